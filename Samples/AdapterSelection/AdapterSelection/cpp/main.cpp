@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "FileHelper.h"
+#include "ResultHelper.h"
 
 using namespace winrt;
 using namespace Windows::Foundation::Collections;
@@ -10,13 +11,12 @@ using namespace Windows::Storage;
 using namespace std;
 
 // globals
-vector<string> labels;
 string labelsFileName("labels.txt");
 hstring modelPath;
 hstring imagePath;
 
 // helper functions
-void PrintResults(IVectorView<float> results);
+void PrintResults(const TensorFloat& results);
 bool ParseArgs(int argc, char* argv[]);
 LearningModelDevice getLearningModelDeviceFromAdapter(com_ptr<IDXGIAdapter1> spAdapter);
 
@@ -105,8 +105,7 @@ int main(int argc, char* argv[])
 
 	// get the output
 	auto resultTensor = results.Outputs().Lookup(outputName).as<TensorFloat>();
-	auto resultVector = resultTensor.GetAsVectorView();
-	PrintResults(resultVector);
+	PrintResults(resultTensor);
 }
 
 LearningModelDevice getLearningModelDeviceFromAdapter(com_ptr<IDXGIAdapter1> spAdapter) {
@@ -147,27 +146,20 @@ bool ParseArgs(int argc, char* argv[])
 	return true;
 }
 
-void PrintResults(IVectorView<float> results)
+void PrintResults(const TensorFloat& results)
 {
     // load the labels
     auto modulePath = FileHelper::GetModulePath();
     std::string labelsFilePath = std::string(modulePath.begin(), modulePath.end()) + labelsFileName;
-    labels = FileHelper::LoadLabels(labelsFilePath);
-
-    vector<pair<float, uint32_t>> sortedResults;
-    for (uint32_t i = 0; i < results.Size(); i++) {
-        pair<float, uint32_t> curr;
-        curr.first = results.GetAt(i);
-        curr.second = i;
-        sortedResults.push_back(curr);
-    }
-    std::sort(sortedResults.begin(), sortedResults.end(),
-        [](pair<float, uint32_t> const &a, pair<float, uint32_t> const &b) { return a.first > b.first; });
+    auto& labels = FileHelper::LoadLabelTable(labelsFilePath);
+
+    // read the scores straight from the output buffer and keep only the top 3
+    ResultHelper::TensorData scores(results);
+    auto topResults = ResultHelper::TopK(scores.Data(), scores.Size(), 3);
 
     // Display the result
-    for (int i = 0; i < 3; i++)
+    for (auto& prediction : topResults)
     {
-        pair<float, uint32_t> curr = sortedResults.at(i);
-        printf("%s with confidence of %f\n", labels[curr.second].c_str(), curr.first);
+        printf("%s with confidence of %f\n", labels.Get(prediction.index), prediction.score);
     }
 }
@@ -1,8 +1,15 @@
 #include "pch.h"
 #include "SampleHelper.h"
+#include "ResultHelper.h"
+#include "TensorConvert.h"
 #include "Windows.AI.MachineLearning.Native.h"
 #include <MemoryBuffer.h>
 #include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <thread>
 
 #define CHECK_HRESULT winrt::check_hresult
 using namespace winrt;
@@ -14,15 +21,36 @@ using namespace winrt::Windows::Graphics::Imaging;
 using namespace winrt::Windows::Storage::Streams;
 using namespace winrt::Windows::Storage;
 
-#define BATCH_SIZE 3
-
 namespace SampleHelper {
 
-std::vector<float>
-SoftwareBitmapToFloatVector(SoftwareBitmap softwareBitmap) {
+static TensorConvert::PixelFormat
+ToTensorConvertFormat(BitmapPixelFormat pixelFormat) {
+  switch (pixelFormat) {
+  case BitmapPixelFormat::Bgra8:
+    return TensorConvert::PixelFormat::Bgra8;
+  case BitmapPixelFormat::Rgba8:
+    return TensorConvert::PixelFormat::Rgba8;
+  case BitmapPixelFormat::Gray8:
+    return TensorConvert::PixelFormat::Gray8;
+  case BitmapPixelFormat::Gray16:
+    return TensorConvert::PixelFormat::Gray16;
+  default:
+    throw hresult_not_implemented(L"Unsupported BitmapPixelFormat.");
+  }
+}
+
+static uint32_t GetChannelCount(BitmapPixelFormat pixelFormat) {
+  return BitmapPixelFormat::Gray8 == pixelFormat ||
+                 BitmapPixelFormat::Gray16 == pixelFormat
+             ? 1
+             : 3;
+}
+
+void SoftwareBitmapToTensorSlice(SoftwareBitmap softwareBitmap, float *slice,
+                                 size_t sliceElements) {
   /* Manully tensorize from CPU resource, steps:
   1. Get the access to buffer of softwarebitmap
-  2. Transform the data in buffer to a vector of float
+  2. Transform the data in buffer into the planar float slice
   */
 
   // 1. Get the access to buffer of softwarebitmap
@@ -39,29 +67,39 @@ SoftwareBitmapToFloatVector(SoftwareBitmap softwareBitmap) {
   uint32_t height = softwareBitmap.PixelHeight();
   uint32_t width = softwareBitmap.PixelWidth();
   BitmapPixelFormat pixelFormat = softwareBitmap.BitmapPixelFormat();
-  uint32_t channels = BitmapPixelFormat::Gray8 == pixelFormat ? 1 : 3;
-
-  std::vector<int64_t> shape = {1, channels, height, width};
-  std::vector<float> outputVector(channels * height * width);
+  uint32_t channels = GetChannelCount(pixelFormat);
+  if (static_cast<size_t>(channels) * height * width != sliceElements) {
+    throw hresult_invalid_argument(
+        L"Image size is different from what the model expects.");
+  }
 
+  // 2. Transform the data in buffer to planar floats
   // The channels of image stored in buffer is in order of BGRA-BGRA-BGRA-BGRA.
   // Then we transform it to the order of
   // BBBBB....GGGGG....RRRR....AAAA(dropped)
-
-  // 2. Transform the data in buffer to a vector of float
-  if (BitmapPixelFormat::Bgra8 == pixelFormat) {
-    for (uint32_t i = 0; i < size; i += 4) {
-      // suppose the model expects BGR image.
-      // index 0 is B, 1 is G, 2 is R, 3 is alpha(dropped).
-      uint32_t pixelInd = i / 4;
-      outputVector[pixelInd] = (float)pData[i];
-      outputVector[(height * width) + pixelInd] = (float)pData[i + 1];
-      outputVector[(height * width * 2) + pixelInd] = (float)pData[i + 2];
-    }
-  }
+  // suppose the model expects BGR image.
+  TensorConvert::ImageDesc image = {};
+  image.data = pData;
+  image.width = width;
+  image.height = height;
+  image.rowPitchInBytes =
+      static_cast<uint32_t>(spBitmapBuffer.GetPlaneDescription(0).Stride);
+  image.format = ToTensorConvertFormat(pixelFormat);
+  TensorConvert::ToPlanarFloat(image, TensorConvert::ChannelOrder::BGR,
+                               channels, slice);
 
   // Pixel Value Normalization can be done at here. We are using the range from
-  // 0-255, but the range can be normilized to 0-1 before we return
+  // 0-255, but the range can be normilized to 0-1 by passing a
+  // TensorConvert::Normalization to ToPlanarFloat.
+}
+
+std::vector<float>
+SoftwareBitmapToFloatVector(SoftwareBitmap softwareBitmap) {
+  size_t elements = static_cast<size_t>(
+                        GetChannelCount(softwareBitmap.BitmapPixelFormat())) *
+                    softwareBitmap.PixelHeight() * softwareBitmap.PixelWidth();
+  std::vector<float> outputVector(elements);
+  SoftwareBitmapToTensorSlice(softwareBitmap, outputVector.data(), elements);
   return outputVector;
 }
 
@@ -77,30 +115,90 @@ hstring GetModelPath(std::string modelType) {
   return modelPath;
 }
 
-TensorFloat CreateInputTensorFloat() {
-  std::vector<hstring> imageNames = {L"fish.png", L"kitten_224.png", L"fish.png"};
-  std::vector<float> inputVector = {};
-  for (hstring imageName : imageNames) {
-    auto imagePath = static_cast<hstring>(FileHelper::GetModulePath().c_str()) + imageName;
-    auto imageFrame = FileHelper::LoadImageFile(imagePath);
-    std::vector<float> imageVector =
-      SoftwareBitmapToFloatVector(imageFrame.SoftwareBitmap());
-    inputVector.insert(inputVector.end(), imageVector.begin(), imageVector.end());
+std::vector<hstring> GetBatchImageNames(uint32_t batchSize) {
+  const std::vector<hstring> sampleImages = {L"fish.png", L"kitten_224.png"};
+  std::vector<hstring> imageNames;
+  for (uint32_t i = 0; i < batchSize; ++i) {
+    imageNames.push_back(sampleImages[i % sampleImages.size()]);
   }
+  return imageNames;
+}
+
+TensorFloat CreateInputTensorFloat(uint32_t batchSize, BatchTimings &timings) {
+  using Clock = std::chrono::high_resolution_clock;
+  using Milliseconds = std::chrono::duration<double, std::milli>;
+  auto start = Clock::now();
 
+  // 1. Allocate the whole {N,3,H,W} tensor once and get its buffer, so each
+  // image is tensorized straight into its own slice without any copies.
   // 224, 224 below are height and width specified in model input.
-  auto inputShape = std::vector<int64_t>{ BATCH_SIZE, 3, 224, 224 };
-  auto inputValue = TensorFloat::CreateFromIterable(
-    inputShape,
-    single_threaded_vector<float>(std::move(inputVector)).GetView());
- 
+  const int64_t height = 224;
+  const int64_t width = 224;
+  auto inputShape = std::vector<int64_t>{batchSize, 3, height, width};
+  TensorFloat inputValue = TensorFloat::Create(inputShape);
+  float *pTensorData = nullptr;
+  uint32_t capacity = 0;
+  com_ptr<ITensorNative> itn = inputValue.as<ITensorNative>();
+  CHECK_HRESULT(
+      itn->GetBuffer(reinterpret_cast<BYTE **>(&pTensorData), &capacity));
+  const size_t sliceElements = static_cast<size_t>(3 * height * width);
+  auto allocated = Clock::now();
+
+  // 2. Decode and tensorize the images in parallel. Workers pull the next
+  // image index from a shared counter so the cost scales with the number of
+  // cores rather than with the batch size.
+  std::vector<hstring> imageNames = GetBatchImageNames(batchSize);
+  std::vector<double> decodeTimes(batchSize);
+  std::vector<double> tensorizeTimes(batchSize);
+  std::atomic<uint32_t> nextImage = 0;
+  uint32_t threadCount = (std::max)(
+      1u, (std::min)(batchSize, std::thread::hardware_concurrency()));
+  std::vector<std::exception_ptr> errors(threadCount);
+  auto modulePath = static_cast<hstring>(FileHelper::GetModulePath().c_str());
+
+  auto worker = [&](uint32_t threadIndex) {
+    try {
+      for (uint32_t i = nextImage++; i < batchSize; i = nextImage++) {
+        auto decodeStart = Clock::now();
+        auto imageFrame = FileHelper::LoadImageFile(modulePath + imageNames[i]);
+        auto decodeEnd = Clock::now();
+        SoftwareBitmapToTensorSlice(imageFrame.SoftwareBitmap(),
+                                    pTensorData + i * sliceElements,
+                                    sliceElements);
+        decodeTimes[i] = Milliseconds(decodeEnd - decodeStart).count();
+        tensorizeTimes[i] = Milliseconds(Clock::now() - decodeEnd).count();
+      }
+    } catch (...) {
+      errors[threadIndex] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (uint32_t t = 1; t < threadCount; ++t) {
+    threads.emplace_back(worker, t);
+  }
+  worker(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto &error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+  timings.allocate = Milliseconds(allocated - start).count();
+  timings.decode = std::accumulate(decodeTimes.begin(), decodeTimes.end(), 0.0);
+  timings.tensorize =
+      std::accumulate(tensorizeTimes.begin(), tensorizeTimes.end(), 0.0);
+  timings.total = Milliseconds(Clock::now() - start).count();
+  timings.threads = threadCount;
   return inputValue;
 }
 
-IVector<VideoFrame> CreateVideoFrames() {
-  std::vector<hstring> imageNames = { L"fish.png", L"kitten_224.png", L"fish.png" };
+IVector<VideoFrame> CreateVideoFrames(uint32_t batchSize) {
   std::vector<VideoFrame> inputFrames = {};
-  for (hstring imageName : imageNames) {
+  for (hstring imageName : GetBatchImageNames(batchSize)) {
     auto imagePath = static_cast<hstring>(FileHelper::GetModulePath().c_str()) + imageName;
     auto imageFrame = FileHelper::LoadImageFile(imagePath);
     inputFrames.emplace_back(imageFrame);
@@ -109,29 +207,34 @@ IVector<VideoFrame> CreateVideoFrames() {
   return videoFrames;
 }
 
-void PrintResults(IVectorView<float> results) {
+void PrintResults(const TensorFloat &results, uint32_t batchSize) {
   // load the labels
   auto modulePath = FileHelper::GetModulePath();
   std::string labelsFilePath =
       std::string(modulePath.begin(), modulePath.end()) + "Labels.txt";
-  std::vector<std::string> labels = FileHelper::LoadLabels(labelsFilePath);
-  // SqueezeNet returns a list of 1000 options, with probabilities for each,
-  // loop through all
-  for (uint32_t batchId = 0; batchId < BATCH_SIZE; ++batchId) {
-    // Find the top probability
-    float topProbability = 0;
-    int topProbabilityLabelIndex;
-    uint32_t oneOutputSize = results.Size() / BATCH_SIZE;
-    for (uint32_t i = 0; i < oneOutputSize; i++) {
-      if (results.GetAt(i + oneOutputSize * batchId) > topProbability) {
-        topProbabilityLabelIndex = i;
-        topProbability = results.GetAt(i + oneOutputSize * batchId);
-      }
-    }
+  auto &labels = FileHelper::LoadLabelTable(labelsFilePath);
+  // SqueezeNet returns a list of 1000 options, with probabilities for each.
+  // Read them from the output buffer and find the top probability of every
+  // batch item in a single pass over its scores.
+  ResultHelper::TensorData scores(results);
+  auto topResults =
+      ResultHelper::TopKPerBatch(scores.Data(), scores.Size(), batchSize, 1);
+  for (uint32_t batchId = 0; batchId < batchSize; ++batchId) {
     // Display the result
     printf("Result for No.%d input \n", batchId);
-    printf("%s with confidence of %f\n",
-           labels[topProbabilityLabelIndex].c_str(), topProbability);
+    if (topResults[batchId].empty()) {
+      printf("no result\n");
+      continue;
+    }
+    const auto &top = topResults[batchId][0];
+    printf("%s with confidence of %f\n", labels.Get(top.index), top.score);
   }
 }
+
+void PrintBatchTimings(const BatchTimings &timings) {
+  printf("Batch built in %.2f ms on %u threads (allocate %.2f ms, decode "
+         "%.2f ms, tensorize %.2f ms summed over images)\n",
+         timings.total, timings.threads, timings.allocate, timings.decode,
+         timings.tensorize);
+}
 } // namespace SampleHelper
\ No newline at end of file
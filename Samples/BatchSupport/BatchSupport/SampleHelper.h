@@ -8,18 +8,42 @@
 
 namespace SampleHelper
 {
+  // Per-stage cost of building a batch, in milliseconds. Decode and
+  // tensorize are summed over all images; since images are processed in
+  // parallel they can exceed the wall-clock total.
+  struct BatchTimings {
+    double allocate = 0;
+    double decode = 0;
+    double tensorize = 0;
+    double total = 0;
+    uint32_t threads = 0;
+  };
+
   // Convert SoftwareBitmap to std::vector<float>
   std::vector<float> SoftwareBitmapToFloatVector(
     winrt::Windows::Graphics::Imaging::SoftwareBitmap softwareBitmap);
 
-  // Create input Tensorfloats with 3 images.
-  winrt::Windows::AI::MachineLearning::TensorFloat CreateInputTensorFloat();
+  // Tensorize a SoftwareBitmap into a caller provided {3,H,W} buffer.
+  void SoftwareBitmapToTensorSlice(
+    winrt::Windows::Graphics::Imaging::SoftwareBitmap softwareBitmap,
+    float* slice, size_t sliceElements);
+
+  // Image file names for a batch, cycling through the sample images.
+  std::vector<winrt::hstring> GetBatchImageNames(uint32_t batchSize);
 
-  // Create input VideoFrames with 3 images
-  winrt::Windows::Foundation::Collections::IVector<winrt::Windows::Media::VideoFrame> CreateVideoFrames();
+  // Create one {batchSize,3,224,224} TensorFloat, decoding and tensorizing
+  // every image in parallel directly into its slice of the tensor buffer.
+  winrt::Windows::AI::MachineLearning::TensorFloat CreateInputTensorFloat(
+    uint32_t batchSize, BatchTimings& timings);
+
+  // Create input VideoFrames with batchSize images
+  winrt::Windows::Foundation::Collections::IVector<winrt::Windows::Media::VideoFrame> CreateVideoFrames(
+    uint32_t batchSize);
 
   winrt::hstring GetModelPath(std::string modelType);
 
-  void PrintResults(winrt::Windows::Foundation::Collections::IVectorView<float> results);
+  void PrintResults(const winrt::Windows::AI::MachineLearning::TensorFloat& results, uint32_t batchSize);
+
+  void PrintBatchTimings(const BatchTimings& timings);
 
 }
\ No newline at end of file
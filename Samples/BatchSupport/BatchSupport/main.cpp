@@ -1,5 +1,6 @@
 ﻿#include "pch.h"
 #include "SampleHelper.h"
+#include "AsyncEvaluator.h"
 
 using namespace winrt;
 using namespace Windows::Foundation;
@@ -11,9 +12,11 @@ using namespace Windows::Storage;
 using namespace winrt::Windows::Storage::Streams;
 using namespace std;
 
-#define BATCH_SIZE 3
+// SqueezeNet_batch3.onnx has a fixed batch dimension of 3.
+const uint32_t fixedBatchSize = 3;
 string modelType = "freeBatchSize";
 string inputType = "TensorFloat";
+uint32_t batchSize = fixedBatchSize;
 
 hstring executionPath =
     static_cast<hstring>(FileHelper::GetModulePath().c_str());
@@ -25,7 +28,11 @@ int main(int argc, char *argv[]) {
 
   // did they pass in the args
   if (ParseArgs(argc, argv) == false) {
-    printf("Usage: %s [freeBatchSize|fixedBatchSize] [TensorFloat|VideoFrame] \n", argv[0]);
+    printf("Usage: %s [freeBatchSize|fixedBatchSize] [TensorFloat|VideoFrame] [batchSize] \n", argv[0]);
+  }
+  if ("fixedBatchSize" == modelType && batchSize != fixedBatchSize) {
+    printf("fixedBatchSize model only supports a batch size of %d\n", fixedBatchSize);
+    batchSize = fixedBatchSize;
   }
 
   // load the model
@@ -40,43 +47,53 @@ int main(int argc, char *argv[]) {
     // If the model has free dimensional batch, override the free dimension with batch_size 
     // for performance improvement.
     LearningModelSessionOptions options;
-    printf("Override Batch Size by %d\n", BATCH_SIZE);
-    options.BatchSizeOverride(static_cast<uint32_t>(BATCH_SIZE));
+    printf("Override Batch Size by %d\n", batchSize);
+    options.BatchSizeOverride(batchSize);
     session = LearningModelSession(model, LearningModelDevice(deviceKind), options);
   }
   else {
     session = LearningModelSession(model, LearningModelDevice(deviceKind));
   }
-  LearningModelBinding binding(session);
 
   // bind the intput image
   printf("Binding...\n");
   auto inputFeatureDescriptor = model.InputFeatures().First();
+  IInspectable inputValue = nullptr;
 
   if (inputType == "TensorFloat") { // if bind TensorFloat
-    // Create input Tensorfloats with 3 copied tensors.
-    TensorFloat inputTensorValue = SampleHelper::CreateInputTensorFloat();
-    binding.Bind(inputFeatureDescriptor.Current().Name(), inputTensorValue);
+    // Create one input TensorFloat holding batchSize images.
+    SampleHelper::BatchTimings timings;
+    TensorFloat inputTensorValue = SampleHelper::CreateInputTensorFloat(batchSize, timings);
+    SampleHelper::PrintBatchTimings(timings);
+    inputValue = inputTensorValue;
   } else { // else bind VideoFrames
-    // Create input VideoFrames with 3 copied images
-    auto inputVideoFrames = SampleHelper::CreateVideoFrames();
-    binding.Bind(inputFeatureDescriptor.Current().Name(), inputVideoFrames);
+    // Create input VideoFrames with batchSize images
+    auto inputVideoFrames = SampleHelper::CreateVideoFrames(batchSize);
+    inputValue = inputVideoFrames;
   }
 
-  // bind output tensor, this step is optional, conmented out in the sample
+  // bind output tensor, this step is optional, conmented out in the sample.
+  // The evaluator owns the binding, so the output is bound in the Submit
+  // callback below, next to the input.
   /*
-  auto outputShape = std::vector<int64_t>{ BATCH_SIZE, 1000, 1, 1 };
+  auto outputShape = std::vector<int64_t>{ batchSize, 1000, 1, 1 };
   auto outputValue = TensorFloat::Create(outputShape);
-  std::wstring outputDataBindingName =
-    std::wstring(model.OutputFeatures().First().Current().Name());
-  binding.Bind(outputDataBindingName, outputValue);
+  hstring outputName = model.OutputFeatures().First().Current().Name();
   */
 
 
-  // now run the model
+  // now run the model. The evaluator owns the binding; one batch needs only one
+  // evaluation in flight.
   printf("Running the model...\n");
+  AsyncEvaluation::AsyncEvaluator evaluator(session, 1);
+  hstring inputName = inputFeatureDescriptor.Current().Name();
   DWORD ticks = GetTickCount();
-  auto results = session.EvaluateAsync(binding, L"RunId").get();
+  auto results = evaluator
+                   .Submit([&](const LearningModelBinding& binding) {
+                     binding.Bind(inputName, inputValue);
+                     // binding.Bind(outputName, outputValue); // if bind output
+                   })
+                   .get();
   ticks = GetTickCount() - ticks;
   printf("model run took %d ticks\n", ticks);
 
@@ -88,7 +105,7 @@ int main(int argc, char *argv[]) {
   printf("output dimensions [%d, %d, %d, %d]\n", outputShape.GetAt(0), outputShape.GetAt(1), outputShape.GetAt(2), outputShape.GetAt(3));
   // conment out three lines above if bind output
 
-  SampleHelper::PrintResults(outputValue.GetAsVectorView());
+  SampleHelper::PrintResults(outputValue, batchSize);
 }
 
 bool ParseArgs(int argc, char *argv[]) {
@@ -96,8 +113,15 @@ bool ParseArgs(int argc, char *argv[]) {
     return false;
   }
   modelType = argv[1];
-  if (argc > 3) {
+  if (argc > 2) {
     inputType = argv[2];
   }
+  if (argc > 3) {
+    int requestedBatchSize = atoi(argv[3]);
+    if (requestedBatchSize <= 0) {
+      return false;
+    }
+    batchSize = static_cast<uint32_t>(requestedBatchSize);
+  }
   return true;
 }
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "TensorConvertor.h"
+#include "TensorConvert.h"
 #include <MemoryBuffer.h>
 // d3dx12.h can be downloaded from https://github.com/Microsoft/DirectX-Graphics-Samples/blob/master/Libraries/D3DX12/d3dx12.h
 // d3dx12.h is a cool helper library, that lets us use Updatesubresources().
@@ -20,6 +21,23 @@ EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 
 namespace TensorizationHelper
 {
+    static TensorConvert::PixelFormat ToTensorConvertFormat(BitmapPixelFormat pixelFormat)
+    {
+        switch (pixelFormat)
+        {
+        case BitmapPixelFormat::Bgra8:
+            return TensorConvert::PixelFormat::Bgra8;
+        case BitmapPixelFormat::Rgba8:
+            return TensorConvert::PixelFormat::Rgba8;
+        case BitmapPixelFormat::Gray8:
+            return TensorConvert::PixelFormat::Gray8;
+        case BitmapPixelFormat::Gray16:
+            return TensorConvert::PixelFormat::Gray16;
+        default:
+            throw hresult_not_implemented(L"Unsupported BitmapPixelFormat.");
+        }
+    }
+
 	std::wstring GetFileName()
 	{
 		wchar_t modulePath[MAX_PATH] = { 0 };
@@ -50,7 +68,7 @@ namespace TensorizationHelper
         uint32_t height = softwareBitmap.PixelHeight();
         uint32_t width = softwareBitmap.PixelWidth();
         BitmapPixelFormat pixelFormat = softwareBitmap.BitmapPixelFormat();
-        uint32_t channels = BitmapPixelFormat::Gray8 == pixelFormat ? 1 : 3;
+        uint32_t channels = BitmapPixelFormat::Gray8 == pixelFormat || BitmapPixelFormat::Gray16 == pixelFormat ? 1 : 3;
 
         std::vector<int64_t> shape = { 1, channels, height , width };
         float* pCPUTensor;
@@ -63,46 +81,17 @@ namespace TensorizationHelper
         CHECK_HRESULT(itn->GetBuffer(reinterpret_cast<BYTE**>(&pCPUTensor), &uCapacity));
 
         // 2. Transform the data in buffer to a vector of float
-        if (BitmapPixelFormat::Bgra8 == pixelFormat)
-        {
-            for (UINT32 i = 0; i < size; i += 4)
-            {
-                // suppose the model expects BGR image.
-                // index 0 is B, 1 is G, 2 is R, 3 is alpha(dropped).
-                UINT32 pixelInd = i / 4;
-                pCPUTensor[pixelInd] = (float)pData[i];
-                pCPUTensor[(height * width) + pixelInd] = (float)pData[i + 1];
-                pCPUTensor[(height * width * 2) + pixelInd] = (float)pData[i + 2];
-            }
-        }
-        else if (BitmapPixelFormat::Rgba8 == pixelFormat)
-        {
-            for (UINT32 i = 0; i < size; i += 4)
-            {
-                // suppose the model expects BGR image.
-                // index 0 is B, 1 is G, 2 is R, 3 is alpha(dropped).
-                UINT32 pixelInd = i / 4;
-                pCPUTensor[pixelInd] = (float)pData[i + 2];
-                pCPUTensor[(height * width) + pixelInd] = (float)pData[i + 1];
-                pCPUTensor[(height * width * 2) + pixelInd] = (float)pData[i];
-            }
-        }
-        else if (BitmapPixelFormat::Gray8 == pixelFormat)
-        {
-            for (UINT32 i = 0; i < size; i += 4)
-            {
-                // suppose the model expects BGR image.
-                // index 0 is B, 1 is G, 2 is R, 3 is alpha(dropped).
-                UINT32 pixelInd = i / 4;
-                float red = (float)pData[i + 2];
-                float green = (float)pData[i + 1];
-                float blue = (float)pData[i];
-                float gray = 0.2126f * red + 0.7152f * green + 0.0722f * blue;
-                pCPUTensor[pixelInd] = gray;
-            }
-        }
+        // suppose the model expects BGR image. Gray images are written to a single plane.
+        TensorConvert::ImageDesc image = {};
+        image.data = pData;
+        image.width = width;
+        image.height = height;
+        image.rowPitchInBytes = static_cast<uint32_t>(spBitmapBuffer.GetPlaneDescription(0).Stride);
+        image.format = ToTensorConvertFormat(pixelFormat);
+        TensorConvert::ToPlanarFloat(image, TensorConvert::ChannelOrder::BGR, channels, pCPUTensor);
+
         // Pixel Value Normalization can be done at here. We are using the range from 0-255, 
-        // but the range can be normilized to 0-1 before we return the TensorFloat.
+        // but the range can be normilized to 0-1 by passing a TensorConvert::Normalization to ToPlanarFloat.
         return tf;
     }
 
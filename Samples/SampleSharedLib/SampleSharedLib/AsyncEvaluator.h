@@ -0,0 +1,205 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <winrt/Windows.Foundation.h>
+#include <winrt/Windows.AI.MachineLearning.h>
+
+// Header-only engine that keeps several LearningModelSession::EvaluateAsync
+// calls in flight at once.
+//
+// The evaluator owns a pool of maxInFlight bindings over one session. Each
+// submission takes a free binding, lets the caller bind its inputs and starts
+// EvaluateAsync without waiting for it. When all bindings are in use, Submit
+// blocks until an evaluation completes, so a fast producer is held back to at
+// most maxInFlight outstanding evaluations instead of queuing without bound.
+//
+// Completions run on the thread that finishes the evaluation (usually a
+// thread pool thread) and are delivered through a callback or a std::future.
+namespace AsyncEvaluation {
+  class AsyncEvaluator {
+    using LearningModelBinding = winrt::Windows::AI::MachineLearning::LearningModelBinding;
+    using LearningModelEvaluationResult =
+      winrt::Windows::AI::MachineLearning::LearningModelEvaluationResult;
+    using LearningModelSession = winrt::Windows::AI::MachineLearning::LearningModelSession;
+
+  public:
+    // Binds the inputs (and optionally outputs) of one evaluation.
+    using BindCallback = std::function<void(const LearningModelBinding&)>;
+    // Receives the result together with the binding it was evaluated with.
+    // Tensors bound as outputs may be read here; the binding is handed to the
+    // next submission as soon as the callback returns. The callback must not
+    // call Submit itself.
+    using CompletionCallback = std::function<void(
+      const LearningModelEvaluationResult&, const LearningModelBinding&)>;
+
+    AsyncEvaluator(const LearningModelSession& session, uint32_t maxInFlight)
+        : m_session(session) {
+      if (maxInFlight == 0) {
+        throw winrt::hresult_invalid_argument(
+          L"AsyncEvaluator: maxInFlight must be at least 1.");
+      }
+      for (uint32_t i = 0; i < maxInFlight; i++) {
+        m_bindings.emplace_back(session);
+        m_free.push_back(i);
+      }
+    }
+
+    // Waits for every outstanding evaluation. Errors that were not collected
+    // by Drain are dropped.
+    ~AsyncEvaluator() {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_condVar.wait(lock, [this] { return m_free.size() == m_bindings.size(); });
+    }
+
+    AsyncEvaluator(const AsyncEvaluator&) = delete;
+    AsyncEvaluator& operator=(const AsyncEvaluator&) = delete;
+
+    // Starts one evaluation and returns once it is in flight. A failed
+    // evaluation or a throwing callback is reported by the next Drain.
+    void Submit(const BindCallback& bind, CompletionCallback onCompleted) {
+      Start(bind, false,
+            [this, onCompleted](const LearningModelEvaluationResult& result,
+                                const LearningModelBinding& binding,
+                                std::exception_ptr error) {
+              if (error) {
+                RecordError(error);
+                return;
+              }
+              try {
+                onCompleted(result, binding);
+              }
+              catch (...) {
+                RecordError(std::current_exception());
+              }
+            });
+    }
+
+    // Starts one evaluation. The future carries the result or the evaluation
+    // error. Read outputs through the result; tensors bound as outputs are
+    // reused by later submissions.
+    std::future<LearningModelEvaluationResult> Submit(const BindCallback& bind) {
+      auto promise = std::make_shared<std::promise<LearningModelEvaluationResult>>();
+      auto future = promise->get_future();
+      Start(bind, true,
+            [promise](const LearningModelEvaluationResult& result,
+                      const LearningModelBinding&, std::exception_ptr error) {
+              if (error) {
+                promise->set_exception(error);
+              }
+              else {
+                promise->set_value(result);
+              }
+            });
+      return future;
+    }
+
+    // Blocks until nothing is in flight, then rethrows the first error
+    // reported by a callback-style submission since the last Drain.
+    void Drain() {
+      std::exception_ptr error;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condVar.wait(lock, [this] { return m_free.size() == m_bindings.size(); });
+        std::swap(error, m_firstError);
+      }
+      if (error) {
+        std::rethrow_exception(error);
+      }
+    }
+
+    uint32_t MaxInFlight() const { return static_cast<uint32_t>(m_bindings.size()); }
+    uint64_t NumCompleted() const { return m_numCompleted; }
+    // Number of times Submit had to wait for a binding to become free.
+    uint64_t NumBackpressureWaits() const { return m_numBackpressureWaits; }
+
+  private:
+    using Completion = std::function<void(
+      const LearningModelEvaluationResult&, const LearningModelBinding&, std::exception_ptr)>;
+
+    // With releaseFirst the binding is returned to the pool before done runs,
+    // so done, or a thread waiting on the future it completes, may submit
+    // again without deadlocking on its own binding.
+    void Start(const BindCallback& bind, bool releaseFirst, Completion done) {
+      size_t slot = Acquire();
+      LearningModelBinding binding = m_bindings[slot];
+      winrt::Windows::Foundation::IAsyncOperation<LearningModelEvaluationResult> operation = nullptr;
+      try {
+        bind(binding);
+        operation = m_session.EvaluateAsync(binding, L"");
+      }
+      catch (...) {
+        Release(slot);
+        throw;
+      }
+
+      operation.Completed(
+        [this, slot, binding, releaseFirst, done](
+          const winrt::Windows::Foundation::IAsyncOperation<LearningModelEvaluationResult>& completed,
+          winrt::Windows::Foundation::AsyncStatus) {
+          LearningModelEvaluationResult result = nullptr;
+          std::exception_ptr error;
+          try {
+            result = completed.GetResults();
+            if (!result.Succeeded()) {
+              winrt::throw_hresult(result.ErrorStatus());
+            }
+          }
+          catch (...) {
+            error = std::current_exception();
+          }
+          m_numCompleted++;
+          if (releaseFirst) {
+            Release(slot);
+            done(result, binding, error);
+          }
+          else {
+            done(result, binding, error);
+            Release(slot);
+          }
+        });
+    }
+
+    size_t Acquire() {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      if (m_free.empty()) {
+        m_numBackpressureWaits++;
+        m_condVar.wait(lock, [this] { return !m_free.empty(); });
+      }
+      size_t slot = m_free.back();
+      m_free.pop_back();
+      return slot;
+    }
+
+    void Release(size_t slot) {
+      // Notify under the lock: once the pool is full the destructor may run,
+      // and it must not destroy the condition variable under a late notify.
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_free.push_back(slot);
+      m_condVar.notify_all();
+    }
+
+    void RecordError(std::exception_ptr error) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_firstError) {
+        m_firstError = error;
+      }
+    }
+
+    LearningModelSession m_session;
+    std::vector<LearningModelBinding> m_bindings;
+    std::mutex m_mutex;
+    std::condition_variable m_condVar;
+    // Indices into m_bindings that are not in flight.
+    std::vector<size_t> m_free;
+    std::exception_ptr m_firstError;
+    std::atomic<uint64_t> m_numCompleted{ 0 };
+    std::atomic<uint64_t> m_numBackpressureWaits{ 0 };
+  };
+}
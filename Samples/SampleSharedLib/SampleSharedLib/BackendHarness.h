@@ -0,0 +1,225 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "InferenceBackend.h"
+#include "ResultHelper.h"
+#include "TensorConvert.h"
+
+// Header-only benchmark harness over InferenceBackend: input generation,
+// the timed load/session/bind/evaluate sequence and output comparison. It
+// uses only the standard library, so with ReferenceBackend it builds and runs
+// off Windows, and WinMLRunner's -Backend and -CompareOutputs and the tests
+// drive every backend through the same code.
+//
+// The default WinMLRunner pipeline stays on the WinRT types: it binds images,
+// GPU resources and device-specific tensors that the interface does not
+// model. Bad inputs throw std::invalid_argument.
+namespace BackendHarness {
+  using InferenceBackend::ElementType;
+
+  // Reads comma or newline separated values, as -Input accepts them.
+  inline std::vector<double> ReadCsvValues(const std::filesystem::path& path) {
+    std::ifstream fileStream(path);
+    if (!fileStream.is_open()) {
+      throw std::invalid_argument("BackendHarness: could not open the input file.");
+    }
+    std::vector<double> values;
+    std::string line;
+    while (std::getline(fileStream, line)) {
+      std::stringstream lineStream(line);
+      std::string value;
+      while (std::getline(lineStream, value, ',')) {
+        if (value.find_first_not_of(" \t\r") != std::string::npos) {
+          values.push_back(std::stod(value));
+        }
+      }
+    }
+    return values;
+  }
+
+  template <typename T> void FillTensor(InferenceBackend::Tensor& tensor, const std::vector<double>& values) {
+    T* data = tensor.Data<T>();
+    for (size_t i = 0; i < tensor.ElementCount(); i++) {
+      data[i] = static_cast<T>(values[i]);
+    }
+  }
+
+  // Builds the value for one model input from csvValues, or from random
+  // values in [0, 1) when csvValues is empty. The random values come from a
+  // fixed seed, so two models see the same inputs up to the input type. Free
+  // dimensions are bound as 1.
+  inline InferenceBackend::Tensor CreateInput(const InferenceBackend::ValueInfo& info,
+                                              std::vector<double> csvValues) {
+    std::vector<int64_t> shape = info.shape;
+    for (auto& dim : shape) {
+      dim = dim < 0 ? 1 : dim;
+    }
+    InferenceBackend::Tensor tensor(info.type, shape);
+    if (csvValues.empty()) {
+      std::mt19937 generator(0);
+      std::uniform_real_distribution<double> distribution(0.0, 1.0);
+      csvValues.resize(tensor.ElementCount());
+      for (auto& value : csvValues) {
+        value = distribution(generator);
+      }
+    }
+    else if (csvValues.size() != tensor.ElementCount()) {
+      throw std::invalid_argument("CSV input size/shape is different from what model expects!");
+    }
+
+    switch (info.type) {
+    case ElementType::Float: FillTensor<float>(tensor, csvValues); break;
+    case ElementType::Float16:
+      for (size_t i = 0; i < tensor.ElementCount(); i++) {
+        tensor.Data<uint16_t>()[i] = TensorConvert::FloatToHalf(static_cast<float>(csvValues[i]));
+      }
+      break;
+    case ElementType::Double: FillTensor<double>(tensor, csvValues); break;
+    case ElementType::Int8: FillTensor<int8_t>(tensor, csvValues); break;
+    case ElementType::UInt8: FillTensor<uint8_t>(tensor, csvValues); break;
+    case ElementType::Int32: FillTensor<int32_t>(tensor, csvValues); break;
+    case ElementType::Int64: FillTensor<int64_t>(tensor, csvValues); break;
+    default:
+      throw std::invalid_argument(std::string("BackendHarness: inputs of type ") +
+                                  InferenceBackend::ElementTypeName(info.type) + " are not supported.");
+    }
+    return tensor;
+  }
+
+  inline bool IsFloatingPoint(ElementType type) {
+    return type == ElementType::Float || type == ElementType::Float16 || type == ElementType::Double;
+  }
+
+  // The values of a float, float16 or double tensor as floats.
+  inline std::vector<float> ToFloats(const InferenceBackend::Tensor& tensor) {
+    std::vector<float> values(tensor.ElementCount());
+    for (size_t i = 0; i < values.size(); i++) {
+      switch (tensor.Type()) {
+      case ElementType::Float: values[i] = tensor.Data<float>()[i]; break;
+      case ElementType::Float16: values[i] = TensorConvert::HalfToFloat(tensor.Data<uint16_t>()[i]); break;
+      case ElementType::Double: values[i] = static_cast<float>(tensor.Data<double>()[i]); break;
+      default: throw std::invalid_argument("BackendHarness: only floating point outputs can be compared.");
+      }
+    }
+    return values;
+  }
+
+  // Writes a float output in the format of -SaveTensorData, so that the same
+  // comparisons apply to every backend.
+  inline void SaveTensor(const std::filesystem::path& path, const InferenceBackend::Tensor& tensor) {
+    std::ofstream fileStream(path);
+    fileStream << "Index,Value" << std::endl;
+    for (size_t i = 0; i < tensor.ElementCount(); i++) {
+      fileStream << i << "," << tensor.Data<float>()[i] << std::endl;
+    }
+  }
+
+  // A model loaded, bound and evaluated through a backend, with the time of
+  // each step. Outputs of the last evaluation are read through session.
+  struct Run {
+    std::unique_ptr<InferenceBackend::Model> model;
+    std::unique_ptr<InferenceBackend::Session> session;
+    double loadMilliseconds = 0;
+    double sessionMilliseconds = 0;
+    double bindMilliseconds = 0;
+    std::vector<double> evaluateMilliseconds;
+
+    double FirstEvaluateMilliseconds() const {
+      return evaluateMilliseconds.empty() ? 0 : evaluateMilliseconds.front();
+    }
+
+    // The average of every evaluation after the first, which pays for
+    // one-time initialization.
+    double AverageEvaluateMilliseconds() const {
+      double average = 0;
+      for (size_t i = 1; i < evaluateMilliseconds.size(); i++) {
+        average += evaluateMilliseconds[i] / (evaluateMilliseconds.size() - 1);
+      }
+      return average;
+    }
+  };
+
+  // Loads path through backend, creates a session, binds csvValues (or random
+  // values, see CreateInput) to every input and evaluates numIterations times.
+  inline Run LoadBindAndEvaluate(InferenceBackend::Backend& backend, const std::filesystem::path& path,
+                                 const std::vector<double>& csvValues, unsigned numIterations) {
+    using Clock = std::chrono::steady_clock;
+    auto millisecondsSince = [](Clock::time_point start) {
+      return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    Run run;
+    Clock::time_point start = Clock::now();
+    run.model = backend.Load(path);
+    run.loadMilliseconds = millisecondsSince(start);
+
+    start = Clock::now();
+    run.session = run.model->CreateSession();
+    run.sessionMilliseconds = millisecondsSince(start);
+
+    if (!csvValues.empty() && run.model->Inputs().size() != 1) {
+      throw std::invalid_argument("BackendHarness: CSV input needs a model with a single input.");
+    }
+    start = Clock::now();
+    for (const auto& input : run.model->Inputs()) {
+      run.session->Bind(input.name, CreateInput(input, csvValues));
+    }
+    run.bindMilliseconds = millisecondsSince(start);
+
+    for (unsigned iteration = 0; iteration < numIterations; iteration++) {
+      start = Clock::now();
+      run.session->Evaluate();
+      run.evaluateMilliseconds.push_back(millisecondsSince(start));
+    }
+    return run;
+  }
+
+  struct OutputComparison {
+    double maxAbsError = 0;
+    double meanAbsError = 0;
+    bool sameTop1 = false;
+    // Classes in the candidate's top k that are also in the reference's.
+    size_t topKOverlap = 0;
+    size_t topKCount = 0;
+  };
+
+  // Compares two floating point outputs of the same size element by element
+  // and by their top k classes.
+  inline OutputComparison CompareOutputs(const InferenceBackend::Tensor& referenceTensor,
+                                         const InferenceBackend::Tensor& candidateTensor, uint32_t topK) {
+    if (!IsFloatingPoint(referenceTensor.Type()) || !IsFloatingPoint(candidateTensor.Type()) ||
+        referenceTensor.ElementCount() != candidateTensor.ElementCount()) {
+      throw std::invalid_argument("BackendHarness: outputs of different sizes or types cannot be compared.");
+    }
+    std::vector<float> reference = ToFloats(referenceTensor);
+    std::vector<float> candidate = ToFloats(candidateTensor);
+    OutputComparison comparison;
+    double totalError = 0;
+    for (size_t i = 0; i < reference.size(); i++) {
+      double error = std::abs(static_cast<double>(reference[i]) - candidate[i]);
+      comparison.maxAbsError = (std::max)(comparison.maxAbsError, error);
+      totalError += error;
+    }
+    comparison.meanAbsError = reference.empty() ? 0.0 : totalError / reference.size();
+
+    auto referenceTop = ResultHelper::TopK(reference.data(), reference.size(), topK);
+    auto candidateTop = ResultHelper::TopK(candidate.data(), candidate.size(), topK);
+    for (const auto& prediction : candidateTop) {
+      comparison.topKOverlap += std::any_of(referenceTop.begin(), referenceTop.end(),
+                                            [&](const auto& other) { return other.index == prediction.index; });
+    }
+    comparison.topKCount = referenceTop.size();
+    comparison.sameTop1 = !referenceTop.empty() && !candidateTop.empty() &&
+                          referenceTop.front().index == candidateTop.front().index;
+    return comparison;
+  }
+}
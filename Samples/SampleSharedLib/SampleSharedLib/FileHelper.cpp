@@ -1,5 +1,8 @@
 #include "pch.h"
 #include "FileHelper.h"
+// Only the label table is used here.
+#define RESULTHELPER_NO_WINRT
+#include "ResultHelper.h"
 
 EXTERN_C IMAGE_DOS_HEADER __ImageBase;
 
@@ -51,27 +54,24 @@ namespace FileHelper {
   }
 
   std::vector<std::string> LoadLabels(std::string labelsFilePath) {
-    // Parse labels from labels file.  We know the file's entries are already
-    // sorted in order.
+    const ResultHelper::LabelTable& table = LoadLabelTable(labelsFilePath);
     std::vector<std::string> labels;
-    std::ifstream labelFile{ labelsFilePath, std::ifstream::in };
-    if (labelFile.fail()) {
+    labels.reserve(table.Size());
+    for (size_t i = 0; i < table.Size(); i++) {
+      labels.emplace_back(table.Get(i));
+    }
+    return labels;
+  }
+
+  const ResultHelper::LabelTable& LoadLabelTable(const std::string& labelsFilePath) {
+    try {
+      return ResultHelper::LabelTable::Shared(labelsFilePath);
+    }
+    catch (const std::runtime_error&) {
       printf("failed to load the %s file.  Make sure it exists in the same "
         "folder as the app\r\n",
         labelsFilePath.c_str());
       exit(EXIT_FAILURE);
     }
-
-    std::string s;
-    while (std::getline(labelFile, s, ',')) {
-      int labelValue = atoi(s.c_str());
-      if (labelValue >= labels.size()) {
-        labels.resize(labelValue + 1);
-      }
-      std::getline(labelFile, s);
-      labels[labelValue] = s;
-    }
-
-    return labels;
   }
 }
\ No newline at end of file
@@ -3,6 +3,10 @@
 #include <winrt/Windows.Media.h>
 #include <Windows.h>
 
+namespace ResultHelper {
+  class LabelTable;
+}
+
 namespace FileHelper
 {
   // Get the Path of Executable
@@ -14,4 +18,8 @@ namespace FileHelper
 
   // Load object detection labels
   std::vector<std::string> LoadLabels(std::string labelsFilePath);
+
+  // Load object detection labels into a table that is parsed once per
+  // process and shared by later calls with the same path
+  const ResultHelper::LabelTable& LoadLabelTable(const std::string& labelsFilePath);
 }
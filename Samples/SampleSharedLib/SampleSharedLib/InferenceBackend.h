@@ -0,0 +1,163 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Portable, header-only interface to an inference engine: load a model,
+// create a session, bind inputs, evaluate, and read outputs back as raw typed
+// host buffers. Harness code written against it (BackendHarness.h: input
+// generation, timing, output checks) runs unchanged on every backend,
+// including ones that build off Windows such as ReferenceBackend. Backends
+// report errors by throwing std::exception subclasses.
+namespace InferenceBackend {
+  enum class ElementType {
+    Undefined,
+    Float,
+    Float16,
+    Double,
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Int64,
+    UInt64,
+    Bool
+  };
+
+  inline size_t ElementSize(ElementType type) {
+    switch (type) {
+    case ElementType::Int8:
+    case ElementType::UInt8:
+    case ElementType::Bool:
+      return 1;
+    case ElementType::Float16:
+    case ElementType::Int16:
+    case ElementType::UInt16:
+      return 2;
+    case ElementType::Float:
+    case ElementType::Int32:
+    case ElementType::UInt32:
+      return 4;
+    case ElementType::Double:
+    case ElementType::Int64:
+    case ElementType::UInt64:
+      return 8;
+    default:
+      return 0;
+    }
+  }
+
+  inline const char* ElementTypeName(ElementType type) {
+    switch (type) {
+    case ElementType::Float: return "float";
+    case ElementType::Float16: return "float16";
+    case ElementType::Double: return "double";
+    case ElementType::Int8: return "int8";
+    case ElementType::UInt8: return "uint8";
+    case ElementType::Int16: return "int16";
+    case ElementType::UInt16: return "uint16";
+    case ElementType::Int32: return "int32";
+    case ElementType::UInt32: return "uint32";
+    case ElementType::Int64: return "int64";
+    case ElementType::UInt64: return "uint64";
+    case ElementType::Bool: return "bool";
+    default: return "undefined";
+    }
+  }
+
+  inline size_t ElementCount(const std::vector<int64_t>& shape) {
+    size_t count = 1;
+    for (int64_t dim : shape) {
+      if (dim < 0) {
+        throw std::invalid_argument("InferenceBackend: a tensor shape cannot have free dimensions.");
+      }
+      count *= static_cast<size_t>(dim);
+    }
+    return count;
+  }
+
+  // A dense row-major tensor in host memory.
+  class Tensor {
+  public:
+    Tensor() = default;
+    // A zero-filled tensor.
+    Tensor(ElementType type, const std::vector<int64_t>& shape) {
+      Reset(type, shape);
+      memset(m_storage.data(), 0, m_byteSize);
+    }
+
+    // Changes the type and shape and leaves the contents unspecified. The
+    // buffer only grows, so a tensor reused across evaluations stops
+    // allocating once warm.
+    void Reset(ElementType type, const std::vector<int64_t>& shape) {
+      m_type = type;
+      m_shape = shape;
+      m_byteSize = InferenceBackend::ElementCount(shape) * ElementSize(type);
+      // uint64_t words keep the buffer aligned for every element type.
+      size_t words = (m_byteSize + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+      if (m_storage.size() < words) {
+        m_storage.resize(words);
+      }
+    }
+
+    ElementType Type() const { return m_type; }
+    const std::vector<int64_t>& Shape() const { return m_shape; }
+    size_t ElementCount() const { return ElementSize(m_type) != 0 ? m_byteSize / ElementSize(m_type) : 0; }
+    size_t ByteSize() const { return m_byteSize; }
+
+    void* Data() { return m_storage.data(); }
+    const void* Data() const { return m_storage.data(); }
+
+    // Typed access; T must match Type().
+    template <typename T> T* Data() { return reinterpret_cast<T*>(m_storage.data()); }
+    template <typename T> const T* Data() const { return reinterpret_cast<const T*>(m_storage.data()); }
+
+  private:
+    ElementType m_type = ElementType::Undefined;
+    std::vector<int64_t> m_shape;
+    size_t m_byteSize = 0;
+    std::vector<uint64_t> m_storage;
+  };
+
+  // A model input or output. Free dimensions are -1.
+  struct ValueInfo {
+    std::string name;
+    ElementType type = ElementType::Undefined;
+    std::vector<int64_t> shape;
+  };
+
+  // Evaluation state for one model. A session is used from one thread at a time.
+  class Session {
+  public:
+    virtual ~Session() = default;
+
+    // Copies value in as the named input for the following evaluations.
+    virtual void Bind(const std::string& name, const Tensor& value) = 0;
+    virtual void Evaluate() = 0;
+    // Valid until the next Evaluate.
+    virtual const Tensor& Output(const std::string& name) = 0;
+  };
+
+  class Model {
+  public:
+    virtual ~Model() = default;
+
+    virtual const std::vector<ValueInfo>& Inputs() const = 0;
+    virtual const std::vector<ValueInfo>& Outputs() const = 0;
+    virtual std::unique_ptr<Session> CreateSession() = 0;
+  };
+
+  class Backend {
+  public:
+    virtual ~Backend() = default;
+
+    virtual std::string Name() const = 0;
+    virtual std::unique_ptr<Model> Load(const std::filesystem::path& path) = 0;
+  };
+}
@@ -0,0 +1,323 @@
+#pragma once
+#include <Windows.h>
+#include <shcore.h>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <winrt/Windows.AI.MachineLearning.h>
+#include <winrt/Windows.Storage.Streams.h>
+
+#pragma comment(lib, "shcore.lib")
+
+// Header-only helpers for handing a model to LearningModel::LoadFromStream
+// without first copying it into an InMemoryRandomAccessStream.
+//
+// ModelBytes is a read-only view of a model that is already in the address
+// space: a memory-mapped file, or a resource inside a loaded module (which the
+// loader maps as part of the image). CreateStreamReference wraps the view in a
+// stream whose reads copy straight from the mapping into the caller's buffer,
+// so the model is never resident twice while it is being parsed, and pages
+// that are not touched are never read from disk.
+namespace ModelSource {
+  enum class LoadMode {
+    // LearningModel::LoadFromFilePath.
+    Path,
+    // Read the whole file into an InMemoryRandomAccessStream and load from it.
+    Stream,
+    // Memory-map the file and load from a stream over the mapping.
+    MemoryMap
+  };
+
+  class ModelBytes {
+  public:
+    // Maps the file read-only. When prefetch is set the whole view is
+    // requested from disk up front with large sequential reads (the Windows
+    // equivalent of madvise(MADV_WILLNEED)) instead of one page fault at a
+    // time as the parser touches it.
+    static std::shared_ptr<ModelBytes> MapFile(const std::wstring& path,
+                                               bool prefetch = false) {
+      HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (file == INVALID_HANDLE_VALUE) {
+        winrt::throw_last_error();
+      }
+      LARGE_INTEGER size = {};
+      HANDLE mapping = nullptr;
+      BOOL haveSize = GetFileSizeEx(file, &size);
+      if (haveSize && size.QuadPart > 0) {
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0,
+                                     nullptr);
+      }
+      DWORD error = GetLastError();
+      // The mapping keeps the file open; neither handle is needed once the
+      // view exists.
+      CloseHandle(file);
+      if (haveSize && size.QuadPart == 0) {
+        throw winrt::hresult_invalid_argument(L"The model file is empty.");
+      }
+      if (mapping == nullptr) {
+        winrt::throw_hresult(HRESULT_FROM_WIN32(error));
+      }
+      void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      error = GetLastError();
+      CloseHandle(mapping);
+      if (view == nullptr) {
+        winrt::throw_hresult(HRESULT_FROM_WIN32(error));
+      }
+
+      auto bytes = std::shared_ptr<ModelBytes>(new ModelBytes(
+        static_cast<const uint8_t*>(view), static_cast<uint64_t>(size.QuadPart),
+        view));
+      if (prefetch) {
+        bytes->Prefetch();
+      }
+      return bytes;
+    }
+
+    // Views a resource of a loaded module (nullptr for the executable).
+    static std::shared_ptr<ModelBytes> FromResource(HMODULE module,
+                                                    LPCWSTR name, LPCWSTR type,
+                                                    bool prefetch = false) {
+      HRSRC resource = FindResourceW(module, name, type);
+      if (resource == nullptr) {
+        winrt::throw_last_error();
+      }
+      HGLOBAL loaded = LoadResource(module, resource);
+      if (loaded == nullptr) {
+        winrt::throw_last_error();
+      }
+      // Resource memory is part of the module image and stays valid for as
+      // long as the module is loaded; there is nothing to release.
+      auto bytes = std::shared_ptr<ModelBytes>(new ModelBytes(
+        static_cast<const uint8_t*>(LockResource(loaded)),
+        SizeofResource(module, resource), nullptr));
+      if (prefetch) {
+        bytes->Prefetch();
+      }
+      return bytes;
+    }
+
+    ~ModelBytes() {
+      if (m_view != nullptr) {
+        UnmapViewOfFile(m_view);
+      }
+    }
+
+    ModelBytes(const ModelBytes&) = delete;
+    ModelBytes& operator=(const ModelBytes&) = delete;
+
+    const uint8_t* Data() const { return m_data; }
+    uint64_t Size() const { return m_size; }
+
+    // Best effort: failure only means the pages are faulted in on demand.
+    void Prefetch() const {
+      WIN32_MEMORY_RANGE_ENTRY range = {
+        const_cast<uint8_t*>(m_data), static_cast<SIZE_T>(m_size) };
+      PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+
+  private:
+    ModelBytes(const uint8_t* data, uint64_t size, void* view)
+      : m_data(data), m_size(size), m_view(view) {}
+
+    const uint8_t* m_data;
+    uint64_t m_size;
+    void* m_view;
+  };
+
+  namespace Details {
+    // A read-only IStream over ModelBytes. The shell turns it into a WinRT
+    // IRandomAccessStream with CreateRandomAccessStreamOverStream.
+    class ModelBytesStream : public IStream {
+    public:
+      ModelBytesStream(std::shared_ptr<ModelBytes> bytes, uint64_t position)
+        : m_bytes(std::move(bytes)), m_position(position) {}
+
+      // IUnknown
+      IFACEMETHODIMP QueryInterface(REFIID riid, void** ppv) override {
+        if (ppv == nullptr) {
+          return E_POINTER;
+        }
+        if (riid == __uuidof(IUnknown) || riid == __uuidof(ISequentialStream) ||
+            riid == __uuidof(IStream)) {
+          *ppv = static_cast<IStream*>(this);
+          AddRef();
+          return S_OK;
+        }
+        *ppv = nullptr;
+        return E_NOINTERFACE;
+      }
+      IFACEMETHODIMP_(ULONG) AddRef() override { return ++m_refCount; }
+      IFACEMETHODIMP_(ULONG) Release() override {
+        ULONG refCount = --m_refCount;
+        if (refCount == 0) {
+          delete this;
+        }
+        return refCount;
+      }
+
+      // ISequentialStream
+      IFACEMETHODIMP Read(void* pv, ULONG cb, ULONG* pcbRead) override {
+        if (pv == nullptr) {
+          return STG_E_INVALIDPOINTER;
+        }
+        uint64_t available =
+          m_position < m_bytes->Size() ? m_bytes->Size() - m_position : 0;
+        ULONG count = static_cast<ULONG>(cb < available ? cb : available);
+        if (count > 0) {
+          memcpy(pv, m_bytes->Data() + m_position, count);
+        }
+        m_position += count;
+        if (pcbRead != nullptr) {
+          *pcbRead = count;
+        }
+        return count == cb ? S_OK : S_FALSE;
+      }
+      IFACEMETHODIMP Write(const void*, ULONG, ULONG*) override {
+        return STG_E_ACCESSDENIED;
+      }
+
+      // IStream
+      IFACEMETHODIMP Seek(LARGE_INTEGER move, DWORD origin,
+                          ULARGE_INTEGER* newPosition) override {
+        int64_t base;
+        switch (origin) {
+        case STREAM_SEEK_SET:
+          base = 0;
+          break;
+        case STREAM_SEEK_CUR:
+          base = static_cast<int64_t>(m_position);
+          break;
+        case STREAM_SEEK_END:
+          base = static_cast<int64_t>(m_bytes->Size());
+          break;
+        default:
+          return STG_E_INVALIDFUNCTION;
+        }
+        if (base + move.QuadPart < 0) {
+          return STG_E_INVALIDFUNCTION;
+        }
+        m_position = static_cast<uint64_t>(base + move.QuadPart);
+        if (newPosition != nullptr) {
+          newPosition->QuadPart = m_position;
+        }
+        return S_OK;
+      }
+      IFACEMETHODIMP SetSize(ULARGE_INTEGER) override {
+        return STG_E_ACCESSDENIED;
+      }
+      IFACEMETHODIMP CopyTo(IStream* destination, ULARGE_INTEGER cb,
+                            ULARGE_INTEGER* pcbRead,
+                            ULARGE_INTEGER* pcbWritten) override {
+        if (destination == nullptr) {
+          return STG_E_INVALIDPOINTER;
+        }
+        uint64_t available =
+          m_position < m_bytes->Size() ? m_bytes->Size() - m_position : 0;
+        uint64_t count = cb.QuadPart < available ? cb.QuadPart : available;
+        uint64_t written = 0;
+        HRESULT hr = S_OK;
+        while (written < count && SUCCEEDED(hr)) {
+          ULONG chunk = static_cast<ULONG>(
+            count - written < 0x40000000 ? count - written : 0x40000000);
+          ULONG chunkWritten = 0;
+          hr = destination->Write(m_bytes->Data() + m_position + written, chunk,
+                                  &chunkWritten);
+          written += chunkWritten;
+          if (chunkWritten == 0) {
+            break;
+          }
+        }
+        m_position += written;
+        if (pcbRead != nullptr) {
+          pcbRead->QuadPart = written;
+        }
+        if (pcbWritten != nullptr) {
+          pcbWritten->QuadPart = written;
+        }
+        return hr;
+      }
+      IFACEMETHODIMP Commit(DWORD) override { return S_OK; }
+      IFACEMETHODIMP Revert() override { return STG_E_INVALIDFUNCTION; }
+      IFACEMETHODIMP LockRegion(ULARGE_INTEGER, ULARGE_INTEGER,
+                                DWORD) override {
+        return STG_E_INVALIDFUNCTION;
+      }
+      IFACEMETHODIMP UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER,
+                                  DWORD) override {
+        return STG_E_INVALIDFUNCTION;
+      }
+      IFACEMETHODIMP Stat(STATSTG* statstg, DWORD) override {
+        if (statstg == nullptr) {
+          return STG_E_INVALIDPOINTER;
+        }
+        // The stream has no name, so STATFLAG_NONAME needs no special case.
+        memset(statstg, 0, sizeof(*statstg));
+        statstg->type = STGTY_STREAM;
+        statstg->cbSize.QuadPart = m_bytes->Size();
+        statstg->grfMode = STGM_READ;
+        return S_OK;
+      }
+      IFACEMETHODIMP Clone(IStream** stream) override {
+        if (stream == nullptr) {
+          return STG_E_INVALIDPOINTER;
+        }
+        *stream = new (std::nothrow) ModelBytesStream(m_bytes, m_position);
+        return *stream != nullptr ? S_OK : E_OUTOFMEMORY;
+      }
+
+    private:
+      std::shared_ptr<ModelBytes> m_bytes;
+      uint64_t m_position;
+      std::atomic<ULONG> m_refCount = 1;
+    };
+  }
+
+  inline winrt::Windows::Storage::Streams::IRandomAccessStream CreateStream(
+    std::shared_ptr<ModelBytes> bytes) {
+    winrt::com_ptr<IStream> stream;
+    stream.attach(new Details::ModelBytesStream(std::move(bytes), 0));
+    winrt::Windows::Storage::Streams::IRandomAccessStream randomAccessStream;
+    winrt::check_hresult(CreateRandomAccessStreamOverStream(
+      stream.get(), BSOS_DEFAULT,
+      winrt::guid_of<winrt::Windows::Storage::Streams::IRandomAccessStream>(),
+      winrt::put_abi(randomAccessStream)));
+    return randomAccessStream;
+  }
+
+  inline winrt::Windows::Storage::Streams::IRandomAccessStreamReference
+  CreateStreamReference(std::shared_ptr<ModelBytes> bytes) {
+    return winrt::Windows::Storage::Streams::RandomAccessStreamReference::
+      CreateFromStream(CreateStream(std::move(bytes)));
+  }
+
+  // Loads a model file with the given strategy. prefetch only applies to
+  // LoadMode::MemoryMap.
+  inline winrt::Windows::AI::MachineLearning::LearningModel LoadModel(
+    const std::wstring& path, LoadMode mode, bool prefetch = false) {
+    using namespace winrt::Windows::AI::MachineLearning;
+    using namespace winrt::Windows::Storage::Streams;
+    switch (mode) {
+    case LoadMode::MemoryMap:
+      return LearningModel::LoadFromStream(
+        CreateStreamReference(ModelBytes::MapFile(path, prefetch)));
+    case LoadMode::Stream: {
+      auto file = ModelBytes::MapFile(path);
+      InMemoryRandomAccessStream stream;
+      DataWriter writer(stream);
+      writer.WriteBytes(winrt::array_view<const uint8_t>(
+        file->Data(), file->Data() + file->Size()));
+      writer.StoreAsync().get();
+      writer.DetachStream();
+      stream.Seek(0);
+      return LearningModel::LoadFromStream(
+        RandomAccessStreamReference::CreateFromStream(stream));
+    }
+    default:
+      return LearningModel::LoadFromFilePath(path);
+    }
+  }
+}
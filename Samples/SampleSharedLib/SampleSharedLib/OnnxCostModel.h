@@ -0,0 +1,640 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "OnnxModel.h"
+#include "ReferenceBackend.h"
+
+// Static cost of one inference of an ONNX model: floating point operations,
+// parameter bytes and activation bytes per node and in total, for reading
+// measured evaluate times against the work they stand for.
+//
+// Shapes are inferred by walking the graph in order from the graph inputs and
+// the initializers, with every free input dimension set to one value (batch
+// 1 by default). Small int64 values are folded along the way (Constant,
+// Shape, Gather, Unsqueeze, Concat), which covers the shape arithmetic that
+// exporters put in front of Reshape. A node whose output shapes cannot be
+// inferred takes them from value_info when it is listed there, and is counted
+// in ModelCost::uncostedNodes with no operations.
+//
+// Operations are counted the way ReferenceSession::Profile counts them, two
+// per multiply-add:
+// - Conv, ConvTranspose, Gemm and MatMul: 2 x multiply-adds.
+// - Pooling: one per window element; global pooling: one per input element.
+// - BatchNormalization: 2 per element (scale and shift); InstanceNormalization,
+//   LayerNormalization and LRN: 5 per element; Softmax and LogSoftmax: 3.
+// - Reductions: one per input element.
+// - Other elementwise operators: one per output element.
+// - Layout operators (Reshape, Transpose, Concat, ...) and Cast: none.
+// Activation bytes are what a node reads from other nodes plus what it
+// writes; parameter bytes are the initializers and Constants it reads.
+namespace Onnx {
+  struct NodeCost {
+    // The node name, or its first output when the node has no name.
+    std::string name;
+    std::string opType;
+    double flops = 0;
+    uint64_t parameterBytes = 0;
+    uint64_t activationBytes = 0;
+    // False when the shapes the cost depends on could not be inferred.
+    bool costed = false;
+  };
+
+  struct ModelCost {
+    // One entry per node in graph order.
+    std::vector<NodeCost> nodes;
+    double flops = 0;
+    // Every initializer and Constant once, however many nodes read it.
+    uint64_t parameterBytes = 0;
+    // Sum over nodes, so the traffic of one inference if nothing stays cached.
+    uint64_t activationBytes = 0;
+    size_t uncostedNodes = 0;
+
+    // Operations per byte moved, for placing the model on a roofline.
+    double Intensity() const {
+      double bytes = static_cast<double>(parameterBytes) + static_cast<double>(activationBytes);
+      return bytes > 0 ? flops / bytes : 0;
+    }
+
+    // The count most expensive nodes, heaviest first.
+    std::vector<const NodeCost*> HeaviestNodes(size_t count) const {
+      std::vector<const NodeCost*> heaviest;
+      for (const auto& node : nodes) {
+        heaviest.push_back(&node);
+      }
+      std::stable_sort(heaviest.begin(), heaviest.end(),
+                       [](const NodeCost* a, const NodeCost* b) { return a->flops > b->flops; });
+      heaviest.resize((std::min)(count, heaviest.size()));
+      return heaviest;
+    }
+  };
+
+  class CostModel {
+  public:
+    static ModelCost Estimate(const Model& model, int64_t freeDimension) {
+      CostModel walk(model, freeDimension);
+      ModelCost cost;
+      for (const auto& initializer : model.graph.initializers) {
+        cost.parameterBytes += initializer.ElementCount() * DataTypeSize(initializer.dataType);
+      }
+      for (const auto& node : model.graph.nodes) {
+        NodeCost nodeCost = walk.Visit(node);
+        if (node.opType == "Constant" && node.domain.empty()) {
+          const Value* value = walk.Find(node.outputs.at(0));
+          cost.parameterBytes += value != nullptr ? value->Bytes() : 0;
+        }
+        cost.flops += nodeCost.flops;
+        cost.activationBytes += nodeCost.activationBytes;
+        cost.uncostedNodes += nodeCost.costed ? 0 : 1;
+        cost.nodes.push_back(std::move(nodeCost));
+      }
+      return cost;
+    }
+
+  private:
+    struct Value {
+      DataType type = DataType::Undefined;
+      std::vector<int64_t> dims;
+      // Initializers and Constant outputs.
+      bool parameter = false;
+      // Folded contents of small int64 values.
+      bool folded = false;
+      std::vector<int64_t> contents;
+
+      double Elements() const {
+        return static_cast<double>(InferenceBackend::Reference::Product(dims, 0, dims.size()));
+      }
+      uint64_t Bytes() const { return static_cast<uint64_t>(Elements()) * DataTypeSize(type); }
+    };
+
+    // Values of more elements than this are not folded.
+    static constexpr size_t MaxFoldedElements = 64;
+
+    CostModel(const Model& model, int64_t freeDimension) {
+      for (const auto& info : model.graph.valueInfo) {
+        m_declared[info.name] = &info;
+      }
+      for (const auto& info : model.graph.outputs) {
+        m_declared[info.name] = &info;
+      }
+      for (const auto& initializer : model.graph.initializers) {
+        Value value;
+        value.type = initializer.dataType;
+        value.dims = initializer.dims;
+        value.parameter = true;
+        Fold(initializer, value);
+        m_values[initializer.name] = value;
+      }
+      for (const ValueInfo* input : model.Inputs()) {
+        if (!input->hasShape) {
+          continue;
+        }
+        Value value;
+        value.type = input->elementType;
+        for (const auto& dim : input->shape) {
+          value.dims.push_back(dim.value >= 0 ? dim.value : freeDimension);
+        }
+        m_values[input->name] = value;
+      }
+    }
+
+    static void Fold(const Tensor& tensor, Value& value) {
+      bool integer = tensor.dataType == DataType::Int64 || tensor.dataType == DataType::Int32;
+      if (integer && tensor.HasData() && tensor.ElementCount() <= MaxFoldedElements) {
+        value.contents = tensor.Values<int64_t>();
+        value.folded = true;
+      }
+    }
+
+    const Value* Find(const std::string& name) const {
+      auto found = m_values.find(name);
+      return found != m_values.end() ? &found->second : nullptr;
+    }
+
+    NodeCost Visit(const Node& node) {
+      NodeCost cost;
+      cost.name = !node.name.empty() ? node.name : (node.outputs.empty() ? node.opType : node.outputs[0]);
+      cost.opType = node.domain.empty() || node.domain == "ai.onnx" ? node.opType : node.domain + "." + node.opType;
+      std::vector<const Value*> inputs;
+      bool known = true;
+      for (const auto& name : node.inputs) {
+        const Value* value = name.empty() ? nullptr : Find(name);
+        known = known && (name.empty() || value != nullptr);
+        inputs.push_back(value);
+      }
+      std::vector<Value> outputs;
+      if (known && (node.domain.empty() || node.domain == "ai.onnx")) {
+        try {
+          cost.costed = Infer(node, inputs, outputs, cost.flops);
+        }
+        catch (const std::exception&) {
+          // Shapes the kernels would reject leave the node uncosted.
+          cost.costed = false;
+        }
+      }
+      if (!cost.costed) {
+        cost.flops = 0;
+        outputs.clear();
+        for (const auto& name : node.outputs) {
+          outputs.push_back(Declared(name));
+        }
+      }
+      for (const Value* input : inputs) {
+        if (input != nullptr) {
+          (input->parameter ? cost.parameterBytes : cost.activationBytes) += input->Bytes();
+        }
+      }
+      for (size_t i = 0; i < node.outputs.size() && i < outputs.size(); i++) {
+        if (node.outputs[i].empty() || outputs[i].type == DataType::Undefined) {
+          continue;
+        }
+        if (!outputs[i].parameter) {
+          cost.activationBytes += outputs[i].Bytes();
+        }
+        m_values[node.outputs[i]] = std::move(outputs[i]);
+      }
+      return cost;
+    }
+
+    // A value listed in value_info or the graph outputs with a static shape;
+    // an undefined value otherwise.
+    Value Declared(const std::string& name) const {
+      Value value;
+      auto declared = m_declared.find(name);
+      if (declared == m_declared.end() || !declared->second->hasShape) {
+        return value;
+      }
+      for (const auto& dim : declared->second->shape) {
+        if (dim.value < 0) {
+          return Value();
+        }
+        value.dims.push_back(dim.value);
+      }
+      value.type = declared->second->elementType;
+      return value;
+    }
+
+    static Value Like(const Value& input, std::vector<int64_t> dims) {
+      Value value;
+      value.type = input.type;
+      value.dims = std::move(dims);
+      return value;
+    }
+
+    static std::vector<int64_t> Broadcast(const std::vector<const Value*>& inputs) {
+      std::vector<int64_t> dims;
+      for (const Value* input : inputs) {
+        if (input == nullptr) {
+          continue;
+        }
+        size_t rank = (std::max)(dims.size(), input->dims.size());
+        std::vector<int64_t> merged(rank, 1);
+        for (size_t i = 0; i < rank; i++) {
+          int64_t a = i + dims.size() >= rank ? dims[i + dims.size() - rank] : 1;
+          int64_t b = i + input->dims.size() >= rank ? input->dims[i + input->dims.size() - rank] : 1;
+          if (a != b && a != 1 && b != 1) {
+            throw std::runtime_error("Onnx: operands do not broadcast.");
+          }
+          merged[i] = a == 1 ? b : a;
+        }
+        dims = merged;
+      }
+      return dims;
+    }
+
+    // Output size along each spatial dimension of a convolution or pooling
+    // window over an N-D input; dilation is 1 for pooling.
+    static std::vector<int64_t> WindowOutput(const Node& node, const std::vector<int64_t>& inputDims,
+                                             const std::vector<int64_t>& kernel, bool ceilMode) {
+      size_t spatial = kernel.size();
+      if (inputDims.size() != spatial + 2) {
+        throw std::runtime_error("Onnx: window rank does not match its input.");
+      }
+      std::vector<int64_t> strides = node.Ints("strides", std::vector<int64_t>(spatial, 1));
+      std::vector<int64_t> dilations = node.Ints("dilations", std::vector<int64_t>(spatial, 1));
+      std::vector<int64_t> pads = node.Ints("pads", std::vector<int64_t>(spatial * 2, 0));
+      std::string autoPad = node.String("auto_pad", "NOTSET");
+      if (strides.size() != spatial || dilations.size() != spatial || pads.size() != spatial * 2) {
+        throw std::runtime_error("Onnx: malformed strides, dilations or pads.");
+      }
+      std::vector<int64_t> output(spatial);
+      for (size_t i = 0; i < spatial; i++) {
+        int64_t input = inputDims[2 + i];
+        if (autoPad == "SAME_UPPER" || autoPad == "SAME_LOWER") {
+          output[i] = (input + strides[i] - 1) / strides[i];
+          continue;
+        }
+        int64_t extent = (kernel[i] - 1) * dilations[i] + 1;
+        int64_t span = input + (autoPad == "VALID" ? 0 : pads[i] + pads[i + spatial]) - extent;
+        if (span < 0 || strides[i] <= 0) {
+          throw std::runtime_error("Onnx: window is larger than its padded input.");
+        }
+        output[i] = (ceilMode ? (span + strides[i] - 1) / strides[i] : span / strides[i]) + 1;
+      }
+      return output;
+    }
+
+    static bool IsUnary(const std::string& op) {
+      static const char* const ops[] = { "Relu", "LeakyRelu", "PRelu", "Sigmoid", "HardSigmoid", "HardSwish",
+                                          "Tanh", "Clip", "Elu", "Selu", "Celu", "Gelu", "Softplus", "Softsign",
+                                          "Exp", "Log", "Sqrt", "Reciprocal", "Neg", "Abs", "Erf", "Floor",
+                                          "Ceil", "Round", "Sign", "Sin", "Cos", "Not", "IsNaN", "Mish",
+                                          "ImageScaler", "Affine", "ScaledTanh", "ThresholdedRelu" };
+      return std::find_if(std::begin(ops), std::end(ops), [&op](const char* name) { return op == name; }) !=
+             std::end(ops);
+    }
+
+    static bool IsBinary(const std::string& op) {
+      static const char* const ops[] = { "Add", "Sub", "Mul", "Div", "Pow", "Mod", "Max", "Min", "Sum", "Mean",
+                                          "Equal", "Less", "LessOrEqual", "Greater", "GreaterOrEqual", "And",
+                                          "Or", "Xor", "Where", "BitShift" };
+      return std::find_if(std::begin(ops), std::end(ops), [&op](const char* name) { return op == name; }) !=
+             std::end(ops);
+    }
+
+    static const Value& Input(const std::vector<const Value*>& inputs, size_t i) {
+      if (i >= inputs.size() || inputs[i] == nullptr) {
+        throw std::runtime_error("Onnx: missing input.");
+      }
+      return *inputs[i];
+    }
+
+    // Reads an int64 input, or the attribute it replaced in older opsets.
+    static bool IntsFrom(const Node& node, const std::vector<const Value*>& inputs, size_t i, const char* attribute,
+                         std::vector<int64_t>& values) {
+      if (i < inputs.size() && inputs[i] != nullptr) {
+        values = inputs[i]->contents;
+        return inputs[i]->folded;
+      }
+      values = node.Ints(attribute);
+      return true;
+    }
+
+    // Fills outputs and flops; false when the operator is not modelled or its
+    // shapes depend on values that were not folded.
+    bool Infer(const Node& node, const std::vector<const Value*>& inputs, std::vector<Value>& outputs,
+               double& flops) {
+      using InferenceBackend::Reference::NormalizeAxis;
+      using InferenceBackend::Reference::Product;
+      const std::string& op = node.opType;
+      if (op == "Constant") {
+        const Attribute* attribute = node.Find("value");
+        if (attribute == nullptr || attribute->t == nullptr) {
+          return false;
+        }
+        Value value;
+        value.type = attribute->t->dataType;
+        value.dims = attribute->t->dims;
+        value.parameter = true;
+        Fold(*attribute->t, value);
+        outputs.push_back(value);
+        return true;
+      }
+      const Value& x = Input(inputs, 0);
+      double elements = x.Elements();
+      if (IsUnary(op)) {
+        outputs.push_back(Like(x, x.dims));
+        flops = elements;
+      }
+      else if (IsBinary(op)) {
+        Value y = Like(op == "Where" ? Input(inputs, 1) : x, Broadcast(inputs));
+        if (op == "Equal" || op == "Less" || op == "LessOrEqual" || op == "Greater" || op == "GreaterOrEqual") {
+          y.type = DataType::Bool;
+        }
+        flops = y.Elements() * static_cast<double>((std::max)(inputs.size(), size_t(2)) - 1);
+        outputs.push_back(y);
+      }
+      else if (op == "Identity" || op == "Dropout") {
+        outputs.push_back(Like(x, x.dims));
+        outputs.back().folded = x.folded;
+        outputs.back().contents = x.contents;
+        if (node.outputs.size() > 1) {
+          outputs.push_back(Like(x, x.dims));
+          outputs.back().type = DataType::Bool;
+        }
+      }
+      else if (op == "Cast") {
+        outputs.push_back(Like(x, x.dims));
+        outputs.back().type = static_cast<DataType>(node.Int("to", 0));
+      }
+      else if (op == "Conv" || op == "ConvTranspose") {
+        const Value& w = Input(inputs, 1);
+        if (w.dims.size() != x.dims.size() || w.dims.size() < 3 || x.dims.size() < 3) {
+          return false;
+        }
+        std::vector<int64_t> kernel = node.Ints("kernel_shape", std::vector<int64_t>(w.dims.begin() + 2, w.dims.end()));
+        int64_t group = node.Int("group", 1);
+        double multiplyAdds = w.Elements() / static_cast<double>(w.dims[0]);
+        std::vector<int64_t> dims = { x.dims[0] };
+        if (op == "Conv") {
+          dims.push_back(w.dims[0]);
+          std::vector<int64_t> spatial = WindowOutput(node, x.dims, kernel, false);
+          dims.insert(dims.end(), spatial.begin(), spatial.end());
+          flops = 2.0 * Product(dims, 0, dims.size()) * multiplyAdds;
+        }
+        else {
+          dims.push_back(w.dims[1] * group);
+          std::vector<int64_t> outputShape = node.Ints("output_shape");
+          std::vector<int64_t> strides = node.Ints("strides", std::vector<int64_t>(kernel.size(), 1));
+          std::vector<int64_t> dilations = node.Ints("dilations", std::vector<int64_t>(kernel.size(), 1));
+          std::vector<int64_t> pads = node.Ints("pads", std::vector<int64_t>(kernel.size() * 2, 0));
+          std::vector<int64_t> outputPadding = node.Ints("output_padding", std::vector<int64_t>(kernel.size(), 0));
+          if (strides.size() != kernel.size() || dilations.size() != kernel.size() ||
+              pads.size() != kernel.size() * 2 || outputPadding.size() != kernel.size()) {
+            return false;
+          }
+          for (size_t i = 0; i < kernel.size(); i++) {
+            int64_t full = strides[i] * (x.dims[2 + i] - 1) + outputPadding[i] + (kernel[i] - 1) * dilations[i] + 1;
+            dims.push_back(outputShape.size() == kernel.size() ? outputShape[i]
+                                                               : full - pads[i] - pads[i + kernel.size()]);
+          }
+          // Every input element is multiplied into a kernel of each output channel of its group.
+          flops = 2.0 * elements * multiplyAdds;
+        }
+        outputs.push_back(Like(x, dims));
+      }
+      else if (op == "Gemm") {
+        const Value& b = Input(inputs, 1);
+        if (x.dims.size() != 2 || b.dims.size() != 2) {
+          return false;
+        }
+        bool transposeA = node.Int("transA", 0) != 0;
+        int64_t m = transposeA ? x.dims[1] : x.dims[0];
+        int64_t k = transposeA ? x.dims[0] : x.dims[1];
+        int64_t n = node.Int("transB", 0) != 0 ? b.dims[0] : b.dims[1];
+        outputs.push_back(Like(x, { m, n }));
+        flops = 2.0 * static_cast<double>(m) * static_cast<double>(n) * static_cast<double>(k);
+        flops += inputs.size() > 2 && inputs[2] != nullptr ? static_cast<double>(m * n) : 0;
+      }
+      else if (op == "MatMul") {
+        std::vector<int64_t> a = x.dims;
+        std::vector<int64_t> b = Input(inputs, 1).dims;
+        if (a.empty() || b.empty()) {
+          return false;
+        }
+        bool vectorA = a.size() == 1;
+        bool vectorB = b.size() == 1;
+        if (vectorA) {
+          a.insert(a.begin(), 1);
+        }
+        if (vectorB) {
+          b.push_back(1);
+        }
+        Value batchA = Like(x, std::vector<int64_t>(a.begin(), a.end() - 2));
+        Value batchB = Like(x, std::vector<int64_t>(b.begin(), b.end() - 2));
+        std::vector<int64_t> dims = Broadcast({ &batchA, &batchB });
+        double batch = static_cast<double>(Product(dims, 0, dims.size()));
+        if (!vectorA) {
+          dims.push_back(a[a.size() - 2]);
+        }
+        if (!vectorB) {
+          dims.push_back(b.back());
+        }
+        outputs.push_back(Like(x, dims));
+        flops = 2.0 * batch * static_cast<double>(a[a.size() - 2]) * static_cast<double>(b.back()) *
+                static_cast<double>(a.back());
+      }
+      else if (op == "MaxPool" || op == "AveragePool" || op == "LpPool") {
+        std::vector<int64_t> kernel = node.Ints("kernel_shape");
+        std::vector<int64_t> dims = { x.dims.at(0), x.dims.at(1) };
+        std::vector<int64_t> spatial = WindowOutput(node, x.dims, kernel, node.Int("ceil_mode", 0) != 0);
+        dims.insert(dims.end(), spatial.begin(), spatial.end());
+        outputs.push_back(Like(x, dims));
+        flops = static_cast<double>(Product(dims, 0, dims.size()) * Product(kernel, 0, kernel.size()));
+        if (node.outputs.size() > 1) {
+          outputs.push_back(Like(x, dims));
+          outputs.back().type = DataType::Int64;
+        }
+      }
+      else if (op == "GlobalAveragePool" || op == "GlobalMaxPool" || op == "GlobalLpPool") {
+        if (x.dims.size() < 3) {
+          return false;
+        }
+        std::vector<int64_t> dims(x.dims.size(), 1);
+        dims[0] = x.dims[0];
+        dims[1] = x.dims[1];
+        outputs.push_back(Like(x, dims));
+        flops = elements;
+      }
+      else if (op == "BatchNormalization") {
+        outputs.push_back(Like(x, x.dims));
+        flops = 2.0 * elements;
+      }
+      else if (op == "InstanceNormalization" || op == "LayerNormalization" || op == "LRN") {
+        outputs.push_back(Like(x, x.dims));
+        flops = 5.0 * elements;
+      }
+      else if (op == "Softmax" || op == "LogSoftmax") {
+        outputs.push_back(Like(x, x.dims));
+        flops = 3.0 * elements;
+      }
+      else if (op.compare(0, 6, "Reduce") == 0 || op == "ArgMax" || op == "ArgMin") {
+        // Reduce axes moved from an attribute to an input in opset 18 (ReduceSum in 13).
+        std::vector<int64_t> axes;
+        bool single = op == "ArgMax" || op == "ArgMin";
+        if (single) {
+          axes = { node.Int("axis", 0) };
+        }
+        else if (!IntsFrom(node, inputs, 1, "axes", axes)) {
+          return false;
+        }
+        bool keepDims = node.Int("keepdims", 1) != 0;
+        std::vector<bool> reduced(x.dims.size(), axes.empty() && node.Int("noop_with_empty_axes", 0) == 0);
+        for (int64_t axis : axes) {
+          reduced[NormalizeAxis(axis, x.dims.size())] = true;
+        }
+        std::vector<int64_t> dims;
+        for (size_t i = 0; i < x.dims.size(); i++) {
+          if (!reduced[i] || keepDims) {
+            dims.push_back(reduced[i] ? 1 : x.dims[i]);
+          }
+        }
+        outputs.push_back(Like(x, dims));
+        outputs.back().type = single ? DataType::Int64 : x.type;
+        flops = elements;
+      }
+      else if (op == "Reshape") {
+        std::vector<int64_t> shape;
+        if (!IntsFrom(node, inputs, 1, "shape", shape)) {
+          return false;
+        }
+        outputs.push_back(Like(x, InferenceBackend::Reference::ReshapeTarget(node, x.dims, shape)));
+        outputs.back().folded = x.folded;
+        outputs.back().contents = x.contents;
+      }
+      else if (op == "Flatten") {
+        int64_t axis = node.Int("axis", 1);
+        size_t rank = x.dims.size();
+        axis = axis == static_cast<int64_t>(rank) ? axis : static_cast<int64_t>(NormalizeAxis(axis, rank));
+        outputs.push_back(Like(x, { Product(x.dims, 0, axis), Product(x.dims, axis, rank) }));
+      }
+      else if (op == "Squeeze" || op == "Unsqueeze") {
+        std::vector<int64_t> axes;
+        if (!IntsFrom(node, inputs, 1, "axes", axes)) {
+          return false;
+        }
+        outputs.push_back(Like(x, op == "Squeeze" ? InferenceBackend::Reference::Squeezed(x.dims, axes)
+                                                  : InferenceBackend::Reference::Unsqueezed(x.dims, axes)));
+        outputs.back().folded = x.folded;
+        outputs.back().contents = x.contents;
+      }
+      else if (op == "Transpose") {
+        std::vector<int64_t> perm = node.Ints("perm");
+        std::vector<int64_t> dims(x.dims.rbegin(), x.dims.rend());
+        if (!perm.empty()) {
+          if (perm.size() != x.dims.size()) {
+            return false;
+          }
+          for (size_t i = 0; i < perm.size(); i++) {
+            dims[i] = x.dims[NormalizeAxis(perm[i], x.dims.size())];
+          }
+        }
+        outputs.push_back(Like(x, dims));
+      }
+      else if (op == "Concat") {
+        size_t axis = NormalizeAxis(node.Int("axis", 0), x.dims.size());
+        Value y = Like(x, x.dims);
+        y.dims[axis] = 0;
+        y.folded = true;
+        for (size_t i = 0; i < inputs.size(); i++) {
+          const Value& input = Input(inputs, i);
+          if (input.dims.size() != x.dims.size()) {
+            return false;
+          }
+          y.dims[axis] += input.dims[axis];
+          y.folded = y.folded && input.folded;
+          y.contents.insert(y.contents.end(), input.contents.begin(), input.contents.end());
+        }
+        if (!y.folded || y.dims.size() != 1) {
+          y.folded = false;
+          y.contents.clear();
+        }
+        outputs.push_back(y);
+      }
+      else if (op == "Pad") {
+        // Pads moved from an attribute to an input in opset 11.
+        std::vector<int64_t> pads;
+        if (!IntsFrom(node, inputs, 1, "pads", pads) || pads.size() != x.dims.size() * 2) {
+          return false;
+        }
+        std::vector<int64_t> dims = x.dims;
+        for (size_t i = 0; i < dims.size(); i++) {
+          dims[i] += pads[i] + pads[i + dims.size()];
+        }
+        outputs.push_back(Like(x, dims));
+      }
+      else if (op == "Crop") {
+        // Crop (removed in opset 9) takes left, top, right, bottom borders, or
+        // a height and width from the top left corner.
+        std::vector<int64_t> border = node.Ints("border", { 0, 0, 0, 0 });
+        std::vector<int64_t> scale = node.Ints("scale");
+        if (x.dims.size() != 4 || border.size() != 4) {
+          return false;
+        }
+        std::vector<int64_t> dims = x.dims;
+        dims[2] = scale.size() == 2 ? scale[0] : dims[2] - border[1] - border[3];
+        dims[3] = scale.size() == 2 ? scale[1] : dims[3] - border[0] - border[2];
+        outputs.push_back(Like(x, dims));
+      }
+      else if (op == "Upsample" || op == "Resize") {
+        // Only scales given as an attribute (Upsample before opset 9) and
+        // sizes given as an input (Resize from opset 11) are folded.
+        std::vector<int64_t> sizes;
+        std::vector<float> scales = node.Find("scales") != nullptr ? node.Find("scales")->floats : std::vector<float>();
+        if (op == "Resize" && inputs.size() > 3 && IntsFrom(node, inputs, 3, "sizes", sizes) &&
+            sizes.size() == x.dims.size()) {
+          outputs.push_back(Like(x, sizes));
+        }
+        else if (op == "Upsample" && scales.size() == x.dims.size()) {
+          std::vector<int64_t> dims = x.dims;
+          for (size_t i = 0; i < dims.size(); i++) {
+            dims[i] = static_cast<int64_t>(std::floor(dims[i] * scales[i]));
+          }
+          outputs.push_back(Like(x, dims));
+        }
+        else {
+          return false;
+        }
+        flops = outputs.back().Elements();
+      }
+      else if (op == "Shape") {
+        Value y = Like(x, { static_cast<int64_t>(x.dims.size()) });
+        y.type = DataType::Int64;
+        y.contents = x.dims;
+        y.folded = true;
+        outputs.push_back(y);
+      }
+      else if (op == "Gather") {
+        const Value& indices = Input(inputs, 1);
+        size_t axis = NormalizeAxis(node.Int("axis", 0), x.dims.size());
+        std::vector<int64_t> dims(x.dims.begin(), x.dims.begin() + axis);
+        dims.insert(dims.end(), indices.dims.begin(), indices.dims.end());
+        dims.insert(dims.end(), x.dims.begin() + axis + 1, x.dims.end());
+        Value y = Like(x, dims);
+        if (x.folded && indices.folded && x.dims.size() == 1) {
+          for (int64_t index : indices.contents) {
+            y.contents.push_back(x.contents.at(NormalizeAxis(index, x.contents.size())));
+          }
+          y.folded = true;
+        }
+        outputs.push_back(y);
+      }
+      else {
+        return false;
+      }
+      return true;
+    }
+
+    std::map<std::string, Value> m_values;
+    std::map<std::string, const ValueInfo*> m_declared;
+  };
+
+  // Costs one inference with every free input dimension set to freeDimension.
+  inline ModelCost EstimateCost(const Model& model, int64_t freeDimension = 1) {
+    return CostModel::Estimate(model, freeDimension);
+  }
+}
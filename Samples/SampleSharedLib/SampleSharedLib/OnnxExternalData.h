@@ -0,0 +1,430 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "OnnxInspector.h"
+#include "OnnxModel.h"
+#include "OnnxWriter.h"
+
+// ONNX external data: initializer payloads kept in a file beside the model
+// instead of inside the protobuf.
+//
+// SplitExternalData moves every initializer payload of at least minBytes into
+// one data file, each at an offset aligned to ExternalDataOptions::alignment,
+// and leaves a graph-only .onnx file behind. The default alignment of 64 KiB
+// is the Windows allocation granularity, the finest at which a view of a file
+// can start, so a runtime can map each tensor where it lies rather than read
+// it into memory (ONNX Runtime does this for aligned external tensors). Since
+// the .onnx file then stays small, models beyond the 2 GB protobuf limit can
+// be written at all; WriteSyntheticModel writes one of any size.
+//
+// MapModel is LoadModel without the copy: the model and its data files are
+// mapped read-only and tensor payloads point into the mappings. Mapped pages
+// are backed by the file, so processes mapping the same weights share the
+// physical memory and pages nobody reads are never loaded.
+//
+// Only initializers of the main graph are moved or mapped; tensor attributes
+// and subgraph initializers stay inline. Locations must be relative paths
+// below the directory of the model.
+namespace Onnx {
+  struct ExternalDataOptions {
+    // Initializers whose payload has at least this many bytes are moved out.
+    // Smaller ones would cost more in padding than mapping them saves.
+    uint64_t minBytes = 64 * 1024;
+    // Offset alignment of each payload in the data file.
+    uint64_t alignment = 64 * 1024;
+    // The data file, relative to the model; empty for <model file name>.data.
+    std::string location;
+  };
+
+  struct ExternalDataReport {
+    // The input model with the external data it read.
+    uint64_t inputBytes = 0;
+    uint64_t modelBytes = 0;
+    uint64_t dataBytes = 0;
+    std::string location;
+    size_t externalTensors = 0;
+    size_t inlineTensors = 0;
+  };
+
+  // The external_data entries of a tensor.
+  struct ExternalLocation {
+    std::string location;
+    uint64_t offset = 0;
+    // Without a length the payload size follows from the dims and type.
+    bool hasLength = false;
+    uint64_t length = 0;
+  };
+
+  inline ExternalLocation FindExternalLocation(const Tensor& tensor) {
+    ExternalLocation place;
+    for (const auto& entry : tensor.externalData) {
+      if (entry.first == "location") {
+        place.location = entry.second;
+      }
+      else if (entry.first == "offset") {
+        place.offset = std::stoull(entry.second);
+      }
+      else if (entry.first == "length") {
+        place.hasLength = true;
+        place.length = std::stoull(entry.second);
+      }
+    }
+    return place;
+  }
+
+  // Resolves location against the model directory, refusing paths that would
+  // leave it.
+  inline std::filesystem::path ExternalDataPath(const std::filesystem::path& directory, const std::string& location) {
+    std::filesystem::path relative = std::filesystem::u8path(location);
+    bool escapes = location.empty() || relative.has_root_name() || relative.has_root_directory();
+    for (const auto& part : relative) {
+      escapes = escapes || part == "..";
+    }
+    if (escapes) {
+      throw std::runtime_error("Onnx: external data location " + location + " is outside the model directory.");
+    }
+    return directory / relative;
+  }
+
+  // Maps the data files of the external initializers of model, which was
+  // parsed from a file in directory, and points the payloads into them.
+  inline void MapExternalData(Model& model, const std::filesystem::path& directory) {
+    std::unordered_map<std::string, std::shared_ptr<MappedFile>> files;
+    for (auto& tensor : model.graph.initializers) {
+      if (!tensor.external) {
+        continue;
+      }
+      ExternalLocation place = FindExternalLocation(tensor);
+      auto& file = files[place.location];
+      if (file == nullptr) {
+        file = std::make_shared<MappedFile>(ExternalDataPath(directory, place.location));
+        model.mappings.push_back(file);
+      }
+      uint64_t expected = static_cast<uint64_t>(tensor.ElementCount()) * DataTypeSize(tensor.dataType);
+      uint64_t length = place.hasLength ? place.length : expected;
+      if (expected == 0 || length != expected || place.offset > file->Size() ||
+          length > file->Size() - place.offset) {
+        throw std::runtime_error("Onnx: the external data of " + tensor.name + " does not fit its file.");
+      }
+      tensor.SetData(Bytes{ file->Data() + place.offset, static_cast<size_t>(length) });
+    }
+  }
+
+  // Maps an .onnx file and its external data and parses the model.
+  inline std::unique_ptr<Model> MapModel(const std::filesystem::path& path) {
+    auto file = std::make_shared<MappedFile>(path);
+    auto model = std::make_unique<Model>();
+    model->mappings.push_back(file);
+    ModelParser::ParseModel(Bytes{ file->Data(), file->Size() }, *model);
+    MapExternalData(*model, path.parent_path());
+    return model;
+  }
+
+  // Appends payloads to a data file at aligned offsets.
+  class ExternalDataWriter {
+  public:
+    ExternalDataWriter(std::ostream& stream, uint64_t alignment)
+      : m_stream(stream), m_alignment((std::max)(alignment, uint64_t(1))) {}
+
+    uint64_t Size() const { return m_size; }
+
+    // Pads to the next aligned offset, where the payload written next starts.
+    uint64_t Begin() {
+      static const char zeros[4096] = {};
+      uint64_t padding = (m_alignment - m_size % m_alignment) % m_alignment;
+      while (padding > 0) {
+        size_t count = static_cast<size_t>((std::min)(padding, uint64_t(sizeof(zeros))));
+        Write(zeros, count);
+        padding -= count;
+      }
+      return m_size;
+    }
+
+    void Write(const void* data, size_t size) {
+      if (!m_stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("Onnx: could not write the external data.");
+      }
+      m_size += size;
+    }
+
+  private:
+    std::ostream& m_stream;
+    uint64_t m_alignment;
+    uint64_t m_size = 0;
+  };
+
+  // Writes the external_data entries and data_location of a TensorProto.
+  inline void WriteExternalFields(WireWriter& tensor, const std::string& location, uint64_t offset, uint64_t length) {
+    const std::pair<std::string, std::string> entries[] = { { "location", location },
+                                                            { "offset", std::to_string(offset) },
+                                                            { "length", std::to_string(length) } };
+    for (const auto& entry : entries) {
+      tensor.Message(13, [&](WireWriter& pair) {
+        pair.String(1, entry.first);
+        pair.String(2, entry.second);
+      });
+    }
+    tensor.Int(14, 1);
+  }
+
+  class ExternalDataSplitter {
+  public:
+    // model was parsed from the bytes given to Write, with its external data
+    // mapped.
+    ExternalDataSplitter(const Model& model, const std::string& location, const ExternalDataOptions& options,
+                         ExternalDataReport& report)
+      : m_model(model), m_location(location), m_options(options), m_report(report) {}
+
+    void Write(Bytes bytes, WireWriter& writer, ExternalDataWriter& data) {
+      // Payloads go out before the model so that the graph, whose messages
+      // are written twice, only has to look their offsets up.
+      const auto& initializers = m_model.graph.initializers;
+      m_offsets.assign(initializers.size(), -1);
+      for (size_t i = 0; i < initializers.size(); i++) {
+        const Tensor& tensor = initializers[i];
+        if (tensor.external) {
+          m_report.inputBytes += tensor.ByteSize();
+        }
+        if (tensor.dataType == DataType::String || !tensor.HasData() || tensor.ByteSize() < m_options.minBytes) {
+          m_report.inlineTensors++;
+          continue;
+        }
+        m_offsets[i] = static_cast<int64_t>(data.Begin());
+        data.Write(tensor.Data(), tensor.ByteSize());
+        m_report.externalTensors++;
+      }
+
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        if (reader.Field() == 1 && reader.Type() == WireReader::Varint) {
+          // External data came with IR version 4.
+          int64_t irVersion = reader.ReadInt();
+          writer.Int(1, m_report.externalTensors > 0 ? (std::max)(irVersion, int64_t(4)) : irVersion);
+        }
+        else if (reader.Field() == 7 && reader.Type() == WireReader::LengthDelimited) {
+          Bytes graph = reader.ReadBytes();
+          writer.Message(7, [&](WireWriter& body) { WriteGraph(graph, body); });
+        }
+        else {
+          writer.Copy(reader);
+        }
+      }
+    }
+
+  private:
+    void WriteGraph(Bytes bytes, WireWriter& writer) {
+      size_t index = 0;
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        if (reader.Field() != 5 || reader.Type() != WireReader::LengthDelimited) {
+          writer.Copy(reader);
+          continue;
+        }
+        Bytes tensor = reader.ReadBytes();
+        const Tensor& source = m_model.graph.initializers.at(index);
+        int64_t offset = m_offsets[index++];
+        if (offset < 0 && !source.external) {
+          writer.Bytes(5, tensor.data, tensor.size);
+          continue;
+        }
+        writer.Message(5, [&](WireWriter& body) {
+          WireReader fields(tensor);
+          while (fields.Next()) {
+            switch (fields.Field()) {
+            // The payload fields, external_data and data_location.
+            case 4:
+            case 5:
+            case 7:
+            case 9:
+            case 10:
+            case 11:
+            case 13:
+            case 14: fields.Skip(); break;
+            default: body.Copy(fields); break;
+            }
+          }
+          if (offset >= 0) {
+            WriteExternalFields(body, m_location, static_cast<uint64_t>(offset), source.ByteSize());
+          }
+          else {
+            // A small external tensor comes back inline.
+            body.Bytes(9, source.Data(), source.ByteSize());
+          }
+        });
+      }
+    }
+
+    const Model& m_model;
+    std::string m_location;
+    const ExternalDataOptions& m_options;
+    ExternalDataReport& m_report;
+    // Data file offset of each initializer, or -1 to keep it inline.
+    std::vector<int64_t> m_offsets;
+  };
+
+  namespace Detail {
+    // Creates output and data and runs write(model, data). A failure leaves
+    // neither file behind.
+    template <typename Write>
+    void WriteModelFiles(const std::filesystem::path& output, const std::filesystem::path& dataPath,
+                         const Write& write) {
+      std::ofstream model(output, std::ios::binary | std::ios::trunc);
+      std::ofstream data(dataPath, std::ios::binary | std::ios::trunc);
+      if (!model || !data) {
+        model.close();
+        data.close();
+        std::filesystem::remove(output);
+        std::filesystem::remove(dataPath);
+        throw std::runtime_error("Onnx: could not create " + (model ? dataPath : output).string());
+      }
+      try {
+        write(model, data);
+        model.close();
+        data.close();
+        if (!model || !data) {
+          throw std::runtime_error("Onnx: could not write " + output.string());
+        }
+      }
+      catch (...) {
+        model.close();
+        data.close();
+        std::filesystem::remove(output);
+        std::filesystem::remove(dataPath);
+        throw;
+      }
+    }
+
+    inline std::string DataLocation(const std::filesystem::path& output, const ExternalDataOptions& options) {
+      return options.location.empty() ? output.filename().u8string() + ".data" : options.location;
+    }
+  }
+
+  // Splits the model at input into output and a data file beside it. Neither
+  // may replace the input model or any of its data files.
+  inline ExternalDataReport SplitExternalData(const std::filesystem::path& input, const std::filesystem::path& output,
+                                              const ExternalDataOptions& options = ExternalDataOptions()) {
+    ExternalDataReport report;
+    report.location = Detail::DataLocation(output, options);
+    std::filesystem::path dataPath = ExternalDataPath(output.parent_path(), report.location);
+    std::vector<std::filesystem::path> sources = { input };
+    MappedFile file(input);
+    auto model = ParseModel(file.Data(), file.Size());
+    for (const auto& tensor : model->graph.initializers) {
+      if (tensor.external) {
+        sources.push_back(ExternalDataPath(input.parent_path(), FindExternalLocation(tensor).location));
+      }
+    }
+    for (const auto& source : sources) {
+      for (const auto& target : { output, dataPath }) {
+        if (std::filesystem::exists(target) && std::filesystem::equivalent(source, target)) {
+          throw std::runtime_error("Onnx: the split model cannot replace " + source.string() + ".");
+        }
+      }
+    }
+    MapExternalData(*model, input.parent_path());
+    report.inputBytes = file.Size();
+
+    Detail::WriteModelFiles(output, dataPath, [&](std::ostream& modelStream, std::ostream& dataStream) {
+      WireWriter writer(modelStream);
+      ExternalDataWriter data(dataStream, options.alignment);
+      ExternalDataSplitter(*model, report.location, options, report).Write(Bytes{ file.Data(), file.Size() }, writer,
+                                                                          data);
+      report.modelBytes = writer.Size();
+      report.dataBytes = data.Size();
+    });
+    return report;
+  }
+
+  // Writes output, a chain of MatMuls from input X [1, width] to output Y
+  // with at least weightBytes of float weights, all of them external data.
+  // The weights are pseudo-random with variance 1/width, so values keep their
+  // scale along the chain.
+  inline ExternalDataReport WriteSyntheticModel(const std::filesystem::path& output, uint64_t weightBytes,
+                                                int64_t width = 4096,
+                                                const ExternalDataOptions& options = ExternalDataOptions()) {
+    if (width <= 0) {
+      throw std::runtime_error("Onnx: the synthetic model needs a positive width.");
+    }
+    const uint64_t layerBytes = static_cast<uint64_t>(width) * static_cast<uint64_t>(width) * sizeof(float);
+    const size_t layers = static_cast<size_t>((std::max)((weightBytes + layerBytes - 1) / layerBytes, uint64_t(1)));
+    ExternalDataReport report;
+    report.location = Detail::DataLocation(output, options);
+    std::filesystem::path dataPath = ExternalDataPath(output.parent_path(), report.location);
+
+    Detail::WriteModelFiles(output, dataPath, [&](std::ostream& modelStream, std::ostream& dataStream) {
+      ExternalDataWriter data(dataStream, options.alignment);
+      std::vector<uint64_t> offsets;
+      std::vector<float> row(static_cast<size_t>(width));
+      const float limit = std::sqrt(3.0f / static_cast<float>(width));
+      uint64_t state = 0x853c49e6748fea9bull;
+      for (size_t layer = 0; layer < layers; layer++) {
+        offsets.push_back(data.Begin());
+        for (int64_t r = 0; r < width; r++) {
+          for (float& value : row) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            value = (static_cast<float>(state >> 40) / 16777216.0f * 2 - 1) * limit;
+          }
+          data.Write(row.data(), row.size() * sizeof(float));
+        }
+      }
+
+      auto valueInfo = [&](WireWriter& value, const char* name) {
+        value.String(1, name);
+        value.Message(2, [&](WireWriter& type) {
+          type.Message(1, [&](WireWriter& tensor) {
+            tensor.Int(1, static_cast<int64_t>(DataType::Float));
+            tensor.Message(2, [&](WireWriter& shape) {
+              for (int64_t dim : { int64_t(1), width }) {
+                shape.Message(1, [&](WireWriter& dimension) { dimension.Int(1, dim); });
+              }
+            });
+          });
+        });
+      };
+      WireWriter writer(modelStream);
+      writer.Int(1, 7);
+      writer.String(2, "WinMLRunner");
+      writer.Message(7, [&](WireWriter& graph) {
+        for (size_t layer = 0; layer < layers; layer++) {
+          graph.Message(1, [&](WireWriter& node) {
+            node.String(1, layer == 0 ? "X" : "H" + std::to_string(layer - 1));
+            node.String(1, "W" + std::to_string(layer));
+            node.String(2, layer + 1 == layers ? "Y" : "H" + std::to_string(layer));
+            node.String(3, "MatMul" + std::to_string(layer));
+            node.String(4, "MatMul");
+          });
+        }
+        graph.String(2, "synthetic");
+        for (size_t layer = 0; layer < layers; layer++) {
+          graph.Message(5, [&](WireWriter& tensor) {
+            tensor.Int(1, width);
+            tensor.Int(1, width);
+            tensor.Int(2, static_cast<int64_t>(DataType::Float));
+            tensor.String(8, "W" + std::to_string(layer));
+            WriteExternalFields(tensor, report.location, offsets[layer], layerBytes);
+          });
+        }
+        graph.Message(11, [&](WireWriter& value) { valueInfo(value, "X"); });
+        graph.Message(12, [&](WireWriter& value) { valueInfo(value, "Y"); });
+      });
+      writer.Message(8, [&](WireWriter& opset) {
+        opset.String(1, "");
+        opset.Int(2, 13);
+      });
+      report.modelBytes = writer.Size();
+      report.dataBytes = data.Size();
+      report.externalTensors = layers;
+    });
+    return report;
+  }
+}
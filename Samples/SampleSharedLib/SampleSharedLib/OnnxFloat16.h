@@ -0,0 +1,677 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "OnnxInspector.h"
+#include "OnnxModel.h"
+#include "OnnxWriter.h"
+#include "TensorConvert.h"
+
+// Offline conversion of an fp32 ONNX model to fp16.
+//
+// Float initializers, Constant and other tensor attributes, Casts to float
+// and the element type of every float value are rewritten to float16.
+// Operators that are numerically fragile or have no fp16 kernel stay fp32:
+// they get a Cast to float in front of each float input and a Cast back to
+// float16 behind each float output. Nodes outside the default domain always
+// stay fp32.
+//
+// The input is memory-mapped and copied field by field through a WireWriter,
+// converting tensor payloads in fixed-size chunks, so memory use does not
+// grow with the size of the weights. Float payloads stored as external data
+// are read the same way and written inline. Subgraphs (If, Loop, Scan) are
+// converted wholesale; the operator blocklist applies to the main graph.
+namespace Onnx {
+  struct Float16Options {
+    // Default-domain operators kept in fp32.
+    std::vector<std::string> keepOps = { "NonMaxSuppression", "TopK", "RoiAlign", "Resize", "Upsample", "Range",
+      "CumSum", "RandomUniform", "RandomNormal", "RandomUniformLike", "RandomNormalLike", "Multinomial",
+      "QuantizeLinear", "DequantizeLinear", "DynamicQuantizeLinear" };
+    // Keeps float graph inputs and outputs fp32, with Casts at the edges of
+    // the graph, so callers bind the same types as before.
+    bool keepIoTypes = false;
+  };
+
+  struct Float16Report {
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+    size_t convertedTensors = 0;
+    // Float initializers only read by fp32 nodes, left as they were.
+    size_t keptTensors = 0;
+    size_t keptNodes = 0;
+    size_t insertedCasts = 0;
+    // Finite values beyond the float16 range, clamped to +-65504.
+    uint64_t saturatedValues = 0;
+  };
+
+  class Float16Converter {
+  public:
+    Float16Converter(const Model& model, const std::filesystem::path& directory, const Float16Options& options,
+                     Float16Report& report)
+      : m_model(model), m_directory(directory), m_options(options), m_report(report) {
+      Analyze();
+    }
+
+    // Writes the converted form of the ModelProto bytes model was parsed from.
+    void Write(Bytes bytes, WireWriter& writer) {
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        if (reader.Field() == 7 && reader.Type() == WireReader::LengthDelimited) {
+          Bytes graph = reader.ReadBytes();
+          writer.Message(7, [&](WireWriter& body) { WriteGraph(graph, body, true); });
+        }
+        else {
+          writer.Copy(reader);
+        }
+      }
+    }
+
+  private:
+    static constexpr size_t ChunkElements = 16384;
+
+    struct Cast {
+      std::string input;
+      std::string output;
+      std::string name;
+      DataType to;
+    };
+
+    // Input and output names of a node kept in fp32, and the Casts around it.
+    struct KeptNode {
+      std::vector<std::string> inputs;
+      std::vector<std::string> outputs;
+      std::vector<Cast> before;
+      std::vector<Cast> after;
+    };
+
+    void Analyze() {
+      const Graph& graph = m_model.graph;
+      for (const auto& initializer : graph.initializers) {
+        m_types[initializer.name] = initializer.dataType;
+        m_names.insert(initializer.name);
+      }
+      for (const auto* values : { &graph.inputs, &graph.outputs, &graph.valueInfo }) {
+        for (const auto& value : *values) {
+          if (value.elementType != DataType::Undefined) {
+            m_types.emplace(value.name, value.elementType);
+          }
+          m_names.insert(value.name);
+        }
+      }
+
+      bool hasSubgraphs = false;
+      std::unordered_set<std::string> produced;
+      std::unordered_map<std::string, std::pair<size_t, size_t>> readers;
+      for (const auto& node : graph.nodes) {
+        m_names.insert(node.name);
+        for (size_t i = 0; i < node.outputs.size(); i++) {
+          const std::string& output = node.outputs[i];
+          m_names.insert(output);
+          produced.insert(output);
+          DataType type = OutputType(node, i);
+          if (!output.empty() && type != DataType::Undefined) {
+            m_types.emplace(output, type);
+          }
+        }
+        bool kept = Keeps(node);
+        for (const auto& input : node.inputs) {
+          m_names.insert(input);
+          auto& count = readers[input];
+          count.first++;
+          count.second += kept ? 1 : 0;
+        }
+        for (const auto& attribute : node.attributes) {
+          hasSubgraphs |= attribute.type == AttributeType::Graph || attribute.type == AttributeType::Graphs;
+        }
+      }
+
+      // Subgraphs may read initializers of the main graph by name, and they are
+      // not decoded, so with subgraphs present every initializer is converted.
+      for (const auto& initializer : graph.initializers) {
+        auto count = readers.find(initializer.name);
+        bool isOutput = std::any_of(graph.outputs.begin(), graph.outputs.end(),
+                                    [&](const ValueInfo& output) { return output.name == initializer.name; });
+        if (initializer.dataType == DataType::Float && !hasSubgraphs && !isOutput && count != readers.end() &&
+            count->second.first == count->second.second) {
+          m_keptInitializers.insert(initializer.name);
+        }
+      }
+      m_report.keptTensors = m_keptInitializers.size();
+
+      if (m_options.keepIoTypes) {
+        for (const auto& input : graph.inputs) {
+          if (IsFloat(input.name) && m_model.FindInitializer(input.name) == nullptr) {
+            m_fp32Inputs.insert(input.name);
+            std::string renamed = Unique(input.name + "_fp16");
+            m_renames[input.name] = renamed;
+            m_front.push_back({ input.name, renamed, Unique(renamed + "_Cast"), DataType::Float16 });
+          }
+        }
+        for (const auto& output : graph.outputs) {
+          if (IsFloat(output.name) && produced.count(output.name) != 0 && m_renames.count(output.name) == 0) {
+            std::string renamed = Unique(output.name + "_fp16");
+            m_renames[output.name] = renamed;
+            m_back.push_back({ renamed, output.name, Unique(output.name + "_Cast"), DataType::Float });
+          }
+        }
+      }
+
+      // fp32 copies of float values, made once and shared by every kept node
+      // that reads them.
+      std::unordered_map<std::string, std::string> fp32Copies;
+      for (size_t index = 0; index < graph.nodes.size(); index++) {
+        const Node& node = graph.nodes[index];
+        if (!Keeps(node)) {
+          continue;
+        }
+        KeptNode& kept = m_keptNodes[index];
+        for (const auto& input : node.inputs) {
+          if (m_keptInitializers.count(input) != 0 || m_fp32Inputs.count(input) != 0) {
+            kept.inputs.push_back(input);
+            continue;
+          }
+          if (input.empty() || !IsFloat(input)) {
+            kept.inputs.push_back(Renamed(input));
+            continue;
+          }
+          auto copy = fp32Copies.find(input);
+          if (copy == fp32Copies.end()) {
+            std::string name = Unique(input + "_fp32");
+            kept.before.push_back({ Renamed(input), name, Unique(name + "_Cast"), DataType::Float });
+            copy = fp32Copies.emplace(input, name).first;
+          }
+          kept.inputs.push_back(copy->second);
+        }
+        for (const auto& output : node.outputs) {
+          if (output.empty() || !IsFloat(output)) {
+            kept.outputs.push_back(output.empty() ? output : Renamed(output));
+            continue;
+          }
+          std::string name = Unique(output + "_fp32");
+          kept.after.push_back({ name, Renamed(output), Unique(output + "_Cast"), DataType::Float16 });
+          kept.outputs.push_back(name);
+          fp32Copies[output] = name;
+        }
+        m_report.keptNodes++;
+        m_report.insertedCasts += kept.before.size() + kept.after.size();
+      }
+      m_report.insertedCasts += m_front.size() + m_back.size();
+    }
+
+    bool Keeps(const Node& node) const {
+      if (!node.domain.empty() && node.domain != "ai.onnx") {
+        return true;
+      }
+      return std::find(m_options.keepOps.begin(), m_options.keepOps.end(), node.opType) != m_options.keepOps.end();
+    }
+
+    bool IsFloat(const std::string& name) const {
+      auto type = m_types.find(name);
+      return type != m_types.end() && type->second == DataType::Float;
+    }
+
+    DataType TypeOf(const Node& node, size_t input) const {
+      if (input >= node.inputs.size()) {
+        return DataType::Undefined;
+      }
+      auto type = m_types.find(node.inputs[input]);
+      return type != m_types.end() ? type->second : DataType::Undefined;
+    }
+
+    // The element type of an output that has no declared type.
+    DataType OutputType(const Node& node, size_t output) const {
+      const std::string& op = node.opType;
+      if (node.domain == "ai.onnx.ml") {
+        return DataType::Undefined;
+      }
+      if (op == "Cast") {
+        return static_cast<DataType>(node.Int("to", 0));
+      }
+      if (op == "Constant" || op == "ConstantOfShape") {
+        for (const auto& attribute : node.attributes) {
+          if (attribute.name == "value" && attribute.t) {
+            return attribute.t->dataType;
+          }
+          if (attribute.name == "value_float" || attribute.name == "value_floats") {
+            return DataType::Float;
+          }
+          if (attribute.name == "value_int" || attribute.name == "value_ints") {
+            return DataType::Int64;
+          }
+        }
+        return op == "ConstantOfShape" ? DataType::Float : DataType::Undefined;
+      }
+      if (op == "Shape" || op == "Size" || op == "NonZero" || op == "ArgMax" || op == "ArgMin" ||
+          op == "NonMaxSuppression" || (op == "TopK" && output == 1) || (op == "MaxPool" && output == 1) ||
+          (op == "Unique" && output > 0)) {
+        return DataType::Int64;
+      }
+      if (op == "Equal" || op == "Less" || op == "LessOrEqual" || op == "Greater" || op == "GreaterOrEqual" ||
+          op == "Not" || op == "And" || op == "Or" || op == "Xor" || op == "IsNaN" || op == "IsInf") {
+        return DataType::Bool;
+      }
+      if (op == "QuantizeLinear") {
+        return node.inputs.size() > 2 ? TypeOf(node, 2) : DataType::UInt8;
+      }
+      if (op == "DynamicQuantizeLinear") {
+        return output == 1 ? DataType::Float : DataType::UInt8;
+      }
+      if (op == "DequantizeLinear") {
+        return TypeOf(node, 1);
+      }
+      if (op == "RandomUniform" || op == "RandomNormal") {
+        return static_cast<DataType>(node.Int("dtype", static_cast<int64_t>(DataType::Float)));
+      }
+      if (op == "RandomUniformLike" || op == "RandomNormalLike" || op == "EyeLike") {
+        const Attribute* dtype = node.Find("dtype");
+        return dtype != nullptr ? static_cast<DataType>(dtype->i) : TypeOf(node, 0);
+      }
+      if (op == "Multinomial") {
+        return static_cast<DataType>(node.Int("dtype", static_cast<int64_t>(DataType::Int32)));
+      }
+      if (op == "Where") {
+        return TypeOf(node, 1);
+      }
+      if (op == "OneHot") {
+        return TypeOf(node, 2);
+      }
+      if (op == "If" || op == "Loop" || op == "Scan") {
+        return DataType::Undefined;
+      }
+      return TypeOf(node, 0);
+    }
+
+    std::string Unique(const std::string& base) {
+      std::string name = base;
+      for (int suffix = 1; m_names.count(name) != 0; suffix++) {
+        name = base + "_" + std::to_string(suffix);
+      }
+      m_names.insert(name);
+      return name;
+    }
+
+    std::string Renamed(const std::string& name) const {
+      auto renamed = m_renames.find(name);
+      return renamed != m_renames.end() ? renamed->second : name;
+    }
+
+    void WriteGraph(Bytes bytes, WireWriter& writer, bool main) {
+      WireReader reader(bytes);
+      size_t nodeIndex = 0;
+      bool frontWritten = !main;
+      while (reader.Next()) {
+        uint32_t field = reader.Field();
+        if (reader.Type() != WireReader::LengthDelimited) {
+          writer.Copy(reader);
+          continue;
+        }
+        switch (field) {
+        case 1: {
+          Bytes node = reader.ReadBytes();
+          if (!frontWritten) {
+            WriteCasts(m_front, writer);
+            frontWritten = true;
+          }
+          auto kept = main ? m_keptNodes.find(nodeIndex++) : m_keptNodes.end();
+          WriteNode(node, kept != m_keptNodes.end() ? &kept->second : nullptr, writer);
+          break;
+        }
+        case 5: WriteTensor(5, reader.ReadBytes(), writer, main); break;
+        case 11:
+        case 12:
+        case 13: {
+          Bytes value = reader.ReadBytes();
+          std::string name = ModelParser::ParseValueInfo(value).name;
+          bool keep = main && (m_keptInitializers.count(name) != 0 ||
+                               (m_options.keepIoTypes && field != 13 && m_model.FindInitializer(name) == nullptr));
+          if (keep) {
+            writer.Bytes(field, value.data, value.size);
+          }
+          else {
+            WriteValueInfo(field, value, writer);
+          }
+          break;
+        }
+        default: writer.Copy(reader); break;
+        }
+      }
+      if (!frontWritten) {
+        WriteCasts(m_front, writer);
+      }
+      if (main) {
+        WriteCasts(m_back, writer);
+      }
+    }
+
+    static void WriteCasts(const std::vector<Cast>& casts, WireWriter& writer) {
+      for (const auto& cast : casts) {
+        writer.Message(1, [&](WireWriter& node) {
+          node.String(1, cast.input);
+          node.String(2, cast.output);
+          node.String(3, cast.name);
+          node.String(4, "Cast");
+          node.Message(5, [&](WireWriter& attribute) {
+            attribute.String(1, "to");
+            attribute.Int(3, static_cast<int64_t>(cast.to));
+            attribute.Int(20, static_cast<int64_t>(AttributeType::Int));
+          });
+        });
+      }
+    }
+
+    void WriteNode(Bytes bytes, const KeptNode* kept, WireWriter& writer) {
+      std::string opType;
+      bool hasValue = false;
+      WireReader scan(bytes);
+      while (scan.Next()) {
+        if (scan.Field() == 4) {
+          opType = scan.ReadBytes().String();
+        }
+        else if (scan.Field() == 5) {
+          hasValue |= ModelParser::ParseAttribute(scan.ReadBytes()).name == "value";
+        }
+        else {
+          scan.Skip();
+        }
+      }
+
+      if (kept != nullptr) {
+        WriteCasts(kept->before, writer);
+      }
+      writer.Message(1, [&](WireWriter& node) {
+        size_t input = 0;
+        size_t output = 0;
+        WireReader reader(bytes);
+        while (reader.Next()) {
+          switch (reader.Field()) {
+          case 1: {
+            std::string name = reader.ReadBytes().String();
+            node.String(1, kept != nullptr ? kept->inputs.at(input++) : Renamed(name));
+            break;
+          }
+          case 2: {
+            std::string name = reader.ReadBytes().String();
+            node.String(2, kept != nullptr ? kept->outputs.at(output++) : Renamed(name));
+            break;
+          }
+          case 5:
+            if (kept != nullptr) {
+              node.Copy(reader);
+            }
+            else {
+              WriteAttribute(reader.ReadBytes(), opType, node);
+            }
+            break;
+          default: node.Copy(reader); break;
+          }
+        }
+        // Without a value ConstantOfShape produces float zeros.
+        if (kept == nullptr && opType == "ConstantOfShape" && !hasValue) {
+          node.Message(5, [&](WireWriter& attribute) {
+            const uint16_t zero = 0;
+            attribute.String(1, "value");
+            attribute.Message(5, [&](WireWriter& tensor) {
+              tensor.Int(1, 1);
+              tensor.Int(2, static_cast<int64_t>(DataType::Float16));
+              tensor.Bytes(9, &zero, sizeof(zero));
+            });
+            attribute.Int(20, static_cast<int64_t>(AttributeType::Tensor));
+          });
+        }
+      });
+      if (kept != nullptr) {
+        WriteCasts(kept->after, writer);
+      }
+    }
+
+    void WriteAttribute(Bytes bytes, const std::string& opType, WireWriter& writer) {
+      std::string name = ModelParser::ParseAttribute(bytes).name;
+      // Casts to float and the dtype of EyeLike and the random generators.
+      bool typeAttribute = (opType == "Cast" && name == "to") || name == "dtype";
+      writer.Message(5, [&](WireWriter& attribute) {
+        WireReader reader(bytes);
+        while (reader.Next()) {
+          uint32_t field = reader.Field();
+          if (field == 3 && typeAttribute && reader.Type() == WireReader::Varint) {
+            int64_t type = reader.ReadInt();
+            attribute.Int(3, type == static_cast<int64_t>(DataType::Float) ? static_cast<int64_t>(DataType::Float16)
+                                                                             : type);
+          }
+          else if ((field == 5 || field == 10) && reader.Type() == WireReader::LengthDelimited) {
+            WriteTensor(field, reader.ReadBytes(), attribute, false);
+          }
+          else if ((field == 6 || field == 11) && reader.Type() == WireReader::LengthDelimited) {
+            Bytes graph = reader.ReadBytes();
+            attribute.Message(field, [&](WireWriter& body) { WriteGraph(graph, body, false); });
+          }
+          else {
+            attribute.Copy(reader);
+          }
+        }
+      });
+    }
+
+    void WriteTensor(uint32_t field, Bytes bytes, WireWriter& writer, bool main) {
+      std::string name;
+      DataType dataType = DataType::Undefined;
+      std::vector<int64_t> dims;
+      Bytes raw;
+      std::vector<float> floatData;
+      std::vector<std::pair<std::string, std::string>> externalData;
+      bool external = false;
+      WireReader scan(bytes);
+      while (scan.Next()) {
+        switch (scan.Field()) {
+        case 1: scan.ReadInts(dims); break;
+        case 2: dataType = static_cast<DataType>(scan.ReadInt()); break;
+        case 4: scan.ReadFixed(floatData); break;
+        case 8: name = scan.ReadBytes().String(); break;
+        case 9: raw = scan.ReadBytes(); break;
+        case 13: externalData.push_back(ModelParser::ParseStringPair(scan.ReadBytes())); break;
+        case 14: external = scan.ReadInt() == 1; break;
+        default: scan.Skip(); break;
+        }
+      }
+      if (dataType != DataType::Float || (main && m_keptInitializers.count(name) != 0)) {
+        writer.Bytes(field, bytes.data, bytes.size);
+        return;
+      }
+
+      size_t count = raw.data != nullptr ? raw.size / sizeof(float) : floatData.size();
+      if (external) {
+        count = 1;
+        for (int64_t dim : dims) {
+          count *= static_cast<size_t>(dim);
+        }
+      }
+      writer.Message(field, [&](WireWriter& tensor) {
+        WireReader reader(bytes);
+        while (reader.Next()) {
+          switch (reader.Field()) {
+          case 2:
+            reader.Skip();
+            tensor.Int(2, static_cast<int64_t>(DataType::Float16));
+            break;
+          case 4:
+          case 9:
+          case 13:
+          case 14: reader.Skip(); break;
+          default: tensor.Copy(reader); break;
+          }
+        }
+        if (count == 0) {
+          return;
+        }
+        tensor.BeginBytes(9, count * sizeof(uint16_t));
+        if (tensor.Counting()) {
+          tensor.Raw(nullptr, count * sizeof(uint16_t));
+          return;
+        }
+        if (external) {
+          WriteExternalPayload(name, externalData, count, tensor);
+        }
+        else {
+          const uint8_t* source = raw.data != nullptr ? raw.data : reinterpret_cast<const uint8_t*>(floatData.data());
+          WritePayload(count, tensor, [&](float* chunk, size_t offset, size_t size) {
+            memcpy(chunk, source + offset * sizeof(float), size * sizeof(float));
+          });
+        }
+        m_report.convertedTensors++;
+      });
+    }
+
+    void WriteExternalPayload(const std::string& name, const std::vector<std::pair<std::string, std::string>>& entries,
+                              size_t count, WireWriter& writer) {
+      std::string location;
+      uint64_t start = 0;
+      for (const auto& entry : entries) {
+        if (entry.first == "location") {
+          location = entry.second;
+        }
+        else if (entry.first == "offset") {
+          start = std::stoull(entry.second);
+        }
+      }
+      std::ifstream file(m_directory / std::filesystem::u8path(location), std::ios::binary);
+      if (location.empty() || !file || !file.seekg(static_cast<std::streamoff>(start))) {
+        throw std::runtime_error("Onnx: could not open the external data of " + name + ".");
+      }
+      WritePayload(count, writer, [&](float* chunk, size_t, size_t size) {
+        if (!file.read(reinterpret_cast<char*>(chunk), static_cast<std::streamsize>(size * sizeof(float)))) {
+          throw std::runtime_error("Onnx: the external data of " + name + " is truncated.");
+        }
+      });
+    }
+
+    // Converts count floats that read(chunk, offset, size) supplies in order.
+    template <typename Read> void WritePayload(size_t count, WireWriter& writer, const Read& read) {
+      std::vector<float> chunk((std::min)(count, ChunkElements));
+      std::vector<uint16_t> halves(chunk.size());
+      for (size_t offset = 0; offset < count; offset += chunk.size()) {
+        size_t size = (std::min)(chunk.size(), count - offset);
+        read(chunk.data(), offset, size);
+        for (size_t i = 0; i < size; i++) {
+          if (std::isfinite(chunk[i]) && std::fabs(chunk[i]) >= 65520.0f) {
+            chunk[i] = std::copysign(65504.0f, chunk[i]);
+            m_report.saturatedValues++;
+          }
+        }
+        TensorConvert::ToHalf(chunk.data(), halves.data(), size);
+        writer.Raw(halves.data(), size * sizeof(uint16_t));
+      }
+    }
+
+    void WriteValueInfo(uint32_t field, Bytes bytes, WireWriter& writer) {
+      writer.Message(field, [&](WireWriter& value) {
+        WireReader reader(bytes);
+        while (reader.Next()) {
+          if (reader.Field() == 2 && reader.Type() == WireReader::LengthDelimited) {
+            Bytes type = reader.ReadBytes();
+            value.Message(2, [&](WireWriter& body) { WriteType(type, body); });
+          }
+          else {
+            value.Copy(reader);
+          }
+        }
+      });
+    }
+
+    // TypeProto: tensor and sparse tensor element types, and the element
+    // types nested in sequences, maps and optionals.
+    static void WriteType(Bytes bytes, WireWriter& writer) {
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        uint32_t field = reader.Field();
+        if (reader.Type() != WireReader::LengthDelimited || (field != 1 && field != 4 && field != 5 && field != 8 &&
+                                                             field != 9)) {
+          writer.Copy(reader);
+          continue;
+        }
+        Bytes inner = reader.ReadBytes();
+        writer.Message(field, [&](WireWriter& body) {
+          WireReader nested(inner);
+          while (nested.Next()) {
+            bool tensor = field == 1 || field == 8;
+            if (tensor && nested.Field() == 1 && nested.Type() == WireReader::Varint) {
+              int64_t type = nested.ReadInt();
+              body.Int(1, type == static_cast<int64_t>(DataType::Float) ? static_cast<int64_t>(DataType::Float16)
+                                                                        : type);
+            }
+            else if (!tensor && nested.Field() == (field == 5 ? 2u : 1u) &&
+                     nested.Type() == WireReader::LengthDelimited) {
+              Bytes element = nested.ReadBytes();
+              body.Message(nested.Field(), [&](WireWriter& type) { WriteType(element, type); });
+            }
+            else {
+              body.Copy(nested);
+            }
+          }
+        });
+      }
+    }
+
+    const Model& m_model;
+    std::filesystem::path m_directory;
+    const Float16Options& m_options;
+    Float16Report& m_report;
+    std::unordered_map<std::string, DataType> m_types;
+    std::unordered_set<std::string> m_names;
+    std::unordered_set<std::string> m_keptInitializers;
+    std::unordered_set<std::string> m_fp32Inputs;
+    std::unordered_map<std::string, std::string> m_renames;
+    std::unordered_map<size_t, KeptNode> m_keptNodes;
+    std::vector<Cast> m_front;
+    std::vector<Cast> m_back;
+  };
+
+  // Converts the serialized model in data and writes the result to output.
+  // External data locations are relative to directory.
+  inline Float16Report ConvertToFloat16(const uint8_t* data, size_t size, std::ostream& output,
+                                        const std::filesystem::path& directory = std::filesystem::path(),
+                                        const Float16Options& options = Float16Options()) {
+    auto model = ParseModel(data, size);
+    Float16Report report;
+    report.inputBytes = size;
+    Float16Converter converter(*model, directory, options, report);
+    WireWriter writer(output);
+    converter.Write(Bytes{ data, size }, writer);
+    report.outputBytes = writer.Size();
+    return report;
+  }
+
+  // Converts the model at input and writes the result to output, which must
+  // be a different file. A failed conversion leaves no output behind.
+  inline Float16Report ConvertToFloat16(const std::filesystem::path& input, const std::filesystem::path& output,
+                                        const Float16Options& options = Float16Options()) {
+    if (std::filesystem::exists(output) && std::filesystem::equivalent(input, output)) {
+      throw std::runtime_error("Onnx: the converted model cannot replace " + input.string() + ".");
+    }
+    MappedFile file(input);
+    std::ofstream stream(output, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+      throw std::runtime_error("Onnx: could not create " + output.string());
+    }
+    try {
+      Float16Report report = ConvertToFloat16(file.Data(), file.Size(), stream, input.parent_path(), options);
+      stream.close();
+      if (!stream) {
+        throw std::runtime_error("Onnx: could not write " + output.string());
+      }
+      return report;
+    }
+    catch (...) {
+      stream.close();
+      std::filesystem::remove(output);
+      throw;
+    }
+  }
+}
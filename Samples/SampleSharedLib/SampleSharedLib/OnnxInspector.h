@@ -0,0 +1,502 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "OnnxModel.h"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Summarizes an .onnx file without loading it: metadata, opsets, graph
+// inputs and outputs, an operator histogram, element type usage and the size
+// of every initializer.
+//
+// The file is memory-mapped and walked field by field with the WireReader of
+// OnnxModel.h. Tensor payloads and other large fields are stepped over by
+// their length prefix without being read, so only the pages holding message
+// headers are faulted in and a model of hundreds of megabytes is inspected in
+// milliseconds. Nodes and initializers of subgraphs (If, Loop, Scan) are
+// counted with those of the main graph. Malformed files, including protobuf
+// messages that are not a ModelProto, are reported as std::runtime_error.
+namespace Onnx {
+  // A read-only mapping of a whole file. An empty file maps to no data.
+  class MappedFile {
+  public:
+    explicit MappedFile(const std::filesystem::path& path) {
+#if defined(_WIN32)
+      HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Onnx: could not open " + path.string());
+      }
+      LARGE_INTEGER size = {};
+      if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        throw std::runtime_error("Onnx: could not get the size of " + path.string());
+      }
+      m_size = static_cast<size_t>(size.QuadPart);
+      // The view keeps the file open; neither handle is needed once it exists.
+      HANDLE mapping = m_size > 0 ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+      CloseHandle(file);
+      if (m_size > 0) {
+        m_view = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (mapping != nullptr) {
+          CloseHandle(mapping);
+        }
+        if (m_view == nullptr) {
+          throw std::runtime_error("Onnx: could not map " + path.string());
+        }
+      }
+#else
+      int file = open(path.c_str(), O_RDONLY);
+      if (file < 0) {
+        throw std::runtime_error("Onnx: could not open " + path.string());
+      }
+      struct stat info;
+      if (fstat(file, &info) != 0) {
+        close(file);
+        throw std::runtime_error("Onnx: could not get the size of " + path.string());
+      }
+      m_size = static_cast<size_t>(info.st_size);
+      void* view = m_size > 0 ? mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0) : nullptr;
+      close(file);
+      if (view == MAP_FAILED) {
+        throw std::runtime_error("Onnx: could not map " + path.string());
+      }
+      m_view = view;
+#endif
+    }
+
+    ~MappedFile() {
+      if (m_view != nullptr) {
+#if defined(_WIN32)
+        UnmapViewOfFile(m_view);
+#else
+        munmap(m_view, m_size);
+#endif
+      }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* Data() const { return static_cast<const uint8_t*>(m_view); }
+    size_t Size() const { return m_size; }
+
+  private:
+    void* m_view = nullptr;
+    size_t m_size = 0;
+  };
+
+  struct InitializerSummary {
+    std::string name;
+    DataType dataType = DataType::Undefined;
+    std::vector<int64_t> dims;
+    // The payload size implied by dims and dataType, or the length recorded
+    // for external data.
+    uint64_t byteSize = 0;
+    bool external = false;
+  };
+
+  struct ValueSummary {
+    std::string name;
+    // For example "float16[1,3,224,224]", "float[N,?]" or
+    // "seq(map(int64,float))".
+    std::string type;
+    // Element types anywhere in the type, map keys and sequence elements
+    // included.
+    std::vector<DataType> elementTypes;
+  };
+
+  struct ModelSummary {
+    uint64_t fileSize = 0;
+    int64_t irVersion = 0;
+    std::string producerName;
+    std::string producerVersion;
+    std::string domain;
+    int64_t modelVersion = 0;
+    std::string docString;
+    std::vector<std::pair<std::string, std::string>> metadata;
+    std::vector<OpsetImport> opsetImports;
+    bool hasGraph = false;
+    std::string graphName;
+    // Graph inputs that are not initializers, and graph outputs.
+    std::vector<ValueSummary> inputs;
+    std::vector<ValueSummary> outputs;
+    // Node count per operator. Operators outside the default domain are
+    // keyed as domain.opType.
+    std::map<std::string, size_t> operators;
+    size_t nodeCount = 0;
+    size_t subgraphCount = 0;
+    // Occurrences of each element type among graph inputs, outputs and
+    // value_info, initializers and Cast targets.
+    std::map<DataType, size_t> elementTypes;
+    std::vector<InitializerSummary> initializers;
+    size_t sparseInitializerCount = 0;
+    uint64_t initializerBytes = 0;
+
+    // Version of the default ("" or "ai.onnx") operator set, or 0.
+    int64_t Opset(const std::string& opsetDomain = "") const {
+      for (const auto& opset : opsetImports) {
+        if (opset.domain == opsetDomain || (opsetDomain.empty() && opset.domain == "ai.onnx")) {
+          return opset.version;
+        }
+      }
+      return 0;
+    }
+
+    bool UsesElementType(DataType type) const { return elementTypes.find(type) != elementTypes.end(); }
+
+    // Whether any input carries float16 data, which is the question
+    // WinMLRunner has always answered as "Support FP16".
+    bool HasFloat16Input() const {
+      for (const auto& input : inputs) {
+        if (std::find(input.elementTypes.begin(), input.elementTypes.end(), DataType::Float16) !=
+            input.elementTypes.end()) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // Initializers, largest first.
+    std::vector<const InitializerSummary*> LargestInitializers(size_t count) const {
+      std::vector<const InitializerSummary*> largest;
+      for (const auto& initializer : initializers) {
+        largest.push_back(&initializer);
+      }
+      std::stable_sort(largest.begin(), largest.end(), [](const InitializerSummary* a, const InitializerSummary* b) {
+        return a->byteSize > b->byteSize;
+      });
+      largest.resize((std::min)(count, largest.size()));
+      return largest;
+    }
+
+    // Empty when the file has what any runtime needs to load it as a model:
+    // an IR version and a graph with at least one output. Otherwise a short
+    // description of what is missing.
+    std::string Problem() const {
+      if (irVersion <= 0) {
+        return "no IR version";
+      }
+      if (!hasGraph) {
+        return "no graph";
+      }
+      if (outputs.empty()) {
+        return "the graph has no outputs";
+      }
+      return "";
+    }
+  };
+
+  class ModelInspector {
+  public:
+    static void InspectModel(Bytes bytes, ModelSummary& summary) {
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: summary.irVersion = Int(reader); break;
+        case 2: summary.producerName = Text(reader); break;
+        case 3: summary.producerVersion = Text(reader); break;
+        case 4: summary.domain = Text(reader); break;
+        case 5: summary.modelVersion = Int(reader); break;
+        case 6: summary.docString = Text(reader); break;
+        case 7:
+          if (summary.hasGraph) {
+            throw std::runtime_error("Onnx: the model has more than one graph.");
+          }
+          summary.hasGraph = true;
+          InspectGraph(Message(reader), summary, true);
+          break;
+        case 8: summary.opsetImports.push_back(ModelParser::ParseOpset(Message(reader))); break;
+        case 14: summary.metadata.push_back(ModelParser::ParseStringPair(Message(reader))); break;
+        default: reader.Skip(); break;
+        }
+      }
+    }
+
+  private:
+    // Checked reads: a field with the wrong wire type means the bytes are not
+    // a ModelProto (a TensorFlow GraphDef, for example), which the
+    // unchecked reads of WireReader would silently misread.
+    static void Expect(const WireReader& reader, uint32_t wireType) {
+      if (reader.Type() != wireType) {
+        throw std::runtime_error("Onnx: field " + std::to_string(reader.Field()) +
+                                 " has an unexpected wire type; this is not an ONNX model.");
+      }
+    }
+
+    static int64_t Int(WireReader& reader) {
+      Expect(reader, WireReader::Varint);
+      return reader.ReadInt();
+    }
+
+    static Bytes Message(WireReader& reader) {
+      Expect(reader, WireReader::LengthDelimited);
+      return reader.ReadBytes();
+    }
+
+    static std::string Text(WireReader& reader) { return Message(reader).String(); }
+
+    static void InspectGraph(Bytes bytes, ModelSummary& summary, bool isMain) {
+      std::vector<ValueSummary> inputs;
+      std::unordered_set<std::string> initializerNames;
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: InspectNode(Message(reader), summary); break;
+        case 2:
+          if (isMain) {
+            summary.graphName = Text(reader);
+          }
+          else {
+            reader.Skip();
+          }
+          break;
+        case 5: {
+          InitializerSummary initializer = InspectTensor(Message(reader));
+          summary.elementTypes[initializer.dataType]++;
+          summary.initializerBytes += initializer.byteSize;
+          initializerNames.insert(initializer.name);
+          summary.initializers.push_back(std::move(initializer));
+          break;
+        }
+        case 11:
+        case 12:
+        case 13:
+          if (isMain) {
+            ValueSummary value = InspectValue(Message(reader));
+            for (DataType type : value.elementTypes) {
+              summary.elementTypes[type]++;
+            }
+            if (reader.Field() == 11) {
+              inputs.push_back(std::move(value));
+            }
+            else if (reader.Field() == 12) {
+              summary.outputs.push_back(std::move(value));
+            }
+          }
+          else {
+            reader.Skip();
+          }
+          break;
+        case 15:
+          summary.sparseInitializerCount++;
+          reader.Skip();
+          break;
+        default: reader.Skip(); break;
+        }
+      }
+      // Older IR versions list initializers among the inputs.
+      for (auto& input : inputs) {
+        if (initializerNames.count(input.name) == 0) {
+          summary.inputs.push_back(std::move(input));
+        }
+      }
+    }
+
+    static void InspectNode(Bytes bytes, ModelSummary& summary) {
+      std::string opType;
+      std::string domain;
+      int64_t castTarget = -1;
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        switch (reader.Field()) {
+        case 4: opType = Text(reader); break;
+        case 7: domain = Text(reader); break;
+        case 5: {
+          // Only the attributes that matter for the summary are looked at:
+          // Cast's target type and subgraphs. Tensor values are skipped.
+          std::string name;
+          int64_t value = -1;
+          WireReader attribute(Message(reader));
+          while (attribute.Next()) {
+            switch (attribute.Field()) {
+            case 1: name = Text(attribute); break;
+            case 3: value = Int(attribute); break;
+            case 6:
+            case 11:
+              summary.subgraphCount++;
+              InspectGraph(Message(attribute), summary, false);
+              break;
+            default: attribute.Skip(); break;
+            }
+          }
+          if (name == "to") {
+            castTarget = value;
+          }
+          break;
+        }
+        default: reader.Skip(); break;
+        }
+      }
+      bool defaultDomain = domain.empty() || domain == "ai.onnx";
+      summary.operators[defaultDomain ? opType : domain + "." + opType]++;
+      summary.nodeCount++;
+      if (defaultDomain && opType == "Cast" && castTarget >= 0) {
+        summary.elementTypes[static_cast<DataType>(castTarget)]++;
+      }
+    }
+
+    static InitializerSummary InspectTensor(Bytes bytes) {
+      InitializerSummary tensor;
+      uint64_t stringBytes = 0;
+      uint64_t externalLength = 0;
+      bool hasExternalLength = false;
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: reader.ReadInts(tensor.dims); break;
+        case 2: tensor.dataType = static_cast<DataType>(Int(reader)); break;
+        case 6: stringBytes += Message(reader).size; break;
+        case 8: tensor.name = Text(reader); break;
+        case 13: {
+          auto entry = ModelParser::ParseStringPair(Message(reader));
+          if (entry.first == "length") {
+            externalLength = std::stoull(entry.second);
+            hasExternalLength = true;
+          }
+          break;
+        }
+        case 14: tensor.external = Int(reader) == 1; break;
+        // raw_data and the typed data fields are skipped by length.
+        default: reader.Skip(); break;
+        }
+      }
+      uint64_t count = 1;
+      for (int64_t dim : tensor.dims) {
+        count *= static_cast<uint64_t>(dim);
+      }
+      if (tensor.external && hasExternalLength) {
+        tensor.byteSize = externalLength;
+      }
+      else if (tensor.dataType == DataType::String) {
+        tensor.byteSize = stringBytes;
+      }
+      else {
+        tensor.byteSize = count * DataTypeSize(tensor.dataType);
+      }
+      return tensor;
+    }
+
+    static ValueSummary InspectValue(Bytes bytes) {
+      ValueSummary value;
+      value.type = "unknown";
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        if (reader.Field() == 1) {
+          value.name = Text(reader);
+        }
+        else if (reader.Field() == 2) {
+          value.type = DescribeType(Message(reader), value.elementTypes);
+        }
+        else {
+          reader.Skip();
+        }
+      }
+      return value;
+    }
+
+    static std::string DescribeTensorType(Bytes bytes, std::vector<DataType>& elementTypes) {
+      DataType elementType = DataType::Undefined;
+      std::string shape;
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        if (reader.Field() == 1) {
+          elementType = static_cast<DataType>(Int(reader));
+        }
+        else if (reader.Field() == 2) {
+          std::vector<Dimension> dims;
+          ModelParser::ParseShape(Message(reader), dims);
+          shape = "[";
+          for (size_t i = 0; i < dims.size(); i++) {
+            shape += i > 0 ? "," : "";
+            shape += dims[i].value >= 0 ? std::to_string(dims[i].value) : (dims[i].param.empty() ? "?" : dims[i].param);
+          }
+          shape += "]";
+        }
+        else {
+          reader.Skip();
+        }
+      }
+      elementTypes.push_back(elementType);
+      return DataTypeName(elementType) + shape;
+    }
+
+    // TypeProto as text, collecting its element types.
+    static std::string DescribeType(Bytes bytes, std::vector<DataType>& elementTypes) {
+      std::string description = "unknown";
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: description = DescribeTensorType(Message(reader), elementTypes); break;
+        case 4:
+        case 9: {
+          // sequence_type and optional_type wrap one element type.
+          const char* wrapper = reader.Field() == 4 ? "seq(" : "optional(";
+          std::string element = "unknown";
+          WireReader inner(Message(reader));
+          while (inner.Next()) {
+            if (inner.Field() == 1) {
+              element = DescribeType(Message(inner), elementTypes);
+            }
+            else {
+              inner.Skip();
+            }
+          }
+          description = wrapper + element + ")";
+          break;
+        }
+        case 5: {
+          DataType keyType = DataType::Undefined;
+          std::string valueType = "unknown";
+          WireReader map(Message(reader));
+          while (map.Next()) {
+            if (map.Field() == 1) {
+              keyType = static_cast<DataType>(Int(map));
+              elementTypes.push_back(keyType);
+            }
+            else if (map.Field() == 2) {
+              valueType = DescribeType(Message(map), elementTypes);
+            }
+            else {
+              map.Skip();
+            }
+          }
+          description = std::string("map(") + DataTypeName(keyType) + "," + valueType + ")";
+          break;
+        }
+        case 8: description = "sparse " + DescribeTensorType(Message(reader), elementTypes); break;
+        default: reader.Skip(); break;
+        }
+      }
+      return description;
+    }
+  };
+
+  // Summarizes a model from bytes that only need to live for the call.
+  inline ModelSummary InspectModel(const uint8_t* data, size_t size) {
+    ModelSummary summary;
+    summary.fileSize = size;
+    ModelInspector::InspectModel(Bytes{ data, size }, summary);
+    return summary;
+  }
+
+  // Maps an .onnx file and summarizes it.
+  inline ModelSummary InspectModelFile(const std::filesystem::path& path) {
+    MappedFile file(path);
+    return InspectModel(file.Data(), file.Size());
+  }
+}
@@ -0,0 +1,781 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Portable, header-only reader for ONNX models. It decodes the protobuf wire
+// format directly, so it needs neither protobuf nor the ONNX headers, and it
+// builds on any C++17 compiler.
+//
+// Only the parts of ModelProto that describe the computation are decoded:
+// metadata, opset imports, and the main graph with its nodes, attributes,
+// initializers, inputs and outputs. Subgraph attributes and sparse tensors
+// are recorded but not decoded. Tensor payloads stored as raw_data are not
+// copied: Tensor::Data points into the buffer the model was parsed from, so
+// that buffer must outlive the model. LoadModel keeps its own copy; MapModel
+// of OnnxExternalData.h maps the file and its external data instead.
+// Malformed input is reported as std::runtime_error.
+namespace Onnx {
+  // TensorProto.DataType.
+  enum class DataType : int32_t {
+    Undefined = 0,
+    Float = 1,
+    UInt8 = 2,
+    Int8 = 3,
+    UInt16 = 4,
+    Int16 = 5,
+    Int32 = 6,
+    Int64 = 7,
+    String = 8,
+    Bool = 9,
+    Float16 = 10,
+    Double = 11,
+    UInt32 = 12,
+    UInt64 = 13,
+    Complex64 = 14,
+    Complex128 = 15,
+    BFloat16 = 16
+  };
+
+  // Size in bytes of one element, or 0 for strings and unknown types.
+  inline size_t DataTypeSize(DataType type) {
+    switch (type) {
+    case DataType::UInt8:
+    case DataType::Int8:
+    case DataType::Bool:
+      return 1;
+    case DataType::UInt16:
+    case DataType::Int16:
+    case DataType::Float16:
+    case DataType::BFloat16:
+      return 2;
+    case DataType::Float:
+    case DataType::Int32:
+    case DataType::UInt32:
+      return 4;
+    case DataType::Int64:
+    case DataType::Double:
+    case DataType::UInt64:
+    case DataType::Complex64:
+      return 8;
+    case DataType::Complex128:
+      return 16;
+    default:
+      return 0;
+    }
+  }
+
+  inline const char* DataTypeName(DataType type) {
+    switch (type) {
+    case DataType::Float: return "float";
+    case DataType::UInt8: return "uint8";
+    case DataType::Int8: return "int8";
+    case DataType::UInt16: return "uint16";
+    case DataType::Int16: return "int16";
+    case DataType::Int32: return "int32";
+    case DataType::Int64: return "int64";
+    case DataType::String: return "string";
+    case DataType::Bool: return "bool";
+    case DataType::Float16: return "float16";
+    case DataType::Double: return "double";
+    case DataType::UInt32: return "uint32";
+    case DataType::UInt64: return "uint64";
+    case DataType::Complex64: return "complex64";
+    case DataType::Complex128: return "complex128";
+    case DataType::BFloat16: return "bfloat16";
+    default: return "undefined";
+    }
+  }
+
+  // AttributeProto.AttributeType.
+  enum class AttributeType : int32_t {
+    Undefined = 0,
+    Float = 1,
+    Int = 2,
+    String = 3,
+    Tensor = 4,
+    Graph = 5,
+    Floats = 6,
+    Ints = 7,
+    Strings = 8,
+    Tensors = 9,
+    Graphs = 10,
+    SparseTensor = 11,
+    SparseTensors = 12,
+    TypeProto = 13,
+    TypeProtos = 14
+  };
+
+  // A length-delimited field: a view into the parsed buffer.
+  struct Bytes {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    std::string String() const { return std::string(reinterpret_cast<const char*>(data), size); }
+  };
+
+  // Iterates over the fields of one protobuf message.
+  class WireReader {
+  public:
+    enum WireType : uint32_t { Varint = 0, Fixed64 = 1, LengthDelimited = 2, Fixed32 = 5 };
+
+    WireReader(const uint8_t* data, size_t size) : m_current(data), m_end(data + size) {}
+    explicit WireReader(Bytes bytes) : WireReader(bytes.data, bytes.size) {}
+
+    // Reads the key of the next field. Returns false at the end of the message.
+    bool Next() {
+      if (m_current == m_end) {
+        return false;
+      }
+      uint64_t key = ReadVarint();
+      m_field = static_cast<uint32_t>(key >> 3);
+      m_wireType = static_cast<uint32_t>(key & 7);
+      if (m_field == 0) {
+        throw std::runtime_error("Onnx: invalid field number.");
+      }
+      return true;
+    }
+
+    uint32_t Field() const { return m_field; }
+    uint32_t Type() const { return m_wireType; }
+    size_t Remaining() const { return static_cast<size_t>(m_end - m_current); }
+
+    uint64_t ReadVarint() {
+      uint64_t value = 0;
+      for (uint32_t shift = 0; shift < 64; shift += 7) {
+        if (m_current == m_end) {
+          throw std::runtime_error("Onnx: truncated varint.");
+        }
+        uint8_t byte = *m_current++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+          return value;
+        }
+      }
+      throw std::runtime_error("Onnx: varint is too long.");
+    }
+
+    uint32_t ReadFixed32() {
+      uint32_t value;
+      memcpy(&value, Take(sizeof(value)), sizeof(value));
+      return value;
+    }
+
+    uint64_t ReadFixed64() {
+      uint64_t value;
+      memcpy(&value, Take(sizeof(value)), sizeof(value));
+      return value;
+    }
+
+    Bytes ReadBytes() {
+      uint64_t size = ReadVarint();
+      if (size > Remaining()) {
+        throw std::runtime_error("Onnx: length-delimited field runs past the end of its message.");
+      }
+      Bytes bytes{ m_current, static_cast<size_t>(size) };
+      m_current += size;
+      return bytes;
+    }
+
+    // Integer scalar fields (int32, int64, enums, bool).
+    int64_t ReadInt() { return static_cast<int64_t>(ReadVarint()); }
+
+    float ReadFloat() {
+      uint32_t bits = ReadFixed32();
+      float value;
+      memcpy(&value, &bits, sizeof(value));
+      return value;
+    }
+
+    // Repeated integer fields may be packed or not; both encodings are accepted.
+    void ReadInts(std::vector<int64_t>& values) {
+      if (m_wireType == LengthDelimited) {
+        WireReader packed(ReadBytes());
+        while (packed.Remaining() > 0) {
+          values.push_back(static_cast<int64_t>(packed.ReadVarint()));
+        }
+      }
+      else {
+        values.push_back(ReadInt());
+      }
+    }
+
+    // Repeated fixed-size fields (float, double, fixed64), packed or not.
+    template <typename T> void ReadFixed(std::vector<T>& values) {
+      static_assert(sizeof(T) == 4 || sizeof(T) == 8, "Fixed fields are 32 or 64 bits wide.");
+      if (m_wireType == LengthDelimited) {
+        Bytes packed = ReadBytes();
+        if (packed.size % sizeof(T) != 0) {
+          throw std::runtime_error("Onnx: packed field size is not a multiple of its element size.");
+        }
+        size_t offset = values.size();
+        values.resize(offset + packed.size / sizeof(T));
+        memcpy(values.data() + offset, packed.data, packed.size);
+      }
+      else {
+        T value;
+        memcpy(&value, Take(sizeof(T)), sizeof(T));
+        values.push_back(value);
+      }
+    }
+
+    void Skip() {
+      switch (m_wireType) {
+      case Varint:
+        ReadVarint();
+        break;
+      case Fixed64:
+        Take(8);
+        break;
+      case LengthDelimited:
+        ReadBytes();
+        break;
+      case Fixed32:
+        Take(4);
+        break;
+      default:
+        throw std::runtime_error("Onnx: unsupported wire type.");
+      }
+    }
+
+  private:
+    const uint8_t* Take(size_t size) {
+      if (size > Remaining()) {
+        throw std::runtime_error("Onnx: truncated field.");
+      }
+      const uint8_t* data = m_current;
+      m_current += size;
+      return data;
+    }
+
+    const uint8_t* m_current;
+    const uint8_t* m_end;
+    uint32_t m_field = 0;
+    uint32_t m_wireType = 0;
+  };
+
+  struct Tensor {
+    std::string name;
+    DataType dataType = DataType::Undefined;
+    std::vector<int64_t> dims;
+    // Set when the payload lives in a separate file (data_location EXTERNAL).
+    bool external = false;
+    std::vector<std::pair<std::string, std::string>> externalData;
+
+    size_t ElementCount() const {
+      size_t count = 1;
+      for (int64_t dim : dims) {
+        count *= static_cast<size_t>(dim);
+      }
+      return count;
+    }
+
+    // The payload in the native little-endian layout of dataType, or nullptr
+    // when the tensor is external or holds strings.
+    const uint8_t* Data() const { return m_raw.data != nullptr ? m_raw.data : m_decoded.data(); }
+    size_t ByteSize() const { return m_raw.data != nullptr ? m_raw.size : m_decoded.size(); }
+    bool HasData() const { return Data() != nullptr && ByteSize() == ElementCount() * DataTypeSize(dataType); }
+
+    // Points the payload at bytes the caller keeps alive, such as the mapped
+    // external data of the tensor.
+    void SetData(Bytes raw) {
+      m_raw = raw;
+      m_decoded.clear();
+    }
+
+    // Copies the payload out as T, converting from any integer or floating
+    // point type. Throws if the tensor has no usable payload.
+    template <typename T> std::vector<T> Values() const {
+      if (!HasData()) {
+        throw std::runtime_error("Onnx: tensor " + name + " has no inline data.");
+      }
+      std::vector<T> values(ElementCount());
+      const uint8_t* data = Data();
+      for (size_t i = 0; i < values.size(); i++) {
+        values[i] = static_cast<T>(ElementAsDouble(data, i));
+      }
+      return values;
+    }
+
+  private:
+    friend class ModelParser;
+
+    double ElementAsDouble(const uint8_t* data, size_t i) const {
+      switch (dataType) {
+      case DataType::Float: return Load<float>(data, i);
+      case DataType::Double: return Load<double>(data, i);
+      case DataType::UInt8: return Load<uint8_t>(data, i);
+      case DataType::Int8: return Load<int8_t>(data, i);
+      case DataType::UInt16: return Load<uint16_t>(data, i);
+      case DataType::Int16: return Load<int16_t>(data, i);
+      case DataType::Int32: return Load<int32_t>(data, i);
+      case DataType::UInt32: return Load<uint32_t>(data, i);
+      case DataType::Int64: return static_cast<double>(Load<int64_t>(data, i));
+      case DataType::UInt64: return static_cast<double>(Load<uint64_t>(data, i));
+      case DataType::Bool: return Load<uint8_t>(data, i) != 0;
+      case DataType::Float16: return HalfToFloat(Load<uint16_t>(data, i));
+      default: throw std::runtime_error("Onnx: tensor " + name + " has a type that cannot be converted.");
+      }
+    }
+
+    template <typename T> static T Load(const uint8_t* data, size_t i) {
+      T value;
+      memcpy(&value, data + i * sizeof(T), sizeof(T));
+      return value;
+    }
+
+    static float HalfToFloat(uint16_t half) {
+      uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+      uint32_t exponent = (half >> 10) & 0x1f;
+      uint32_t mantissa = half & 0x3ff;
+      uint32_t bits;
+      if (exponent == 0x1f) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+      }
+      else if (exponent != 0) {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+      }
+      else if (mantissa == 0) {
+        bits = sign;
+      }
+      else {
+        // Subnormal half: normalize the mantissa.
+        exponent = 113;
+        while ((mantissa & 0x400) == 0) {
+          mantissa <<= 1;
+          exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+      }
+      float value;
+      memcpy(&value, &bits, sizeof(value));
+      return value;
+    }
+
+    Bytes m_raw;
+    // Typed-field payloads (float_data, int64_data, ...) converted to the
+    // layout of dataType.
+    std::vector<uint8_t> m_decoded;
+  };
+
+  struct Attribute {
+    std::string name;
+    AttributeType type = AttributeType::Undefined;
+    float f = 0;
+    int64_t i = 0;
+    std::string s;
+    std::shared_ptr<Tensor> t;
+    std::vector<float> floats;
+    std::vector<int64_t> ints;
+    std::vector<std::string> strings;
+  };
+
+  struct Node {
+    std::string name;
+    std::string opType;
+    std::string domain;
+    // Optional inputs and outputs that are left out are empty strings.
+    std::vector<std::string> inputs;
+    std::vector<std::string> outputs;
+    std::vector<Attribute> attributes;
+
+    const Attribute* Find(const char* attributeName) const {
+      for (const auto& attribute : attributes) {
+        if (attribute.name == attributeName) {
+          return &attribute;
+        }
+      }
+      return nullptr;
+    }
+
+    int64_t Int(const char* attributeName, int64_t fallback) const {
+      const Attribute* attribute = Find(attributeName);
+      return attribute != nullptr ? attribute->i : fallback;
+    }
+
+    float Float(const char* attributeName, float fallback) const {
+      const Attribute* attribute = Find(attributeName);
+      return attribute != nullptr ? attribute->f : fallback;
+    }
+
+    std::string String(const char* attributeName, const std::string& fallback) const {
+      const Attribute* attribute = Find(attributeName);
+      return attribute != nullptr ? attribute->s : fallback;
+    }
+
+    std::vector<int64_t> Ints(const char* attributeName, const std::vector<int64_t>& fallback = {}) const {
+      const Attribute* attribute = Find(attributeName);
+      return attribute != nullptr ? attribute->ints : fallback;
+    }
+  };
+
+  // A dimension is either a fixed value or a symbolic parameter (value -1).
+  struct Dimension {
+    int64_t value = -1;
+    std::string param;
+  };
+
+  struct ValueInfo {
+    std::string name;
+    // Undefined for non-tensor values (sequences, maps).
+    DataType elementType = DataType::Undefined;
+    bool hasShape = false;
+    std::vector<Dimension> shape;
+    std::string denotation;
+  };
+
+  struct Graph {
+    std::string name;
+    std::vector<Node> nodes;
+    std::vector<Tensor> initializers;
+    // ONNX lists initializers among the inputs in older IR versions; use
+    // Model::Inputs for the values a caller has to bind.
+    std::vector<ValueInfo> inputs;
+    std::vector<ValueInfo> outputs;
+    std::vector<ValueInfo> valueInfo;
+    size_t sparseInitializerCount = 0;
+  };
+
+  struct OpsetImport {
+    std::string domain;
+    int64_t version = 0;
+  };
+
+  struct Model {
+    int64_t irVersion = 0;
+    std::vector<OpsetImport> opsetImports;
+    std::string producerName;
+    std::string producerVersion;
+    std::string domain;
+    int64_t modelVersion = 0;
+    std::string docString;
+    std::vector<std::pair<std::string, std::string>> metadata;
+    Graph graph;
+    // The bytes that raw tensor payloads point into, when the model owns them.
+    std::vector<uint8_t> storage;
+    // Or the mapped files they point into; see MapModel in OnnxExternalData.h.
+    std::vector<std::shared_ptr<const void>> mappings;
+
+    Model() = default;
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // Version of the default ("" or "ai.onnx") operator set, or 0.
+    int64_t Opset(const std::string& opsetDomain = "") const {
+      for (const auto& opset : opsetImports) {
+        if (opset.domain == opsetDomain || (opsetDomain.empty() && opset.domain == "ai.onnx")) {
+          return opset.version;
+        }
+      }
+      return 0;
+    }
+
+    const Tensor* FindInitializer(const std::string& name) const {
+      for (const auto& initializer : graph.initializers) {
+        if (initializer.name == name) {
+          return &initializer;
+        }
+      }
+      return nullptr;
+    }
+
+    // Graph inputs that are not initializers.
+    std::vector<const ValueInfo*> Inputs() const {
+      std::vector<const ValueInfo*> inputs;
+      for (const auto& input : graph.inputs) {
+        if (FindInitializer(input.name) == nullptr) {
+          inputs.push_back(&input);
+        }
+      }
+      return inputs;
+    }
+  };
+
+  class ModelParser {
+  public:
+    static void ParseModel(Bytes bytes, Model& model) {
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: model.irVersion = reader.ReadInt(); break;
+        case 2: model.producerName = reader.ReadBytes().String(); break;
+        case 3: model.producerVersion = reader.ReadBytes().String(); break;
+        case 4: model.domain = reader.ReadBytes().String(); break;
+        case 5: model.modelVersion = reader.ReadInt(); break;
+        case 6: model.docString = reader.ReadBytes().String(); break;
+        case 7: ParseGraph(reader.ReadBytes(), model.graph); break;
+        case 8: model.opsetImports.push_back(ParseOpset(reader.ReadBytes())); break;
+        case 14: model.metadata.push_back(ParseStringPair(reader.ReadBytes())); break;
+        default: reader.Skip(); break;
+        }
+      }
+    }
+
+    static void ParseGraph(Bytes bytes, Graph& graph) {
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: graph.nodes.push_back(ParseNode(reader.ReadBytes())); break;
+        case 2: graph.name = reader.ReadBytes().String(); break;
+        case 5: graph.initializers.push_back(ParseTensor(reader.ReadBytes())); break;
+        case 11: graph.inputs.push_back(ParseValueInfo(reader.ReadBytes())); break;
+        case 12: graph.outputs.push_back(ParseValueInfo(reader.ReadBytes())); break;
+        case 13: graph.valueInfo.push_back(ParseValueInfo(reader.ReadBytes())); break;
+        case 15:
+          graph.sparseInitializerCount++;
+          reader.Skip();
+          break;
+        default: reader.Skip(); break;
+        }
+      }
+    }
+
+    static Node ParseNode(Bytes bytes) {
+      Node node;
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: node.inputs.push_back(reader.ReadBytes().String()); break;
+        case 2: node.outputs.push_back(reader.ReadBytes().String()); break;
+        case 3: node.name = reader.ReadBytes().String(); break;
+        case 4: node.opType = reader.ReadBytes().String(); break;
+        case 5: node.attributes.push_back(ParseAttribute(reader.ReadBytes())); break;
+        case 7: node.domain = reader.ReadBytes().String(); break;
+        default: reader.Skip(); break;
+        }
+      }
+      return node;
+    }
+
+    static Attribute ParseAttribute(Bytes bytes) {
+      Attribute attribute;
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: attribute.name = reader.ReadBytes().String(); break;
+        case 2: attribute.f = reader.ReadFloat(); break;
+        case 3: attribute.i = reader.ReadInt(); break;
+        case 4: attribute.s = reader.ReadBytes().String(); break;
+        case 5: attribute.t = std::make_shared<Tensor>(ParseTensor(reader.ReadBytes())); break;
+        case 7: reader.ReadFixed(attribute.floats); break;
+        case 8: reader.ReadInts(attribute.ints); break;
+        case 9: attribute.strings.push_back(reader.ReadBytes().String()); break;
+        case 20: attribute.type = static_cast<AttributeType>(reader.ReadInt()); break;
+        default: reader.Skip(); break;
+        }
+      }
+      return attribute;
+    }
+
+    static Tensor ParseTensor(Bytes bytes) {
+      Tensor tensor;
+      std::vector<float> floatData;
+      std::vector<int64_t> intData;
+      std::vector<double> doubleData;
+      std::vector<uint64_t> uint64Data;
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: reader.ReadInts(tensor.dims); break;
+        case 2: tensor.dataType = static_cast<DataType>(reader.ReadInt()); break;
+        case 4: reader.ReadFixed(floatData); break;
+        // int32_data also carries the narrower integer types and float16 bits.
+        case 5: reader.ReadInts(intData); break;
+        case 7: reader.ReadInts(intData); break;
+        case 8: tensor.name = reader.ReadBytes().String(); break;
+        case 9: tensor.m_raw = reader.ReadBytes(); break;
+        case 10: reader.ReadFixed(doubleData); break;
+        case 11:
+          if (reader.Type() == WireReader::LengthDelimited) {
+            WireReader packed(reader.ReadBytes());
+            while (packed.Remaining() > 0) {
+              uint64Data.push_back(packed.ReadVarint());
+            }
+          }
+          else {
+            uint64Data.push_back(reader.ReadVarint());
+          }
+          break;
+        case 13: tensor.externalData.push_back(ParseStringPair(reader.ReadBytes())); break;
+        case 14: tensor.external = reader.ReadInt() == 1; break;
+        default: reader.Skip(); break;
+        }
+      }
+
+      if (tensor.m_raw.data == nullptr) {
+        if (!floatData.empty()) {
+          Store(tensor, floatData.data(), floatData.size());
+        }
+        else if (!doubleData.empty()) {
+          Store(tensor, doubleData.data(), doubleData.size());
+        }
+        else if (!uint64Data.empty()) {
+          if (tensor.dataType == DataType::UInt32) {
+            Narrow<uint32_t>(tensor, uint64Data);
+          }
+          else {
+            Store(tensor, uint64Data.data(), uint64Data.size());
+          }
+        }
+        else if (!intData.empty()) {
+          switch (tensor.dataType) {
+          case DataType::Int64: Store(tensor, intData.data(), intData.size()); break;
+          case DataType::Int32: Narrow<int32_t>(tensor, intData); break;
+          case DataType::UInt8:
+          case DataType::Bool: Narrow<uint8_t>(tensor, intData); break;
+          case DataType::Int8: Narrow<int8_t>(tensor, intData); break;
+          case DataType::UInt16:
+          case DataType::Float16:
+          case DataType::BFloat16: Narrow<uint16_t>(tensor, intData); break;
+          case DataType::Int16: Narrow<int16_t>(tensor, intData); break;
+          default: break;
+          }
+        }
+      }
+      return tensor;
+    }
+
+    static ValueInfo ParseValueInfo(Bytes bytes) {
+      ValueInfo info;
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        switch (reader.Field()) {
+        case 1: info.name = reader.ReadBytes().String(); break;
+        case 2: ParseType(reader.ReadBytes(), info); break;
+        default: reader.Skip(); break;
+        }
+      }
+      return info;
+    }
+
+    static void ParseShape(Bytes bytes, std::vector<Dimension>& shape) {
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        if (reader.Field() != 1) {
+          reader.Skip();
+          continue;
+        }
+        Dimension dimension;
+        WireReader dim(reader.ReadBytes());
+        while (dim.Next()) {
+          if (dim.Field() == 1) {
+            dimension.value = dim.ReadInt();
+          }
+          else if (dim.Field() == 2) {
+            dimension.param = dim.ReadBytes().String();
+          }
+          else {
+            dim.Skip();
+          }
+        }
+        shape.push_back(dimension);
+      }
+    }
+
+    static OpsetImport ParseOpset(Bytes bytes) {
+      OpsetImport opset;
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        if (reader.Field() == 1) {
+          opset.domain = reader.ReadBytes().String();
+        }
+        else if (reader.Field() == 2) {
+          opset.version = reader.ReadInt();
+        }
+        else {
+          reader.Skip();
+        }
+      }
+      return opset;
+    }
+
+    static std::pair<std::string, std::string> ParseStringPair(Bytes bytes) {
+      std::pair<std::string, std::string> entry;
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        if (reader.Field() == 1) {
+          entry.first = reader.ReadBytes().String();
+        }
+        else if (reader.Field() == 2) {
+          entry.second = reader.ReadBytes().String();
+        }
+        else {
+          reader.Skip();
+        }
+      }
+      return entry;
+    }
+
+  private:
+    static void ParseType(Bytes bytes, ValueInfo& info) {
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        if (reader.Field() == 1) {
+          // TypeProto.Tensor
+          WireReader tensorType(reader.ReadBytes());
+          while (tensorType.Next()) {
+            if (tensorType.Field() == 1) {
+              info.elementType = static_cast<DataType>(tensorType.ReadInt());
+            }
+            else if (tensorType.Field() == 2) {
+              info.hasShape = true;
+              ParseShape(tensorType.ReadBytes(), info.shape);
+            }
+            else {
+              tensorType.Skip();
+            }
+          }
+        }
+        else if (reader.Field() == 6) {
+          info.denotation = reader.ReadBytes().String();
+        }
+        else {
+          reader.Skip();
+        }
+      }
+    }
+
+    template <typename T> static void Store(Tensor& tensor, const T* values, size_t count) {
+      tensor.m_decoded.resize(count * sizeof(T));
+      memcpy(tensor.m_decoded.data(), values, tensor.m_decoded.size());
+    }
+
+    template <typename T, typename Source> static void Narrow(Tensor& tensor, const std::vector<Source>& values) {
+      std::vector<T> narrowed(values.size());
+      for (size_t i = 0; i < values.size(); i++) {
+        narrowed[i] = static_cast<T>(values[i]);
+      }
+      Store(tensor, narrowed.data(), narrowed.size());
+    }
+  };
+
+  // Parses a model from bytes the caller keeps alive for the model's lifetime.
+  inline std::unique_ptr<Model> ParseModel(const uint8_t* data, size_t size) {
+    auto model = std::make_unique<Model>();
+    ModelParser::ParseModel(Bytes{ data, size }, *model);
+    return model;
+  }
+
+  // Reads and parses an .onnx file.
+  inline std::unique_ptr<Model> LoadModel(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+      throw std::runtime_error("Onnx: could not open " + path.string());
+    }
+    std::vector<uint8_t> storage(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(storage.data()), static_cast<std::streamsize>(storage.size()))) {
+      throw std::runtime_error("Onnx: could not read " + path.string());
+    }
+    auto model = std::make_unique<Model>();
+    model->storage = std::move(storage);
+    ModelParser::ParseModel(Bytes{ model->storage.data(), model->storage.size() }, *model);
+    return model;
+  }
+}
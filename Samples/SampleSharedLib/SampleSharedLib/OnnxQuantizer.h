@@ -0,0 +1,851 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "OnnxInspector.h"
+#include "OnnxModel.h"
+#include "OnnxWriter.h"
+
+// Post-training static quantization of an fp32 ONNX model to the QDQ format.
+//
+// Calibration runs the float model over representative inputs and feeds every
+// activation that will be quantized (CalibrationTensors) to a Calibrator. Each
+// tensor keeps a histogram of its magnitudes and its exact minimum and
+// maximum, and its range comes from the minimum and maximum, from a
+// percentile of the magnitudes, or from the clipping threshold whose 8-bit
+// quantization loses the least information (the smallest Kullback-Leibler
+// divergence from the float distribution).
+//
+// The rewrite puts a QuantizeLinear and DequantizeLinear pair behind every
+// activation a quantized node reads and behind its output, or behind the
+// output of a Relu that is its only consumer; graph outputs stay float.
+// Activations are uint8 with a zero point, weights int8 symmetric, per output
+// channel from opset 13 on and per tensor before, and Conv and Gemm biases
+// int32 with the product of the input and weight scales: the form runtimes
+// fuse into integer kernels such as QLinearConv. The DequantizeLinear of a weight produces the weight's own
+// name, so the quantized nodes are copied unchanged. Models below opset 10,
+// which has no QuantizeLinear, move to opset 10 when none of their operators
+// changed in between; anything else is reported as std::runtime_error.
+//
+// Like the fp16 converter the model is copied field by field through a
+// WireWriter. Weights stored as external data stay float and keep their
+// relative location.
+namespace Onnx {
+  enum class CalibrationMethod { MinMax, Percentile, Entropy };
+
+  inline const char* CalibrationMethodName(CalibrationMethod method) {
+    switch (method) {
+    case CalibrationMethod::MinMax: return "MinMax";
+    case CalibrationMethod::Percentile: return "Percentile";
+    case CalibrationMethod::Entropy: return "Entropy";
+    default: return "unknown";
+    }
+  }
+
+  struct QuantizationOptions {
+    CalibrationMethod method = CalibrationMethod::MinMax;
+    // Share of the magnitudes Percentile calibration keeps in range, in percent.
+    double percentile = 99.999;
+    // Per-channel weight scales where the opset allows them.
+    bool perChannel = true;
+    // Default-domain operators to quantize.
+    std::vector<std::string> ops = { "Conv", "MatMul", "Gemm" };
+  };
+
+  struct QuantizationReport {
+    uint64_t inputBytes = 0;
+    uint64_t outputBytes = 0;
+    // Default opset of the written model.
+    int64_t opset = 0;
+    size_t quantizedNodes = 0;
+    // Nodes of a quantized type left in float because an activation they read
+    // was never calibrated or their weights are not inline float initializers.
+    size_t skippedNodes = 0;
+    size_t quantizedActivations = 0;
+    // Weights and biases.
+    size_t quantizedTensors = 0;
+    size_t insertedNodes = 0;
+  };
+
+  // Calibrated [minimum, maximum] of each activation, by tensor name.
+  using QuantizationRanges = std::unordered_map<std::string, std::pair<float, float>>;
+
+  // Distribution of the values of one tensor: the exact minimum and maximum
+  // and a histogram of the magnitudes. The bins cover [0, limit); a larger
+  // value doubles the limit and merges neighbouring bins, so values are seen
+  // once and never stored. Exact zeros, which Relu outputs are full of and
+  // which quantize exactly, are left out of the histogram so that they do not
+  // pull the clipping thresholds down.
+  class Histogram {
+  public:
+    static constexpr size_t Bins = 2048;
+
+    Histogram() : m_bins(Bins) {}
+
+    void Add(const float* values, size_t count) {
+      float largest = 0;
+      for (size_t i = 0; i < count; i++) {
+        if (std::isfinite(values[i])) {
+          m_min = (std::min)(m_min, values[i]);
+          m_max = (std::max)(m_max, values[i]);
+          largest = (std::max)(largest, std::fabs(values[i]));
+          m_count++;
+        }
+      }
+      if (largest > m_limit) {
+        Grow(largest);
+      }
+      double scale = m_limit > 0 ? Bins / static_cast<double>(m_limit) : 0.0;
+      for (size_t i = 0; i < count; i++) {
+        if (std::isfinite(values[i]) && values[i] != 0) {
+          m_bins[(std::min)(static_cast<size_t>(std::fabs(values[i]) * scale), Bins - 1)]++;
+          m_binned++;
+        }
+      }
+    }
+
+    uint64_t Count() const { return m_count; }
+
+    // The calibrated range, which always lies within [minimum, maximum].
+    std::pair<float, float> Range(CalibrationMethod method, double percentile) const {
+      if (m_count == 0) {
+        return { 0.0f, 0.0f };
+      }
+      if (method == CalibrationMethod::MinMax || m_binned == 0) {
+        return { m_min, m_max };
+      }
+      size_t bins = method == CalibrationMethod::Percentile ? PercentileBins(percentile) : EntropyBins();
+      float threshold = m_limit * static_cast<float>(bins) / Bins;
+      return { (std::max)(m_min, -threshold), (std::min)(m_max, threshold) };
+    }
+
+  private:
+    void Grow(float largest) {
+      if (m_limit == 0) {
+        m_limit = largest;
+        return;
+      }
+      while (m_limit < largest) {
+        for (size_t i = 0; i < Bins / 2; i++) {
+          m_bins[i] = m_bins[2 * i] + m_bins[2 * i + 1];
+        }
+        std::fill(m_bins.begin() + Bins / 2, m_bins.end(), 0);
+        m_limit *= 2;
+      }
+    }
+
+    // The number of leading bins holding percentile percent of the values.
+    size_t PercentileBins(double percentile) const {
+      double target = m_binned * (std::min)((std::max)(percentile, 0.0), 100.0) / 100.0;
+      uint64_t total = 0;
+      for (size_t i = 0; i < Bins; i++) {
+        total += m_bins[i];
+        if (total >= target) {
+          return i + 1;
+        }
+      }
+      return Bins;
+    }
+
+    // The number of leading bins to keep whose 8-bit quantization diverges
+    // least from the distribution with the values beyond them clipped into
+    // the last kept bin. Magnitudes of signed values get half the levels.
+    size_t EntropyBins() const {
+      const size_t Levels = m_min < 0 ? 128 : 256;
+      // Stands in for empty bins of the quantized distribution that the
+      // clipped one puts mass in, so that the divergence stays finite.
+      constexpr double Floor = 1e-6;
+      std::vector<double> q(Bins);
+      uint64_t outliers = 0;
+      for (size_t i = Levels; i < Bins; i++) {
+        outliers += m_bins[i];
+      }
+      size_t best = Bins;
+      double bestDivergence = std::numeric_limits<double>::infinity();
+      for (size_t bins = Levels; bins <= Bins; bins++) {
+        // The kept bins merged into Levels levels, each spread evenly over
+        // the bins of the level that are not empty.
+        double kept = 0;
+        for (size_t level = 0; level < Levels; level++) {
+          size_t begin = level * bins / Levels;
+          size_t end = (level + 1) * bins / Levels;
+          double mass = 0;
+          size_t used = 0;
+          for (size_t i = begin; i < end; i++) {
+            mass += static_cast<double>(m_bins[i]);
+            used += m_bins[i] > 0 ? 1 : 0;
+          }
+          for (size_t i = begin; i < end; i++) {
+            q[i] = m_bins[i] > 0 ? mass / used : 0.0;
+          }
+          kept += mass;
+        }
+        double divergence = 0;
+        for (size_t i = 0; i < bins && kept > 0; i++) {
+          double p = static_cast<double>(m_bins[i]) + (i == bins - 1 ? static_cast<double>(outliers) : 0.0);
+          if (p > 0) {
+            p /= static_cast<double>(m_binned);
+            divergence += p * std::log(p / (std::max)(q[i] / kept, Floor));
+          }
+        }
+        if (bins < Bins) {
+          outliers -= m_bins[bins];
+        }
+        if (kept > 0 && divergence < bestDivergence) {
+          bestDivergence = divergence;
+          best = bins;
+        }
+      }
+      return best;
+    }
+
+    std::vector<uint64_t> m_bins;
+    float m_limit = 0;
+    float m_min = std::numeric_limits<float>::infinity();
+    float m_max = -std::numeric_limits<float>::infinity();
+    uint64_t m_count = 0;
+    uint64_t m_binned = 0;
+  };
+
+  // Histograms of the tensors named at construction. Values of any other
+  // tensor are ignored, so Add can be given every value a model computes.
+  class Calibrator {
+  public:
+    explicit Calibrator(const std::vector<std::string>& names) {
+      for (const auto& name : names) {
+        m_histograms[name];
+      }
+    }
+
+    void Add(const std::string& name, const float* values, size_t count) {
+      auto histogram = m_histograms.find(name);
+      if (histogram != m_histograms.end()) {
+        histogram->second.Add(values, count);
+      }
+    }
+
+    // Ranges of the tensors that have been seen.
+    QuantizationRanges Ranges(const QuantizationOptions& options) const {
+      QuantizationRanges ranges;
+      for (const auto& histogram : m_histograms) {
+        if (histogram.second.Count() > 0) {
+          ranges[histogram.first] = histogram.second.Range(options.method, options.percentile);
+        }
+      }
+      return ranges;
+    }
+
+  private:
+    std::unordered_map<std::string, Histogram> m_histograms;
+  };
+
+  class QdqQuantizer {
+  public:
+    QdqQuantizer(const Model& model, const QuantizationOptions& options) : m_model(model), m_options(options) {
+      Plan();
+    }
+
+    // The activations to calibrate, in graph order.
+    std::vector<std::string> Activations() const {
+      std::vector<std::string> names;
+      std::unordered_set<std::string> seen;
+      for (const auto& candidate : m_candidates) {
+        for (const auto& name : candidate.activations) {
+          if (seen.insert(name).second) {
+            names.push_back(name);
+          }
+        }
+        if (!candidate.output.empty() && seen.insert(candidate.output).second) {
+          names.push_back(candidate.output);
+        }
+      }
+      return names;
+    }
+
+    // Writes the quantized form of the ModelProto bytes model was parsed from.
+    void Write(Bytes bytes, const QuantizationRanges& ranges, WireWriter& writer, QuantizationReport& report) {
+      Prepare(ranges, report);
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        uint32_t field = reader.Field();
+        if (field == 1 && reader.Type() == WireReader::Varint) {
+          int64_t irVersion = reader.ReadInt();
+          writer.Int(1, m_opset != m_model.Opset() ? (std::max)(irVersion, int64_t(5)) : irVersion);
+        }
+        else if (field == 7 && reader.Type() == WireReader::LengthDelimited) {
+          Bytes graph = reader.ReadBytes();
+          writer.Message(7, [&](WireWriter& body) { WriteGraph(graph, body); });
+        }
+        else if (field == 8 && reader.Type() == WireReader::LengthDelimited) {
+          Bytes opset = reader.ReadBytes();
+          OpsetImport import = ModelParser::ParseOpset(opset);
+          if (import.domain.empty() || import.domain == "ai.onnx") {
+            writer.Message(8, [&](WireWriter& body) {
+              WireReader fields(opset);
+              while (fields.Next()) {
+                if (fields.Field() == 2 && fields.Type() == WireReader::Varint) {
+                  fields.ReadInt();
+                  body.Int(2, m_opset);
+                }
+                else {
+                  body.Copy(fields);
+                }
+              }
+            });
+          }
+          else {
+            writer.Bytes(8, opset.data, opset.size);
+          }
+        }
+        else {
+          writer.Copy(reader);
+        }
+      }
+      report.opset = m_opset;
+    }
+
+  private:
+    // A node to quantize and the tensors it reads, by input index.
+    struct Candidate {
+      size_t node = 0;
+      std::vector<std::string> activations;
+      // Float initializers and the axis of their per-channel scales, or -1.
+      std::vector<std::pair<std::string, int64_t>> weights;
+      std::string bias;
+      // The activation quantized behind the node, or empty.
+      std::string output;
+    };
+
+    // A quantized initializer and the DequantizeLinear that restores it.
+    struct Replacement {
+      std::string name;
+      std::string quantized;
+      std::string scale;
+      std::string zeroPoint;
+      std::string node;
+      DataType type = DataType::Int8;
+      std::vector<int64_t> dims;
+      int64_t axis = -1;
+      std::vector<uint8_t> values;
+      std::vector<float> scales;
+    };
+
+    struct QuantizedActivation {
+      std::string name;
+      std::string quantized;
+      std::string dequantized;
+      std::string scale;
+      std::string zeroPoint;
+      std::string quantizeNode;
+      std::string dequantizeNode;
+      float scaleValue = 1.0f;
+      uint8_t zeroPointValue = 0;
+    };
+
+    void Plan() {
+      const Graph& graph = m_model.graph;
+      for (const auto& initializer : graph.initializers) {
+        m_initializers[initializer.name] = &initializer;
+        m_names.insert(initializer.name);
+      }
+      for (const auto* values : { &graph.inputs, &graph.outputs, &graph.valueInfo }) {
+        for (const auto& value : *values) {
+          m_names.insert(value.name);
+        }
+      }
+      std::unordered_map<std::string, std::vector<size_t>> consumers;
+      for (size_t index = 0; index < graph.nodes.size(); index++) {
+        const Node& node = graph.nodes[index];
+        m_names.insert(node.name);
+        for (const auto& input : node.inputs) {
+          m_names.insert(input);
+          consumers[input].push_back(index);
+        }
+        for (const auto& output : node.outputs) {
+          m_names.insert(output);
+          if (!output.empty()) {
+            m_producers[output] = index;
+          }
+        }
+      }
+
+      m_opset = m_model.Opset();
+      if (m_opset < 10) {
+        RequireOpset10();
+        m_opset = 10;
+      }
+      bool perChannel = m_options.perChannel && m_opset >= 13;
+
+      for (size_t index = 0; index < graph.nodes.size(); index++) {
+        const Node& node = graph.nodes[index];
+        bool defaultDomain = node.domain.empty() || node.domain == "ai.onnx";
+        if (!defaultDomain || node.outputs.empty() ||
+            std::find(m_options.ops.begin(), m_options.ops.end(), node.opType) == m_options.ops.end()) {
+          continue;
+        }
+        // Conv, MatMul and Gemm quantize their first two inputs; other
+        // operators every input.
+        bool linear = node.opType == "Conv" || node.opType == "MatMul" || node.opType == "Gemm";
+        size_t quantizedInputs = linear ? (std::min)(node.inputs.size(), size_t(2)) : node.inputs.size();
+        Candidate candidate;
+        candidate.node = index;
+        bool usable = quantizedInputs > 0;
+        for (size_t i = 0; i < quantizedInputs && usable; i++) {
+          const std::string& input = node.inputs[i];
+          auto initializer = m_initializers.find(input);
+          if (input.empty()) {
+            usable = false;
+          }
+          else if (initializer == m_initializers.end()) {
+            candidate.activations.push_back(input);
+          }
+          else if (initializer->second->dataType != DataType::Float || !initializer->second->HasData()) {
+            usable = false;
+          }
+          else {
+            candidate.weights.push_back({ input, perChannel ? WeightAxis(node, i, *initializer->second) : -1 });
+          }
+        }
+        if (!usable || candidate.activations.empty()) {
+          m_skipped++;
+          continue;
+        }
+        if ((node.opType == "Conv" || node.opType == "Gemm") && node.inputs.size() > 2 &&
+            candidate.activations.size() == 1 && candidate.weights.size() == 1 &&
+            node.inputs[0] == candidate.activations[0] && consumers[node.inputs[2]].size() == 1) {
+          auto bias = m_initializers.find(node.inputs[2]);
+          if (bias != m_initializers.end() && bias->second->dataType == DataType::Float &&
+              bias->second->dims.size() == 1 && bias->second->HasData()) {
+            candidate.bias = node.inputs[2];
+          }
+        }
+        // A Relu that is the only consumer is clipped by the zero point of
+        // the quantized type, so the quantization goes behind it. Graph
+        // outputs stay float.
+        const std::string& output = node.outputs[0];
+        auto readers = consumers.find(output);
+        candidate.output = output;
+        if (readers != consumers.end() && readers->second.size() == 1 && !IsGraphOutput(output)) {
+          const Node& consumer = graph.nodes[readers->second[0]];
+          if (consumer.opType == "Relu" && (consumer.domain.empty() || consumer.domain == "ai.onnx") &&
+              !consumer.outputs.empty()) {
+            candidate.output = consumer.outputs[0];
+          }
+        }
+        if (IsGraphOutput(candidate.output)) {
+          candidate.output.clear();
+        }
+        m_candidates.push_back(std::move(candidate));
+      }
+    }
+
+    // The axis of the output channels of a weight, or -1 for a single scale.
+    static int64_t WeightAxis(const Node& node, size_t input, const Tensor& weight) {
+      int64_t rank = static_cast<int64_t>(weight.dims.size());
+      if (node.opType == "Conv") {
+        return input == 1 && rank > 1 ? 0 : -1;
+      }
+      if (node.opType == "Gemm") {
+        return input == 1 && rank == 2 ? (node.Int("transB", 0) != 0 ? 0 : 1) : -1;
+      }
+      if (node.opType == "MatMul") {
+        return input == 1 && rank > 1 ? rank - 1 : -1;
+      }
+      return -1;
+    }
+
+    bool IsGraphOutput(const std::string& name) const {
+      const auto& outputs = m_model.graph.outputs;
+      return std::any_of(outputs.begin(), outputs.end(), [&](const ValueInfo& output) { return output.name == name; });
+    }
+
+    // Opset 10 only changed or added operators outside this list, and
+    // BatchNormalization lost its spatial attribute in opset 9.
+    void RequireOpset10() const {
+      static const std::unordered_set<std::string> unchanged = { "Abs", "Add", "AveragePool",
+        "BatchNormalization", "Cast", "Clip", "Concat", "Constant", "Conv", "ConvTranspose", "Div", "Dropout", "Elu",
+        "Exp", "Flatten", "Gather", "Gemm", "GlobalAveragePool", "GlobalMaxPool", "Identity", "InstanceNormalization",
+        "LeakyRelu", "Log", "LRN", "MatMul", "Max", "MaxPool", "Mean", "Min", "Mul", "Neg", "Pad", "Pow", "PRelu",
+        "Reciprocal", "ReduceMax", "ReduceMean", "ReduceMin", "ReduceSum", "Relu", "Reshape", "Shape", "Sigmoid",
+        "Softmax", "Split", "Sqrt", "Squeeze", "Sub", "Sum", "Tanh", "Transpose", "Unsqueeze" };
+      int64_t opset = m_model.Opset();
+      if (opset == 0) {
+        throw std::runtime_error("Onnx: the model does not import the default operator set.");
+      }
+      for (const auto& node : m_model.graph.nodes) {
+        if (!node.domain.empty() && node.domain != "ai.onnx") {
+          continue;
+        }
+        if (unchanged.count(node.opType) == 0 ||
+            (node.opType == "BatchNormalization" && node.Find("spatial") != nullptr)) {
+          throw std::runtime_error("Onnx: quantization needs opset 10, and " + node.opType + " in " +
+                                   node.name + " may not keep its meaning from opset " + std::to_string(opset) +
+                                   " to 10.");
+        }
+      }
+    }
+
+    std::string Unique(const std::string& base) {
+      std::string name = base;
+      for (int suffix = 1; m_names.count(name) != 0; suffix++) {
+        name = base + "_" + std::to_string(suffix);
+      }
+      m_names.insert(name);
+      return name;
+    }
+
+    // Resolves the plan against the calibrated ranges and quantizes the
+    // weights.
+    void Prepare(const QuantizationRanges& ranges, QuantizationReport& report) {
+      report.skippedNodes = m_skipped;
+      for (const auto& candidate : m_candidates) {
+        bool calibrated = std::all_of(candidate.activations.begin(), candidate.activations.end(),
+                                      [&](const std::string& name) { return ranges.count(name) != 0; });
+        if (!calibrated) {
+          report.skippedNodes++;
+          continue;
+        }
+        for (const auto& name : candidate.activations) {
+          AddActivation(name, ranges.at(name));
+        }
+        if (ranges.count(candidate.output) != 0) {
+          AddActivation(candidate.output, ranges.at(candidate.output));
+        }
+        for (const auto& weight : candidate.weights) {
+          if (m_replacementIndex.count(weight.first) == 0) {
+            QuantizeWeight(*m_initializers.at(weight.first), weight.second);
+          }
+        }
+        if (!candidate.bias.empty() && m_replacementIndex.count(candidate.bias) == 0) {
+          const Replacement& weight = m_replacements[m_replacementIndex.at(candidate.weights[0].first)];
+          float inputScale = m_activations[m_activationIndex.at(candidate.activations[0])].scaleValue;
+          QuantizeBias(*m_initializers.at(candidate.bias), weight, inputScale);
+        }
+        report.quantizedNodes++;
+      }
+      report.quantizedActivations = m_activations.size();
+      report.quantizedTensors = m_replacements.size();
+      report.insertedNodes = 2 * m_activations.size() + m_replacements.size();
+    }
+
+    void AddActivation(const std::string& name, std::pair<float, float> range) {
+      if (m_activationIndex.count(name) != 0) {
+        return;
+      }
+      // The range has to hold zero so that zero padding is exact.
+      float low = (std::min)(range.first, 0.0f);
+      float high = (std::max)(range.second, 0.0f);
+      QuantizedActivation activation;
+      activation.name = name;
+      activation.scaleValue = (high - low) / 255.0f;
+      if (!(activation.scaleValue > 0) || !std::isfinite(activation.scaleValue)) {
+        activation.scaleValue = 1.0f;
+      }
+      activation.zeroPointValue =
+        static_cast<uint8_t>((std::min)((std::max)(std::nearbyint(-low / activation.scaleValue), 0.0f), 255.0f));
+      activation.quantized = Unique(name + "_quantized");
+      activation.dequantized = Unique(name + "_dequantized");
+      activation.scale = Unique(name + "_scale");
+      activation.zeroPoint = Unique(name + "_zero_point");
+      activation.quantizeNode = Unique(name + "_QuantizeLinear");
+      activation.dequantizeNode = Unique(name + "_DequantizeLinear");
+      m_activationIndex[name] = m_activations.size();
+      m_renames[name] = activation.dequantized;
+      auto producer = m_producers.find(name);
+      if (producer != m_producers.end()) {
+        m_after[producer->second].push_back(m_activations.size());
+      }
+      else {
+        m_front.push_back(m_activations.size());
+      }
+      m_activations.push_back(std::move(activation));
+    }
+
+    Replacement& AddReplacement(const Tensor& tensor, DataType type, int64_t axis) {
+      Replacement replacement;
+      replacement.name = tensor.name;
+      replacement.type = type;
+      replacement.dims = tensor.dims;
+      replacement.axis = axis;
+      replacement.quantized = Unique(tensor.name + "_quantized");
+      replacement.scale = Unique(tensor.name + "_scale");
+      replacement.zeroPoint = Unique(tensor.name + "_zero_point");
+      replacement.node = Unique(tensor.name + "_DequantizeLinear");
+      m_replacementIndex[tensor.name] = m_replacements.size();
+      m_replacements.push_back(std::move(replacement));
+      return m_replacements.back();
+    }
+
+    // Symmetric int8 in [-127, 127], with one scale per index of axis.
+    void QuantizeWeight(const Tensor& tensor, int64_t axis) {
+      std::vector<float> values = tensor.Values<float>();
+      size_t channels = axis >= 0 ? static_cast<size_t>(tensor.dims[axis]) : 1;
+      size_t inner = 1;
+      for (size_t i = static_cast<size_t>(axis + 1); axis >= 0 && i < tensor.dims.size(); i++) {
+        inner *= static_cast<size_t>(tensor.dims[i]);
+      }
+      Replacement& weight = AddReplacement(tensor, DataType::Int8, axis);
+      weight.scales.assign(channels, 0.0f);
+      for (size_t i = 0; i < values.size(); i++) {
+        float& scale = weight.scales[(i / inner) % channels];
+        scale = (std::max)(scale, std::isfinite(values[i]) ? std::fabs(values[i]) : 0.0f);
+      }
+      for (float& scale : weight.scales) {
+        scale = scale > 0 ? scale / 127.0f : 1.0f;
+      }
+      weight.values.resize(values.size());
+      for (size_t i = 0; i < values.size(); i++) {
+        float q = std::nearbyint(values[i] / weight.scales[(i / inner) % channels]);
+        weight.values[i] = static_cast<uint8_t>(static_cast<int8_t>((std::min)((std::max)(q, -127.0f), 127.0f)));
+      }
+    }
+
+    // int32 with the scale of the accumulator, input scale times weight scale.
+    void QuantizeBias(const Tensor& tensor, const Replacement& weight, float inputScale) {
+      std::vector<float> values = tensor.Values<float>();
+      if (weight.scales.size() != 1 && weight.scales.size() != values.size()) {
+        return;
+      }
+      std::vector<float> scales(weight.scales.size());
+      for (size_t i = 0; i < scales.size(); i++) {
+        scales[i] = inputScale * weight.scales[i];
+      }
+      Replacement& bias = AddReplacement(tensor, DataType::Int32, scales.size() > 1 ? 0 : -1);
+      bias.scales = scales;
+      bias.values.resize(values.size() * sizeof(int32_t));
+      for (size_t i = 0; i < values.size(); i++) {
+        double q = std::nearbyint(static_cast<double>(values[i]) / scales[scales.size() > 1 ? i : 0]);
+        int32_t value = static_cast<int32_t>((std::min)((std::max)(q, -2147483648.0), 2147483647.0));
+        memcpy(bias.values.data() + i * sizeof(int32_t), &value, sizeof(value));
+      }
+    }
+
+    void WriteGraph(Bytes bytes, WireWriter& writer) {
+      WireReader reader(bytes);
+      size_t nodeIndex = 0;
+      bool frontWritten = false;
+      while (reader.Next()) {
+        uint32_t field = reader.Field();
+        if (reader.Type() != WireReader::LengthDelimited) {
+          writer.Copy(reader);
+          continue;
+        }
+        switch (field) {
+        case 1: {
+          Bytes node = reader.ReadBytes();
+          if (!frontWritten) {
+            WriteFront(writer);
+            frontWritten = true;
+          }
+          WriteNode(node, writer);
+          auto after = m_after.find(nodeIndex++);
+          if (after != m_after.end()) {
+            for (size_t activation : after->second) {
+              WriteQuantizeDequantize(m_activations[activation], writer);
+            }
+          }
+          break;
+        }
+        case 5: {
+          Bytes tensor = reader.ReadBytes();
+          auto replacement = m_replacementIndex.find(TensorName(tensor));
+          if (replacement != m_replacementIndex.end()) {
+            WriteReplacementTensors(m_replacements[replacement->second], writer);
+          }
+          else {
+            writer.Bytes(5, tensor.data, tensor.size);
+          }
+          break;
+        }
+        case 11: {
+          Bytes value = reader.ReadBytes();
+          // Older IR versions list initializers among the inputs; replaced
+          // ones are now computed.
+          if (m_replacementIndex.count(ModelParser::ParseValueInfo(value).name) == 0) {
+            writer.Bytes(11, value.data, value.size);
+          }
+          break;
+        }
+        default: writer.Copy(reader); break;
+        }
+      }
+      if (!frontWritten) {
+        WriteFront(writer);
+      }
+      for (const auto& activation : m_activations) {
+        WriteTensor(writer, activation.scale, DataType::Float, {}, &activation.scaleValue, sizeof(float));
+        WriteTensor(writer, activation.zeroPoint, DataType::UInt8, {}, &activation.zeroPointValue, 1);
+      }
+    }
+
+    static std::string TensorName(Bytes bytes) {
+      WireReader reader(bytes);
+      while (reader.Next()) {
+        if (reader.Field() == 8 && reader.Type() == WireReader::LengthDelimited) {
+          return reader.ReadBytes().String();
+        }
+        reader.Skip();
+      }
+      return std::string();
+    }
+
+    // The DequantizeLinear of every weight and the quantization of the graph
+    // inputs, ahead of the first node.
+    void WriteFront(WireWriter& writer) const {
+      for (const auto& replacement : m_replacements) {
+        WriteQdqNode(writer, "DequantizeLinear", { replacement.quantized, replacement.scale, replacement.zeroPoint },
+                     replacement.name, replacement.node, replacement.axis);
+      }
+      for (size_t activation : m_front) {
+        WriteQuantizeDequantize(m_activations[activation], writer);
+      }
+    }
+
+    static void WriteQuantizeDequantize(const QuantizedActivation& activation, WireWriter& writer) {
+      WriteQdqNode(writer, "QuantizeLinear", { activation.name, activation.scale, activation.zeroPoint },
+                   activation.quantized, activation.quantizeNode, -1);
+      WriteQdqNode(writer, "DequantizeLinear", { activation.quantized, activation.scale, activation.zeroPoint },
+                   activation.dequantized, activation.dequantizeNode, -1);
+    }
+
+    // Copies a node, reading the dequantized form of quantized activations.
+    void WriteNode(Bytes bytes, WireWriter& writer) const {
+      writer.Message(1, [&](WireWriter& node) {
+        WireReader reader(bytes);
+        while (reader.Next()) {
+          if (reader.Field() == 1 && reader.Type() == WireReader::LengthDelimited) {
+            std::string input = reader.ReadBytes().String();
+            auto renamed = m_renames.find(input);
+            node.String(1, renamed != m_renames.end() ? renamed->second : input);
+          }
+          else {
+            node.Copy(reader);
+          }
+        }
+      });
+    }
+
+    static void WriteQdqNode(WireWriter& writer, const char* opType, const std::vector<std::string>& inputs,
+                             const std::string& output, const std::string& name, int64_t axis) {
+      writer.Message(1, [&](WireWriter& node) {
+        for (const auto& input : inputs) {
+          node.String(1, input);
+        }
+        node.String(2, output);
+        node.String(3, name);
+        node.String(4, opType);
+        if (axis >= 0) {
+          node.Message(5, [&](WireWriter& attribute) {
+            attribute.String(1, "axis");
+            attribute.Int(3, axis);
+            attribute.Int(20, static_cast<int64_t>(AttributeType::Int));
+          });
+        }
+      });
+    }
+
+    static void WriteReplacementTensors(const Replacement& replacement, WireWriter& writer) {
+      std::vector<int64_t> scaleDims;
+      if (replacement.axis >= 0) {
+        scaleDims.push_back(static_cast<int64_t>(replacement.scales.size()));
+      }
+      size_t zeroPointSize = replacement.scales.size() * DataTypeSize(replacement.type);
+      std::vector<uint8_t> zeroPoints(zeroPointSize, 0);
+      WriteTensor(writer, replacement.quantized, replacement.type, replacement.dims, replacement.values.data(),
+                  replacement.values.size());
+      WriteTensor(writer, replacement.scale, DataType::Float, scaleDims, replacement.scales.data(),
+                  replacement.scales.size() * sizeof(float));
+      WriteTensor(writer, replacement.zeroPoint, replacement.type, scaleDims, zeroPoints.data(), zeroPoints.size());
+    }
+
+    static void WriteTensor(WireWriter& writer, const std::string& name, DataType type,
+                            const std::vector<int64_t>& dims, const void* data, size_t size) {
+      writer.Message(5, [&](WireWriter& tensor) {
+        for (int64_t dim : dims) {
+          tensor.Int(1, dim);
+        }
+        tensor.Int(2, static_cast<int64_t>(type));
+        tensor.String(8, name);
+        tensor.Bytes(9, data, size);
+      });
+    }
+
+    const Model& m_model;
+    const QuantizationOptions& m_options;
+    int64_t m_opset = 0;
+    size_t m_skipped = 0;
+    std::unordered_map<std::string, const Tensor*> m_initializers;
+    std::unordered_map<std::string, size_t> m_producers;
+    std::unordered_set<std::string> m_names;
+    std::vector<Candidate> m_candidates;
+    std::vector<QuantizedActivation> m_activations;
+    std::unordered_map<std::string, size_t> m_activationIndex;
+    std::unordered_map<std::string, std::string> m_renames;
+    // Activations quantized behind the node of each index, and ahead of all.
+    std::unordered_map<size_t, std::vector<size_t>> m_after;
+    std::vector<size_t> m_front;
+    std::vector<Replacement> m_replacements;
+    std::unordered_map<std::string, size_t> m_replacementIndex;
+  };
+
+  // The activations a Calibrator has to see for QuantizeModel to quantize
+  // every node of options.ops.
+  inline std::vector<std::string> CalibrationTensors(const Model& model,
+                                                     const QuantizationOptions& options = QuantizationOptions()) {
+    return QdqQuantizer(model, options).Activations();
+  }
+
+  // Quantizes the serialized model in data with the calibrated ranges and
+  // writes the result to output.
+  inline QuantizationReport QuantizeModel(const uint8_t* data, size_t size, std::ostream& output,
+                                          const QuantizationRanges& ranges,
+                                          const QuantizationOptions& options = QuantizationOptions()) {
+    auto model = ParseModel(data, size);
+    QuantizationReport report;
+    report.inputBytes = size;
+    QdqQuantizer quantizer(*model, options);
+    WireWriter writer(output);
+    quantizer.Write(Bytes{ data, size }, ranges, writer, report);
+    report.outputBytes = writer.Size();
+    return report;
+  }
+
+  // Quantizes the model at input and writes the result to output, which must
+  // be a different file. A failed quantization leaves no output behind.
+  inline QuantizationReport QuantizeModel(const std::filesystem::path& input, const std::filesystem::path& output,
+                                          const QuantizationRanges& ranges,
+                                          const QuantizationOptions& options = QuantizationOptions()) {
+    if (std::filesystem::exists(output) && std::filesystem::equivalent(input, output)) {
+      throw std::runtime_error("Onnx: the quantized model cannot replace " + input.string() + ".");
+    }
+    MappedFile file(input);
+    std::ofstream stream(output, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+      throw std::runtime_error("Onnx: could not create " + output.string());
+    }
+    try {
+      QuantizationReport report = QuantizeModel(file.Data(), file.Size(), stream, ranges, options);
+      stream.close();
+      if (!stream) {
+        throw std::runtime_error("Onnx: could not write " + output.string());
+      }
+      return report;
+    }
+    catch (...) {
+      stream.close();
+      std::filesystem::remove(output);
+      throw;
+    }
+  }
+}
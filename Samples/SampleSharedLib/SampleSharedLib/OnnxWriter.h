@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include "OnnxModel.h"
+
+// Protobuf wire format writer for rewriting ONNX models field by field, the
+// counterpart of WireReader.
+//
+// A WireWriter either streams to an std::ostream or, default constructed,
+// only counts the bytes it would write. Nested messages are written in two
+// passes: the body runs once against a counting writer to learn the length
+// prefix, then again against the stream. Bodies therefore have to write the
+// same bytes every time they run, and large payloads are best written with
+// BeginBytes and Raw so that a counting pass skips producing them. Memory use
+// is independent of the size of the model being written.
+namespace Onnx {
+  class WireWriter {
+  public:
+    WireWriter() = default;
+    explicit WireWriter(std::ostream& stream) : m_stream(&stream) {}
+
+    // True when bytes are only counted.
+    bool Counting() const { return m_stream == nullptr; }
+    uint64_t Size() const { return m_size; }
+
+    void Key(uint32_t field, uint32_t wireType) { Varint(static_cast<uint64_t>(field) << 3 | wireType); }
+
+    void Varint(uint64_t value) {
+      uint8_t bytes[10];
+      size_t count = 0;
+      do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        bytes[count++] = static_cast<uint8_t>(value != 0 ? byte | 0x80 : byte);
+      } while (value != 0);
+      Raw(bytes, count);
+    }
+
+    void Int(uint32_t field, int64_t value) {
+      Key(field, WireReader::Varint);
+      Varint(static_cast<uint64_t>(value));
+    }
+
+    void Float(uint32_t field, float value) {
+      Key(field, WireReader::Fixed32);
+      Raw(&value, sizeof(value));
+    }
+
+    void Bytes(uint32_t field, const void* data, size_t size) {
+      BeginBytes(field, size);
+      Raw(data, size);
+    }
+
+    void String(uint32_t field, const std::string& value) { Bytes(field, value.data(), value.size()); }
+
+    // Starts a length-delimited field whose size bytes follow through Raw.
+    void BeginBytes(uint32_t field, uint64_t size) {
+      Key(field, WireReader::LengthDelimited);
+      Varint(size);
+    }
+
+    void Raw(const void* data, size_t size) {
+      if (m_stream != nullptr && size > 0) {
+        m_stream->write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        if (!*m_stream) {
+          throw std::runtime_error("Onnx: could not write the model.");
+        }
+      }
+      m_size += size;
+    }
+
+    // Writes a nested message; body(WireWriter&) writes its fields.
+    template <typename Body> void Message(uint32_t field, const Body& body) {
+      WireWriter counter;
+      body(counter);
+      BeginBytes(field, counter.Size());
+      if (Counting()) {
+        m_size += counter.Size();
+        return;
+      }
+      uint64_t start = m_size;
+      body(*this);
+      if (m_size - start != counter.Size()) {
+        throw std::runtime_error("Onnx: a message wrote different bytes on its second pass.");
+      }
+    }
+
+    // Copies the field reader has just read the key of, unchanged.
+    void Copy(WireReader& reader) {
+      uint32_t field = reader.Field();
+      switch (reader.Type()) {
+      case WireReader::Varint:
+        Int(field, reader.ReadInt());
+        break;
+      case WireReader::Fixed64: {
+        uint64_t value = reader.ReadFixed64();
+        Key(field, WireReader::Fixed64);
+        Raw(&value, sizeof(value));
+        break;
+      }
+      case WireReader::LengthDelimited: {
+        Onnx::Bytes bytes = reader.ReadBytes();
+        Bytes(field, bytes.data, bytes.size);
+        break;
+      }
+      case WireReader::Fixed32: {
+        uint32_t value = reader.ReadFixed32();
+        Key(field, WireReader::Fixed32);
+        Raw(&value, sizeof(value));
+        break;
+      }
+      default:
+        throw std::runtime_error("Onnx: unsupported wire type.");
+      }
+    }
+
+  private:
+    std::ostream* m_stream = nullptr;
+    uint64_t m_size = 0;
+  };
+}
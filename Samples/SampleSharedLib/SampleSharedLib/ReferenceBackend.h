@@ -0,0 +1,1430 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "InferenceBackend.h"
+#include "OnnxExternalData.h"
+#include "OnnxModel.h"
+#include "ReferenceGemm.h"
+
+// Portable CPU backend that executes ONNX graphs with C++ kernels, to run and
+// test harness code off Windows and to check other backends' outputs.
+//
+// Supported operators (default domain): Conv, MaxPool, AveragePool,
+// GlobalAveragePool, GlobalMaxPool, BatchNormalization, Relu, LeakyRelu,
+// Sigmoid, Tanh, Clip, Add, Sub, Mul, Div, Gemm, MatMul, Softmax, Concat,
+// Reshape, Flatten, Squeeze, Unsqueeze, Transpose, Dropout, Identity,
+// Constant, QuantizeLinear and DequantizeLinear. Convolution and pooling are
+// 2-D. Arithmetic is float only; int64 tensors are accepted where they
+// describe shapes. Quantization is simulated: quantized values are held as
+// floats, so a QDQ model computes what its float model computes on the
+// quantized grid. Loading a model with any other operator fails with
+// std::runtime_error.
+//
+// With Options::optimize (the default) the graph is compiled for speed:
+// - Conv runs as im2col plus the packed GEMM of ReferenceGemm.h, with weights
+//   packed once at load and the work split over a worker pool.
+// - A Conv whose only consumer is a Relu stores its result through the Relu.
+// - Intermediate values share buffers: each value takes a buffer whose
+//   previous value is dead by the time it is written. Buffers only grow, so
+//   after the first evaluation a session allocates nothing.
+// Without it every node runs the straightforward kernels below into a buffer
+// of its own, which serves as the oracle for the optimized path. Activations
+// stay NCHW either way.
+namespace InferenceBackend {
+  namespace Reference {
+    struct Options {
+      // Threads for convolution, including the evaluating one; 0 uses every
+      // hardware thread.
+      unsigned threads = 0;
+      bool optimize = true;
+      // Time every node; see ReferenceSession::Profile.
+      bool profile = false;
+    };
+
+    // Cost of one node, accumulated over the evaluations of a session.
+    struct LayerProfile {
+      // The node name, or its first output when the node has no name.
+      std::string name;
+      // "Conv+Relu" for fused nodes.
+      std::string opType;
+      double flops = 0;
+      double milliseconds = 0;
+      uint32_t evaluations = 0;
+    };
+
+    [[noreturn]] inline void Fail(const std::string& message) {
+      throw std::runtime_error("ReferenceBackend: " + message);
+    }
+
+    inline ElementType ToElementType(Onnx::DataType type) {
+      switch (type) {
+      case Onnx::DataType::Float: return ElementType::Float;
+      case Onnx::DataType::Float16: return ElementType::Float16;
+      case Onnx::DataType::Double: return ElementType::Double;
+      case Onnx::DataType::Int8: return ElementType::Int8;
+      case Onnx::DataType::UInt8: return ElementType::UInt8;
+      case Onnx::DataType::Int16: return ElementType::Int16;
+      case Onnx::DataType::UInt16: return ElementType::UInt16;
+      case Onnx::DataType::Int32: return ElementType::Int32;
+      case Onnx::DataType::UInt32: return ElementType::UInt32;
+      case Onnx::DataType::Int64: return ElementType::Int64;
+      case Onnx::DataType::UInt64: return ElementType::UInt64;
+      case Onnx::DataType::Bool: return ElementType::Bool;
+      default: return ElementType::Undefined;
+      }
+    }
+
+    // Initializers become float tensors, except int64 ones, which hold shapes
+    // and axes.
+    inline Tensor ToTensor(const Onnx::Tensor& source) {
+      if (source.external && !source.HasData()) {
+        Fail("initializer " + source.name + " is stored in an external file that is not mapped.");
+      }
+      if (source.dataType == Onnx::DataType::Int64 || source.dataType == Onnx::DataType::Int32) {
+        std::vector<int64_t> values = source.Values<int64_t>();
+        Tensor tensor(ElementType::Int64, source.dims);
+        std::copy(values.begin(), values.end(), tensor.Data<int64_t>());
+        return tensor;
+      }
+      std::vector<float> values = source.Values<float>();
+      Tensor tensor(ElementType::Float, source.dims);
+      std::copy(values.begin(), values.end(), tensor.Data<float>());
+      return tensor;
+    }
+
+    inline int64_t Product(const std::vector<int64_t>& shape, size_t begin, size_t end) {
+      int64_t product = 1;
+      for (size_t i = begin; i < end && i < shape.size(); i++) {
+        product *= shape[i];
+      }
+      return product;
+    }
+
+    // Maps a possibly negative axis into [0, rank).
+    inline size_t NormalizeAxis(int64_t axis, size_t rank) {
+      int64_t normalized = axis < 0 ? axis + static_cast<int64_t>(rank) : axis;
+      if (normalized < 0 || normalized >= static_cast<int64_t>(rank)) {
+        Fail("axis " + std::to_string(axis) + " is out of range.");
+      }
+      return static_cast<size_t>(normalized);
+    }
+
+    inline void RequireFloat(const Tensor& tensor, const char* op) {
+      if (tensor.Type() != ElementType::Float) {
+        Fail(std::string(op) + " only supports float tensors.");
+      }
+    }
+
+    inline std::vector<int64_t> ReadInt64s(const Tensor& tensor) {
+      if (tensor.Type() != ElementType::Int64) {
+        Fail("shape and axes inputs must be int64 tensors.");
+      }
+      return std::vector<int64_t>(tensor.Data<int64_t>(), tensor.Data<int64_t>() + tensor.ElementCount());
+    }
+
+    inline void Copy(const Tensor& input, Tensor& output, const std::vector<int64_t>& shape) {
+      if (&input == &output) {
+        Fail("an operator cannot write its own input.");
+      }
+      output.Reset(input.Type(), shape);
+      memcpy(output.Data(), input.Data(), input.ByteSize());
+    }
+
+    // Window geometry shared by convolution and pooling, for the spatial
+    // dimensions of an NCHW input.
+    struct Window {
+      int64_t kernel[2];
+      int64_t stride[2];
+      int64_t dilation[2];
+      int64_t padBegin[2];
+      int64_t input[2];
+      int64_t output[2];
+    };
+
+    inline Window ComputeWindow(const Onnx::Node& node, const std::vector<int64_t>& inputShape,
+                                const std::vector<int64_t>& kernel, bool ceilMode) {
+      if (inputShape.size() != 4 || kernel.size() != 2) {
+        Fail(node.opType + " only supports 2-D NCHW inputs.");
+      }
+      std::vector<int64_t> strides = node.Ints("strides", { 1, 1 });
+      std::vector<int64_t> dilations = node.Ints("dilations", { 1, 1 });
+      std::vector<int64_t> pads = node.Ints("pads", { 0, 0, 0, 0 });
+      std::string autoPad = node.String("auto_pad", "NOTSET");
+      if (strides.size() != 2 || dilations.size() != 2 || pads.size() != 4) {
+        Fail(node.opType + " has malformed strides, dilations or pads.");
+      }
+
+      Window window;
+      for (int i = 0; i < 2; i++) {
+        window.kernel[i] = kernel[i];
+        window.stride[i] = strides[i];
+        window.dilation[i] = dilations[i];
+        window.input[i] = inputShape[2 + i];
+        int64_t extent = (kernel[i] - 1) * dilations[i] + 1;
+        if (autoPad == "SAME_UPPER" || autoPad == "SAME_LOWER") {
+          window.output[i] = (window.input[i] + strides[i] - 1) / strides[i];
+          int64_t totalPad = (std::max<int64_t>)(0, (window.output[i] - 1) * strides[i] + extent - window.input[i]);
+          window.padBegin[i] = autoPad == "SAME_UPPER" ? totalPad / 2 : totalPad - totalPad / 2;
+        }
+        else {
+          int64_t padBegin = autoPad == "VALID" ? 0 : pads[i];
+          int64_t padEnd = autoPad == "VALID" ? 0 : pads[i + 2];
+          int64_t span = window.input[i] + padBegin + padEnd - extent;
+          if (span < 0) {
+            Fail(node.opType + " window is larger than its padded input.");
+          }
+          window.output[i] = (ceilMode ? (span + strides[i] - 1) / strides[i] : span / strides[i]) + 1;
+          // A window may not start in the end padding.
+          if (ceilMode && (window.output[i] - 1) * strides[i] >= window.input[i] + padBegin) {
+            window.output[i]--;
+          }
+          window.padBegin[i] = padBegin;
+        }
+      }
+      return window;
+    }
+
+    // Checks the operands of a Conv node and sizes its output.
+    inline Window PrepareConv(const Onnx::Node& node, const Tensor& x, const Tensor& w, Tensor& y) {
+      RequireFloat(x, "Conv");
+      RequireFloat(w, "Conv");
+      const auto& xShape = x.Shape();
+      const auto& wShape = w.Shape();
+      if (wShape.size() != 4) {
+        Fail("Conv only supports 2-D kernels.");
+      }
+      int64_t group = node.Int("group", 1);
+      if (xShape.size() != 4 || group <= 0 || xShape[1] != wShape[1] * group || wShape[0] % group != 0) {
+        Fail("Conv input channels do not match its weights and group.");
+      }
+      Window window = ComputeWindow(node, xShape, node.Ints("kernel_shape", { wShape[2], wShape[3] }), false);
+      y.Reset(ElementType::Float, { xShape[0], wShape[0], window.output[0], window.output[1] });
+      return window;
+    }
+
+    inline void Conv(const Onnx::Node& node, const Tensor& x, const Tensor& w, const Tensor* bias, Tensor& y) {
+      Window window = PrepareConv(node, x, w, y);
+      const int64_t batch = x.Shape()[0];
+      const int64_t inputChannels = x.Shape()[1];
+      const int64_t outputChannels = w.Shape()[0];
+      const int64_t groupInputChannels = w.Shape()[1];
+      const int64_t inputPlane = window.input[0] * window.input[1];
+      const int64_t outputPlane = window.output[0] * window.output[1];
+      const int64_t groupOutputChannels = outputChannels / node.Int("group", 1);
+      const float* input = x.Data<float>();
+      const float* weights = w.Data<float>();
+      float* output = y.Data<float>();
+      for (int64_t n = 0; n < batch; n++) {
+        for (int64_t m = 0; m < outputChannels; m++) {
+          float* outputChannel = output + (n * outputChannels + m) * outputPlane;
+          std::fill(outputChannel, outputChannel + outputPlane, bias != nullptr ? bias->Data<float>()[m] : 0.0f);
+          int64_t firstChannel = (m / groupOutputChannels) * groupInputChannels;
+          for (int64_t c = 0; c < groupInputChannels; c++) {
+            const float* inputChannel = input + (n * inputChannels + firstChannel + c) * inputPlane;
+            const float* kernel = weights + (m * groupInputChannels + c) * window.kernel[0] * window.kernel[1];
+            for (int64_t kh = 0; kh < window.kernel[0]; kh++) {
+              for (int64_t kw = 0; kw < window.kernel[1]; kw++) {
+                float weight = kernel[kh * window.kernel[1] + kw];
+                for (int64_t oh = 0; oh < window.output[0]; oh++) {
+                  int64_t ih = oh * window.stride[0] - window.padBegin[0] + kh * window.dilation[0];
+                  if (ih < 0 || ih >= window.input[0]) {
+                    continue;
+                  }
+                  const float* inputRow = inputChannel + ih * window.input[1];
+                  float* outputRow = outputChannel + oh * window.output[1];
+                  for (int64_t ow = 0; ow < window.output[1]; ow++) {
+                    int64_t iw = ow * window.stride[1] - window.padBegin[1] + kw * window.dilation[1];
+                    if (iw >= 0 && iw < window.input[1]) {
+                      outputRow[ow] += weight * inputRow[iw];
+                    }
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+
+    // Packs Conv weights for Gemm, one run of left panels per group.
+    inline std::vector<float> PackConvWeights(const Tensor& w, int64_t group) {
+      int64_t groupOutputChannels = w.Shape()[0] / group;
+      int64_t depth = static_cast<int64_t>(w.ElementCount()) / w.Shape()[0];
+      std::vector<float> packed;
+      for (int64_t g = 0; g < group; g++) {
+        std::vector<float> panels =
+          PackGemmLeft(w.Data<float>() + g * groupOutputChannels * depth, groupOutputChannels, depth);
+        packed.insert(packed.end(), panels.begin(), panels.end());
+      }
+      return packed;
+    }
+
+    // Conv as one GEMM per image and group: the packed weights times the
+    // im2col expansion of the input, which 1x1 convolutions without stride or
+    // padding skip. Bias and the fused Relu are applied as results are
+    // stored. columns is scratch space for im2col.
+    inline void PackedConv(const Onnx::Node& node, const Tensor& x, const Tensor& w,
+                           const std::vector<float>& packedWeights, const Tensor* bias, bool relu, Tensor& y,
+                           std::vector<float>& columns, WorkerPool& pool) {
+      Window window = PrepareConv(node, x, w, y);
+      const int64_t group = node.Int("group", 1);
+      const int64_t batch = x.Shape()[0];
+      const int64_t groupInputChannels = w.Shape()[1];
+      const int64_t groupOutputChannels = w.Shape()[0] / group;
+      const int64_t depth = groupInputChannels * window.kernel[0] * window.kernel[1];
+      const int64_t inputPlane = window.input[0] * window.input[1];
+      const int64_t outputPlane = window.output[0] * window.output[1];
+      const int64_t groupPanels = (groupOutputChannels + GemmRows - 1) / GemmRows * depth * GemmRows;
+      bool direct = window.kernel[0] == 1 && window.kernel[1] == 1 && window.stride[0] == 1 &&
+                    window.stride[1] == 1 && window.padBegin[0] == 0 && window.padBegin[1] == 0 &&
+                    outputPlane == inputPlane;
+      if (!direct) {
+        columns.resize(static_cast<size_t>(depth * outputPlane));
+      }
+      const float* biasData = bias != nullptr ? bias->Data<float>() : nullptr;
+      for (int64_t n = 0; n < batch; n++) {
+        for (int64_t g = 0; g < group; g++) {
+          const float* input = x.Data<float>() + (n * group + g) * groupInputChannels * inputPlane;
+          if (!direct) {
+            Im2Col(input, groupInputChannels, window.input, window.kernel, window.stride, window.dilation,
+                   window.padBegin, window.output, columns.data(), pool);
+          }
+          Gemm(packedWeights.data() + g * groupPanels, groupOutputChannels, depth, direct ? input : columns.data(),
+               outputPlane, outputPlane, y.Data<float>() + (n * group + g) * groupOutputChannels * outputPlane,
+               outputPlane, biasData != nullptr ? biasData + g * groupOutputChannels : nullptr, relu, pool);
+        }
+      }
+    }
+
+    inline void Pool(const Onnx::Node& node, const Tensor& x, Tensor& y, bool isMax) {
+      RequireFloat(x, node.opType.c_str());
+      const auto& xShape = x.Shape();
+      Window window = ComputeWindow(node, xShape, node.Ints("kernel_shape"), node.Int("ceil_mode", 0) != 0);
+      bool countIncludePad = node.Int("count_include_pad", 0) != 0;
+      y.Reset(ElementType::Float, { xShape[0], xShape[1], window.output[0], window.output[1] });
+
+      const int64_t inputPlane = window.input[0] * window.input[1];
+      const int64_t outputPlane = window.output[0] * window.output[1];
+      for (int64_t plane = 0; plane < xShape[0] * xShape[1]; plane++) {
+        const float* input = x.Data<float>() + plane * inputPlane;
+        float* output = y.Data<float>() + plane * outputPlane;
+        for (int64_t oh = 0; oh < window.output[0]; oh++) {
+          for (int64_t ow = 0; ow < window.output[1]; ow++) {
+            float value = isMax ? -std::numeric_limits<float>::infinity() : 0.0f;
+            int64_t count = 0;
+            for (int64_t kh = 0; kh < window.kernel[0]; kh++) {
+              int64_t ih = oh * window.stride[0] - window.padBegin[0] + kh * window.dilation[0];
+              for (int64_t kw = 0; kw < window.kernel[1]; kw++) {
+                int64_t iw = ow * window.stride[1] - window.padBegin[1] + kw * window.dilation[1];
+                if (ih < 0 || ih >= window.input[0] || iw < 0 || iw >= window.input[1]) {
+                  // Padding inside the padded input still counts with count_include_pad.
+                  if (countIncludePad && ih < window.input[0] + window.padBegin[0] &&
+                      iw < window.input[1] + window.padBegin[1]) {
+                    count++;
+                  }
+                  continue;
+                }
+                float element = input[ih * window.input[1] + iw];
+                value = isMax ? (std::max)(value, element) : value + element;
+                count++;
+              }
+            }
+            output[oh * window.output[1] + ow] = isMax ? value : (count > 0 ? value / count : 0.0f);
+          }
+        }
+      }
+    }
+
+    inline void GlobalPool(const Tensor& x, Tensor& y, bool isMax) {
+      RequireFloat(x, "GlobalPool");
+      const auto& xShape = x.Shape();
+      if (xShape.size() < 3) {
+        Fail("global pooling needs an N x C x spatial input.");
+      }
+      std::vector<int64_t> shape(xShape.size(), 1);
+      shape[0] = xShape[0];
+      shape[1] = xShape[1];
+      y.Reset(ElementType::Float, shape);
+      int64_t spatial = Product(xShape, 2, xShape.size());
+      for (int64_t plane = 0; plane < xShape[0] * xShape[1]; plane++) {
+        const float* input = x.Data<float>() + plane * spatial;
+        float value = isMax ? -std::numeric_limits<float>::infinity() : 0.0f;
+        for (int64_t i = 0; i < spatial; i++) {
+          value = isMax ? (std::max)(value, input[i]) : value + input[i];
+        }
+        y.Data<float>()[plane] = isMax ? value : value / spatial;
+      }
+    }
+
+    inline void BatchNormalization(const Onnx::Node& node, const Tensor& x, const Tensor& scale, const Tensor& bias,
+                                   const Tensor& mean, const Tensor& variance, Tensor& y) {
+      RequireFloat(x, "BatchNormalization");
+      const auto& xShape = x.Shape();
+      float epsilon = node.Float("epsilon", 1e-5f);
+      y.Reset(ElementType::Float, xShape);
+      int64_t channels = xShape.size() > 1 ? xShape[1] : 1;
+      int64_t spatial = Product(xShape, 2, xShape.size());
+      for (int64_t n = 0; n < xShape[0]; n++) {
+        for (int64_t c = 0; c < channels; c++) {
+          float multiplier = scale.Data<float>()[c] / std::sqrt(variance.Data<float>()[c] + epsilon);
+          float offset = bias.Data<float>()[c] - mean.Data<float>()[c] * multiplier;
+          const float* input = x.Data<float>() + (n * channels + c) * spatial;
+          float* output = y.Data<float>() + (n * channels + c) * spatial;
+          for (int64_t i = 0; i < spatial; i++) {
+            output[i] = input[i] * multiplier + offset;
+          }
+        }
+      }
+    }
+
+    template <typename Function> void Unary(const Tensor& x, Tensor& y, const char* op, Function function) {
+      RequireFloat(x, op);
+      y.Reset(ElementType::Float, x.Shape());
+      const float* input = x.Data<float>();
+      float* output = y.Data<float>();
+      for (size_t i = 0; i < x.ElementCount(); i++) {
+        output[i] = function(input[i]);
+      }
+    }
+
+    // Numpy-style broadcasting of two float tensors.
+    template <typename Function>
+    void Binary(const Tensor& a, const Tensor& b, Tensor& y, const char* op, Function function) {
+      RequireFloat(a, op);
+      RequireFloat(b, op);
+      const auto& aShape = a.Shape();
+      const auto& bShape = b.Shape();
+      size_t rank = (std::max)(aShape.size(), bShape.size());
+      std::vector<int64_t> shape(rank);
+      std::vector<int64_t> aDims(rank, 1);
+      std::vector<int64_t> bDims(rank, 1);
+      std::copy(aShape.begin(), aShape.end(), aDims.begin() + (rank - aShape.size()));
+      std::copy(bShape.begin(), bShape.end(), bDims.begin() + (rank - bShape.size()));
+      for (size_t i = 0; i < rank; i++) {
+        if (aDims[i] != bDims[i] && aDims[i] != 1 && bDims[i] != 1) {
+          Fail(std::string(op) + " inputs cannot be broadcast together.");
+        }
+        shape[i] = aDims[i] == 1 ? bDims[i] : aDims[i];
+      }
+      y.Reset(ElementType::Float, shape);
+      const float* aData = a.Data<float>();
+      const float* bData = b.Data<float>();
+      float* output = y.Data<float>();
+      size_t count = y.ElementCount();
+
+      if (aDims == bDims) {
+        for (size_t i = 0; i < count; i++) {
+          output[i] = function(aData[i], bData[i]);
+        }
+        return;
+      }
+      if (b.ElementCount() == 1) {
+        for (size_t i = 0; i < count; i++) {
+          output[i] = function(aData[i], bData[0]);
+        }
+        return;
+      }
+
+      // Strides of 0 repeat a broadcast dimension.
+      std::vector<int64_t> aStrides(rank, 0);
+      std::vector<int64_t> bStrides(rank, 0);
+      for (int64_t i = static_cast<int64_t>(rank) - 1, aStride = 1, bStride = 1; i >= 0; i--) {
+        aStrides[i] = aDims[i] == 1 ? 0 : aStride;
+        bStrides[i] = bDims[i] == 1 ? 0 : bStride;
+        aStride *= aDims[i];
+        bStride *= bDims[i];
+      }
+      std::vector<int64_t> index(rank, 0);
+      int64_t aOffset = 0;
+      int64_t bOffset = 0;
+      for (size_t i = 0; i < count; i++) {
+        output[i] = function(aData[aOffset], bData[bOffset]);
+        for (int64_t dim = static_cast<int64_t>(rank) - 1; dim >= 0; dim--) {
+          aOffset += aStrides[dim];
+          bOffset += bStrides[dim];
+          if (++index[dim] < shape[dim]) {
+            break;
+          }
+          aOffset -= aStrides[dim] * shape[dim];
+          bOffset -= bStrides[dim] * shape[dim];
+          index[dim] = 0;
+        }
+      }
+    }
+
+    // output[m][n] = sum_k a[m][k] * b[k][n], with a and b optionally
+    // transposed. output must not alias the inputs.
+    inline void MatrixMultiply(const float* a, const float* b, float* output, int64_t m, int64_t n, int64_t k,
+                               bool transposeA, bool transposeB, float alpha) {
+      for (int64_t row = 0; row < m; row++) {
+        float* outputRow = output + row * n;
+        std::fill(outputRow, outputRow + n, 0.0f);
+        for (int64_t inner = 0; inner < k; inner++) {
+          float aValue = alpha * (transposeA ? a[inner * m + row] : a[row * k + inner]);
+          if (transposeB) {
+            for (int64_t column = 0; column < n; column++) {
+              outputRow[column] += aValue * b[column * k + inner];
+            }
+          }
+          else {
+            const float* bRow = b + inner * n;
+            for (int64_t column = 0; column < n; column++) {
+              outputRow[column] += aValue * bRow[column];
+            }
+          }
+        }
+      }
+    }
+
+    inline void Gemm(const Onnx::Node& node, const Tensor& a, const Tensor& b, const Tensor* c, Tensor& y) {
+      RequireFloat(a, "Gemm");
+      RequireFloat(b, "Gemm");
+      bool transposeA = node.Int("transA", 0) != 0;
+      bool transposeB = node.Int("transB", 0) != 0;
+      float alpha = node.Float("alpha", 1.0f);
+      float beta = node.Float("beta", 1.0f);
+      if (a.Shape().size() != 2 || b.Shape().size() != 2) {
+        Fail("Gemm inputs must be matrices.");
+      }
+      int64_t m = transposeA ? a.Shape()[1] : a.Shape()[0];
+      int64_t k = transposeA ? a.Shape()[0] : a.Shape()[1];
+      int64_t n = transposeB ? b.Shape()[0] : b.Shape()[1];
+      if ((transposeB ? b.Shape()[1] : b.Shape()[0]) != k) {
+        Fail("Gemm inner dimensions do not match.");
+      }
+      y.Reset(ElementType::Float, { m, n });
+      MatrixMultiply(a.Data<float>(), b.Data<float>(), y.Data<float>(), m, n, k, transposeA, transposeB, alpha);
+      if (c != nullptr && beta != 0.0f) {
+        Tensor product;
+        Copy(y, product, y.Shape());
+        Tensor scaledC(ElementType::Float, c->Shape());
+        for (size_t i = 0; i < c->ElementCount(); i++) {
+          scaledC.Data<float>()[i] = beta * c->Data<float>()[i];
+        }
+        Binary(product, scaledC, y, "Gemm", [](float p, float q) { return p + q; });
+      }
+    }
+
+    inline void MatMul(const Tensor& a, const Tensor& b, Tensor& y) {
+      RequireFloat(a, "MatMul");
+      RequireFloat(b, "MatMul");
+      std::vector<int64_t> aShape = a.Shape();
+      std::vector<int64_t> bShape = b.Shape();
+      bool vectorA = aShape.size() == 1;
+      bool vectorB = bShape.size() == 1;
+      if (vectorA) {
+        aShape.insert(aShape.begin(), 1);
+      }
+      if (vectorB) {
+        bShape.push_back(1);
+      }
+      int64_t m = aShape[aShape.size() - 2];
+      int64_t k = aShape.back();
+      int64_t n = bShape.back();
+      if (bShape[bShape.size() - 2] != k) {
+        Fail("MatMul inner dimensions do not match.");
+      }
+
+      // Broadcast the leading (batch) dimensions.
+      size_t batchRank = (std::max)(aShape.size(), bShape.size()) - 2;
+      std::vector<int64_t> aBatch(batchRank, 1);
+      std::vector<int64_t> bBatch(batchRank, 1);
+      std::copy(aShape.begin(), aShape.end() - 2, aBatch.begin() + (batchRank - (aShape.size() - 2)));
+      std::copy(bShape.begin(), bShape.end() - 2, bBatch.begin() + (batchRank - (bShape.size() - 2)));
+      std::vector<int64_t> shape;
+      for (size_t i = 0; i < batchRank; i++) {
+        if (aBatch[i] != bBatch[i] && aBatch[i] != 1 && bBatch[i] != 1) {
+          Fail("MatMul batch dimensions cannot be broadcast together.");
+        }
+        shape.push_back((std::max)(aBatch[i], bBatch[i]));
+      }
+      int64_t batches = Product(shape, 0, shape.size());
+      if (!vectorA) {
+        shape.push_back(m);
+      }
+      if (!vectorB) {
+        shape.push_back(n);
+      }
+      y.Reset(ElementType::Float, shape);
+
+      std::vector<int64_t> index(batchRank, 0);
+      for (int64_t batch = 0; batch < batches; batch++) {
+        int64_t aOffset = 0;
+        int64_t bOffset = 0;
+        for (size_t i = 0; i < batchRank; i++) {
+          aOffset = aOffset * aBatch[i] + (aBatch[i] == 1 ? 0 : index[i]);
+          bOffset = bOffset * bBatch[i] + (bBatch[i] == 1 ? 0 : index[i]);
+        }
+        MatrixMultiply(a.Data<float>() + aOffset * m * k, b.Data<float>() + bOffset * k * n,
+                       y.Data<float>() + batch * m * n, m, n, k, false, false, 1.0f);
+        for (int64_t dim = static_cast<int64_t>(batchRank) - 1; dim >= 0; dim--) {
+          if (++index[dim] < (std::max)(aBatch[dim], bBatch[dim])) {
+            break;
+          }
+          index[dim] = 0;
+        }
+      }
+    }
+
+    inline void Softmax(const Onnx::Node& node, int64_t opset, const Tensor& x, Tensor& y) {
+      RequireFloat(x, "Softmax");
+      const auto& shape = x.Shape();
+      y.Reset(ElementType::Float, shape);
+      // Before opset 13 the input is flattened to 2-D at axis; from 13 on only
+      // the axis itself is normalized.
+      size_t axis = NormalizeAxis(node.Int("axis", opset >= 13 ? -1 : 1), shape.size());
+      int64_t outer = Product(shape, 0, axis);
+      int64_t length = opset >= 13 ? shape[axis] : Product(shape, axis, shape.size());
+      int64_t inner = opset >= 13 ? Product(shape, axis + 1, shape.size()) : 1;
+      for (int64_t o = 0; o < outer; o++) {
+        for (int64_t i = 0; i < inner; i++) {
+          const float* input = x.Data<float>() + o * length * inner + i;
+          float* output = y.Data<float>() + o * length * inner + i;
+          float maximum = -std::numeric_limits<float>::infinity();
+          for (int64_t j = 0; j < length; j++) {
+            maximum = (std::max)(maximum, input[j * inner]);
+          }
+          float sum = 0.0f;
+          for (int64_t j = 0; j < length; j++) {
+            output[j * inner] = std::exp(input[j * inner] - maximum);
+            sum += output[j * inner];
+          }
+          for (int64_t j = 0; j < length; j++) {
+            output[j * inner] /= sum;
+          }
+        }
+      }
+    }
+
+    inline float ElementAsFloat(const Tensor& tensor, size_t i) {
+      return tensor.Type() == ElementType::Int64 ? static_cast<float>(tensor.Data<int64_t>()[i])
+                                                 : tensor.Data<float>()[i];
+    }
+
+    // QuantizeLinear (rounding half to even and saturating to [low, high]) or
+    // DequantizeLinear, with one scale and zero point or one per channel of
+    // axis.
+    inline void Quantize(const Onnx::Node& node, bool dequantize, float low, float high, const Tensor& x,
+                         const Tensor& scale, const Tensor* zeroPoint, Tensor& y) {
+      if ((x.Type() != ElementType::Float && x.Type() != ElementType::Int64) ||
+          (zeroPoint != nullptr && zeroPoint->ElementCount() != scale.ElementCount())) {
+        Fail(node.opType + " has inputs of the wrong type or size.");
+      }
+      const auto& shape = x.Shape();
+      size_t channels = scale.ElementCount();
+      int64_t inner = static_cast<int64_t>(x.ElementCount());
+      if (channels > 1) {
+        size_t axis = NormalizeAxis(node.Int("axis", 1), shape.size());
+        if (shape[axis] != static_cast<int64_t>(channels)) {
+          Fail(node.opType + " has " + std::to_string(channels) + " scales for an axis of " +
+               std::to_string(shape[axis]) + ".");
+        }
+        inner = Product(shape, axis + 1, shape.size());
+      }
+      y.Reset(ElementType::Float, shape);
+      float* output = y.Data<float>();
+      for (size_t i = 0; i < x.ElementCount(); i++) {
+        size_t channel = channels > 1 ? (i / static_cast<size_t>(inner)) % channels : 0;
+        float s = ElementAsFloat(scale, channel);
+        float z = zeroPoint != nullptr ? ElementAsFloat(*zeroPoint, channel) : 0.0f;
+        float value = ElementAsFloat(x, i);
+        output[i] = dequantize ? (value - z) * s : (std::min)((std::max)(std::nearbyint(value / s) + z, low), high);
+      }
+    }
+
+    inline void Concat(const Onnx::Node& node, const std::vector<const Tensor*>& inputs, Tensor& y) {
+      std::vector<int64_t> shape = inputs.front()->Shape();
+      size_t axis = NormalizeAxis(node.Int("axis", 1), shape.size());
+      shape[axis] = 0;
+      for (const Tensor* input : inputs) {
+        if (input->Shape().size() != shape.size() || input->Type() != inputs.front()->Type()) {
+          Fail("Concat inputs must have the same rank and type.");
+        }
+        shape[axis] += input->Shape()[axis];
+      }
+      y.Reset(inputs.front()->Type(), shape);
+      size_t elementSize = ElementSize(y.Type());
+      int64_t outer = Product(shape, 0, axis);
+      int64_t inner = Product(shape, axis + 1, shape.size());
+      uint8_t* output = static_cast<uint8_t*>(y.Data());
+      for (int64_t o = 0; o < outer; o++) {
+        for (const Tensor* input : inputs) {
+          size_t bytes = static_cast<size_t>(input->Shape()[axis] * inner) * elementSize;
+          memcpy(output, static_cast<const uint8_t*>(input->Data()) + o * bytes, bytes);
+          output += bytes;
+        }
+      }
+    }
+
+    inline void Transpose(const Onnx::Node& node, const Tensor& x, Tensor& y) {
+      const auto& xShape = x.Shape();
+      size_t rank = xShape.size();
+      std::vector<int64_t> perm = node.Ints("perm");
+      if (perm.empty()) {
+        for (size_t i = 0; i < rank; i++) {
+          perm.push_back(static_cast<int64_t>(rank - 1 - i));
+        }
+      }
+      if (perm.size() != rank) {
+        Fail("Transpose perm does not match the input rank.");
+      }
+      std::vector<int64_t> shape(rank);
+      std::vector<int64_t> inputStrides(rank);
+      for (int64_t i = static_cast<int64_t>(rank) - 1, stride = 1; i >= 0; i--) {
+        inputStrides[i] = stride;
+        stride *= xShape[i];
+      }
+      std::vector<int64_t> strides(rank);
+      for (size_t i = 0; i < rank; i++) {
+        shape[i] = xShape[perm[i]];
+        strides[i] = inputStrides[perm[i]];
+      }
+      y.Reset(x.Type(), shape);
+      size_t elementSize = ElementSize(x.Type());
+      const uint8_t* input = static_cast<const uint8_t*>(x.Data());
+      uint8_t* output = static_cast<uint8_t*>(y.Data());
+      std::vector<int64_t> index(rank, 0);
+      int64_t offset = 0;
+      for (size_t i = 0; i < y.ElementCount(); i++) {
+        memcpy(output + i * elementSize, input + offset * elementSize, elementSize);
+        for (int64_t dim = static_cast<int64_t>(rank) - 1; dim >= 0; dim--) {
+          offset += strides[dim];
+          if (++index[dim] < shape[dim]) {
+            break;
+          }
+          offset -= strides[dim] * shape[dim];
+          index[dim] = 0;
+        }
+      }
+    }
+
+    inline std::vector<int64_t> ReshapeTarget(const Onnx::Node& node, const std::vector<int64_t>& inputShape,
+                                              std::vector<int64_t> shape) {
+      bool allowZero = node.Int("allowzero", 0) != 0;
+      int64_t known = 1;
+      int64_t inferred = -1;
+      for (size_t i = 0; i < shape.size(); i++) {
+        if (shape[i] == 0 && !allowZero) {
+          if (i >= inputShape.size()) {
+            Fail("Reshape copies a dimension the input does not have.");
+          }
+          shape[i] = inputShape[i];
+        }
+        if (shape[i] == -1) {
+          if (inferred >= 0) {
+            Fail("Reshape can infer only one dimension.");
+          }
+          inferred = static_cast<int64_t>(i);
+        }
+        else {
+          known *= shape[i];
+        }
+      }
+      int64_t count = Product(inputShape, 0, inputShape.size());
+      if (inferred >= 0) {
+        if (known == 0 || count % known != 0) {
+          Fail("Reshape cannot infer a dimension.");
+        }
+        shape[inferred] = count / known;
+      }
+      else if (known != count) {
+        Fail("Reshape changes the number of elements.");
+      }
+      return shape;
+    }
+
+    inline std::vector<int64_t> Unsqueezed(const std::vector<int64_t>& inputShape, const std::vector<int64_t>& axes) {
+      size_t rank = inputShape.size() + axes.size();
+      std::vector<bool> inserted(rank, false);
+      for (int64_t axis : axes) {
+        inserted[NormalizeAxis(axis, rank)] = true;
+      }
+      std::vector<int64_t> shape;
+      size_t next = 0;
+      for (size_t i = 0; i < rank; i++) {
+        shape.push_back(inserted[i] ? 1 : inputShape.at(next++));
+      }
+      return shape;
+    }
+
+    inline std::vector<int64_t> Squeezed(const std::vector<int64_t>& inputShape, const std::vector<int64_t>& axes) {
+      std::vector<bool> removed(inputShape.size(), axes.empty());
+      for (int64_t axis : axes) {
+        removed[NormalizeAxis(axis, inputShape.size())] = true;
+      }
+      std::vector<int64_t> shape;
+      for (size_t i = 0; i < inputShape.size(); i++) {
+        if (!removed[i] || inputShape[i] != 1) {
+          if (!axes.empty() && removed[i]) {
+            Fail("Squeeze removes a dimension that is not 1.");
+          }
+          shape.push_back(inputShape[i]);
+        }
+      }
+      return shape;
+    }
+
+    enum class Op {
+      Conv,
+      MaxPool,
+      AveragePool,
+      GlobalAveragePool,
+      GlobalMaxPool,
+      BatchNormalization,
+      Relu,
+      LeakyRelu,
+      Sigmoid,
+      Tanh,
+      Clip,
+      Add,
+      Sub,
+      Mul,
+      Div,
+      Gemm,
+      MatMul,
+      Softmax,
+      Concat,
+      Reshape,
+      Flatten,
+      Squeeze,
+      Unsqueeze,
+      Transpose,
+      Identity,
+      QuantizeLinear,
+      DequantizeLinear
+    };
+
+    inline bool ParseOp(const std::string& opType, Op& op) {
+      static const std::unordered_map<std::string, Op> ops = {
+        { "Conv", Op::Conv },
+        { "MaxPool", Op::MaxPool },
+        { "AveragePool", Op::AveragePool },
+        { "GlobalAveragePool", Op::GlobalAveragePool },
+        { "GlobalMaxPool", Op::GlobalMaxPool },
+        { "BatchNormalization", Op::BatchNormalization },
+        { "Relu", Op::Relu },
+        { "LeakyRelu", Op::LeakyRelu },
+        { "Sigmoid", Op::Sigmoid },
+        { "Tanh", Op::Tanh },
+        { "Clip", Op::Clip },
+        { "Add", Op::Add },
+        { "Sub", Op::Sub },
+        { "Mul", Op::Mul },
+        { "Div", Op::Div },
+        { "Gemm", Op::Gemm },
+        { "MatMul", Op::MatMul },
+        { "Softmax", Op::Softmax },
+        { "Concat", Op::Concat },
+        { "Reshape", Op::Reshape },
+        { "Flatten", Op::Flatten },
+        { "Squeeze", Op::Squeeze },
+        { "Unsqueeze", Op::Unsqueeze },
+        { "Transpose", Op::Transpose },
+        { "Dropout", Op::Identity },
+        { "Identity", Op::Identity },
+        { "QuantizeLinear", Op::QuantizeLinear },
+        { "DequantizeLinear", Op::DequantizeLinear },
+      };
+      auto it = ops.find(opType);
+      if (it == ops.end()) {
+        return false;
+      }
+      op = it->second;
+      return true;
+    }
+
+    // A node with its inputs and outputs resolved to value indices. Missing
+    // optional inputs are -1.
+    struct Step {
+      Op op;
+      Onnx::Node node;
+      std::vector<int> inputs;
+      std::vector<int> outputs;
+      // Conv only: the Relu that consumed the output is applied in place.
+      bool fuseRelu = false;
+      // Conv only: constant weights in PackConvWeights layout, or empty.
+      std::vector<float> packedWeights;
+      // QuantizeLinear only: the range of the quantized type.
+      float low = 0.0f;
+      float high = 255.0f;
+    };
+
+    // The compiled graph shared by every session of a model.
+    struct Program {
+      Options options;
+      int64_t opset = 0;
+      size_t valueCount = 0;
+      // Indexed by value.
+      std::vector<std::string> names;
+      // Indexed by value; null for values computed at evaluation time.
+      std::vector<std::shared_ptr<const Tensor>> constants;
+      // Indexed by value; the session buffer that holds it, or -1 for
+      // constants.
+      std::vector<int> buffers;
+      size_t bufferCount = 0;
+      std::vector<Step> steps;
+      std::vector<ValueInfo> inputs;
+      std::vector<ValueInfo> outputs;
+      std::vector<int> inputValues;
+      std::vector<int> outputValues;
+    };
+
+    inline std::vector<int64_t> ToShape(const Onnx::ValueInfo& info) {
+      std::vector<int64_t> shape;
+      for (const auto& dim : info.shape) {
+        shape.push_back(dim.value > 0 ? dim.value : -1);
+      }
+      return shape;
+    }
+
+    // Folds every Conv whose output is read by a single Relu, and by nothing
+    // else, into that Relu.
+    inline void FuseConvRelu(Program& program) {
+      std::vector<int> readers(program.valueCount, 0);
+      for (const auto& step : program.steps) {
+        for (int input : step.inputs) {
+          if (input >= 0) {
+            readers[input]++;
+          }
+        }
+      }
+      for (int output : program.outputValues) {
+        readers[output]++;
+      }
+      std::vector<Step> steps;
+      std::unordered_map<int, size_t> pendingConvs;
+      for (auto& step : program.steps) {
+        if (step.op == Op::Relu && step.inputs.size() == 1 && step.inputs[0] >= 0) {
+          auto conv = pendingConvs.find(step.inputs[0]);
+          if (conv != pendingConvs.end()) {
+            steps[conv->second].fuseRelu = true;
+            steps[conv->second].outputs[0] = step.outputs.at(0);
+            continue;
+          }
+        }
+        if (step.op == Op::Conv && step.outputs.size() == 1 && step.outputs[0] >= 0 &&
+            readers[step.outputs[0]] == 1) {
+          pendingConvs[step.outputs[0]] = steps.size();
+        }
+        steps.push_back(std::move(step));
+      }
+      program.steps = std::move(steps);
+    }
+
+    // Assigns every value computed at evaluation time a session buffer. Graph
+    // inputs and outputs keep a buffer of their own; any other value reuses a
+    // buffer whose last reader ran before the value is written.
+    inline void PlanBuffers(Program& program, bool share) {
+      std::vector<int>& buffers = program.buffers;
+      buffers.assign(program.valueCount, -1);
+      std::vector<int> lastRead(program.valueCount, -1);
+      std::vector<bool> pinned(program.valueCount, !share);
+      for (size_t i = 0; i < program.steps.size(); i++) {
+        for (int input : program.steps[i].inputs) {
+          if (input >= 0) {
+            lastRead[input] = static_cast<int>(i);
+          }
+        }
+      }
+      std::vector<int> free;
+      auto assign = [&](int value, bool reuse) {
+        if (buffers[value] >= 0 || program.constants[value] != nullptr) {
+          return;
+        }
+        if (reuse && !free.empty()) {
+          buffers[value] = free.back();
+          free.pop_back();
+        }
+        else {
+          buffers[value] = static_cast<int>(program.bufferCount++);
+        }
+      };
+      auto release = [&](int value) {
+        if (buffers[value] >= 0 && !pinned[value]) {
+          free.push_back(buffers[value]);
+          pinned[value] = true;
+        }
+      };
+
+      for (int value : program.inputValues) {
+        assign(value, false);
+        pinned[value] = true;
+      }
+      for (int value : program.outputValues) {
+        pinned[value] = true;
+      }
+      for (size_t i = 0; i < program.steps.size(); i++) {
+        const Step& step = program.steps[i];
+        // Values read without ever being written stay empty.
+        for (int input : step.inputs) {
+          if (input >= 0 && buffers[input] < 0 && program.constants[input] == nullptr) {
+            assign(input, false);
+            pinned[input] = true;
+          }
+        }
+        for (int output : step.outputs) {
+          if (output >= 0) {
+            assign(output, true);
+          }
+        }
+        // Inputs are released after the outputs are placed, so that no
+        // operator writes over its own input.
+        for (int input : step.inputs) {
+          if (input >= 0 && lastRead[input] == static_cast<int>(i)) {
+            release(input);
+          }
+        }
+        for (int output : step.outputs) {
+          if (output >= 0 && lastRead[output] < 0) {
+            release(output);
+          }
+        }
+      }
+    }
+
+    inline std::shared_ptr<const Program> Compile(const Onnx::Model& model, const Options& options = {}) {
+      auto program = std::make_shared<Program>();
+      program->options = options;
+      program->opset = model.Opset();
+      std::unordered_map<std::string, int> values;
+      auto valueIndex = [&](const std::string& name) {
+        auto it = values.find(name);
+        if (it != values.end()) {
+          return it->second;
+        }
+        int index = static_cast<int>(program->constants.size());
+        values.emplace(name, index);
+        program->constants.push_back(nullptr);
+        program->names.push_back(name);
+        return index;
+      };
+
+      for (const auto& initializer : model.graph.initializers) {
+        int index = valueIndex(initializer.name);
+        program->constants[index] = std::make_shared<Tensor>(ToTensor(initializer));
+      }
+      for (const Onnx::ValueInfo* input : model.Inputs()) {
+        program->inputValues.push_back(valueIndex(input->name));
+        program->inputs.push_back({ input->name, ToElementType(input->elementType), ToShape(*input) });
+      }
+
+      for (const auto& node : model.graph.nodes) {
+        if (!node.domain.empty() && node.domain != "ai.onnx") {
+          Fail("operator " + node.domain + "." + node.opType + " is not supported.");
+        }
+        if (node.opType == "Constant") {
+          const Onnx::Attribute* value = node.Find("value");
+          if (value == nullptr || value->t == nullptr || node.outputs.size() != 1) {
+            Fail("only Constant nodes with a tensor value are supported.");
+          }
+          program->constants[valueIndex(node.outputs[0])] = std::make_shared<Tensor>(ToTensor(*value->t));
+          continue;
+        }
+        Step step;
+        if (!ParseOp(node.opType, step.op)) {
+          Fail("operator " + node.opType + " is not supported.");
+        }
+        if (step.op == Op::QuantizeLinear && node.inputs.size() > 2) {
+          const Onnx::Tensor* zeroPoint = model.FindInitializer(node.inputs[2]);
+          if (zeroPoint != nullptr && zeroPoint->dataType == Onnx::DataType::Int8) {
+            step.low = -128.0f;
+            step.high = 127.0f;
+          }
+        }
+        step.node = node;
+        for (const auto& input : node.inputs) {
+          step.inputs.push_back(input.empty() ? -1 : valueIndex(input));
+        }
+        for (const auto& output : node.outputs) {
+          step.outputs.push_back(output.empty() ? -1 : valueIndex(output));
+        }
+        // Quantized weights are dequantized once, so that they pack like
+        // float weights.
+        bool constant = step.op == Op::DequantizeLinear && step.outputs.size() == 1 && step.outputs[0] >= 0;
+        for (int input : step.inputs) {
+          constant = constant && (input < 0 || program->constants[input] != nullptr);
+        }
+        if (constant) {
+          auto weights = std::make_shared<Tensor>();
+          Quantize(node, true, 0.0f, 0.0f, *program->constants[step.inputs[0]],
+                   *program->constants[step.inputs[1]],
+                   step.inputs.size() > 2 && step.inputs[2] >= 0 ? program->constants[step.inputs[2]].get() : nullptr,
+                   *weights);
+          program->constants[step.outputs[0]] = weights;
+          continue;
+        }
+        program->steps.push_back(std::move(step));
+      }
+
+      for (const auto& output : model.graph.outputs) {
+        if (values.find(output.name) == values.end()) {
+          Fail("graph output " + output.name + " is never computed.");
+        }
+        program->outputValues.push_back(values[output.name]);
+        program->outputs.push_back({ output.name, ToElementType(output.elementType), ToShape(output) });
+      }
+      program->valueCount = program->constants.size();
+
+      if (options.optimize) {
+        FuseConvRelu(*program);
+        for (auto& step : program->steps) {
+          const Tensor* weights =
+            step.op == Op::Conv && step.inputs.size() > 1 && step.inputs[1] >= 0
+              ? program->constants[step.inputs[1]].get() : nullptr;
+          int64_t group = step.node.Int("group", 1);
+          if (weights != nullptr && weights->Type() == ElementType::Float && weights->Shape().size() == 4 &&
+              group > 0 && weights->Shape()[0] % group == 0) {
+            step.packedWeights = PackConvWeights(*weights, group);
+          }
+        }
+      }
+      PlanBuffers(*program, options.optimize);
+      return program;
+    }
+  }
+
+  class ReferenceSession : public Session {
+  public:
+    ReferenceSession(std::shared_ptr<const Reference::Program> program, std::shared_ptr<Reference::WorkerPool> pool)
+        : m_program(std::move(program)), m_pool(std::move(pool)), m_buffers(m_program->bufferCount),
+          m_bound(m_program->inputs.size(), false) {
+      if (m_program->options.profile) {
+        for (const auto& step : m_program->steps) {
+          Reference::LayerProfile layer;
+          layer.name = !step.node.name.empty() ? step.node.name : step.node.outputs.at(0);
+          layer.opType = step.node.opType + (step.fuseRelu ? "+Relu" : "");
+          m_profile.push_back(layer);
+        }
+      }
+    }
+
+    void Bind(const std::string& name, const Tensor& value) override {
+      for (size_t i = 0; i < m_program->inputs.size(); i++) {
+        const ValueInfo& input = m_program->inputs[i];
+        if (input.name != name) {
+          continue;
+        }
+        if (value.Type() != input.type || value.Shape().size() != input.shape.size()) {
+          Reference::Fail("the value bound to " + name + " has the wrong type or rank.");
+        }
+        for (size_t dim = 0; dim < input.shape.size(); dim++) {
+          if (input.shape[dim] >= 0 && input.shape[dim] != value.Shape()[dim]) {
+            Reference::Fail("the value bound to " + name + " has the wrong shape.");
+          }
+        }
+        Reference::Copy(value, Buffer(m_program->inputValues[i]), value.Shape());
+        m_bound[i] = true;
+        return;
+      }
+      Reference::Fail(name + " is not an input of the model.");
+    }
+
+    void Evaluate() override {
+      for (size_t i = 0; i < m_bound.size(); i++) {
+        if (!m_bound[i]) {
+          Reference::Fail("input " + m_program->inputs[i].name + " is not bound.");
+        }
+      }
+      Notify(m_program->inputValues);
+      if (m_profile.empty()) {
+        for (const auto& step : m_program->steps) {
+          Run(step);
+          Notify(step.outputs);
+        }
+        return;
+      }
+      for (size_t i = 0; i < m_program->steps.size(); i++) {
+        auto start = std::chrono::steady_clock::now();
+        Run(m_program->steps[i]);
+        auto end = std::chrono::steady_clock::now();
+        Reference::LayerProfile& layer = m_profile[i];
+        layer.milliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+        layer.flops += Flops(m_program->steps[i]);
+        layer.evaluations++;
+        Notify(m_program->steps[i].outputs);
+      }
+    }
+
+    // Calls observer(name, value) with every float input and every float
+    // value a node computes, as soon as it is computed and before its buffer
+    // is reused. The output of a Conv fused with its Relu is not seen; load
+    // with optimize off to see every value.
+    void Observe(std::function<void(const std::string&, const Tensor&)> observer) {
+      m_observer = std::move(observer);
+    }
+
+    const Tensor& Output(const std::string& name) override {
+      for (size_t i = 0; i < m_program->outputs.size(); i++) {
+        if (m_program->outputs[i].name == name) {
+          return Value(m_program->outputValues[i]);
+        }
+      }
+      Reference::Fail(name + " is not an output of the model.");
+    }
+
+    // One entry per node in execution order, empty unless the model was
+    // loaded with Options::profile.
+    const std::vector<Reference::LayerProfile>& Profile() const { return m_profile; }
+
+    // Buffers backing the intermediate values.
+    size_t BufferCount() const { return m_buffers.size(); }
+
+  private:
+    Tensor& Buffer(int index) { return m_buffers[m_program->buffers[index]]; }
+
+    void Notify(const std::vector<int>& values) {
+      if (!m_observer) {
+        return;
+      }
+      for (int value : values) {
+        if (value >= 0 && Value(value).Type() == ElementType::Float) {
+          m_observer(m_program->names[value], Value(value));
+        }
+      }
+    }
+
+    const Tensor& Value(int index) const {
+      const auto& constant = m_program->constants[index];
+      return constant != nullptr ? *constant : m_buffers[m_program->buffers[index]];
+    }
+
+    // Floating point operations of the step that just ran: two per
+    // multiply-add for Conv, Gemm and MatMul, one per window element for
+    // pooling and one per output element otherwise.
+    double Flops(const Reference::Step& step) const {
+      const Tensor& output = Value(step.outputs.at(0));
+      double elements = static_cast<double>(output.ElementCount());
+      switch (step.op) {
+      case Reference::Op::Conv: {
+        const Tensor& w = Input(step, 1);
+        return 2.0 * elements * static_cast<double>(w.ElementCount() / w.Shape()[0]);
+      }
+      case Reference::Op::Gemm: {
+        const auto& aShape = Input(step, 0).Shape();
+        return 2.0 * elements * static_cast<double>(step.node.Int("transA", 0) != 0 ? aShape[0] : aShape[1]);
+      }
+      case Reference::Op::MatMul:
+        return 2.0 * elements * static_cast<double>(Input(step, 0).Shape().back());
+      case Reference::Op::MaxPool:
+      case Reference::Op::AveragePool: {
+        std::vector<int64_t> kernel = step.node.Ints("kernel_shape");
+        return elements * static_cast<double>(Reference::Product(kernel, 0, kernel.size()));
+      }
+      case Reference::Op::GlobalAveragePool:
+      case Reference::Op::GlobalMaxPool:
+        return static_cast<double>(Input(step, 0).ElementCount());
+      default:
+        return elements;
+      }
+    }
+
+    const Tensor& Input(const Reference::Step& step, size_t i) const {
+      if (i >= step.inputs.size() || step.inputs[i] < 0) {
+        Reference::Fail(step.node.opType + " is missing input " + std::to_string(i) + ".");
+      }
+      return Value(step.inputs[i]);
+    }
+
+    const Tensor* OptionalInput(const Reference::Step& step, size_t i) const {
+      return i < step.inputs.size() && step.inputs[i] >= 0 ? &Value(step.inputs[i]) : nullptr;
+    }
+
+    void Run(const Reference::Step& step) {
+      using namespace Reference;
+      const Onnx::Node& node = step.node;
+      Tensor& output = Buffer(step.outputs.at(0));
+      switch (step.op) {
+      case Op::Conv:
+        if (!m_program->options.optimize) {
+          Conv(node, Input(step, 0), Input(step, 1), OptionalInput(step, 2), output);
+        }
+        else if (!step.packedWeights.empty()) {
+          PackedConv(node, Input(step, 0), Input(step, 1), step.packedWeights, OptionalInput(step, 2), step.fuseRelu,
+                     output, m_columns, *m_pool);
+        }
+        else {
+          // Weights computed by the graph are packed on every evaluation.
+          const Tensor& w = Input(step, 1);
+          RequireFloat(w, "Conv");
+          if (w.Shape().size() != 4 || node.Int("group", 1) <= 0 || w.Shape()[0] % node.Int("group", 1) != 0) {
+            Fail("Conv input channels do not match its weights and group.");
+          }
+          PackedConv(node, Input(step, 0), w, PackConvWeights(w, node.Int("group", 1)), OptionalInput(step, 2),
+                     step.fuseRelu, output, m_columns, *m_pool);
+        }
+        break;
+      case Op::MaxPool:
+        Pool(node, Input(step, 0), output, true);
+        break;
+      case Op::AveragePool:
+        Pool(node, Input(step, 0), output, false);
+        break;
+      case Op::GlobalAveragePool:
+        GlobalPool(Input(step, 0), output, false);
+        break;
+      case Op::GlobalMaxPool:
+        GlobalPool(Input(step, 0), output, true);
+        break;
+      case Op::BatchNormalization:
+        BatchNormalization(node, Input(step, 0), Input(step, 1), Input(step, 2), Input(step, 3), Input(step, 4),
+                           output);
+        break;
+      case Op::Relu:
+        Unary(Input(step, 0), output, "Relu", [](float x) { return x > 0.0f ? x : 0.0f; });
+        break;
+      case Op::LeakyRelu: {
+        float alpha = node.Float("alpha", 0.01f);
+        Unary(Input(step, 0), output, "LeakyRelu", [alpha](float x) { return x >= 0.0f ? x : alpha * x; });
+        break;
+      }
+      case Op::Sigmoid:
+        Unary(Input(step, 0), output, "Sigmoid", [](float x) { return 1.0f / (1.0f + std::exp(-x)); });
+        break;
+      case Op::Tanh:
+        Unary(Input(step, 0), output, "Tanh", [](float x) { return std::tanh(x); });
+        break;
+      case Op::Clip: {
+        // Bounds are attributes before opset 11 and optional inputs after.
+        float low = node.Float("min", -std::numeric_limits<float>::infinity());
+        float high = node.Float("max", std::numeric_limits<float>::infinity());
+        if (const Tensor* min = OptionalInput(step, 1)) {
+          low = min->Data<float>()[0];
+        }
+        if (const Tensor* max = OptionalInput(step, 2)) {
+          high = max->Data<float>()[0];
+        }
+        Unary(Input(step, 0), output, "Clip", [low, high](float x) { return (std::min)((std::max)(x, low), high); });
+        break;
+      }
+      case Op::Add:
+        Binary(Input(step, 0), Input(step, 1), output, "Add", [](float a, float b) { return a + b; });
+        break;
+      case Op::Sub:
+        Binary(Input(step, 0), Input(step, 1), output, "Sub", [](float a, float b) { return a - b; });
+        break;
+      case Op::Mul:
+        Binary(Input(step, 0), Input(step, 1), output, "Mul", [](float a, float b) { return a * b; });
+        break;
+      case Op::Div:
+        Binary(Input(step, 0), Input(step, 1), output, "Div", [](float a, float b) { return a / b; });
+        break;
+      case Op::Gemm:
+        Gemm(node, Input(step, 0), Input(step, 1), OptionalInput(step, 2), output);
+        break;
+      case Op::MatMul:
+        MatMul(Input(step, 0), Input(step, 1), output);
+        break;
+      case Op::Softmax:
+        Softmax(node, m_program->opset, Input(step, 0), output);
+        break;
+      case Op::Concat: {
+        std::vector<const Tensor*> inputs;
+        for (size_t i = 0; i < step.inputs.size(); i++) {
+          inputs.push_back(&Input(step, i));
+        }
+        Concat(node, inputs, output);
+        break;
+      }
+      case Op::Reshape: {
+        const Tensor& x = Input(step, 0);
+        // Before opset 5 the target shape is an attribute.
+        std::vector<int64_t> shape =
+          step.inputs.size() > 1 ? ReadInt64s(Input(step, 1)) : node.Ints("shape");
+        Copy(x, output, ReshapeTarget(node, x.Shape(), shape));
+        break;
+      }
+      case Op::Flatten: {
+        const Tensor& x = Input(step, 0);
+        // Flatten also accepts axis == rank.
+        int64_t axis = node.Int("axis", 1);
+        size_t rank = x.Shape().size();
+        axis = axis == static_cast<int64_t>(rank) ? axis : static_cast<int64_t>(NormalizeAxis(axis, rank));
+        Copy(x, output, { Product(x.Shape(), 0, axis), Product(x.Shape(), axis, x.Shape().size()) });
+        break;
+      }
+      case Op::Squeeze:
+      case Op::Unsqueeze: {
+        const Tensor& x = Input(step, 0);
+        // Before opset 13 the axes are an attribute.
+        std::vector<int64_t> axes = step.inputs.size() > 1 ? ReadInt64s(Input(step, 1)) : node.Ints("axes");
+        Copy(x, output, step.op == Op::Squeeze ? Squeezed(x.Shape(), axes) : Unsqueezed(x.Shape(), axes));
+        break;
+      }
+      case Op::Transpose:
+        Transpose(node, Input(step, 0), output);
+        break;
+      case Op::Identity:
+        Copy(Input(step, 0), output, Input(step, 0).Shape());
+        // Dropout's optional mask keeps every element at inference time.
+        if (step.outputs.size() > 1 && step.outputs[1] >= 0) {
+          Tensor& mask = Buffer(step.outputs[1]);
+          mask.Reset(ElementType::Bool, output.Shape());
+          memset(mask.Data(), 1, mask.ByteSize());
+        }
+        break;
+      case Op::QuantizeLinear:
+      case Op::DequantizeLinear:
+        Quantize(node, step.op == Op::DequantizeLinear, step.low, step.high, Input(step, 0), Input(step, 1),
+                 OptionalInput(step, 2), output);
+        break;
+      }
+    }
+
+    std::shared_ptr<const Reference::Program> m_program;
+    std::shared_ptr<Reference::WorkerPool> m_pool;
+    std::vector<Tensor> m_buffers;
+    std::vector<bool> m_bound;
+    // im2col scratch, kept across evaluations like the buffers.
+    std::vector<float> m_columns;
+    std::vector<Reference::LayerProfile> m_profile;
+    std::function<void(const std::string&, const Tensor&)> m_observer;
+  };
+
+  // Sessions of a model share its compiled program and worker pool.
+  class ReferenceModel : public Model {
+  public:
+    explicit ReferenceModel(const Onnx::Model& model, const Reference::Options& options = {})
+        : m_program(Reference::Compile(model, options)) {
+      unsigned threads = options.threads != 0 ? options.threads : std::thread::hardware_concurrency();
+      m_pool = std::make_shared<Reference::WorkerPool>(options.optimize ? (std::max)(threads, 1u) : 1u);
+    }
+
+    const std::vector<ValueInfo>& Inputs() const override { return m_program->inputs; }
+    const std::vector<ValueInfo>& Outputs() const override { return m_program->outputs; }
+    std::unique_ptr<Session> CreateSession() override {
+      return std::make_unique<ReferenceSession>(m_program, m_pool);
+    }
+
+  private:
+    std::shared_ptr<const Reference::Program> m_program;
+    std::shared_ptr<Reference::WorkerPool> m_pool;
+  };
+
+  class ReferenceBackend : public Backend {
+  public:
+    explicit ReferenceBackend(const Reference::Options& options = {}) : m_options(options) {}
+
+    std::string Name() const override { return "Reference"; }
+
+    std::unique_ptr<Model> Load(const std::filesystem::path& path) override {
+      // Weights are copied into the compiled program, so the mappings only
+      // live while it is built.
+      auto model = Onnx::MapModel(path);
+      return std::make_unique<ReferenceModel>(*model, m_options);
+    }
+
+  private:
+    Reference::Options m_options;
+  };
+}
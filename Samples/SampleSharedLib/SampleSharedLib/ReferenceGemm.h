@@ -0,0 +1,337 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Compute kernels behind the optimized convolution path of ReferenceBackend:
+// im2col, a cache-blocked single-precision GEMM over pre-packed weights and
+// the worker pool that runs both in parallel.
+//
+// The GEMM follows the usual packed layout. The left matrix (the weights) is
+// packed once into panels of GemmRows rows, the right matrix is packed per
+// GemmDepthBlock x GemmColumnBlock block into panels of GemmColumns columns,
+// and a GemmRows x GemmColumns microkernel keeps its tile of the result in
+// registers for a whole depth block. The microkernel uses SSE on x86/x64 and
+// NEON on ARM64; define REFERENCEBACKEND_NO_SIMD to force the scalar path.
+#if !defined(REFERENCEBACKEND_NO_SIMD)
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define REFERENCEBACKEND_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define REFERENCEBACKEND_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace InferenceBackend {
+  namespace Reference {
+    constexpr int64_t GemmRows = 4;
+    constexpr int64_t GemmColumns = 8;
+    // A packed right block is 256 KB, sized to stay in L2 while every left
+    // panel streams past it.
+    constexpr int64_t GemmDepthBlock = 256;
+    constexpr int64_t GemmColumnBlock = 256;
+    // Rows of the result one parallel task covers, so that narrow late layers
+    // still split across threads.
+    constexpr int64_t GemmRowBlock = 64;
+
+    // Runs body(i) for every i in [0, count) on the calling thread and
+    // threads - 1 workers. Calls from different threads are serialized; body
+    // must not call ParallelFor itself.
+    class WorkerPool {
+    public:
+      explicit WorkerPool(unsigned threads) {
+        for (unsigned i = 1; i < threads; i++) {
+          m_workers.emplace_back([this] { WorkerLoop(); });
+        }
+      }
+
+      ~WorkerPool() {
+        {
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_stop = true;
+        }
+        m_wake.notify_all();
+        for (auto& worker : m_workers) {
+          worker.join();
+        }
+      }
+
+      WorkerPool(const WorkerPool&) = delete;
+      WorkerPool& operator=(const WorkerPool&) = delete;
+
+      size_t ThreadCount() const { return m_workers.size() + 1; }
+
+      void ParallelFor(size_t count, const std::function<void(size_t)>& body) {
+        if (m_workers.empty() || count <= 1) {
+          for (size_t i = 0; i < count; i++) {
+            body(i);
+          }
+          return;
+        }
+        std::lock_guard<std::mutex> job(m_jobMutex);
+        {
+          std::unique_lock<std::mutex> lock(m_mutex);
+          // A worker that woke for the previous job may still be leaving it.
+          m_done.wait(lock, [this] { return m_active == 0; });
+          m_body = &body;
+          m_count = count;
+          m_next = 0;
+          m_pending = count;
+          m_generation++;
+        }
+        m_wake.notify_all();
+        Work(&body, count);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_pending == 0 && m_active == 0; });
+        m_body = nullptr;
+      }
+
+    private:
+      void WorkerLoop() {
+        uint64_t seen = 0;
+        for (;;) {
+          const std::function<void(size_t)>* body;
+          size_t count;
+          {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+            if (m_stop) {
+              return;
+            }
+            seen = m_generation;
+            body = m_body;
+            count = m_count;
+            m_active++;
+          }
+          if (body != nullptr) {
+            Work(body, count);
+          }
+          std::lock_guard<std::mutex> lock(m_mutex);
+          m_active--;
+          m_done.notify_all();
+        }
+      }
+
+      void Work(const std::function<void(size_t)>* body, size_t count) {
+        for (;;) {
+          size_t index = m_next.fetch_add(1);
+          if (index >= count) {
+            return;
+          }
+          (*body)(index);
+          if (m_pending.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done.notify_all();
+          }
+        }
+      }
+
+      std::vector<std::thread> m_workers;
+      std::mutex m_jobMutex;
+      std::mutex m_mutex;
+      std::condition_variable m_wake;
+      std::condition_variable m_done;
+      const std::function<void(size_t)>* m_body = nullptr;
+      size_t m_count = 0;
+      std::atomic<size_t> m_next{ 0 };
+      std::atomic<size_t> m_pending{ 0 };
+      uint64_t m_generation = 0;
+      uint32_t m_active = 0;
+      bool m_stop = false;
+    };
+
+    // Packs the row-major rows x depth matrix a into panels of GemmRows rows,
+    // each stored depth-major. The last panel is padded with zeros.
+    inline std::vector<float> PackGemmLeft(const float* a, int64_t rows, int64_t depth) {
+      int64_t panels = (rows + GemmRows - 1) / GemmRows;
+      std::vector<float> packed(static_cast<size_t>(panels * depth * GemmRows), 0.0f);
+      for (int64_t row = 0; row < rows; row++) {
+        float* panel = packed.data() + (row / GemmRows) * depth * GemmRows + row % GemmRows;
+        for (int64_t k = 0; k < depth; k++) {
+          panel[k * GemmRows] = a[row * depth + k];
+        }
+      }
+      return packed;
+    }
+
+    namespace Details {
+      // Packs rows [k0, k0 + depth) and columns [n0, n0 + width) of b into
+      // panels of GemmColumns columns, each stored depth-major and padded with
+      // zeros.
+      inline void PackGemmRight(const float* b, int64_t ldb, int64_t k0, int64_t depth, int64_t n0, int64_t width,
+                                float* packed) {
+        for (int64_t j = 0; j < width; j += GemmColumns) {
+          int64_t columns = (std::min)(GemmColumns, width - j);
+          float* panel = packed + j * depth;
+          for (int64_t k = 0; k < depth; k++) {
+            const float* source = b + (k0 + k) * ldb + n0 + j;
+            float* target = panel + k * GemmColumns;
+            memcpy(target, source, static_cast<size_t>(columns) * sizeof(float));
+            std::fill(target + columns, target + GemmColumns, 0.0f);
+          }
+        }
+      }
+
+      // tile[GemmRows][GemmColumns] = sum over k of a[k][row] * b[k][column].
+#if defined(REFERENCEBACKEND_SSE2)
+      inline void MicroKernel(const float* a, const float* b, int64_t depth, float* tile) {
+        __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+        __m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+        __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+        __m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+        for (int64_t k = 0; k < depth; k++) {
+          __m128 b0 = _mm_loadu_ps(b);
+          __m128 b1 = _mm_loadu_ps(b + 4);
+          __m128 a0 = _mm_set1_ps(a[0]);
+          __m128 a1 = _mm_set1_ps(a[1]);
+          __m128 a2 = _mm_set1_ps(a[2]);
+          __m128 a3 = _mm_set1_ps(a[3]);
+          c00 = _mm_add_ps(c00, _mm_mul_ps(a0, b0));
+          c01 = _mm_add_ps(c01, _mm_mul_ps(a0, b1));
+          c10 = _mm_add_ps(c10, _mm_mul_ps(a1, b0));
+          c11 = _mm_add_ps(c11, _mm_mul_ps(a1, b1));
+          c20 = _mm_add_ps(c20, _mm_mul_ps(a2, b0));
+          c21 = _mm_add_ps(c21, _mm_mul_ps(a2, b1));
+          c30 = _mm_add_ps(c30, _mm_mul_ps(a3, b0));
+          c31 = _mm_add_ps(c31, _mm_mul_ps(a3, b1));
+          a += GemmRows;
+          b += GemmColumns;
+        }
+        _mm_storeu_ps(tile, c00);
+        _mm_storeu_ps(tile + 4, c01);
+        _mm_storeu_ps(tile + 8, c10);
+        _mm_storeu_ps(tile + 12, c11);
+        _mm_storeu_ps(tile + 16, c20);
+        _mm_storeu_ps(tile + 20, c21);
+        _mm_storeu_ps(tile + 24, c30);
+        _mm_storeu_ps(tile + 28, c31);
+      }
+#elif defined(REFERENCEBACKEND_NEON)
+      inline void MicroKernel(const float* a, const float* b, int64_t depth, float* tile) {
+        float32x4_t c00 = vdupq_n_f32(0), c01 = vdupq_n_f32(0);
+        float32x4_t c10 = vdupq_n_f32(0), c11 = vdupq_n_f32(0);
+        float32x4_t c20 = vdupq_n_f32(0), c21 = vdupq_n_f32(0);
+        float32x4_t c30 = vdupq_n_f32(0), c31 = vdupq_n_f32(0);
+        for (int64_t k = 0; k < depth; k++) {
+          float32x4_t b0 = vld1q_f32(b);
+          float32x4_t b1 = vld1q_f32(b + 4);
+          float32x4_t av = vld1q_f32(a);
+          c00 = vfmaq_laneq_f32(c00, b0, av, 0);
+          c01 = vfmaq_laneq_f32(c01, b1, av, 0);
+          c10 = vfmaq_laneq_f32(c10, b0, av, 1);
+          c11 = vfmaq_laneq_f32(c11, b1, av, 1);
+          c20 = vfmaq_laneq_f32(c20, b0, av, 2);
+          c21 = vfmaq_laneq_f32(c21, b1, av, 2);
+          c30 = vfmaq_laneq_f32(c30, b0, av, 3);
+          c31 = vfmaq_laneq_f32(c31, b1, av, 3);
+          a += GemmRows;
+          b += GemmColumns;
+        }
+        vst1q_f32(tile, c00);
+        vst1q_f32(tile + 4, c01);
+        vst1q_f32(tile + 8, c10);
+        vst1q_f32(tile + 12, c11);
+        vst1q_f32(tile + 16, c20);
+        vst1q_f32(tile + 20, c21);
+        vst1q_f32(tile + 24, c30);
+        vst1q_f32(tile + 28, c31);
+      }
+#else
+      inline void MicroKernel(const float* a, const float* b, int64_t depth, float* tile) {
+        std::fill(tile, tile + GemmRows * GemmColumns, 0.0f);
+        for (int64_t k = 0; k < depth; k++) {
+          for (int64_t row = 0; row < GemmRows; row++) {
+            for (int64_t column = 0; column < GemmColumns; column++) {
+              tile[row * GemmColumns + column] += a[row] * b[column];
+            }
+          }
+          a += GemmRows;
+          b += GemmColumns;
+        }
+      }
+#endif
+    }
+
+    // c = a * b + bias, with a given by PackGemmLeft (rows x depth), b
+    // row-major depth x columns with row stride ldb and c rows x columns with
+    // row stride ldc. bias holds one value per row and may be null; relu
+    // clamps the result at zero. Blocks of the result run on pool.
+    inline void Gemm(const float* packedA, int64_t rows, int64_t depth, const float* b, int64_t ldb, int64_t columns,
+                     float* c, int64_t ldc, const float* bias, bool relu, WorkerPool& pool) {
+      int64_t columnBlocks = (columns + GemmColumnBlock - 1) / GemmColumnBlock;
+      int64_t rowBlocks = (rows + GemmRowBlock - 1) / GemmRowBlock;
+      pool.ParallelFor(static_cast<size_t>(columnBlocks * rowBlocks), [&](size_t task) {
+        int64_t n0 = static_cast<int64_t>(task) % columnBlocks * GemmColumnBlock;
+        int64_t width = (std::min)(GemmColumnBlock, columns - n0);
+        int64_t m0 = static_cast<int64_t>(task) / columnBlocks * GemmRowBlock;
+        int64_t m1 = (std::min)(m0 + GemmRowBlock, rows);
+        // Each thread keeps its packing buffer across calls.
+        thread_local std::vector<float> packedB;
+        packedB.resize(static_cast<size_t>(GemmDepthBlock * GemmColumnBlock));
+        float tile[GemmRows * GemmColumns];
+
+        for (int64_t k0 = 0; k0 < depth; k0 += GemmDepthBlock) {
+          int64_t kc = (std::min)(GemmDepthBlock, depth - k0);
+          bool first = k0 == 0;
+          bool last = k0 + kc == depth;
+          Details::PackGemmRight(b, ldb, k0, kc, n0, width, packedB.data());
+          for (int64_t m = m0; m < m1; m += GemmRows) {
+            const float* panelA = packedA + (m / GemmRows) * depth * GemmRows + k0 * GemmRows;
+            int64_t tileRows = (std::min)(GemmRows, m1 - m);
+            for (int64_t j = 0; j < width; j += GemmColumns) {
+              Details::MicroKernel(panelA, packedB.data() + j * kc, kc, tile);
+              int64_t tileColumns = (std::min)(GemmColumns, width - j);
+              for (int64_t row = 0; row < tileRows; row++) {
+                float* target = c + (m + row) * ldc + n0 + j;
+                float offset = first ? (bias != nullptr ? bias[m + row] : 0.0f) : 0.0f;
+                for (int64_t column = 0; column < tileColumns; column++) {
+                  float value = tile[row * GemmColumns + column] + (first ? offset : target[column]);
+                  target[column] = last && relu && value < 0.0f ? 0.0f : value;
+                }
+              }
+            }
+          }
+        }
+      });
+    }
+
+    // Unfolds one image of channels x height x width into the
+    // (channels * kernelHeight * kernelWidth) x (outputHeight * outputWidth)
+    // matrix whose product with the flattened kernels is the convolution.
+    // Taps that fall in the padding are zero. Rows are filled in parallel.
+    inline void Im2Col(const float* input, int64_t channels, const int64_t inputSize[2], const int64_t kernel[2],
+                       const int64_t stride[2], const int64_t dilation[2], const int64_t padBegin[2],
+                       const int64_t outputSize[2], float* columns, WorkerPool& pool) {
+      int64_t kernelArea = kernel[0] * kernel[1];
+      int64_t outputArea = outputSize[0] * outputSize[1];
+      pool.ParallelFor(static_cast<size_t>(channels), [&](size_t channel) {
+        const float* plane = input + static_cast<int64_t>(channel) * inputSize[0] * inputSize[1];
+        for (int64_t tap = 0; tap < kernelArea; tap++) {
+          int64_t kh = tap / kernel[1];
+          int64_t kw = tap % kernel[1];
+          float* row = columns + (static_cast<int64_t>(channel) * kernelArea + tap) * outputArea;
+          for (int64_t oh = 0; oh < outputSize[0]; oh++) {
+            float* target = row + oh * outputSize[1];
+            int64_t ih = oh * stride[0] - padBegin[0] + kh * dilation[0];
+            if (ih < 0 || ih >= inputSize[0]) {
+              std::fill(target, target + outputSize[1], 0.0f);
+              continue;
+            }
+            const float* source = plane + ih * inputSize[1];
+            for (int64_t ow = 0; ow < outputSize[1]; ow++) {
+              int64_t iw = ow * stride[1] - padBegin[1] + kw * dilation[1];
+              target[ow] = iw >= 0 && iw < inputSize[1] ? source[iw] : 0.0f;
+            }
+          }
+        }
+      });
+    }
+  }
+}
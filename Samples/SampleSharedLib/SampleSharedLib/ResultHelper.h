@@ -0,0 +1,286 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Header-only post-processing for classifier outputs: reads scores straight
+// from the output tensor's native buffer, selects the top-K classes of every
+// batch item in a single pass and looks up their labels in a table that is
+// parsed once per process.
+//
+// The top-K scan compares eight scores at a time against the current K-th best
+// score with SSE2 on x86/x64 and NEON on ARM64, so only the rare scores that
+// can enter the result are touched individually. Define RESULTHELPER_NO_SIMD
+// to force the scalar path and RESULTHELPER_NO_WINRT to leave out the tensor
+// access helpers, which are always left out off Windows.
+#if !defined(RESULTHELPER_NO_SIMD)
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESULTHELPER_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define RESULTHELPER_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#if !defined(RESULTHELPER_NO_WINRT) && !defined(_WIN32)
+#define RESULTHELPER_NO_WINRT
+#endif
+
+#if !defined(RESULTHELPER_NO_WINRT)
+#include <unknwn.h>
+#include <winrt/Windows.AI.MachineLearning.h>
+#include <Windows.AI.MachineLearning.Native.h>
+#endif
+
+namespace ResultHelper {
+  struct Prediction {
+    uint32_t index;
+    float score;
+  };
+
+  namespace Details {
+    // Inserts into predictions, which is sorted by descending score and holds
+    // at most k entries. Equal scores keep the lower index first.
+    inline void Insert(std::vector<Prediction>& predictions, uint32_t k, uint32_t index, float score) {
+      size_t position = predictions.size();
+      while (position > 0 && predictions[position - 1].score < score) {
+        position--;
+      }
+      if (position >= k) {
+        return;
+      }
+      if (predictions.size() == k) {
+        predictions.pop_back();
+      }
+      predictions.insert(predictions.begin() + position, Prediction{ index, score });
+    }
+
+    // Returns a bit mask of the eight scores starting at scores that are
+    // greater than threshold.
+#if defined(RESULTHELPER_SSE2)
+    inline uint32_t Above8(const float* scores, float threshold) {
+      __m128 limit = _mm_set1_ps(threshold);
+      int low = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(scores), limit));
+      int high = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(scores + 4), limit));
+      return static_cast<uint32_t>(low | (high << 4));
+    }
+#elif defined(RESULTHELPER_NEON)
+    inline uint32_t Above8(const float* scores, float threshold) {
+      static const uint32_t bits[4] = { 1, 2, 4, 8 };
+      float32x4_t limit = vdupq_n_f32(threshold);
+      uint32x4_t weights = vld1q_u32(bits);
+      uint32x4_t low = vandq_u32(vcgtq_f32(vld1q_f32(scores), limit), weights);
+      uint32x4_t high = vandq_u32(vcgtq_f32(vld1q_f32(scores + 4), limit), weights);
+      return vaddvq_u32(low) | (vaddvq_u32(high) << 4);
+    }
+#endif
+  }
+
+  // Writes the k highest scores of scores[0, count) to predictions, best
+  // first. NaN scores are never selected, so fewer than k predictions are
+  // returned only when count - (number of NaNs) < k.
+  inline void TopK(const float* scores, size_t count, uint32_t k, std::vector<Prediction>& predictions) {
+    predictions.clear();
+    if (k == 0) {
+      return;
+    }
+    predictions.reserve(k + 1);
+
+    size_t i = 0;
+    for (; i < count && predictions.size() < k; ++i) {
+      if (!std::isnan(scores[i])) {
+        Details::Insert(predictions, k, static_cast<uint32_t>(i), scores[i]);
+      }
+    }
+
+#if defined(RESULTHELPER_SSE2) || defined(RESULTHELPER_NEON)
+    for (; i + 8 <= count; i += 8) {
+      uint32_t mask = Details::Above8(scores + i, predictions.back().score);
+      for (uint32_t lane = 0; mask != 0; ++lane, mask >>= 1) {
+        // An earlier lane may have raised the threshold, so re-check.
+        if ((mask & 1) && scores[i + lane] > predictions.back().score) {
+          Details::Insert(predictions, k, static_cast<uint32_t>(i + lane), scores[i + lane]);
+        }
+      }
+    }
+#endif
+    for (; i < count; ++i) {
+      if (scores[i] > predictions.back().score) {
+        Details::Insert(predictions, k, static_cast<uint32_t>(i), scores[i]);
+      }
+    }
+  }
+
+  inline std::vector<Prediction> TopK(const float* scores, size_t count, uint32_t k) {
+    std::vector<Prediction> predictions;
+    TopK(scores, count, k, predictions);
+    return predictions;
+  }
+
+  // Treats scores as batchSize consecutive rows of count / batchSize scores
+  // and returns the top k of every row, one pass per row.
+  inline std::vector<std::vector<Prediction>> TopKPerBatch(const float* scores, size_t count, uint32_t batchSize,
+                                                           uint32_t k) {
+    std::vector<std::vector<Prediction>> results(batchSize);
+    if (batchSize == 0) {
+      return results;
+    }
+    size_t rowSize = count / batchSize;
+    for (uint32_t batchId = 0; batchId < batchSize; ++batchId) {
+      TopK(scores + rowSize * batchId, rowSize, k, results[batchId]);
+    }
+    return results;
+  }
+
+  // Labels parsed from "index,label" lines into one contiguous buffer of
+  // null-terminated strings.
+  class LabelTable {
+  public:
+    LabelTable() = default;
+
+    // Largest index a labels file may use, so that a corrupt file cannot make
+    // the table allocate without bound.
+    static constexpr uint32_t MaxIndex = 1u << 24;
+
+    // Parses the contents of a labels file. Lines without a leading index are
+    // ignored and indices that never appear map to an empty label. Throws
+    // std::runtime_error for an index above MaxIndex.
+    static LabelTable Parse(const char* text, size_t length) {
+      struct Entry {
+        uint32_t index;
+        size_t offset;
+      };
+      LabelTable table;
+      std::vector<Entry> entries;
+      uint32_t count = 0;
+      const char* end = text + length;
+      const char* line = text;
+      while (line < end) {
+        const char* next = line;
+        while (next < end && *next != '\n') {
+          ++next;
+        }
+        const char* cursor = line;
+        uint32_t index = 0;
+        bool hasIndex = false;
+        while (cursor < next && *cursor >= '0' && *cursor <= '9') {
+          index = index * 10 + static_cast<uint32_t>(*cursor - '0');
+          if (index > MaxIndex) {
+            throw std::runtime_error("A label index is larger than " + std::to_string(MaxIndex) + ".");
+          }
+          hasIndex = true;
+          ++cursor;
+        }
+        if (hasIndex && cursor < next && *cursor == ',') {
+          ++cursor;
+          const char* labelEnd = next;
+          if (labelEnd > cursor && labelEnd[-1] == '\r') {
+            --labelEnd;
+          }
+          entries.push_back(Entry{ index, table.m_text.size() });
+          table.m_text.append(cursor, labelEnd);
+          table.m_text.push_back('\0');
+          if (index >= count) {
+            count = index + 1;
+          }
+        }
+        line = next + 1;
+      }
+
+      // Offset 0 stays the empty string used for missing indices.
+      table.m_text.insert(table.m_text.begin(), '\0');
+      table.m_offsets.assign(count, 0);
+      for (const Entry& entry : entries) {
+        table.m_offsets[entry.index] = static_cast<uint32_t>(entry.offset + 1);
+      }
+      return table;
+    }
+
+    // Reads and parses a labels file, throwing std::runtime_error if it cannot
+    // be opened.
+    static LabelTable Load(const std::string& path) {
+      FILE* file = nullptr;
+#if defined(_MSC_VER)
+      fopen_s(&file, path.c_str(), "rb");
+#else
+      file = fopen(path.c_str(), "rb");
+#endif
+      if (file == nullptr) {
+        throw std::runtime_error("failed to load the " + path + " file. Make sure it exists in the same folder as the app");
+      }
+      std::string text;
+      char chunk[64 * 1024];
+      size_t read;
+      while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        text.append(chunk, read);
+      }
+      fclose(file);
+      return Parse(text.data(), text.size());
+    }
+
+    // Returns the table for path, loading it on first use. Later calls with
+    // the same path, from any thread, reuse the parsed table.
+    static const LabelTable& Shared(const std::string& path) {
+      static std::mutex mutex;
+      static std::map<std::string, std::unique_ptr<LabelTable>> tables;
+      std::lock_guard<std::mutex> lock(mutex);
+      auto& table = tables[path];
+      if (!table) {
+        table.reset(new LabelTable(Load(path)));
+      }
+      return *table;
+    }
+
+    size_t Size() const { return m_offsets.size(); }
+
+    // Never returns null; unknown indices yield an empty string.
+    const char* Get(size_t index) const {
+      return index < m_offsets.size() ? m_text.c_str() + m_offsets[index] : "";
+    }
+
+  private:
+    std::string m_text;
+    std::vector<uint32_t> m_offsets;
+  };
+
+#if !defined(RESULTHELPER_NO_WINRT)
+  // Read access to the scores of a float tensor. Uses the tensor's native
+  // buffer when available, which avoids a virtual call per element; otherwise
+  // copies the scores out of the vector view in one GetMany call. Data stays
+  // valid for the lifetime of this object.
+  class TensorData {
+  public:
+    explicit TensorData(const winrt::Windows::AI::MachineLearning::TensorFloat& tensor) {
+      BYTE* buffer = nullptr;
+      uint32_t capacity = 0;
+      m_native = tensor.try_as<ITensorNative>();
+      if (m_native && SUCCEEDED(m_native->GetBuffer(&buffer, &capacity)) && buffer != nullptr) {
+        m_data = reinterpret_cast<const float*>(buffer);
+        m_size = capacity / sizeof(float);
+        return;
+      }
+      auto view = tensor.GetAsVectorView();
+      m_copy.resize(view.Size());
+      view.GetMany(0, m_copy);
+      m_data = m_copy.data();
+      m_size = m_copy.size();
+    }
+
+    const float* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+  private:
+    winrt::com_ptr<ITensorNative> m_native;
+    std::vector<float> m_copy;
+    const float* m_data = nullptr;
+    size_t m_size = 0;
+  };
+#endif
+}
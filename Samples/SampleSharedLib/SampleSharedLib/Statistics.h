@@ -0,0 +1,84 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Header-only summaries of measured latencies, shared by the samples and the
+// WinMLRunner benchmarks so that every report computes its percentiles alike.
+//
+// Short runs keep every latency and sort them. Long-lived or cross-process
+// measurements count them instead in a histogram of eight buckets to a power
+// of two of microseconds, from 1 us to 2^36 us: its size is fixed however many
+// latencies it counts, and a percentile read from it is within 6% of the exact
+// one. The buckets are plain counters, so that histograms kept in shared
+// memory by several processes can be summed bucket by bucket.
+namespace Statistics {
+  // The sample nearest to the given percentile (0 to 100) of an ascending
+  // sorted list, or 0 when the list is empty.
+  inline double Percentile(const std::vector<double>& sorted, double percentile) {
+    if (sorted.empty()) {
+      return 0;
+    }
+    size_t index = static_cast<size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[index];
+  }
+
+  constexpr uint32_t HistogramSubBuckets = 8;
+  constexpr uint32_t HistogramBuckets = 36 * HistogramSubBuckets;
+
+  inline uint32_t HistogramBucket(double milliseconds) {
+    double microseconds = milliseconds * 1000;
+    if (microseconds < 1) {
+      return 0;
+    }
+    int exponent = 0;
+    // microseconds = mantissa * 2^exponent with mantissa in [0.5, 1).
+    double mantissa = std::frexp(microseconds, &exponent);
+    uint32_t bucket = (exponent - 1) * HistogramSubBuckets +
+                      static_cast<uint32_t>((mantissa * 2 - 1) * HistogramSubBuckets);
+    return (std::min)(bucket, HistogramBuckets - 1);
+  }
+
+  // The middle of the latencies a bucket counts, in milliseconds.
+  inline double HistogramBucketMidpoint(uint32_t bucket) {
+    int exponent = static_cast<int>(bucket / HistogramSubBuckets);
+    double sub = static_cast<double>(bucket % HistogramSubBuckets);
+    double low = std::ldexp(1.0 + sub / HistogramSubBuckets, exponent);
+    double high = std::ldexp(1.0 + (sub + 1) / HistogramSubBuckets, exponent);
+    return (low + high) / 2 / 1000;
+  }
+
+  // The given percentile of the count latencies in buckets, or 0 when there
+  // are none.
+  inline double HistogramPercentile(const uint64_t* buckets, uint64_t count, double percentile) {
+    uint64_t rank = (std::max)(static_cast<uint64_t>(std::ceil(percentile / 100 * count)), uint64_t(1));
+    uint64_t seen = 0;
+    for (uint32_t bucket = 0; bucket < HistogramBuckets; bucket++) {
+      seen += buckets[bucket];
+      if (seen >= rank) {
+        return HistogramBucketMidpoint(bucket);
+      }
+    }
+    return 0;
+  }
+
+  class LatencyHistogram {
+  public:
+    void Add(double milliseconds) {
+      m_buckets[HistogramBucket(milliseconds)]++;
+      m_count++;
+    }
+
+    uint64_t Count() const { return m_count; }
+
+    double Percentile(double percentile) const {
+      return HistogramPercentile(m_buckets, m_count, percentile);
+    }
+
+  private:
+    uint64_t m_buckets[HistogramBuckets] = {};
+    uint64_t m_count = 0;
+  };
+}
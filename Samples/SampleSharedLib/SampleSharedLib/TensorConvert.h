@@ -0,0 +1,411 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// Portable, header-only conversion of interleaved 8-bit/16-bit pixel buffers
+// (the layouts produced by SoftwareBitmap) into planar NCHW tensor data.
+//
+// Every routine processes four pixels at a time with SSE2 on x86/x64 and NEON
+// on ARM64, and falls back to scalar code for row tails and other targets.
+// Define TENSORCONVERT_NO_SIMD to force the scalar path.
+#if !defined(TENSORCONVERT_NO_SIMD)
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TENSORCONVERT_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define TENSORCONVERT_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace TensorConvert {
+  enum class PixelFormat { Bgra8, Rgba8, Gray8, Gray16 };
+
+  // Order of the color planes in the output tensor.
+  enum class ChannelOrder { RGB, BGR };
+
+  struct ImageDesc {
+    const void* data;
+    uint32_t width;
+    uint32_t height;
+    // Distance in bytes between the start of two consecutive rows. Zero means
+    // the rows are tightly packed.
+    uint32_t rowPitchInBytes;
+    PixelFormat format;
+  };
+
+  // out[c] = (in * scale - means[c]) / stddevs[c], where c is the index of the
+  // output plane. The default is the identity transform.
+  struct Normalization {
+    float scale = 1.0f;
+    float means[3] = { 0.0f, 0.0f, 0.0f };
+    float stddevs[3] = { 1.0f, 1.0f, 1.0f };
+  };
+
+  inline uint32_t BytesPerPixel(PixelFormat format) {
+    switch (format) {
+    case PixelFormat::Bgra8:
+    case PixelFormat::Rgba8:
+      return 4;
+    case PixelFormat::Gray16:
+      return 2;
+    default:
+      return 1;
+    }
+  }
+
+  // IEEE binary16 conversion with round-to-nearest-even. NaN maps to a quiet
+  // NaN and values beyond the half range saturate to infinity.
+  inline uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint32_t half;
+    if (bits >= (127u + 16u) << 23) {
+      half = bits > 0x7f800000u ? 0x7e00u : 0x7c00u;
+    } else if (bits < (127u - 14u) << 23) {
+      // Let the FPU round the mantissa by adding a magic denormal bias.
+      const uint32_t magicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+      float magic;
+      float scaled;
+      memcpy(&magic, &magicBits, sizeof(magic));
+      memcpy(&scaled, &bits, sizeof(scaled));
+      scaled += magic;
+      memcpy(&half, &scaled, sizeof(half));
+      half -= magicBits;
+    } else {
+      uint32_t mantissaOdd = (bits >> 13) & 1u;
+      bits += ((15u - 127u) << 23) + 0xfffu;
+      bits += mantissaOdd;
+      half = bits >> 13;
+    }
+    return static_cast<uint16_t>(half | (sign >> 16));
+  }
+
+  inline float HalfToFloat(uint16_t half) {
+    const uint32_t shiftedExponent = 0x7c00u << 13;
+    uint32_t bits = (half & 0x7fffu) << 13;
+    uint32_t exponent = bits & shiftedExponent;
+    bits += (127u - 15u) << 23;
+
+    if (exponent == shiftedExponent) {
+      bits += (128u - 16u) << 23;
+    } else if (exponent == 0) {
+      // Renormalize subnormals through the FPU.
+      const uint32_t magicBits = 113u << 23;
+      float magic;
+      float value;
+      bits += 1u << 23;
+      memcpy(&magic, &magicBits, sizeof(magic));
+      memcpy(&value, &bits, sizeof(value));
+      value -= magic;
+      memcpy(&bits, &value, sizeof(bits));
+    }
+    bits |= static_cast<uint32_t>(half & 0x8000u) << 16;
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  namespace Details {
+    // Rec. 709 luma weights, used when a color image is written to a single plane.
+    const float LumaR = 0.2126f;
+    const float LumaG = 0.7152f;
+    const float LumaB = 0.0722f;
+
+    struct ChannelTransform {
+      // Index into the (r, g, b) triple read from the pixel, or -1 for luma.
+      int source;
+      float multiplier;
+      float offset;
+    };
+
+    inline float Luma(float r, float g, float b) { return (r * LumaR + g * LumaG) + b * LumaB; }
+
+    inline void LoadPixel(const uint8_t* pixel, PixelFormat format, float& r, float& g, float& b) {
+      switch (format) {
+      case PixelFormat::Bgra8:
+        b = static_cast<float>(pixel[0]);
+        g = static_cast<float>(pixel[1]);
+        r = static_cast<float>(pixel[2]);
+        break;
+      case PixelFormat::Rgba8:
+        r = static_cast<float>(pixel[0]);
+        g = static_cast<float>(pixel[1]);
+        b = static_cast<float>(pixel[2]);
+        break;
+      case PixelFormat::Gray8:
+        r = g = b = static_cast<float>(pixel[0]);
+        break;
+      case PixelFormat::Gray16: {
+        uint16_t value;
+        memcpy(&value, pixel, sizeof(value));
+        r = g = b = static_cast<float>(value);
+        break;
+      }
+      }
+    }
+
+    inline float SelectChannel(const ChannelTransform& transform, float r, float g, float b) {
+      float value = transform.source == 0 ? r : transform.source == 1 ? g : transform.source == 2 ? b : Luma(r, g, b);
+      return value * transform.multiplier + transform.offset;
+    }
+
+    struct FloatWriter {
+      using Type = float;
+      static void Write(float* out, float value) { *out = value; }
+    };
+
+    struct HalfWriter {
+      using Type = uint16_t;
+      static void Write(uint16_t* out, float value) { *out = FloatToHalf(value); }
+    };
+
+    struct UInt8Writer {
+      using Type = uint8_t;
+      static void Write(uint8_t* out, float value) {
+        // Written so that NaN clamps to zero, matching the SIMD min/max below.
+        value = value > 0.0f ? value : 0.0f;
+        value = value < 255.0f ? value : 255.0f;
+        *out = static_cast<uint8_t>(std::nearbyint(value));
+      }
+    };
+
+#if defined(TENSORCONVERT_SSE2)
+    using Float4 = __m128;
+
+    inline Float4 MultiplyAdd(Float4 value, Float4 multiplier, Float4 offset) {
+      return _mm_add_ps(_mm_mul_ps(value, multiplier), offset);
+    }
+
+    inline Float4 Luma4(Float4 r, Float4 g, Float4 b) {
+      return _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(LumaR)), _mm_mul_ps(g, _mm_set1_ps(LumaG))),
+        _mm_mul_ps(b, _mm_set1_ps(LumaB)));
+    }
+
+    inline Float4 Splat(float value) { return _mm_set1_ps(value); }
+
+    inline void LoadPixels4(const uint8_t* pixels, PixelFormat format, Float4& r, Float4& g, Float4& b) {
+      const __m128i zero = _mm_setzero_si128();
+      switch (format) {
+      case PixelFormat::Bgra8:
+      case PixelFormat::Rgba8: {
+        const __m128i mask = _mm_set1_epi32(0xff);
+        __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels));
+        Float4 c0 = _mm_cvtepi32_ps(_mm_and_si128(packed, mask));
+        Float4 c1 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 8), mask));
+        Float4 c2 = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 16), mask));
+        g = c1;
+        r = format == PixelFormat::Bgra8 ? c2 : c0;
+        b = format == PixelFormat::Bgra8 ? c0 : c2;
+        break;
+      }
+      case PixelFormat::Gray8: {
+        int32_t packed;
+        memcpy(&packed, pixels, sizeof(packed));
+        __m128i bytes = _mm_cvtsi32_si128(packed);
+        __m128i words = _mm_unpacklo_epi8(bytes, zero);
+        r = g = b = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+        break;
+      }
+      case PixelFormat::Gray16: {
+        __m128i words = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pixels));
+        r = g = b = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+        break;
+      }
+      }
+    }
+
+    inline void Store4(float* out, Float4 values) { _mm_storeu_ps(out, values); }
+
+    inline void Store4(uint16_t* out, Float4 values) {
+      // Vectorized form of FloatToHalf; produces bit-identical results.
+      const __m128i subnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+      __m128 sign = _mm_and_ps(values, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u))));
+      __m128 absolute = _mm_xor_ps(values, sign);
+      __m128i absoluteBits = _mm_castps_si128(absolute);
+
+      __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absolute, absolute));
+      __m128i isRegular = _mm_cmpgt_epi32(_mm_set1_epi32((127 + 16) << 23), absoluteBits);
+      __m128i infOrNan = _mm_or_si128(_mm_and_si128(isNan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+      __m128i isSubnormal = _mm_cmpgt_epi32(_mm_set1_epi32((127 - 14) << 23), absoluteBits);
+
+      __m128i subnormal = _mm_sub_epi32(
+        _mm_castps_si128(_mm_add_ps(absolute, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+      __m128i mantissaOdd = _mm_srai_epi32(_mm_slli_epi32(absoluteBits, 31 - 13), 31);
+      __m128i normal = _mm_add_epi32(absoluteBits, _mm_set1_epi32(0xfff - ((127 - 15) << 23)));
+      normal = _mm_srli_epi32(_mm_sub_epi32(normal, mantissaOdd), 13);
+
+      __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+      __m128i half = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, infOrNan));
+      // The arithmetic shift keeps every lane inside the int16 range so the
+      // saturating pack below is exact.
+      half = _mm_or_si128(half, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packs_epi32(half, half));
+    }
+
+    inline void Store4(uint8_t* out, Float4 values) {
+      values = _mm_min_ps(_mm_max_ps(values, _mm_setzero_ps()), _mm_set1_ps(255.0f));
+      __m128i words = _mm_cvtps_epi32(values);
+      words = _mm_packs_epi32(words, words);
+      int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(words, words));
+      memcpy(out, &packed, sizeof(packed));
+    }
+#elif defined(TENSORCONVERT_NEON)
+    using Float4 = float32x4_t;
+
+    inline Float4 MultiplyAdd(Float4 value, Float4 multiplier, Float4 offset) {
+      // Kept unfused so results match the scalar path.
+      return vaddq_f32(vmulq_f32(value, multiplier), offset);
+    }
+
+    inline Float4 Luma4(Float4 r, Float4 g, Float4 b) {
+      return vaddq_f32(vaddq_f32(vmulq_n_f32(r, LumaR), vmulq_n_f32(g, LumaG)), vmulq_n_f32(b, LumaB));
+    }
+
+    inline Float4 Splat(float value) { return vdupq_n_f32(value); }
+
+    inline void LoadPixels4(const uint8_t* pixels, PixelFormat format, Float4& r, Float4& g, Float4& b) {
+      switch (format) {
+      case PixelFormat::Bgra8:
+      case PixelFormat::Rgba8: {
+        const uint32x4_t mask = vdupq_n_u32(0xff);
+        uint32x4_t packed = vreinterpretq_u32_u8(vld1q_u8(pixels));
+        Float4 c0 = vcvtq_f32_u32(vandq_u32(packed, mask));
+        Float4 c1 = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(packed, 8), mask));
+        Float4 c2 = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(packed, 16), mask));
+        g = c1;
+        r = format == PixelFormat::Bgra8 ? c2 : c0;
+        b = format == PixelFormat::Bgra8 ? c0 : c2;
+        break;
+      }
+      case PixelFormat::Gray8: {
+        uint32_t packed;
+        memcpy(&packed, pixels, sizeof(packed));
+        uint16x8_t words = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(packed)));
+        r = g = b = vcvtq_f32_u32(vmovl_u16(vget_low_u16(words)));
+        break;
+      }
+      case PixelFormat::Gray16: {
+        uint16_t words[4];
+        memcpy(words, pixels, sizeof(words));
+        r = g = b = vcvtq_f32_u32(vmovl_u16(vld1_u16(words)));
+        break;
+      }
+      }
+    }
+
+    inline void Store4(float* out, Float4 values) { vst1q_f32(out, values); }
+
+    inline void Store4(uint16_t* out, Float4 values) {
+      vst1_u16(out, vreinterpret_u16_f16(vcvt_f16_f32(values)));
+    }
+
+    inline void Store4(uint8_t* out, Float4 values) {
+      values = vminq_f32(vmaxnmq_f32(values, vdupq_n_f32(0.0f)), vdupq_n_f32(255.0f));
+      uint16x4_t words = vmovn_u32(vcvtnq_u32_f32(values));
+      uint32_t packed = vget_lane_u32(vreinterpret_u32_u8(vmovn_u16(vcombine_u16(words, words))), 0);
+      memcpy(out, &packed, sizeof(packed));
+    }
+#endif
+
+    template <typename Writer>
+    void ConvertToPlanar(const ImageDesc& image, ChannelOrder order, uint32_t channels,
+      typename Writer::Type* out, const Normalization& normalization) {
+      if (channels != 1 && channels != 3) {
+        throw std::invalid_argument("TensorConvert: only 1 or 3 output channels are supported");
+      }
+
+      const bool isColor = image.format == PixelFormat::Bgra8 || image.format == PixelFormat::Rgba8;
+      ChannelTransform transforms[3];
+      for (uint32_t c = 0; c < channels; ++c) {
+        if (channels == 1) {
+          transforms[c].source = isColor ? -1 : 0;
+        } else {
+          transforms[c].source = order == ChannelOrder::RGB ? static_cast<int>(c) : 2 - static_cast<int>(c);
+        }
+        transforms[c].multiplier = normalization.scale / normalization.stddevs[c];
+        transforms[c].offset = -normalization.means[c] / normalization.stddevs[c];
+      }
+
+      const uint32_t bytesPerPixel = BytesPerPixel(image.format);
+      const uint32_t rowPitch = image.rowPitchInBytes ? image.rowPitchInBytes : image.width * bytesPerPixel;
+      const size_t planeSize = static_cast<size_t>(image.width) * image.height;
+      const uint8_t* rows = static_cast<const uint8_t*>(image.data);
+
+      for (uint32_t y = 0; y < image.height; ++y) {
+        const uint8_t* row = rows + static_cast<size_t>(y) * rowPitch;
+        typename Writer::Type* rowOut = out + static_cast<size_t>(y) * image.width;
+        uint32_t x = 0;
+#if defined(TENSORCONVERT_SSE2) || defined(TENSORCONVERT_NEON)
+        Float4 multipliers[3];
+        Float4 offsets[3];
+        for (uint32_t c = 0; c < channels; ++c) {
+          multipliers[c] = Splat(transforms[c].multiplier);
+          offsets[c] = Splat(transforms[c].offset);
+        }
+        for (; x + 4 <= image.width; x += 4) {
+          Float4 r = Splat(0.0f), g = r, b = r;
+          LoadPixels4(row + x * bytesPerPixel, image.format, r, g, b);
+          for (uint32_t c = 0; c < channels; ++c) {
+            int source = transforms[c].source;
+            Float4 value = source == 0 ? r : source == 1 ? g : source == 2 ? b : Luma4(r, g, b);
+            Store4(rowOut + c * planeSize + x, MultiplyAdd(value, multipliers[c], offsets[c]));
+          }
+        }
+#endif
+        for (; x < image.width; ++x) {
+          float r = 0.0f, g = 0.0f, b = 0.0f;
+          LoadPixel(row + x * bytesPerPixel, image.format, r, g, b);
+          for (uint32_t c = 0; c < channels; ++c) {
+            Writer::Write(rowOut + c * planeSize + x, SelectChannel(transforms[c], r, g, b));
+          }
+        }
+      }
+    }
+  }
+
+  // Converts an interleaved image into `channels` (1 or 3) planes of
+  // width * height elements each, written back to back starting at `out`.
+  // Color images written to one plane are reduced to luma; gray images
+  // written to three planes are replicated.
+  inline void ToPlanarFloat(const ImageDesc& image, ChannelOrder order, uint32_t channels, float* out,
+    const Normalization& normalization = Normalization()) {
+    Details::ConvertToPlanar<Details::FloatWriter>(image, order, channels, out, normalization);
+  }
+
+  // Same as ToPlanarFloat, storing IEEE binary16 bit patterns.
+  inline void ToPlanarHalf(const ImageDesc& image, ChannelOrder order, uint32_t channels, uint16_t* out,
+    const Normalization& normalization = Normalization()) {
+    Details::ConvertToPlanar<Details::HalfWriter>(image, order, channels, out, normalization);
+  }
+
+  // Same as ToPlanarFloat, rounding to nearest and saturating to [0, 255].
+  inline void ToPlanarUInt8(const ImageDesc& image, ChannelOrder order, uint32_t channels, uint8_t* out,
+    const Normalization& normalization = Normalization()) {
+    Details::ConvertToPlanar<Details::UInt8Writer>(image, order, channels, out, normalization);
+  }
+
+  // FloatToHalf over `count` contiguous values.
+  inline void ToHalf(const float* in, uint16_t* out, size_t count) {
+    size_t i = 0;
+#if defined(TENSORCONVERT_SSE2)
+    for (; i + 4 <= count; i += 4) {
+      Details::Store4(out + i, _mm_loadu_ps(in + i));
+    }
+#elif defined(TENSORCONVERT_NEON)
+    for (; i + 4 <= count; i += 4) {
+      Details::Store4(out + i, vld1q_f32(in + i));
+    }
+#endif
+    for (; i < count; ++i) {
+      out[i] = FloatToHalf(in[i]);
+    }
+  }
+}
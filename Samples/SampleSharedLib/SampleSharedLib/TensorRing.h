@@ -0,0 +1,330 @@
+#pragma once
+#include <Windows.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#if !defined(TENSORRING_NO_WINRT)
+#include <robuffer.h>
+#include <winrt/Windows.Foundation.Collections.h>
+#include <winrt/Windows.Storage.Streams.h>
+#include <winrt/Windows.AI.MachineLearning.h>
+#endif
+
+// Header-only ring of fixed-size tensor slots in a named shared memory
+// section, for streaming inputs from a producer process (a camera or feature
+// extractor) into an evaluation loop without files or extra copies.
+//
+// The ring has one producer and one consumer. The producer owns head and the
+// consumer owns tail; each only reads the other's index, so neither side ever
+// takes a lock. Slot i % SlotCount() is filled while head - tail < SlotCount()
+// and published by advancing head; the consumer reads it while tail < head and
+// hands it back by advancing tail. Payloads are 64-byte aligned and can be
+// wrapped as tensor buffers directly (see CreateSlotTensor), so an evaluation
+// reads the producer's bytes where they were written.
+//
+// The consumer usually creates the ring, since it knows the input size from
+// the model, and the producer opens it by name. Define TENSORRING_NO_WINRT to
+// leave out the tensor helpers.
+namespace TensorRing {
+  enum class WaitResult {
+    Ready,
+    // The producer closed the ring and every published slot was read.
+    Closed,
+    TimedOut
+  };
+
+  namespace Details {
+    constexpr uint32_t Magic = 0x474e4952;  // "RING"
+    constexpr uint32_t Version = 1;
+    constexpr uint64_t Alignment = 64;
+
+    [[noreturn]] inline void ThrowWin32Error(DWORD error) {
+      throw std::system_error(static_cast<int>(error), std::system_category());
+    }
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                  "The ring indices are shared between processes and must not need a lock.");
+
+    // Lives at the start of the section. The indices sit on separate cache
+    // lines so that the two sides do not invalidate each other's line on
+    // every slot.
+    struct Header {
+      uint32_t magic;
+      uint32_t version;
+      uint32_t slotCount;
+      uint32_t slotBytes;
+      uint64_t slotStride;
+      alignas(64) std::atomic<uint64_t> head;
+      alignas(64) std::atomic<uint64_t> tail;
+      alignas(64) std::atomic<uint32_t> closed;
+    };
+
+    struct alignas(64) SlotHeader {
+      // QueryPerformanceCounter value when the slot was published. The counter
+      // is system wide, so the consumer can compare it with its own clock.
+      int64_t published;
+      uint32_t bytes;
+    };
+
+    inline uint64_t RoundUp(uint64_t value) {
+      return (value + Alignment - 1) / Alignment * Alignment;
+    }
+
+    inline uint64_t SlotStride(uint32_t slotBytes) {
+      return RoundUp(sizeof(SlotHeader)) + RoundUp(slotBytes);
+    }
+
+    // Spins briefly, then yields, then sleeps, so that a slot published right
+    // away is picked up within microseconds while a long wait costs no CPU.
+    template <typename Predicate>
+    bool WaitUntil(Predicate ready, DWORD timeoutMilliseconds) {
+      ULONGLONG start = GetTickCount64();
+      for (uint32_t attempt = 0;; attempt++) {
+        if (ready()) {
+          return true;
+        }
+        if (attempt < 256) {
+          YieldProcessor();
+        }
+        else if (attempt < 1024) {
+          SwitchToThread();
+        }
+        else {
+          if (GetTickCount64() - start >= timeoutMilliseconds) {
+            return ready();
+          }
+          Sleep(1);
+        }
+      }
+    }
+  }
+
+  class SharedTensorRing : public std::enable_shared_from_this<SharedTensorRing> {
+  public:
+    // Creates the section (named, for example, "Local\\MyRing") with
+    // slotCount slots of slotBytes bytes each. Throws if a ring of that name
+    // already exists. Errors are reported as std::system_error.
+    static std::shared_ptr<SharedTensorRing> Create(const std::wstring& name, uint32_t slotBytes,
+                                                    uint32_t slotCount) {
+      if (slotBytes == 0 || slotCount == 0) {
+        throw std::invalid_argument("A tensor ring needs at least one slot of at least one byte.");
+      }
+      uint64_t stride = Details::SlotStride(slotBytes);
+      uint64_t size = Details::RoundUp(sizeof(Details::Header)) + stride * slotCount;
+      HANDLE mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                          static_cast<DWORD>(size >> 32), static_cast<DWORD>(size),
+                                          name.c_str());
+      if (mapping == nullptr) {
+        Details::ThrowWin32Error(GetLastError());
+      }
+      if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mapping);
+        Details::ThrowWin32Error(ERROR_ALREADY_EXISTS);
+      }
+      Details::Header* header = MapView(mapping);
+      auto ring = std::shared_ptr<SharedTensorRing>(
+        new SharedTensorRing(mapping, header, slotCount, slotBytes, stride));
+      // The section starts zeroed; the header is published last so that an
+      // early Open sees a bad magic rather than a half-written header.
+      header->version = Details::Version;
+      header->slotCount = slotCount;
+      header->slotBytes = slotBytes;
+      header->slotStride = stride;
+      new (&header->head) std::atomic<uint64_t>(0);
+      new (&header->tail) std::atomic<uint64_t>(0);
+      new (&header->closed) std::atomic<uint32_t>(0);
+      std::atomic_thread_fence(std::memory_order_release);
+      header->magic = Details::Magic;
+      return ring;
+    }
+
+    // Opens a ring created by another process. The geometry is read from the
+    // header once and checked against the size of the mapped view, so that the
+    // other process cannot later make this one index outside of it.
+    static std::shared_ptr<SharedTensorRing> Open(const std::wstring& name) {
+      HANDLE mapping = OpenFileMappingW(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, name.c_str());
+      if (mapping == nullptr) {
+        Details::ThrowWin32Error(GetLastError());
+      }
+      Details::Header* header = MapView(mapping);
+      bool known = header->magic == Details::Magic && header->version == Details::Version;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      // Owns the view from here on, so that the checks below unmap it when they throw.
+      auto ring = std::shared_ptr<SharedTensorRing>(
+        new SharedTensorRing(mapping, header, header->slotCount, header->slotBytes, header->slotStride));
+      if (!known) {
+        throw std::runtime_error("The shared memory section is not a tensor ring of a known version.");
+      }
+      MEMORY_BASIC_INFORMATION view = {};
+      if (VirtualQuery(header, &view, sizeof(view)) == 0) {
+        Details::ThrowWin32Error(GetLastError());
+      }
+      uint64_t headerSize = Details::RoundUp(sizeof(Details::Header));
+      if (ring->m_slotCount == 0 || ring->m_slotBytes == 0 ||
+          ring->m_slotStride < Details::SlotStride(ring->m_slotBytes) ||
+          ring->m_slotStride % Details::Alignment != 0 || view.RegionSize < headerSize ||
+          (view.RegionSize - headerSize) / ring->m_slotStride < ring->m_slotCount) {
+        throw std::runtime_error("The slots of the tensor ring do not fit its shared memory section.");
+      }
+      return ring;
+    }
+
+    ~SharedTensorRing() {
+      UnmapViewOfFile(m_header);
+      CloseHandle(m_mapping);
+    }
+
+    SharedTensorRing(const SharedTensorRing&) = delete;
+    SharedTensorRing& operator=(const SharedTensorRing&) = delete;
+
+    uint32_t SlotCount() const { return m_slotCount; }
+    uint32_t SlotBytes() const { return m_slotBytes; }
+
+    uint8_t* Payload(uint32_t slot) const {
+      return reinterpret_cast<uint8_t*>(Slot(slot)) + Details::RoundUp(sizeof(Details::SlotHeader));
+    }
+
+    // Producer: waits for a free slot and returns its index in slot.
+    WaitResult AcquireWrite(uint32_t& slot, DWORD timeoutMilliseconds) {
+      uint64_t head = m_header->head.load(std::memory_order_relaxed);
+      bool ready = Details::WaitUntil(
+        [&] { return head - m_header->tail.load(std::memory_order_acquire) < m_slotCount; },
+        timeoutMilliseconds);
+      if (!ready) {
+        return WaitResult::TimedOut;
+      }
+      slot = static_cast<uint32_t>(head % m_slotCount);
+      return WaitResult::Ready;
+    }
+
+    // Producer: publishes the slot returned by AcquireWrite, holding bytes
+    // bytes of payload.
+    void Publish(uint32_t bytes) {
+      uint64_t head = m_header->head.load(std::memory_order_relaxed);
+      Details::SlotHeader* slot = Slot(static_cast<uint32_t>(head % m_slotCount));
+      slot->bytes = bytes;
+      slot->published = Now();
+      m_header->head.store(head + 1, std::memory_order_release);
+    }
+
+    // Producer: no more slots will be published.
+    void Close() { m_header->closed.store(1, std::memory_order_release); }
+
+    // Consumer: waits for a published slot and returns its index in slot.
+    WaitResult AcquireRead(uint32_t& slot, DWORD timeoutMilliseconds) {
+      uint64_t tail = m_header->tail.load(std::memory_order_relaxed);
+      bool closed = false;
+      bool ready = Details::WaitUntil(
+        [&] {
+          // Read closed first: once it is set, a head read after it includes
+          // every slot the producer will ever publish.
+          closed = m_header->closed.load(std::memory_order_acquire) != 0;
+          return m_header->head.load(std::memory_order_acquire) > tail || closed;
+        },
+        timeoutMilliseconds);
+      if (!ready) {
+        return WaitResult::TimedOut;
+      }
+      if (m_header->head.load(std::memory_order_acquire) == tail) {
+        return WaitResult::Closed;
+      }
+      slot = static_cast<uint32_t>(tail % m_slotCount);
+      return WaitResult::Ready;
+    }
+
+    // Consumer: hands the slot returned by AcquireRead back to the producer.
+    // Its payload must no longer be in use, including by a tensor over it.
+    void Release() {
+      m_header->tail.fetch_add(1, std::memory_order_release);
+    }
+
+    uint32_t PublishedBytes(uint32_t slot) const { return Slot(slot)->bytes; }
+    int64_t PublishedAt(uint32_t slot) const { return Slot(slot)->published; }
+
+    static int64_t Now() {
+      LARGE_INTEGER counter;
+      QueryPerformanceCounter(&counter);
+      return counter.QuadPart;
+    }
+
+    static double MillisecondsSince(int64_t start) {
+      LARGE_INTEGER frequency;
+      QueryPerformanceFrequency(&frequency);
+      return (Now() - start) * 1000.0 / frequency.QuadPart;
+    }
+
+#if !defined(TENSORRING_NO_WINRT)
+    // A buffer over the payload of slot that keeps the ring mapped.
+    winrt::Windows::Storage::Streams::IBuffer SlotBuffer(uint32_t slot) {
+      return winrt::make<PayloadBuffer>(shared_from_this(), slot);
+    }
+
+    // A float tensor whose data is the payload of slot. Create one per slot up
+    // front and bind the one AcquireRead returns: the evaluation then reads
+    // the producer's bytes in place.
+    winrt::Windows::AI::MachineLearning::TensorFloat CreateSlotTensor(const std::vector<int64_t>& shape,
+                                                                      uint32_t slot) {
+      return winrt::Windows::AI::MachineLearning::TensorFloat::CreateFromBuffer(shape, SlotBuffer(slot));
+    }
+#endif
+
+  private:
+    SharedTensorRing(HANDLE mapping, Details::Header* header, uint32_t slotCount, uint32_t slotBytes,
+                     uint64_t slotStride)
+        : m_mapping(mapping), m_header(header), m_slotCount(slotCount), m_slotBytes(slotBytes),
+          m_slotStride(slotStride) {}
+
+    // Maps the whole section. Closes mapping if it cannot.
+    static Details::Header* MapView(HANDLE mapping) {
+      void* view = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+      if (view == nullptr) {
+        DWORD error = GetLastError();
+        CloseHandle(mapping);
+        Details::ThrowWin32Error(error);
+      }
+      return static_cast<Details::Header*>(view);
+    }
+
+    Details::SlotHeader* Slot(uint32_t slot) const {
+      uint8_t* base = reinterpret_cast<uint8_t*>(m_header) + Details::RoundUp(sizeof(Details::Header));
+      return reinterpret_cast<Details::SlotHeader*>(base + m_slotStride * slot);
+    }
+
+#if !defined(TENSORRING_NO_WINRT)
+    struct PayloadBuffer
+        : winrt::implements<PayloadBuffer, winrt::Windows::Storage::Streams::IBuffer,
+                            ::Windows::Storage::Streams::IBufferByteAccess> {
+      PayloadBuffer(std::shared_ptr<SharedTensorRing> ring, uint32_t slot)
+          : m_ring(std::move(ring)), m_slot(slot) {}
+
+      uint32_t Capacity() const { return m_ring->SlotBytes(); }
+      uint32_t Length() const { return m_ring->SlotBytes(); }
+      void Length(uint32_t length) {
+        if (length != m_ring->SlotBytes()) {
+          throw winrt::hresult_invalid_argument(L"The length of a ring slot buffer is fixed.");
+        }
+      }
+
+      HRESULT __stdcall Buffer(uint8_t** value) final {
+        *value = m_ring->Payload(m_slot);
+        return S_OK;
+      }
+
+      std::shared_ptr<SharedTensorRing> m_ring;
+      uint32_t m_slot;
+    };
+#endif
+
+    HANDLE m_mapping;
+    Details::Header* m_header;
+    // Copied from the header when the ring is created or opened, never read from shared memory again.
+    const uint32_t m_slotCount;
+    const uint32_t m_slotBytes;
+    const uint64_t m_slotStride;
+  };
+}
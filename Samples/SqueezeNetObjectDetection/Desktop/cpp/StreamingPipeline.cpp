@@ -0,0 +1,226 @@
+#include "pch.h"
+#include "StreamingPipeline.h"
+#include "ResultHelper.h"
+#include "Statistics.h"
+#include <MemoryBuffer.h>
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+using namespace winrt;
+using namespace Windows::Foundation;
+using namespace Windows::AI::MachineLearning;
+using namespace Windows::Media;
+using namespace Windows::Graphics::Imaging;
+using namespace Windows::Storage;
+using namespace std;
+
+struct Frame
+{
+    SoftwareBitmap Bitmap = nullptr;
+    chrono::steady_clock::time_point Captured;
+};
+
+// Stands in for a camera: produces frames in order from a directory of images or a raw BGRA8 file.
+class FrameSource
+{
+public:
+    explicit FrameSource(const StreamingOptions& options) : m_options(options)
+    {
+        if (options.RawWidth > 0 && options.RawHeight > 0)
+        {
+            m_raw.open(filesystem::path(options.SourcePath), ios::binary);
+            if (!m_raw)
+            {
+                throw hresult_invalid_argument(L"Failed to open raw frame file " + options.SourcePath);
+            }
+            return;
+        }
+
+        for (auto& entry : filesystem::directory_iterator(options.SourcePath))
+        {
+            auto extension = entry.path().extension().wstring();
+            if (entry.is_regular_file() &&
+                (_wcsicmp(extension.c_str(), L".png") == 0 || _wcsicmp(extension.c_str(), L".jpg") == 0 ||
+                 _wcsicmp(extension.c_str(), L".jpeg") == 0 || _wcsicmp(extension.c_str(), L".bmp") == 0))
+            {
+                m_images.push_back(entry.path().wstring());
+            }
+        }
+        if (m_images.empty())
+        {
+            throw hresult_invalid_argument(L"No .png, .jpg or .bmp images found in " + options.SourcePath);
+        }
+        sort(m_images.begin(), m_images.end());
+    }
+
+    // Returns a null bitmap when the source is exhausted.
+    SoftwareBitmap Next()
+    {
+        if (m_options.FrameCount > 0 && m_produced == m_options.FrameCount)
+        {
+            return nullptr;
+        }
+        SoftwareBitmap bitmap = m_raw.is_open() ? NextRawFrame() : NextImage();
+        if (bitmap != nullptr)
+        {
+            m_produced++;
+        }
+        return bitmap;
+    }
+
+private:
+    SoftwareBitmap NextImage()
+    {
+        if (m_options.FrameCount == 0 && m_produced == m_images.size())
+        {
+            return nullptr;
+        }
+        const wstring& path = m_images[m_produced % m_images.size()];
+        StorageFile file = StorageFile::GetFileFromPathAsync(path).get();
+        auto stream = file.OpenAsync(FileAccessMode::Read).get();
+        BitmapDecoder decoder = BitmapDecoder::CreateAsync(stream).get();
+        return decoder.GetSoftwareBitmapAsync(BitmapPixelFormat::Bgra8, BitmapAlphaMode::Premultiplied).get();
+    }
+
+    SoftwareBitmap NextRawFrame()
+    {
+        size_t rowSize = static_cast<size_t>(m_options.RawWidth) * 4;
+        m_rawFrame.resize(rowSize * m_options.RawHeight);
+        if (!m_raw.read(reinterpret_cast<char*>(m_rawFrame.data()), m_rawFrame.size()))
+        {
+            if (m_options.FrameCount == 0 || m_produced == 0)
+            {
+                return nullptr;
+            }
+            // Loop the recording until FrameCount frames were captured.
+            m_raw.clear();
+            m_raw.seekg(0);
+            if (!m_raw.read(reinterpret_cast<char*>(m_rawFrame.data()), m_rawFrame.size()))
+            {
+                return nullptr;
+            }
+        }
+
+        SoftwareBitmap bitmap(BitmapPixelFormat::Bgra8, m_options.RawWidth, m_options.RawHeight,
+                              BitmapAlphaMode::Premultiplied);
+        {
+            BitmapBuffer buffer = bitmap.LockBuffer(BitmapBufferAccessMode::Write);
+            IMemoryBufferReference reference = buffer.CreateReference();
+            uint8_t* data = nullptr;
+            uint32_t capacity = 0;
+            check_hresult(reference.as<::Windows::Foundation::IMemoryBufferByteAccess>()->GetBuffer(&data, &capacity));
+            uint32_t stride = buffer.GetPlaneDescription(0).Stride;
+            for (uint32_t y = 0; y < m_options.RawHeight; y++)
+            {
+                memcpy(data + static_cast<size_t>(y) * stride, m_rawFrame.data() + y * rowSize, rowSize);
+            }
+        }
+        return bitmap;
+    }
+
+    const StreamingOptions& m_options;
+    vector<wstring> m_images;
+    ifstream m_raw;
+    vector<uint8_t> m_rawFrame;
+    size_t m_produced = 0;
+};
+
+void RunStreamingClassifier(const LearningModel& model, const LearningModelDevice& device,
+                            const StreamingOptions& options, const ResultHelper::LabelTable& labels)
+{
+    auto inputName = model.InputFeatures().GetAt(0).Name();
+    auto outputDescriptor = model.OutputFeatures().GetAt(0).as<TensorFeatureDescriptor>();
+    vector<int64_t> outputShape;
+    for (auto dim : outputDescriptor.Shape())
+    {
+        outputShape.push_back(dim > 0 ? dim : 1);
+    }
+
+    // One session and one binding for the whole stream. The output tensor is bound once and WinML writes every
+    // result into it, so no per-frame output allocation takes place.
+    LearningModelSession session(model, device);
+    LearningModelBinding binding(session);
+    TensorFloat output = TensorFloat::Create(outputShape);
+    binding.Bind(outputDescriptor.Name(), output);
+
+    FrameQueue<Frame> queue(options.QueueCapacity);
+    atomic<uint64_t> captured = 0;
+    atomic<uint64_t> dropped = 0;
+    exception_ptr captureError;
+
+    auto start = chrono::steady_clock::now();
+    thread decodeStage([&]() {
+        try
+        {
+            init_apartment();
+            FrameSource source(options);
+            auto period = chrono::duration<double>(options.FramesPerSecond > 0 ? 1.0 / options.FramesPerSecond : 0);
+            auto nextCapture = chrono::steady_clock::now();
+            while (true)
+            {
+                if (options.FramesPerSecond > 0)
+                {
+                    this_thread::sleep_until(nextCapture);
+                    nextCapture += chrono::duration_cast<chrono::steady_clock::duration>(period);
+                }
+                Frame frame;
+                frame.Captured = chrono::steady_clock::now();
+                frame.Bitmap = source.Next();
+                if (frame.Bitmap == nullptr)
+                {
+                    break;
+                }
+                captured++;
+                if (queue.Push(move(frame)))
+                {
+                    dropped++;
+                }
+            }
+        }
+        catch (...)
+        {
+            captureError = current_exception();
+        }
+        queue.Close();
+    });
+
+    vector<double> latencies;
+    Frame frame;
+    uint32_t lastLabel = UINT32_MAX;
+    vector<ResultHelper::Prediction> top;
+    while (queue.Pop(frame))
+    {
+        auto videoFrame = VideoFrame::CreateWithSoftwareBitmap(frame.Bitmap);
+        binding.Bind(inputName, ImageFeatureValue::CreateFromVideoFrame(videoFrame));
+        session.Evaluate(binding, L"");
+        latencies.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - frame.Captured).count());
+
+        // Report the top-1 class whenever it changes rather than for every frame.
+        ResultHelper::TensorData scores(output);
+        ResultHelper::TopK(scores.Data(), scores.Size(), 1, top);
+        if (!top.empty() && top[0].index != lastLabel)
+        {
+            const char* label = labels.Get(top[0].index);
+            printf("frame %zu: %s with confidence of %f\n", latencies.size() - 1, *label ? label : "unknown",
+                   top[0].score);
+            lastLabel = top[0].index;
+        }
+    }
+    double elapsedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    decodeStage.join();
+    if (captureError)
+    {
+        rethrow_exception(captureError);
+    }
+
+    sort(latencies.begin(), latencies.end());
+    printf("\nCaptured %llu frames, classified %zu, dropped %llu (queue capacity %zu)\n",
+           static_cast<unsigned long long>(captured.load()), latencies.size(),
+           static_cast<unsigned long long>(dropped.load()), options.QueueCapacity);
+    printf("Sustained throughput: %.2f FPS over %.2f s\n", elapsedSeconds > 0 ? latencies.size() / elapsedSeconds : 0.0,
+           elapsedSeconds);
+    printf("Capture-to-result latency (ms): p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n",
+           Statistics::Percentile(latencies, 50), Statistics::Percentile(latencies, 90),
+           Statistics::Percentile(latencies, 99), latencies.empty() ? 0.0 : latencies.back());
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ResultHelper
+{
+    class LabelTable;
+}
+
+// Bounded queue between the decode and inference stages. When the queue is full the oldest frame is dropped, so the
+// inference stage always works on the most recent frames, the way a live camera feed behaves.
+template <typename T>
+class FrameQueue
+{
+public:
+    explicit FrameQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1) {}
+
+    // Returns true if a queued frame had to be dropped to make room.
+    bool Push(T item)
+    {
+        bool dropped = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_items.size() == m_capacity)
+            {
+                m_items.pop_front();
+                dropped = true;
+            }
+            m_items.push_back(std::move(item));
+        }
+        m_condVar.notify_one();
+        return dropped;
+    }
+
+    // Blocks until a frame is available. Returns false once the queue is closed and drained.
+    bool Pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condVar.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty())
+        {
+            return false;
+        }
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        return true;
+    }
+
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_condVar.notify_all();
+    }
+
+private:
+    size_t m_capacity;
+    std::deque<T> m_items;
+    bool m_closed = false;
+    std::mutex m_mutex;
+    std::condition_variable m_condVar;
+};
+
+struct StreamingOptions
+{
+    // A directory of images, or a file of raw BGRA8 frames when RawWidth and RawHeight are set.
+    std::wstring SourcePath;
+    uint32_t RawWidth = 0;
+    uint32_t RawHeight = 0;
+    // Total frames to capture. Directories are cycled through until this many frames were produced; zero means one
+    // pass over the directory or raw file.
+    uint32_t FrameCount = 0;
+    // Simulated camera rate. Zero captures as fast as frames can be decoded.
+    double FramesPerSecond = 30;
+    size_t QueueCapacity = 4;
+};
+
+// Runs a decode thread that captures frames from the source into a FrameQueue and classifies them on the calling
+// thread with a single session and binding whose output is bound once up front. Prints sustained throughput,
+// capture-to-result latency percentiles and the number of dropped frames.
+void RunStreamingClassifier(const winrt::Windows::AI::MachineLearning::LearningModel& model,
+                            const winrt::Windows::AI::MachineLearning::LearningModelDevice& device,
+                            const StreamingOptions& options,
+                            const ResultHelper::LabelTable& labels);
@@ -3,6 +3,9 @@
 
 #include "pch.h"
 #include "FileHelper.h"
+#include "ResultHelper.h"
+#include "StreamingPipeline.h"
+#include <filesystem>
 
 using namespace winrt;
 using namespace Windows::Foundation;
@@ -14,14 +17,15 @@ using namespace Windows::Storage;
 using namespace std;
 
 // globals
-vector<string> labels;
 string labelsFileName("labels.txt");
 LearningModelDeviceKind deviceKind = LearningModelDeviceKind::Default;
 string deviceName = "default";
 hstring imagePath;
+bool streaming = false;
+StreamingOptions streamingOptions;
 
 VideoFrame LoadImageFile(hstring filePath, ColorManagementMode colorManagementMode);
-void PrintResults(IVectorView<float> results);
+void PrintResults(const TensorFloat& results);
 bool ParseArgs(int argc, char* argv[]);
 ColorManagementMode GetColorManagementMode(const LearningModel& model);
 
@@ -34,7 +38,8 @@ wstring GetModelPath()
 }
 
 // MAIN !
-// usage: SqueezeNet [imagefile] [cpu|directx]
+// usage: SqueezeNet [imagefile|imagefolder|rawfile] [cpu|directx] [-raw <width> <height>] [-frames <count>]
+//                   [-fps <rate>] [-queue <capacity>]
 int main(int argc, char* argv[])
 {
     init_apartment();
@@ -42,7 +47,9 @@ int main(int argc, char* argv[])
     // did they pass in the args 
     if (ParseArgs(argc, argv) == false)
     {
-        printf("Usage: %s [imagefile] [cpu|directx]", argv[0]);
+        printf("Usage: %s [imagefile|imagefolder|rawfile] [cpu|directx] [-raw <width> <height>] [-frames <count>] "
+               "[-fps <rate>] [-queue <capacity>]",
+               argv[0]);
         return -1;
     }
 
@@ -56,6 +63,30 @@ int main(int argc, char* argv[])
     ticks = GetTickCount() - ticks;
     printf("model file loaded in %d ticks\n", ticks);
 
+    if (streaming)
+    {
+        // classify a folder of images or a raw frame recording as a simulated camera feed
+        auto modulePath = FileHelper::GetModulePath();
+        auto& labels = FileHelper::LoadLabelTable(std::string(modulePath.begin(), modulePath.end()) + labelsFileName);
+        printf("Streaming from '%ws' at %.1f FPS with a queue of %zu frames...\n", streamingOptions.SourcePath.c_str(),
+               streamingOptions.FramesPerSecond, streamingOptions.QueueCapacity);
+        try
+        {
+            RunStreamingClassifier(model, LearningModelDevice(deviceKind), streamingOptions, labels);
+        }
+        catch (hresult_error hr)
+        {
+            printf("    Streaming failed: %ws\n", hr.message().c_str());
+            return hr.code();
+        }
+        catch (std::exception& e)
+        {
+            printf("    Streaming failed: %s\n", e.what());
+            return EXIT_FAILURE;
+        }
+        return 0;
+    }
+
     // get model color management mode
     printf("Getting model color management mode...\n");
     ColorManagementMode colorManagementMode = GetColorManagementMode(model);
@@ -83,8 +114,7 @@ int main(int argc, char* argv[])
 
     // get the output
     auto resultTensor = results.Outputs().Lookup(L"softmaxout_1").as<TensorFloat>();
-    auto resultVector = resultTensor.GetAsVectorView();
-    PrintResults(resultVector);
+    PrintResults(resultTensor);
 }
 
 bool ParseArgs(int argc, char* argv[])
@@ -93,10 +123,47 @@ bool ParseArgs(int argc, char* argv[])
     {
         return false;
     }
-    // get the image file
+    // get the image file, image folder or raw frame file
     imagePath = hstring(wstring_to_utf8().from_bytes(argv[1]));
-    // did they pass a third arg?
-    if (argc >= 3)
+    streamingOptions.SourcePath = imagePath.c_str();
+    std::error_code error;
+    streaming = std::filesystem::is_directory(streamingOptions.SourcePath, error);
+
+    // streaming options can follow the device
+    int firstOption = (argc >= 3 && argv[2][0] != '-') ? 3 : 2;
+    for (int i = firstOption; i < argc; i++)
+    {
+        string option = argv[i];
+        if (option == "-raw" && i + 2 < argc)
+        {
+            streamingOptions.RawWidth = static_cast<uint32_t>(atoi(argv[++i]));
+            streamingOptions.RawHeight = static_cast<uint32_t>(atoi(argv[++i]));
+            if (streamingOptions.RawWidth == 0 || streamingOptions.RawHeight == 0)
+            {
+                return false;
+            }
+            streaming = true;
+        }
+        else if (option == "-frames" && i + 1 < argc)
+        {
+            streamingOptions.FrameCount = static_cast<uint32_t>(atoi(argv[++i]));
+        }
+        else if (option == "-fps" && i + 1 < argc)
+        {
+            streamingOptions.FramesPerSecond = atof(argv[++i]);
+        }
+        else if (option == "-queue" && i + 1 < argc)
+        {
+            streamingOptions.QueueCapacity = static_cast<size_t>(atoi(argv[++i]));
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    // did they pass a device?
+    if (firstOption == 3)
     {
         deviceName = argv[2];
         if (deviceName == "cpu")
@@ -187,28 +254,21 @@ VideoFrame LoadImageFile(hstring filePath, ColorManagementMode colorManagementMo
     return inputImage;
 }
 
-void PrintResults(IVectorView<float> results)
+void PrintResults(const TensorFloat& results)
 {
     // load the labels
     auto modulePath = FileHelper::GetModulePath();
     std::string labelsFilePath =
       std::string(modulePath.begin(), modulePath.end()) + labelsFileName;
-    labels = FileHelper::LoadLabels(labelsFilePath);
-
-    vector<pair<float, uint32_t>> sortedResults;
-    for (uint32_t i = 0; i < results.Size(); i++) {
-        pair<float, uint32_t> curr;
-        curr.first = results.GetAt(i);
-        curr.second = i;
-        sortedResults.push_back(curr);
-    }
-    std::sort(sortedResults.begin(), sortedResults.end(),
-        [](pair<float, uint32_t> const &a, pair<float, uint32_t> const &b) { return a.first > b.first; });
+    auto& labels = FileHelper::LoadLabelTable(labelsFilePath);
+
+    // read the scores straight from the output buffer and keep only the top 3
+    ResultHelper::TensorData scores(results);
+    auto topResults = ResultHelper::TopK(scores.Data(), scores.Size(), 3);
 
     // Display the result
-    for (int i = 0; i < 3; i++)
+    for (auto& prediction : topResults)
     {
-        pair<float, uint32_t> curr = sortedResults.at(i);
-        printf("%s with confidence of %f\n", labels[curr.second].c_str(), curr.first);
+        printf("%s with confidence of %f\n", labels.Get(prediction.index), prediction.score);
     }
 }
@@ -1,6 +1,7 @@
 ﻿#include "pch.h"
 #include <Windows.h>
 #include "resource.h"
+#include "ModelSource.h"
 #include <winrt/windows.storage.streams.h>
 #include <winrt/Windows.AI.MachineLearning.h>
 
@@ -12,39 +13,22 @@ int main()
 {
     init_apartment();
 
-    // Find the resource
-    const auto modelResource = FindResource(NULL, MAKEINTRESOURCE(IDR_SQUEEZENET_MODEL), DataFileTypeString);
-    if (modelResource == nullptr)
-    {
-        printf("failed to find resource.");
-        return 1;
-    }
-
-    // Load the resource
-    const auto modelMem = LoadResource(NULL, modelResource);
-    if (modelMem == nullptr)
-    {
-        printf("failed to load resource");
-        return 2;
-    }
-
     try
     {
-        // get a byte point to the resource
-        const unsigned char* pModelData = static_cast<const unsigned char*>(LockResource(modelMem));
-        const auto size = SizeofResource(NULL, modelResource);
-
-        // write the bytes into a stream
-        InMemoryRandomAccessStream modelStream;
-        DataWriter writer(modelStream);
-        writer.WriteBytes(array_view<const unsigned char>(pModelData, pModelData + size));
-        writer.StoreAsync().get();
-
-        // clean up.
-        FreeResource(modelMem);
-
-        // wrap the stream in a stream reference
-        auto modelStreamReference = RandomAccessStreamReference::CreateFromStream(modelStream);
+        // view the embedded model in place; the resource is already mapped as part of the executable image
+        std::shared_ptr<ModelSource::ModelBytes> modelBytes;
+        try
+        {
+            modelBytes = ModelSource::ModelBytes::FromResource(NULL, MAKEINTRESOURCE(IDR_SQUEEZENET_MODEL), DataFileTypeString);
+        }
+        catch (...)
+        {
+            printf("failed to find or load resource.");
+            return 1;
+        }
+
+        // wrap the bytes in a stream reference without copying them into an intermediate stream
+        auto modelStreamReference = ModelSource::CreateStreamReference(modelBytes);
 
         // load the model from stream reference
         auto learningModel = LearningModel::LoadFromStream(modelStreamReference);
@@ -0,0 +1,916 @@
+#include "CppUnitTest.h"
+#include "BackendHarness.h"
+#include "OnnxCostModel.h"
+#include "OnnxExternalData.h"
+#include "OnnxFloat16.h"
+#include "OnnxInspector.h"
+#include "OnnxQuantizer.h"
+#include "ReferenceBackend.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace InferenceBackend;
+
+namespace ReferenceBackendTest
+{
+    // Just enough of a protobuf writer to build ONNX models in memory.
+    class Message
+    {
+    public:
+        Message& Varint(uint32_t field, int64_t value)
+        {
+            Key(field, 0);
+            WriteVarint(static_cast<uint64_t>(value));
+            return *this;
+        }
+
+        Message& Float(uint32_t field, float value)
+        {
+            Key(field, 5);
+            m_bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+            return *this;
+        }
+
+        Message& Bytes(uint32_t field, const std::string& bytes)
+        {
+            Key(field, 2);
+            WriteVarint(bytes.size());
+            m_bytes += bytes;
+            return *this;
+        }
+
+        Message& Child(uint32_t field, const Message& child) { return Bytes(field, child.m_bytes); }
+
+        const std::string& Data() const { return m_bytes; }
+
+    private:
+        void Key(uint32_t field, uint32_t wireType) { WriteVarint(field << 3 | wireType); }
+
+        void WriteVarint(uint64_t value)
+        {
+            do
+            {
+                uint8_t byte = value & 0x7f;
+                value >>= 7;
+                m_bytes.push_back(static_cast<char>(value != 0 ? byte | 0x80 : byte));
+            } while (value != 0);
+        }
+
+        std::string m_bytes;
+    };
+
+    // A float graph input or output. Negative dimensions are free.
+    static Message Value(const std::string& name, const std::vector<int64_t>& shape)
+    {
+        Message dims;
+        for (int64_t dim : shape)
+        {
+            dims.Child(1, dim < 0 ? Message().Bytes(2, "N") : Message().Varint(1, dim));
+        }
+        Message tensorType;
+        tensorType.Varint(1, 1).Child(2, dims);
+        return Message().Bytes(1, name).Child(2, Message().Child(1, tensorType));
+    }
+
+    static Message FloatInitializer(const std::string& name, const std::vector<int64_t>& shape,
+                                    const std::vector<float>& values)
+    {
+        Message tensor;
+        for (int64_t dim : shape)
+        {
+            tensor.Varint(1, dim);
+        }
+        tensor.Varint(2, 1).Bytes(8, name);
+        const char* data = reinterpret_cast<const char*>(values.data());
+        return tensor.Bytes(9, std::string(data, values.size() * sizeof(float)));
+    }
+
+    static Message Int64Initializer(const std::string& name, const std::vector<int64_t>& values)
+    {
+        Message tensor;
+        tensor.Varint(1, static_cast<int64_t>(values.size())).Varint(2, 7).Bytes(8, name);
+        for (int64_t value : values)
+        {
+            tensor.Varint(7, value);
+        }
+        return tensor;
+    }
+
+    static Message IntAttribute(const std::string& name, int64_t value)
+    {
+        return Message().Bytes(1, name).Varint(20, 2).Varint(3, value);
+    }
+
+    static Message FloatAttribute(const std::string& name, float value)
+    {
+        return Message().Bytes(1, name).Varint(20, 1).Float(2, value);
+    }
+
+    static Message StringAttribute(const std::string& name, const std::string& value)
+    {
+        return Message().Bytes(1, name).Varint(20, 3).Bytes(4, value);
+    }
+
+    static Message IntsAttribute(const std::string& name, const std::vector<int64_t>& values)
+    {
+        Message attribute;
+        attribute.Bytes(1, name).Varint(20, 7);
+        for (int64_t value : values)
+        {
+            attribute.Varint(8, value);
+        }
+        return attribute;
+    }
+
+    static Message Node(const std::string& opType, const std::vector<std::string>& inputs,
+                        const std::vector<std::string>& outputs, const std::vector<Message>& attributes = {})
+    {
+        Message node;
+        for (const auto& input : inputs)
+        {
+            node.Bytes(1, input);
+        }
+        for (const auto& output : outputs)
+        {
+            node.Bytes(2, output);
+        }
+        node.Bytes(4, opType);
+        for (const auto& attribute : attributes)
+        {
+            node.Child(5, attribute);
+        }
+        return node;
+    }
+
+    // A serialized model with input X, output Y and the given initializers.
+    static std::string ModelBytes(const std::vector<Message>& nodes, const std::vector<int64_t>& inputShape,
+                                  const std::vector<Message>& initializers = {}, int64_t opset = 13)
+    {
+        Message graph;
+        for (const auto& node : nodes)
+        {
+            graph.Child(1, node);
+        }
+        graph.Bytes(2, "test");
+        for (const auto& initializer : initializers)
+        {
+            graph.Child(5, initializer);
+        }
+        graph.Child(11, Value("X", inputShape)).Child(12, Value("Y", {}));
+        Message model;
+        model.Varint(1, 7).Child(7, graph).Child(8, Message().Varint(2, opset));
+        return model.Data();
+    }
+
+    static std::unique_ptr<Model> LoadGraph(const std::vector<Message>& nodes, const std::vector<int64_t>& inputShape,
+                                            const std::vector<Message>& initializers = {}, int64_t opset = 13,
+                                            const Reference::Options& options = {})
+    {
+        std::string bytes = ModelBytes(nodes, inputShape, initializers, opset);
+        auto onnx = Onnx::ParseModel(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+        return std::make_unique<ReferenceModel>(*onnx, options);
+    }
+
+    static std::unique_ptr<Model> LoadNode(const Message& node, const std::vector<int64_t>& inputShape,
+                                           const std::vector<Message>& initializers = {}, int64_t opset = 13)
+    {
+        return LoadGraph({ node }, inputShape, initializers, opset);
+    }
+
+    static std::vector<float> RandomValues(size_t count, std::mt19937& generator)
+    {
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+        std::vector<float> values(count);
+        for (auto& value : values)
+        {
+            value = distribution(generator);
+        }
+        return values;
+    }
+
+    static std::vector<float> Evaluate(Model& model, const std::vector<int64_t>& shape, const std::vector<float>& x,
+                                       std::vector<int64_t>* outputShape = nullptr)
+    {
+        Tensor input(ElementType::Float, shape);
+        std::copy(x.begin(), x.end(), input.Data<float>());
+        auto session = model.CreateSession();
+        session->Bind("X", input);
+        session->Evaluate();
+        const Tensor& output = session->Output("Y");
+        if (outputShape != nullptr)
+        {
+            *outputShape = output.Shape();
+        }
+        return std::vector<float>(output.Data<float>(), output.Data<float>() + output.ElementCount());
+    }
+
+    static void CheckClose(const std::vector<float>& expected, const std::vector<float>& actual)
+    {
+        Assert::AreEqual(expected.size(), actual.size());
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            Assert::AreEqual(expected[i], actual[i], 1e-5f);
+        }
+    }
+
+    TEST_CLASS(ReferenceBackendTest)
+    {
+    public:
+        TEST_METHOD(ConvAppliesPadsStridesAndBias)
+        {
+            auto model = LoadNode(Node("Conv", { "X", "W", "B" }, { "Y" },
+                                       { IntsAttribute("pads", { 1, 1, 1, 1 }), IntsAttribute("strides", { 2, 2 }) }),
+                                  { 1, 1, 3, 3 },
+                                  { FloatInitializer("W", { 1, 1, 2, 2 }, { 1, 1, 1, 1 }),
+                                    FloatInitializer("B", { 1 }, { 0.5f }) });
+            std::vector<int64_t> shape;
+            CheckClose({ 1.5f, 5.5f, 11.5f, 28.5f },
+                       Evaluate(*model, { 1, 1, 3, 3 }, { 1, 2, 3, 4, 5, 6, 7, 8, 9 }, &shape));
+            Assert::IsTrue(shape == std::vector<int64_t>{ 1, 1, 2, 2 });
+        }
+
+        TEST_METHOD(ConvSameUpperPadsAtTheEnd)
+        {
+            auto model = LoadNode(Node("Conv", { "X", "W" }, { "Y" }, { StringAttribute("auto_pad", "SAME_UPPER") }),
+                                  { 1, 1, 3, 3 }, { FloatInitializer("W", { 1, 1, 2, 2 }, { 1, 1, 1, 1 }) });
+            CheckClose({ 4, 4, 2, 4, 4, 2, 2, 2, 1 }, Evaluate(*model, { 1, 1, 3, 3 }, std::vector<float>(9, 1.0f)));
+        }
+
+        TEST_METHOD(MaxPoolCeilModeAddsPartialWindows)
+        {
+            std::vector<float> x(16);
+            for (size_t i = 0; i < x.size(); i++)
+            {
+                x[i] = static_cast<float>(i);
+            }
+            auto floor = LoadNode(Node("MaxPool", { "X" }, { "Y" },
+                                       { IntsAttribute("kernel_shape", { 3, 3 }), IntsAttribute("strides", { 2, 2 }) }),
+                                  { 1, 1, 4, 4 });
+            CheckClose({ 10 }, Evaluate(*floor, { 1, 1, 4, 4 }, x));
+            auto ceil = LoadNode(Node("MaxPool", { "X" }, { "Y" },
+                                      { IntsAttribute("kernel_shape", { 3, 3 }), IntsAttribute("strides", { 2, 2 }),
+                                        IntAttribute("ceil_mode", 1) }),
+                                 { 1, 1, 4, 4 });
+            CheckClose({ 10, 11, 14, 15 }, Evaluate(*ceil, { 1, 1, 4, 4 }, x));
+        }
+
+        TEST_METHOD(AveragePoolCountsPaddingOnlyWhenAsked)
+        {
+            for (int64_t countIncludePad = 0; countIncludePad <= 1; countIncludePad++)
+            {
+                auto model = LoadNode(Node("AveragePool", { "X" }, { "Y" },
+                                           { IntsAttribute("kernel_shape", { 2, 2 }),
+                                             IntsAttribute("pads", { 1, 1, 1, 1 }),
+                                             IntAttribute("count_include_pad", countIncludePad) }),
+                                      { 1, 1, 2, 2 });
+                auto y = Evaluate(*model, { 1, 1, 2, 2 }, { 1, 2, 3, 4 });
+                Assert::AreEqual(size_t(9), y.size());
+                Assert::AreEqual(countIncludePad ? 0.25f : 1.0f, y[0], 1e-6f);
+                Assert::AreEqual(2.5f, y[4], 1e-6f);
+            }
+        }
+
+        TEST_METHOD(AddBroadcastsLikeNumpy)
+        {
+            auto row = LoadNode(Node("Add", { "X", "B" }, { "Y" }), { 2, 3 },
+                                { FloatInitializer("B", { 3 }, { 10, 20, 30 }) });
+            CheckClose({ 10, 21, 32, 13, 24, 35 }, Evaluate(*row, { 2, 3 }, { 0, 1, 2, 3, 4, 5 }));
+            auto outer = LoadNode(Node("Add", { "X", "B" }, { "Y" }), { 2, 1 },
+                                  { FloatInitializer("B", { 1, 3 }, { 10, 20, 30 }) });
+            std::vector<int64_t> shape;
+            CheckClose({ 11, 21, 31, 12, 22, 32 }, Evaluate(*outer, { 2, 1 }, { 1, 2 }, &shape));
+            Assert::IsTrue(shape == std::vector<int64_t>{ 2, 3 });
+        }
+
+        TEST_METHOD(SoftmaxAxisFollowsTheOpset)
+        {
+            // Before opset 13 the input is flattened from axis on; from 13 on only the axis is normalized.
+            auto opset11 = LoadNode(Node("Softmax", { "X" }, { "Y" }, { IntAttribute("axis", 0) }), { 2, 2 }, {}, 11);
+            auto y11 = Evaluate(*opset11, { 2, 2 }, { 1, 2, 3, 4 });
+            float sum = std::exp(1.0f) + std::exp(2.0f) + std::exp(3.0f) + std::exp(4.0f);
+            Assert::AreEqual(std::exp(1.0f) / sum, y11[0], 1e-6f);
+
+            auto opset13 = LoadNode(Node("Softmax", { "X" }, { "Y" }, { IntAttribute("axis", 0) }), { 2, 2 }, {}, 13);
+            auto y13 = Evaluate(*opset13, { 2, 2 }, { 1, 2, 3, 4 });
+            Assert::AreEqual(1.0f / (1.0f + std::exp(2.0f)), y13[0], 1e-6f);
+            Assert::AreEqual(1.0f, y13[0] + y13[2], 1e-6f);
+        }
+
+        TEST_METHOD(GemmTransposesAndAddsBias)
+        {
+            auto model = LoadNode(Node("Gemm", { "X", "W", "C" }, { "Y" }, { IntAttribute("transB", 1),
+                                                                            FloatAttribute("alpha", 2.0f) }),
+                                  { 1, 2 },
+                                  { FloatInitializer("W", { 3, 2 }, { 1, 0, 0, 1, 1, 1 }),
+                                    FloatInitializer("C", { 3 }, { 1, 1, 1 }) });
+            CheckClose({ 3, 5, 7 }, Evaluate(*model, { 1, 2 }, { 1, 2 }));
+        }
+
+        TEST_METHOD(ReshapeInfersTheFreeDimension)
+        {
+            auto model =
+                LoadNode(Node("Reshape", { "X", "S" }, { "Y" }), { 2, 3 }, { Int64Initializer("S", { 0, -1, 1 }) });
+            std::vector<int64_t> shape;
+            CheckClose({ 0, 1, 2, 3, 4, 5 }, Evaluate(*model, { 2, 3 }, { 0, 1, 2, 3, 4, 5 }, &shape));
+            Assert::IsTrue(shape == std::vector<int64_t>{ 2, 3, 1 });
+        }
+
+        TEST_METHOD(TransposeDefaultsToReversedAxes)
+        {
+            auto model = LoadNode(Node("Transpose", { "X" }, { "Y" }), { 2, 3 });
+            CheckClose({ 0, 3, 1, 4, 2, 5 }, Evaluate(*model, { 2, 3 }, { 0, 1, 2, 3, 4, 5 }));
+        }
+
+        TEST_METHOD(FreeDimensionsAcceptAnySize)
+        {
+            auto model = LoadNode(Node("Relu", { "X" }, { "Y" }), { -1, 2 });
+            CheckClose({ 0, 1, 0, 3, 0, 5 }, Evaluate(*model, { 3, 2 }, { -1, 1, -2, 3, -4, 5 }));
+            Assert::ExpectException<std::runtime_error>([&]() { Evaluate(*model, { 3, 3 }, std::vector<float>(9)); });
+        }
+
+        TEST_METHOD(PackedConvMatchesDirectConv)
+        {
+            struct Case
+            {
+                int64_t batch, channels, size, outputChannels, kernel, stride, pad, dilation, group;
+            };
+            // Deep and wide enough to cross the GEMM blocks, plus the 1x1 path, groups and dilation.
+            const Case cases[] = {
+                { 1, 32, 20, 72, 3, 1, 1, 1, 1 }, { 2, 16, 9, 8, 1, 1, 0, 1, 1 }, { 1, 8, 11, 12, 3, 2, 0, 1, 4 },
+                { 1, 3, 15, 5, 5, 3, 2, 2, 1 },   { 1, 6, 7, 6, 1, 2, 1, 1, 6 },
+            };
+            std::mt19937 generator(0);
+            for (const Case& c : cases)
+            {
+                std::vector<int64_t> xShape = { c.batch, c.channels, c.size, c.size };
+                std::vector<int64_t> wShape = { c.outputChannels, c.channels / c.group, c.kernel, c.kernel };
+                std::vector<Message> initializers = {
+                    FloatInitializer("W", wShape, RandomValues(c.outputChannels * wShape[1] * c.kernel * c.kernel,
+                                                               generator)),
+                    FloatInitializer("B", { c.outputChannels }, RandomValues(c.outputChannels, generator))
+                };
+                Message conv = Node("Conv", { "X", "W", "B" }, { "Y" },
+                                    { IntsAttribute("kernel_shape", { c.kernel, c.kernel }),
+                                      IntsAttribute("strides", { c.stride, c.stride }),
+                                      IntsAttribute("pads", { c.pad, c.pad, c.pad, c.pad }),
+                                      IntsAttribute("dilations", { c.dilation, c.dilation }),
+                                      IntAttribute("group", c.group) });
+                Reference::Options direct;
+                direct.optimize = false;
+                Reference::Options packed;
+                packed.threads = 3;
+                auto expected = LoadGraph({ conv }, xShape, initializers, 13, direct);
+                auto actual = LoadGraph({ conv }, xShape, initializers, 13, packed);
+                std::vector<float> x = RandomValues(static_cast<size_t>(Reference::Product(xShape, 0, 4)), generator);
+                std::vector<int64_t> expectedShape;
+                std::vector<int64_t> actualShape;
+                std::vector<float> y = Evaluate(*expected, xShape, x, &expectedShape);
+                std::vector<float> yPacked = Evaluate(*actual, xShape, x, &actualShape);
+                Assert::IsTrue(expectedShape == actualShape);
+                Assert::AreEqual(y.size(), yPacked.size());
+                for (size_t i = 0; i < y.size(); i++)
+                {
+                    Assert::AreEqual(y[i], yPacked[i], 1e-4f);
+                }
+            }
+        }
+
+        TEST_METHOD(ConvReluRunsAsOneProfiledLayer)
+        {
+            Reference::Options options;
+            options.profile = true;
+            auto model = LoadGraph({ Node("Conv", { "X", "W" }, { "C" }), Node("Relu", { "C" }, { "Y" }) },
+                                   { 1, 1, 2, 2 }, { FloatInitializer("W", { 2, 1, 1, 1 }, { 1, -1 }) }, 13, options);
+            Tensor input(ElementType::Float, { 1, 1, 2, 2 });
+            const float x[] = { 1, -2, 3, -4 };
+            std::copy(x, x + 4, input.Data<float>());
+            auto session = model->CreateSession();
+            session->Bind("X", input);
+            session->Evaluate();
+            session->Evaluate();
+            const Tensor& y = session->Output("Y");
+            CheckClose({ 1, 0, 3, 0, 0, 2, 0, 4 }, std::vector<float>(y.Data<float>(), y.Data<float>() + 8));
+
+            const auto& profile = dynamic_cast<ReferenceSession&>(*session).Profile();
+            Assert::AreEqual(size_t(1), profile.size());
+            Assert::AreEqual(std::string("Conv+Relu"), profile[0].opType);
+            Assert::AreEqual(2u, profile[0].evaluations);
+            // Eight outputs of one multiply-add each, twice.
+            Assert::AreEqual(32.0, profile[0].flops);
+        }
+
+        TEST_METHOD(IntermediateValuesShareBuffers)
+        {
+            // A is read again after B and C are dead, so D and Y take their buffers.
+            auto model = LoadGraph({ Node("Relu", { "X" }, { "A" }), Node("Sigmoid", { "A" }, { "B" }),
+                                     Node("Tanh", { "B" }, { "C" }), Node("Add", { "C", "A" }, { "D" }),
+                                     Node("Relu", { "D" }, { "Y" }) },
+                                   { 3 });
+            Tensor input(ElementType::Float, { 3 });
+            const float x[] = { -1, 0, 2 };
+            std::copy(x, x + 3, input.Data<float>());
+            auto session = model->CreateSession();
+            session->Bind("X", input);
+            session->Evaluate();
+            const Tensor& y = session->Output("Y");
+            std::vector<float> expected;
+            for (float value : x)
+            {
+                float a = (std::max)(value, 0.0f);
+                expected.push_back(std::tanh(1.0f / (1.0f + std::exp(-a))) + a);
+            }
+            CheckClose(expected, std::vector<float>(y.Data<float>(), y.Data<float>() + 3));
+            // X keeps its own buffer; A, B and C need one each.
+            Assert::AreEqual(size_t(4), dynamic_cast<ReferenceSession&>(*session).BufferCount());
+        }
+
+        TEST_METHOD(UnsupportedOperatorFailsAtLoad)
+        {
+            Assert::ExpectException<std::runtime_error>([]() { LoadNode(Node("LSTM", { "X" }, { "Y" }), { 1, 1 }); });
+        }
+    };
+
+    static Onnx::ModelSummary Inspect(const std::string& bytes)
+    {
+        return Onnx::InspectModel(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+    }
+
+    TEST_CLASS(OnnxInspectorTest)
+    {
+    public:
+        TEST_METHOD(InspectorCountsOperatorsAndInitializerBytes)
+        {
+            auto summary = Inspect(ModelBytes({ Node("Conv", { "X", "W", "B" }, { "C" }),
+                                                Node("Relu", { "C" }, { "R" }), Node("Relu", { "R" }, { "Y" }) },
+                                              { 1, 1, 3, 3 },
+                                              { FloatInitializer("W", { 1, 1, 2, 2 }, { 1, 1, 1, 1 }),
+                                                FloatInitializer("B", { 1 }, { 0.5f }) },
+                                              11));
+            Assert::AreEqual(std::string(), summary.Problem());
+            Assert::AreEqual(int64_t(11), summary.Opset());
+            Assert::AreEqual(size_t(3), summary.nodeCount);
+            Assert::AreEqual(size_t(2), summary.operators["Relu"]);
+            Assert::AreEqual(size_t(1), summary.operators["Conv"]);
+            Assert::AreEqual(size_t(1), summary.inputs.size());
+            Assert::AreEqual(std::string("X"), summary.inputs[0].name);
+            Assert::IsTrue(summary.UsesElementType(Onnx::DataType::Float));
+            Assert::AreEqual(size_t(2), summary.initializers.size());
+            Assert::AreEqual(uint64_t(20), summary.initializerBytes);
+            auto largest = summary.LargestInitializers(1);
+            Assert::AreEqual(size_t(1), largest.size());
+            Assert::AreEqual(std::string("W"), largest[0]->name);
+        }
+
+        TEST_METHOD(InspectorReportsWhatAModelIsMissing)
+        {
+            std::string noGraph = Message().Varint(1, 7).Child(8, Message().Varint(2, 13)).Data();
+            Assert::AreEqual(std::string("no graph"), Inspect(noGraph).Problem());
+            Assert::AreEqual(std::string("no IR version"), Inspect(std::string()).Problem());
+            Assert::ExpectException<std::runtime_error>([]() { Inspect("not an onnx model"); });
+        }
+    };
+
+    static Onnx::ModelCost Cost(const std::string& bytes, int64_t freeDimension = 1)
+    {
+        auto model = Onnx::ParseModel(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+        return Onnx::EstimateCost(*model, freeDimension);
+    }
+
+    TEST_CLASS(OnnxCostModelTest)
+    {
+    public:
+        TEST_METHOD(CostCountsConvActivationAndPoolWork)
+        {
+            Message pool = Node("MaxPool", { "R" }, { "Y" }, { IntsAttribute("kernel_shape", { 2, 2 }) });
+            auto cost = Cost(ModelBytes({ Node("Conv", { "X", "W" }, { "C" }), Node("Relu", { "C" }, { "R" }), pool },
+                                        { 1, 1, 3, 3 },
+                                        { FloatInitializer("W", { 2, 1, 2, 2 }, std::vector<float>(8)) }));
+            Assert::AreEqual(size_t(0), cost.uncostedNodes);
+            // Conv: 8 outputs of 4 multiply-adds; Relu: 8 outputs; MaxPool: 2 windows of 4.
+            Assert::AreEqual(64.0, cost.nodes[0].flops);
+            Assert::AreEqual(8.0, cost.nodes[1].flops);
+            Assert::AreEqual(8.0, cost.nodes[2].flops);
+            Assert::AreEqual(80.0, cost.flops);
+            Assert::AreEqual(uint64_t(32), cost.parameterBytes);
+            Assert::AreEqual(uint64_t(32), cost.nodes[0].parameterBytes);
+            // Conv reads 9 floats and writes 8.
+            Assert::AreEqual(uint64_t(68), cost.nodes[0].activationBytes);
+            Assert::AreEqual(std::string("C"), cost.HeaviestNodes(1)[0]->name);
+        }
+
+        TEST_METHOD(CostFoldsShapeArithmeticInFrontOfReshape)
+        {
+            Message zero = Message().Varint(2, 7).Bytes(8, "zero").Varint(7, 0);
+            auto cost = Cost(ModelBytes({ Node("Shape", { "X" }, { "S" }), Node("Gather", { "S", "zero" }, { "N" }),
+                                          Node("Unsqueeze", { "N" }, { "U" }, { IntsAttribute("axes", { 0 }) }),
+                                          Node("Concat", { "U", "minusOne" }, { "T" }, { IntAttribute("axis", 0) }),
+                                          Node("Reshape", { "X", "T" }, { "R" }),
+                                          Node("MatMul", { "R", "W" }, { "Y" }) },
+                                        { 2, 2, 2 },
+                                        { zero, Int64Initializer("minusOne", { -1 }),
+                                          FloatInitializer("W", { 4, 3 }, std::vector<float>(12)) },
+                                        11));
+            Assert::AreEqual(size_t(0), cost.uncostedNodes);
+            // [2, 4] x [4, 3]
+            Assert::AreEqual(48.0, cost.flops);
+        }
+
+        TEST_METHOD(CostSetsFreeDimensionsAndSkipsUnknownOperators)
+        {
+            Message custom = Node("Custom", { "R" }, { "Y" });
+            custom.Bytes(7, "contoso");
+            auto cost = Cost(ModelBytes({ Node("Relu", { "X" }, { "R" }), custom }, { -1, 4 }), 3);
+            Assert::AreEqual(12.0, cost.flops);
+            Assert::AreEqual(size_t(1), cost.uncostedNodes);
+            Assert::IsFalse(cost.nodes[1].costed);
+            Assert::AreEqual(std::string("contoso.Custom"), cost.nodes[1].opType);
+        }
+    };
+
+    // Converts bytes and parses the result, which owns its storage.
+    static std::unique_ptr<Onnx::Model> ConvertToFloat16(const std::string& bytes, Onnx::Float16Report& report,
+                                                         const Onnx::Float16Options& options = {})
+    {
+        std::ostringstream output;
+        report = Onnx::ConvertToFloat16(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(), output, {},
+                                        options);
+        std::string converted = output.str();
+        auto model = std::make_unique<Onnx::Model>();
+        model->storage.assign(converted.begin(), converted.end());
+        Onnx::ModelParser::ParseModel(Onnx::Bytes{ model->storage.data(), model->storage.size() }, *model);
+        return model;
+    }
+
+    TEST_CLASS(OnnxFloat16Test)
+    {
+    public:
+        TEST_METHOD(Float16RewritesWeightsAndValueTypes)
+        {
+            Onnx::Float16Report report;
+            auto model = ConvertToFloat16(ModelBytes({ Node("Mul", { "X", "W" }, { "M" }),
+                                                       Node("Relu", { "M" }, { "Y" }) },
+                                                     { 1, 3 }, { FloatInitializer("W", { 3 }, { 0.5f, -2.0f, 1e6f }) }),
+                                          report);
+            Assert::AreEqual(size_t(1), report.convertedTensors);
+            Assert::AreEqual(uint64_t(1), report.saturatedValues);
+            Assert::AreEqual(size_t(0), report.insertedCasts);
+            Assert::AreEqual(report.outputBytes, uint64_t(model->storage.size()));
+            Assert::IsTrue(model->graph.inputs[0].elementType == Onnx::DataType::Float16);
+            Assert::IsTrue(model->graph.outputs[0].elementType == Onnx::DataType::Float16);
+            const Onnx::Tensor& weights = model->graph.initializers[0];
+            Assert::IsTrue(weights.dataType == Onnx::DataType::Float16);
+            auto values = weights.Values<float>();
+            Assert::AreEqual(0.5f, values[0]);
+            Assert::AreEqual(-2.0f, values[1]);
+            Assert::AreEqual(65504.0f, values[2]);
+            Assert::AreEqual(size_t(2), model->graph.nodes.size());
+        }
+
+        TEST_METHOD(Float16KeepsBlockedOperatorsInFp32BehindCasts)
+        {
+            Onnx::Float16Options options;
+            options.keepIoTypes = true;
+            Onnx::Float16Report report;
+            auto model = ConvertToFloat16(ModelBytes({ Node("Relu", { "X" }, { "R" }),
+                                                       Node("CumSum", { "R", "axis" }, { "C" }),
+                                                       Node("Add", { "C", "X" }, { "Y" }) },
+                                                     { 4 }, { Int64Initializer("axis", { 0 }) }),
+                                          report, options);
+            const auto& nodes = model->graph.nodes;
+            // X is cast once for Relu and Add, CumSum runs between two Casts and Y is cast back to float.
+            Assert::AreEqual(size_t(4), report.insertedCasts);
+            Assert::AreEqual(size_t(1), report.keptNodes);
+            Assert::AreEqual(size_t(7), nodes.size());
+            Assert::IsTrue(model->graph.inputs[0].elementType == Onnx::DataType::Float);
+            Assert::IsTrue(model->graph.outputs[0].elementType == Onnx::DataType::Float);
+            Assert::AreEqual(std::string("Cast"), nodes[0].opType);
+            Assert::AreEqual(std::string("X"), nodes[0].inputs[0]);
+            Assert::AreEqual(int64_t(10), nodes[0].Int("to", 0));
+            Assert::AreEqual(nodes[0].outputs[0], nodes[1].inputs[0]);
+            Assert::AreEqual(std::string("Cast"), nodes[2].opType);
+            Assert::AreEqual(int64_t(1), nodes[2].Int("to", 0));
+            Assert::AreEqual(std::string("CumSum"), nodes[3].opType);
+            Assert::AreEqual(nodes[2].outputs[0], nodes[3].inputs[0]);
+            Assert::AreEqual(std::string("axis"), nodes[3].inputs[1]);
+            Assert::AreEqual(std::string("Cast"), nodes[4].opType);
+            Assert::AreEqual(std::string("C"), nodes[4].outputs[0]);
+            Assert::AreEqual(std::string("Add"), nodes[5].opType);
+            Assert::AreEqual(std::string("Y"), nodes[6].outputs[0]);
+            Assert::AreEqual(nodes[5].outputs[0], nodes[6].inputs[0]);
+        }
+    };
+
+    // Calibrates bytes on the naive reference path with samples and returns the quantized model.
+    static std::unique_ptr<Onnx::Model> Quantize(const std::string& bytes, const std::vector<int64_t>& shape,
+                                                 const std::vector<std::vector<float>>& samples,
+                                                 Onnx::QuantizationReport& report,
+                                                 const Onnx::QuantizationOptions& options = {})
+    {
+        auto source = Onnx::ParseModel(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+        Onnx::Calibrator calibrator(Onnx::CalibrationTensors(*source, options));
+        Reference::Options naive;
+        naive.optimize = false;
+        ReferenceModel model(*source, naive);
+        auto session = model.CreateSession();
+        static_cast<ReferenceSession&>(*session).Observe([&](const std::string& name, const Tensor& value) {
+            calibrator.Add(name, value.Data<float>(), value.ElementCount());
+        });
+        for (const auto& sample : samples)
+        {
+            Tensor input(ElementType::Float, shape);
+            std::copy(sample.begin(), sample.end(), input.Data<float>());
+            session->Bind("X", input);
+            session->Evaluate();
+        }
+        std::ostringstream output;
+        report = Onnx::QuantizeModel(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size(), output,
+                                     calibrator.Ranges(options), options);
+        std::string quantized = output.str();
+        auto result = std::make_unique<Onnx::Model>();
+        result->storage.assign(quantized.begin(), quantized.end());
+        Onnx::ModelParser::ParseModel(Onnx::Bytes{ result->storage.data(), result->storage.size() }, *result);
+        return result;
+    }
+
+    static std::string ConvReluModel(int64_t opset, std::mt19937& generator)
+    {
+        std::vector<float> weights = RandomValues(4 * 2 * 3 * 3, generator);
+        // One channel with a much wider range than the others.
+        weights[0] = 4.0f;
+        return ModelBytes({ Node("Conv", { "X", "W", "B" }, { "C" }, { IntsAttribute("pads", { 1, 1, 1, 1 }) }),
+                            Node("Relu", { "C" }, { "R" }), Node("Identity", { "R" }, { "Y" }) },
+                          { 1, 2, 5, 5 },
+                          { FloatInitializer("W", { 4, 2, 3, 3 }, weights),
+                            FloatInitializer("B", { 4 }, { 0.1f, -0.2f, 0.3f, 0.0f }) },
+                          opset);
+    }
+
+    TEST_CLASS(OnnxQuantizerTest)
+    {
+    public:
+        TEST_METHOD(QuantizeLinearRoundsHalfToEvenAndSaturates)
+        {
+            Message zeroPoint = Message().Varint(2, 2).Bytes(8, "zero_point").Bytes(9, std::string(1, '\x0a'));
+            auto model = LoadGraph({ Node("QuantizeLinear", { "X", "scale", "zero_point" }, { "Q" }),
+                                     Node("DequantizeLinear", { "Q", "scale", "zero_point" }, { "Y" }) },
+                                   { 5 }, { FloatInitializer("scale", {}, { 0.5f }), zeroPoint });
+            CheckClose({ 0.0f, 1.0f, 2.0f, 122.5f, -5.0f },
+                       Evaluate(*model, { 5 }, { 0.0f, 1.25f, 1.75f, 200.0f, -10.0f }));
+        }
+
+        TEST_METHOD(CalibrationClipsOutliersExceptWithMinMax)
+        {
+            // Exponentially distributed like a Relu output, so most of the mass sits near zero.
+            std::vector<float> values(10000);
+            for (size_t i = 0; i < values.size(); i++)
+            {
+                values[i] = -std::log((static_cast<float>(i % 1000) + 0.5f) / 1000.0f);
+            }
+            values[0] = -1.0f;
+            const float outlier = 1000.0f;
+            Onnx::Histogram histogram;
+            histogram.Add(values.data(), values.size());
+            // The outlier widens the histogram after the fact.
+            histogram.Add(&outlier, 1);
+
+            auto minMax = histogram.Range(Onnx::CalibrationMethod::MinMax, 0);
+            Assert::AreEqual(-1.0f, minMax.first);
+            Assert::AreEqual(outlier, minMax.second);
+            auto percentile = histogram.Range(Onnx::CalibrationMethod::Percentile, 99.9);
+            Assert::AreEqual(-1.0f, percentile.first);
+            Assert::IsTrue(percentile.second > 6.0f && percentile.second < 7.7f);
+            auto entropy = histogram.Range(Onnx::CalibrationMethod::Entropy, 0);
+            Assert::AreEqual(-1.0f, entropy.first);
+            Assert::IsTrue(entropy.second > 6.0f && entropy.second < outlier / 2);
+        }
+
+        TEST_METHOD(QdqQuantizesConvWeightsPerChannelAndKeepsItsOutput)
+        {
+            std::mt19937 generator(7);
+            std::string bytes = ConvReluModel(13, generator);
+            std::vector<std::vector<float>> samples;
+            for (int i = 0; i < 4; i++)
+            {
+                samples.push_back(RandomValues(50, generator));
+            }
+            Onnx::QuantizationReport report;
+            auto quantized = Quantize(bytes, { 1, 2, 5, 5 }, samples, report);
+            Assert::AreEqual(size_t(1), report.quantizedNodes);
+            Assert::AreEqual(size_t(2), report.quantizedActivations);
+            Assert::AreEqual(size_t(2), report.quantizedTensors);
+            Assert::AreEqual(int64_t(13), report.opset);
+
+            // Weight and bias DequantizeLinear, X, Conv, Relu, R, Identity.
+            const auto& nodes = quantized->graph.nodes;
+            Assert::AreEqual(size_t(9), nodes.size());
+            Assert::AreEqual(std::string("DequantizeLinear"), nodes[0].opType);
+            Assert::AreEqual(std::string("W"), nodes[0].outputs[0]);
+            Assert::AreEqual(int64_t(0), nodes[0].Int("axis", -1));
+            Assert::AreEqual(std::string("B"), nodes[1].outputs[0]);
+            Assert::AreEqual(std::string("QuantizeLinear"), nodes[2].opType);
+            Assert::AreEqual(std::string("X"), nodes[2].inputs[0]);
+            Assert::AreEqual(std::string("Conv"), nodes[4].opType);
+            Assert::AreEqual(nodes[3].outputs[0], nodes[4].inputs[0]);
+            Assert::AreEqual(std::string("W"), nodes[4].inputs[1]);
+            Assert::AreEqual(std::string("R"), nodes[6].inputs[0]);
+            Assert::AreEqual(nodes[7].outputs[0], nodes[8].inputs[0]);
+            Assert::AreEqual(std::string("Y"), nodes[8].outputs[0]);
+            const Onnx::Tensor* weights = quantized->FindInitializer(nodes[0].inputs[0]);
+            Assert::IsTrue(weights != nullptr && weights->dataType == Onnx::DataType::Int8);
+            Assert::AreEqual(size_t(4), quantized->FindInitializer(nodes[0].inputs[1])->ElementCount());
+            Assert::IsTrue(quantized->FindInitializer(nodes[1].inputs[0])->dataType == Onnx::DataType::Int32);
+            Assert::IsTrue(quantized->FindInitializer("W") == nullptr);
+
+            auto source = Onnx::ParseModel(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+            ReferenceModel floatModel(*source, {});
+            ReferenceModel quantizedModel(*quantized, {});
+            std::vector<float> expected = Evaluate(floatModel, { 1, 2, 5, 5 }, samples[0]);
+            std::vector<float> actual = Evaluate(quantizedModel, { 1, 2, 5, 5 }, samples[0]);
+            float largest = 0;
+            for (float value : expected)
+            {
+                largest = (std::max)(largest, value);
+            }
+            for (size_t i = 0; i < expected.size(); i++)
+            {
+                Assert::AreEqual(expected[i], actual[i], largest / 50);
+            }
+        }
+
+        TEST_METHOD(QdqMovesOldModelsToOpset10WithPerTensorWeights)
+        {
+            std::mt19937 generator(7);
+            Onnx::QuantizationReport report;
+            auto quantized = Quantize(ConvReluModel(9, generator), { 1, 2, 5, 5 },
+                                      { RandomValues(50, generator) }, report);
+            Assert::AreEqual(int64_t(10), report.opset);
+            Assert::AreEqual(int64_t(10), quantized->Opset());
+            Assert::IsTrue(quantized->graph.nodes[0].Find("axis") == nullptr);
+            Assert::AreEqual(size_t(1), quantized->FindInitializer(quantized->graph.nodes[0].inputs[1])->ElementCount());
+
+            std::string upsample = ModelBytes({ Node("Conv", { "X", "W" }, { "C" }), Node("Upsample", { "C" }, { "Y" }) },
+                                              { 1, 1, 2, 2 }, { FloatInitializer("W", { 1, 1, 1, 1 }, { 1.0f }) }, 9);
+            Assert::ExpectException<std::runtime_error>([&]() {
+                auto source = Onnx::ParseModel(reinterpret_cast<const uint8_t*>(upsample.data()), upsample.size());
+                Onnx::CalibrationTensors(*source);
+            });
+        }
+    };
+
+    // A fresh directory below the temporary path, removed with its contents.
+    class TemporaryDirectory
+    {
+    public:
+        explicit TemporaryDirectory(const std::string& name)
+            : m_path(std::filesystem::temp_directory_path() / ("ReferenceBackendTest_" + name))
+        {
+            std::filesystem::remove_all(m_path);
+            std::filesystem::create_directories(m_path);
+        }
+        ~TemporaryDirectory() { std::filesystem::remove_all(m_path); }
+
+        std::filesystem::path operator/(const std::string& file) const { return m_path / file; }
+
+    private:
+        std::filesystem::path m_path;
+    };
+
+    static void WriteFile(const std::filesystem::path& path, const std::string& bytes)
+    {
+        std::ofstream(path, std::ios::binary).write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    }
+
+    TEST_CLASS(OnnxExternalDataTest)
+    {
+    public:
+        TEST_METHOD(SplitMovesLargeInitializersToAlignedOffsets)
+        {
+            TemporaryDirectory directory("Split");
+            std::mt19937 generator(3);
+            WriteFile(directory / "model.onnx",
+                      ModelBytes({ Node("Conv", { "X", "W", "B" }, { "C" }, { IntsAttribute("pads", { 1, 1, 1, 1 }) }),
+                                   Node("Conv", { "C", "V" }, { "Y" }) },
+                                 { 1, 1, 4, 4 },
+                                 { FloatInitializer("W", { 4, 1, 3, 3 }, RandomValues(36, generator)),
+                                   FloatInitializer("B", { 4 }, RandomValues(4, generator)),
+                                   FloatInitializer("V", { 2, 4, 1, 1 }, RandomValues(8, generator)) }));
+            Onnx::ExternalDataOptions options;
+            options.minBytes = 32;
+            options.alignment = 4096;
+            Onnx::ExternalDataReport report =
+                Onnx::SplitExternalData(directory / "model.onnx", directory / "split.onnx", options);
+            Assert::AreEqual(size_t(2), report.externalTensors);
+            Assert::AreEqual(size_t(1), report.inlineTensors);
+            Assert::AreEqual(std::string("split.onnx.data"), report.location);
+            Assert::AreEqual(uint64_t(4096 + 32), report.dataBytes);
+            Assert::AreEqual(uint64_t(4096 + 32), std::filesystem::file_size(directory / "split.onnx.data"));
+
+            auto split = Onnx::MapModel(directory / "split.onnx");
+            Assert::IsTrue(split->FindInitializer("W")->external);
+            Assert::AreEqual(uint64_t(0), Onnx::FindExternalLocation(*split->FindInitializer("W")).offset);
+            Assert::IsFalse(split->FindInitializer("B")->external);
+            Onnx::ExternalLocation v = Onnx::FindExternalLocation(*split->FindInitializer("V"));
+            Assert::AreEqual(uint64_t(4096), v.offset);
+            Assert::AreEqual(uint64_t(32), v.length);
+
+            ReferenceBackend backend;
+            std::vector<float> x = RandomValues(16, generator);
+            std::vector<float> expected = Evaluate(*backend.Load(directory / "model.onnx"), { 1, 1, 4, 4 }, x);
+            CheckClose(expected, Evaluate(*backend.Load(directory / "split.onnx"), { 1, 1, 4, 4 }, x));
+
+            // Splitting with a higher threshold brings the external tensors back inline.
+            options.minBytes = 1024;
+            report = Onnx::SplitExternalData(directory / "split.onnx", directory / "inline.onnx", options);
+            Assert::AreEqual(size_t(0), report.externalTensors);
+            Assert::AreEqual(uint64_t(0), report.dataBytes);
+            CheckClose(expected, Evaluate(*backend.Load(directory / "inline.onnx"), { 1, 1, 4, 4 }, x));
+            Assert::ExpectException<std::runtime_error>([&]() {
+                Onnx::SplitExternalData(directory / "split.onnx", directory / "split.onnx", options);
+            });
+        }
+
+        TEST_METHOD(SyntheticModelRunsFromItsDataFile)
+        {
+            TemporaryDirectory directory("Synthetic");
+            Onnx::ExternalDataReport report =
+                Onnx::WriteSyntheticModel(directory / "large.onnx", 3 * 64 * 64 * sizeof(float) - 1, 64);
+            Assert::AreEqual(size_t(3), report.externalTensors);
+            Assert::IsTrue(report.modelBytes < 1024);
+            Assert::AreEqual(uint64_t(2 * 64 * 1024 + 64 * 64 * sizeof(float)), report.dataBytes);
+
+            auto model = ReferenceBackend().Load(directory / "large.onnx");
+            std::vector<float> y = Evaluate(*model, { 1, 64 }, std::vector<float>(64, 1.0f));
+            double energy = 0;
+            for (float value : y)
+            {
+                energy += value * value;
+            }
+            // Variance 1/width keeps the squared norm near that of the input.
+            Assert::IsTrue(energy > 64 / 8.0 && energy < 64 * 8.0);
+        }
+
+        TEST_METHOD(ExternalDataOutsideTheModelDirectoryIsRefused)
+        {
+            TemporaryDirectory directory("Outside");
+            Message weights;
+            weights.Varint(1, 1).Varint(2, 1).Bytes(8, "W");
+            weights.Child(13, Message().Bytes(1, "location").Bytes(2, "../weights.bin")).Varint(14, 1);
+            // The file exists, but not below the directory of the model.
+            WriteFile(directory / "weights.bin", std::string(sizeof(float), '\0'));
+            std::filesystem::create_directory(directory / "model");
+            WriteFile(directory / "model" / "model.onnx",
+                      ModelBytes({ Node("Mul", { "X", "W" }, { "Y" }) }, { 1 }, { weights }));
+            Assert::ExpectException<std::runtime_error>([&]() { Onnx::MapModel(directory / "model" / "model.onnx"); });
+        }
+    };
+
+    TEST_CLASS(BackendHarnessTest)
+    {
+    public:
+        TEST_METHOD(LoadBindAndEvaluateBindsCsvValuesAndTimesEveryIteration)
+        {
+            TemporaryDirectory directory("Harness");
+            WriteFile(directory / "relu.onnx", ModelBytes({ Node("Relu", { "X" }, { "Y" }) }, { 1, 4 }));
+            WriteFile(directory / "input.csv", "1,-2\n3,-4\n");
+
+            ReferenceBackend backend;
+            BackendHarness::Run run = BackendHarness::LoadBindAndEvaluate(
+                backend, directory / "relu.onnx", BackendHarness::ReadCsvValues(directory / "input.csv"), 3);
+            Assert::AreEqual(size_t(3), run.evaluateMilliseconds.size());
+            const Tensor& y = run.session->Output("Y");
+            CheckClose({ 1, 0, 3, 0 }, std::vector<float>(y.Data<float>(), y.Data<float>() + y.ElementCount()));
+
+            Assert::ExpectException<std::invalid_argument>([&]() {
+                BackendHarness::LoadBindAndEvaluate(backend, directory / "relu.onnx", { 1, 2, 3 }, 1);
+            });
+        }
+
+        TEST_METHOD(CompareOutputsReportsErrorsAndTopKOverlap)
+        {
+            Tensor reference(ElementType::Float, { 4 });
+            Tensor candidate(ElementType::Float, { 4 });
+            const float referenceValues[] = { 0.1f, 0.6f, 0.2f, 0.1f };
+            const float candidateValues[] = { 0.1f, 0.3f, 0.5f, 0.1f };
+            std::copy(std::begin(referenceValues), std::end(referenceValues), reference.Data<float>());
+            std::copy(std::begin(candidateValues), std::end(candidateValues), candidate.Data<float>());
+
+            BackendHarness::OutputComparison comparison = BackendHarness::CompareOutputs(reference, candidate, 2);
+            Assert::AreEqual(0.3, comparison.maxAbsError, 1e-6);
+            Assert::AreEqual(0.15, comparison.meanAbsError, 1e-6);
+            Assert::IsFalse(comparison.sameTop1);
+            Assert::AreEqual(size_t(2), comparison.topKOverlap);
+            Assert::AreEqual(size_t(2), comparison.topKCount);
+
+            Assert::ExpectException<std::invalid_argument>(
+                [&]() { BackendHarness::CompareOutputs(reference, Tensor(ElementType::Float, { 3 }), 2); });
+        }
+    };
+}
@@ -0,0 +1,102 @@
+#include "CppUnitTest.h"
+#define RESULTHELPER_NO_WINRT
+#include "ResultHelper.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace ResultHelper;
+
+namespace ResultHelperTest
+{
+    // Reference top-K: stable sort by descending score, NaNs excluded.
+    static std::vector<Prediction> SortTopK(const std::vector<float>& scores, uint32_t k)
+    {
+        std::vector<Prediction> all;
+        for (uint32_t i = 0; i < scores.size(); ++i)
+        {
+            if (!std::isnan(scores[i]))
+            {
+                all.push_back(Prediction{ i, scores[i] });
+            }
+        }
+        std::stable_sort(all.begin(), all.end(),
+                         [](const Prediction& a, const Prediction& b) { return a.score > b.score; });
+        all.resize(std::min<size_t>(k, all.size()));
+        return all;
+    }
+
+    static void CheckEqual(const std::vector<Prediction>& expected, const std::vector<Prediction>& actual)
+    {
+        Assert::AreEqual(expected.size(), actual.size());
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            Assert::AreEqual(expected[i].index, actual[i].index);
+            Assert::AreEqual(expected[i].score, actual[i].score);
+        }
+    }
+
+    TEST_CLASS(ResultHelperTest)
+    {
+    public:
+        TEST_METHOD(TopKMatchesSortForAllLengthsAndTies)
+        {
+            // Few distinct values so that ties are common, and lengths that cover every SIMD tail.
+            uint32_t seed = 1;
+            for (uint32_t count = 0; count < 67; ++count)
+            {
+                std::vector<float> scores(count);
+                for (auto& score : scores)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    score = static_cast<float>((seed >> 16) % 13);
+                    if ((seed >> 8) % 29 == 0)
+                    {
+                        score = NAN;
+                    }
+                }
+                for (uint32_t k = 0; k < 9; ++k)
+                {
+                    CheckEqual(SortTopK(scores, k), TopK(scores.data(), scores.size(), k));
+                }
+            }
+        }
+
+        TEST_METHOD(TopKPerBatchSplitsRows)
+        {
+            std::vector<float> scores = { 0.1f, 0.7f, 0.2f, 0.9f, 0.05f, 0.05f };
+            auto results = TopKPerBatch(scores.data(), scores.size(), 2, 1);
+            Assert::AreEqual(size_t(2), results.size());
+            Assert::AreEqual(1u, results[0][0].index);
+            Assert::AreEqual(0u, results[1][0].index);
+            Assert::AreEqual(0.9f, results[1][0].score);
+        }
+
+        TEST_METHOD(LabelTableParsesIndexedLines)
+        {
+            std::string text = "0,tench, Tinca tinca\r\n2,great white shark\n\nnot a label\n1,goldfish";
+            LabelTable labels = LabelTable::Parse(text.data(), text.size());
+            Assert::AreEqual(size_t(3), labels.Size());
+            Assert::AreEqual("tench, Tinca tinca", labels.Get(0));
+            Assert::AreEqual("goldfish", labels.Get(1));
+            Assert::AreEqual("great white shark", labels.Get(2));
+            Assert::AreEqual("", labels.Get(3));
+        }
+
+        TEST_METHOD(LabelTableRejectsHugeIndices)
+        {
+            // One would wrap the label count to 0, the other allocate hundreds of MB.
+            for (std::string text : { "4294967295,wraps\n", "99999999,huge\n" })
+            {
+                Assert::ExpectException<std::runtime_error>([&text]() { LabelTable::Parse(text.data(), text.size()); });
+            }
+            // Leading zeros do not count towards the limit.
+            std::string padded = "00000000000000000017,padded\n";
+            Assert::AreEqual(size_t(18), LabelTable::Parse(padded.data(), padded.size()).Size());
+        }
+    };
+}
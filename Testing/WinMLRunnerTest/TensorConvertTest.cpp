@@ -0,0 +1,252 @@
+#include "CppUnitTest.h"
+#include "TensorConvert.h"
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace TensorConvert;
+
+namespace TensorConvertTest
+{
+    static const PixelFormat ALL_FORMATS[] = { PixelFormat::Bgra8, PixelFormat::Rgba8, PixelFormat::Gray8,
+                                               PixelFormat::Gray16 };
+    static const ChannelOrder ALL_ORDERS[] = { ChannelOrder::RGB, ChannelOrder::BGR };
+
+    struct TestImage
+    {
+        std::vector<uint8_t> bytes;
+        ImageDesc desc;
+    };
+
+    // Fills every channel of every pixel with a different value so that all 256 (or, for Gray16, a spread of 65536)
+    // sample values and every channel permutation are exercised. Padding bytes are poisoned to catch reads past the
+    // row.
+    static TestImage MakeImage(PixelFormat format, uint32_t width, uint32_t height, uint32_t padding)
+    {
+        TestImage image;
+        uint32_t bytesPerPixel = BytesPerPixel(format);
+        uint32_t rowPitch = width * bytesPerPixel + padding;
+        image.bytes.assign(static_cast<size_t>(rowPitch) * height, 0xcd);
+        uint32_t seed = 0;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            uint8_t* row = image.bytes.data() + static_cast<size_t>(y) * rowPitch;
+            for (uint32_t x = 0; x < width * bytesPerPixel; ++x)
+            {
+                row[x] = static_cast<uint8_t>(seed);
+                seed += (x % 4 == 3) ? 1 : 97;
+            }
+        }
+        image.desc = { image.bytes.data(), width, height, padding ? rowPitch : 0, format };
+        return image;
+    }
+
+    // Straightforward per-pixel reference implementation of the documented semantics.
+    static std::vector<float> Reference(const ImageDesc& image, ChannelOrder order, uint32_t channels,
+                                        const Normalization& normalization)
+    {
+        uint32_t bytesPerPixel = BytesPerPixel(image.format);
+        uint32_t rowPitch = image.rowPitchInBytes ? image.rowPitchInBytes : image.width * bytesPerPixel;
+        size_t planeSize = static_cast<size_t>(image.width) * image.height;
+        std::vector<float> out(planeSize * channels);
+        for (uint32_t y = 0; y < image.height; ++y)
+        {
+            for (uint32_t x = 0; x < image.width; ++x)
+            {
+                const uint8_t* pixel = static_cast<const uint8_t*>(image.data) + y * rowPitch + x * bytesPerPixel;
+                double rgb[3];
+                switch (image.format)
+                {
+                    case PixelFormat::Bgra8:
+                        rgb[0] = pixel[2];
+                        rgb[1] = pixel[1];
+                        rgb[2] = pixel[0];
+                        break;
+                    case PixelFormat::Rgba8:
+                        rgb[0] = pixel[0];
+                        rgb[1] = pixel[1];
+                        rgb[2] = pixel[2];
+                        break;
+                    case PixelFormat::Gray8:
+                        rgb[0] = rgb[1] = rgb[2] = pixel[0];
+                        break;
+                    case PixelFormat::Gray16:
+                        rgb[0] = rgb[1] = rgb[2] = pixel[0] | (pixel[1] << 8);
+                        break;
+                }
+                for (uint32_t c = 0; c < channels; ++c)
+                {
+                    double value;
+                    if (channels == 1)
+                    {
+                        value = 0.2126 * rgb[0] + 0.7152 * rgb[1] + 0.0722 * rgb[2];
+                    }
+                    else
+                    {
+                        value = rgb[order == ChannelOrder::RGB ? c : 2 - c];
+                    }
+                    value = (value * normalization.scale - normalization.means[c]) / normalization.stddevs[c];
+                    out[c * planeSize + static_cast<size_t>(y) * image.width + x] = static_cast<float>(value);
+                }
+            }
+        }
+        return out;
+    }
+
+    static float RoundAndSaturate(float value)
+    {
+        value = value > 0.0f ? value : 0.0f;
+        value = value < 255.0f ? value : 255.0f;
+        return std::nearbyint(value);
+    }
+
+    static void CheckConversion(PixelFormat format, ChannelOrder order, uint32_t channels, uint32_t width,
+                                uint32_t height, uint32_t padding, const Normalization& normalization)
+    {
+        TestImage image = MakeImage(format, width, height, padding);
+        std::vector<float> expected = Reference(image.desc, order, channels, normalization);
+
+        std::vector<float> floats(expected.size());
+        std::vector<uint16_t> halves(expected.size());
+        std::vector<uint8_t> bytes(expected.size());
+        ToPlanarFloat(image.desc, order, channels, floats.data(), normalization);
+        ToPlanarHalf(image.desc, order, channels, halves.data(), normalization);
+        ToPlanarUInt8(image.desc, order, channels, bytes.data(), normalization);
+
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            float tolerance = 1e-5f * (std::fabs(expected[i]) > 1.0f ? std::fabs(expected[i]) : 1.0f);
+            if (std::fabs(floats[i] - expected[i]) > tolerance)
+            {
+                Assert::Fail((L"float mismatch at element " + std::to_wstring(i) + L": expected " +
+                              std::to_wstring(expected[i]) + L", got " + std::to_wstring(floats[i]))
+                                 .c_str());
+            }
+            // The fp16 and uint8 outputs must be exactly the rounded float output, regardless of which code path
+            // (vector body or scalar tail) produced them.
+            if (halves[i] != FloatToHalf(floats[i]))
+            {
+                Assert::Fail((L"half mismatch at element " + std::to_wstring(i)).c_str());
+            }
+            if (bytes[i] != static_cast<uint8_t>(RoundAndSaturate(floats[i])))
+            {
+                Assert::Fail((L"uint8 mismatch at element " + std::to_wstring(i)).c_str());
+            }
+        }
+    }
+
+    TEST_CLASS(TensorConvertTest)
+    {
+    public:
+        TEST_METHOD(IdentityAllFormatsOrdersAndWidths)
+        {
+            for (PixelFormat format : ALL_FORMATS)
+            {
+                for (ChannelOrder order : ALL_ORDERS)
+                {
+                    for (uint32_t channels : { 1u, 3u })
+                    {
+                        // Widths around the 4-pixel vector step exercise both the vector body and the scalar tail.
+                        for (uint32_t width = 1; width <= 19; ++width)
+                        {
+                            CheckConversion(format, order, channels, width, 17, 0, Normalization());
+                        }
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(RowPitchIsHonored)
+        {
+            for (PixelFormat format : ALL_FORMATS)
+            {
+                for (uint32_t padding : { 1u, 3u, 12u, 64u })
+                {
+                    CheckConversion(format, ChannelOrder::BGR, 3, 23, 9, padding, Normalization());
+                    CheckConversion(format, ChannelOrder::RGB, 1, 23, 9, padding, Normalization());
+                }
+            }
+        }
+
+        TEST_METHOD(FusedNormalization)
+        {
+            Normalization imageNet;
+            imageNet.scale = 1.0f / 255.0f;
+            imageNet.means[0] = 0.485f;
+            imageNet.means[1] = 0.456f;
+            imageNet.means[2] = 0.406f;
+            imageNet.stddevs[0] = 0.229f;
+            imageNet.stddevs[1] = 0.224f;
+            imageNet.stddevs[2] = 0.225f;
+
+            // Pushes values outside [0, 255] so the uint8 output saturates on both ends.
+            Normalization stretch;
+            stretch.scale = 3.0f;
+            stretch.means[0] = stretch.means[1] = stretch.means[2] = 200.0f;
+
+            for (PixelFormat format : ALL_FORMATS)
+            {
+                for (ChannelOrder order : ALL_ORDERS)
+                {
+                    for (uint32_t channels : { 1u, 3u })
+                    {
+                        CheckConversion(format, order, channels, 67, 13, 5, imageNet);
+                        CheckConversion(format, order, channels, 67, 13, 0, stretch);
+                    }
+                }
+            }
+        }
+
+        TEST_METHOD(HalfConversionRoundTripsEveryValue)
+        {
+            for (uint32_t bits = 0; bits <= 0xffff; ++bits)
+            {
+                uint16_t half = static_cast<uint16_t>(bits);
+                float value = HalfToFloat(half);
+                if (std::isnan(value))
+                {
+                    Assert::IsTrue((FloatToHalf(value) & 0x7e00) == 0x7e00);
+                    continue;
+                }
+                Assert::AreEqual(static_cast<int>(half), static_cast<int>(FloatToHalf(value)));
+            }
+        }
+
+        TEST_METHOD(HalfConversionRoundsToNearestEven)
+        {
+            Assert::AreEqual(0x3c00, static_cast<int>(FloatToHalf(1.0f + 1.0f / 4096.0f)));
+            Assert::AreEqual(0x3c02, static_cast<int>(FloatToHalf(1.0f + 3.0f / 2048.0f)));
+            Assert::AreEqual(0x7bff, static_cast<int>(FloatToHalf(65504.0f)));
+            Assert::AreEqual(0x7c00, static_cast<int>(FloatToHalf(65520.0f)));
+            Assert::AreEqual(0xfc00, static_cast<int>(FloatToHalf(-1e10f)));
+            Assert::AreEqual(0x0001, static_cast<int>(FloatToHalf(5.9604645e-8f)));
+            Assert::AreEqual(0x0000, static_cast<int>(FloatToHalf(2.9802322e-8f)));
+        }
+
+        TEST_METHOD(BulkHalfConversionMatchesScalar)
+        {
+            // Every half value as a float, nudged off the representable values so that rounding is exercised, and
+            // an odd count so that the scalar tail runs as well.
+            std::vector<float> values;
+            for (uint32_t bits = 0; bits <= 0xffff; bits += 3)
+            {
+                float value = HalfToFloat(static_cast<uint16_t>(bits));
+                values.push_back(std::isfinite(value) ? value * 1.0003f : value);
+            }
+            values.push_back(1e10f);
+            std::vector<uint16_t> halves(values.size());
+            ToHalf(values.data(), halves.data(), values.size());
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                if (std::isnan(values[i]))
+                {
+                    Assert::IsTrue((halves[i] & 0x7e00) == 0x7e00);
+                    continue;
+                }
+                Assert::AreEqual(static_cast<int>(FloatToHalf(values[i])), static_cast<int>(halves[i]));
+            }
+        }
+    };
+}
@@ -0,0 +1,114 @@
+#include "CppUnitTest.h"
+#define TENSORRING_NO_WINRT
+#include "TensorRing.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace TensorRing;
+
+namespace TensorRingTest
+{
+    // Unique per test so that a ring left mapped by a failed test does not make the next Create fail.
+    static std::wstring RingName(const wchar_t* test)
+    {
+        return L"Local\\TensorRingTest" + std::to_wstring(GetCurrentProcessId()) + test;
+    }
+
+    TEST_CLASS(TensorRingTest)
+    {
+    public:
+        TEST_METHOD(SlotsArriveInOrderAcrossWraparound)
+        {
+            const uint32_t slotBytes = 1000;
+            const uint32_t numTensors = 10000;
+            auto consumer = SharedTensorRing::Create(RingName(L"Order"), slotBytes, 3);
+            auto producer = SharedTensorRing::Open(RingName(L"Order"));
+            Assert::AreEqual(3u, producer->SlotCount());
+            Assert::AreEqual(slotBytes, producer->SlotBytes());
+
+            bool producerFailed = false;
+            std::thread producerThread([&]() {
+                for (uint32_t i = 0; i < numTensors; i++)
+                {
+                    uint32_t slot = 0;
+                    if (producer->AcquireWrite(slot, 5000) != WaitResult::Ready)
+                    {
+                        producerFailed = true;
+                        break;
+                    }
+                    memset(producer->Payload(slot), static_cast<int>(i % 251), slotBytes);
+                    producer->Publish(1 + i % slotBytes);
+                }
+                producer->Close();
+            });
+
+            uint32_t received = 0;
+            uint32_t slot = 0;
+            bool payloadsMatch = true;
+            while (consumer->AcquireRead(slot, 5000) == WaitResult::Ready)
+            {
+                const uint8_t* payload = consumer->Payload(slot);
+                payloadsMatch = payloadsMatch && reinterpret_cast<uintptr_t>(payload) % 64 == 0 &&
+                                payload[0] == received % 251 && payload[slotBytes - 1] == received % 251 &&
+                                consumer->PublishedBytes(slot) == 1 + received % slotBytes;
+                received++;
+                consumer->Release();
+            }
+            producerThread.join();
+
+            Assert::IsFalse(producerFailed);
+            Assert::IsTrue(payloadsMatch);
+            Assert::AreEqual(numTensors, received);
+            Assert::IsTrue(consumer->AcquireRead(slot, 0) == WaitResult::Closed);
+        }
+
+        TEST_METHOD(FullRingTimesOutUntilReleased)
+        {
+            auto ring = SharedTensorRing::Create(RingName(L"Full"), 16, 2);
+            uint32_t slot = 0;
+            for (int i = 0; i < 2; i++)
+            {
+                Assert::IsTrue(ring->AcquireWrite(slot, 0) == WaitResult::Ready);
+                ring->Publish(16);
+            }
+            Assert::IsTrue(ring->AcquireWrite(slot, 10) == WaitResult::TimedOut);
+
+            Assert::IsTrue(ring->AcquireRead(slot, 0) == WaitResult::Ready);
+            Assert::AreEqual(0u, slot);
+            ring->Release();
+            Assert::IsTrue(ring->AcquireWrite(slot, 0) == WaitResult::Ready);
+            Assert::AreEqual(0u, slot);
+        }
+
+        TEST_METHOD(EmptyRingTimesOutAndCreateRejectsExistingName)
+        {
+            auto ring = SharedTensorRing::Create(RingName(L"Empty"), 16, 2);
+            uint32_t slot = 0;
+            Assert::IsTrue(ring->AcquireRead(slot, 10) == WaitResult::TimedOut);
+            Assert::ExpectException<std::system_error>([]() { SharedTensorRing::Create(RingName(L"Empty"), 16, 2); });
+        }
+
+        TEST_METHOD(OpenRejectsSlotsOutsideTheSection)
+        {
+            // A ring of two slots whose header claims a thousand, as a buggy producer could write it.
+            auto ring = SharedTensorRing::Create(RingName(L"Oversized"), 16, 2);
+            HANDLE mapping = OpenFileMappingW(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, RingName(L"Oversized").c_str());
+            Assert::IsNotNull(mapping);
+            auto header = static_cast<Details::Header*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+            Assert::IsNotNull(header);
+            header->slotCount = 1000;
+            Assert::ExpectException<std::runtime_error>([]() { SharedTensorRing::Open(RingName(L"Oversized")); });
+            header->slotCount = 2;
+            header->slotStride = 16;
+            Assert::ExpectException<std::runtime_error>([]() { SharedTensorRing::Open(RingName(L"Oversized")); });
+            UnmapViewOfFile(header);
+            CloseHandle(mapping);
+
+            // The ring that created the section keeps the geometry it read at creation.
+            Assert::AreEqual(2u, ring->SlotCount());
+        }
+    };
+}
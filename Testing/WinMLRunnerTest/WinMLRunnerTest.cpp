@@ -8,6 +8,7 @@
 #include <fstream>
 #include <algorithm>
 #include <vector>
+#include <map>
 #include <direct.h>
 #include <iomanip>
 #include <codecvt>
@@ -67,6 +68,45 @@ namespace WinMLRunnerTest
         return GetOutputCSVLineCount(OUTPUT_PATH);
     }
 
+    // Values of the first row after the header, by column name.
+    static std::map<std::string, std::string> GetOutputCSVColumns(const std::wstring& path)
+    {
+        std::ifstream fin(path);
+        std::string header, row, name, value;
+        std::getline(fin, header);
+        std::getline(fin, row);
+        std::map<std::string, std::string> columns;
+        std::istringstream headerColumns(header), rowColumns(row);
+        while (std::getline(headerColumns, name, ',') && std::getline(rowColumns, value, ','))
+        {
+            columns[name] = value;
+        }
+        return columns;
+    }
+
+    // Model name, device type, input binding and input type of every row, which identify the configuration it reports.
+    static std::vector<std::string> GetOutputCSVConfigurations(const std::wstring& path)
+    {
+        std::vector<std::string> configurations;
+        std::ifstream fin;
+        fin.open(path);
+        std::string line;
+        while (std::getline(fin, line))
+        {
+            size_t end = std::string::npos;
+            for (int column = 0, start = 0; column < 4; column++, start = static_cast<int>(end) + 1)
+            {
+                end = line.find(',', start);
+                if (end == std::string::npos)
+                {
+                    break;
+                }
+            }
+            configurations.push_back(line.substr(0, end));
+        }
+        return configurations;
+    }
+
     static void RemoveModelsFromFolder(std::initializer_list<std::string>&& modelList)
     {
         //make test_models folder
@@ -509,6 +549,46 @@ namespace WinMLRunnerTest
             Assert::AreEqual(static_cast<size_t>(2), GetOutputCSVLineCount());
         }
 
+        TEST_METHOD(GarbageInputCpuTrackAllocations)
+        {
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet.onnx";
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", modelPath, L"-PerfOutput", OUTPUT_PATH,
+                                                        L"-CPU", L"-Iterations", L"3", L"-TrackAllocations" });
+            Assert::AreEqual(S_OK, RunProc((wchar_t*)command.c_str()));
+            Assert::AreEqual(static_cast<size_t>(2), GetOutputCSVLineCount());
+
+            // WinML allocates as it binds an input, and its heap calls are counted.
+            std::map<std::string, std::string> columns = GetOutputCSVColumns(OUTPUT_PATH);
+            Assert::IsTrue(columns.count("bind allocations per call") == 1);
+            Assert::IsTrue(std::stod(columns["bind allocations per call"]) > 0);
+        }
+
+        TEST_METHOD(GarbageInputCpuCheckEnvironment)
+        {
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet.onnx";
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", modelPath, L"-PerfOutput", OUTPUT_PATH,
+                                                        L"-CPU", L"-Iterations", L"3", L"-CheckEnvironment" });
+            Assert::AreEqual(S_OK, RunProc((wchar_t*)command.c_str()));
+            Assert::AreEqual(static_cast<size_t>(2), GetOutputCSVLineCount());
+
+            // A phase shorter than the sampling period still gets the latest clock sample.
+            std::map<std::string, std::string> columns = GetOutputCSVColumns(OUTPUT_PATH);
+            Assert::IsTrue(std::stod(columns["evaluate min GHz"]) > 0);
+            Assert::IsFalse(columns["environment"].empty());
+            Assert::IsFalse(columns["cpu"].empty());
+        }
+
+        TEST_METHOD(GarbageInputCpuLoadModeInPerfOutput)
+        {
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet.onnx";
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", modelPath, L"-PerfOutput", OUTPUT_PATH,
+                                                        L"-CPU", L"-LoadMode", L"mmap", L"-PrefetchModel" });
+            Assert::AreEqual(S_OK, RunProc((wchar_t*)command.c_str()));
+
+            std::map<std::string, std::string> columns = GetOutputCSVColumns(OUTPUT_PATH);
+            Assert::AreEqual(std::string("MemoryMap prefetched"), columns["model load mode"]);
+        }
+
         TEST_METHOD(RunAllModelsInFolderGarbageInput)
         {
             const std::wstring command = BuildCommand({ EXE_PATH, L"-folder", INPUT_FOLDER_PATH, L"-PerfOutput", OUTPUT_PATH, L"-perf" });
@@ -517,6 +597,68 @@ namespace WinMLRunnerTest
             // We need to expect one more line because of the header
             Assert::AreEqual(static_cast<size_t>(5), GetOutputCSVLineCount());
         }
+
+        TEST_METHOD(RunAllModelsInFolderInParallelKeepsConfigurationOrder)
+        {
+            const std::wstring sequentialOutputPath = CURRENT_PATH + L"test_output_sequential.csv";
+            const std::wstring sequentialCommand = BuildCommand(
+                { EXE_PATH, L"-folder", INPUT_FOLDER_PATH, L"-PerfOutput", sequentialOutputPath, L"-perf" });
+            Assert::AreEqual(S_OK, RunProc((wchar_t *)sequentialCommand.c_str()));
+
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-folder", INPUT_FOLDER_PATH, L"-PerfOutput",
+                                                        OUTPUT_PATH, L"-perf", L"-MaxParallelScenarios", L"4" });
+            Assert::AreEqual(S_OK, RunProc((wchar_t *)command.c_str()));
+
+            // We need to expect one more line because of the header
+            Assert::AreEqual(static_cast<size_t>(5), GetOutputCSVLineCount());
+            auto sequentialConfigurations = GetOutputCSVConfigurations(sequentialOutputPath);
+            std::remove(std::string(sequentialOutputPath.begin(), sequentialOutputPath.end()).c_str());
+            Assert::IsTrue(sequentialConfigurations == GetOutputCSVConfigurations(OUTPUT_PATH));
+        }
+
+        TEST_METHOD(RunAllModelsInFolderIsolatedResumesFromJournal)
+        {
+            const std::wstring journalPath = CURRENT_PATH + L"test_output.journal";
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-folder", INPUT_FOLDER_PATH, L"-PerfOutput",
+                                                        OUTPUT_PATH, L"-perf", L"-Isolate", L"-Journal", journalPath });
+            Assert::AreEqual(S_OK, RunProc((wchar_t *)command.c_str()));
+            // We need to expect one more line because of the header
+            Assert::AreEqual(static_cast<size_t>(5), GetOutputCSVLineCount());
+
+            // Every model is in the journal, so the rerun starts no child and appends no row.
+            Assert::AreEqual(S_OK, RunProc((wchar_t *)command.c_str()));
+            Assert::AreEqual(static_cast<size_t>(5), GetOutputCSVLineCount());
+            std::filesystem::remove(journalPath);
+            std::filesystem::remove_all(journalPath + L".logs");
+        }
+
+        TEST_METHOD(IsolateWithoutJournalOrPerfOutput)
+        {
+            // The journal would default to a path stamped with the time, which no rerun finds.
+            const std::wstring command =
+                BuildCommand({ EXE_PATH, L"-folder", INPUT_FOLDER_PATH, L"-perf", L"-Isolate" });
+            Assert::AreEqual(E_INVALIDARG, RunProc((wchar_t *)command.c_str()));
+        }
+
+        TEST_METHOD(ColdStartWritesARowPerLaunch)
+        {
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet.onnx";
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", modelPath, L"-CPU", L"-ColdStart", L"2",
+                                                        L"-EvictModel", L"-PerfOutput", OUTPUT_PATH });
+            Assert::AreEqual(S_OK, RunProc((wchar_t *)command.c_str()));
+            // A cold and a warm launch for each of the 2, plus the header.
+            Assert::AreEqual(static_cast<size_t>(5), GetOutputCSVLineCount());
+        }
+
+        TEST_METHOD(ScaleOutWritesARowPerWorkerAndRun)
+        {
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet.onnx";
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", modelPath, L"-CPU", L"-ScaleOut", L"2",
+                                                        L"-Requests", L"10", L"-PerfOutput", OUTPUT_PATH });
+            Assert::AreEqual(S_OK, RunProc((wchar_t *)command.c_str()));
+            // A solo and a shared row for each of the 2 workers and a total, plus the header.
+            Assert::AreEqual(static_cast<size_t>(6), GetOutputCSVLineCount());
+        }
     };
 
     TEST_CLASS(ImageInputTest)
@@ -603,6 +745,25 @@ namespace WinMLRunnerTest
             Assert::AreEqual(static_cast<size_t>(2), GetOutputCSVLineCount(tensorDataPath + L"\\PerIterationData\\Summary.csv"));
         }
 
+        TEST_METHOD_WITH_NAME(ProvidedImageInputOnlyCpuSchedulingTelemetry)
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet.onnx";
+            const std::wstring inputPath = CURRENT_PATH + L"fish.png";
+            const std::wstring tensorDataPath = TENSOR_DATA_PATH + L"\\" + METHOD_NAME;
+            const std::wstring command =
+                BuildCommand({ EXE_PATH, L"-model", modelPath, L"-input", inputPath, L"-Iterations", L"5",
+                               L"-SchedulingTelemetry", L"-BaseOutputPath", tensorDataPath,
+                               L"-PerIterationPath PerIterationData", L"-CPU" });
+            Assert::AreEqual(S_OK, RunProc((wchar_t*)command.c_str()));
+
+            // We need to expect one more line because of the header
+            const std::wstring summaryPath = tensorDataPath + L"\\PerIterationData\\Summary.csv";
+            Assert::AreEqual(static_cast<size_t>(6), GetOutputCSVLineCount(summaryPath));
+            std::ifstream fin(summaryPath);
+            std::string header;
+            std::getline(fin, header);
+            Assert::IsTrue(header.find("Process Context Switches") != std::string::npos);
+        }
+
         TEST_METHOD_WITH_NAME(ProvidedImageInputOnlyCpuSaveTensor)
             const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet.onnx";
             const std::wstring inputPath = CURRENT_PATH + L"fish.png";
@@ -827,6 +988,30 @@ namespace WinMLRunnerTest
             Assert::AreEqual(true, CompareTensorsFP16(L"OutputTensorData\\Squeezenet_fp16_fish_input_CPU.csv",
                                                       tensorDataPath + L"\\softmaxout_1CpuIteration1.csv"));
         }
+
+        TEST_METHOD_WITH_NAME(ProvidedCSVInputWinMLBackend)
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet.onnx";
+            const std::wstring inputPath = CURRENT_PATH + L"fish.csv";
+            const std::wstring tensorDataPath = TENSOR_DATA_PATH + L"\\" + METHOD_NAME;
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", modelPath, L"-input", inputPath, L"-CPU",
+                                                        L"-Backend", L"WinML", L"-SaveTensorData", L"First",
+                                                        L"-PerIterationPath", tensorDataPath });
+            Assert::AreEqual(S_OK, RunProc((wchar_t*)command.c_str()));
+            Assert::AreEqual(true, CompareTensors(L"OutputTensorData\\Squeezenet_fish_input_CPU.csv",
+                                                  tensorDataPath + L"\\softmaxout_1WinMLCPU.csv"));
+        }
+
+        TEST_METHOD_WITH_NAME(ProvidedCSVInputReferenceBackend)
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet.onnx";
+            const std::wstring inputPath = CURRENT_PATH + L"fish.csv";
+            const std::wstring tensorDataPath = TENSOR_DATA_PATH + L"\\" + METHOD_NAME;
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", modelPath, L"-input", inputPath,
+                                                        L"-Backend", L"Reference", L"-SaveTensorData", L"First",
+                                                        L"-PerIterationPath", tensorDataPath });
+            Assert::AreEqual(S_OK, RunProc((wchar_t*)command.c_str()));
+            Assert::AreEqual(true, CompareTensors(L"OutputTensorData\\Squeezenet_fish_input_CPU.csv",
+                                                  tensorDataPath + L"\\softmaxout_1Reference.csv"));
+        }
     };
 
     TEST_CLASS(ConcurrencyTest)
@@ -857,6 +1042,109 @@ namespace WinMLRunnerTest
             });
             Assert::AreEqual(S_OK, RunProc((wchar_t *)command.c_str()));
         }
+
+        TEST_METHOD(RunFolderWithModelCache)
+        {
+            const std::wstring command = BuildCommand({
+                EXE_PATH, L"-folder", INPUT_FOLDER_PATH, L"-ConcurrentLoad", L"-NumThreads", L"5", L"-ModelCache"
+            });
+            Assert::AreEqual(S_OK, RunProc((wchar_t *)command.c_str()));
+        }
+
+        TEST_METHOD(MicroBatchingFreeBatchModel)
+        {
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet_free.onnx";
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", modelPath, L"-CPU", L"-MicroBatching",
+                                                        L"-MaxBatchSize", L"4", L"-Clients", L"4", L"-Requests", L"8" });
+            Assert::AreEqual(S_OK, RunProc((wchar_t *)command.c_str()));
+        }
+
+        TEST_METHOD(AsyncEvaluateOverlapsEvaluations)
+        {
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet.onnx";
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", modelPath, L"-CPU", L"-AsyncEvaluate",
+                                                        L"-MaxInFlight", L"3", L"-Requests", L"8" });
+            Assert::AreEqual(S_OK, RunProc((wchar_t *)command.c_str()));
+        }
+
+        TEST_METHOD(SharedMemoryInputStreamsFromProducerProcess)
+        {
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet.onnx";
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", modelPath, L"-CPU",
+                                                        L"-SharedMemoryInput", L"-RingSlots", L"2", L"-Requests",
+                                                        L"8" });
+            Assert::AreEqual(S_OK, RunProc((wchar_t *)command.c_str()));
+        }
+
+        TEST_METHOD(ServeAnswersLoadClientAndStops)
+        {
+            const std::wstring modelPath = CURRENT_PATH + L"SqueezeNet_free.onnx";
+            const std::wstring pipeName = L"WinMLRunnerTest" + std::to_wstring(GetCurrentProcessId());
+            std::wstring serverCommand = BuildCommand({ EXE_PATH, L"-model", modelPath, L"-CPU", L"-Serve", pipeName,
+                                                        L"-MaxBatchSize", L"4" });
+            STARTUPINFO startupInfo = { sizeof(startupInfo) };
+            PROCESS_INFORMATION server = {};
+            Assert::IsTrue(0 != CreateProcess(nullptr, &serverCommand[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr,
+                                              &startupInfo, &server));
+            CloseHandle(server.hThread);
+
+            // The client retries until the server has loaded the model, then stops it once its requests are done.
+            const std::wstring clientCommand = BuildCommand({ EXE_PATH, L"-Connect", pipeName, L"-Clients", L"4",
+                                                              L"-Requests", L"8", L"-StopServer" });
+            HRESULT clientResult = RunProc((wchar_t *)clientCommand.c_str());
+            if (clientResult != S_OK)
+            {
+                TerminateProcess(server.hProcess, 1);
+            }
+            Assert::AreEqual(WAIT_OBJECT_0, WaitForSingleObject(server.hProcess, 60000));
+            DWORD serverExitCode = 1;
+            GetExitCodeProcess(server.hProcess, &serverExitCode);
+            CloseHandle(server.hProcess);
+            Assert::AreEqual(S_OK, clientResult);
+            Assert::AreEqual(0ul, serverExitCode);
+        }
+
+        TEST_METHOD(ScenarioFileRunsEveryScenarioInOneProcess)
+        {
+            const std::wstring scenarioPath = CURRENT_PATH + L"test_scenarios.json";
+            const std::wstring outputPath = CURRENT_PATH + L"test_scenarios.csv";
+            std::remove(std::string(outputPath.begin(), outputPath.end()).c_str());
+            {
+                std::ofstream scenarioFile(scenarioPath);
+                scenarioFile << R"({
+                    "defaults": { "device": "CPU", "iterations": 3 },
+                    "scenarios": [
+                        { "id": "squeezenet", "model": "SqueezeNet.onnx" },
+                        { "id": "squeezenet-again", "model": "SqueezeNet.onnx", "iterations": 5 },
+                        { "id": "squeezenet-batch4-t2", "model": "SqueezeNet_free.onnx", "batch": 4, "threads": 2 }
+                    ]
+                })";
+            }
+            const std::wstring command =
+                BuildCommand({ EXE_PATH, L"-ScenarioFile", scenarioPath, L"-PerfOutput", outputPath });
+            Assert::AreEqual(S_OK, RunProc((wchar_t *)command.c_str()));
+
+            // One row per scenario after the header, in file order, each carrying its scenario id.
+            Assert::AreEqual(static_cast<size_t>(4), GetOutputCSVLineCount(outputPath));
+            std::ifstream csv(outputPath);
+            std::string text((std::istreambuf_iterator<char>(csv)), std::istreambuf_iterator<char>());
+            size_t first = text.find(",squeezenet,");
+            size_t second = text.find(",squeezenet-again,");
+            size_t third = text.find(",squeezenet-batch4-t2,");
+            Assert::IsTrue(first != std::string::npos && second != std::string::npos && third != std::string::npos);
+            Assert::IsTrue(first < second && second < third);
+        }
+
+        TEST_METHOD(ScenarioFileRejectsUnknownKeys)
+        {
+            const std::wstring scenarioPath = CURRENT_PATH + L"test_scenarios_typo.json";
+            {
+                std::ofstream scenarioFile(scenarioPath);
+                scenarioFile << R"({ "scenarios": [ { "id": "typo", "model": "SqueezeNet.onnx", "iteration": 3 } ] })";
+            }
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-ScenarioFile", scenarioPath });
+            Assert::AreNotEqual(S_OK, RunProc((wchar_t *)command.c_str()));
+        }
     };
 
     TEST_CLASS(OtherTests)
@@ -880,6 +1168,24 @@ namespace WinMLRunnerTest
             Assert::AreEqual(S_OK, RunProc((wchar_t*)command.c_str()));
         }
 
+        TEST_METHOD(TestLoadModeStream)
+        {
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", CURRENT_PATH + L"SqueezeNet.onnx", L"-LoadMode", L"stream" });
+            Assert::AreEqual(S_OK, RunProc((wchar_t*)command.c_str()));
+        }
+
+        TEST_METHOD(TestLoadModeMemoryMap)
+        {
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", CURRENT_PATH + L"SqueezeNet.onnx", L"-LoadMode", L"mmap", L"-PrefetchModel" });
+            Assert::AreEqual(S_OK, RunProc((wchar_t*)command.c_str()));
+        }
+
+        TEST_METHOD(TestLoadModeMemoryMapModelNotFound)
+        {
+            const std::wstring command = BuildCommand({ EXE_PATH, L"-model", L"invalid_model_name", L"-LoadMode", L"mmap" });
+            Assert::AreNotEqual(S_OK, RunProc((wchar_t*)command.c_str()));
+        }
+
         /* Commenting out test until WinMLRunnerDLL.dll is properly written and ABI friendly
         TEST_METHOD(TestWinMLRunnerDllLinking)
         {
@@ -0,0 +1,415 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <malloc.h>
+#include <new>
+
+#include "Windows.h"
+#include <dbghelp.h>
+#include <psapi.h>
+#include <winternl.h>
+#include "AllocationTracker.h"
+
+using namespace AllocationTracker;
+
+static std::atomic<bool> s_enabled{ false };
+// Bytes allocated and not yet freed since Enable. Blocks allocated before and freed after make it drift down, which
+// does not matter as only its growth over an interval is reported.
+static std::atomic<int64_t> s_liveBytes{ 0 };
+// Plain data, so that reaching it from operator new never runs a constructor or allocates.
+static thread_local Phase* t_phase = nullptr;
+// Set while operator new and delete call malloc and free, whose heap calls they count themselves.
+static thread_local bool t_inOperator = false;
+
+void Phase::Reset() { memset(this, 0, sizeof(*this)); }
+
+std::vector<CallSite> Phase::TopSites(size_t count) const
+{
+    std::vector<CallSite> sites;
+    for (const auto& site : Sites)
+    {
+        if (site.Samples > 0)
+        {
+            sites.push_back(site);
+        }
+    }
+    std::sort(sites.begin(), sites.end(), [](const CallSite& a, const CallSite& b) {
+        return a.Samples != b.Samples ? a.Samples > b.Samples : a.Bytes > b.Bytes;
+    });
+    sites.resize((std::min)(count, sites.size()));
+    return sites;
+}
+
+
+bool AllocationTracker::IsEnabled() { return s_enabled; }
+
+void AllocationTracker::Enter(Phase& phase)
+{
+    phase.Intervals++;
+    phase.StartLiveBytes = s_liveBytes;
+    t_phase = &phase;
+}
+
+void AllocationTracker::Leave() { t_phase = nullptr; }
+
+// Not inlined, so that the frames to skip are always this function, RecordAllocation and operator new or the heap
+// function stand in.
+static __declspec(noinline) void SampleCallSite(Phase& phase, size_t size)
+{
+    void* frames[FramesPerSite] = {};
+    ULONG hash = 0;
+    if (RtlCaptureStackBackTrace(3, FramesPerSite, frames, &hash) == 0)
+    {
+        return;
+    }
+    for (uint32_t probe = 0; probe < SiteSlots; probe++)
+    {
+        CallSite& site = phase.Sites[(hash + probe) % SiteSlots];
+        if (site.Samples == 0)
+        {
+            site.Hash = hash;
+            memcpy(site.Frames, frames, sizeof(frames));
+        }
+        else if (site.Hash != hash)
+        {
+            continue;
+        }
+        site.Samples++;
+        site.Bytes += size;
+        return;
+    }
+    phase.DroppedSamples++;
+}
+
+static __declspec(noinline) void RecordAllocation(size_t size)
+{
+    int64_t liveBytes = s_liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    Phase* phase = t_phase;
+    if (phase == nullptr)
+    {
+        return;
+    }
+    phase->Allocations++;
+    phase->Bytes += size;
+    phase->PeakLiveBytes = (std::max)(phase->PeakLiveBytes, liveBytes - phase->StartLiveBytes);
+    if (phase->UntilSample == 0)
+    {
+        SampleCallSite(*phase, size);
+        phase->UntilSample = SampleInterval;
+    }
+    phase->UntilSample--;
+}
+
+static void RecordFree(size_t size)
+{
+    s_liveBytes.fetch_sub(size, std::memory_order_relaxed);
+    Phase* phase = t_phase;
+    if (phase != nullptr)
+    {
+        phase->Frees++;
+    }
+}
+
+// Stand ins for the heap functions in the import tables of other modules. They call the real ones through the import
+// table of this module, which is never patched.
+static SIZE_T BlockSize(HANDLE heap, LPCVOID block)
+{
+    SIZE_T size = block != nullptr ? HeapSize(heap, 0, block) : 0;
+    return size == static_cast<SIZE_T>(-1) ? 0 : size;
+}
+
+static __declspec(noinline) LPVOID WINAPI TrackedHeapAlloc(HANDLE heap, DWORD flags, SIZE_T size)
+{
+    LPVOID block = HeapAlloc(heap, flags, size);
+    if (block != nullptr && !t_inOperator)
+    {
+        RecordAllocation(size);
+    }
+    return block;
+}
+
+static __declspec(noinline) LPVOID WINAPI TrackedHeapReAlloc(HANDLE heap, DWORD flags, LPVOID block, SIZE_T size)
+{
+    SIZE_T oldSize = t_inOperator ? 0 : BlockSize(heap, block);
+    LPVOID newBlock = HeapReAlloc(heap, flags, block, size);
+    if (newBlock != nullptr && !t_inOperator)
+    {
+        RecordFree(oldSize);
+        RecordAllocation(size);
+    }
+    return newBlock;
+}
+
+static BOOL WINAPI TrackedHeapFree(HANDLE heap, DWORD flags, LPVOID block)
+{
+    if (block != nullptr && !t_inOperator)
+    {
+        RecordFree(BlockSize(heap, block));
+    }
+    return HeapFree(heap, flags, block);
+}
+
+// The stand in for an import table entry, or nullptr. kernel32 forwards the heap functions to ntdll, so an entry
+// holds either.
+static void* ReplacementFor(void* function)
+{
+    auto address = [](const wchar_t* module, const char* name) {
+        return reinterpret_cast<void*>(GetProcAddress(GetModuleHandleW(module), name));
+    };
+    static const std::pair<void*, void*> replacements[] = {
+        { address(L"kernel32.dll", "HeapAlloc"), reinterpret_cast<void*>(&TrackedHeapAlloc) },
+        { address(L"ntdll.dll", "RtlAllocateHeap"), reinterpret_cast<void*>(&TrackedHeapAlloc) },
+        { address(L"kernel32.dll", "HeapReAlloc"), reinterpret_cast<void*>(&TrackedHeapReAlloc) },
+        { address(L"ntdll.dll", "RtlReAllocateHeap"), reinterpret_cast<void*>(&TrackedHeapReAlloc) },
+        { address(L"kernel32.dll", "HeapFree"), reinterpret_cast<void*>(&TrackedHeapFree) },
+        { address(L"ntdll.dll", "RtlFreeHeap"), reinterpret_cast<void*>(&TrackedHeapFree) },
+    };
+    for (const auto& replacement : replacements)
+    {
+        if (replacement.first != nullptr && replacement.first == function)
+        {
+            return replacement.second;
+        }
+    }
+    return nullptr;
+}
+
+// The heap itself, and modules whose allocations are not the benchmark's.
+static bool IsExcludedModule(HMODULE module, const wchar_t* name)
+{
+    static HMODULE self = [] {
+        HMODULE handle = nullptr;
+        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                           reinterpret_cast<LPCWSTR>(&ReplacementFor), &handle);
+        return handle;
+    }();
+    const wchar_t* fileName = wcsrchr(name, L'\\');
+    fileName = fileName != nullptr ? fileName + 1 : name;
+    for (const wchar_t* excluded : { L"ntdll.dll", L"kernel32.dll", L"kernelbase.dll", L"dbghelp.dll" })
+    {
+        if (_wcsicmp(fileName, excluded) == 0)
+        {
+            return true;
+        }
+    }
+    return module == self;
+}
+
+static void PatchImports(HMODULE module)
+{
+    auto base = reinterpret_cast<BYTE*>(module);
+    auto dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(base);
+    if (dosHeader->e_magic != IMAGE_DOS_SIGNATURE)
+    {
+        return;
+    }
+    auto ntHeaders = reinterpret_cast<const IMAGE_NT_HEADERS*>(base + dosHeader->e_lfanew);
+    const IMAGE_DATA_DIRECTORY& imports = ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+    if (imports.VirtualAddress == 0)
+    {
+        return;
+    }
+    for (auto descriptor = reinterpret_cast<const IMAGE_IMPORT_DESCRIPTOR*>(base + imports.VirtualAddress);
+         descriptor->Name != 0; descriptor++)
+    {
+        for (auto thunk = reinterpret_cast<IMAGE_THUNK_DATA*>(base + descriptor->FirstThunk); thunk->u1.Function != 0;
+             thunk++)
+        {
+            void* replacement = ReplacementFor(reinterpret_cast<void*>(thunk->u1.Function));
+            DWORD protection = 0;
+            if (replacement != nullptr &&
+                VirtualProtect(&thunk->u1.Function, sizeof(thunk->u1.Function), PAGE_READWRITE, &protection))
+            {
+                // A single aligned store, so that threads calling through the entry meanwhile see either function.
+                thunk->u1.Function = reinterpret_cast<ULONG_PTR>(replacement);
+                VirtualProtect(&thunk->u1.Function, sizeof(thunk->u1.Function), protection, &protection);
+            }
+        }
+    }
+}
+
+// LdrRegisterDllNotification is only exported by ntdll, and its types are only documented.
+struct DllLoadedNotification
+{
+    ULONG Flags;
+    const UNICODE_STRING* FullDllName;
+    const UNICODE_STRING* BaseDllName;
+    PVOID DllBase;
+    ULONG SizeOfImage;
+};
+typedef VOID(CALLBACK* PFNDllNotification)(ULONG reason, const DllLoadedNotification* data, PVOID context);
+typedef NTSTATUS(NTAPI* PFNLdrRegisterDllNotification)(ULONG flags, PFNDllNotification callback, PVOID context,
+                                                       PVOID* cookie);
+static const ULONG DllNotificationReasonLoaded = 1;
+
+// Called under the loader lock once the imports of a new module are resolved, before its DllMain runs.
+static VOID CALLBACK OnDllNotification(ULONG reason, const DllLoadedNotification* data, PVOID)
+{
+    if (reason != DllNotificationReasonLoaded)
+    {
+        return;
+    }
+    // Copied without allocating, as the name is not null terminated.
+    wchar_t name[MAX_PATH] = {};
+    size_t length = (std::min)(static_cast<size_t>(data->BaseDllName->Length / sizeof(wchar_t)), MAX_PATH - size_t(1));
+    wmemcpy(name, data->BaseDllName->Buffer, length);
+    auto module = static_cast<HMODULE>(data->DllBase);
+    if (!IsExcludedModule(module, name))
+    {
+        PatchImports(module);
+    }
+}
+
+void AllocationTracker::Enable()
+{
+    if (s_enabled.exchange(true))
+    {
+        return;
+    }
+    auto registerDllNotification = reinterpret_cast<PFNLdrRegisterDllNotification>(
+        GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "LdrRegisterDllNotification"));
+    PVOID cookie = nullptr;
+    if (registerDllNotification != nullptr)
+    {
+        registerDllNotification(0, OnDllNotification, nullptr, &cookie);
+    }
+    std::vector<HMODULE> modules(1024);
+    DWORD needed = 0;
+    if (!EnumProcessModules(GetCurrentProcess(), modules.data(), static_cast<DWORD>(modules.size() * sizeof(HMODULE)),
+                            &needed))
+    {
+        return;
+    }
+    modules.resize((std::min)(modules.size(), needed / sizeof(HMODULE)));
+    for (HMODULE module : modules)
+    {
+        wchar_t name[MAX_PATH] = {};
+        if (GetModuleFileNameW(module, name, MAX_PATH) != 0 && !IsExcludedModule(module, name))
+        {
+            PatchImports(module);
+        }
+    }
+}
+
+std::string AllocationTracker::DescribeFrame(void* address)
+{
+    // dbghelp is loaded when first needed, as pdh is, so that running without -TrackAllocations never loads it.
+    typedef BOOL(WINAPI * PFNSymInitialize)(HANDLE process, PCSTR searchPath, BOOL invadeProcess);
+    typedef BOOL(WINAPI * PFNSymFromAddr)(HANDLE process, DWORD64 address, PDWORD64 displacement, PSYMBOL_INFO symbol);
+    typedef BOOL(WINAPI * PFNSymGetLineFromAddr64)(HANDLE process, DWORD64 address, PDWORD displacement,
+                                                   PIMAGEHLP_LINE64 line);
+    static HMODULE dbghelp = LoadLibraryExW(L"dbghelp.dll", nullptr, LOAD_LIBRARY_SEARCH_SYSTEM32);
+    static auto symFromAddr =
+        dbghelp != nullptr ? reinterpret_cast<PFNSymFromAddr>(GetProcAddress(dbghelp, "SymFromAddr")) : nullptr;
+    static auto symGetLineFromAddr64 =
+        dbghelp != nullptr ? reinterpret_cast<PFNSymGetLineFromAddr64>(GetProcAddress(dbghelp, "SymGetLineFromAddr64"))
+                           : nullptr;
+    static bool initialized = [] {
+        auto symInitialize =
+            dbghelp != nullptr ? reinterpret_cast<PFNSymInitialize>(GetProcAddress(dbghelp, "SymInitialize")) : nullptr;
+        return symInitialize != nullptr && symInitialize(GetCurrentProcess(), nullptr, TRUE);
+    }();
+
+    DWORD64 frame = reinterpret_cast<DWORD64>(address);
+    if (initialized && symFromAddr != nullptr)
+    {
+        char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME] = {};
+        auto symbol = reinterpret_cast<PSYMBOL_INFO>(buffer);
+        symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+        symbol->MaxNameLen = MAX_SYM_NAME;
+        DWORD64 displacement = 0;
+        if (symFromAddr(GetCurrentProcess(), frame, &displacement, symbol))
+        {
+            std::string description(symbol->Name, symbol->NameLen);
+            IMAGEHLP_LINE64 line = { sizeof(line) };
+            DWORD lineDisplacement = 0;
+            if (symGetLineFromAddr64 != nullptr &&
+                symGetLineFromAddr64(GetCurrentProcess(), frame, &lineDisplacement, &line))
+            {
+                const char* file = strrchr(line.FileName, '\\');
+                description += " (" + std::string(file != nullptr ? file + 1 : line.FileName) + ":" +
+                               std::to_string(line.LineNumber) + ")";
+            }
+            return description;
+        }
+    }
+    HMODULE module = nullptr;
+    char modulePath[MAX_PATH] = {};
+    if (!GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                            static_cast<LPCSTR>(address), &module) ||
+        GetModuleFileNameA(module, modulePath, MAX_PATH) == 0)
+    {
+        return "unknown";
+    }
+    const char* moduleName = strrchr(modulePath, '\\');
+    char offset[32] = {};
+    sprintf_s(offset, "+0x%llx", frame - reinterpret_cast<DWORD64>(module));
+    return std::string(moduleName != nullptr ? moduleName + 1 : modulePath) + offset;
+}
+
+// The replacements every operator new and delete of the module resolve to. Until Enable they cost one load of
+// s_enabled over malloc and free. Never inlined, even with link time code generation, so that SampleCallSite skips
+// the right frames.
+
+__declspec(noinline) void* operator new(size_t size)
+{
+    for (;;)
+    {
+        t_inOperator = true;
+        void* block = malloc(size == 0 ? 1 : size);
+        t_inOperator = false;
+        if (block != nullptr)
+        {
+            if (s_enabled.load(std::memory_order_relaxed))
+            {
+                // The size the heap reserved, which is what _msize reports again when the block is freed.
+                RecordAllocation(_msize(block));
+            }
+            return block;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try
+    {
+        return operator new(size);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nothrow) noexcept { return operator new(size, nothrow); }
+
+void operator delete(void* block) noexcept
+{
+    if (block != nullptr && s_enabled.load(std::memory_order_relaxed))
+    {
+        RecordFree(_msize(block));
+    }
+    t_inOperator = true;
+    free(block);
+    t_inOperator = false;
+}
+
+void operator delete[](void* block) noexcept { operator delete(block); }
+
+void operator delete(void* block, size_t) noexcept { operator delete(block); }
+
+void operator delete[](void* block, size_t) noexcept { operator delete(block); }
+
+void operator delete(void* block, const std::nothrow_t&) noexcept { operator delete(block); }
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept { operator delete(block); }
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Counts heap allocations and attributes each one to the profiling interval active on the allocating thread. The
+// allocations of this module are seen through operator new, which AllocationTracker.cpp replaces; those of WinML and
+// every other DLL through HeapAlloc, HeapReAlloc and HeapFree, which Enable patches into their import tables, so
+// malloc and operator new of whatever C runtime they use are counted too. Work WinML hands to its own threads is
+// counted in the live heap bytes but not attributed to the interval.
+namespace AllocationTracker
+{
+// One in SampleInterval allocations of an interval has its call stack recorded.
+static const uint32_t SampleInterval = 16;
+static const uint32_t FramesPerSite = 8;
+static const uint32_t SiteSlots = 64;
+
+struct CallSite
+{
+    // Hash of the frames, as returned by RtlCaptureStackBackTrace.
+    uint32_t Hash;
+    uint32_t Samples;
+    uint64_t Bytes;
+    void* Frames[FramesPerSite];
+};
+
+// The allocations made during the intervals of one PerfCounterStatistics. Only the thread that started an interval
+// adds to it, so nothing here is atomic.
+struct Phase
+{
+    uint64_t Intervals;
+    uint64_t Allocations;
+    uint64_t Bytes;
+    uint64_t Frees;
+    // Highest growth of the live heap bytes of the process over the start of an interval. Frees and allocations of
+    // other threads count, so this is how much more the heap held at once while the interval ran.
+    int64_t PeakLiveBytes;
+    int64_t StartLiveBytes;
+    uint32_t UntilSample;
+    // Samples whose call site found no free slot.
+    uint32_t DroppedSamples;
+    // Open addressed on the hash; a slot is free while its Samples is 0.
+    CallSite Sites[SiteSlots];
+
+    void Reset();
+    // The recorded call sites with the most samples first.
+    std::vector<CallSite> TopSites(size_t count) const;
+};
+
+// Starts counting and patches the heap imports of the loaded modules, and of those loaded later. Until then operator
+// new and delete only pass through to malloc and free. The patches stay until the process exits.
+void Enable();
+bool IsEnabled();
+
+// Attributes the allocations of the calling thread to phase until Leave.
+void Enter(Phase& phase);
+void Leave();
+
+// The function, file and line of a frame when symbols are found, else its module and offset.
+std::string DescribeFrame(void* address);
+} // namespace AllocationTracker
@@ -0,0 +1,156 @@
+#include <iomanip>
+#include <random>
+
+#include "Windows.h"
+#include "common.h"
+#include "AsyncEvaluator.h"
+#include "Scenarios.h"
+#include "Statistics.h"
+
+using namespace winrt;
+using namespace winrt::Windows::AI::MachineLearning;
+
+struct OverlapStats
+{
+    double throughput = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+};
+
+static OverlapStats ComputeStats(std::vector<double>& latencies, double elapsed)
+{
+    std::sort(latencies.begin(), latencies.end());
+    OverlapStats stats;
+    stats.throughput = elapsed > 0 ? latencies.size() * 1000.0 / elapsed : 0;
+    stats.p50 = Statistics::Percentile(latencies, 50);
+    stats.p90 = Statistics::Percentile(latencies, 90);
+    stats.p99 = Statistics::Percentile(latencies, 99);
+    return stats;
+}
+
+// Random float tensors for every input. Free dimensions are evaluated with size 1.
+static std::vector<std::pair<hstring, TensorFloat>> CreateInputs(const LearningModel& model)
+{
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    std::vector<std::pair<hstring, TensorFloat>> inputs;
+    for (auto&& input : model.InputFeatures())
+    {
+        auto descriptor = input.try_as<TensorFeatureDescriptor>();
+        if (!descriptor || descriptor.TensorKind() != TensorKind::Float)
+        {
+            throw hresult_invalid_argument(L"AsyncEvaluate: every model input must be a float tensor.");
+        }
+        std::vector<int64_t> shape;
+        size_t elementCount = 1;
+        for (auto dim : descriptor.Shape())
+        {
+            shape.push_back(dim > 0 ? dim : 1);
+            elementCount *= static_cast<size_t>(shape.back());
+        }
+        std::vector<float> data(elementCount);
+        std::generate(data.begin(), data.end(), [&]() { return distribution(generator); });
+        inputs.emplace_back(descriptor.Name(), TensorFloat::CreateFromArray(shape, data));
+    }
+    return inputs;
+}
+
+static void BindInputs(const LearningModelBinding& binding,
+                       const std::vector<std::pair<hstring, TensorFloat>>& inputs)
+{
+    for (auto& input : inputs)
+    {
+        binding.Bind(input.first, input.second);
+    }
+}
+
+// One evaluation at a time on the calling thread.
+static OverlapStats EvaluateSynchronously(const LearningModelSession& session,
+                                          const std::vector<std::pair<hstring, TensorFloat>>& inputs,
+                                          unsigned num_requests)
+{
+    LearningModelBinding binding(session);
+    std::vector<double> latencies;
+    Timer wallClock;
+    wallClock.Start();
+    for (unsigned request = 0; request < num_requests; request++)
+    {
+        Timer timer;
+        timer.Start();
+        BindInputs(binding, inputs);
+        session.Evaluate(binding, L"");
+        latencies.push_back(timer.Stop());
+    }
+    return ComputeStats(latencies, wallClock.Stop());
+}
+
+// Submits num_requests evaluations as fast as the evaluator accepts them. Latency is measured from submission, so it
+// includes the time a request waited for a free binding.
+static OverlapStats EvaluateOverlapped(const LearningModelSession& session,
+                                       const std::vector<std::pair<hstring, TensorFloat>>& inputs,
+                                       unsigned max_in_flight, unsigned num_requests)
+{
+    std::vector<double> latencies(num_requests);
+    // Declared after latencies so that, should Submit throw, the evaluator waits for the evaluations still writing to
+    // it before it is destroyed.
+    AsyncEvaluation::AsyncEvaluator evaluator(session, max_in_flight);
+    Timer wallClock;
+    wallClock.Start();
+    for (unsigned request = 0; request < num_requests; request++)
+    {
+        auto submitted = std::chrono::high_resolution_clock::now();
+        evaluator.Submit([&](const LearningModelBinding& binding) { BindInputs(binding, inputs); },
+                         [&latencies, request, submitted](const LearningModelEvaluationResult&,
+                                                          const LearningModelBinding&) {
+                             latencies[request] = std::chrono::duration<double, std::milli>(
+                                                      std::chrono::high_resolution_clock::now() - submitted)
+                                                      .count();
+                         });
+    }
+    evaluator.Drain();
+    return ComputeStats(latencies, wallClock.Stop());
+}
+
+static void PrintRow(const std::string& mode, unsigned in_flight, const OverlapStats& stats, double baseline)
+{
+    std::cout << "  " << std::setw(14) << mode << std::setw(12) << in_flight << std::setw(20) << std::fixed
+              << std::setprecision(1) << stats.throughput << std::setw(10) << std::setprecision(2)
+              << (baseline > 0 ? stats.throughput / baseline : 0) << std::setw(12) << std::setprecision(3)
+              << stats.p50 << std::setw(12) << stats.p90 << std::setw(12) << stats.p99 << std::defaultfloat
+              << std::endl;
+}
+
+void AsyncEvaluationBenchmark(const std::wstring& path, const LearningModelDevice& device,
+                              const std::string& device_name, unsigned max_in_flight, unsigned num_requests)
+{
+    auto model = LearningModel::LoadFromFilePath(path);
+    std::wcout << L"Async evaluation benchmark for " << path << std::endl;
+    std::cout << "  Device: " << device_name << ", requests: " << num_requests << std::endl;
+
+    LearningModelSession session(model, device);
+    auto inputs = CreateInputs(model);
+
+    // Warm up so that first-run initialization is not charged to either mode.
+    EvaluateSynchronously(session, inputs, 2);
+
+    std::cout << std::left << "  " << std::setw(14) << "Mode" << std::setw(12) << "InFlight" << std::setw(20)
+              << "Throughput(req/s)" << std::setw(10) << "Speedup" << std::setw(12) << "p50(ms)" << std::setw(12)
+              << "p90(ms)" << std::setw(12) << "p99(ms)" << std::endl;
+    OverlapStats synchronous = EvaluateSynchronously(session, inputs, num_requests);
+    PrintRow("Evaluate", 1, synchronous, synchronous.throughput);
+
+    // In-flight depths 1, 2, 4, ... up to max_in_flight show where overlap stops paying off.
+    std::vector<unsigned> depths;
+    for (unsigned depth = 1; depth < max_in_flight; depth *= 2)
+    {
+        depths.push_back(depth);
+    }
+    depths.push_back(max_in_flight);
+    for (unsigned depth : depths)
+    {
+        OverlapStats overlapped = EvaluateOverlapped(session, inputs, depth, num_requests);
+        PrintRow("EvaluateAsync", depth, overlapped, synchronous.throughput);
+    }
+    std::cout << std::right << std::endl;
+}
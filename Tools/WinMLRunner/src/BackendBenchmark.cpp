@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+
+#include "Windows.h"
+#include "common.h"
+#include "BackendHarness.h"
+#include "ReferenceBackend.h"
+#include "ResultHelper.h"
+#include "Scenarios.h"
+
+using namespace winrt;
+using InferenceBackend::ElementType;
+
+// Bad inputs end the run with E_INVALIDARG, as they do on the WinRT pipeline.
+static std::vector<double> ReadCsvValues(const std::wstring& path)
+{
+    try
+    {
+        return path.empty() ? std::vector<double>() : BackendHarness::ReadCsvValues(path);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        throw hresult_invalid_argument(to_hstring(e.what()));
+    }
+}
+
+static BackendHarness::Run LoadBindAndEvaluate(InferenceBackend::Backend& backend, const std::wstring& path,
+                                               const std::vector<double>& csv_values, unsigned num_iterations)
+{
+    try
+    {
+        return BackendHarness::LoadBindAndEvaluate(backend, path, csv_values, num_iterations);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        throw hresult_invalid_argument(to_hstring(e.what()));
+    }
+}
+
+// Prints the time and throughput of every node of a profiled reference session, slowest first.
+static void PrintLayerProfile(const InferenceBackend::ReferenceSession& session)
+{
+    std::vector<InferenceBackend::Reference::LayerProfile> layers = session.Profile();
+    if (layers.empty() || layers.front().evaluations == 0)
+    {
+        return;
+    }
+    double totalMilliseconds = 0;
+    double totalFlops = 0;
+    for (const auto& layer : layers)
+    {
+        totalMilliseconds += layer.milliseconds;
+        totalFlops += layer.flops;
+    }
+    std::stable_sort(layers.begin(), layers.end(),
+                     [](const auto& a, const auto& b) { return a.milliseconds > b.milliseconds; });
+
+    std::cout << "  Layers (" << layers.size() << " nodes, " << session.BufferCount()
+              << " intermediate buffers, average over " << layers.front().evaluations << " evaluations):"
+              << std::endl;
+    std::cout << "    " << std::left << std::setw(40) << "Node" << std::setw(20) << "Op" << std::right
+              << std::setw(12) << "ms" << std::setw(8) << "%" << std::setw(12) << "GFLOP/s" << std::endl;
+    std::cout << std::fixed;
+    for (const auto& layer : layers)
+    {
+        std::cout << "    " << std::left << std::setw(40) << layer.name << std::setw(20) << layer.opType << std::right
+                  << std::setprecision(3) << std::setw(12) << layer.milliseconds / layer.evaluations
+                  << std::setprecision(1) << std::setw(8) << 100.0 * layer.milliseconds / totalMilliseconds
+                  << std::setprecision(2) << std::setw(12)
+                  << (layer.milliseconds > 0 ? layer.flops / layer.milliseconds / 1e6 : 0.0) << std::endl;
+    }
+    std::cout << "    " << std::left << std::setw(60) << "Total" << std::right << std::setprecision(3)
+              << std::setw(12) << totalMilliseconds / layers.front().evaluations << std::setw(8) << ""
+              << std::setprecision(2) << std::setw(12)
+              << (totalMilliseconds > 0 ? totalFlops / totalMilliseconds / 1e6 : 0.0) << std::endl;
+    std::cout << std::defaultfloat << std::setprecision(6);
+}
+
+int RunBackendBenchmark(InferenceBackend::Backend& backend, const std::wstring& path, const std::string& device_name,
+                        const std::wstring& input_path, unsigned num_iterations, unsigned top_k,
+                        const std::wstring& save_tensor_path)
+{
+    std::wcout << L"Backend benchmark for " << path << std::endl;
+    std::cout << "  Backend: " << backend.Name() << (device_name.empty() ? "" : ", device: " + device_name)
+              << ", iterations: " << num_iterations << std::endl;
+
+    BackendHarness::Run run = LoadBindAndEvaluate(backend, path, ReadCsvValues(input_path), num_iterations);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  Load: " << run.loadMilliseconds << " ms, session: " << run.sessionMilliseconds
+              << " ms, bind: " << run.bindMilliseconds << " ms" << std::endl;
+    std::cout << "  First evaluate: " << run.FirstEvaluateMilliseconds()
+              << " ms, average of the rest: " << run.AverageEvaluateMilliseconds() << " ms" << std::endl;
+    std::cout << std::defaultfloat;
+
+    if (num_iterations == 0)
+    {
+        return 0;
+    }
+    if (auto referenceSession = dynamic_cast<const InferenceBackend::ReferenceSession*>(run.session.get()))
+    {
+        PrintLayerProfile(*referenceSession);
+    }
+    for (const auto& output : run.model->Outputs())
+    {
+        const InferenceBackend::Tensor& tensor = run.session->Output(output.name);
+        if (tensor.Type() != ElementType::Float)
+        {
+            std::cout << "  " << output.name << ": " << InferenceBackend::ElementTypeName(tensor.Type()) << " ["
+                      << tensor.ElementCount() << " elements]" << std::endl;
+            continue;
+        }
+        std::cout << "  " << output.name << " top " << top_k << ":";
+        for (const auto& prediction : ResultHelper::TopK(tensor.Data<float>(), tensor.ElementCount(), top_k))
+        {
+            std::cout << " " << prediction.index << " (" << prediction.score << ")";
+        }
+        std::cout << std::endl;
+        if (!save_tensor_path.empty())
+        {
+            std::filesystem::create_directories(save_tensor_path);
+            std::string fileName = output.name + backend.Name() + device_name + ".csv";
+            BackendHarness::SaveTensor(std::filesystem::path(save_tensor_path) / fileName, tensor);
+        }
+    }
+    return 0;
+}
+
+int CompareModelOutputs(InferenceBackend::Backend& backend, const std::wstring& reference_path,
+                        const std::wstring& candidate_path, const std::string& device_name,
+                        const std::wstring& input_path, unsigned top_k)
+{
+    std::wcout << L"Comparing " << candidate_path << L" against " << reference_path << std::endl;
+    std::cout << "  Backend: " << backend.Name() << (device_name.empty() ? "" : ", device: " + device_name)
+              << std::endl;
+
+    // Random inputs come from the same seed, so both models see the same values up to the input type.
+    std::vector<double> csvValues = ReadCsvValues(input_path);
+    BackendHarness::Run runs[2] = { LoadBindAndEvaluate(backend, reference_path, csvValues, 1),
+                                    LoadBindAndEvaluate(backend, candidate_path, csvValues, 1) };
+
+    int result = 0;
+    for (const auto& output : runs[0].model->Outputs())
+    {
+        const auto& candidateOutputs = runs[1].model->Outputs();
+        if (std::none_of(candidateOutputs.begin(), candidateOutputs.end(),
+                         [&](const InferenceBackend::ValueInfo& info) { return info.name == output.name; }))
+        {
+            std::cout << "  " << output.name << ": missing from the candidate model" << std::endl;
+            result = 1;
+            continue;
+        }
+        const InferenceBackend::Tensor& referenceTensor = runs[0].session->Output(output.name);
+        const InferenceBackend::Tensor& candidateTensor = runs[1].session->Output(output.name);
+        if (!BackendHarness::IsFloatingPoint(referenceTensor.Type()) ||
+            !BackendHarness::IsFloatingPoint(candidateTensor.Type()) ||
+            referenceTensor.ElementCount() != candidateTensor.ElementCount())
+        {
+            std::cout << "  " << output.name << ": " << InferenceBackend::ElementTypeName(referenceTensor.Type())
+                      << " [" << referenceTensor.ElementCount() << " elements] and "
+                      << InferenceBackend::ElementTypeName(candidateTensor.Type()) << " ["
+                      << candidateTensor.ElementCount() << " elements] cannot be compared" << std::endl;
+            result = referenceTensor.ElementCount() != candidateTensor.ElementCount() ? 1 : result;
+            continue;
+        }
+
+        BackendHarness::OutputComparison comparison =
+            BackendHarness::CompareOutputs(referenceTensor, candidateTensor, top_k);
+        std::cout << "  " << output.name << ": max abs error " << comparison.maxAbsError << ", mean abs error "
+                  << comparison.meanAbsError << ", top-1 " << (comparison.sameTop1 ? "matches" : "differs")
+                  << ", top " << top_k << " overlap " << comparison.topKOverlap << "/" << comparison.topKCount
+                  << std::endl;
+    }
+    return result;
+}
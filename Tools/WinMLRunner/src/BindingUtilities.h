@@ -1,10 +1,12 @@
 #pragma once
+#include <atomic>
 #include <random>
 #include <time.h>
 #include "Common.h"
 #include "Windows.AI.Machinelearning.Native.h"
 #include "d3dx12.h"
 #include "MemoryBuffer.h"
+#include "TensorConvert.h"
 using namespace winrt::Windows::Media;
 using namespace winrt::Windows::Storage;
 using namespace winrt::Windows::Storage::Streams;
@@ -162,7 +164,8 @@ static ColorManagementMode GetColorManagementMode(const LearningModel& model)
     }
     catch (...)
     {
-        printf("    Model does not have color space gamma information. Will color manage to sRGB by default...\n");
+        ConsolePrintf(
+            "    Model does not have color space gamma information. Will color manage to sRGB by default...\n");
     }
     if (gammaSpace == L"" || _wcsicmp(gammaSpace.c_str(), L"SRGB") == 0)
     {
@@ -170,8 +173,9 @@ static ColorManagementMode GetColorManagementMode(const LearningModel& model)
     }
     // Due diligence should be done to make sure that the input image is within the model's colorspace. There are
     // multiple non-sRGB color spaces.
-    printf("    Model metadata indicates that color gamma space is : %ws. Will not manage color space to sRGB...\n",
-           gammaSpace.c_str());
+    ConsolePrintf(
+        "    Model metadata indicates that color gamma space is : %ws. Will not manage color space to sRGB...\n",
+        gammaSpace.c_str());
     return ColorManagementMode::DoNotColorManage;
 }
 
@@ -205,8 +209,11 @@ void GetHeightAndWidthFromLearningModelFeatureDescriptor(const ILearningModelFea
 
 namespace BindingUtilities
 {
-    static unsigned int seed = 0;
-    static std::independent_bits_engine<std::default_random_engine, CHAR_BIT, unsigned int> randomBitsEngineChar;
+    // Scenarios may generate garbage data on several threads at once (-MaxParallelScenarios), so every thread gets its
+    // own engines and only the seed sequence is shared.
+    static std::atomic<unsigned int> seed{ 0 };
+    static thread_local std::independent_bits_engine<std::default_random_engine, CHAR_BIT, unsigned int>
+        randomBitsEngineChar;
 
     SoftwareBitmap GenerateGarbageImage(const ILearningModelFeatureDescriptor& modelFeatureDescriptor,
                                         InputDataType inputDataType)
@@ -258,8 +265,9 @@ namespace BindingUtilities
         }
         catch (hresult_error hr)
         {
-            printf("    Failed to load the image file, make sure you are using fully qualified paths\r\n");
-            printf("    %ws\n", hr.message().c_str());
+            ConsolePrintf("    Failed to load the image file, make sure you are using fully qualified paths\r\n");
+            ConsolePrintf("    %ws\n", hr.message().c_str());
+            ConsoleCapture::StopActive();
             exit(hr.code());
         }
         BitmapPixelFormat format = inputDataType == InputDataType::Tensor
@@ -295,9 +303,10 @@ namespace BindingUtilities
         }
         catch (hresult_error hr)
         {
-            printf("    Failed to create SoftwareBitmap! Please make sure that input image is within the model's "
-                   "colorspace.\n");
-            printf("    %ws\n", hr.message().c_str());
+            ConsolePrintf("    Failed to create SoftwareBitmap! Please make sure that input image is within the "
+                          "model's colorspace.\n");
+            ConsolePrintf("    %ws\n", hr.message().c_str());
+            ConsoleCapture::StopActive();
             exit(hr.code());
         }
     }
@@ -332,13 +341,14 @@ namespace BindingUtilities
         uint32_t totalSizeInBytes;
         uint32_t numChannelsPerElement;
         uint32_t elementStrideInBytes;
+        uint32_t rowPitchInBytes;
         bool isPlanar;
         TensorKind channelFormat;
         BitmapPixelFormat elementFormat;
 
         InputBufferDesc()
-            : elements(nullptr), totalSizeInBytes(0), numChannelsPerElement(0), elementStrideInBytes(0), isPlanar(0),
-              channelFormat(TensorKind::Undefined), elementFormat(BitmapPixelFormat::Unknown)
+            : elements(nullptr), totalSizeInBytes(0), numChannelsPerElement(0), elementStrideInBytes(0),
+              rowPitchInBytes(0), isPlanar(0), channelFormat(TensorKind::Undefined), elementFormat(BitmapPixelFormat::Unknown)
         {
         }
     };
@@ -397,10 +407,76 @@ namespace BindingUtilities
         }
     }
 
+    // Vectorized tensorization of interleaved 8-bit and Gray16 images. Returns false when the pixel format or the
+    // tensor kind is not handled by TensorConvert, in which case the caller falls back to CopyTensorFromBuffer.
+    template <TensorKind TKind>
+    bool TryConvertImageToTensor(void* actualData, uint32_t channels, uint32_t tensorHeight, uint32_t tensorWidth,
+                                 const InputBufferDesc& inputBufferDesc, float scale, const std::vector<float>& means,
+                                 const std::vector<float>& stddevs)
+    {
+        TensorConvert::ImageDesc image = {};
+        TensorConvert::ChannelOrder order = TensorConvert::ChannelOrder::RGB;
+        switch (inputBufferDesc.elementFormat)
+        {
+            case BitmapPixelFormat::Bgra8:
+                // Planes keep the order the pixels are stored in, matching CopyTensorFromBuffer.
+                image.format = TensorConvert::PixelFormat::Bgra8;
+                order = TensorConvert::ChannelOrder::BGR;
+                break;
+            case BitmapPixelFormat::Rgba8:
+                image.format = TensorConvert::PixelFormat::Rgba8;
+                break;
+            case BitmapPixelFormat::Gray8:
+                image.format = TensorConvert::PixelFormat::Gray8;
+                break;
+            case BitmapPixelFormat::Gray16:
+                image.format = TensorConvert::PixelFormat::Gray16;
+                break;
+            default:
+                return false;
+        }
+        if (channels != inputBufferDesc.numChannelsPerElement || (channels != 1 && channels != 3))
+        {
+            return false;
+        }
+
+        image.data = inputBufferDesc.elements;
+        image.width = tensorWidth;
+        image.height = tensorHeight;
+        image.rowPitchInBytes = inputBufferDesc.rowPitchInBytes;
+
+        // CopyTensorFromBuffer divides by the scale, TensorConvert multiplies.
+        TensorConvert::Normalization normalization;
+        normalization.scale = 1.0f / scale;
+        for (uint32_t i = 0; i < channels; ++i)
+        {
+            normalization.means[i] = means[i];
+            normalization.stddevs[i] = stddevs[i];
+        }
+
+        if constexpr (TKind == TensorKind::Float)
+        {
+            TensorConvert::ToPlanarFloat(image, order, channels, static_cast<float*>(actualData), normalization);
+        }
+        else if constexpr (TKind == TensorKind::Float16)
+        {
+            TensorConvert::ToPlanarHalf(image, order, channels, static_cast<uint16_t*>(actualData), normalization);
+        }
+        else if constexpr (TKind == TensorKind::UInt8)
+        {
+            TensorConvert::ToPlanarUInt8(image, order, channels, static_cast<uint8_t*>(actualData), normalization);
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
     template <TensorKind TKind, typename WriteType>
     static void GenerateRandomData(WriteType* data, uint32_t sizeInBytes, uint32_t maxValue)
     {
-        static std::independent_bits_engine<std::default_random_engine, sizeof(uint32_t) * 8, uint32_t>
+        static thread_local std::independent_bits_engine<std::default_random_engine, sizeof(uint32_t) * 8, uint32_t>
             randomBitsEngine;
         randomBitsEngine.seed(seed++);
 
@@ -494,18 +570,24 @@ namespace BindingUtilities
                     throw hresult_invalid_argument(L"CreateTensor<TKind>: Unknown Tensorize Function");
             }
 
-            switch (inputBufferDesc.channelFormat)
+            if (!args.IsImageInput() || !TryConvertImageToTensor<TKind>(actualData, channels, tensorHeight,
+                                                                        tensorWidth, inputBufferDesc, scale, means,
+                                                                        stddevs))
             {
-                case TensorKind::UInt8:
-                    CopyTensorFromBuffer<TKind, uint8_t>(actualData, tensorHeight, tensorWidth, inputBufferDesc, scale,
-                                                         means, stddevs);
-                    break;
-                case TensorKind::Float:
-                    CopyTensorFromBuffer<TKind, float>(actualData, tensorHeight, tensorWidth, inputBufferDesc, scale,
-                                                       means, stddevs);
-                    break;
-                default:
-                    throw hresult_not_implemented(L"Creating Tensors for Input Images with unhandled channel format!");
+                switch (inputBufferDesc.channelFormat)
+                {
+                    case TensorKind::UInt8:
+                        CopyTensorFromBuffer<TKind, uint8_t>(actualData, tensorHeight, tensorWidth, inputBufferDesc,
+                                                             scale, means, stddevs);
+                        break;
+                    case TensorKind::Float:
+                        CopyTensorFromBuffer<TKind, float>(actualData, tensorHeight, tensorWidth, inputBufferDesc,
+                                                           scale, means, stddevs);
+                        break;
+                    default:
+                        throw hresult_not_implemented(
+                            L"Creating Tensors for Input Images with unhandled channel format!");
+                }
             }
         }
         // Garbage Data
@@ -607,9 +689,10 @@ namespace BindingUtilities
         }
     }
 
-    // Process the descriptor to gather and normalize the shape
+    // Process the descriptor to gather and normalize the shape. A free leading dimension becomes batchSize, the other
+    // free dimensions 1.
     void ProcessDescriptor(const ILearningModelFeatureDescriptor& description, std::vector<int64_t>& shape,
-                           TensorKind& tensorKind, InputBufferDesc& inputBufferDesc)
+                           TensorKind& tensorKind, InputBufferDesc& inputBufferDesc, uint32_t batchSize = 1)
     {
         // Try Image Feature Descriptor
         auto imageFeatureDescriptor = description.try_as<ImageFeatureDescriptor>();
@@ -656,7 +739,7 @@ namespace BindingUtilities
                 {
                     if (dimSize == -1)
                     {
-                        shape.push_back(1);
+                        shape.push_back(dim == 0 ? batchSize : 1);
                     }
                     else
                     {
@@ -683,7 +766,7 @@ namespace BindingUtilities
 
         std::vector<int64_t> shape = {};
         TensorKind tensorKind = TensorKind::Undefined;
-        ProcessDescriptor(description, shape, tensorKind, inputBufferDesc);
+        ProcessDescriptor(description, shape, tensorKind, inputBufferDesc, args.BatchSize());
 
         SoftwareBitmap softwareBitmap(nullptr);
         if (args.IsCSVInput())
@@ -716,6 +799,7 @@ namespace BindingUtilities
             auto sbByteAccess = sbReference.as<::Windows::Foundation::IMemoryBufferByteAccess>();
             winrt::check_hresult(sbByteAccess->GetBuffer(&inputBufferDesc.elements, &inputBufferDesc.totalSizeInBytes));
 
+            inputBufferDesc.rowPitchInBytes = static_cast<uint32_t>(sbBitmapBuffer.GetPlaneDescription(0).Stride);
             inputBufferDesc.isPlanar = false;
             inputBufferDesc.elementFormat = softwareBitmap.BitmapPixelFormat();
             switch (inputBufferDesc.elementFormat)
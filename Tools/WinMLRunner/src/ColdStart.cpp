@@ -0,0 +1,277 @@
+#include <filesystem>
+#include <iomanip>
+#include <map>
+
+#include "Windows.h"
+#include "common.h"
+#include "Scenarios.h"
+#include "StartupTimings.h"
+
+// Options of the harness itself, and the ones each launch gets its own value of, with the number of values each takes.
+// Every other option of the command line is passed on to the launches.
+static const std::map<std::wstring, int> ColdStartOptions = {
+    { L"-coldstart", 1 }, { L"-evictmodel", 0 }, { L"-startupreport", 1 },
+    { L"-iterations", 1 }, { L"-perfoutput", -1 }, { L"-isolate", 0 },
+};
+
+// What a launch's time to first result splits into. The last two are the time left over and the total.
+static const char* PhaseNames[] = { "process start", "runtime DLL load", "device creation", "COM apartment init",
+                                    "model load",    "session creation", "first bind",      "first evaluate",
+                                    "other",         "time to first result" };
+static const size_t PhaseCount = sizeof(PhaseNames) / sizeof(PhaseNames[0]);
+
+struct Launch
+{
+    bool Evicted = false;
+    double Phases[PhaseCount] = {};
+};
+
+// The SeProfileSingleProcessPrivilege purging the standby list needs is only held by elevated processes, and has to be
+// enabled before use. Returns whether it is.
+static bool EnableStandbyListPurge()
+{
+    HANDLE token = nullptr;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+    {
+        return false;
+    }
+    winrt::handle tokenHandle(token);
+    TOKEN_PRIVILEGES privileges = {};
+    privileges.PrivilegeCount = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    if (!LookupPrivilegeValueW(nullptr, SE_PROF_SINGLE_PROCESS_NAME, &privileges.Privileges[0].Luid))
+    {
+        return false;
+    }
+    // Succeeds without enabling anything when the token lacks the privilege.
+    return AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+           GetLastError() != ERROR_NOT_ALL_ASSIGNED;
+}
+
+// Empties the standby list, the pages of the file cache no process has mapped, as dropping the caches does elsewhere.
+// NtSetSystemInformation is not in the SDK's import libraries, so it is looked up in ntdll.
+static bool PurgeStandbyList()
+{
+    using NtSetSystemInformationFunction = LONG(WINAPI*)(INT, PVOID, ULONG);
+    auto setSystemInformation = reinterpret_cast<NtSetSystemInformationFunction>(
+        GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtSetSystemInformation"));
+    if (setSystemInformation == nullptr)
+    {
+        return false;
+    }
+    // SystemMemoryListInformation and MemoryPurgeStandbyList.
+    const INT systemMemoryListInformation = 80;
+    INT command = 4;
+    return setSystemInformation(systemMemoryListInformation, &command, sizeof(command)) >= 0;
+}
+
+// Drops the cached pages of the file at path, as posix_fadvise(POSIX_FADV_DONTNEED) does elsewhere: the file system
+// flushes and purges the cache of a file opened without buffering while no other handle or mapping holds it.
+static void EvictFile(const std::wstring& path, bool purge_standby_list)
+{
+    winrt::file_handle file(CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                                        OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr));
+    if (!file)
+    {
+        winrt::throw_last_error();
+    }
+    file.close();
+    if (purge_standby_list && !PurgeStandbyList())
+    {
+        std::cout << "Purging the standby list failed; only the model file was evicted." << std::endl;
+    }
+}
+
+// The "<name> <value>" lines WriteStartupReport wrote to path.
+static std::map<std::string, std::string> ReadStartupReport(const std::filesystem::path& path)
+{
+    std::map<std::string, std::string> values;
+    std::ifstream report(path);
+    std::string name;
+    std::string value;
+    while (report >> name >> value)
+    {
+        values[name] = value;
+    }
+    return values;
+}
+
+// Starts command_line with its console output going to log_path and waits for it to exit. Returns the time it was
+// started, in GetSystemTimePreciseAsFileTime units, or 0 when it failed or ran longer than timeout_seconds.
+static uint64_t RunLaunch(const std::wstring& command_line, const std::filesystem::path& log_path,
+                          unsigned timeout_seconds, DWORD& exit_code)
+{
+    SECURITY_ATTRIBUTES inheritable = { sizeof(inheritable), nullptr, TRUE };
+    winrt::file_handle log(CreateFileW(log_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &inheritable, CREATE_ALWAYS,
+                                       FILE_ATTRIBUTE_NORMAL, nullptr));
+    if (!log)
+    {
+        winrt::throw_last_error();
+    }
+    STARTUPINFOW startupInfo = {};
+    startupInfo.cb = sizeof(startupInfo);
+    startupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startupInfo.hStdOutput = log.get();
+    startupInfo.hStdError = log.get();
+    PROCESS_INFORMATION processInfo = {};
+    std::wstring commandLine = command_line;
+    uint64_t launched = StartupTimings::Now();
+    winrt::check_bool(CreateProcessW(nullptr, &commandLine[0], nullptr, nullptr, TRUE, CREATE_NO_WINDOW, nullptr,
+                                     nullptr, &startupInfo, &processInfo));
+    winrt::handle process(processInfo.hProcess);
+    winrt::handle thread(processInfo.hThread);
+    if (WaitForSingleObject(process.get(), timeout_seconds * 1000) != WAIT_OBJECT_0)
+    {
+        TerminateProcess(process.get(), 1);
+        WaitForSingleObject(process.get(), INFINITE);
+        exit_code = WAIT_TIMEOUT;
+        return 0;
+    }
+    GetExitCodeProcess(process.get(), &exit_code);
+    return exit_code == 0 ? launched : 0;
+}
+
+static void PrintSummary(const std::vector<Launch>& launches, bool evicted, const char* title)
+{
+    std::vector<std::vector<double>> phases(PhaseCount);
+    for (const auto& launch : launches)
+    {
+        if (launch.Evicted != evicted)
+        {
+            continue;
+        }
+        for (size_t phase = 0; phase < PhaseCount; phase++)
+        {
+            phases[phase].push_back(launch.Phases[phase]);
+        }
+    }
+    if (phases[0].empty())
+    {
+        return;
+    }
+    std::cout << title << ", median [min, max] of " << phases[0].size() << " launches in ms:" << std::endl;
+    for (size_t phase = 0; phase < PhaseCount; phase++)
+    {
+        std::vector<double>& values = phases[phase];
+        std::sort(values.begin(), values.end());
+        std::cout << "  " << std::left << std::setw(22) << PhaseNames[phase] << std::right << std::fixed
+                  << std::setprecision(1) << std::setw(9) << values[values.size() / 2] << " [" << values.front()
+                  << ", " << values.back() << "]" << std::defaultfloat << std::endl;
+    }
+}
+
+int MeasureColdStarts(const std::wstring& path, unsigned launches, bool evict_model,
+                      const std::wstring& perf_output_path, unsigned timeout_seconds)
+{
+    wchar_t executable[MAX_PATH] = {};
+    GetModuleFileNameW(nullptr, executable, MAX_PATH);
+    std::wstring baseCommandLine = QuoteArgument(executable);
+    for (const auto& argument : ChildArguments(ColdStartOptions))
+    {
+        baseCommandLine += L" " + QuoteArgument(argument);
+    }
+    baseCommandLine += L" -Iterations 1";
+    std::filesystem::path workDirectory =
+        std::filesystem::temp_directory_path() / (L"WinMLRunnerColdStart_" + std::to_wstring(GetCurrentProcessId()));
+    std::filesystem::create_directories(workDirectory);
+
+    bool purgeStandbyList = false;
+    if (evict_model)
+    {
+        purgeStandbyList = EnableStandbyListPurge();
+        std::cout << (purgeStandbyList ? "Evicting the model and purging the standby list before each cold launch."
+                                       : "Evicting the model before each cold launch. Run elevated to purge the "
+                                         "standby list too, dropping the runtime DLLs from the cache as well.")
+                  << std::endl;
+    }
+
+    std::ofstream csv;
+    if (!perf_output_path.empty())
+    {
+        bool writeHeader =
+            !std::filesystem::exists(perf_output_path) || std::filesystem::file_size(perf_output_path) == 0;
+        csv.open(std::filesystem::path(perf_output_path), std::ios::app);
+        if (writeHeader)
+        {
+            csv << "model,launch,model cache";
+            for (const char* phase : PhaseNames)
+            {
+                csv << "," << phase << " (ms)";
+            }
+            csv << std::endl;
+        }
+    }
+
+    std::string modelName = std::filesystem::path(path).filename().string();
+    std::vector<Launch> measured;
+    unsigned failures = 0;
+    unsigned number = 0;
+    for (unsigned i = 0; i < launches; i++)
+    {
+        // Without eviction only the first launch may find the model uncached.
+        for (int warm = evict_model ? 0 : 1; warm < 2; warm++)
+        {
+            number++;
+            Launch launch;
+            launch.Evicted = !warm;
+            if (launch.Evicted)
+            {
+                EvictFile(path, purgeStandbyList);
+            }
+            std::filesystem::path reportPath = workDirectory / (L"launch" + std::to_wstring(number) + L".txt");
+            std::filesystem::path logPath = workDirectory / (L"launch" + std::to_wstring(number) + L".log");
+            std::filesystem::remove(reportPath);
+            DWORD exitCode = 0;
+            uint64_t launched = RunLaunch(baseCommandLine + L" -StartupReport " + QuoteArgument(reportPath.wstring()),
+                                          logPath, timeout_seconds, exitCode);
+            std::map<std::string, std::string> report = ReadStartupReport(reportPath);
+            if (launched == 0 || report.count("first_result") == 0 || std::stoull(report["first_result"]) == 0)
+            {
+                std::cout << "Launch " << number << " [FAILED]: exit code 0x" << std::hex << exitCode << std::dec
+                          << std::endl;
+                std::wcout << L"  See " << logPath.wstring() << std::endl;
+                failures++;
+                continue;
+            }
+            static const char* reported[] = { "runtime_load_ms", "device_creation_ms", "apartment_init_ms",
+                                              "model_load_ms",   "session_creation_ms", "first_bind_ms",
+                                              "first_evaluate_ms" };
+            launch.Phases[0] = (std::stoull(report["main_entered"]) - launched) / 10000.0;
+            launch.Phases[PhaseCount - 1] = (std::stoull(report["first_result"]) - launched) / 10000.0;
+            double accounted = launch.Phases[0];
+            for (size_t phase = 1; phase <= _countof(reported); phase++)
+            {
+                launch.Phases[phase] = std::stod(report[reported[phase - 1]]);
+                accounted += launch.Phases[phase];
+            }
+            launch.Phases[PhaseCount - 2] = launch.Phases[PhaseCount - 1] - accounted;
+
+            std::cout << "Launch " << number << (launch.Evicted ? " (model evicted): " : ": ") << std::fixed
+                      << std::setprecision(1) << launch.Phases[PhaseCount - 1] << " ms to first result =";
+            for (size_t phase = 0; phase < PhaseCount - 1; phase++)
+            {
+                std::cout << (phase == 0 ? " " : " + ") << PhaseNames[phase] << " " << launch.Phases[phase];
+            }
+            std::cout << std::defaultfloat << std::endl;
+            if (csv.is_open())
+            {
+                csv << modelName << "," << number << "," << (launch.Evicted ? "evicted" : "cached");
+                for (double value : launch.Phases)
+                {
+                    csv << "," << value;
+                }
+                csv << std::endl;
+            }
+            measured.push_back(launch);
+        }
+    }
+
+    std::cout << std::endl;
+    PrintSummary(measured, true, "Cold starts, model evicted");
+    PrintSummary(measured, false, evict_model ? "Warm starts, model cached" : "Starts");
+    if (failures == 0)
+    {
+        std::filesystem::remove_all(workDirectory);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -44,7 +44,14 @@ void CommandLineArgs::PrintUsage()
     std::cout << "  -Perf [all]: capture performance measurements such as timing and memory usage. Specifying \"all\" "
                  "will output all measurements"
               << std::endl;
+    std::cout << "  -TrackAllocations : count the heap allocations made during each measured load, session creation, "
+                 "bind and evaluate: allocations, bytes and frees per call, peak live bytes and the call sites of one "
+                 "in 16 allocations. Implies -Perf"
+              << std::endl;
     std::cout << "  -Iterations : # times perf measurements will be run/averaged. (maximum: 1024 times)" << std::endl;
+    std::cout << "  -BatchSize <number> : evaluate batches of this size, overriding the free batch dimension of the "
+                 "model (default: 1). Needs random tensor input"
+              << std::endl;
     std::cout << "  -Input <path to input file>: binds image or CSV to model" << std::endl;
     std::cout << "  -InputImageFolder <path to directory of images> : specify folder of images to bind to model"
               << std::endl;
@@ -55,6 +62,10 @@ void CommandLineArgs::PrintUsage()
     std::cout << "  -PerfOutput [<path>] : fully qualified or relative path including csv filename for perf results"
               << std::endl;
     std::cout << "  -SavePerIterationPerf : save per iteration performance results to csv file" << std::endl;
+    std::cout << "  -SchedulingTelemetry : add the context switches, page faults and CPUs of each evaluate to the per "
+                 "iteration results, and print how the slow iterations differ from the others. Implies "
+                 "-SavePerIterationPerf"
+              << std::endl;
     std::cout << "  -PerIterationPath <directory_path> : Relative or fully qualified path for per iteration and save "
                  "tensor output results.  If not specified a default(timestamped) folder will be created."
               << std::endl;
@@ -67,6 +78,66 @@ void CommandLineArgs::PrintUsage()
     std::cout << "  -AutoScale <interpolationMode> : Enable image autoscaling and set the interpolation mode [Nearest, "
                  "Linear, Cubic, Fant]"
               << std::endl;
+    std::cout << "  -LoadMode <loadMode> : how the model file is handed to WinML [path (default), stream, mmap]. "
+                 "stream copies the file into an in-memory stream, mmap loads from a stream over a read-only memory "
+                 "mapping of the file. Use with -Perf to compare load time and peak working set"
+              << std::endl;
+    std::cout << "  -PrefetchModel : with -LoadMode mmap, read the whole mapping from disk before loading" << std::endl;
+    std::cout << "  -InspectOnly : print model metadata, inputs, outputs, operator counts, element types, the largest "
+                 "initializers and the FLOPs of the heaviest nodes straight from the .onnx file, without loading the "
+                 "model"
+              << std::endl;
+    std::cout << "  -ConvertToFP16 <output.onnx> : write an fp16 copy of the model, converting float weights and "
+                 "values to float16 and keeping the operators of -FP16KeepOps in fp32 behind Casts, then exit"
+              << std::endl;
+    std::cout << "  -FP16KeepOps <op,op,...> : with -ConvertToFP16, more operators to keep in fp32 in addition to "
+                 "NonMaxSuppression, TopK, RoiAlign, Resize, Upsample, Range, CumSum, the random generators and the "
+                 "quantization operators"
+              << std::endl;
+    std::cout << "  -FP16KeepIOTypes : with -ConvertToFP16, keep float inputs and outputs fp32 so that callers bind "
+                 "the same types"
+              << std::endl;
+    std::cout << "  -CompareOutputs : with -ConvertToFP16, evaluate both models on each selected device with the "
+                 "same -Input <csv file> or random input and report the error and top -TopK agreement of every "
+                 "output"
+              << std::endl;
+    std::cout << "  -Quantize <output.onnx> : calibrate the model on the samples of -Calibrate, write an int8 QDQ "
+                 "copy of it quantizing Conv, MatMul and Gemm, then compare the top-1 result and evaluation time of "
+                 "both models on every sample with the reference CPU backend and on each selected device"
+              << std::endl;
+    std::cout << "  -Calibrate <folder> : with -Quantize, the calibration set: .csv and .npy files holding the "
+                 "values of the single model input, and .png, .jpg and .bmp images tensorized as -Input binds them "
+                 "with -Tensor, -RGB or -BGR, scaled to the input with -AutoScale"
+              << std::endl;
+    std::cout << "  -CalibrationMethod <method> : with -Quantize, how activation ranges are chosen [MinMax (default), "
+                 "Percentile [<percent>] (default 99.999), Entropy]"
+              << std::endl;
+    std::cout << "  -PerTensor : with -Quantize, one scale per weight tensor instead of one per output channel "
+                 "(per channel needs opset 13)"
+              << std::endl;
+    std::cout << "  -ExternalData <output.onnx> [<min size in KB>] : move every initializer of at least the size "
+                 "(default: 64) into <output.onnx>.data at 64 KB aligned offsets, write the remaining graph to "
+                 "<output.onnx>, then report the memory it takes to copy or to map the weights of both models, "
+                 "and exit"
+              << std::endl;
+    std::cout << "  -SyntheticModel <output.onnx> <size in MB> : write a chain of MatMuls with the given size of "
+                 "weights, all of them external data, report the memory it takes to copy or to map them, and exit"
+              << std::endl;
+    std::cout << "  -ModelCache [<size in MB>] : load models through a process-wide cache shared by all loads and "
+                 "threads, evicting unused models once the cached model files exceed the size (default: 1024). "
+                 "Cold load and cache hit latencies are reported separately"
+              << std::endl;
+    std::cout << "  -Backend <backend> : run the model through the portable InferenceBackend interface instead of the "
+                 "usual pipeline [WinML, Reference, ReferenceNaive]. WinML runs on each selected device, Reference is "
+                 "a portable C++ CPU executor for checking outputs that also reports time and GFLOP/s per layer, "
+                 "ReferenceNaive runs it without im2col/GEMM convolution, fusion or buffer sharing. Uses -Input "
+                 "<csv file>, -Iterations, -TopK and -SaveTensorData"
+              << std::endl;
+    std::cout << "  -ScenarioFile <file.json> : run every scenario of the file in this process instead of -model or "
+                 "-folder. Each scenario names its model, device, input, binding, input type, batch size, iterations "
+                 "and intra-op thread count; models are loaded and devices created once for all of them, and "
+                 "-PerfOutput rows carry the id of their scenario"
+              << std::endl;
     std::cout << std::endl;
     std::cout << "Concurrency Options:" << std::endl;
     std::cout << "  -ConcurrentLoad: load models concurrently" << std::endl;
@@ -75,6 +146,109 @@ void CommandLineArgs::PrintUsage()
               << std::endl;
     std::cout << "  -ThreadInterval <milliseconds>: interval time between two thread creations in milliseconds"
               << std::endl;
+    std::cout << "  -MaxParallelScenarios <number>: run up to this many model/device/input configurations at once. "
+                 "Console output and perf results are still written in configuration order (default: 1)"
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Isolation Options:" << std::endl;
+    std::cout << "  -Isolate: run each model of -folder, or each scenario of -ScenarioFile, in a WinMLRunner child "
+                 "process of its own, so that a model crashing or hanging fails only itself. Each child's console "
+                 "output goes to <journal>.logs, its perf results are appended to -PerfOutput when it finishes and "
+                 "its outcome to the journal. Rerunning the same command skips everything the journal lists"
+              << std::endl;
+    std::cout << "  -Journal <path>: append-only log of the finished children, read back to resume a sweep "
+                 "(default: <PerfOutput>.journal, so -Isolate needs -Journal or -PerfOutput)"
+              << std::endl;
+    std::cout << "  -MaxChildren <number>: most children running at once (default: 1)" << std::endl;
+    std::cout << "  -ChildTimeout <seconds>: kill a child running longer than this (default: 600)" << std::endl;
+    std::cout << "  -ChildMemoryLimit <MB>: most memory a child may commit; further children only start while this "
+                 "much physical memory is available (default: no limit)"
+              << std::endl;
+    std::cout << "  -OnlyScenario <id>: run only the scenario of -ScenarioFile with this id" << std::endl;
+    std::cout << "  -MachinePeak <threads> <GFLOP/s> <GB/s>: use this CPU peak instead of measuring it, as -Isolate "
+                 "passes to its children"
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Cold Start Options:" << std::endl;
+    std::cout << "  -ColdStart <launches>: start a fresh WinMLRunner process this many times to evaluate -model once "
+                 "and break the time to its first result down into process start, runtime DLL load, device creation, "
+                 "COM apartment init, model load, session creation, first bind and first evaluate. -PerfOutput gets "
+                 "a row per launch"
+              << std::endl;
+    std::cout << "  -EvictModel: drop the model from the file cache before each launch, and follow each with a launch "
+                 "that finds it cached, to compare cold and warm starts"
+              << std::endl;
+    std::cout << "  -StartupReport <path>: write the startup milestones of this process to path after the first "
+                 "result, as each -ColdStart launch does"
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Environment Check Options:" << std::endl;
+    std::cout << "  -CheckEnvironment: measure the system load before the run, sample the CPU clock during each "
+                 "measured load, session creation, bind and evaluate to find throttling and frequency transitions, "
+                 "and note in -PerfOutput the CPU, power plan, cores and SMT of the machine and whether the run "
+                 "deviated. Implies -Perf"
+              << std::endl;
+    std::cout << "  -MaxSystemLoad <percent>: with -CheckEnvironment, the busiest the machine may be before the run "
+                 "(default: 10)"
+              << std::endl;
+    std::cout << "  -MaxClockDrift <percent>: with -CheckEnvironment, how far the clock may move from the one measured "
+                 "before the run (default: 10)"
+              << std::endl;
+    std::cout << "  -RejectNoisyRuns: with -CheckEnvironment, exit without running when the machine is busy and leave "
+                 "the configurations whose environment deviated out of -PerfOutput, instead of noting the deviation"
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Micro-batching Options:" << std::endl;
+    std::cout << "  -MicroBatching: serve single-example requests from concurrent clients through a dynamic batching "
+                 "scheduler and compare throughput and latency against batch size 1. Requires a single float tensor "
+                 "input with a free batch dimension"
+              << std::endl;
+    std::cout << "  -MaxBatchSize <number>: largest batch the scheduler will form (default: 8)" << std::endl;
+    std::cout << "  -MaxBatchWait <milliseconds>: longest time a request waits for others to join its batch "
+                 "(default: 2)"
+              << std::endl;
+    std::cout << "  -Clients <number>: number of concurrent clients (default: 8)" << std::endl;
+    std::cout << "  -Requests <number>: number of requests each client sends (default: 100)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Async Evaluation Options:" << std::endl;
+    std::cout << "  -AsyncEvaluate: keep several EvaluateAsync calls in flight over a pool of bindings and compare "
+                 "throughput and latency against synchronous Evaluate. Requires float tensor inputs. -Requests sets "
+                 "the number of evaluations"
+              << std::endl;
+    std::cout << "  -MaxInFlight <number>: most evaluations in flight at once; depths 1, 2, 4, ... up to this are "
+                 "measured (default: 4)"
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Shared Memory Input Options:" << std::endl;
+    std::cout << "  -SharedMemoryInput: stream inputs from a producer process through a shared memory ring of tensor "
+                 "slots bound in place, and compare throughput and latency against handing each input over through a "
+                 "file. Requires a single float tensor input. -Requests sets the number of inputs"
+              << std::endl;
+    std::cout << "  -RingSlots <number>: number of tensor slots in the ring (default: 4)" << std::endl;
+    std::cout << "  -RingProducer <name>: run as a test producer that publishes -Requests tensors into the ring called "
+                 "<name>"
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Scale-out Options:" << std::endl;
+    std::cout << "  -ScaleOut <workers>: run -model in this many WinMLRunner worker processes, each pinned to its own "
+                 "equal share of the physical cores, first one at a time and then all together, released at once "
+                 "through a shared memory barrier. Prints each worker's throughput, latency and slowdown against its "
+                 "solo run, and the total throughput and combined percentiles. Requires float tensor inputs. "
+                 "-Requests sets the evaluations per worker, -PerfOutput gets a row per worker and run"
+              << std::endl;
+    std::cout << "  -ScaleOutWorker <name> <index>: run as worker <index> of the -ScaleOut coordinator whose shared "
+                 "memory section is called <name>"
+              << std::endl;
+    std::cout << std::endl;
+    std::cout << "Inference Server Options:" << std::endl;
+    std::cout << "  -Serve <name>: load the model once and answer inference requests on the named pipe "
+                 "\\\\.\\pipe\\<name>, batching concurrent requests per device. -MaxBatchSize and -MaxBatchWait "
+                 "configure batching. Requires a single float tensor input with a free batch dimension"
+              << std::endl;
+    std::cout << "  -Connect <name>: run a load client against the server on the named pipe <name> with -Clients "
+                 "closed-loop clients sending -Requests requests each, then print client and server statistics"
+              << std::endl;
+    std::cout << "  -StopServer: with -Connect, ask the server to shut down when the load run is done" << std::endl;
 }
 
 void CheckAPICall(int return_value)
@@ -237,6 +411,11 @@ CommandLineArgs::CommandLineArgs(const std::vector<std::wstring>& args)
             }
             m_perfCapture = true;
         }
+        else if ((_wcsicmp(args[i].c_str(), L"-TrackAllocations") == 0))
+        {
+            m_trackAllocations = true;
+            m_perfCapture = true;
+        }
         else if ((_wcsicmp(args[i].c_str(), L"-DebugEvaluate") == 0))
         {
             if (!IsDebuggerPresent())
@@ -250,6 +429,12 @@ CommandLineArgs::CommandLineArgs(const std::vector<std::wstring>& args)
         {
             m_perIterCapture = true;
         }
+        else if ((_wcsicmp(args[i].c_str(), L"-SchedulingTelemetry") == 0))
+        {
+            m_schedulingTelemetry = true;
+            m_perIterCapture = true;
+            m_perfCapture = true;
+        }
         else if (_wcsicmp(args[i].c_str(), L"-BaseOutputPath") == 0)
         {
             CheckNextArgument(args, i);
@@ -290,6 +475,158 @@ CommandLineArgs::CommandLineArgs(const std::vector<std::wstring>& args)
                 throw hresult_invalid_argument(L"Unknown AutoScale Interpolation Mode!");
             }
         }
+        else if ((_wcsicmp(args[i].c_str(), L"-LoadMode") == 0))
+        {
+            CheckNextArgument(args, i);
+            if (_wcsicmp(args[++i].c_str(), L"path") == 0)
+            {
+                m_loadMode = ModelSource::LoadMode::Path;
+            }
+            else if (_wcsicmp(args[i].c_str(), L"stream") == 0)
+            {
+                m_loadMode = ModelSource::LoadMode::Stream;
+            }
+            else if (_wcsicmp(args[i].c_str(), L"mmap") == 0)
+            {
+                m_loadMode = ModelSource::LoadMode::MemoryMap;
+            }
+            else
+            {
+                PrintUsage();
+                throw hresult_invalid_argument(L"Unknown Load Mode!");
+            }
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-Backend") == 0))
+        {
+            CheckNextArgument(args, i);
+            if (_wcsicmp(args[++i].c_str(), L"WinML") == 0)
+            {
+                m_backend = BackendType::WinML;
+            }
+            else if (_wcsicmp(args[i].c_str(), L"Reference") == 0)
+            {
+                m_backend = BackendType::Reference;
+            }
+            else if (_wcsicmp(args[i].c_str(), L"ReferenceNaive") == 0)
+            {
+                m_backend = BackendType::ReferenceNaive;
+            }
+            else
+            {
+                PrintUsage();
+                throw hresult_invalid_argument(L"Unknown Backend!");
+            }
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-PrefetchModel") == 0))
+        {
+            m_prefetchModel = true;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-InspectOnly") == 0))
+        {
+            m_inspectOnly = true;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-ConvertToFP16") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_float16OutputPath = args[++i];
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-FP16KeepOps") == 0))
+        {
+            CheckNextArgument(args, i);
+            std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+            std::istringstream ops(converter.to_bytes(args[++i]));
+            std::string op;
+            while (std::getline(ops, op, ','))
+            {
+                m_float16KeepOps.push_back(op);
+            }
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-FP16KeepIOTypes") == 0))
+        {
+            m_float16KeepIOTypes = true;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-CompareOutputs") == 0))
+        {
+            m_compareOutputs = true;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-Quantize") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_quantizedOutputPath = args[++i];
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-Calibrate") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_calibrationPath = args[++i];
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-CalibrationMethod") == 0))
+        {
+            CheckNextArgument(args, i);
+            if (_wcsicmp(args[++i].c_str(), L"MinMax") == 0)
+            {
+                m_quantizationOptions.method = Onnx::CalibrationMethod::MinMax;
+            }
+            else if (_wcsicmp(args[i].c_str(), L"Percentile") == 0)
+            {
+                m_quantizationOptions.method = Onnx::CalibrationMethod::Percentile;
+                if (i + 1 < args.size() && args[i + 1][0] != L'-')
+                {
+                    m_quantizationOptions.percentile = std::stod(args[++i]);
+                }
+            }
+            else if (_wcsicmp(args[i].c_str(), L"Entropy") == 0)
+            {
+                m_quantizationOptions.method = Onnx::CalibrationMethod::Entropy;
+            }
+            else
+            {
+                PrintUsage();
+                throw hresult_invalid_argument(L"Unknown Calibration Method!");
+            }
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-PerTensor") == 0))
+        {
+            m_quantizationOptions.perChannel = false;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-ExternalData") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_externalDataOutputPath = args[++i];
+            if (i + 1 < args.size() && args[i + 1][0] != L'-')
+            {
+                m_externalDataOptions.minBytes = std::stoull(args[++i]) * 1024;
+            }
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-SyntheticModel") == 0))
+        {
+            CheckNextArgument(args, i);
+            CheckNextArgument(args, i, i + 2);
+            m_syntheticModelPath = args[++i];
+            m_syntheticModelSizeMB = std::stoull(args[++i]);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-ScenarioFile") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_scenarioFilePath = FileHelper::GetAbsolutePath(args[++i]);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-BatchSize") == 0))
+        {
+            CheckNextArgument(args, i);
+            unsigned batch_size = std::stoi(args[++i].c_str());
+            if (batch_size == 0)
+            {
+                throw hresult_invalid_argument(L"-BatchSize must be at least 1.");
+            }
+            SetBatchSize(batch_size);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-ModelCache") == 0))
+        {
+            m_modelCache = true;
+            if (i + 1 < args.size() && args[i + 1][0] != L'-')
+            {
+                m_modelCacheSizeMB = std::stoul(args[++i].c_str());
+            }
+        }
         else if (_wcsicmp(args[i].c_str(), L"-SaveTensorData") == 0)
         {
             CheckNextArgument(args, i);
@@ -359,6 +696,199 @@ CommandLineArgs::CommandLineArgs(const std::vector<std::wstring>& args)
             unsigned thread_interval = std::stoi(args[++i].c_str());
             SetThreadInterval(thread_interval);
         }
+        else if ((_wcsicmp(args[i].c_str(), L"-MaxParallelScenarios") == 0))
+        {
+            CheckNextArgument(args, i);
+            unsigned max_parallel_scenarios = std::stoi(args[++i].c_str());
+            if (max_parallel_scenarios == 0)
+            {
+                throw hresult_invalid_argument(L"-MaxParallelScenarios must be at least 1.");
+            }
+            SetMaxParallelScenarios(max_parallel_scenarios);
+        }
+        // isolation options
+        else if ((_wcsicmp(args[i].c_str(), L"-Isolate") == 0))
+        {
+            m_isolate = true;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-Journal") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_journalPath = FileHelper::GetAbsolutePath(args[++i]);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-MaxChildren") == 0))
+        {
+            CheckNextArgument(args, i);
+            unsigned max_children = std::stoi(args[++i].c_str());
+            if (max_children == 0 || max_children > MAXIMUM_WAIT_OBJECTS)
+            {
+                throw hresult_invalid_argument(L"-MaxChildren must be between 1 and 64.");
+            }
+            m_maxChildren = max_children;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-ChildTimeout") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_childTimeoutSeconds = std::stoul(args[++i].c_str());
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-ChildMemoryLimit") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_childMemoryLimitMB = std::stoull(args[++i].c_str());
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-MachinePeak") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_cpuPeakThreads = std::stoi(args[++i].c_str());
+            CheckNextArgument(args, i);
+            m_cpuPeakGflops = std::stod(args[++i].c_str());
+            CheckNextArgument(args, i);
+            m_cpuPeakGigabytesPerSecond = std::stod(args[++i].c_str());
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-OnlyScenario") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_onlyScenario = args[++i];
+        }
+        // cold start options
+        else if ((_wcsicmp(args[i].c_str(), L"-ColdStart") == 0))
+        {
+            CheckNextArgument(args, i);
+            unsigned launches = std::stoi(args[++i].c_str());
+            if (launches == 0)
+            {
+                throw hresult_invalid_argument(L"-ColdStart must be at least 1.");
+            }
+            m_coldStartLaunches = launches;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-EvictModel") == 0))
+        {
+            m_evictModel = true;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-StartupReport") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_startupReportPath = FileHelper::GetAbsolutePath(args[++i]);
+            // The report carries the first load, session creation, bind and evaluate times.
+            m_perfCapture = true;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-CheckEnvironment") == 0))
+        {
+            m_checkEnvironment = true;
+            m_perfCapture = true;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-MaxSystemLoad") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_maxSystemLoadPercent = std::stod(args[++i]);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-MaxClockDrift") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_maxClockDriftPercent = std::stod(args[++i]);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-RejectNoisyRuns") == 0))
+        {
+            m_rejectNoisyRuns = true;
+        }
+        // micro-batching options
+        else if ((_wcsicmp(args[i].c_str(), L"-MicroBatching") == 0))
+        {
+            ToggleMicroBatching(true);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-MaxBatchSize") == 0))
+        {
+            CheckNextArgument(args, i);
+            unsigned max_batch_size = std::stoi(args[++i].c_str());
+            if (max_batch_size == 0)
+            {
+                throw hresult_invalid_argument(L"-MaxBatchSize must be at least 1.");
+            }
+            SetMaxBatchSize(max_batch_size);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-MaxBatchWait") == 0))
+        {
+            CheckNextArgument(args, i);
+            SetMaxBatchWait(std::stod(args[++i].c_str()));
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-Clients") == 0))
+        {
+            CheckNextArgument(args, i);
+            SetNumClients(std::stoi(args[++i].c_str()));
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-Requests") == 0))
+        {
+            CheckNextArgument(args, i);
+            SetNumRequestsPerClient(std::stoi(args[++i].c_str()));
+        }
+        // async evaluation options
+        else if ((_wcsicmp(args[i].c_str(), L"-AsyncEvaluate") == 0))
+        {
+            ToggleAsyncEvaluate(true);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-MaxInFlight") == 0))
+        {
+            CheckNextArgument(args, i);
+            unsigned max_in_flight = std::stoi(args[++i].c_str());
+            if (max_in_flight == 0)
+            {
+                throw hresult_invalid_argument(L"-MaxInFlight must be at least 1.");
+            }
+            SetMaxInFlight(max_in_flight);
+        }
+        // shared memory input options
+        else if ((_wcsicmp(args[i].c_str(), L"-SharedMemoryInput") == 0))
+        {
+            ToggleSharedMemoryInput(true);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-RingSlots") == 0))
+        {
+            CheckNextArgument(args, i);
+            unsigned ring_slots = std::stoi(args[++i].c_str());
+            if (ring_slots == 0)
+            {
+                throw hresult_invalid_argument(L"-RingSlots must be at least 1.");
+            }
+            SetRingSlots(ring_slots);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-RingProducer") == 0))
+        {
+            CheckNextArgument(args, i);
+            SetRingProducerName(args[++i]);
+        }
+        // scale-out options
+        else if ((_wcsicmp(args[i].c_str(), L"-ScaleOut") == 0))
+        {
+            CheckNextArgument(args, i);
+            unsigned workers = std::stoi(args[++i].c_str());
+            if (workers == 0)
+            {
+                throw hresult_invalid_argument(L"-ScaleOut must be at least 1.");
+            }
+            m_scaleOutWorkers = workers;
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-ScaleOutWorker") == 0))
+        {
+            CheckNextArgument(args, i);
+            m_scaleOutSectionName = args[++i];
+            CheckNextArgument(args, i);
+            m_scaleOutWorkerIndex = std::stoi(args[++i].c_str());
+        }
+        // inference server options
+        else if ((_wcsicmp(args[i].c_str(), L"-Serve") == 0))
+        {
+            CheckNextArgument(args, i);
+            SetServePipeName(args[++i]);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-Connect") == 0))
+        {
+            CheckNextArgument(args, i);
+            SetConnectPipeName(args[++i]);
+        }
+        else if ((_wcsicmp(args[i].c_str(), L"-StopServer") == 0))
+        {
+            ToggleStopServer(true);
+        }
         else if ((_wcsicmp(args[i].c_str(), L"-TopK") == 0))
         {
             CheckNextArgument(args, i);
@@ -377,7 +907,72 @@ CommandLineArgs::CommandLineArgs(const std::vector<std::wstring>& args)
         }
     }
 
-    if (m_modelPath.empty() && m_modelFolderPath.empty())
+    if (!m_servePipeName.empty() && m_modelPath.empty())
+    {
+        throw hresult_invalid_argument(L"-Serve requires a model given with -model.");
+    }
+    if (!m_float16OutputPath.empty() && m_modelPath.empty())
+    {
+        throw hresult_invalid_argument(L"-ConvertToFP16 requires a model given with -model.");
+    }
+    if (!m_quantizedOutputPath.empty() && (m_modelPath.empty() || m_calibrationPath.empty()))
+    {
+        throw hresult_invalid_argument(L"-Quantize requires a model given with -model and a -Calibrate folder.");
+    }
+    if (!m_externalDataOutputPath.empty() && m_modelPath.empty())
+    {
+        throw hresult_invalid_argument(L"-ExternalData requires a model given with -model.");
+    }
+    if (m_coldStartLaunches > 0 && m_modelPath.empty())
+    {
+        throw hresult_invalid_argument(L"-ColdStart requires a model given with -model.");
+    }
+    if (m_scaleOutWorkers > 0 && m_modelPath.empty())
+    {
+        throw hresult_invalid_argument(L"-ScaleOut requires a model given with -model.");
+    }
+    if (m_rejectNoisyRuns && !m_checkEnvironment)
+    {
+        throw hresult_invalid_argument(L"-RejectNoisyRuns requires -CheckEnvironment.");
+    }
+    if (!m_scenarioFilePath.empty())
+    {
+        if (!m_modelPath.empty() || !m_modelFolderPath.empty())
+        {
+            throw hresult_invalid_argument(L"-ScenarioFile names its own models and cannot be used with -model or "
+                                           L"-folder.");
+        }
+        m_scenarios = LoadScenarioFile(m_scenarioFilePath);
+        if (!m_onlyScenario.empty())
+        {
+            auto only = std::find_if(m_scenarios.begin(), m_scenarios.end(), [this](const BenchmarkScenario& scenario) {
+                return scenario.Id == m_onlyScenario;
+            });
+            if (only == m_scenarios.end())
+            {
+                throw hresult_invalid_argument(L"-OnlyScenario: " + m_scenarioFilePath + L" has no scenario " +
+                                               m_onlyScenario);
+            }
+            m_scenarios = { *only };
+        }
+        // The results of the scenarios are what the file asks for.
+        m_perfCapture = true;
+        m_perfOutput = true;
+        // main creates the selected devices once, before any scenario runs.
+        for (const auto& scenario : m_scenarios)
+        {
+            m_useCPU = m_useCPU || scenario.Device == DeviceType::CPU;
+            m_useGPU = m_useGPU || scenario.Device == DeviceType::DefaultGPU;
+            m_useGPUHighPerformance = m_useGPUHighPerformance || scenario.Device == DeviceType::HighPerfGPU;
+            m_useGPUMinPower = m_useGPUMinPower || scenario.Device == DeviceType::MinPowerGPU;
+            m_createDeviceInWinML = m_createDeviceInWinML || scenario.DeviceCreation == DeviceCreationLocation::WinML;
+            m_createDeviceOnClient =
+                m_createDeviceOnClient || scenario.DeviceCreation == DeviceCreationLocation::UserD3DDevice;
+        }
+    }
+    // The helper processes of -Connect and -RingProducer, and -SyntheticModel, run without a model.
+    if (m_modelPath.empty() && m_modelFolderPath.empty() && m_connectPipeName.empty() && m_ringProducerName.empty() &&
+        m_syntheticModelPath.empty() && m_scenarioFilePath.empty())
     {
         std::cout << std::endl;
         PrintUsage();
@@ -407,7 +1002,22 @@ CommandLineArgs::CommandLineArgs(const std::vector<std::wstring>& args)
     {
         PopulateInputImagePaths();
     }
+    if (m_isolate && m_journalPath.empty() && sPerfOutputPath.empty())
+    {
+        // The default -PerfOutput path holds the time it was made at, so a rerun would never find the journal again.
+        throw hresult_invalid_argument(L"-Isolate requires -Journal or -PerfOutput, for the journal to be found on "
+                                       L"rerun.");
+    }
     SetupOutputDirectories(sBaseOutputPath, sPerfOutputPath, sPerIterationDataPath);
+    // So that rows loading the same model by path, stream and mapping can be told apart.
+    AddPerformanceFileMetadata("model load mode", TypeHelper::Stringify(m_loadMode) +
+                                                      (m_loadMode == ModelSource::LoadMode::MemoryMap && m_prefetchModel
+                                                           ? " prefetched"
+                                                           : ""));
+    if (m_journalPath.empty())
+    {
+        m_journalPath = m_perfOutputPath + L".journal";
+    }
 
     CheckForInvalidArguments();
 }
@@ -509,6 +1119,45 @@ void CommandLineArgs::CheckForInvalidArguments()
     {
         throw hresult_not_implemented(L"Saving tensor output for multiple images isn't implemented.");
     }
+    if (m_batchSize > 1 && (!IsGarbageInput() || UseRGB() || UseBGR()))
+    {
+        // Images and CSV files hold a single sample.
+        throw hresult_invalid_argument(L"-BatchSize needs random tensor input.");
+    }
+}
+
+void CommandLineArgs::ApplyScenario(const BenchmarkScenario& scenario)
+{
+    m_modelPath = scenario.ModelPath;
+    m_useCPU = scenario.Device == DeviceType::CPU;
+    m_useGPU = scenario.Device == DeviceType::DefaultGPU;
+    m_useGPUHighPerformance = scenario.Device == DeviceType::HighPerfGPU;
+    m_useGPUMinPower = scenario.Device == DeviceType::MinPowerGPU;
+    m_createDeviceInWinML = scenario.DeviceCreation == DeviceCreationLocation::WinML;
+    m_createDeviceOnClient = scenario.DeviceCreation == DeviceCreationLocation::UserD3DDevice;
+    m_useCPUBoundInput = scenario.Binding == InputBindingType::CPU;
+    m_useGPUBoundInput = scenario.Binding == InputBindingType::GPU;
+    m_useTensor = scenario.InputType == InputDataType::Tensor;
+    m_useRGB = scenario.InputType == InputDataType::ImageRGB;
+    m_useBGR = scenario.InputType == InputDataType::ImageBGR;
+    m_imagePaths.clear();
+    m_csvData.clear();
+    if (_wcsicmp(std::filesystem::path(scenario.InputPath).extension().c_str(), L".csv") == 0)
+    {
+        m_csvData = scenario.InputPath;
+    }
+    else if (!scenario.InputPath.empty())
+    {
+        m_imagePaths.push_back(scenario.InputPath);
+    }
+    m_batchSize = scenario.BatchSize;
+    m_intraOpNumThreads = scenario.Threads;
+    m_numIterations = scenario.Iterations;
+    m_numSessionIterations = 1;
+    AddPerformanceFileMetadata("scenario", std::string(scenario.Id.begin(), scenario.Id.end()));
+    AddPerformanceFileMetadata("batch size", std::to_string(scenario.BatchSize));
+    AddPerformanceFileMetadata("intra-op threads",
+                               scenario.Threads == 0 ? "default" : std::to_string(scenario.Threads));
 }
 
 std::vector<InputDataType> CommandLineArgs::FetchInputDataTypes()
@@ -1,5 +1,8 @@
 #pragma once
 #include "Common.h"
+#include "OnnxExternalData.h"
+#include "OnnxQuantizer.h"
+#include "ScenarioFile.h"
 
 enum TensorizeFuncs
 {
@@ -28,21 +31,65 @@ public:
     CommandLineArgs(const std::vector<std::wstring>& args);
     void PrintUsage();
     bool IsConcurrentLoad() const { return m_concurrentLoad; }
+    bool IsMicroBatching() const { return m_microBatching; }
+    bool IsAsyncEvaluate() const { return m_asyncEvaluate; }
+    bool IsSharedMemoryInput() const { return m_sharedMemoryInput; }
     bool IsUsingGPUHighPerformance() const { return m_useGPUHighPerformance; }
     bool IsUsingGPUMinPower() const { return m_useGPUMinPower; }
     bool UseBGR() const { return m_useBGR; }
     bool IsUsingGPUBoundInput() const { return m_useGPUBoundInput; }
     bool IsPerformanceCapture() const { return m_perfCapture; }
     bool IsPerformanceConsoleOutputVerbose() const { return m_perfConsoleOutputAll; }
+    bool IsTrackAllocations() const { return m_trackAllocations; }
     bool IsEvaluationDebugOutputEnabled() const { return m_evaluation_debug_output; }
     bool TerseOutput() const { return m_terseOutput; }
     bool IsPerIterationCapture() const { return m_perIterCapture; }
+    bool IsSchedulingTelemetry() const { return m_schedulingTelemetry; }
     bool IsCreateDeviceOnClient() const { return m_createDeviceOnClient; }
     bool IsAutoScale() const { return m_autoScale; }
     bool IsOutputPerf() const { return m_perfOutput; }
     bool IsSaveTensor() const { return m_saveTensor; }
     bool IsTimeLimitIterations() const { return m_timeLimitIterations; }
     BitmapInterpolationMode AutoScaleInterpMode() const { return m_autoScaleInterpMode; }
+    ModelSource::LoadMode LoadMode() const { return m_loadMode; }
+    bool IsPrefetchModel() const { return m_prefetchModel; }
+    bool IsModelCache() const { return m_modelCache; }
+    bool IsInspectOnly() const { return m_inspectOnly; }
+    const std::wstring& Float16OutputPath() const { return m_float16OutputPath; }
+    const std::vector<std::string>& Float16KeepOps() const { return m_float16KeepOps; }
+    bool IsFloat16KeepIOTypes() const { return m_float16KeepIOTypes; }
+    bool IsCompareOutputs() const { return m_compareOutputs; }
+    const std::wstring& QuantizedOutputPath() const { return m_quantizedOutputPath; }
+    const std::wstring& CalibrationPath() const { return m_calibrationPath; }
+    const Onnx::QuantizationOptions& QuantizationOptions() const { return m_quantizationOptions; }
+    const std::wstring& ExternalDataOutputPath() const { return m_externalDataOutputPath; }
+    const Onnx::ExternalDataOptions& ExternalDataOptions() const { return m_externalDataOptions; }
+    const std::wstring& SyntheticModelPath() const { return m_syntheticModelPath; }
+    uint64_t SyntheticModelSizeMB() const { return m_syntheticModelSizeMB; }
+    uint32_t ModelCacheSize() const { return m_modelCacheSizeMB; } // Cache capacity in MB
+    BackendType Backend() const { return m_backend; }
+    const std::wstring& ScenarioFilePath() const { return m_scenarioFilePath; }
+    const std::vector<BenchmarkScenario>& Scenarios() const { return m_scenarios; }
+    bool IsIsolate() const { return m_isolate; }
+    const std::wstring& JournalPath() const { return m_journalPath; }
+    uint32_t MaxChildren() const { return m_maxChildren; }
+    uint32_t ChildTimeout() const { return m_childTimeoutSeconds; } // Timeout in seconds
+    uint64_t ChildMemoryLimit() const { return m_childMemoryLimitMB; } // Limit in MB, 0 for none
+    // The CPU peak -MachinePeak gave, so that it is not measured again; 0 GFLOP/s when none was.
+    bool HasCpuPeak() const { return m_cpuPeakGflops > 0; }
+    uint32_t CpuPeakThreads() const { return m_cpuPeakThreads; }
+    double CpuPeakGflops() const { return m_cpuPeakGflops; }
+    double CpuPeakGigabytesPerSecond() const { return m_cpuPeakGigabytesPerSecond; }
+    uint32_t ColdStartLaunches() const { return m_coldStartLaunches; }
+    bool IsEvictModel() const { return m_evictModel; }
+    const std::wstring& StartupReportPath() const { return m_startupReportPath; }
+    bool IsCheckEnvironment() const { return m_checkEnvironment; }
+    double MaxSystemLoad() const { return m_maxSystemLoadPercent; } // Percent of all processors
+    double MaxClockDrift() const { return m_maxClockDriftPercent; } // Percent of the clock before the run
+    bool IsRejectNoisyRuns() const { return m_rejectNoisyRuns; }
+    uint32_t ScaleOutWorkers() const { return m_scaleOutWorkers; }
+    const std::wstring& ScaleOutSectionName() const { return m_scaleOutSectionName; }
+    uint32_t ScaleOutWorkerIndex() const { return m_scaleOutWorkerIndex; }
 
     const std::vector<std::wstring>& ImagePaths() const { return m_imagePaths; }
     const std::wstring& CsvPath() const { return m_csvData; }
@@ -98,11 +145,25 @@ public:
     bool IsImageInput() const { return !m_imagePaths.empty() && m_csvData.empty(); }
 
     uint32_t NumIterations() const { return m_numIterations; }
+    uint32_t BatchSize() const { return m_batchSize; }
+    // Threads a session runs one operator on, set by -ScenarioFile. 0 leaves WinML's default.
+    uint32_t IntraOpNumThreads() const { return m_intraOpNumThreads; }
     uint32_t NumLoadIterations() const { return m_numLoadIterations; }
     uint32_t NumSessionCreationIterations() const { return m_numSessionIterations; }
     double IterationTimeLimit() const { return m_iterationTimeLimitMilliseconds; }
     uint32_t NumThreads() const { return m_numThreads; }
     uint32_t ThreadInterval() const { return m_threadInterval; } // Thread interval in milliseconds
+    uint32_t MaxParallelScenarios() const { return m_maxParallelScenarios; }
+    uint32_t MaxBatchSize() const { return m_maxBatchSize; }
+    double MaxBatchWait() const { return m_maxBatchWaitMilliseconds; } // Batch wait in milliseconds
+    uint32_t NumClients() const { return m_numClients; }
+    uint32_t NumRequestsPerClient() const { return m_numRequestsPerClient; }
+    uint32_t MaxInFlight() const { return m_maxInFlight; }
+    uint32_t RingSlots() const { return m_ringSlots; }
+    const std::wstring& RingProducerName() const { return m_ringProducerName; }
+    const std::wstring& ServePipeName() const { return m_servePipeName; }
+    const std::wstring& ConnectPipeName() const { return m_connectPipeName; }
+    bool IsStopServer() const { return m_stopServer; }
     uint32_t TopK() const { return m_topK; }
     uint32_t GarbageDataMaxValue() const { return m_garbageDataMaxValue; }
     bool IsGarbageDataRange() const { return m_garbageDataMaxValue != 0; }
@@ -112,6 +173,9 @@ public:
     void ToggleGPUHighPerformance(bool useGPUHighPerformance) { m_useGPUHighPerformance = useGPUHighPerformance; }
     void ToggleUseGPUMinPower(bool useGPUMinPower) { m_useGPUMinPower = useGPUMinPower; }
     void ToggleConcurrentLoad(bool concurrentLoad) { m_concurrentLoad = concurrentLoad; }
+    void ToggleMicroBatching(bool microBatching) { m_microBatching = microBatching; }
+    void ToggleAsyncEvaluate(bool asyncEvaluate) { m_asyncEvaluate = asyncEvaluate; }
+    void ToggleSharedMemoryInput(bool sharedMemoryInput) { m_sharedMemoryInput = sharedMemoryInput; }
     void ToggleCreateDeviceOnClient(bool createDeviceOnClient) { m_createDeviceOnClient = createDeviceOnClient; }
     void ToggleCreateDeviceInWinML(bool createDeviceInWinML) { m_createDeviceInWinML = createDeviceInWinML; }
     void ToggleCPUBoundInput(bool useCPUBoundInput) { m_useCPUBoundInput = useCPUBoundInput; }
@@ -132,8 +196,26 @@ public:
         m_perIterationDataPath = perIterationDataPath;
     }
     void SetInputDataPath(const std::wstring& inputDataPath) { m_inputData = inputDataPath; }
+    // Binds the image at imagePath instead of any -Input, as a -Input image would be after parsing.
+    void SetImagePath(const std::wstring& imagePath)
+    {
+        m_imagePaths = { imagePath };
+        m_csvData.clear();
+    }
     void SetNumThreads(unsigned numThreads) { m_numThreads = numThreads; }
     void SetThreadInterval(unsigned threadInterval) { m_threadInterval = threadInterval; }
+    void SetMaxParallelScenarios(unsigned maxParallelScenarios) { m_maxParallelScenarios = maxParallelScenarios; }
+    void SetMaxBatchSize(unsigned maxBatchSize) { m_maxBatchSize = maxBatchSize; }
+    void SetBatchSize(unsigned batchSize) { m_batchSize = batchSize; }
+    void SetMaxBatchWait(double milliseconds) { m_maxBatchWaitMilliseconds = milliseconds; }
+    void SetNumClients(unsigned numClients) { m_numClients = numClients; }
+    void SetNumRequestsPerClient(unsigned numRequests) { m_numRequestsPerClient = numRequests; }
+    void SetMaxInFlight(unsigned maxInFlight) { m_maxInFlight = maxInFlight; }
+    void SetRingSlots(unsigned ringSlots) { m_ringSlots = ringSlots; }
+    void SetRingProducerName(const std::wstring& name) { m_ringProducerName = name; }
+    void SetServePipeName(const std::wstring& name) { m_servePipeName = name; }
+    void SetConnectPipeName(const std::wstring& name) { m_connectPipeName = name; }
+    void ToggleStopServer(bool stopServer) { m_stopServer = stopServer; }
     void SetTopK(unsigned k) { m_topK = k; }
     void SetPerformanceCSVPath(const std::wstring& performanceCSVPath) { m_perfOutputPath = performanceCSVPath; }
     void SetRunIterations(const uint32_t iterations) { m_numIterations = iterations; }
@@ -141,6 +223,9 @@ public:
     void SetLoadIterations(const uint32_t iterations) { m_numLoadIterations = iterations; }
     void AddPerformanceFileMetadata(const std::string& key, const std::string& value);
     void SetGarbageDataMaxValue(const uint32_t value) { m_garbageDataMaxValue = value; }
+    // Selects the model, device, input, binding, input type, batch size, intra-op threads and iterations of scenario
+    // and a single session creation, and adds its id, batch size and intra-op threads to the performance file metadata.
+    void ApplyScenario(const BenchmarkScenario& scenario);
 
     // Stop iterating when total time of iterations after the first iteration exceeds time limit.
     void SetIterationTimeLimit(const double milliseconds)
@@ -158,11 +243,15 @@ public:
 private:
     bool m_perfCapture = false;
     bool m_perfConsoleOutputAll = false;
+    bool m_trackAllocations = false;
     bool m_useCPU = false;
     bool m_useGPU = false;
     bool m_useGPUHighPerformance = false;
     bool m_useGPUMinPower = false;
     bool m_concurrentLoad = false;
+    bool m_microBatching = false;
+    bool m_asyncEvaluate = false;
+    bool m_sharedMemoryInput = false;
     bool m_createDeviceOnClient = false;
     bool m_createDeviceInWinML = false;
     bool m_useRGB = false;
@@ -173,12 +262,51 @@ private:
     bool m_ignoreFirstRun = false;
     bool m_evaluation_debug_output = false;
     bool m_perIterCapture = false;
+    bool m_schedulingTelemetry = false;
     bool m_terseOutput = false;
     bool m_autoScale = false;
     bool m_perfOutput = false;
     BitmapInterpolationMode m_autoScaleInterpMode = BitmapInterpolationMode::Cubic;
     bool m_saveTensor = false;
     bool m_timeLimitIterations = false;
+    ModelSource::LoadMode m_loadMode = ModelSource::LoadMode::Path;
+    bool m_prefetchModel = false;
+    bool m_modelCache = false;
+    bool m_inspectOnly = false;
+    std::wstring m_float16OutputPath;
+    std::vector<std::string> m_float16KeepOps;
+    bool m_float16KeepIOTypes = false;
+    bool m_compareOutputs = false;
+    std::wstring m_quantizedOutputPath;
+    std::wstring m_calibrationPath;
+    Onnx::QuantizationOptions m_quantizationOptions;
+    std::wstring m_externalDataOutputPath;
+    Onnx::ExternalDataOptions m_externalDataOptions;
+    std::wstring m_syntheticModelPath;
+    uint64_t m_syntheticModelSizeMB = 0;
+    uint32_t m_modelCacheSizeMB = 1024;
+    BackendType m_backend = BackendType::None;
+    std::wstring m_scenarioFilePath;
+    std::vector<BenchmarkScenario> m_scenarios;
+    bool m_isolate = false;
+    std::wstring m_journalPath;
+    uint32_t m_maxChildren = 1;
+    uint32_t m_childTimeoutSeconds = 600;
+    uint64_t m_childMemoryLimitMB = 0;
+    uint32_t m_cpuPeakThreads = 0;
+    double m_cpuPeakGflops = 0;
+    double m_cpuPeakGigabytesPerSecond = 0;
+    std::wstring m_onlyScenario;
+    uint32_t m_coldStartLaunches = 0;
+    bool m_evictModel = false;
+    std::wstring m_startupReportPath;
+    bool m_checkEnvironment = false;
+    double m_maxSystemLoadPercent = 10;
+    double m_maxClockDriftPercent = 10;
+    bool m_rejectNoisyRuns = false;
+    uint32_t m_scaleOutWorkers = 0;
+    std::wstring m_scaleOutSectionName;
+    uint32_t m_scaleOutWorkerIndex = 0;
     std::wstring m_saveTensorMode = L"First";
     ::TensorizeArgs m_tensorizeArgs;
 
@@ -194,11 +322,24 @@ private:
     std::wstring m_perfOutputPath;
     std::wstring m_perIterationDataPath;
     uint32_t m_numIterations = 1;
+    uint32_t m_batchSize = 1;
+    uint32_t m_intraOpNumThreads = 0;
     uint32_t m_numLoadIterations = 1;
     uint32_t m_numSessionIterations = 1;
     double m_iterationTimeLimitMilliseconds = 0;
     uint32_t m_numThreads = 1;
     uint32_t m_threadInterval = 0;
+    uint32_t m_maxParallelScenarios = 1;
+    uint32_t m_maxBatchSize = 8;
+    double m_maxBatchWaitMilliseconds = 2;
+    uint32_t m_numClients = 8;
+    uint32_t m_numRequestsPerClient = 100;
+    uint32_t m_maxInFlight = 4;
+    uint32_t m_ringSlots = 4;
+    std::wstring m_ringProducerName;
+    std::wstring m_servePipeName;
+    std::wstring m_connectPipeName;
+    bool m_stopServer = false;
     uint32_t m_topK = 1;
     uint32_t m_garbageDataMaxValue = 0;
     std::vector<std::pair<std::string, std::string>> m_perfFileMetadata;
@@ -5,11 +5,14 @@
 #include "Windows.h"
 #include "common.h"
 #include "ThreadPool.h"
+#include "ModelCache.h"
+#include "Run.h"
 
 using namespace winrt;
 using namespace winrt::Windows::AI::MachineLearning;
 
-void load_model(const std::wstring& path, bool print_info)
+void load_model(const std::wstring& path, bool print_info, ModelSource::LoadMode load_mode, bool prefetch,
+                bool use_cache)
 {
     if (print_info)
     {
@@ -17,7 +20,19 @@ void load_model(const std::wstring& path, bool print_info)
         ss << L"Begin loading a model " << path << L" in thread " << std::this_thread::get_id() << std::endl;
         std::wcout << ss.str();
     }
-    auto model = LearningModel::LoadFromFilePath(path);
+    LearningModel model = nullptr;
+    ModelCache::Handle cachedModel;
+    if (use_cache)
+    {
+        cachedModel = ModelCache::Instance().Acquire(path, [load_mode, prefetch](const std::wstring& modelPath) {
+            return LoadModelWithMode(modelPath, load_mode, prefetch);
+        });
+        model = cachedModel.Model();
+    }
+    else
+    {
+        model = LoadModelWithMode(path, load_mode, prefetch);
+    }
     if (print_info)
     {
         std::wstringstream ss;
@@ -27,7 +42,7 @@ void load_model(const std::wstring& path, bool print_info)
 }
 
 void ConcurrentLoadModel(const std::vector<std::wstring>& paths, unsigned num_threads, unsigned interval_milliseconds,
-                         bool print_info)
+                         bool print_info, ModelSource::LoadMode load_mode, bool prefetch, bool use_cache)
 {
 
     ThreadPool pool(num_threads);
@@ -38,7 +53,16 @@ void ConcurrentLoadModel(const std::vector<std::wstring>& paths, unsigned num_th
     for (size_t i = 0; i < threads_size; i++)
     {
         Sleep(interval_milliseconds);
-        output_futures.push_back(pool.SubmitWork(load_model, std::ref(paths[i % paths.size()]), true));
+        output_futures.push_back(
+            pool.SubmitWork(load_model, std::ref(paths[i % paths.size()]), true, load_mode, prefetch, use_cache));
+    }
+    if (use_cache)
+    {
+        // Wait so that the cache statistics printed by the caller cover every load.
+        for (auto& output_future : output_futures)
+        {
+            output_future.wait();
+        }
     }
     // TODO: read output values from load_model
 }
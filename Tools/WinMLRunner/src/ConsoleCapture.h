@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cstdarg>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ConsoleCapture;
+
+namespace ConsoleCaptureDetails
+{
+    inline thread_local ConsoleCapture* t_activeCapture = nullptr;
+
+    // Installed as the buffer of std::cout and std::wcout. Writes from a thread with an active ConsoleCapture go to
+    // that capture; writes from every other thread go to the console buffer it replaced.
+    template <typename CharT> class RoutingBuffer : public std::basic_streambuf<CharT>
+    {
+        using Traits = std::char_traits<CharT>;
+
+    public:
+        explicit RoutingBuffer(std::basic_streambuf<CharT>* console) : m_console(console) {}
+        std::basic_streambuf<CharT>* Console() const { return m_console; }
+
+    protected:
+        typename Traits::int_type overflow(typename Traits::int_type ch) override
+        {
+            if (Traits::eq_int_type(ch, Traits::eof()))
+            {
+                return Traits::not_eof(ch);
+            }
+            CharT c = Traits::to_char_type(ch);
+            return xsputn(&c, 1) == 1 ? ch : Traits::eof();
+        }
+
+        std::streamsize xsputn(const CharT* text, std::streamsize count) override;
+
+        int sync() override { return t_activeCapture ? 0 : m_console->pubsync(); }
+
+    private:
+        std::basic_streambuf<CharT>* m_console;
+    };
+
+    inline RoutingBuffer<char>*& NarrowRouter()
+    {
+        static RoutingBuffer<char>* router = nullptr;
+        return router;
+    }
+
+    inline RoutingBuffer<wchar_t>*& WideRouter()
+    {
+        static RoutingBuffer<wchar_t>* router = nullptr;
+        return router;
+    }
+}
+
+// Collects what the current thread writes to std::cout and std::wcout (including ConsolePrintf and ConsoleWPrintf)
+// while it is alive, so that output of work running concurrently can be printed in a fixed order. Narrow and wide
+// output keep their relative order. Captures do not nest; only create one on a thread that has none.
+class ConsoleCapture
+{
+public:
+    // Routes std::cout and std::wcout through the capture buffers. Call once from the main thread before any thread
+    // starts capturing; later calls do nothing.
+    static void Install()
+    {
+        static std::once_flag installed;
+        std::call_once(installed, []() {
+            ConsoleCaptureDetails::NarrowRouter() = new ConsoleCaptureDetails::RoutingBuffer<char>(std::cout.rdbuf());
+            ConsoleCaptureDetails::WideRouter() =
+                new ConsoleCaptureDetails::RoutingBuffer<wchar_t>(std::wcout.rdbuf());
+            std::cout.rdbuf(ConsoleCaptureDetails::NarrowRouter());
+            std::wcout.rdbuf(ConsoleCaptureDetails::WideRouter());
+        });
+    }
+
+    ConsoleCapture() { ConsoleCaptureDetails::t_activeCapture = this; }
+    ~ConsoleCapture() { Stop(); }
+    ConsoleCapture(const ConsoleCapture&) = delete;
+    ConsoleCapture& operator=(const ConsoleCapture&) = delete;
+
+    // Prints everything captured so far.
+    void Flush()
+    {
+        for (auto& chunk : m_chunks)
+        {
+            if (chunk.IsWide)
+            {
+                Console(ConsoleCaptureDetails::WideRouter(), std::wcout)->sputn(chunk.Wide.data(), chunk.Wide.size());
+            }
+            else
+            {
+                Console(ConsoleCaptureDetails::NarrowRouter(), std::cout)
+                    ->sputn(chunk.Narrow.data(), chunk.Narrow.size());
+            }
+        }
+        m_chunks.clear();
+        std::cout.flush();
+        std::wcout.flush();
+    }
+
+    // Prints everything captured so far; later output from this thread goes straight to the console.
+    void Stop()
+    {
+        if (ConsoleCaptureDetails::t_activeCapture == this)
+        {
+            ConsoleCaptureDetails::t_activeCapture = nullptr;
+        }
+        Flush();
+    }
+
+    // Stops the capture of the calling thread, if it has one, for a thread about to end the process to print what it
+    // captured first.
+    static void StopActive()
+    {
+        if (ConsoleCaptureDetails::t_activeCapture)
+        {
+            ConsoleCaptureDetails::t_activeCapture->Stop();
+        }
+    }
+
+    void Append(const char* text, std::streamsize count)
+    {
+        if (m_chunks.empty() || m_chunks.back().IsWide)
+        {
+            m_chunks.push_back(Chunk{ false });
+        }
+        m_chunks.back().Narrow.append(text, static_cast<size_t>(count));
+    }
+
+    void Append(const wchar_t* text, std::streamsize count)
+    {
+        if (m_chunks.empty() || !m_chunks.back().IsWide)
+        {
+            m_chunks.push_back(Chunk{ true });
+        }
+        m_chunks.back().Wide.append(text, static_cast<size_t>(count));
+    }
+
+private:
+    struct Chunk
+    {
+        bool IsWide;
+        std::string Narrow;
+        std::wstring Wide;
+    };
+
+    template <typename CharT>
+    static std::basic_streambuf<CharT>* Console(ConsoleCaptureDetails::RoutingBuffer<CharT>* router,
+                                                std::basic_ostream<CharT>& stream)
+    {
+        return router ? router->Console() : stream.rdbuf();
+    }
+
+    std::vector<Chunk> m_chunks;
+};
+
+template <typename CharT>
+std::streamsize ConsoleCaptureDetails::RoutingBuffer<CharT>::xsputn(const CharT* text, std::streamsize count)
+{
+    if (t_activeCapture)
+    {
+        t_activeCapture->Append(text, count);
+        return count;
+    }
+    return m_console->sputn(text, count);
+}
+
+// printf and wprintf that write through std::cout and std::wcout, so that ConsoleCapture sees them.
+inline void ConsolePrintf(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    va_list sizeArgs;
+    va_copy(sizeArgs, args);
+    int length = vsnprintf(nullptr, 0, format, sizeArgs);
+    va_end(sizeArgs);
+    if (length > 0)
+    {
+        std::string text(static_cast<size_t>(length) + 1, '\0');
+        vsnprintf(&text[0], text.size(), format, args);
+        text.resize(static_cast<size_t>(length));
+        std::cout << text;
+    }
+    va_end(args);
+    std::cout.flush();
+}
+
+inline void ConsoleWPrintf(const wchar_t* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    va_list sizeArgs;
+    va_copy(sizeArgs, args);
+    int length = _vscwprintf(format, sizeArgs);
+    va_end(sizeArgs);
+    if (length > 0)
+    {
+        std::wstring text(static_cast<size_t>(length) + 1, L'\0');
+        vswprintf(&text[0], text.size(), format, args);
+        text.resize(static_cast<size_t>(length));
+        std::wcout << text;
+    }
+    va_end(args);
+    std::wcout.flush();
+}
@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "Windows.h"
+#include "EnvironmentMonitor.h"
+
+using namespace EnvironmentMonitor;
+
+// What CallNtPowerInformation(ProcessorInformation) fills one of per processor; the SDK documents it without
+// declaring it.
+struct ProcessorPowerInformation
+{
+    ULONG Number;
+    ULONG MaxMhz;
+    ULONG CurrentMhz;
+    ULONG MhzLimit;
+    ULONG MaxIdleState;
+    ULONG CurrentIdleState;
+};
+
+struct Sample
+{
+    uint64_t Sequence;
+    double Ghz;
+    bool Throttled;
+};
+
+// More than enough for the parallel scenarios; an interval that finds no free slot gets the latest sample on Leave.
+static const uint32_t MaxActivePhases = 64;
+
+static std::atomic<bool> s_enabled{ false };
+static double s_referenceGhz = 0;
+static double s_maxClockDriftPercent = 0;
+static double s_systemLoadPercent = 0;
+static double s_maxSystemLoadPercent = 0;
+// Guards the slots and the latest sample. An SRW lock, so that nothing is left to destroy while the sampling thread
+// may still hold it at exit, and entering an interval never allocates.
+static SRWLOCK s_lock = SRWLOCK_INIT;
+static Phase* s_active[MaxActivePhases] = {};
+static Sample s_latest = {};
+// The processor the last interval entered on, packed as group * 64 + number, for the sampling thread to follow.
+static std::atomic<uint32_t> s_processor{ 0 };
+static thread_local Phase* t_phase = nullptr;
+static thread_local uint32_t t_slot = MaxActivePhases;
+
+void Phase::Reset() { memset(this, 0, sizeof(*this)); }
+
+// The power management functions are in powrprof.dll, which the runner does not link to.
+static HMODULE PowerLibrary()
+{
+    static HMODULE powrprof = LoadLibraryExW(L"powrprof.dll", nullptr, LOAD_LIBRARY_SEARCH_SYSTEM32);
+    return powrprof;
+}
+
+// One entry per active processor, empty when the power manager cannot be asked.
+static std::vector<ProcessorPowerInformation> ReadProcessorPower()
+{
+    using CallNtPowerInformationFunction = LONG(WINAPI*)(POWER_INFORMATION_LEVEL, PVOID, ULONG, PVOID, ULONG);
+    static auto callNtPowerInformation = PowerLibrary() == nullptr
+                                             ? nullptr
+                                             : reinterpret_cast<CallNtPowerInformationFunction>(
+                                                   GetProcAddress(PowerLibrary(), "CallNtPowerInformation"));
+    std::vector<ProcessorPowerInformation> processors(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS));
+    if (callNtPowerInformation == nullptr ||
+        callNtPowerInformation(ProcessorInformation, nullptr, 0, processors.data(),
+                               static_cast<ULONG>(processors.size() * sizeof(ProcessorPowerInformation))) < 0)
+    {
+        processors.clear();
+    }
+    return processors;
+}
+
+static bool IsThrottled()
+{
+    std::vector<ProcessorPowerInformation> processors = ReadProcessorPower();
+    return std::any_of(processors.begin(), processors.end(),
+                       [](const ProcessorPowerInformation& processor) { return processor.MhzLimit < processor.MaxMhz; });
+}
+
+static std::string ToUtf8(const std::wstring& value)
+{
+    int size = WideCharToMultiByte(CP_UTF8, 0, value.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    std::string result(size > 0 ? size - 1 : 0, '\0');
+    if (size > 1)
+    {
+        WideCharToMultiByte(CP_UTF8, 0, value.c_str(), -1, &result[0], size, nullptr, nullptr);
+    }
+    return result;
+}
+
+static std::string ReadCpuModel()
+{
+    wchar_t name[256] = {};
+    DWORD size = sizeof(name);
+    if (RegGetValueW(HKEY_LOCAL_MACHINE, L"HARDWARE\\DESCRIPTION\\System\\CentralProcessor\\0",
+                     L"ProcessorNameString", RRF_RT_REG_SZ, nullptr, name, &size) != ERROR_SUCCESS)
+    {
+        return "unknown";
+    }
+    std::wstring model(name);
+    // Some vendors pad the name with spaces.
+    model.erase(0, model.find_first_not_of(L' '));
+    model.erase(model.find_last_not_of(L' ') + 1);
+    return ToUtf8(model);
+}
+
+static std::string ReadPowerPlan()
+{
+    using PowerGetActiveSchemeFunction = DWORD(WINAPI*)(HKEY, GUID**);
+    using PowerReadFriendlyNameFunction = DWORD(WINAPI*)(HKEY, const GUID*, const GUID*, const GUID*, UCHAR*, DWORD*);
+    if (PowerLibrary() == nullptr)
+    {
+        return "unknown";
+    }
+    auto getActiveScheme =
+        reinterpret_cast<PowerGetActiveSchemeFunction>(GetProcAddress(PowerLibrary(), "PowerGetActiveScheme"));
+    auto readFriendlyName =
+        reinterpret_cast<PowerReadFriendlyNameFunction>(GetProcAddress(PowerLibrary(), "PowerReadFriendlyName"));
+    GUID* scheme = nullptr;
+    if (getActiveScheme == nullptr || readFriendlyName == nullptr || getActiveScheme(nullptr, &scheme) != ERROR_SUCCESS)
+    {
+        return "unknown";
+    }
+    wchar_t name[256] = {};
+    DWORD size = sizeof(name);
+    DWORD result = readFriendlyName(nullptr, scheme, nullptr, nullptr, reinterpret_cast<UCHAR*>(name), &size);
+    LocalFree(scheme);
+    return result == ERROR_SUCCESS ? ToUtf8(name) : "unknown";
+}
+
+Fingerprint EnvironmentMonitor::ReadFingerprint()
+{
+    Fingerprint fingerprint;
+    fingerprint.CpuModel = ReadCpuModel();
+    fingerprint.PowerPlan = ReadPowerPlan();
+    DWORD size = 0;
+    GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &size);
+    std::vector<char> buffer(size);
+    auto information = reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data());
+    if (size > 0 && GetLogicalProcessorInformationEx(RelationProcessorCore, information, &size))
+    {
+        for (DWORD offset = 0; offset < size;)
+        {
+            auto core = reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + offset);
+            fingerprint.PhysicalCores++;
+            fingerprint.Smt = fingerprint.Smt || (core->Processor.Flags & LTP_PC_SMT) != 0;
+            for (WORD group = 0; group < core->Processor.GroupCount; group++)
+            {
+                KAFFINITY mask = core->Processor.GroupMask[group].Mask;
+                for (; mask != 0; mask &= mask - 1)
+                {
+                    fingerprint.LogicalProcessors++;
+                }
+            }
+            offset += core->Size;
+        }
+    }
+    std::vector<ProcessorPowerInformation> processors = ReadProcessorPower();
+    if (!processors.empty())
+    {
+        fingerprint.NominalMhz = processors[0].MaxMhz;
+    }
+    return fingerprint;
+}
+
+double EnvironmentMonitor::MeasureSystemLoad(uint32_t milliseconds)
+{
+    auto ticks = [](const FILETIME& time) {
+        return (static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+    };
+    FILETIME idle[2];
+    FILETIME kernel[2];
+    FILETIME user[2];
+    GetSystemTimes(&idle[0], &kernel[0], &user[0]);
+    Sleep(milliseconds);
+    GetSystemTimes(&idle[1], &kernel[1], &user[1]);
+    // The kernel time includes the idle time.
+    uint64_t total = ticks(kernel[1]) - ticks(kernel[0]) + ticks(user[1]) - ticks(user[0]);
+    uint64_t idleTime = ticks(idle[1]) - ticks(idle[0]);
+    return total == 0 ? 0 : 100.0 * (total - (std::min)(idleTime, total)) / total;
+}
+
+// A chain of dependent 64-bit multiplies and xors, which take three cycles and one on every x64 core of the last
+// decade. The xor keeps the compiler from folding the multiplies together.
+static __declspec(noinline) uint64_t SpinChain(uint64_t value, uint64_t multiplier, uint32_t steps)
+{
+    for (uint32_t i = 0; i < steps; i++)
+    {
+        value = (value * multiplier) ^ i;
+    }
+    return value;
+}
+
+double EnvironmentMonitor::MeasureGhz()
+{
+    // About a third of a millisecond per trial at 3 GHz, long against the resolution of the performance counter and
+    // short against a scheduling quantum. The best trial is the one that was not preempted.
+    static const uint32_t Steps = 250000;
+    static const uint32_t CyclesPerStep = 4;
+    static const int Trials = 3;
+    static volatile uint64_t sink = 0;
+    volatile uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    double best = 0;
+    for (int trial = 0; trial < Trials; trial++)
+    {
+        LARGE_INTEGER start;
+        LARGE_INTEGER stop;
+        QueryPerformanceCounter(&start);
+        sink = SpinChain(sink, multiplier, Steps);
+        QueryPerformanceCounter(&stop);
+        double seconds = static_cast<double>(stop.QuadPart - start.QuadPart) / frequency.QuadPart;
+        if (seconds > 0)
+        {
+            best = (std::max)(best, static_cast<double>(Steps) * CyclesPerStep / seconds / 1e9);
+        }
+    }
+    return best;
+}
+
+static void Fold(Phase& phase, const Sample& sample)
+{
+    if (sample.Sequence == 0 || sample.Sequence == phase.LastSample)
+    {
+        return;
+    }
+    if (phase.Samples == 0)
+    {
+        phase.MinGhz = sample.Ghz;
+        phase.MaxGhz = sample.Ghz;
+    }
+    else
+    {
+        phase.Transitions += std::abs(sample.Ghz - phase.LastGhz) > TransitionFraction * phase.LastGhz;
+        phase.MinGhz = (std::min)(phase.MinGhz, sample.Ghz);
+        phase.MaxGhz = (std::max)(phase.MaxGhz, sample.Ghz);
+    }
+    phase.LastGhz = sample.Ghz;
+    phase.LastSample = sample.Sequence;
+    phase.ThrottledSamples += sample.Throttled;
+    phase.Samples++;
+}
+
+// Runs at normal priority, so that it never preempts the evaluation it watches, on the processor that evaluation last
+// entered an interval on: on hybrid parts the cores run at different clocks, and another core's would read as drift.
+static void SampleForever()
+{
+    uint32_t pinned = UINT32_MAX;
+    for (uint64_t sequence = 1;; sequence++)
+    {
+        uint32_t processor = s_processor.load(std::memory_order_relaxed);
+        if (processor != pinned)
+        {
+            GROUP_AFFINITY affinity = {};
+            affinity.Group = static_cast<WORD>(processor / 64);
+            affinity.Mask = KAFFINITY(1) << (processor % 64);
+            SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+            pinned = processor;
+        }
+        Sample sample = { sequence, MeasureGhz(), IsThrottled() };
+        AcquireSRWLockExclusive(&s_lock);
+        s_latest = sample;
+        for (Phase* phase : s_active)
+        {
+            if (phase != nullptr)
+            {
+                Fold(*phase, sample);
+            }
+        }
+        ReleaseSRWLockExclusive(&s_lock);
+        Sleep(SamplePeriodMs);
+    }
+}
+
+void EnvironmentMonitor::Enable(double max_clock_drift_percent, double system_load_percent,
+                                double max_system_load_percent)
+{
+    if (s_enabled)
+    {
+        return;
+    }
+    // The median of a few samples, so that one caught mid transition does not set the reference.
+    std::vector<double> samples;
+    for (int i = 0; i < 5; i++)
+    {
+        samples.push_back(MeasureGhz());
+        Sleep(SamplePeriodMs / 5);
+    }
+    std::sort(samples.begin(), samples.end());
+    s_referenceGhz = samples[samples.size() / 2];
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    s_processor = processor.Group * 64u + processor.Number;
+    s_maxClockDriftPercent = max_clock_drift_percent;
+    s_systemLoadPercent = system_load_percent;
+    s_maxSystemLoadPercent = max_system_load_percent;
+    std::thread(SampleForever).detach();
+    s_enabled = true;
+}
+
+bool EnvironmentMonitor::IsEnabled() { return s_enabled; }
+
+double EnvironmentMonitor::ReferenceGhz() { return s_referenceGhz; }
+
+void EnvironmentMonitor::Enter(Phase& phase)
+{
+    if (!s_enabled)
+    {
+        return;
+    }
+    phase.Intervals++;
+    t_phase = &phase;
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    s_processor.store(processor.Group * 64u + processor.Number, std::memory_order_relaxed);
+    AcquireSRWLockExclusive(&s_lock);
+    for (t_slot = 0; t_slot < MaxActivePhases && s_active[t_slot] != nullptr; t_slot++)
+    {
+    }
+    if (t_slot < MaxActivePhases)
+    {
+        s_active[t_slot] = &phase;
+    }
+    ReleaseSRWLockExclusive(&s_lock);
+}
+
+void EnvironmentMonitor::Leave()
+{
+    if (t_phase == nullptr)
+    {
+        return;
+    }
+    AcquireSRWLockExclusive(&s_lock);
+    if (t_slot < MaxActivePhases)
+    {
+        s_active[t_slot] = nullptr;
+    }
+    Fold(*t_phase, s_latest);
+    ReleaseSRWLockExclusive(&s_lock);
+    t_phase = nullptr;
+}
+
+std::string EnvironmentMonitor::Deviation(const Phase& phase)
+{
+    if (phase.Samples == 0 || s_referenceGhz <= 0)
+    {
+        return "";
+    }
+    std::vector<std::string> reasons;
+    double below = 100 * (s_referenceGhz - phase.MinGhz) / s_referenceGhz;
+    double above = 100 * (phase.MaxGhz - s_referenceGhz) / s_referenceGhz;
+    if (below > s_maxClockDriftPercent)
+    {
+        reasons.push_back("clock " + std::to_string(std::lround(below)) + "% below reference");
+    }
+    if (above > s_maxClockDriftPercent)
+    {
+        reasons.push_back("clock " + std::to_string(std::lround(above)) + "% above reference");
+    }
+    if (phase.ThrottledSamples > 0)
+    {
+        reasons.push_back("throttled in " + std::to_string(phase.ThrottledSamples) + " of " +
+                          std::to_string(phase.Samples) + " samples");
+    }
+    std::ostringstream deviation;
+    for (size_t i = 0; i < reasons.size(); i++)
+    {
+        deviation << (i == 0 ? "" : " and ") << reasons[i];
+    }
+    return deviation.str();
+}
+
+std::string EnvironmentMonitor::SystemDeviation()
+{
+    if (!s_enabled || s_systemLoadPercent <= s_maxSystemLoadPercent)
+    {
+        return "";
+    }
+    return "system " + std::to_string(std::lround(s_systemLoadPercent)) + "% busy before the run";
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Whether the machine stayed fit to benchmark on: how busy it was before the run, and the clock the CPU ran at during
+// each profiling interval. The clock is sampled by a background thread timing a calibrated spin loop, as Windows has
+// no user mode access to the APERF and MPERF counters; throttling is read from the power manager, which reports when
+// it holds a processor below its maximum frequency for thermal or power reasons.
+namespace EnvironmentMonitor
+{
+// Clock samples more than this fraction apart count as a frequency transition.
+static const double TransitionFraction = 0.05;
+static const uint32_t SamplePeriodMs = 100;
+
+// The clock samples taken while the intervals of one PerfCounterStatistics ran. Written by the sampling thread under
+// a lock, and read once the intervals have ended.
+struct Phase
+{
+    uint64_t Intervals;
+    uint32_t Samples;
+    double MinGhz;
+    double MaxGhz;
+    double LastGhz;
+    // Sequence number of the last sample taken in, so that a sample is never counted twice.
+    uint64_t LastSample;
+    uint32_t Transitions;
+    // Samples taken while some processor was held below its maximum frequency.
+    uint32_t ThrottledSamples;
+
+    void Reset();
+};
+
+struct Fingerprint
+{
+    std::string CpuModel;
+    // The active power plan, which on Windows stands for the frequency governor.
+    std::string PowerPlan;
+    uint32_t PhysicalCores = 0;
+    uint32_t LogicalProcessors = 0;
+    bool Smt = false;
+    uint32_t NominalMhz = 0;
+};
+
+Fingerprint ReadFingerprint();
+
+// Percent of the time all processors were busy over the next milliseconds, the calling thread sleeping meanwhile.
+double MeasureSystemLoad(uint32_t milliseconds);
+
+// Effective clock of the processor running the calling thread, in GHz. Exact on x64; elsewhere the multiply and xor
+// the spin loop times may take other than four cycles, which scales every sample alike.
+double MeasureGhz();
+
+// Measures the clock the run is compared against and starts the sampling thread, which runs until the process exits.
+// system_load_percent is what MeasureSystemLoad found before the run.
+void Enable(double max_clock_drift_percent, double system_load_percent, double max_system_load_percent);
+bool IsEnabled();
+double ReferenceGhz();
+
+// Takes the samples of the clock into phase until Leave. An interval no sample falls in gets the latest one taken.
+// The sampling thread moves to the processor the calling thread runs on, so Enter goes outside the timed interval.
+void Enter(Phase& phase);
+void Leave();
+
+// Why phase or the system before the run deviated beyond the thresholds given to Enable, or empty when it did not.
+std::string Deviation(const Phase& phase);
+std::string SystemDeviation();
+} // namespace EnvironmentMonitor
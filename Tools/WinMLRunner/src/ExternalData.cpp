@@ -0,0 +1,141 @@
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+
+#include "Windows.h"
+#include <psapi.h>
+#include "common.h"
+#include "OnnxExternalData.h"
+#include "Scenarios.h"
+
+using namespace winrt;
+
+static double ToMB(uint64_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+struct ProcessMemory
+{
+    double workingSetMB = 0;
+    double privateMB = 0;
+};
+
+static ProcessMemory CurrentMemory()
+{
+    PROCESS_MEMORY_COUNTERS_EX counters = {};
+    GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters),
+                         sizeof(counters));
+    return { ToMB(counters.WorkingSetSize), ToMB(counters.PrivateUsage) };
+}
+
+static ProcessMemory Growth(const ProcessMemory& before)
+{
+    ProcessMemory now = CurrentMemory();
+    return { now.workingSetMB - before.workingSetMB, now.privateMB - before.privateMB };
+}
+
+// Reads a byte of every page of every weight, as a backend creating its session from them would.
+static uint64_t TouchWeights(const Onnx::Model& model)
+{
+    uint64_t sum = 0;
+    for (const auto& tensor : model.graph.initializers)
+    {
+        for (size_t offset = 0; offset < tensor.ByteSize(); offset += 4096)
+        {
+            sum += tensor.Data()[offset];
+        }
+    }
+    return sum;
+}
+
+// Memory growth while every weight of the model at path is in the heap, read the way loaders without external data
+// support read them: the .onnx file through LoadModel and each external payload from its file.
+static ProcessMemory CopiedWeightsMemory(const std::filesystem::path& path)
+{
+    ProcessMemory before = CurrentMemory();
+    std::unique_ptr<Onnx::Model> model = Onnx::LoadModel(path);
+    std::vector<std::vector<char>> payloads;
+    for (const auto& tensor : model->graph.initializers)
+    {
+        if (!tensor.external)
+        {
+            continue;
+        }
+        Onnx::ExternalLocation place = Onnx::FindExternalLocation(tensor);
+        std::ifstream file(Onnx::ExternalDataPath(path.parent_path(), place.location), std::ios::binary);
+        payloads.emplace_back(static_cast<size_t>(place.hasLength ? place.length : tensor.ElementCount() *
+                                                                      Onnx::DataTypeSize(tensor.dataType)));
+        if (!file.seekg(static_cast<std::streamoff>(place.offset)) ||
+            !file.read(payloads.back().data(), static_cast<std::streamsize>(payloads.back().size())))
+        {
+            throw std::runtime_error("Onnx: could not read the external data of " + tensor.name + ".");
+        }
+    }
+    volatile uint64_t sum = TouchWeights(*model);
+    (void)sum;
+    return Growth(before);
+}
+
+// Memory growth while every weight of the model at path is read through MapModel.
+static ProcessMemory MappedWeightsMemory(const std::filesystem::path& path)
+{
+    ProcessMemory before = CurrentMemory();
+    std::unique_ptr<Onnx::Model> model = Onnx::MapModel(path);
+    volatile uint64_t sum = TouchWeights(*model);
+    (void)sum;
+    return Growth(before);
+}
+
+static void PrintWeightsMemory(const std::wstring& path)
+{
+    std::wcout << L"  Reading every weight of " << path << L":" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    ProcessMemory mapped = MappedWeightsMemory(path);
+    std::cout << "    mapped: working set +" << mapped.workingSetMB << " MB, private +" << mapped.privateMB << " MB"
+              << std::endl;
+    try
+    {
+        ProcessMemory copied = CopiedWeightsMemory(path);
+        std::cout << "    copied: working set +" << copied.workingSetMB << " MB, private +" << copied.privateMB
+                  << " MB" << std::endl;
+    }
+    catch (const std::bad_alloc&)
+    {
+        std::cout << "    copied: out of memory" << std::endl;
+    }
+    std::cout << std::defaultfloat;
+}
+
+int SplitModelExternalData(const std::wstring& path, const std::wstring& output_path,
+                           const Onnx::ExternalDataOptions& options)
+{
+    std::wcout << L"Splitting " << path << L" into " << output_path << std::endl;
+    Timer timer;
+    timer.Start();
+    Onnx::ExternalDataReport report = Onnx::SplitExternalData(path, output_path, options);
+    double splitTime = timer.Stop();
+    std::cout << std::fixed << std::setprecision(3) << "  " << ToMB(report.inputBytes) << " MB -> "
+              << ToMB(report.modelBytes) << " MB model and " << ToMB(report.dataBytes) << " MB in "
+              << report.location << " in " << splitTime << " ms" << std::defaultfloat << std::endl;
+    std::cout << "  " << report.externalTensors << " initializers moved out at " << options.alignment / 1024
+              << " KB alignment, " << report.inlineTensors << " under " << options.minBytes / 1024
+              << " KB kept inline" << std::endl;
+    PrintWeightsMemory(path);
+    PrintWeightsMemory(output_path);
+    std::cout << "  Mapped weights are file pages: every process mapping the same file shares them, so only the "
+                 "private growth is paid per process."
+              << std::endl;
+    return 0;
+}
+
+int GenerateSyntheticModel(const std::wstring& output_path, uint64_t size_mb)
+{
+    std::wcout << L"Writing a synthetic model of " << size_mb << L" MB to " << output_path << std::endl;
+    Timer timer;
+    timer.Start();
+    Onnx::ExternalDataReport report = Onnx::WriteSyntheticModel(output_path, size_mb * 1024 * 1024);
+    double writeTime = timer.Stop();
+    std::cout << std::fixed << std::setprecision(3) << "  " << report.externalTensors << " MatMul layers, "
+              << ToMB(report.modelBytes) << " MB model and " << ToMB(report.dataBytes) << " MB in "
+              << report.location << " in " << writeTime << " ms" << std::defaultfloat << std::endl;
+    PrintWeightsMemory(output_path);
+    return 0;
+}
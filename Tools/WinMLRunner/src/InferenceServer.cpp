@@ -0,0 +1,588 @@
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include "Windows.h"
+#include "common.h"
+#include "MicroBatcher.h"
+#include "ServeProtocol.h"
+#include "Scenarios.h"
+#include "Statistics.h"
+
+using namespace winrt;
+using namespace winrt::Windows::AI::MachineLearning;
+using namespace ServeProtocol;
+
+// How long a client keeps retrying while the server is still loading the model or all pipe instances are busy.
+static const ULONGLONG ConnectTimeoutMilliseconds = 60000;
+static const DWORD PipeBufferBytes = 64 * 1024;
+
+static void PrintServerStats(const StatsBody& stats)
+{
+    std::cout << "  Server: " << stats.Requests << " requests in " << stats.Batches << " batches, " << stats.Errors
+              << " errors, queue depth " << stats.QueueDepth << ", " << stats.Connections << " connections, up "
+              << std::fixed << std::setprecision(1) << stats.UptimeSeconds << " s" << std::endl;
+    std::cout << std::setprecision(3) << "  Server queue p50/p90/p99(ms): " << stats.QueueP50 << " / " << stats.QueueP90
+              << " / " << stats.QueueP99 << std::endl;
+    std::cout << "  Server time p50/p90/p99(ms): " << stats.ServerP50 << " / " << stats.ServerP90 << " / "
+              << stats.ServerP99 << std::defaultfloat << std::endl;
+}
+
+// Serves one model over a named pipe. Every connection gets its own thread, which blocks on its current request, so
+// requests arriving together on different connections are coalesced by the device's MicroBatcher.
+class InferenceServer
+{
+public:
+    InferenceServer(const std::wstring& pipeName, const LearningModel& model,
+                    std::vector<std::unique_ptr<MicroBatcher>> batchers, uint32_t maxBatchSize)
+        : m_pipePath(PipePath(pipeName)), m_model(model), m_batchers(std::move(batchers)), m_maxBatchSize(maxBatchSize),
+          m_connectEvent(CreateEventW(nullptr, TRUE, FALSE, nullptr)),
+          m_stopEvent(CreateEventW(nullptr, TRUE, FALSE, nullptr))
+    {
+        m_uptime.Start();
+    }
+
+    ~InferenceServer()
+    {
+        CloseHandle(m_connectEvent);
+        CloseHandle(m_stopEvent);
+    }
+
+    // Accepts connections until a client sends Shutdown, then answers the requests being evaluated, closes every
+    // connection and returns.
+    void Run()
+    {
+        bool firstInstance = true;
+        std::vector<std::unique_ptr<Connection>> connections;
+        while (true)
+        {
+            // The first instance claims the name, so a second server on the same pipe fails instead of sharing it.
+            DWORD openMode =
+                PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (firstInstance ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+            HANDLE pipe = CreateNamedPipeW(m_pipePath.c_str(), openMode,
+                                           PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                           PIPE_UNLIMITED_INSTANCES, PipeBufferBytes, PipeBufferBytes, 0, nullptr);
+            if (pipe == INVALID_HANDLE_VALUE)
+            {
+                throw_last_error();
+            }
+            firstInstance = false;
+            auto stream = std::make_unique<PipeStream>(pipe);
+            if (!WaitForClient(*stream))
+            {
+                break;
+            }
+
+            connections.erase(std::remove_if(connections.begin(), connections.end(),
+                                             [](std::unique_ptr<Connection>& connection) {
+                                                 if (!connection->Done)
+                                                 {
+                                                     return false;
+                                                 }
+                                                 connection->Thread.join();
+                                                 return true;
+                                             }),
+                              connections.end());
+            connections.push_back(std::make_unique<Connection>());
+            Connection* connection = connections.back().get();
+            connection->Stream = std::move(stream);
+            connection->Thread = std::thread([this, connection]() { Serve(*connection); });
+        }
+
+        // A connection handling a request answers it and then sees m_stopping. One waiting for a request is
+        // disconnected, which makes every later read fail, and cancelled, which ends the read already waiting, so no
+        // connection thread can block on a client that stays connected.
+        m_stopping = true;
+        for (auto& connection : connections)
+        {
+            std::lock_guard<std::mutex> lock(connection->Mutex);
+            if (connection->Reading)
+            {
+                DisconnectNamedPipe(connection->Stream->Handle());
+                connection->Stream->Cancel();
+            }
+        }
+        for (auto& connection : connections)
+        {
+            connection->Thread.join();
+        }
+    }
+
+    StatsBody Stats()
+    {
+        StatsBody stats = {};
+        Statistics::LatencyHistogram queueLatencies;
+        Statistics::LatencyHistogram serverLatencies;
+        {
+            std::lock_guard<std::mutex> lock(m_statsMutex);
+            queueLatencies = m_queueLatencies;
+            serverLatencies = m_serverLatencies;
+            stats.Errors = m_numErrors;
+        }
+        stats.Requests = serverLatencies.Count();
+        for (auto& batcher : m_batchers)
+        {
+            stats.Batches += batcher->NumBatches();
+            stats.QueueDepth += static_cast<uint32_t>(batcher->QueueDepth());
+        }
+        stats.Connections = m_numConnections;
+        stats.UptimeSeconds = m_uptime.Stop() / 1000.0;
+        stats.QueueP50 = queueLatencies.Percentile(50);
+        stats.QueueP90 = queueLatencies.Percentile(90);
+        stats.QueueP99 = queueLatencies.Percentile(99);
+        stats.ServerP50 = serverLatencies.Percentile(50);
+        stats.ServerP90 = serverLatencies.Percentile(90);
+        stats.ServerP99 = serverLatencies.Percentile(99);
+        return stats;
+    }
+
+private:
+    struct Connection
+    {
+        std::unique_ptr<PipeStream> Stream;
+        std::thread Thread;
+        std::atomic<bool> Done = false;
+        // Set while the connection waits for a request, rather than handling one. Guarded by Mutex.
+        std::mutex Mutex;
+        bool Reading = false;
+    };
+
+    // Returns false once Shutdown is requested.
+    bool WaitForClient(PipeStream& stream)
+    {
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = m_connectEvent;
+        ResetEvent(m_connectEvent);
+        if (!ConnectNamedPipe(stream.Handle(), &overlapped))
+        {
+            DWORD error = GetLastError();
+            if (error == ERROR_PIPE_CONNECTED)
+            {
+                return true;
+            }
+            if (error != ERROR_IO_PENDING)
+            {
+                throw hresult_error(HRESULT_FROM_WIN32(error), L"Serve: failed to wait for a client.");
+            }
+        }
+
+        HANDLE events[] = { m_connectEvent, m_stopEvent };
+        DWORD transferred = 0;
+        if (WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0)
+        {
+            // A client that connects and closes right away fails the connect; its reads then fail and end it.
+            GetOverlappedResult(stream.Handle(), &overlapped, &transferred, FALSE);
+            return true;
+        }
+        stream.Cancel();
+        GetOverlappedResult(stream.Handle(), &overlapped, &transferred, TRUE);
+        return false;
+    }
+
+    void Serve(Connection& connection)
+    {
+        m_numConnections++;
+        RequestHeader header;
+        std::vector<uint8_t> body;
+        while (true)
+        {
+            {
+                std::lock_guard<std::mutex> lock(connection.Mutex);
+                if (m_stopping)
+                {
+                    break;
+                }
+                connection.Reading = true;
+            }
+            bool read = connection.Stream->ReadMessage(header, body);
+            {
+                std::lock_guard<std::mutex> lock(connection.Mutex);
+                connection.Reading = false;
+            }
+            if (!read || !Handle(*connection.Stream, header, body))
+            {
+                break;
+            }
+        }
+        m_numConnections--;
+        connection.Done = true;
+    }
+
+    // Answers one request. Returns false when the connection should be closed.
+    bool Handle(PipeStream& stream, const RequestHeader& header, const std::vector<uint8_t>& body)
+    {
+        ResponseHeader response = {};
+        std::vector<uint8_t> responseBody;
+        switch (header.Type)
+        {
+            case MessageType::Describe:
+            {
+                const auto& exampleShape = m_batchers.front()->ExampleShape();
+                DescribeBody describe = {};
+                describe.DeviceCount = static_cast<uint32_t>(m_batchers.size());
+                describe.MaxBatchSize = m_maxBatchSize;
+                describe.InputDataType = DataType::Float32;
+                describe.InputRank = static_cast<uint8_t>(exampleShape.size() + 1);
+                Append(responseBody, describe);
+                Append(responseBody, int64_t(1));
+                Append(responseBody, exampleShape.data(), exampleShape.size() * sizeof(int64_t));
+                break;
+            }
+            case MessageType::Infer:
+                response.Result = Infer(header, body, responseBody);
+                break;
+            case MessageType::Stats:
+                Append(responseBody, Stats());
+                break;
+            case MessageType::Shutdown:
+                stream.WriteMessage(response, responseBody);
+                SetEvent(m_stopEvent);
+                return false;
+            default:
+            {
+                const std::string message = "Unknown message type.";
+                response.Result = Status::InvalidRequest;
+                responseBody.assign(message.begin(), message.end());
+                break;
+            }
+        }
+        return stream.WriteMessage(response, responseBody);
+    }
+
+    Status Infer(const RequestHeader& header, const std::vector<uint8_t>& body, std::vector<uint8_t>& responseBody)
+    {
+        Timer timer;
+        timer.Start();
+        auto fail = [&](Status status, const std::string& message) {
+            {
+                std::lock_guard<std::mutex> lock(m_statsMutex);
+                m_numErrors++;
+            }
+            responseBody.assign(message.begin(), message.end());
+            return status;
+        };
+
+        if (header.Device >= m_batchers.size())
+        {
+            return fail(Status::InvalidRequest, "Unknown device index.");
+        }
+        MicroBatcher& batcher = *m_batchers[header.Device];
+        BodyReader reader(body);
+        TensorHeader tensor;
+        std::vector<int64_t> shape;
+        if (!reader.TakeTensorHeader(tensor, shape) || tensor.ElementType != DataType::Float32 ||
+            tensor.PayloadBytes != reader.Remaining())
+        {
+            return fail(Status::InvalidRequest, "Malformed tensor; only float32 inputs are supported.");
+        }
+        size_t elementCount = 1;
+        for (int64_t dim : shape)
+        {
+            elementCount *= dim > 0 ? static_cast<size_t>(dim) : 0;
+        }
+        if (elementCount != batcher.InputElementCount() || tensor.PayloadBytes != elementCount * sizeof(float))
+        {
+            return fail(Status::InvalidRequest, "The input shape is different from one example of the model input.");
+        }
+        std::vector<float> input(elementCount);
+        reader.Take(input.data(), tensor.PayloadBytes);
+
+        MicroBatchResult result;
+        try
+        {
+            result = batcher.Submit(std::move(input)).get();
+        }
+        catch (const hresult_error& error)
+        {
+            return fail(Status::EvaluationFailed, to_string(error.message()));
+        }
+        catch (const std::exception& error)
+        {
+            return fail(Status::EvaluationFailed, error.what());
+        }
+
+        InferBody infer = {};
+        infer.BatchSize = result.BatchSize;
+        infer.OutputCount = static_cast<uint32_t>(result.Outputs.size());
+        infer.QueueMilliseconds = static_cast<float>(result.QueueMilliseconds);
+        Append(responseBody, infer);
+        for (uint32_t i = 0; i < result.Outputs.size(); i++)
+        {
+            const auto& output = result.Outputs[i];
+            std::vector<int64_t> outputShape = OutputShape(i, output.size());
+            TensorHeader outputTensor = {};
+            outputTensor.ElementType = DataType::Float32;
+            outputTensor.Rank = static_cast<uint8_t>(outputShape.size());
+            outputTensor.PayloadBytes = static_cast<uint32_t>(output.size() * sizeof(float));
+            Append(responseBody, outputTensor);
+            Append(responseBody, outputShape.data(), outputShape.size() * sizeof(int64_t));
+            Append(responseBody, output.data(), outputTensor.PayloadBytes);
+        }
+
+        double serverMilliseconds = timer.Stop();
+        // The server time is patched in last so that it covers building the response.
+        reinterpret_cast<InferBody*>(responseBody.data())->ServerMilliseconds = static_cast<float>(serverMilliseconds);
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_queueLatencies.Add(result.QueueMilliseconds);
+        m_serverLatencies.Add(serverMilliseconds);
+        return Status::Ok;
+    }
+
+    // The model's output shape with a batch of 1, or a flat shape when the model leaves other dimensions free.
+    std::vector<int64_t> OutputShape(uint32_t output, size_t elementCount)
+    {
+        auto descriptor = m_model.OutputFeatures().GetAt(output).as<TensorFeatureDescriptor>();
+        std::vector<int64_t> shape = { 1 };
+        int64_t product = 1;
+        auto dims = descriptor.Shape();
+        for (uint32_t dim = 1; dim < dims.Size(); dim++)
+        {
+            shape.push_back(dims.GetAt(dim));
+            product *= dims.GetAt(dim) > 0 ? dims.GetAt(dim) : 0;
+        }
+        if (dims.Size() == 0 || product != static_cast<int64_t>(elementCount))
+        {
+            shape = { static_cast<int64_t>(elementCount) };
+        }
+        return shape;
+    }
+
+    std::wstring m_pipePath;
+    LearningModel m_model;
+    std::vector<std::unique_ptr<MicroBatcher>> m_batchers;
+    uint32_t m_maxBatchSize;
+    HANDLE m_connectEvent;
+    HANDLE m_stopEvent;
+    std::atomic<bool> m_stopping = false;
+    std::atomic<uint32_t> m_numConnections = 0;
+    Timer m_uptime;
+
+    // Histograms rather than every latency, so that a server running for days neither grows nor takes longer to
+    // answer Stats.
+    std::mutex m_statsMutex;
+    Statistics::LatencyHistogram m_queueLatencies;
+    Statistics::LatencyHistogram m_serverLatencies;
+    uint64_t m_numErrors = 0;
+};
+
+int ServeModel(const std::wstring& path, const std::vector<LearningModelDevice>& devices,
+               const std::vector<std::string>& device_names, const std::wstring& pipe_name, unsigned max_batch_size,
+               double max_wait_milliseconds)
+{
+    if (devices.empty() || devices.size() > UINT8_MAX)
+    {
+        throw hresult_invalid_argument(L"Serve: between 1 and 255 devices can be served.");
+    }
+    auto model = LearningModel::LoadFromFilePath(path);
+    MicroBatcherOptions options;
+    options.MaxBatchSize = max_batch_size;
+    options.MaxWait = std::chrono::microseconds(static_cast<int64_t>(max_wait_milliseconds * 1000));
+    std::vector<std::unique_ptr<MicroBatcher>> batchers;
+    for (const auto& device : devices)
+    {
+        batchers.push_back(std::make_unique<MicroBatcher>(model, device, options));
+        // Evaluate once so that the first request does not pay for session creation.
+        batchers.back()->Submit(std::vector<float>(batchers.back()->InputElementCount())).get();
+    }
+
+    InferenceServer server(pipe_name, model, std::move(batchers), max_batch_size);
+    std::wcout << L"Serving " << path << L" on " << PipePath(pipe_name) << std::endl;
+    for (size_t device = 0; device < device_names.size(); device++)
+    {
+        std::cout << "  Device " << device << ": " << device_names[device] << std::endl;
+    }
+    std::cout << "  Max batch size: " << max_batch_size << ", max batch wait: " << max_wait_milliseconds << " ms"
+              << std::endl;
+    server.Run();
+
+    std::cout << "Server stopped." << std::endl;
+    PrintServerStats(server.Stats());
+    return 0;
+}
+
+static std::unique_ptr<PipeStream> Connect(const std::wstring& pipe_name)
+{
+    std::wstring path = PipePath(pipe_name);
+    ULONGLONG start = GetTickCount64();
+    while (true)
+    {
+        HANDLE pipe = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_OVERLAPPED, nullptr);
+        if (pipe != INVALID_HANDLE_VALUE)
+        {
+            return std::make_unique<PipeStream>(pipe);
+        }
+        DWORD error = GetLastError();
+        if (error != ERROR_PIPE_BUSY && error != ERROR_FILE_NOT_FOUND)
+        {
+            throw hresult_error(HRESULT_FROM_WIN32(error), L"Serve client: failed to connect to " + path);
+        }
+        if (GetTickCount64() - start >= ConnectTimeoutMilliseconds)
+        {
+            throw hresult_error(HRESULT_FROM_WIN32(ERROR_TIMEOUT), L"Serve client: no server is listening on " + path);
+        }
+        if (error == ERROR_PIPE_BUSY)
+        {
+            WaitNamedPipeW(path.c_str(), 1000);
+        }
+        else
+        {
+            Sleep(100);
+        }
+    }
+}
+
+static void Call(PipeStream& stream, MessageType type, uint8_t device, const std::vector<uint8_t>& body,
+                 std::vector<uint8_t>& responseBody)
+{
+    RequestHeader request = {};
+    request.Type = type;
+    request.Device = device;
+    ResponseHeader response = {};
+    if (!stream.WriteMessage(request, body) || !stream.ReadMessage(response, responseBody))
+    {
+        throw hresult_error(E_FAIL, L"Serve client: lost the connection to the server.");
+    }
+    if (response.Result != Status::Ok)
+    {
+        throw hresult_error(E_FAIL, L"Serve client: the server failed a request: " +
+                                        to_hstring(std::string(responseBody.begin(), responseBody.end())));
+    }
+}
+
+int RunServeClient(const std::wstring& pipe_name, unsigned num_clients, unsigned requests_per_client,
+                   bool stop_server)
+{
+    auto control = Connect(pipe_name);
+    std::vector<uint8_t> response;
+    Call(*control, MessageType::Describe, 0, {}, response);
+    BodyReader describeReader(response);
+    DescribeBody describe = {};
+    std::vector<int64_t> shape;
+    if (!describeReader.Take(describe) || describe.InputRank > MaxRank)
+    {
+        throw hresult_error(E_FAIL, L"Serve client: malformed Describe response.");
+    }
+    shape.resize(describe.InputRank);
+    if (!describeReader.Take(shape.data(), shape.size() * sizeof(int64_t)))
+    {
+        throw hresult_error(E_FAIL, L"Serve client: malformed Describe response.");
+    }
+    // An example the server could not accept in one request is as malformed as a non-positive dimension.
+    const size_t maxElements = MaxBodyBytes / sizeof(float);
+    size_t elementCount = 1;
+    for (int64_t dim : shape)
+    {
+        if (dim <= 0 || static_cast<uint64_t>(dim) > maxElements / elementCount)
+        {
+            throw hresult_error(E_FAIL, L"Serve client: malformed Describe response.");
+        }
+        elementCount *= static_cast<size_t>(dim);
+    }
+
+    std::wcout << L"Load client for " << PipePath(pipe_name) << std::endl;
+    std::cout << "  Devices: " << describe.DeviceCount << ", clients: " << num_clients
+              << ", requests per client: " << requests_per_client << std::endl;
+
+    // Closed loop: each client sends one request, waits for its response and sends the next. Clients are spread over
+    // the server's devices.
+    std::vector<std::vector<double>> latencies(num_clients);
+    std::vector<uint64_t> batchSizes(num_clients);
+    std::vector<std::exception_ptr> errors(num_clients);
+    Timer wallClock;
+    wallClock.Start();
+    std::vector<std::thread> clients;
+    for (unsigned client = 0; client < num_clients; client++)
+    {
+        clients.emplace_back([&, client]() {
+            try
+            {
+                auto stream = Connect(pipe_name);
+                std::mt19937 generator(client);
+                std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+                std::vector<float> input(elementCount);
+                TensorHeader tensor = {};
+                tensor.ElementType = DataType::Float32;
+                tensor.Rank = static_cast<uint8_t>(shape.size());
+                tensor.PayloadBytes = static_cast<uint32_t>(elementCount * sizeof(float));
+                std::vector<uint8_t> request;
+                std::vector<uint8_t> reply;
+                for (unsigned i = 0; i < requests_per_client; i++)
+                {
+                    std::generate(input.begin(), input.end(), [&]() { return distribution(generator); });
+                    request.clear();
+                    Append(request, tensor);
+                    Append(request, shape.data(), shape.size() * sizeof(int64_t));
+                    Append(request, input.data(), tensor.PayloadBytes);
+
+                    Timer timer;
+                    timer.Start();
+                    Call(*stream, MessageType::Infer, static_cast<uint8_t>(client % describe.DeviceCount), request,
+                         reply);
+                    latencies[client].push_back(timer.Stop());
+
+                    BodyReader reader(reply);
+                    InferBody infer = {};
+                    if (!reader.Take(infer) || infer.OutputCount == 0)
+                    {
+                        throw hresult_error(E_FAIL, L"Serve client: malformed Infer response.");
+                    }
+                    batchSizes[client] += infer.BatchSize;
+                }
+            }
+            catch (...)
+            {
+                errors[client] = std::current_exception();
+            }
+        });
+    }
+    for (auto& client : clients)
+    {
+        client.join();
+    }
+    double elapsed = wallClock.Stop();
+    for (auto& error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::vector<double> allLatencies;
+    uint64_t totalBatchSize = 0;
+    for (unsigned client = 0; client < num_clients; client++)
+    {
+        allLatencies.insert(allLatencies.end(), latencies[client].begin(), latencies[client].end());
+        totalBatchSize += batchSizes[client];
+    }
+    std::sort(allLatencies.begin(), allLatencies.end());
+    double throughput = elapsed > 0 ? allLatencies.size() * 1000.0 / elapsed : 0;
+    // Average over requests of the batch each was served in.
+    double averageBatchSize = allLatencies.empty() ? 0 : static_cast<double>(totalBatchSize) / allLatencies.size();
+
+    std::cout << std::left << "  " << std::setw(20) << "Throughput(req/s)" << std::setw(12) << "AvgBatch"
+              << std::setw(12) << "p50(ms)" << std::setw(12) << "p90(ms)" << std::setw(12) << "p99(ms)" << std::endl;
+    std::cout << "  " << std::setw(20) << std::fixed << std::setprecision(1) << throughput << std::setw(12)
+              << std::setprecision(2) << averageBatchSize << std::setw(12) << std::setprecision(3)
+              << Statistics::Percentile(allLatencies, 50) << std::setw(12)
+              << Statistics::Percentile(allLatencies, 90) << std::setw(12)
+              << Statistics::Percentile(allLatencies, 99) << std::defaultfloat << std::right << std::endl;
+
+    Call(*control, MessageType::Stats, 0, {}, response);
+    StatsBody stats = {};
+    if (!BodyReader(response).Take(stats))
+    {
+        throw hresult_error(E_FAIL, L"Serve client: malformed Stats response.");
+    }
+    PrintServerStats(stats);
+
+    if (stop_server)
+    {
+        Call(*control, MessageType::Shutdown, 0, {}, response);
+        std::cout << "  Asked the server to stop." << std::endl;
+    }
+    std::cout << std::endl;
+    return 0;
+}
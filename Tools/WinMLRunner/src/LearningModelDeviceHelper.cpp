@@ -111,7 +111,7 @@ void PopulateLearningModelDeviceList(CommandLineArgs& args, std::vector<Learning
                     com_ptr<IDXCoreAdapter> spAdapter = nullptr;
                     com_ptr<IDXCoreAdapter> currAdapter = nullptr;
                     bool chosenAdapterFound = false;
-                    printf("Printing available adapters..\n");
+                    ConsolePrintf("Printing available adapters..\n");
                     for (UINT i = 0; i < spAdapterList->GetAdapterCount(); i++)
                     {
                         THROW_IF_FAILED(spAdapterList->GetAdapter(i, currAdapter.put()));
@@ -127,7 +127,7 @@ void PopulateLearningModelDeviceList(CommandLineArgs& args, std::vector<Learning
                                                                  driverDescriptionSize, driverDescription));
                         if (isHardware)
                         {
-                            printf("Description: %s\n", driverDescription);
+                            ConsolePrintf("Description: %s\n", driverDescription);
                         }
                         if (!adapterName.empty() && !chosenAdapterFound)
                         {
@@ -157,7 +157,7 @@ void PopulateLearningModelDeviceList(CommandLineArgs& args, std::vector<Learning
                     CHAR* driverDescription = new CHAR[driverDescriptionSize];
                     spAdapter->GetProperty(DXCoreAdapterProperty::DriverDescription, driverDescriptionSize,
                                            driverDescription);
-                    printf("Using adapter : %s\n", driverDescription);
+                    ConsolePrintf("Using adapter : %s\n", driverDescription);
                     free(driverDescription);
                     IUnknown* pAdapter = spAdapter.get();
                     com_ptr<IDXGIAdapter> spDxgiAdapter;
@@ -232,7 +232,7 @@ void PopulateLearningModelDeviceList(CommandLineArgs& args, std::vector<Learning
             }
             catch (...)
             {
-                printf("Creating LearningModelDevice failed!");
+                ConsolePrintf("Creating LearningModelDevice failed!");
                 throw;
             }
         }
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Peak floating point rate and memory bandwidth of the CPU, measured once by microbenchmarks, as the roof that
+// -perf compares achieved GFLOP/s against.
+//
+// The compute roof runs independent chains of fused multiply-adds on every thread: 256-bit FMA when the CPU and OS
+// support AVX2 and FMA, SSE2 multiply and add otherwise on x64, and plain C++ elsewhere. The memory roof sums a
+// buffer much larger than any cache on every thread. Each is the best of a few short trials.
+namespace MachinePeak
+{
+    struct Peak
+    {
+        unsigned threads = 0;
+        double gflops = 0;
+        double gigabytesPerSecond = 0;
+
+        // The roofline: the best GFLOP/s a workload of the given operations per byte can reach on this machine.
+        double Attainable(double intensity) const { return (std::min)(gflops, intensity * gigabytesPerSecond); }
+    };
+
+    namespace Details
+    {
+        constexpr int Chains = 10;
+        constexpr uint64_t Iterations = 1 << 22;
+        constexpr size_t BandwidthBytes = size_t(256) << 20;
+        constexpr int Trials = 3;
+
+#if defined(_M_X64) || defined(__x86_64__)
+#if defined(_MSC_VER)
+#define MACHINEPEAK_AVX2_TARGET
+        inline bool HasAvx2Fma()
+        {
+            int info[4];
+            __cpuid(info, 1);
+            bool fma = (info[2] & (1 << 12)) != 0;
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+            {
+                return false;
+            }
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+        }
+#else
+#define MACHINEPEAK_AVX2_TARGET __attribute__((target("avx2,fma")))
+        inline bool HasAvx2Fma() { return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"); }
+#endif
+
+        // Floating point operations done, returned through sink so the loop is not optimized away.
+        MACHINEPEAK_AVX2_TARGET inline double FmaAvx2(float* sink)
+        {
+            __m256 accumulators[Chains];
+            for (int i = 0; i < Chains; i++)
+            {
+                accumulators[i] = _mm256_set1_ps(static_cast<float>(i));
+            }
+            const __m256 multiplier = _mm256_set1_ps(0.999999f);
+            const __m256 addend = _mm256_set1_ps(1e-7f);
+            for (uint64_t iteration = 0; iteration < Iterations; iteration++)
+            {
+                for (int i = 0; i < Chains; i++)
+                {
+                    accumulators[i] = _mm256_fmadd_ps(accumulators[i], multiplier, addend);
+                }
+            }
+            __m256 sum = accumulators[0];
+            for (int i = 1; i < Chains; i++)
+            {
+                sum = _mm256_add_ps(sum, accumulators[i]);
+            }
+            *sink = _mm256_cvtss_f32(sum);
+            return 2.0 * 8 * Chains * Iterations;
+        }
+#undef MACHINEPEAK_AVX2_TARGET
+
+        inline double MultiplyAddSse2(float* sink)
+        {
+            __m128 accumulators[Chains];
+            for (int i = 0; i < Chains; i++)
+            {
+                accumulators[i] = _mm_set1_ps(static_cast<float>(i));
+            }
+            const __m128 multiplier = _mm_set1_ps(0.999999f);
+            const __m128 addend = _mm_set1_ps(1e-7f);
+            for (uint64_t iteration = 0; iteration < Iterations; iteration++)
+            {
+                for (int i = 0; i < Chains; i++)
+                {
+                    accumulators[i] = _mm_add_ps(_mm_mul_ps(accumulators[i], multiplier), addend);
+                }
+            }
+            __m128 sum = accumulators[0];
+            for (int i = 1; i < Chains; i++)
+            {
+                sum = _mm_add_ps(sum, accumulators[i]);
+            }
+            *sink = _mm_cvtss_f32(sum);
+            return 2.0 * 4 * Chains * Iterations;
+        }
+
+        inline double MultiplyAdd(float* sink)
+        {
+            static const bool hasAvx2Fma = HasAvx2Fma();
+            return hasAvx2Fma ? FmaAvx2(sink) : MultiplyAddSse2(sink);
+        }
+#else
+        inline double MultiplyAdd(float* sink)
+        {
+            constexpr int Lanes = 8;
+            float accumulators[Chains][Lanes];
+            for (int i = 0; i < Chains; i++)
+            {
+                std::fill(accumulators[i], accumulators[i] + Lanes, static_cast<float>(i));
+            }
+            for (uint64_t iteration = 0; iteration < Iterations; iteration++)
+            {
+                for (int i = 0; i < Chains; i++)
+                {
+                    for (int lane = 0; lane < Lanes; lane++)
+                    {
+                        accumulators[i][lane] = accumulators[i][lane] * 0.999999f + 1e-7f;
+                    }
+                }
+            }
+            float sum = 0;
+            for (int i = 0; i < Chains; i++)
+            {
+                for (int lane = 0; lane < Lanes; lane++)
+                {
+                    sum += accumulators[i][lane];
+                }
+            }
+            *sink = sum;
+            return 2.0 * Lanes * Chains * Iterations;
+        }
+#endif
+
+        // Runs work on every thread at once and returns the wall time in seconds.
+        inline double RunOnThreads(unsigned threads, const std::function<void(unsigned)>& work)
+        {
+            std::vector<std::thread> workers;
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned thread = 1; thread < threads; thread++)
+            {
+                workers.emplace_back(work, thread);
+            }
+            work(0);
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        inline double MeasureGflops(unsigned threads)
+        {
+            std::vector<float> sinks(threads);
+            std::vector<double> flops(threads);
+            double best = 0;
+            for (int trial = 0; trial < Trials; trial++)
+            {
+                double seconds =
+                    RunOnThreads(threads, [&](unsigned thread) { flops[thread] = MultiplyAdd(&sinks[thread]); });
+                double total = 0;
+                for (double count : flops)
+                {
+                    total += count;
+                }
+                best = (std::max)(best, total / seconds / 1e9);
+            }
+            return best;
+        }
+
+        inline double MeasureBandwidth(unsigned threads)
+        {
+            std::vector<uint64_t> buffer(BandwidthBytes / sizeof(uint64_t));
+            size_t slice = buffer.size() / threads;
+            std::vector<uint64_t> sums(threads);
+            // Every thread touches its own slice first so that the pages are committed before timing.
+            RunOnThreads(threads, [&](unsigned thread) {
+                std::fill(buffer.begin() + thread * slice, buffer.begin() + (thread + 1) * slice, thread + 1);
+            });
+            double best = 0;
+            for (int trial = 0; trial < Trials; trial++)
+            {
+                double seconds = RunOnThreads(threads, [&](unsigned thread) {
+                    const uint64_t* data = buffer.data() + thread * slice;
+                    uint64_t partial[4] = {};
+                    for (size_t i = 0; i + 4 <= slice; i += 4)
+                    {
+                        partial[0] += data[i];
+                        partial[1] += data[i + 1];
+                        partial[2] += data[i + 2];
+                        partial[3] += data[i + 3];
+                    }
+                    sums[thread] = partial[0] + partial[1] + partial[2] + partial[3];
+                });
+                best = (std::max)(best, static_cast<double>(slice * threads * sizeof(uint64_t)) / seconds / 1e9);
+            }
+            return best;
+        }
+    }
+
+    // Takes about a second; threads 0 uses every hardware thread.
+    inline Peak Measure(unsigned threads = 0)
+    {
+        Peak peak;
+        peak.threads = threads != 0 ? threads : (std::max)(std::thread::hardware_concurrency(), 1u);
+        peak.gflops = Details::MeasureGflops(peak.threads);
+        peak.gigabytesPerSecond = Details::MeasureBandwidth(peak.threads);
+        return peak;
+    }
+}
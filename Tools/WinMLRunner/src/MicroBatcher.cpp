@@ -0,0 +1,210 @@
+#include "MicroBatcher.h"
+#include "Windows.AI.MachineLearning.Native.h"
+
+MicroBatcher::MicroBatcher(const LearningModel& model, const LearningModelDevice& device,
+                           const MicroBatcherOptions& options)
+    : m_model(model), m_device(device), m_options(options)
+{
+    if (m_options.MaxBatchSize == 0)
+    {
+        throw hresult_invalid_argument(L"MicroBatcher: MaxBatchSize must be at least 1.");
+    }
+    if (m_model.InputFeatures().Size() != 1)
+    {
+        throw hresult_invalid_argument(L"MicroBatcher: only models with a single input are supported.");
+    }
+
+    auto inputDescriptor = m_model.InputFeatures().GetAt(0).try_as<TensorFeatureDescriptor>();
+    if (!inputDescriptor || inputDescriptor.TensorKind() != TensorKind::Float)
+    {
+        throw hresult_invalid_argument(L"MicroBatcher: the model input must be a float tensor.");
+    }
+    auto shape = inputDescriptor.Shape();
+    if (shape.Size() == 0 || shape.GetAt(0) != -1)
+    {
+        throw hresult_invalid_argument(L"MicroBatcher: the model input must have a free batch dimension.");
+    }
+    for (uint32_t dim = 1; dim < shape.Size(); dim++)
+    {
+        if (shape.GetAt(dim) <= 0)
+        {
+            throw hresult_invalid_argument(L"MicroBatcher: only the batch dimension of the input may be free.");
+        }
+        m_exampleShape.push_back(shape.GetAt(dim));
+        m_inputElementCount *= static_cast<size_t>(shape.GetAt(dim));
+    }
+    m_inputName = inputDescriptor.Name();
+
+    for (auto&& output : m_model.OutputFeatures())
+    {
+        auto outputDescriptor = output.try_as<TensorFeatureDescriptor>();
+        if (!outputDescriptor || outputDescriptor.TensorKind() != TensorKind::Float)
+        {
+            throw hresult_invalid_argument(L"MicroBatcher: every model output must be a float tensor.");
+        }
+    }
+
+    m_scheduler = std::thread([this]() { SchedulerLoop(); });
+}
+
+MicroBatcher::~MicroBatcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond_var.notify_all();
+    // The scheduler drains whatever is still queued before exiting.
+    m_scheduler.join();
+}
+
+std::future<MicroBatchResult> MicroBatcher::Submit(std::vector<float> input)
+{
+    if (input.size() != m_inputElementCount)
+    {
+        throw hresult_invalid_argument(L"MicroBatcher: input size is different from what the model expects.");
+    }
+
+    Request request;
+    request.Input = std::move(input);
+    request.EnqueueTime = std::chrono::steady_clock::now();
+    auto future = request.Promise.get_future();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_stop)
+        {
+            throw hresult_illegal_method_call(L"MicroBatcher: Submit called during destruction.");
+        }
+        m_queue.push_back(std::move(request));
+    }
+    m_cond_var.notify_one();
+    return future;
+}
+
+void MicroBatcher::SchedulerLoop()
+{
+    while (true)
+    {
+        std::vector<Request> batch;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cond_var.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty())
+            {
+                // Stopping and nothing left to drain.
+                break;
+            }
+
+            // Hold the batch open until it is full or its oldest request has waited MaxWait.
+            auto deadline = m_queue.front().EnqueueTime + m_options.MaxWait;
+            m_cond_var.wait_until(lock, deadline,
+                                  [this] { return m_stop || m_queue.size() >= m_options.MaxBatchSize; });
+
+            size_t batchSize = (std::min)(m_queue.size(), static_cast<size_t>(m_options.MaxBatchSize));
+            batch.reserve(batchSize);
+            for (size_t i = 0; i < batchSize; i++)
+            {
+                batch.push_back(std::move(m_queue.front()));
+                m_queue.pop_front();
+            }
+        }
+        EvaluateBatch(batch);
+    }
+}
+
+MicroBatcher::CachedSession& MicroBatcher::GetSession(uint32_t batchSize)
+{
+    auto it = m_sessions.find(batchSize);
+    if (it != m_sessions.end())
+    {
+        return it->second;
+    }
+
+    LearningModelSessionOptions sessionOptions;
+    sessionOptions.BatchSizeOverride(batchSize);
+    CachedSession cached;
+    cached.Session = LearningModelSession(m_model, m_device, sessionOptions);
+    cached.Binding = LearningModelBinding(cached.Session);
+    m_numSessions++;
+    return m_sessions.emplace(batchSize, cached).first->second;
+}
+
+static void GetTensorData(const TensorFloat& tensor, std::vector<float>& cpuCopy, const float*& data, size_t& size)
+{
+    // Outputs of CPU sessions expose their buffer directly; otherwise fall back to a copy.
+    try
+    {
+        com_ptr<ITensorNative> tensorNative = tensor.as<ITensorNative>();
+        BYTE* buffer = nullptr;
+        uint32_t capacity = 0;
+        check_hresult(tensorNative->GetBuffer(&buffer, &capacity));
+        data = reinterpret_cast<const float*>(buffer);
+        size = capacity / sizeof(float);
+    }
+    catch (hresult_error const&)
+    {
+        auto view = tensor.GetAsVectorView();
+        cpuCopy.assign(begin(view), end(view));
+        data = cpuCopy.data();
+        size = cpuCopy.size();
+    }
+}
+
+void MicroBatcher::EvaluateBatch(std::vector<Request>& batch)
+{
+    uint32_t batchSize = static_cast<uint32_t>(batch.size());
+    auto batchStart = std::chrono::steady_clock::now();
+    try
+    {
+        CachedSession& cached = GetSession(batchSize);
+
+        std::vector<int64_t> batchShape = { static_cast<int64_t>(batchSize) };
+        batchShape.insert(batchShape.end(), m_exampleShape.begin(), m_exampleShape.end());
+        TensorFloat input = TensorFloat::Create(batchShape);
+        com_ptr<ITensorNative> inputNative = input.as<ITensorNative>();
+        float* inputData = nullptr;
+        uint32_t inputCapacity = 0;
+        check_hresult(inputNative->GetBuffer(reinterpret_cast<BYTE**>(&inputData), &inputCapacity));
+        for (uint32_t i = 0; i < batchSize; i++)
+        {
+            std::copy(batch[i].Input.begin(), batch[i].Input.end(), inputData + i * m_inputElementCount);
+        }
+
+        cached.Binding.Clear();
+        cached.Binding.Bind(m_inputName, input);
+        auto result = cached.Session.Evaluate(cached.Binding, L"");
+
+        std::vector<MicroBatchResult> results(batchSize);
+        for (auto&& output : m_model.OutputFeatures())
+        {
+            auto tensor = result.Outputs().Lookup(output.Name()).as<TensorFloat>();
+            std::vector<float> cpuCopy;
+            const float* data = nullptr;
+            size_t size = 0;
+            GetTensorData(tensor, cpuCopy, data, size);
+
+            size_t sliceSize = size / batchSize;
+            for (uint32_t i = 0; i < batchSize; i++)
+            {
+                results[i].Outputs.emplace_back(data + i * sliceSize, data + (i + 1) * sliceSize);
+            }
+        }
+
+        m_numBatches++;
+        m_numRequests += batchSize;
+        for (uint32_t i = 0; i < batchSize; i++)
+        {
+            results[i].BatchSize = batchSize;
+            results[i].QueueMilliseconds =
+                std::chrono::duration<double, std::milli>(batchStart - batch[i].EnqueueTime).count();
+            batch[i].Promise.set_value(std::move(results[i]));
+        }
+    }
+    catch (...)
+    {
+        for (auto& request : batch)
+        {
+            request.Promise.set_exception(std::current_exception());
+        }
+    }
+}
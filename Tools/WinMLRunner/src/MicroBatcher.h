@@ -0,0 +1,99 @@
+#pragma once
+
+#include "common.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <mutex>
+#include <thread>
+
+using namespace winrt::Windows::AI::MachineLearning;
+
+struct MicroBatcherOptions
+{
+    // Largest batch the scheduler will form.
+    uint32_t MaxBatchSize = 8;
+    // Longest time the oldest queued request waits for others to join its batch.
+    std::chrono::microseconds MaxWait = std::chrono::milliseconds(2);
+};
+
+struct MicroBatchResult
+{
+    // This request's slice of every model output, in the order of LearningModel::OutputFeatures.
+    std::vector<std::vector<float>> Outputs;
+    // Size of the batch the request was evaluated in.
+    uint32_t BatchSize = 0;
+    // Time from Submit until the request's batch started evaluating.
+    double QueueMilliseconds = 0;
+};
+
+// Serves single-example requests against a model whose only input is a float tensor with a free batch dimension.
+// A scheduler thread coalesces queued requests into one batch of up to MaxBatchSize, evaluates it once and scatters
+// the output slices back to the callers' futures. One session per batch size is created on first use and cached.
+class MicroBatcher
+{
+public:
+    MicroBatcher(const LearningModel& model, const LearningModelDevice& device, const MicroBatcherOptions& options);
+    ~MicroBatcher();
+    MicroBatcher(const MicroBatcher&) = delete;
+    MicroBatcher& operator=(const MicroBatcher&) = delete;
+
+    // Queues one example; input must hold InputElementCount() floats.
+    std::future<MicroBatchResult> Submit(std::vector<float> input);
+
+    size_t InputElementCount() const { return m_inputElementCount; }
+    // Shape of one example: the model input shape without its batch dimension.
+    const std::vector<int64_t>& ExampleShape() const { return m_exampleShape; }
+    uint64_t NumBatches() const { return m_numBatches; }
+    uint64_t NumRequests() const { return m_numRequests; }
+    size_t NumSessions() const { return m_numSessions; }
+    // Requests submitted but not yet taken into a batch.
+    size_t QueueDepth()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queue.size();
+    }
+
+private:
+    struct Request
+    {
+        std::vector<float> Input;
+        std::promise<MicroBatchResult> Promise;
+        std::chrono::steady_clock::time_point EnqueueTime;
+    };
+
+    struct CachedSession
+    {
+        LearningModelSession Session = nullptr;
+        LearningModelBinding Binding = nullptr;
+    };
+
+    void SchedulerLoop();
+    void EvaluateBatch(std::vector<Request>& batch);
+    CachedSession& GetSession(uint32_t batchSize);
+
+    LearningModel m_model;
+    LearningModelDevice m_device;
+    MicroBatcherOptions m_options;
+    std::wstring m_inputName;
+    std::vector<int64_t> m_exampleShape;
+    size_t m_inputElementCount = 1;
+
+    // Only used from the scheduler thread.
+    std::map<uint32_t, CachedSession> m_sessions;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond_var;
+    std::deque<Request> m_queue;
+    bool m_stop = false;
+
+    std::atomic<uint64_t> m_numBatches = 0;
+    std::atomic<uint64_t> m_numRequests = 0;
+    std::atomic<size_t> m_numSessions = 0;
+
+    // Started last, once every other member is initialized.
+    std::thread m_scheduler;
+};
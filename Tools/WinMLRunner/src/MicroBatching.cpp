@@ -0,0 +1,129 @@
+#include <iomanip>
+#include <random>
+#include <thread>
+
+#include "Windows.h"
+#include "common.h"
+#include "MicroBatcher.h"
+#include "Scenarios.h"
+#include "Statistics.h"
+
+using namespace winrt;
+using namespace winrt::Windows::AI::MachineLearning;
+
+struct ServingStats
+{
+    double throughput = 0;
+    double averageBatchSize = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+};
+
+// Closed loop: each client submits one request, waits for its result and submits the next.
+static ServingStats ServeClients(MicroBatcher& batcher, unsigned num_clients, unsigned requests_per_client)
+{
+    std::vector<std::vector<double>> latencies(num_clients);
+    std::vector<std::exception_ptr> errors(num_clients);
+    uint64_t batchesBefore = batcher.NumBatches();
+    uint64_t requestsBefore = batcher.NumRequests();
+
+    Timer wallClock;
+    wallClock.Start();
+    std::vector<std::thread> clients;
+    for (unsigned client = 0; client < num_clients; client++)
+    {
+        clients.emplace_back([&, client]() {
+            try
+            {
+                std::mt19937 generator(client);
+                std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+                std::vector<float> input(batcher.InputElementCount());
+                for (unsigned request = 0; request < requests_per_client; request++)
+                {
+                    std::generate(input.begin(), input.end(), [&]() { return distribution(generator); });
+                    Timer timer;
+                    timer.Start();
+                    batcher.Submit(input).get();
+                    latencies[client].push_back(timer.Stop());
+                }
+            }
+            catch (...)
+            {
+                errors[client] = std::current_exception();
+            }
+        });
+    }
+    for (auto& client : clients)
+    {
+        client.join();
+    }
+    double elapsed = wallClock.Stop();
+
+    for (auto& error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::vector<double> allLatencies;
+    for (auto& clientLatencies : latencies)
+    {
+        allLatencies.insert(allLatencies.end(), clientLatencies.begin(), clientLatencies.end());
+    }
+    std::sort(allLatencies.begin(), allLatencies.end());
+
+    ServingStats stats;
+    uint64_t batches = batcher.NumBatches() - batchesBefore;
+    uint64_t requests = batcher.NumRequests() - requestsBefore;
+    stats.throughput = elapsed > 0 ? requests * 1000.0 / elapsed : 0;
+    stats.averageBatchSize = batches ? static_cast<double>(requests) / batches : 0;
+    stats.p50 = Statistics::Percentile(allLatencies, 50);
+    stats.p90 = Statistics::Percentile(allLatencies, 90);
+    stats.p99 = Statistics::Percentile(allLatencies, 99);
+    return stats;
+}
+
+void MicroBatchingBenchmark(const std::wstring& path, const LearningModelDevice& device, const std::string& device_name,
+                            unsigned max_batch_size, double max_wait_milliseconds, unsigned num_clients,
+                            unsigned requests_per_client)
+{
+    auto model = LearningModel::LoadFromFilePath(path);
+    std::wcout << L"Micro-batching benchmark for " << path << std::endl;
+    std::cout << "  Device: " << device_name << ", clients: " << num_clients
+              << ", requests per client: " << requests_per_client << std::endl;
+
+    // Batch size 1 is the baseline: every request is evaluated on its own as soon as it arrives.
+    std::vector<MicroBatcherOptions> configurations;
+    MicroBatcherOptions baseline;
+    baseline.MaxBatchSize = 1;
+    baseline.MaxWait = std::chrono::microseconds(0);
+    configurations.push_back(baseline);
+    if (max_batch_size > 1)
+    {
+        MicroBatcherOptions batched;
+        batched.MaxBatchSize = max_batch_size;
+        batched.MaxWait = std::chrono::microseconds(static_cast<int64_t>(max_wait_milliseconds * 1000));
+        configurations.push_back(batched);
+    }
+
+    std::cout << std::left << "  " << std::setw(14) << "MaxBatchSize" << std::setw(14) << "MaxWait(ms)"
+              << std::setw(20) << "Throughput(req/s)" << std::setw(12) << "AvgBatch" << std::setw(12) << "p50(ms)"
+              << std::setw(12) << "p90(ms)" << std::setw(12) << "p99(ms)" << std::endl;
+    for (const auto& options : configurations)
+    {
+        MicroBatcher batcher(model, device, options);
+        // Warm up so that the sessions for the common batch sizes exist before measuring.
+        ServeClients(batcher, num_clients, 2);
+        ServingStats stats = ServeClients(batcher, num_clients, requests_per_client);
+
+        std::cout << "  " << std::setw(14) << options.MaxBatchSize << std::setw(14)
+                  << options.MaxWait.count() / 1000.0 << std::setw(20) << std::fixed << std::setprecision(1)
+                  << stats.throughput << std::setw(12) << std::setprecision(2) << stats.averageBatchSize
+                  << std::setw(12) << std::setprecision(3) << stats.p50 << std::setw(12) << stats.p90
+                  << std::setw(12) << stats.p99 << std::defaultfloat << std::endl;
+    }
+    std::cout << std::right << std::endl;
+}
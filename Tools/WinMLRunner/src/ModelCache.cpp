@@ -0,0 +1,246 @@
+#include <filesystem>
+#include <iomanip>
+
+#include "ModelCache.h"
+
+// 64-bit FNV-1a over the file contents.
+static uint64_t HashFile(const std::wstring& path)
+{
+    std::ifstream file(std::filesystem::path(path), std::ios::binary);
+    if (!file)
+    {
+        throw hresult_invalid_argument(L"ModelCache: failed to open " + path);
+    }
+    uint64_t hash = 14695981039346656037ull;
+    std::vector<char> chunk(1 << 20);
+    while (file)
+    {
+        file.read(chunk.data(), chunk.size());
+        std::streamsize count = file.gcount();
+        for (std::streamsize i = 0; i < count; i++)
+        {
+            hash = (hash ^ static_cast<uint8_t>(chunk[i])) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+ModelCache::Handle::Handle(Handle&& other) noexcept
+    : m_cache(other.m_cache), m_entry(std::move(other.m_entry)), m_hit(other.m_hit)
+{
+    other.m_cache = nullptr;
+}
+
+ModelCache::Handle& ModelCache::Handle::operator=(Handle&& other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+        m_cache = other.m_cache;
+        m_entry = std::move(other.m_entry);
+        m_hit = other.m_hit;
+        other.m_cache = nullptr;
+    }
+    return *this;
+}
+
+ModelCache::Handle::~Handle() { Reset(); }
+
+void ModelCache::Handle::Reset()
+{
+    if (m_cache != nullptr && m_entry != nullptr)
+    {
+        m_cache->Release(m_entry);
+    }
+    m_cache = nullptr;
+    m_entry = nullptr;
+}
+
+LearningModel ModelCache::Handle::Model() const { return m_entry ? m_entry->Model.get() : nullptr; }
+
+ModelCache& ModelCache::Instance()
+{
+    static ModelCache cache;
+    return cache;
+}
+
+void ModelCache::SetCapacity(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_capacity = bytes;
+    EvictUnused(m_capacity);
+}
+
+ModelCache::Handle ModelCache::Acquire(const std::wstring& path, const Loader& loader)
+{
+    Timer timer;
+    timer.Start();
+
+    std::error_code error;
+    auto lastWriteTime = std::filesystem::last_write_time(path, error);
+    uint64_t size = error ? 0 : std::filesystem::file_size(path, error);
+    if (error)
+    {
+        // Let the loader report a missing or unreadable file the same way it does without the cache.
+        auto model = loader(path);
+        std::promise<LearningModel> promise;
+        promise.set_value(model);
+        auto entry = std::make_shared<Entry>();
+        entry->Model = promise.get_future().share();
+        entry->Ready = true;
+        return Handle(nullptr, entry, false);
+    }
+    int64_t lastWrite = static_cast<int64_t>(lastWriteTime.time_since_epoch().count());
+
+    uint64_t hash = 0;
+    bool knownVersion = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto version = m_fileVersions.find(path);
+        if (version != m_fileVersions.end() && version->second.LastWriteTime == lastWrite &&
+            version->second.Size == size)
+        {
+            hash = version->second.Hash;
+            knownVersion = true;
+        }
+    }
+    if (!knownVersion)
+    {
+        // Hashing reads the whole file once per path and version; later lookups only stat the file.
+        hash = HashFile(path);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fileVersions[path] = { lastWrite, size, hash };
+    }
+
+    std::shared_ptr<Entry> entry;
+    std::promise<LearningModel> promise;
+    bool isLoader = false;
+    bool wasReady = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto found = m_entries.find(hash);
+        if (found != m_entries.end())
+        {
+            entry = found->second;
+            wasReady = entry->Ready;
+            m_lru.splice(m_lru.begin(), m_lru, entry->LruPosition);
+        }
+        else
+        {
+            entry = std::make_shared<Entry>();
+            entry->Hash = hash;
+            entry->Size = size;
+            entry->Model = promise.get_future().share();
+            m_lru.push_front(hash);
+            entry->LruPosition = m_lru.begin();
+            m_entries.emplace(hash, entry);
+            isLoader = true;
+        }
+        entry->RefCount++;
+    }
+    // From here on the reference is owned by the handle, which releases it on every exit path.
+    Handle handle(this, entry, !isLoader);
+
+    if (isLoader)
+    {
+        try
+        {
+            promise.set_value(loader(path));
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto found = m_entries.find(hash);
+            if (found != m_entries.end() && found->second == entry)
+            {
+                m_lru.erase(entry->LruPosition);
+                m_entries.erase(found);
+            }
+            throw;
+        }
+
+        double elapsed = timer.Stop();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entry->Ready = true;
+        m_stats.ColdLoads++;
+        m_stats.ColdLoadMilliseconds += elapsed;
+        m_stats.BytesCached += entry->Size;
+        EvictUnused(m_capacity);
+        return handle;
+    }
+
+    // Waits when another caller is still loading this model and rethrows its error if the load failed.
+    entry->Model.get();
+    double elapsed = timer.Stop();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (wasReady)
+    {
+        m_stats.Hits++;
+        m_stats.HitMilliseconds += elapsed;
+    }
+    else
+    {
+        m_stats.SharedLoads++;
+        m_stats.SharedLoadMilliseconds += elapsed;
+    }
+    return handle;
+}
+
+void ModelCache::Release(const std::shared_ptr<Entry>& entry)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    entry->RefCount--;
+    if (entry->RefCount == 0)
+    {
+        EvictUnused(m_capacity);
+    }
+}
+
+void ModelCache::EvictUnused(uint64_t capacity)
+{
+    auto position = m_lru.end();
+    while (m_stats.BytesCached > capacity && position != m_lru.begin())
+    {
+        --position;
+        auto found = m_entries.find(*position);
+        const auto& entry = found->second;
+        if (!entry->Ready || entry->RefCount > 0)
+        {
+            continue;
+        }
+        m_stats.BytesCached -= entry->Size;
+        m_stats.Evictions++;
+        m_entries.erase(found);
+        position = m_lru.erase(position);
+    }
+}
+
+void ModelCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    EvictUnused(0);
+}
+
+ModelCache::Stats ModelCache::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void ModelCache::PrintStats() const
+{
+    Stats stats = GetStats();
+    auto average = [](double total, uint64_t count) { return count ? total / count : 0.0; };
+    std::cout << std::endl << "Model cache:" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  Cold loads: " << stats.ColdLoads
+              << " (average: " << average(stats.ColdLoadMilliseconds, stats.ColdLoads) << " ms)" << std::endl;
+    std::cout << "  Cache hits: " << stats.Hits << " (average: " << average(stats.HitMilliseconds, stats.Hits)
+              << " ms)" << std::endl;
+    std::cout << "  Waited on in-flight load: " << stats.SharedLoads
+              << " (average: " << average(stats.SharedLoadMilliseconds, stats.SharedLoads) << " ms)" << std::endl;
+    std::cout << "  Evictions: " << stats.Evictions << ", cached: " << BYTE_TO_MB(stats.BytesCached) << " MB"
+              << std::endl;
+    std::cout << std::defaultfloat;
+}
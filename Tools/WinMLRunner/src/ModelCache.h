@@ -0,0 +1,113 @@
+#pragma once
+
+#include "common.h"
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+using namespace winrt::Windows::AI::MachineLearning;
+
+// Process-wide cache of loaded models.
+//
+// Entries are keyed by the content hash of the model file, so two paths holding the same bytes share one
+// LearningModel. The hash of each path is remembered together with the file's last write time and size and only
+// recomputed when either changes. Concurrent requests for a model that is still loading wait for that one load
+// instead of starting their own. Models that are not referenced by any Handle are evicted least recently used first
+// once the total size of the cached model files exceeds the capacity.
+class ModelCache
+{
+    struct Entry;
+
+public:
+    struct Stats
+    {
+        uint64_t ColdLoads = 0;
+        // Requests served from a model that had already finished loading.
+        uint64_t Hits = 0;
+        // Requests that waited on a load started by another caller.
+        uint64_t SharedLoads = 0;
+        uint64_t Evictions = 0;
+        uint64_t BytesCached = 0;
+        double ColdLoadMilliseconds = 0;
+        double HitMilliseconds = 0;
+        double SharedLoadMilliseconds = 0;
+    };
+
+    // Keeps a cached model referenced, and therefore not evictable, for as long as it is alive.
+    class Handle
+    {
+    public:
+        Handle() = default;
+        Handle(Handle&& other) noexcept;
+        Handle& operator=(Handle&& other) noexcept;
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+        ~Handle();
+
+        LearningModel Model() const;
+        bool WasHit() const { return m_hit; }
+        explicit operator bool() const { return m_entry != nullptr; }
+
+    private:
+        friend class ModelCache;
+        Handle(ModelCache* cache, std::shared_ptr<Entry> entry, bool hit)
+            : m_cache(cache), m_entry(std::move(entry)), m_hit(hit)
+        {
+        }
+        void Reset();
+
+        ModelCache* m_cache = nullptr;
+        std::shared_ptr<Entry> m_entry;
+        bool m_hit = false;
+    };
+
+    using Loader = std::function<LearningModel(const std::wstring& path)>;
+
+    static ModelCache& Instance();
+
+    void SetCapacity(uint64_t bytes);
+
+    // Returns the cached model for path, calling loader on a miss. Exceptions thrown by loader propagate to the
+    // caller and to every request that was waiting on the same load; nothing is cached for a failed load.
+    Handle Acquire(const std::wstring& path, const Loader& loader);
+
+    // Drops every model that is not currently referenced.
+    void Clear();
+
+    Stats GetStats() const;
+    void PrintStats() const;
+
+private:
+    struct Entry
+    {
+        uint64_t Hash = 0;
+        uint64_t Size = 0;
+        std::shared_future<LearningModel> Model;
+        bool Ready = false;
+        uint32_t RefCount = 0;
+        std::list<uint64_t>::iterator LruPosition;
+    };
+
+    struct FileVersion
+    {
+        int64_t LastWriteTime = 0;
+        uint64_t Size = 0;
+        uint64_t Hash = 0;
+    };
+
+    ModelCache() = default;
+    void Release(const std::shared_ptr<Entry>& entry);
+    // Requires m_mutex to be held.
+    void EvictUnused(uint64_t capacity);
+
+    mutable std::mutex m_mutex;
+    uint64_t m_capacity = 1024ull * 1024 * 1024;
+    std::unordered_map<std::wstring, FileVersion> m_fileVersions;
+    std::unordered_map<uint64_t, std::shared_ptr<Entry>> m_entries;
+    // Content hashes, most recently used first.
+    std::list<uint64_t> m_lru;
+    Stats m_stats;
+};
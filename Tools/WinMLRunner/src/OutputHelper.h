@@ -1,6 +1,13 @@
 #pragma once
 #include "Common.h"
 #include "CommandLineArgs.h"
+#include "ConsoleCapture.h"
+#include "EnvironmentMonitor.h"
+#include "MachinePeak.h"
+#include "OnnxCostModel.h"
+#include "OnnxFloat16.h"
+#include "OnnxInspector.h"
+#include "SchedulingTelemetry.h"
 #include <fstream>
 #include <ctime>
 #include <locale>
@@ -48,45 +55,49 @@ inline size_t hash_data(void const* ptr, size_t const bytes) noexcept
 class OutputHelper
 {
 public:
-    OutputHelper(int numIterations)
+    OutputHelper(int numIterations) { SetNumIterations(numIterations); }
+
+    // Makes room for the results of numIterations iterations, which start over from zero.
+    void SetNumIterations(int numIterations)
     {
-        m_clockLoadTimes.resize(numIterations, 0.0);
-        m_clockBindTimes.resize(numIterations, 0.0);
-        m_clockEvalTimes.resize(numIterations, 0.0);
-        m_CPUWorkingDiff.resize(numIterations, 0.0);
-        m_CPUWorkingStart.resize(numIterations, 0.0);
-        m_GPUSharedDiff.resize(numIterations, 0.0);
-        m_GPUDedicatedDiff.resize(numIterations, 0.0);
-        m_GPUSharedStart.resize(numIterations, 0.0);
-        m_outputResult.resize(numIterations, "");
-        m_outputTensorHash.resize(numIterations, 0);
+        m_clockLoadTimes.assign(numIterations, 0.0);
+        m_clockBindTimes.assign(numIterations, 0.0);
+        m_clockEvalTimes.assign(numIterations, 0.0);
+        m_CPUWorkingDiff.assign(numIterations, 0.0);
+        m_CPUWorkingStart.assign(numIterations, 0.0);
+        m_GPUSharedDiff.assign(numIterations, 0.0);
+        m_GPUDedicatedDiff.assign(numIterations, 0.0);
+        m_GPUSharedStart.assign(numIterations, 0.0);
+        m_outputResult.assign(numIterations, "");
+        m_outputTensorHash.assign(numIterations, 0);
+        m_schedulingTelemetry.assign(numIterations, SchedulingTelemetry::Iteration());
     }
 
     void PrintLoadingInfo(const std::wstring& modelPath) const
     {
-        wprintf(L"Loading model (path = %s)...\n", modelPath.c_str());
+        ConsoleWPrintf(L"Loading model (path = %s)...\n", modelPath.c_str());
     }
 
     void PrintBindingInfo(uint32_t iteration, DeviceType deviceType, InputBindingType inputBindingType,
                           InputDataType inputDataType, DeviceCreationLocation deviceCreationLocation,
                           const std::string& status) const
     {
-        printf("Binding (device = %s, iteration = %d, inputBinding = %s, inputDataType = %s, deviceCreationLocation = "
-               "%s)...%s\n",
-               TypeHelper::Stringify(deviceType).c_str(), iteration, TypeHelper::Stringify(inputBindingType).c_str(),
-               TypeHelper::Stringify(inputDataType).c_str(), TypeHelper::Stringify(deviceCreationLocation).c_str(),
-               status.c_str());
+        ConsolePrintf("Binding (device = %s, iteration = %d, inputBinding = %s, inputDataType = %s, "
+                      "deviceCreationLocation = %s)...%s\n",
+                      TypeHelper::Stringify(deviceType).c_str(), iteration,
+                      TypeHelper::Stringify(inputBindingType).c_str(), TypeHelper::Stringify(inputDataType).c_str(),
+                      TypeHelper::Stringify(deviceCreationLocation).c_str(), status.c_str());
     }
 
     void PrintEvaluatingInfo(uint32_t iteration, DeviceType deviceType, InputBindingType inputBindingType,
                              InputDataType inputDataType, DeviceCreationLocation deviceCreationLocation,
                              const std::string& status) const
     {
-        printf("Evaluating (device = %s, iteration = %d, inputBinding = %s, inputDataType = %s, deviceCreationLocation "
-               "= %s)...%s\n",
-               TypeHelper::Stringify(deviceType).c_str(), iteration, TypeHelper::Stringify(inputBindingType).c_str(),
-               TypeHelper::Stringify(inputDataType).c_str(), TypeHelper::Stringify(deviceCreationLocation).c_str(),
-               status.c_str());
+        ConsolePrintf("Evaluating (device = %s, iteration = %d, inputBinding = %s, inputDataType = %s, "
+                      "deviceCreationLocation = %s)...%s\n",
+                      TypeHelper::Stringify(deviceType).c_str(), iteration,
+                      TypeHelper::Stringify(inputBindingType).c_str(), TypeHelper::Stringify(inputDataType).c_str(),
+                      TypeHelper::Stringify(deviceCreationLocation).c_str(), status.c_str());
     }
 
     void PrintModelInfo(std::wstring modelPath, LearningModel model) const
@@ -117,6 +128,144 @@ public:
         std::cout << std::endl;
     }
 
+    // The -InspectOnly counterpart of PrintModelInfo, from a summary of the .onnx file rather than a loaded model.
+    void PrintModelSummary(const std::wstring& modelPath, const Onnx::ModelSummary& summary,
+                           double inspectMilliseconds) const
+    {
+        std::cout << "=================================================================" << std::endl;
+        std::cout << "Name: " << summary.graphName << std::endl;
+        std::cout << "Author: " << summary.producerName << std::endl;
+        std::cout << "Version: " << summary.modelVersion << std::endl;
+        std::cout << "Domain: " << summary.domain << std::endl;
+        std::cout << "Description: " << summary.docString << std::endl;
+        std::wcout << "Path: " << modelPath << std::endl;
+        std::cout << "Support FP16: " << std::boolalpha << summary.HasFloat16Input() << std::endl;
+        std::cout << "Producer: " << summary.producerName << " " << summary.producerVersion << std::endl;
+        std::cout << "IR version: " << summary.irVersion << std::endl;
+        std::cout << "Opsets:";
+        for (const auto& opset : summary.opsetImports)
+        {
+            std::cout << " " << (opset.domain.empty() ? "ai.onnx" : opset.domain) << " " << opset.version;
+        }
+        std::cout << std::endl;
+        for (const auto& entry : summary.metadata)
+        {
+            std::cout << "Metadata: " << entry.first << " = " << entry.second << std::endl;
+        }
+        std::cout << std::fixed << std::setprecision(2) << "File size: " << summary.fileSize / (1024.0 * 1024.0)
+                  << " MB, inspected in " << inspectMilliseconds << " ms" << std::defaultfloat << std::endl;
+
+        std::cout << std::endl;
+        std::cout << "Inputs:" << std::endl;
+        for (const auto& input : summary.inputs)
+        {
+            std::cout << "  " << input.name << ": " << input.type << std::endl;
+        }
+        std::cout << "Outputs:" << std::endl;
+        for (const auto& output : summary.outputs)
+        {
+            std::cout << "  " << output.name << ": " << output.type << std::endl;
+        }
+
+        std::vector<std::pair<std::string, size_t>> operators(summary.operators.begin(), summary.operators.end());
+        std::stable_sort(operators.begin(), operators.end(),
+                         [](const auto& a, const auto& b) { return a.second > b.second; });
+        std::cout << "Operators (" << summary.nodeCount << " nodes";
+        if (summary.subgraphCount > 0)
+        {
+            std::cout << ", " << summary.subgraphCount << " subgraphs";
+        }
+        std::cout << "):" << std::endl;
+        for (const auto& op : operators)
+        {
+            std::cout << "  " << std::left << std::setw(32) << op.first << std::right << op.second << std::endl;
+        }
+        std::cout << "Element types:";
+        for (const auto& type : summary.elementTypes)
+        {
+            std::cout << " " << Onnx::DataTypeName(type.first) << " (" << type.second << ")";
+        }
+        std::cout << std::endl;
+
+        size_t externalCount = std::count_if(summary.initializers.begin(), summary.initializers.end(),
+                                             [](const auto& initializer) { return initializer.external; });
+        std::cout << std::fixed << std::setprecision(2) << "Initializers: " << summary.initializers.size() << ", "
+                  << summary.initializerBytes / (1024.0 * 1024.0) << " MB" << std::defaultfloat;
+        if (externalCount > 0)
+        {
+            std::cout << " (" << externalCount << " in external files)";
+        }
+        if (summary.sparseInitializerCount > 0)
+        {
+            std::cout << ", " << summary.sparseInitializerCount << " sparse";
+        }
+        std::cout << std::endl;
+        for (const auto* initializer : summary.LargestInitializers(10))
+        {
+            std::string shape = "[";
+            for (size_t i = 0; i < initializer->dims.size(); i++)
+            {
+                shape += (i > 0 ? "," : "") + std::to_string(initializer->dims[i]);
+            }
+            std::cout << "  " << std::left << std::setw(40) << initializer->name << std::setw(24)
+                      << Onnx::DataTypeName(initializer->dataType) + shape + "]" << std::right
+                      << initializer->byteSize << " bytes" << std::endl;
+        }
+        std::cout << "=================================================================" << std::endl;
+        std::cout << std::endl;
+    }
+
+    // The static cost of one evaluate with free dimensions set to 1, and the nodes that do most of the work.
+    void PrintModelCost(const Onnx::ModelCost& cost) const
+    {
+        std::cout << std::fixed << std::setprecision(3) << "Cost per evaluate: " << cost.flops / 1e9 << " GFLOP, "
+                  << cost.parameterBytes / (1024.0 * 1024.0) << " MB of parameters, "
+                  << cost.activationBytes / (1024.0 * 1024.0) << " MB of activations, " << cost.Intensity()
+                  << " FLOP/byte" << std::defaultfloat << std::endl;
+        if (cost.uncostedNodes > 0)
+        {
+            std::cout << "  " << cost.uncostedNodes << " of " << cost.nodes.size()
+                      << " nodes could not be costed and count as no work" << std::endl;
+        }
+        for (const auto* node : cost.HeaviestNodes(10))
+        {
+            if (node->flops <= 0)
+            {
+                break;
+            }
+            std::cout << "  " << std::left << std::setw(40) << node->name << std::setw(24) << node->opType
+                      << std::right << std::fixed << std::setprecision(3) << node->flops / 1e9 << " GFLOP ("
+                      << std::setprecision(1) << 100.0 * node->flops / cost.flops << "%)" << std::defaultfloat
+                      << std::endl;
+        }
+        std::cout << "=================================================================" << std::endl;
+        std::cout << std::endl;
+    }
+
+    void PrintFloat16Report(const std::wstring& outputPath, const Onnx::Float16Report& report,
+                            double convertTime) const
+    {
+        std::wcout << L"Converted to fp16: " << outputPath << std::endl;
+        std::cout << std::fixed << std::setprecision(3) << "  " << report.inputBytes / (1024.0 * 1024.0) << " MB -> "
+                  << report.outputBytes / (1024.0 * 1024.0) << " MB in " << convertTime << " ms" << std::defaultfloat
+                  << std::endl;
+        std::cout << "  " << report.convertedTensors << " tensors converted, " << report.keptTensors
+                  << " kept in fp32, " << report.keptNodes << " nodes kept in fp32 with " << report.insertedCasts
+                  << " Casts inserted" << std::endl;
+        if (report.saturatedValues > 0)
+        {
+            std::cout << "  " << report.saturatedValues << " values were beyond the float16 range and clamped to "
+                      << "+-65504" << std::endl;
+        }
+    }
+
+    void PrintMachinePeak(const MachinePeak::Peak& peak) const
+    {
+        std::cout << std::fixed << std::setprecision(1) << "CPU peak: " << peak.gflops << " GFLOP/s, "
+                  << peak.gigabytesPerSecond << " GB/s on " << peak.threads << " threads" << std::defaultfloat
+                  << std::endl;
+    }
+
     void PrintFeatureDescriptorInfo(const ILearningModelFeatureDescriptor& descriptor) const
     {
         // IMPORTANT: This learningModelFeatureKind array needs to match the "enum class
@@ -158,7 +307,8 @@ public:
             // valid GPU adapter
             else
             {
-                printf("Index: %d, Description: %ls\n", static_cast<int>(validAdapters.size()), pDesc.Description);
+                ConsolePrintf("Index: %d, Description: %ls\n", static_cast<int>(validAdapters.size()),
+                              pDesc.Description);
                 validAdapters.push_back(spAdapter);
             }
         }
@@ -292,11 +442,11 @@ public:
         double firstIterationPeakWorkingSet = firstLoadPeakWorkingSetUsage + firstSessionPeakWorkingSetUsage +
                                               firstBindPeakMemoryUsage + firstEvalPeakMemoryUsage;
 
-        printf("\nResults (device = %s, numIterations = %d, inputBinding = %s, inputDataType = %s, "
-               "deviceCreationLocation = %s):\n",
-               TypeHelper::Stringify(deviceType).c_str(), numIterations,
-               TypeHelper::Stringify(inputBindingType).c_str(), TypeHelper::Stringify(inputDataType).c_str(),
-               TypeHelper::Stringify(deviceCreationLocation).c_str());
+        ConsolePrintf("\nResults (device = %s, numIterations = %d, inputBinding = %s, inputDataType = %s, "
+                      "deviceCreationLocation = %s):\n",
+                      TypeHelper::Stringify(deviceType).c_str(), numIterations,
+                      TypeHelper::Stringify(inputBindingType).c_str(), TypeHelper::Stringify(inputDataType).c_str(),
+                      TypeHelper::Stringify(deviceCreationLocation).c_str());
 
         std::cout << "\nFirst Iteration Performance (load, bind, session creation, and evaluate): " << std::endl;
         std::cout << "  Load: " << loadTime << " ms" << std::endl;
@@ -368,9 +518,9 @@ public:
 
         if (numIterations > 1)
         {
-            printf("\nAverage Performance excluding first iteration. Iterations %d to %d. (Iterations greater than 1 "
-                   "only bind and evaluate)\n",
-                   2, numIterations);
+            ConsolePrintf("\nAverage Performance excluding first iteration. Iterations %d to %d. (Iterations greater "
+                          "than 1 only bind and evaluate)\n",
+                          2, numIterations);
             std::cout << "  Average Bind: " << averageBindTime << " ms" << std::endl;
             if (isPerformanceConsoleOutputVerbose)
             {
@@ -450,6 +600,145 @@ public:
         std::cout << std::endl << std::endl << std::endl;
     }
 
+    // The first frames of an allocation call site outside the C and C++ runtime, innermost first.
+    static std::string DescribeCallSite(const AllocationTracker::CallSite& site)
+    {
+        static const char* runtimePrefixes[] = { "std::",   "operator new", "malloc",      "_malloc",     "calloc",
+                                                 "_calloc", "realloc",      "_realloc",    "ucrtbase.dll", "msvcrt.dll" };
+        std::string description;
+        int described = 0;
+        for (void* frame : site.Frames)
+        {
+            if (frame == nullptr || described == 3)
+            {
+                break;
+            }
+            std::string name = AllocationTracker::DescribeFrame(frame);
+            if (std::any_of(std::begin(runtimePrefixes), std::end(runtimePrefixes),
+                            [&name](const char* prefix) { return name.rfind(prefix, 0) == 0; }))
+            {
+                continue;
+            }
+            description += (described++ == 0 ? "" : " < ") + name;
+        }
+        return description.empty() ? "C runtime" : description;
+    }
+
+    // The profiled phases the console reports on, in the order they run.
+    static const std::vector<std::pair<WINML_MODEL_TEST_PERF, const char*>>& ProfiledPhases()
+    {
+        static const std::vector<std::pair<WINML_MODEL_TEST_PERF, const char*>> phases = {
+            { LOAD_MODEL, "load" },
+            { CREATE_SESSION, "session creation" },
+            { BIND_VALUE_FIRST_RUN, "first bind" },
+            { BIND_VALUE, "bind" },
+            { EVAL_MODEL_FIRST_RUN, "first evaluate" },
+            { EVAL_MODEL, "evaluate" },
+        };
+        return phases;
+    }
+
+    // What -TrackAllocations counted in each profiled phase, per call of the phase.
+    void PrintAllocations(const Profiler<WINML_MODEL_TEST_PERF>& profiler) const
+    {
+        static const size_t TopAllocationSites = 5;
+        std::cout << "Heap allocations, per call:" << std::endl;
+        std::cout << std::fixed << std::setprecision(1);
+        for (const auto& phase : ProfiledPhases())
+        {
+            const AllocationTracker::Phase& allocations = profiler[phase.first].GetAllocations();
+            if (allocations.Intervals == 0)
+            {
+                continue;
+            }
+            double calls = static_cast<double>(allocations.Intervals);
+            std::cout << "  " << phase.second << ": " << allocations.Allocations / calls << " allocations, "
+                      << allocations.Bytes / calls / 1024 << " KB, " << allocations.Frees / calls
+                      << " frees, peak live " << allocations.PeakLiveBytes / 1024.0 << " KB ("
+                      << allocations.Intervals << (allocations.Intervals == 1 ? " call)" : " calls)") << std::endl;
+        }
+        for (const auto& phase : ProfiledPhases())
+        {
+            const AllocationTracker::Phase& allocations = profiler[phase.first].GetAllocations();
+            std::vector<AllocationTracker::CallSite> sites = allocations.TopSites(TopAllocationSites);
+            if (sites.empty())
+            {
+                continue;
+            }
+            double calls = static_cast<double>(allocations.Intervals);
+            std::cout << "\n  Top call sites of " << phase.second << " (1 in " << AllocationTracker::SampleInterval
+                      << " allocations sampled):" << std::endl;
+            for (const auto& site : sites)
+            {
+                std::cout << "    ~" << site.Samples * AllocationTracker::SampleInterval / calls << " allocations, "
+                          << site.Bytes * AllocationTracker::SampleInterval / calls / 1024 << " KB: "
+                          << DescribeCallSite(site) << std::endl;
+            }
+            if (allocations.DroppedSamples > 0)
+            {
+                std::cout << "    " << allocations.DroppedSamples << " samples of further call sites not recorded"
+                          << std::endl;
+            }
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+
+    void PrintEnvironment(const EnvironmentMonitor::Fingerprint& fingerprint, double systemLoad) const
+    {
+        std::cout << "Environment: " << fingerprint.CpuModel << ", " << fingerprint.PhysicalCores << " cores, "
+                  << fingerprint.LogicalProcessors << " logical processors, SMT " << (fingerprint.Smt ? "on" : "off")
+                  << ", power plan " << fingerprint.PowerPlan << std::endl;
+        std::cout << std::fixed << std::setprecision(2) << "  clock " << EnvironmentMonitor::ReferenceGhz()
+                  << " GHz (nominal " << fingerprint.NominalMhz / 1000.0 << " GHz), system load " << std::setprecision(1)
+                  << systemLoad << "% before the run" << std::defaultfloat << std::endl;
+    }
+
+    // Why the environment of the profiled phases deviated beyond the -CheckEnvironment thresholds, as
+    // "<phase>: <reasons>" separated by semicolons, or empty when it did not.
+    static std::string EnvironmentDeviation(const Profiler<WINML_MODEL_TEST_PERF>& profiler)
+    {
+        std::string deviation = EnvironmentMonitor::SystemDeviation();
+        for (const auto& phase : ProfiledPhases())
+        {
+            std::string reasons = EnvironmentMonitor::Deviation(profiler[phase.first].GetClock());
+            if (!reasons.empty())
+            {
+                deviation += (deviation.empty() ? "" : "; ") + std::string(phase.second) + ": " + reasons;
+            }
+        }
+        return deviation;
+    }
+
+    // The clock -CheckEnvironment sampled during each profiled phase.
+    void PrintClock(const Profiler<WINML_MODEL_TEST_PERF>& profiler) const
+    {
+        std::cout << "CPU clock in GHz, against " << std::fixed << std::setprecision(2)
+                  << EnvironmentMonitor::ReferenceGhz() << " before the run:" << std::endl;
+        for (const auto& phase : ProfiledPhases())
+        {
+            const EnvironmentMonitor::Phase& clock = profiler[phase.first].GetClock();
+            if (clock.Samples == 0)
+            {
+                continue;
+            }
+            std::cout << "  " << phase.second << ": " << clock.MinGhz << " - " << clock.MaxGhz << " in "
+                      << clock.Samples << (clock.Samples == 1 ? " sample" : " samples");
+            if (clock.Transitions > 0)
+            {
+                std::cout << ", " << clock.Transitions << " transitions";
+            }
+            if (clock.ThrottledSamples > 0)
+            {
+                std::cout << ", " << clock.ThrottledSamples << " throttled";
+            }
+            std::cout << std::endl;
+        }
+        std::string deviation = EnvironmentDeviation(profiler);
+        std::cout << std::defaultfloat << "Environment " << (deviation.empty() ? "steady" : "deviated: " + deviation)
+                  << std::endl
+                  << std::endl;
+    }
+
     static std::wstring FeatureDescriptorToString(const ILearningModelFeatureDescriptor& descriptor)
     {
         switch (descriptor.Kind())
@@ -548,6 +837,97 @@ public:
         m_GPUDedicatedDiff[iterNum] = profiler[eval].GetGpuDedicatedDiff();
     }
 
+    // Iterations past the ones this output was sized for are not kept.
+    void SaveSchedulingTelemetry(const SchedulingTelemetry::Iteration& iteration, uint32_t iterNum)
+    {
+        if (iterNum < m_schedulingTelemetry.size())
+        {
+            m_schedulingTelemetry[iterNum] = iteration;
+        }
+    }
+
+    // Compares the iterations whose evaluation took more than twice the median with the others, to tell which of the
+    // counters -SchedulingTelemetry saved go with the slow ones. The first iteration, which evaluates cold, is left
+    // out.
+    void PrintSchedulingSummary(uint32_t numIterations) const
+    {
+        std::vector<uint32_t> iterations;
+        std::vector<double> times;
+        numIterations = (std::min)(numIterations, static_cast<uint32_t>(m_schedulingTelemetry.size()));
+        for (uint32_t i = 1; i < numIterations; i++)
+        {
+            if (m_schedulingTelemetry[i].Delta.Valid)
+            {
+                iterations.push_back(i);
+                times.push_back(m_clockEvalTimes[i]);
+            }
+        }
+        if (iterations.size() < 3)
+        {
+            std::cout << "Scheduling telemetry: at least 4 iterations are needed to compare the slow ones with the rest."
+                      << std::endl;
+            return;
+        }
+        std::sort(times.begin(), times.end());
+        double median = times[times.size() / 2];
+        std::vector<uint32_t> slow;
+        std::vector<uint32_t> rest;
+        for (uint32_t i : iterations)
+        {
+            (m_clockEvalTimes[i] > 2 * median ? slow : rest).push_back(i);
+        }
+        std::cout << "Scheduling telemetry: " << slow.size() << " of " << iterations.size()
+                  << " iterations took more than twice the median evaluate time of " << std::fixed
+                  << std::setprecision(3) << median << " ms" << std::defaultfloat;
+        if (slow.empty() || rest.empty())
+        {
+            std::cout << "." << std::endl;
+            return;
+        }
+        std::cout << ". Per iteration, slow ones against the rest:" << std::endl;
+
+        const struct
+        {
+            const char* name;
+            uint64_t SchedulingTelemetry::Counters::*counter;
+        } counters[] = {
+            { "eval thread context switches", &SchedulingTelemetry::Counters::ThreadContextSwitches },
+            { "process context switches", &SchedulingTelemetry::Counters::ProcessContextSwitches },
+            { "page faults", &SchedulingTelemetry::Counters::PageFaults },
+            { "hard page faults", &SchedulingTelemetry::Counters::HardFaults },
+        };
+        for (const auto& counter : counters)
+        {
+            auto mean = [&](const std::vector<uint32_t>& group) {
+                double total = 0;
+                for (uint32_t i : group)
+                {
+                    total += static_cast<double>(m_schedulingTelemetry[i].Delta.*counter.counter);
+                }
+                return total / group.size();
+            };
+            double slowMean = mean(slow);
+            double restMean = mean(rest);
+            std::cout << "  " << counter.name << ": " << std::fixed << std::setprecision(1) << slowMean << " vs "
+                      << restMean;
+            if (restMean > 0)
+            {
+                std::cout << " (" << slowMean / restMean << "x)";
+            }
+            std::cout << std::defaultfloat << std::endl;
+        }
+        auto migrated = [&](const std::vector<uint32_t>& group) {
+            size_t count = 0;
+            for (uint32_t i : group)
+            {
+                count += m_schedulingTelemetry[i].StartProcessor != m_schedulingTelemetry[i].EndProcessor;
+            }
+            return 100.0 * count / group.size();
+        };
+        std::cout << "  ended on another CPU than they started on: " << std::fixed << std::setprecision(0)
+                  << migrated(slow) << "% vs " << migrated(rest) << "%" << std::defaultfloat << std::endl;
+    }
+
     void SaveResult(uint32_t iterationNum, std::string result, int hashcode)
     {
         m_outputResult[iterationNum] = result;
@@ -649,6 +1029,21 @@ public:
                          << "Evaluate (ms)"
                          << ",";
 
+                    if (args.IsSchedulingTelemetry())
+                    {
+                        fout << "Eval Thread Context Switches"
+                             << ","
+                             << "Process Context Switches"
+                             << ","
+                             << "Page Faults"
+                             << ","
+                             << "Hard Page Faults"
+                             << ","
+                             << "Start CPU"
+                             << ","
+                             << "End CPU"
+                             << ",";
+                    }
                     if (args.IsSaveTensor())
                     {
                         fout << "Result"
@@ -680,6 +1075,21 @@ public:
                          << m_CPUWorkingDiff[i] << "," << m_CPUWorkingStart[i] << "," << m_GPUSharedDiff[i] << ","
                          << m_GPUSharedStart[i] << "," << m_GPUDedicatedDiff[i] << "," << m_clockLoadTimes[i] << ","
                          << m_clockBindTimes[i] << "," << m_clockEvalTimes[i] << ",";
+                    if (args.IsSchedulingTelemetry())
+                    {
+                        const SchedulingTelemetry::Iteration& scheduling = m_schedulingTelemetry[i];
+                        if (scheduling.Delta.Valid)
+                        {
+                            fout << scheduling.Delta.ThreadContextSwitches << ","
+                                 << scheduling.Delta.ProcessContextSwitches << "," << scheduling.Delta.PageFaults
+                                 << "," << scheduling.Delta.HardFaults << "," << scheduling.StartProcessor << ","
+                                 << scheduling.EndProcessor << ",";
+                        }
+                        else
+                        {
+                            fout << ",,,,,,";
+                        }
+                    }
 
                     if (args.IsSaveTensor() &&
                         (args.SaveTensorMode() == L"All" || (args.SaveTensorMode() == L"First" && i == 0)))
@@ -758,10 +1168,13 @@ public:
         std::reverse(maxValues.begin(), maxValues.end());
     }
 
+    // flopsPerEvaluate is 0 when the model could not be costed, and attainableGflops is 0 when there is no measured
+    // roof for the device; the columns that need them are left empty then.
     void WritePerformanceDataToCSV(const Profiler<WINML_MODEL_TEST_PERF>& profiler, int numIterations,
                                    std::wstring model, const std::string& deviceType, const std::string& inputBinding,
                                    const std::string& inputType, const std::string& deviceCreationLocation,
-                                   const std::vector<std::pair<std::string, std::string>>& perfFileMetadata) const
+                                   const std::vector<std::pair<std::string, std::string>>& perfFileMetadata,
+                                   double flopsPerEvaluate = 0, double attainableGflops = 0) const
     {
         double averageLoadTime = profiler[LOAD_MODEL].GetAverage(CounterType::TIMER);
         double stdevLoadTime = profiler[LOAD_MODEL].GetStdev(CounterType::TIMER);
@@ -1143,7 +1556,23 @@ public:
                      << "evaluate min shared memory (MB)"
                      << ","
                      << "evaluate max shared memory (MB)"
+                     << ","
+                     << "GFLOP per evaluate"
+                     << ","
+                     << "GFLOP/s achieved"
+                     << ","
+                     << "fraction of roofline"
                      << ",";
+                for (const char* phase : { "load", "session creation", "bind", "evaluate" })
+                {
+                    fout << phase << " allocations per call," << phase << " allocated KB per call," << phase
+                         << " peak live KB,";
+                }
+                for (const char* phase : { "load", "session creation", "bind", "evaluate" })
+                {
+                    fout << phase << " min GHz," << phase << " max GHz,";
+                }
+                fout << "clock transitions,throttled samples,environment,";
                 for (auto metaDataPair : perfFileMetadata)
                 {
                     fout << metaDataPair.first << ",";
@@ -1199,6 +1628,67 @@ public:
                  << (numIterations <= 1 ? 0 : stdevEvalSharedMemoryUsage) << ","
                  << (numIterations <= 1 ? 0 : maxEvalSharedMemoryUsage) << ","
                  << (numIterations <= 1 ? 0 : minEvalSharedMemoryUsage) << ",";
+            if (flopsPerEvaluate > 0)
+            {
+                double evalTime = numIterations <= 1 ? averageFirstEvalTime : averageEvalTime;
+                double achievedGflops = evalTime > 0 ? flopsPerEvaluate / (evalTime * 1e6) : 0;
+                fout << flopsPerEvaluate / 1e9 << "," << achievedGflops << ",";
+                if (attainableGflops > 0)
+                {
+                    fout << achievedGflops / attainableGflops;
+                }
+                fout << ",";
+            }
+            else
+            {
+                fout << ",,,";
+            }
+            // Left empty without -TrackAllocations, and for bind and evaluate when only the first iteration ran.
+            for (WINML_MODEL_TEST_PERF phase : { LOAD_MODEL, CREATE_SESSION, BIND_VALUE, EVAL_MODEL })
+            {
+                const AllocationTracker::Phase& allocations = profiler[phase].GetAllocations();
+                if (AllocationTracker::IsEnabled() && allocations.Intervals > 0)
+                {
+                    fout << allocations.Allocations / static_cast<double>(allocations.Intervals) << ","
+                         << allocations.Bytes / 1024.0 / allocations.Intervals << ","
+                         << allocations.PeakLiveBytes / 1024.0 << ",";
+                }
+                else
+                {
+                    fout << ",,,";
+                }
+            }
+            // Left empty without -CheckEnvironment, and for a phase no clock sample was taken in.
+            for (WINML_MODEL_TEST_PERF phase : { LOAD_MODEL, CREATE_SESSION, BIND_VALUE, EVAL_MODEL })
+            {
+                const EnvironmentMonitor::Phase& clock = profiler[phase].GetClock();
+                if (clock.Samples > 0)
+                {
+                    fout << clock.MinGhz << "," << clock.MaxGhz << ",";
+                }
+                else
+                {
+                    fout << ",,";
+                }
+            }
+            if (EnvironmentMonitor::IsEnabled())
+            {
+                // Over every phase, the first bind and evaluate included.
+                uint32_t transitions = 0;
+                uint32_t throttledSamples = 0;
+                for (const auto& phase : ProfiledPhases())
+                {
+                    transitions += profiler[phase.first].GetClock().Transitions;
+                    throttledSamples += profiler[phase.first].GetClock().ThrottledSamples;
+                }
+                std::string deviation = EnvironmentDeviation(profiler);
+                fout << transitions << "," << throttledSamples << "," << (deviation.empty() ? "steady" : deviation)
+                     << ",";
+            }
+            else
+            {
+                fout << ",,,";
+            }
             for (auto metaDataPair : perfFileMetadata)
             {
                 fout << metaDataPair.second << ",";
@@ -1235,6 +1725,7 @@ private:
     std::vector<double> m_GPUDedicatedDiff;
     std::vector<std::string> m_outputResult;
     std::vector<int> m_outputTensorHash;
+    std::vector<SchedulingTelemetry::Iteration> m_schedulingTelemetry;
 
 #if defined(_AMD64_)
     // PIX markers only work on amd64
@@ -0,0 +1,253 @@
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+
+#include "Windows.h"
+#include "common.h"
+#include "BackendHarness.h"
+#include "ReferenceBackend.h"
+#include "ResultHelper.h"
+#include "Scenarios.h"
+
+using namespace winrt;
+using InferenceBackend::ElementType;
+
+template <typename T> static void AppendValues(std::ifstream& fileStream, size_t count, std::vector<float>& values)
+{
+    std::vector<T> buffer(count);
+    fileStream.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(count * sizeof(T)));
+    values.insert(values.end(), buffer.begin(), buffer.end());
+}
+
+// Reads a C-order NumPy array of little-endian float32, float64 or uint8 values, whatever its shape.
+static std::vector<float> ReadNpySample(const std::filesystem::path& path)
+{
+    std::ifstream fileStream(path, std::ios::binary);
+    char magic[8] = {};
+    fileStream.read(magic, sizeof(magic));
+    if (!fileStream || memcmp(magic, "\x93NUMPY", 6) != 0)
+    {
+        throw hresult_invalid_argument(L"Quantization: " + path.wstring() + L" is not a .npy file.");
+    }
+    uint32_t headerSize = 0;
+    fileStream.read(reinterpret_cast<char*>(&headerSize), magic[6] == 1 ? 2 : 4);
+    std::string header(headerSize, '\0');
+    fileStream.read(&header[0], headerSize);
+
+    auto shapeBegin = header.find('(', header.find("'shape'"));
+    auto shapeEnd = header.find(')', shapeBegin);
+    if (!fileStream || shapeBegin == std::string::npos || shapeEnd == std::string::npos ||
+        header.find("'fortran_order': True") != std::string::npos)
+    {
+        throw hresult_invalid_argument(L"Quantization: " + path.wstring() + L" is not a C-order .npy array.");
+    }
+    size_t count = 1;
+    std::stringstream shape(header.substr(shapeBegin + 1, shapeEnd - shapeBegin - 1));
+    std::string dim;
+    while (std::getline(shape, dim, ','))
+    {
+        if (dim.find_first_not_of(" ") != std::string::npos)
+        {
+            count *= std::stoull(dim);
+        }
+    }
+
+    std::vector<float> values;
+    if (header.find("'<f4'") != std::string::npos)
+    {
+        AppendValues<float>(fileStream, count, values);
+    }
+    else if (header.find("'<f8'") != std::string::npos)
+    {
+        AppendValues<double>(fileStream, count, values);
+    }
+    else if (header.find("'|u1'") != std::string::npos)
+    {
+        AppendValues<uint8_t>(fileStream, count, values);
+    }
+    else
+    {
+        throw hresult_invalid_argument(L"Quantization: " + path.wstring() +
+                                       L" holds neither float32, float64 nor uint8 values.");
+    }
+    if (!fileStream)
+    {
+        throw hresult_invalid_argument(L"Quantization: " + path.wstring() + L" is truncated.");
+    }
+    return values;
+}
+
+// Every sample of the calibration folder, in file name order. Other files are ignored.
+static std::vector<InferenceBackend::Tensor>
+LoadCalibrationSet(const std::wstring& folder, const std::vector<int64_t>& shape,
+                   const std::function<std::vector<float>(const std::wstring&)>& load_image)
+{
+    std::vector<std::filesystem::path> paths;
+    for (const auto& entry : std::filesystem::directory_iterator(folder))
+    {
+        if (entry.is_regular_file())
+        {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<InferenceBackend::Tensor> samples;
+    for (const auto& path : paths)
+    {
+        std::wstring extension = path.extension().wstring();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::towlower);
+        std::vector<float> values;
+        if (extension == L".csv")
+        {
+            std::vector<double> csvValues = BackendHarness::ReadCsvValues(path);
+            values.assign(csvValues.begin(), csvValues.end());
+        }
+        else if (extension == L".npy")
+        {
+            values = ReadNpySample(path);
+        }
+        else if (extension == L".png" || extension == L".jpg" || extension == L".jpeg" || extension == L".bmp")
+        {
+            values = load_image(std::filesystem::absolute(path).wstring());
+        }
+        else
+        {
+            continue;
+        }
+        InferenceBackend::Tensor sample(ElementType::Float, shape);
+        if (values.size() != sample.ElementCount())
+        {
+            throw hresult_invalid_argument(L"Quantization: " + path.wstring() + L" holds " +
+                                           std::to_wstring(values.size()) + L" values, the model input " +
+                                           std::to_wstring(sample.ElementCount()) + L".");
+        }
+        std::copy(values.begin(), values.end(), sample.Data<float>());
+        samples.push_back(std::move(sample));
+    }
+    return samples;
+}
+
+// The index of the largest value of every float output.
+static std::vector<size_t> Top1(InferenceBackend::Model& model, InferenceBackend::Session& session)
+{
+    std::vector<size_t> indices;
+    for (const auto& output : model.Outputs())
+    {
+        const InferenceBackend::Tensor& tensor = session.Output(output.name);
+        if (tensor.Type() == ElementType::Float && tensor.ElementCount() > 0)
+        {
+            indices.push_back(ResultHelper::TopK(tensor.Data<float>(), tensor.ElementCount(), 1).front().index);
+        }
+    }
+    return indices;
+}
+
+// Evaluates both models on every sample and prints how often all their top-1 results agree and the time each takes.
+static void CompareOnBackend(InferenceBackend::Backend& backend, const std::string& device_name,
+                             const std::wstring& float_path, const std::wstring& quantized_path,
+                             const std::vector<InferenceBackend::Tensor>& samples)
+{
+    std::unique_ptr<InferenceBackend::Model> models[2] = { backend.Load(float_path), backend.Load(quantized_path) };
+    std::unique_ptr<InferenceBackend::Session> sessions[2] = { models[0]->CreateSession(),
+                                                               models[1]->CreateSession() };
+    double totalTimes[2] = {};
+    size_t agreements = 0;
+    Timer timer;
+    for (const auto& sample : samples)
+    {
+        std::vector<size_t> top1[2];
+        for (int i = 0; i < 2; i++)
+        {
+            sessions[i]->Bind(models[i]->Inputs().front().name, sample);
+            timer.Start();
+            sessions[i]->Evaluate();
+            totalTimes[i] += timer.Stop();
+            top1[i] = Top1(*models[i], *sessions[i]);
+        }
+        agreements += !top1[0].empty() && top1[0] == top1[1];
+    }
+
+    double floatTime = totalTimes[0] / samples.size();
+    double quantizedTime = totalTimes[1] / samples.size();
+    std::cout << std::fixed << std::setprecision(3) << "  " << backend.Name()
+              << (device_name.empty() ? "" : " " + device_name) << ": top-1 agreement " << agreements << "/"
+              << samples.size() << " (" << std::setprecision(1) << 100.0 * agreements / samples.size()
+              << "%), float " << std::setprecision(3) << floatTime << " ms, quantized " << quantizedTime
+              << " ms, speedup " << std::setprecision(2) << (quantizedTime > 0 ? floatTime / quantizedTime : 0.0)
+              << "x" << std::defaultfloat << std::endl;
+}
+
+int QuantizeWithCalibration(const std::wstring& path, const std::wstring& output_path,
+                            const std::wstring& calibration_path, const Onnx::QuantizationOptions& options,
+                            const std::function<std::vector<float>(const std::wstring&)>& load_image,
+                            const std::vector<InferenceBackend::Backend*>& backends,
+                            const std::vector<std::string>& device_names)
+{
+    std::wcout << L"Quantizing " << path << L" to " << output_path << std::endl;
+
+    // The naive reference path computes every value on its own, so the observer also sees the Conv outputs that
+    // the optimized path fuses with their Relu.
+    InferenceBackend::Reference::Options referenceOptions;
+    referenceOptions.optimize = false;
+    InferenceBackend::ReferenceBackend reference(referenceOptions);
+    std::unique_ptr<InferenceBackend::Model> model = reference.Load(path);
+    if (model->Inputs().size() != 1 || model->Inputs().front().type != ElementType::Float)
+    {
+        throw hresult_invalid_argument(L"Quantization: the model must have a single float input.");
+    }
+    const InferenceBackend::ValueInfo& input = model->Inputs().front();
+    std::vector<int64_t> shape = input.shape;
+    for (auto& dim : shape)
+    {
+        dim = dim < 0 ? 1 : dim;
+    }
+    std::vector<InferenceBackend::Tensor> samples = LoadCalibrationSet(calibration_path, shape, load_image);
+    if (samples.empty())
+    {
+        throw hresult_invalid_argument(L"Quantization: " + calibration_path + L" holds no samples.");
+    }
+
+    // Parsed over a mapping: choosing the activations only needs the graph, not the weight payloads.
+    Onnx::MappedFile file(path);
+    Onnx::Calibrator calibrator(Onnx::CalibrationTensors(*Onnx::ParseModel(file.Data(), file.Size()), options));
+    std::unique_ptr<InferenceBackend::Session> session = model->CreateSession();
+    dynamic_cast<InferenceBackend::ReferenceSession&>(*session).Observe(
+        [&](const std::string& name, const InferenceBackend::Tensor& value) {
+            // Only float activations are quantized; others, such as shape computations, are not reinterpreted.
+            if (value.Type() == ElementType::Float)
+            {
+                calibrator.Add(name, value.Data<float>(), value.ElementCount());
+            }
+        });
+    Timer timer;
+    timer.Start();
+    for (const auto& sample : samples)
+    {
+        session->Bind(input.name, sample);
+        session->Evaluate();
+    }
+    double calibrateTime = timer.Stop();
+
+    timer.Start();
+    Onnx::QuantizationReport report = Onnx::QuantizeModel(path, output_path, calibrator.Ranges(options), options);
+    double quantizeTime = timer.Stop();
+
+    std::cout << std::fixed << std::setprecision(3) << "  Calibrated " << report.quantizedActivations
+              << " activations on " << samples.size() << " samples (" << Onnx::CalibrationMethodName(options.method)
+              << ") in " << calibrateTime << " ms" << std::endl;
+    std::cout << "  " << report.inputBytes / (1024.0 * 1024.0) << " MB -> " << report.outputBytes / (1024.0 * 1024.0)
+              << " MB in " << quantizeTime << " ms, opset " << report.opset << std::defaultfloat << std::endl;
+    std::cout << "  " << report.quantizedNodes << " nodes quantized, " << report.skippedNodes << " left in float, "
+              << report.quantizedTensors << " weights and biases quantized, " << report.insertedNodes
+              << " QuantizeLinear and DequantizeLinear nodes inserted" << std::endl;
+
+    // The optimized reference path simulates the quantized model in float, so its time is not an int8 speedup.
+    InferenceBackend::ReferenceBackend optimized;
+    CompareOnBackend(optimized, "", path, output_path, samples);
+    for (size_t i = 0; i < backends.size(); i++)
+    {
+        CompareOnBackend(*backends[i], device_names[i], path, output_path, samples);
+    }
+    return 0;
+}
@@ -2,10 +2,23 @@
 #include "Common.h"
 #include "OutputHelper.h"
 #include "BindingUtilities.h"
+#include "EnvironmentMonitor.h"
+#include <atomic>
 #include <filesystem>
+#include <map>
+#include <mutex>
 #include <d3d11.h>
 #include <Windows.Graphics.DirectX.Direct3D11.interop.h>
 #include "Scenarios.h"
+#include "ModelSource.h"
+#include "ModelCache.h"
+#include "ScenarioScheduler.h"
+#include "SessionOptionsNative.h"
+#include "SchedulingTelemetry.h"
+#include "StartupTimings.h"
+#include "OnnxInspector.h"
+#include "ReferenceBackend.h"
+#include "WinMLBackend.h"
 #include <winrt/Windows.Foundation.Metadata.h>
 using namespace winrt::Windows::Graphics::DirectX::Direct3D11;
 using namespace winrt::Windows::Foundation::Metadata;
@@ -90,8 +103,14 @@ HRESULT BindInputFeatures(const LearningModel& model, const LearningModelBinding
     return S_OK;
 }
 
+LearningModel LoadModelWithMode(const std::wstring& path, ModelSource::LoadMode loadMode, bool prefetch)
+{
+    return ModelSource::LoadModel(path, loadMode, prefetch);
+}
+
 HRESULT LoadModel(LearningModel& model, const std::wstring& path, bool capturePerf, OutputHelper& output,
-                  const CommandLineArgs& args, uint32_t iterationNum, Profiler<WINML_MODEL_TEST_PERF>& profiler)
+                  const CommandLineArgs& args, uint32_t iterationNum, Profiler<WINML_MODEL_TEST_PERF>& profiler,
+                  ModelCache::Handle* cachedModel = nullptr)
 {
     try
     {
@@ -102,7 +121,17 @@ HRESULT LoadModel(LearningModel& model, const std::wstring& path, bool capturePe
             {
                 WINML_PROFILING_START(profiler, WINML_MODEL_TEST_PERF::LOAD_MODEL);
             }
-            model = LearningModel::LoadFromFilePath(path);
+            if (cachedModel != nullptr)
+            {
+                *cachedModel = ModelCache::Instance().Acquire(path, [&args](const std::wstring& modelPath) {
+                    return LoadModelWithMode(modelPath, args.LoadMode(), args.IsPrefetchModel());
+                });
+                model = cachedModel->Model();
+            }
+            else
+            {
+                model = LoadModelWithMode(path, args.LoadMode(), args.IsPrefetchModel());
+            }
 
             if (capturePerf)
             {
@@ -124,18 +153,30 @@ HRESULT LoadModel(LearningModel& model, const std::wstring& path, bool capturePe
     return S_OK;
 }
 
-void PopulateSessionOptions(LearningModelSessionOptions& sessionOptions)
+void PopulateSessionOptions(LearningModelSessionOptions& sessionOptions, uint32_t batchSize,
+                            uint32_t intraOpNumThreads)
 {
-    // Batch Size Override as 1
+    // Batch Size Override as -BatchSize, 1 by default
     try
     {
-        sessionOptions.BatchSizeOverride(1);
+        sessionOptions.BatchSizeOverride(batchSize);
     }
     catch (...)
     {
-        printf("Batch size override couldn't be set.\n");
+        ConsolePrintf("Batch size override couldn't be set.\n");
         throw;
     }
+    // Intra-op thread count as the "threads" of a -ScenarioFile scenario, WinML's default when 0
+    if (intraOpNumThreads > 0)
+    {
+        auto nativeOptions = sessionOptions.try_as<ILearningModelSessionOptionsNative>();
+        if (!nativeOptions)
+        {
+            ConsolePrintf("Intra-op thread count couldn't be set: this version of WinML does not support it.\n");
+            throw hresult_not_implemented();
+        }
+        check_hresult(nativeOptions->SetIntraOpNumThreadsOverride(intraOpNumThreads));
+    }
 }
 
 void CreateSessionConsideringSupportForSessionOptions(LearningModelSession& session,
@@ -150,7 +191,7 @@ void CreateSessionConsideringSupportForSessionOptions(LearningModelSession& sess
     if (isSessionOptionsTypePresent)
     {
         LearningModelSessionOptions sessionOptions;
-        PopulateSessionOptions(sessionOptions);
+        PopulateSessionOptions(sessionOptions, args.BatchSize(), args.IntraOpNumThreads());
         if (args.IsPerformanceCapture())
         {
             WINML_PROFILING_START(profiler, WINML_MODEL_TEST_PERF::CREATE_SESSION);
@@ -261,6 +302,23 @@ std::vector<std::wstring> GetModelsInDirectory(CommandLineArgs& args, OutputHelp
         if (it.path().string().find(".onnx") != std::string::npos ||
             it.path().string().find(".pb") != std::string::npos)
         {
+            // Files that only match by name, such as external tensor data or TensorFlow graphs, are dropped here
+            // rather than failing a load later. Inspecting reads only the message headers of the file.
+            std::string problem;
+            try
+            {
+                problem = Onnx::InspectModelFile(it.path()).Problem();
+            }
+            catch (const std::exception& e)
+            {
+                problem = e.what();
+            }
+            if (!problem.empty())
+            {
+                std::wcout << L"Skipping " << it.path().wstring() << L": ";
+                std::cout << problem << std::endl;
+                continue;
+            }
             std::wstring fileName;
             fileName.assign(path.begin(), path.end());
             args.SetModelPath(fileName);
@@ -271,6 +329,119 @@ std::vector<std::wstring> GetModelsInDirectory(CommandLineArgs& args, OutputHelp
     return modelPaths;
 }
 
+int InspectModels(const std::vector<std::wstring>& modelPaths, const OutputHelper& output)
+{
+    int result = 0;
+    for (const auto& path : modelPaths)
+    {
+        try
+        {
+            Timer timer;
+            timer.Start();
+            Onnx::ModelSummary summary = Onnx::InspectModelFile(path);
+            double inspectTime = timer.Stop();
+            output.PrintModelSummary(path, summary, inspectTime);
+            // Parsed over a mapping, so that initializer payloads are not read to count the work.
+            Onnx::MappedFile file(path);
+            output.PrintModelCost(Onnx::EstimateCost(*Onnx::ParseModel(file.Data(), file.Size())));
+        }
+        catch (const std::exception& e)
+        {
+            std::wcout << "Inspect Model: " << path << " [FAILED]" << std::endl;
+            std::cout << e.what() << std::endl;
+            result = EXIT_FAILURE;
+        }
+    }
+    return result;
+}
+
+int ConvertModelToFloat16(const CommandLineArgs& args, const std::vector<LearningModelDeviceWithMetadata>& deviceList,
+                          const OutputHelper& output)
+{
+    Onnx::Float16Options options;
+    options.keepOps.insert(options.keepOps.end(), args.Float16KeepOps().begin(), args.Float16KeepOps().end());
+    options.keepIoTypes = args.IsFloat16KeepIOTypes();
+    try
+    {
+        Timer timer;
+        timer.Start();
+        Onnx::Float16Report report = Onnx::ConvertToFloat16(args.ModelPath(), args.Float16OutputPath(), options);
+        double convertTime = timer.Stop();
+        output.PrintFloat16Report(args.Float16OutputPath(), report, convertTime);
+    }
+    catch (const std::exception& e)
+    {
+        std::wcout << "Convert Model: " << args.ModelPath() << " [FAILED]" << std::endl;
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!args.IsCompareOutputs())
+    {
+        return 0;
+    }
+    int result = 0;
+    for (auto& learningModelDevice : deviceList)
+    {
+        WinMLBackend::Backend backend(learningModelDevice.LearningModelDevice);
+        result |= CompareModelOutputs(backend, args.ModelPath(), args.Float16OutputPath(),
+                                      TypeHelper::Stringify(learningModelDevice.DeviceType), args.CsvPath(),
+                                      args.TopK());
+    }
+    return result;
+}
+
+// Tensorizes a -Calibrate image for the single input of model as -Input binds an image to a tensor input, through
+// LoadImageFile and CreateBindableTensor, in the plane order -Tensor, -RGB or -BGR select.
+std::vector<float> LoadCalibrationImage(const LearningModel& model, const CommandLineArgs& args,
+                                        const std::wstring& imagePath)
+{
+    InputDataType inputDataType = args.UseRGB()   ? InputDataType::ImageRGB
+                                  : args.UseBGR() ? InputDataType::ImageBGR
+                                                  : InputDataType::Tensor;
+    CommandLineArgs imageArgs = args;
+    imageArgs.SetImagePath(imagePath);
+    imageArgs.ToggleTerseOutput(true);
+    ITensor tensor = BindingUtilities::CreateBindableTensor(model.InputFeatures().GetAt(0), imagePath,
+                                                            InputBindingType::CPU, inputDataType, imageArgs, 1,
+                                                            GetColorManagementMode(model));
+    auto values = tensor.as<TensorFloat>().GetAsVectorView();
+    return std::vector<float>(begin(values), end(values));
+}
+
+int QuantizeModelWithCalibration(const CommandLineArgs& args,
+                                 const std::vector<LearningModelDeviceWithMetadata>& deviceList)
+{
+    std::vector<std::unique_ptr<WinMLBackend::Backend>> devices;
+    std::vector<InferenceBackend::Backend*> backends;
+    std::vector<std::string> deviceNames;
+    for (auto& learningModelDevice : deviceList)
+    {
+        devices.push_back(std::make_unique<WinMLBackend::Backend>(learningModelDevice.LearningModelDevice));
+        backends.push_back(devices.back().get());
+        deviceNames.push_back(TypeHelper::Stringify(learningModelDevice.DeviceType));
+    }
+    try
+    {
+        LearningModel model = LearningModel::LoadFromFilePath(args.ModelPath());
+        auto loadImage = [&model, &args](const std::wstring& imagePath) {
+            return LoadCalibrationImage(model, args, imagePath);
+        };
+        return QuantizeWithCalibration(args.ModelPath(), args.QuantizedOutputPath(), args.CalibrationPath(),
+                                       args.QuantizationOptions(), loadImage, backends, deviceNames);
+    }
+    catch (const std::exception& e)
+    {
+        std::wcout << "Quantize Model: " << args.ModelPath() << " [FAILED]" << std::endl;
+        std::cout << e.what() << std::endl;
+    }
+    catch (const hresult_error& e)
+    {
+        std::wcout << "Quantize Model: " << args.ModelPath() << " [FAILED]" << std::endl;
+        std::wcout << e.message().c_str() << std::endl;
+    }
+    return EXIT_FAILURE;
+}
+
 HRESULT CheckIfModelAndConfigurationsAreSupported(LearningModel& model, const std::wstring& modelPath,
                                                   const DeviceType deviceType,
                                                   const std::vector<InputDataType>& inputDataTypes)
@@ -323,6 +494,11 @@ HRESULT EvaluateModel(LearningModelEvaluationResult& result,
 {
     try
     {
+        SchedulingTelemetry::Recorder scheduling;
+        if (capturePerf && args.IsSchedulingTelemetry())
+        {
+            scheduling.Start();
+        }
         if (capturePerf)
         {
             WINML_PROFILING_START(profiler, iterationNum == 0 ? WINML_MODEL_TEST_PERF::EVAL_MODEL_FIRST_RUN
@@ -335,6 +511,14 @@ HRESULT EvaluateModel(LearningModelEvaluationResult& result,
         {
             WINML_PROFILING_STOP(profiler, iterationNum == 0 ? WINML_MODEL_TEST_PERF::EVAL_MODEL_FIRST_RUN
                                                              : WINML_MODEL_TEST_PERF::EVAL_MODEL);
+            if (iterationNum == 0)
+            {
+                StartupTimings::MarkFirstResult();
+            }
+            if (args.IsSchedulingTelemetry())
+            {
+                output.SaveSchedulingTelemetry(scheduling.Stop(), iterationNum);
+            }
             if (args.IsPerIterationCapture())
             {
                 output.SaveEvalPerformance(profiler, iterationNum);
@@ -468,8 +652,8 @@ void IterateBindAndEvaluate(const int maxBindAndEvalIterations, int& lastIterati
 
             if (args.TerseOutput() && args.NumIterations() > 1)
             {
-                printf("Binding and Evaluating %d more time%s...", args.NumIterations() - 1,
-                       (args.NumIterations() == 2 ? "" : "s"));
+                ConsolePrintf("Binding and Evaluating %d more time%s...", args.NumIterations() - 1,
+                              (args.NumIterations() == 2 ? "" : "s"));
             }
         }
 #if defined(_AMD64_)
@@ -488,6 +672,99 @@ void RunBindAndEvaluateOnce(CommandLineArgs& args, OutputHelper& output, Learnin
                            profiler, imagePath);
 }
 
+// The roof CPU results are compared with, measured the first time it is needed unless a supervisor measured it
+// already and passed it down with -MachinePeak.
+const MachinePeak::Peak& CpuPeak(const CommandLineArgs& args)
+{
+    static const MachinePeak::Peak peak = [&args]() {
+        if (!args.HasCpuPeak())
+        {
+            return MachinePeak::Measure();
+        }
+        MachinePeak::Peak given;
+        given.threads = args.CpuPeakThreads();
+        given.gflops = args.CpuPeakGflops();
+        given.gigabytesPerSecond = args.CpuPeakGigabytesPerSecond();
+        return given;
+    }();
+    return peak;
+}
+
+// Each model is costed once per batch size however many configurations run it, with its free dimensions set to the
+// batch size as the session's batch size override sets them; nullptr when the file cannot be parsed.
+const Onnx::ModelCost* CostOfModel(const std::wstring& modelPath, uint32_t batchSize)
+{
+    static std::mutex mutex;
+    static std::map<std::pair<std::wstring, uint32_t>, std::unique_ptr<Onnx::ModelCost>> costs;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = costs.find({ modelPath, batchSize });
+    if (found == costs.end())
+    {
+        std::unique_ptr<Onnx::ModelCost> cost;
+        try
+        {
+            Onnx::MappedFile file(modelPath);
+            cost = std::make_unique<Onnx::ModelCost>(
+                Onnx::EstimateCost(*Onnx::ParseModel(file.Data(), file.Size()), batchSize));
+        }
+        catch (const std::exception&)
+        {
+        }
+        found = costs.emplace(std::make_pair(modelPath, batchSize), std::move(cost)).first;
+    }
+    return found->second.get();
+}
+
+// Writes the startup milestones of this process and the times of its first load, session creation, bind and evaluate
+// to path, one "<name> <value>" line each, for the -ColdStart launch that started it.
+static void WriteStartupReport(const std::wstring& path, Profiler<WINML_MODEL_TEST_PERF>& profiler)
+{
+    const StartupTimings::Milestones& milestones = StartupTimings::Get();
+    std::ofstream report(std::filesystem::path(path), std::ios::trunc);
+    report << "main_entered " << milestones.MainEntered << std::endl;
+    report << "first_result " << milestones.FirstResult.load() << std::endl;
+    report << "runtime_load_ms " << milestones.RuntimeLoadMs << std::endl;
+    report << "device_creation_ms " << milestones.DeviceCreationMs << std::endl;
+    report << "apartment_init_ms " << milestones.ApartmentInitMs << std::endl;
+    report << "model_load_ms " << profiler[LOAD_MODEL].GetValues(CounterType::TIMER, 0) << std::endl;
+    report << "session_creation_ms " << profiler[CREATE_SESSION].GetValues(CounterType::TIMER, 0) << std::endl;
+    report << "first_bind_ms " << profiler[BIND_VALUE_FIRST_RUN].GetValues(CounterType::TIMER, 0) << std::endl;
+    report << "first_evaluate_ms " << profiler[EVAL_MODEL_FIRST_RUN].GetValues(CounterType::TIMER, 0) << std::endl;
+}
+
+// -CheckEnvironment: notes the machine in the performance file metadata, measures how busy it is and starts sampling
+// the CPU clock. Returns false when -RejectNoisyRuns refuses to run on a machine this busy.
+static bool CheckEnvironment(CommandLineArgs& args, OutputHelper& output)
+{
+    static const uint32_t SystemLoadMs = 1000;
+    EnvironmentMonitor::Fingerprint fingerprint = EnvironmentMonitor::ReadFingerprint();
+    double systemLoad = EnvironmentMonitor::MeasureSystemLoad(SystemLoadMs);
+    EnvironmentMonitor::Enable(args.MaxClockDrift(), systemLoad, args.MaxSystemLoad());
+    output.PrintEnvironment(fingerprint, systemLoad);
+
+    std::ostringstream referenceGhz;
+    referenceGhz << std::fixed << std::setprecision(2) << EnvironmentMonitor::ReferenceGhz();
+    std::ostringstream systemLoadPercent;
+    systemLoadPercent << std::fixed << std::setprecision(1) << systemLoad;
+    args.AddPerformanceFileMetadata("cpu", fingerprint.CpuModel);
+    args.AddPerformanceFileMetadata("power plan", fingerprint.PowerPlan);
+    args.AddPerformanceFileMetadata("physical cores", std::to_string(fingerprint.PhysicalCores));
+    args.AddPerformanceFileMetadata("logical processors", std::to_string(fingerprint.LogicalProcessors));
+    args.AddPerformanceFileMetadata("smt", fingerprint.Smt ? "on" : "off");
+    args.AddPerformanceFileMetadata("nominal MHz", std::to_string(fingerprint.NominalMhz));
+    args.AddPerformanceFileMetadata("clock before run (GHz)", referenceGhz.str());
+    args.AddPerformanceFileMetadata("system load before run (%)", systemLoadPercent.str());
+
+    std::string deviation = EnvironmentMonitor::SystemDeviation();
+    if (!deviation.empty() && args.IsRejectNoisyRuns())
+    {
+        std::cout << "Not running: the " << deviation << ", over -MaxSystemLoad " << args.MaxSystemLoad() << "%."
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
 void WritePerfResults(CommandLineArgs& args, OutputHelper& output, LearningModelSession& session,
                       const LearningModelDeviceWithMetadata& device, const InputBindingType inputBindingType,
                       const InputDataType inputDataType, Profiler<WINML_MODEL_TEST_PERF>& profiler,
@@ -496,26 +773,60 @@ void WritePerfResults(CommandLineArgs& args, OutputHelper& output, LearningModel
 {
     output.PrintResults(profiler, lastIteration, device.DeviceType, inputBindingType, inputDataType, device.DeviceCreationLocation,
                         args.IsPerformanceConsoleOutputVerbose());
-    if (args.IsOutputPerf())
+    if (args.IsTrackAllocations())
+    {
+        output.PrintAllocations(profiler);
+    }
+    bool rejected = false;
+    if (EnvironmentMonitor::IsEnabled())
+    {
+        output.PrintClock(profiler);
+        rejected = args.IsRejectNoisyRuns() && !OutputHelper::EnvironmentDeviation(profiler).empty();
+        if (rejected)
+        {
+            std::cout << "Results rejected by -RejectNoisyRuns and left out of the performance file." << std::endl;
+        }
+    }
+    if (args.IsOutputPerf() && !rejected)
     {
         std::string deviceTypeStringified = TypeHelper::Stringify(device.DeviceType);
         std::string inputDataTypeStringified = TypeHelper::Stringify(inputDataType);
         std::string inputBindingTypeStringified = TypeHelper::Stringify(inputBindingType);
         std::string deviceCreationLocationStringified = TypeHelper::Stringify(device.DeviceCreationLocation);
+        // Only the CPU has a measured roof; GPU rows get the achieved rate alone.
+        const Onnx::ModelCost* cost = CostOfModel(modelPath, args.BatchSize());
+        double flops = cost != nullptr ? cost->flops : 0;
+        double attainableGflops = cost != nullptr && device.DeviceType == DeviceType::CPU
+                                      ? CpuPeak(args).Attainable(cost->Intensity())
+                                      : 0;
         output.WritePerformanceDataToCSV(profiler, lastIteration, modelPath, deviceTypeStringified,
                                             inputDataTypeStringified, inputBindingTypeStringified,
-                                            deviceCreationLocationStringified, args.GetPerformanceFileMetadata());
+                                            deviceCreationLocationStringified, args.GetPerformanceFileMetadata(),
+                                            flops, attainableGflops);
     }
     if (args.IsPerIterationCapture())
     {
         output.WritePerIterationPerformance(args, session.Model().Name().c_str(), imagePath);
     }
+    if (args.IsSchedulingTelemetry())
+    {
+        // The iterations the configuration ran, which an iteration time limit may have cut short.
+        output.PrintSchedulingSummary(lastIteration);
+    }
+    // The first configuration holds the first result. Parallel scenarios may get here at once, and only one writes.
+    static std::atomic<bool> startupReported(false);
+    if (!args.StartupReportPath().empty() && !startupReported.exchange(true))
+    {
+        WriteStartupReport(args.StartupReportPath(), profiler);
+    }
 }
 
+// With a scenario, the results are written once every earlier scenario has written its own.
 void RunConfiguration(CommandLineArgs& args, OutputHelper& output, LearningModelSession& session, HRESULT& lastHr,
                       const InputBindingType inputBindingType, const InputDataType inputDataType,
                       Profiler<WINML_MODEL_TEST_PERF>& profiler, const std::wstring& modelPath,
-                      const std::wstring& imagePath, const uint32_t sessionCreationIteration, const LearningModelDeviceWithMetadata& device)
+                      const std::wstring& imagePath, const uint32_t sessionCreationIteration, const LearningModelDeviceWithMetadata& device,
+                      Scenario* scenario = nullptr)
 {
     if (sessionCreationIteration < args.NumSessionCreationIterations() - 1)
     {
@@ -529,17 +840,223 @@ void RunConfiguration(CommandLineArgs& args, OutputHelper& output, LearningModel
                                inputBindingType, inputDataType, profiler, imagePath);
         if (args.IsPerformanceCapture() && SUCCEEDED(lastHr))
         {
+            if (scenario != nullptr)
+            {
+                scenario->EnterOrderedSection();
+            }
             WritePerfResults(args, output, session, device, inputBindingType, inputDataType, profiler, modelPath,
                              imagePath, sessionCreationIteration, lastIteration);
         }
     }
 }
+
+void RunDeviceConfigurations(CommandLineArgs& args, OutputHelper& output, LearningModel& model,
+                             const std::wstring& path, const LearningModelDeviceWithMetadata& learningModelDevice,
+                             const std::vector<InputDataType>& inputDataTypes,
+                             const std::vector<InputBindingType>& inputBindingTypes,
+                             Profiler<WINML_MODEL_TEST_PERF>& profiler, HRESULT& lastHr, Scenario* scenario = nullptr)
+{
+    lastHr = CheckIfModelAndConfigurationsAreSupported(model, path, learningModelDevice.DeviceType, inputDataTypes);
+    if (FAILED(lastHr))
+    {
+        return;
+    }
+#if defined(_AMD64_)
+    StartPIXCapture(output);
+#endif
+    LearningModelSession session = nullptr;
+    for (auto inputDataType : inputDataTypes)
+    {
+        for (auto inputBindingType : inputBindingTypes)
+        {
+            // Clear up session, bind, eval performance metrics after configuration iteration
+            if (args.IsPerformanceCapture() || args.IsPerIterationCapture())
+            {
+                // Resets all values from profiler for bind and evaluate.
+                profiler.Reset(WINML_MODEL_TEST_PERF::BIND_VALUE, WINML_MODEL_TEST_PERF::COUNT);
+            }
+            for (uint32_t sessionCreationIteration = 0;
+                sessionCreationIteration < args.NumSessionCreationIterations();
+                sessionCreationIteration++)
+            {
+                lastHr = CreateSession(session, model, learningModelDevice,args, output, profiler);
+                if (FAILED(lastHr))
+                {
+                    continue;
+                }
+                if (args.IsImageInput())
+                {
+                    for (const std::wstring& inputImagePath : args.ImagePaths())
+                    {
+                        RunConfiguration(args, output, session, lastHr, inputBindingType, inputDataType, profiler,
+                                         path, inputImagePath, sessionCreationIteration, learningModelDevice,
+                                         scenario);
+                    }
+                }
+                else
+                {
+                    RunConfiguration(args, output, session, lastHr, inputBindingType, inputDataType, profiler, path,
+                                     L"", sessionCreationIteration, learningModelDevice, scenario);
+                }
+                // Close and destroy session
+                session.Close();
+            }
+        }
+    }
+}
+
+// Runs every model and device pair as its own scenario, up to -MaxParallelScenarios at a time. Each scenario loads its
+// model and keeps its own profiler and output state, so apart from timings affected by the work running beside it, a
+// scenario reports what a sequential run would. Returns the result of the last pair, as the sequential loop does.
+HRESULT RunScenariosInParallel(CommandLineArgs& args, const OutputHelper& output,
+                               const std::vector<std::wstring>& modelPaths,
+                               const std::vector<LearningModelDeviceWithMetadata>& deviceList,
+                               const std::vector<InputDataType>& inputDataTypes,
+                               const std::vector<InputBindingType>& inputBindingTypes)
+{
+    std::vector<HRESULT> results(modelPaths.size() * deviceList.size(), S_OK);
+    ScenarioScheduler scheduler(args.MaxParallelScenarios());
+    size_t scenarioIndex = 0;
+    for (const auto& path : modelPaths)
+    {
+        for (const auto& learningModelDevice : deviceList)
+        {
+            HRESULT& lastHr = results[scenarioIndex++];
+            scheduler.Submit([&args, &output, &path, &learningModelDevice, &inputDataTypes, &inputBindingTypes,
+                              &lastHr](Scenario& scenario) {
+                OutputHelper scenarioOutput(output);
+                // Heap allocated: the counters are too large for a pool thread's stack.
+                auto profiler = std::make_unique<Profiler<WINML_MODEL_TEST_PERF>>();
+                profiler->Enable();
+                LearningModel model = nullptr;
+                ModelCache::Handle cachedModel;
+                LoadModel(model, path, args.IsPerformanceCapture() || args.IsPerIterationCapture(), scenarioOutput,
+                          args, 0, *profiler, args.IsModelCache() ? &cachedModel : nullptr);
+                RunDeviceConfigurations(args, scenarioOutput, model, path, learningModelDevice, inputDataTypes,
+                                        inputBindingTypes, *profiler, lastHr, &scenario);
+            });
+        }
+    }
+    scheduler.WaitAll();
+    return results.empty() ? S_OK : results.back();
+}
+
+// Runs the scenarios of -ScenarioFile one after the other in this process. A model is loaded by the first scenario
+// naming it and kept for the later ones, and main created every device the file uses once, so except for the first
+// use of a model each scenario runs in a warm process. Each model keeps its own profiler, so the load columns of a
+// scenario report the load of its model, and each scenario its own copy of output, sized for its iterations.
+// Returns the result of the last scenario that failed, S_OK if none did.
+HRESULT RunScenarioFile(CommandLineArgs& args, const OutputHelper& output,
+                        const std::vector<LearningModelDeviceWithMetadata>& deviceList)
+{
+    struct LoadedModel
+    {
+        LearningModel Model = nullptr;
+        // Heap allocated: the counters are large.
+        std::unique_ptr<Profiler<WINML_MODEL_TEST_PERF>> Profiler;
+    };
+    std::map<std::wstring, LoadedModel> models;
+    HRESULT result = S_OK;
+    for (const auto& scenario : args.Scenarios())
+    {
+        std::wcout << std::endl << L"Scenario " << scenario.Id << std::endl;
+        CommandLineArgs scenarioArgs = args;
+        scenarioArgs.ApplyScenario(scenario);
+        OutputHelper scenarioOutput(output);
+        scenarioOutput.SetNumIterations(scenario.Iterations);
+        auto device = std::find_if(deviceList.begin(), deviceList.end(), [&scenario](const auto& candidate) {
+            return candidate.DeviceType == scenario.Device &&
+                   candidate.DeviceCreationLocation == scenario.DeviceCreation;
+        });
+        if (device == deviceList.end())
+        {
+            std::cout << "The device of the scenario could not be created [FAILED]" << std::endl;
+            result = E_INVALIDARG;
+            continue;
+        }
+
+        auto loaded = models.find(scenario.ModelPath);
+        if (loaded == models.end())
+        {
+            LoadedModel model;
+            model.Profiler = std::make_unique<Profiler<WINML_MODEL_TEST_PERF>>();
+            model.Profiler->Enable();
+            try
+            {
+                LoadModel(model.Model, scenario.ModelPath, true, scenarioOutput, scenarioArgs, 0, *model.Profiler);
+            }
+            catch (const hresult_error& error)
+            {
+                result = error.code();
+                continue;
+            }
+            loaded = models.emplace(scenario.ModelPath, std::move(model)).first;
+        }
+        LearningModel& model = loaded->second.Model;
+        Profiler<WINML_MODEL_TEST_PERF>& profiler = *loaded->second.Profiler;
+        profiler.Reset(WINML_MODEL_TEST_PERF::CREATE_SESSION, WINML_MODEL_TEST_PERF::COUNT);
+
+        HRESULT lastHr = CheckIfModelAndConfigurationsAreSupported(model, scenario.ModelPath, scenario.Device,
+                                                                   { scenario.InputType });
+        LearningModelSession session = nullptr;
+        if (SUCCEEDED(lastHr))
+        {
+            lastHr = CreateSession(session, model, *device, scenarioArgs, scenarioOutput, profiler);
+        }
+        if (FAILED(lastHr))
+        {
+            result = lastHr;
+            continue;
+        }
+
+        std::wstring imagePath = scenarioArgs.ImagePaths().empty() ? L"" : scenarioArgs.ImagePaths().front();
+        RunConfiguration(scenarioArgs, scenarioOutput, session, lastHr, scenario.Binding, scenario.InputType, profiler,
+                         scenario.ModelPath, imagePath, 0, *device);
+        session.Close();
+        if (FAILED(lastHr))
+        {
+            result = lastHr;
+        }
+    }
+    return result;
+}
+
 int run(CommandLineArgs& args,
         Profiler<WINML_MODEL_TEST_PERF>& profiler,
         const std::vector<LearningModelDeviceWithMetadata>& deviceList) try
 {
-    // Initialize COM in a multi-threaded environment.
+    // Initialize COM in a multi-threaded environment. main has already, and timed it; this is for callers of the DLL.
     winrt::init_apartment();
+    if (!args.RingProducerName().empty())
+    {
+        return RunRingProducer(args.RingProducerName(), args.NumRequestsPerClient());
+    }
+    if (!args.ConnectPipeName().empty())
+    {
+        return RunServeClient(args.ConnectPipeName(), args.NumClients(), args.NumRequestsPerClient(),
+                              args.IsStopServer());
+    }
+    if (!args.SyntheticModelPath().empty())
+    {
+        return GenerateSyntheticModel(args.SyntheticModelPath(), args.SyntheticModelSizeMB());
+    }
+    if (args.ColdStartLaunches() > 0)
+    {
+        return MeasureColdStarts(args.ModelPath(), args.ColdStartLaunches(), args.IsEvictModel(),
+                                 args.IsOutputPerf() ? args.OutputPath() : L"", args.ChildTimeout());
+    }
+    if (args.ScaleOutWorkers() > 0)
+    {
+        return RunScaleOut(args.ModelPath(), args.ScaleOutWorkers(), args.NumRequestsPerClient(),
+                           args.IsOutputPerf() ? args.OutputPath() : L"", args.ChildTimeout());
+    }
+    if (!args.ScaleOutSectionName().empty())
+    {
+        // The worker evaluates on the first device selected.
+        return RunScaleOutWorker(args.ScaleOutSectionName(), args.ScaleOutWorkerIndex(), args.ModelPath(),
+                                 deviceList.front().LearningModelDevice, args.NumRequestsPerClient(),
+                                 args.ChildTimeout());
+    }
     OutputHelper output(args.NumIterations());
 
 #if defined(_AMD64_)
@@ -549,6 +1066,10 @@ int run(CommandLineArgs& args,
     // Profiler is a wrapper class that captures and stores timing and memory usage data on the
     // CPU and GPU.
     profiler.Enable();
+    if (args.IsTrackAllocations())
+    {
+        AllocationTracker::Enable();
+    }
 
     output.SetCSVFileName(args.OutputPath());
     if (args.IsSaveTensor() || args.IsPerIterationCapture())
@@ -557,6 +1078,29 @@ int run(CommandLineArgs& args,
         output.SetDefaultCSVFileNamePerIteration();
     }
 
+    if (!args.Scenarios().empty() && args.IsIsolate())
+    {
+        std::vector<std::wstring> ids;
+        for (const auto& scenario : args.Scenarios())
+        {
+            ids.push_back(scenario.Id);
+        }
+        return SuperviseChildren(L"-OnlyScenario", ids, args.JournalPath(), args.OutputPath(), args.MaxChildren(),
+                                 args.ChildTimeout(), args.ChildMemoryLimit());
+    }
+    if (args.IsCheckEnvironment() && !CheckEnvironment(args, output))
+    {
+        return 1;
+    }
+    if (!args.Scenarios().empty())
+    {
+        if (args.IsOutputPerf())
+        {
+            // Measured before any scenario runs, so that the roof is taken on an otherwise idle CPU.
+            output.PrintMachinePeak(CpuPeak(args));
+        }
+        return RunScenarioFile(args, output, deviceList);
+    }
     if (!args.ModelPath().empty() || !args.FolderPath().empty())
     {
         std::vector<InputBindingType> inputBindingTypes = args.FetchInputBindingTypes();
@@ -565,69 +1109,163 @@ int run(CommandLineArgs& args,
                                                    ? GetModelsInDirectory(args, &output)
                                                    : std::vector<std::wstring>(1, args.ModelPath());
         HRESULT lastHr = S_OK;
+        if (args.IsInspectOnly())
+        {
+            return InspectModels(modelPaths, output);
+        }
+        if (!args.Float16OutputPath().empty())
+        {
+            return ConvertModelToFloat16(args, deviceList, output);
+        }
+        if (!args.QuantizedOutputPath().empty())
+        {
+            return QuantizeModelWithCalibration(args, deviceList);
+        }
+        if (!args.ExternalDataOutputPath().empty())
+        {
+            return SplitModelExternalData(args.ModelPath(), args.ExternalDataOutputPath(), args.ExternalDataOptions());
+        }
+        if (args.IsModelCache())
+        {
+            ModelCache::Instance().SetCapacity(static_cast<uint64_t>(args.ModelCacheSize()) * 1024 * 1024);
+        }
         if (args.IsConcurrentLoad())
         {
-            ConcurrentLoadModel(modelPaths, args.NumThreads(), args.ThreadInterval(), true);
+            ConcurrentLoadModel(modelPaths, args.NumThreads(), args.ThreadInterval(), true, args.LoadMode(),
+                                args.IsPrefetchModel(), args.IsModelCache());
+            if (args.IsModelCache())
+            {
+                ModelCache::Instance().PrintStats();
+            }
             return 0;
         }
-        for (const auto& path : modelPaths)
+        if (args.IsMicroBatching())
         {
-            LearningModel model = nullptr;
-
-            LoadModel(model, path, args.IsPerformanceCapture() || args.IsPerIterationCapture(), output, args, 0,
-                      profiler);
-            for (auto& learningModelDevice : deviceList)
+            for (const auto& path : modelPaths)
             {
-                lastHr = CheckIfModelAndConfigurationsAreSupported(model, path, learningModelDevice.DeviceType, inputDataTypes);
-                if (FAILED(lastHr))
+                for (auto& learningModelDevice : deviceList)
+                {
+                    MicroBatchingBenchmark(path, learningModelDevice.LearningModelDevice,
+                                           TypeHelper::Stringify(learningModelDevice.DeviceType), args.MaxBatchSize(),
+                                           args.MaxBatchWait(), args.NumClients(), args.NumRequestsPerClient());
+                }
+            }
+            return 0;
+        }
+        if (args.IsAsyncEvaluate())
+        {
+            for (const auto& path : modelPaths)
+            {
+                for (auto& learningModelDevice : deviceList)
+                {
+                    AsyncEvaluationBenchmark(path, learningModelDevice.LearningModelDevice,
+                                             TypeHelper::Stringify(learningModelDevice.DeviceType), args.MaxInFlight(),
+                                             args.NumRequestsPerClient());
+                }
+            }
+            return 0;
+        }
+        if (args.IsSharedMemoryInput())
+        {
+            for (const auto& path : modelPaths)
+            {
+                for (auto& learningModelDevice : deviceList)
+                {
+                    SharedMemoryInputBenchmark(path, learningModelDevice.LearningModelDevice,
+                                               TypeHelper::Stringify(learningModelDevice.DeviceType), args.RingSlots(),
+                                               args.NumRequestsPerClient());
+                }
+            }
+            return 0;
+        }
+        if (args.Backend() != BackendType::None)
+        {
+            std::wstring saveTensorPath = args.IsSaveTensor() ? args.PerIterationDataPath() : L"";
+            for (const auto& path : modelPaths)
+            {
+                if (args.Backend() == BackendType::Reference || args.Backend() == BackendType::ReferenceNaive)
                 {
+                    InferenceBackend::Reference::Options options;
+                    options.optimize = args.Backend() == BackendType::Reference;
+                    options.profile = true;
+                    InferenceBackend::ReferenceBackend backend(options);
+                    RunBackendBenchmark(backend, path, "", args.CsvPath(), args.NumIterations(), args.TopK(),
+                                        saveTensorPath);
                     continue;
                 }
+                for (auto& learningModelDevice : deviceList)
+                {
+                    WinMLBackend::Backend backend(learningModelDevice.LearningModelDevice);
+                    RunBackendBenchmark(backend, path, TypeHelper::Stringify(learningModelDevice.DeviceType),
+                                        args.CsvPath(), args.NumIterations(), args.TopK(), saveTensorPath);
+                }
+            }
+            return 0;
+        }
+        if (!args.ServePipeName().empty())
+        {
+            std::vector<LearningModelDevice> devices;
+            std::vector<std::string> deviceNames;
+            for (auto& learningModelDevice : deviceList)
+            {
+                devices.push_back(learningModelDevice.LearningModelDevice);
+                deviceNames.push_back(TypeHelper::Stringify(learningModelDevice.DeviceType));
+            }
+            return ServeModel(args.ModelPath(), devices, deviceNames, args.ServePipeName(), args.MaxBatchSize(),
+                              args.MaxBatchWait());
+        }
+        if (args.IsIsolate())
+        {
+            return SuperviseChildren(L"-model", modelPaths, args.JournalPath(), args.OutputPath(), args.MaxChildren(),
+                                     args.ChildTimeout(), args.ChildMemoryLimit());
+        }
+        if (args.IsOutputPerf())
+        {
+            // Measured before any configuration runs, so that the roof is taken on an otherwise idle CPU.
+            output.PrintMachinePeak(CpuPeak(args));
+        }
+        if (args.MaxParallelScenarios() > 1)
+        {
+            bool pixAttached = false;
 #if defined(_AMD64_)
-                StartPIXCapture(output);
+            pixAttached = output.GetGraphicsAnalysis().get() != nullptr;
 #endif
-                LearningModelSession session = nullptr;
-                for (auto inputDataType : inputDataTypes)
+            if (args.IsSaveTensor() || args.IsPerIterationCapture() || pixAttached)
+            {
+                // Per iteration files are named per run rather than per configuration and PIX captures one
+                // configuration at a time, so these runs stay sequential.
+                std::cout << "-MaxParallelScenarios is ignored with -SaveTensorData, -SavePerIterationPerf or PIX "
+                             "attached. Running configurations one at a time."
+                          << std::endl;
+            }
+            else
+            {
+                lastHr = RunScenariosInParallel(args, output, modelPaths, deviceList, inputDataTypes,
+                                                inputBindingTypes);
+                if (args.IsModelCache())
                 {
-                    for (auto inputBindingType : inputBindingTypes)
-                    {
-                        // Clear up session, bind, eval performance metrics after configuration iteration
-                        if (args.IsPerformanceCapture() || args.IsPerIterationCapture())
-                        {
-                            // Resets all values from profiler for bind and evaluate.
-                            profiler.Reset(WINML_MODEL_TEST_PERF::BIND_VALUE, WINML_MODEL_TEST_PERF::COUNT);
-                        }
-                        for (uint32_t sessionCreationIteration = 0;
-                            sessionCreationIteration < args.NumSessionCreationIterations();
-                            sessionCreationIteration++)
-                        {
-                            lastHr = CreateSession(session, model, learningModelDevice,args, output, profiler);
-                            if (FAILED(lastHr))
-                            {
-                                continue;
-                            }
-                            if (args.IsImageInput())
-                            {
-                                for (const std::wstring& inputImagePath : args.ImagePaths())
-                                {
-                                    RunConfiguration(args, output, session, lastHr, inputBindingType, inputDataType,
-                                                     profiler, path, inputImagePath, sessionCreationIteration,
-                                                     learningModelDevice);
-                                }
-                            }
-                            else
-                            {
-                                RunConfiguration(args, output, session, lastHr, inputBindingType, inputDataType,
-                                                 profiler, path, L"", sessionCreationIteration,
-                                                 learningModelDevice);
-                            }
-                            // Close and destroy session
-                            session.Close();
-                        }
-                    }
+                    ModelCache::Instance().PrintStats();
                 }
+                return lastHr;
             }
         }
+        for (const auto& path : modelPaths)
+        {
+            LearningModel model = nullptr;
+            ModelCache::Handle cachedModel;
+
+            LoadModel(model, path, args.IsPerformanceCapture() || args.IsPerIterationCapture(), output, args, 0,
+                      profiler, args.IsModelCache() ? &cachedModel : nullptr);
+            for (auto& learningModelDevice : deviceList)
+            {
+                RunDeviceConfigurations(args, output, model, path, learningModelDevice, inputDataTypes,
+                                        inputBindingTypes, profiler, lastHr);
+            }
+        }
+        if (args.IsModelCache())
+        {
+            ModelCache::Instance().PrintStats();
+        }
         return lastHr;
     }
     return 0;
@@ -1,6 +1,11 @@
 #include "CommandLineArgs.h"
 #include "LearningModelDeviceHelper.h"
 
+// Loads the model at path from its file path, a stream or a memory mapping as -LoadMode selects, prefetching the
+// mapping with -PrefetchModel.
+winrt::Windows::AI::MachineLearning::LearningModel LoadModelWithMode(const std::wstring& path,
+                                                                     ModelSource::LoadMode loadMode, bool prefetch);
+
 int run(CommandLineArgs& args,
     Profiler<WINML_MODEL_TEST_PERF>& profiler,
     const std::vector<LearningModelDeviceWithMetadata>& deviceList);
\ No newline at end of file
@@ -0,0 +1,510 @@
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <numeric>
+#include <random>
+
+#include "Windows.h"
+#include "common.h"
+#include "Scenarios.h"
+#include "SessionOptionsNative.h"
+#include "Statistics.h"
+
+using namespace winrt;
+using namespace winrt::Windows::AI::MachineLearning;
+
+// Options of the coordinator itself; every other option of its command line is passed on to the workers.
+static const std::map<std::wstring, int> ScaleOutOptions = {
+    { L"-scaleout", 1 },
+    { L"-perfoutput", -1 },
+    { L"-isolate", 0 },
+};
+
+static const uint32_t SectionMagic = 0x4c414353; // "SCAL"
+
+// Lives at the start of the shared memory section, followed by one WorkerBlock per worker.
+struct SectionHeader
+{
+    uint32_t Magic;
+    uint32_t Workers;
+    // Workers that loaded the model, evaluated once and wait to be released.
+    alignas(64) std::atomic<uint32_t> Arrived;
+    // QueryPerformanceCounter value the coordinator released the workers at, 0 until then. The counter is system wide.
+    alignas(64) std::atomic<int64_t> Start;
+};
+
+// Written by its worker alone, and read by the coordinator once Done is set.
+struct alignas(64) WorkerBlock
+{
+    std::atomic<uint32_t> Done;
+    uint32_t Evaluations;
+    int64_t FirstStart;
+    int64_t LastEnd;
+    double TotalMs;
+    // A Statistics histogram, summed across the workers by the coordinator.
+    uint64_t Buckets[Statistics::HistogramBuckets];
+};
+
+struct LatencyStats
+{
+    uint64_t Evaluations = 0;
+    double Throughput = 0;
+    double MeanMs = 0;
+    double P50Ms = 0;
+    double P90Ms = 0;
+    double P99Ms = 0;
+};
+
+// The CPU sets a worker is pinned to, and the logical processors they stand for.
+struct WorkerCpus
+{
+    std::vector<ULONG> CpuSets;
+    uint32_t Cores = 0;
+    uint32_t FirstProcessor = 0;
+    uint32_t LastProcessor = 0;
+};
+
+using SectionView = std::unique_ptr<void, decltype(&UnmapViewOfFile)>;
+
+static size_t SectionBytes(uint32_t workers) { return sizeof(WorkerBlock) + sizeof(WorkerBlock) * workers; }
+
+static WorkerBlock* Blocks(SectionHeader* header)
+{
+    // The header is padded to a whole block, so that the blocks keep their alignment.
+    static_assert(sizeof(SectionHeader) <= sizeof(WorkerBlock), "The header must fit in the space of one block.");
+    return reinterpret_cast<WorkerBlock*>(reinterpret_cast<char*>(header) + sizeof(WorkerBlock));
+}
+
+static SectionView MapSection(HANDLE mapping)
+{
+    SectionView view(MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0), &UnmapViewOfFile);
+    if (!view)
+    {
+        throw_last_error();
+    }
+    return view;
+}
+
+// Empties the section for a new round of workers.
+static void ResetSection(SectionHeader* header, uint32_t workers)
+{
+    memset(header, 0, SectionBytes(workers));
+    new (&header->Arrived) std::atomic<uint32_t>(0);
+    new (&header->Start) std::atomic<int64_t>(0);
+    for (uint32_t worker = 0; worker < workers; worker++)
+    {
+        new (&Blocks(header)[worker].Done) std::atomic<uint32_t>(0);
+    }
+    header->Workers = workers;
+    header->Magic = SectionMagic;
+}
+
+static LatencyStats Summarize(const uint64_t* buckets, uint64_t evaluations, double total_ms, double seconds)
+{
+    LatencyStats stats;
+    stats.Evaluations = evaluations;
+    if (evaluations == 0)
+    {
+        return stats;
+    }
+    stats.Throughput = seconds > 0 ? evaluations / seconds : 0;
+    stats.MeanMs = total_ms / evaluations;
+    stats.P50Ms = Statistics::HistogramPercentile(buckets, evaluations, 50);
+    stats.P90Ms = Statistics::HistogramPercentile(buckets, evaluations, 90);
+    stats.P99Ms = Statistics::HistogramPercentile(buckets, evaluations, 99);
+    return stats;
+}
+
+static double CounterSeconds(int64_t ticks)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return static_cast<double>(ticks) / frequency.QuadPart;
+}
+
+// The logical processors of the CPU sets this process was pinned to, 0 when it was not pinned.
+static ULONG PinnedProcessorCount()
+{
+    ULONG count = 0;
+    GetProcessDefaultCpuSets(GetCurrentProcess(), nullptr, 0, &count);
+    return count;
+}
+
+// Random float tensors for every input. Free dimensions are evaluated with size 1.
+static void BindRandomInputs(const LearningModel& model, const LearningModelBinding& binding)
+{
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    for (auto&& input : model.InputFeatures())
+    {
+        auto descriptor = input.try_as<TensorFeatureDescriptor>();
+        if (!descriptor || descriptor.TensorKind() != TensorKind::Float)
+        {
+            throw hresult_invalid_argument(L"ScaleOut: every model input must be a float tensor.");
+        }
+        std::vector<int64_t> shape;
+        size_t elementCount = 1;
+        for (auto dim : descriptor.Shape())
+        {
+            shape.push_back(dim > 0 ? dim : 1);
+            elementCount *= static_cast<size_t>(shape.back());
+        }
+        std::vector<float> data(elementCount);
+        std::generate(data.begin(), data.end(), [&]() { return distribution(generator); });
+        binding.Bind(descriptor.Name(), TensorFloat::CreateFromArray(shape, data));
+    }
+}
+
+int RunScaleOutWorker(const std::wstring& section_name, unsigned index, const std::wstring& path,
+                      const LearningModelDevice& device, unsigned num_requests, unsigned timeout_seconds)
+{
+    handle mapping(OpenFileMappingW(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, section_name.c_str()));
+    if (!mapping)
+    {
+        throw_last_error();
+    }
+    SectionView view = MapSection(mapping.get());
+    auto header = static_cast<SectionHeader*>(view.get());
+    if (header->Magic != SectionMagic || index >= header->Workers)
+    {
+        throw hresult_invalid_argument(L"ScaleOutWorker: " + section_name + L" has no worker " +
+                                       std::to_wstring(index));
+    }
+    WorkerBlock& block = Blocks(header)[index];
+
+    LearningModel model = LearningModel::LoadFromFilePath(path);
+    // The intra-op thread pool is sized for the whole machine by default. Capped at the worker's share, so that
+    // neither run oversubscribes its CPUs and the slowdown between them is the interference of the other workers.
+    LearningModelSessionOptions options;
+    ULONG processors = PinnedProcessorCount();
+    auto nativeOptions = options.try_as<ILearningModelSessionOptionsNative>();
+    if (processors > 0 && nativeOptions)
+    {
+        check_hresult(nativeOptions->SetIntraOpNumThreadsOverride(processors));
+        std::cout << "Intra-op threads: " << processors << std::endl;
+    }
+    else
+    {
+        std::cout << "Intra-op threads: not capped" << std::endl;
+    }
+    LearningModelSession session(model, device, options);
+    LearningModelBinding binding(session);
+    BindRandomInputs(model, binding);
+    // Warm up so that first-run initialization is not charged to the measurement.
+    session.Evaluate(binding, L"");
+
+    // The barrier. Spinning takes nothing from the other workers, which have CPUs of their own, and starts this one
+    // within a microsecond of the release.
+    header->Arrived.fetch_add(1);
+    ULONGLONG deadline = GetTickCount64() + timeout_seconds * 1000ull;
+    while (header->Start.load(std::memory_order_acquire) == 0)
+    {
+        if (GetTickCount64() > deadline)
+        {
+            throw hresult_error(HRESULT_FROM_WIN32(ERROR_TIMEOUT), L"ScaleOutWorker: the coordinator never started.");
+        }
+        YieldProcessor();
+    }
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    for (unsigned request = 0; request < num_requests; request++)
+    {
+        LARGE_INTEGER start;
+        LARGE_INTEGER stop;
+        QueryPerformanceCounter(&start);
+        session.Evaluate(binding, L"");
+        QueryPerformanceCounter(&stop);
+        double milliseconds = (stop.QuadPart - start.QuadPart) * 1000.0 / frequency.QuadPart;
+        if (request == 0)
+        {
+            block.FirstStart = start.QuadPart;
+        }
+        block.LastEnd = stop.QuadPart;
+        block.TotalMs += milliseconds;
+        block.Buckets[Statistics::HistogramBucket(milliseconds)]++;
+        block.Evaluations++;
+    }
+    block.Done.store(1, std::memory_order_release);
+    return 0;
+}
+
+// Splits the physical cores of the machine into workers equal runs of whole cores, so that no two workers share a
+// core's caches or its SMT siblings. Cores left over go unused.
+static std::vector<WorkerCpus> PartitionCpuSets(uint32_t workers)
+{
+    ULONG length = 0;
+    GetSystemCpuSetInformation(nullptr, 0, &length, GetCurrentProcess(), 0);
+    std::vector<char> buffer(length);
+    if (!GetSystemCpuSetInformation(reinterpret_cast<SYSTEM_CPU_SET_INFORMATION*>(buffer.data()), length, &length,
+                                    GetCurrentProcess(), 0))
+    {
+        throw_last_error();
+    }
+    // The CPU sets of each core with the logical processor of each, by group and core.
+    std::map<std::pair<WORD, BYTE>, std::vector<std::pair<ULONG, uint32_t>>> cores;
+    for (ULONG offset = 0; offset < length;)
+    {
+        auto information = reinterpret_cast<const SYSTEM_CPU_SET_INFORMATION*>(buffer.data() + offset);
+        if (information->Type == CpuSetInformation)
+        {
+            const auto& cpuSet = information->CpuSet;
+            cores[{ cpuSet.Group, cpuSet.CoreIndex }].emplace_back(
+                cpuSet.Id, cpuSet.Group * 64u + cpuSet.LogicalProcessorIndex);
+        }
+        offset += information->Size;
+    }
+    uint32_t coresPerWorker = static_cast<uint32_t>(cores.size()) / workers;
+    if (coresPerWorker == 0)
+    {
+        throw hresult_invalid_argument(L"ScaleOut: " + std::to_wstring(workers) + L" workers need as many physical "
+                                       L"cores, and this machine has " + std::to_wstring(cores.size()) + L".");
+    }
+    std::vector<WorkerCpus> partition(workers);
+    auto core = cores.begin();
+    for (auto& cpus : partition)
+    {
+        cpus.Cores = coresPerWorker;
+        cpus.FirstProcessor = UINT32_MAX;
+        for (uint32_t i = 0; i < coresPerWorker; i++, core++)
+        {
+            for (const auto& cpuSet : core->second)
+            {
+                cpus.CpuSets.push_back(cpuSet.first);
+                cpus.FirstProcessor = (std::min)(cpus.FirstProcessor, cpuSet.second);
+                cpus.LastProcessor = (std::max)(cpus.LastProcessor, cpuSet.second);
+            }
+        }
+    }
+    return partition;
+}
+
+// Starts command_line suspended, restricts it to cpu_sets, which every thread it creates inherits, and resumes it.
+static handle StartWorker(const std::wstring& command_line, const std::vector<ULONG>& cpu_sets,
+                          const std::filesystem::path& log_path)
+{
+    SECURITY_ATTRIBUTES inheritable = { sizeof(inheritable), nullptr, TRUE };
+    file_handle log(CreateFileW(log_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &inheritable, CREATE_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, nullptr));
+    if (!log)
+    {
+        throw_last_error();
+    }
+    STARTUPINFOW startupInfo = {};
+    startupInfo.cb = sizeof(startupInfo);
+    startupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startupInfo.hStdOutput = log.get();
+    startupInfo.hStdError = log.get();
+    PROCESS_INFORMATION processInfo = {};
+    std::wstring commandLine = command_line;
+    check_bool(CreateProcessW(nullptr, &commandLine[0], nullptr, nullptr, TRUE, CREATE_SUSPENDED | CREATE_NO_WINDOW,
+                              nullptr, nullptr, &startupInfo, &processInfo));
+    handle process(processInfo.hProcess);
+    handle thread(processInfo.hThread);
+    if (!SetProcessDefaultCpuSets(process.get(), cpu_sets.data(), static_cast<ULONG>(cpu_sets.size())))
+    {
+        DWORD error = GetLastError();
+        TerminateProcess(process.get(), 1);
+        throw_hresult(HRESULT_FROM_WIN32(error));
+    }
+    ResumeThread(thread.get());
+    return process;
+}
+
+// Starts the workers listed, holds them at the barrier until every one has loaded the model and evaluated once, then
+// releases them together and waits for them to exit. Returns whether all of them measured.
+static bool RunRound(SectionHeader* header, uint32_t section_workers, const std::wstring& base_command_line,
+                     const std::vector<uint32_t>& workers, const std::vector<WorkerCpus>& partition,
+                     const std::filesystem::path& log_directory, const std::wstring& round, unsigned timeout_seconds)
+{
+    ResetSection(header, section_workers);
+    std::vector<handle> processes;
+    for (uint32_t worker : workers)
+    {
+        std::filesystem::path logPath =
+            log_directory / (round + L"_worker" + std::to_wstring(worker) + L".log");
+        processes.push_back(StartWorker(base_command_line + L" " + std::to_wstring(worker), partition[worker].CpuSets,
+                                        logPath));
+    }
+    ULONGLONG deadline = GetTickCount64() + timeout_seconds * 1000ull;
+    bool failed = false;
+    while (!failed && header->Arrived.load() < workers.size())
+    {
+        // A worker that exits before it arrives failed to load the model.
+        failed = GetTickCount64() > deadline ||
+                 std::any_of(processes.begin(), processes.end(),
+                             [](const handle& process) { return WaitForSingleObject(process.get(), 0) == WAIT_OBJECT_0; });
+        Sleep(1);
+    }
+    if (!failed)
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        header->Start.store(now.QuadPart, std::memory_order_release);
+    }
+    for (size_t i = 0; i < processes.size(); i++)
+    {
+        ULONGLONG now = GetTickCount64();
+        DWORD remaining = static_cast<DWORD>(deadline > now ? deadline - now : 0);
+        if (failed || WaitForSingleObject(processes[i].get(), remaining) != WAIT_OBJECT_0)
+        {
+            TerminateProcess(processes[i].get(), 1);
+            WaitForSingleObject(processes[i].get(), INFINITE);
+            failed = true;
+            continue;
+        }
+        DWORD exitCode = 0;
+        GetExitCodeProcess(processes[i].get(), &exitCode);
+        failed = exitCode != 0 || Blocks(header)[workers[i]].Done.load(std::memory_order_acquire) == 0;
+    }
+    return !failed;
+}
+
+static LatencyStats WorkerStats(SectionHeader* header, uint32_t worker)
+{
+    const WorkerBlock& block = Blocks(header)[worker];
+    return Summarize(block.Buckets, block.Evaluations, block.TotalMs, CounterSeconds(block.LastEnd - block.FirstStart));
+}
+
+static void WriteRow(std::ofstream& csv, const std::string& model, uint32_t workers, const std::string& worker,
+                     const std::string& cpus, const char* run, const LatencyStats& stats, double slowdown)
+{
+    csv << model << "," << workers << "," << worker << "," << cpus << "," << run << "," << stats.Evaluations << ","
+        << stats.Throughput << "," << stats.MeanMs << "," << stats.P50Ms << "," << stats.P90Ms << "," << stats.P99Ms
+        << ",";
+    if (slowdown > 0)
+    {
+        csv << slowdown;
+    }
+    csv << std::endl;
+}
+
+int RunScaleOut(const std::wstring& path, uint32_t workers, unsigned num_requests,
+                const std::wstring& perf_output_path, unsigned timeout_seconds)
+{
+    std::vector<WorkerCpus> partition = PartitionCpuSets(workers);
+    std::wstring sectionName = L"Local\\WinMLRunnerScaleOut" + std::to_wstring(GetCurrentProcessId());
+    size_t sectionBytes = SectionBytes(workers);
+    handle mapping(CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                      static_cast<DWORD>(static_cast<uint64_t>(sectionBytes) >> 32),
+                                      static_cast<DWORD>(sectionBytes), sectionName.c_str()));
+    if (!mapping)
+    {
+        throw_last_error();
+    }
+    SectionView view = MapSection(mapping.get());
+    auto header = static_cast<SectionHeader*>(view.get());
+
+    wchar_t executable[MAX_PATH] = {};
+    GetModuleFileNameW(nullptr, executable, MAX_PATH);
+    std::wstring baseCommandLine = QuoteArgument(executable);
+    for (const auto& argument : ChildArguments(ScaleOutOptions))
+    {
+        baseCommandLine += L" " + QuoteArgument(argument);
+    }
+    baseCommandLine += L" -ScaleOutWorker " + sectionName;
+    std::filesystem::path logDirectory =
+        std::filesystem::temp_directory_path() / (L"WinMLRunnerScaleOut_" + std::to_wstring(GetCurrentProcessId()));
+    std::filesystem::create_directories(logDirectory);
+
+    std::wcout << L"Scale-out benchmark for " << path << std::endl;
+    std::cout << "  " << workers << " workers of " << partition[0].Cores << " physical cores each, " << num_requests
+              << " evaluations per worker" << std::endl;
+
+    // Each worker alone on its CPUs first, as the baseline its slowdown is measured against.
+    std::vector<LatencyStats> solo(workers);
+    for (uint32_t worker = 0; worker < workers; worker++)
+    {
+        if (!RunRound(header, workers, baseCommandLine, { worker }, partition, logDirectory, L"solo", timeout_seconds))
+        {
+            std::wcout << L"Solo run of worker " << worker << L" [FAILED]. See " << logDirectory.wstring()
+                       << std::endl;
+            return 1;
+        }
+        solo[worker] = WorkerStats(header, worker);
+    }
+
+    std::vector<uint32_t> all(workers);
+    std::iota(all.begin(), all.end(), 0);
+    if (!RunRound(header, workers, baseCommandLine, all, partition, logDirectory, L"shared", timeout_seconds))
+    {
+        std::wcout << L"Shared run [FAILED]. See " << logDirectory.wstring() << std::endl;
+        return 1;
+    }
+    std::vector<LatencyStats> shared(workers);
+    std::vector<uint64_t> combinedBuckets(Statistics::HistogramBuckets);
+    uint64_t combinedEvaluations = 0;
+    double combinedMs = 0;
+    int64_t lastEnd = 0;
+    for (uint32_t worker = 0; worker < workers; worker++)
+    {
+        const WorkerBlock& block = Blocks(header)[worker];
+        shared[worker] = WorkerStats(header, worker);
+        for (uint32_t bucket = 0; bucket < Statistics::HistogramBuckets; bucket++)
+        {
+            combinedBuckets[bucket] += block.Buckets[bucket];
+        }
+        combinedEvaluations += block.Evaluations;
+        combinedMs += block.TotalMs;
+        lastEnd = (std::max)(lastEnd, block.LastEnd);
+    }
+    // From the release to the last evaluation to end, so that a worker finishing late counts against the total.
+    LatencyStats combined = Summarize(combinedBuckets.data(), combinedEvaluations, combinedMs,
+                                      CounterSeconds(lastEnd - header->Start.load()));
+    double soloThroughput = 0;
+    for (const auto& stats : solo)
+    {
+        soloThroughput += stats.Throughput;
+    }
+
+    std::cout << std::left << "  " << std::setw(8) << "Worker" << std::setw(10) << "CPUs" << std::right
+              << std::setw(16) << "Solo(eval/s)" << std::setw(16) << "Shared(eval/s)" << std::setw(12) << "Solo p50"
+              << std::setw(12) << "Shared p50" << std::setw(12) << "Shared p99" << std::setw(10) << "Slowdown"
+              << std::endl;
+    std::vector<std::string> cpuNames;
+    double slowdownTotal = 0;
+    for (uint32_t worker = 0; worker < workers; worker++)
+    {
+        cpuNames.push_back(std::to_string(partition[worker].FirstProcessor) + "-" +
+                           std::to_string(partition[worker].LastProcessor));
+        double slowdown = solo[worker].MeanMs > 0 ? shared[worker].MeanMs / solo[worker].MeanMs : 0;
+        slowdownTotal += slowdown;
+        std::cout << std::left << "  " << std::setw(8) << worker << std::setw(10) << cpuNames.back() << std::right
+                  << std::fixed << std::setprecision(1) << std::setw(16) << solo[worker].Throughput << std::setw(16)
+                  << shared[worker].Throughput << std::setprecision(3) << std::setw(12) << solo[worker].P50Ms
+                  << std::setw(12) << shared[worker].P50Ms << std::setw(12) << shared[worker].P99Ms
+                  << std::setprecision(2) << std::setw(9) << slowdown << "x" << std::defaultfloat << std::endl;
+    }
+    std::cout << std::fixed << std::setprecision(1) << "  Total: " << combined.Throughput << " eval/s, "
+              << (soloThroughput > 0 ? 100 * combined.Throughput / soloThroughput : 0)
+              << "% of the solo runs added up; mean slowdown " << std::setprecision(2) << slowdownTotal / workers
+              << "x" << std::endl;
+    std::cout << std::setprecision(3) << "  Combined latency (ms): p50 " << combined.P50Ms << ", p90 "
+              << combined.P90Ms << ", p99 " << combined.P99Ms << std::defaultfloat << std::endl;
+
+    if (!perf_output_path.empty())
+    {
+        bool writeHeader =
+            !std::filesystem::exists(perf_output_path) || std::filesystem::file_size(perf_output_path) == 0;
+        std::ofstream csv(std::filesystem::path(perf_output_path), std::ios::app);
+        if (writeHeader)
+        {
+            csv << "model,workers,worker,cpus,run,evaluations,throughput (eval/s),mean (ms),p50 (ms),p90 (ms),"
+                   "p99 (ms),slowdown"
+                << std::endl;
+        }
+        std::string modelName = std::filesystem::path(path).filename().string();
+        for (uint32_t worker = 0; worker < workers; worker++)
+        {
+            WriteRow(csv, modelName, workers, std::to_string(worker), cpuNames[worker], "solo", solo[worker], 0);
+            WriteRow(csv, modelName, workers, std::to_string(worker), cpuNames[worker], "shared", shared[worker],
+                     solo[worker].MeanMs > 0 ? shared[worker].MeanMs / solo[worker].MeanMs : 0);
+        }
+        WriteRow(csv, modelName, workers, "all", "", "shared", combined, slowdownTotal / workers);
+    }
+    std::filesystem::remove_all(logDirectory);
+    return 0;
+}
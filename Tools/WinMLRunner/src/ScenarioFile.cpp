@@ -0,0 +1,229 @@
+#include <cmath>
+#include <filesystem>
+#include <set>
+#include <winrt/Windows.Data.Json.h>
+
+#include "ScenarioFile.h"
+
+using namespace winrt::Windows::Data::Json;
+
+static const std::set<std::wstring> ScenarioKeys = { L"id",        L"model", L"input",      L"device",
+                                                     L"deviceCreation", L"binding", L"inputType", L"batch",
+                                                     L"iterations", L"threads" };
+
+static std::wstring Describe(size_t index, const std::wstring& id)
+{
+    return L"-ScenarioFile: scenario " + std::to_wstring(index + 1) + (id.empty() ? L"" : L" (" + id + L")");
+}
+
+// The value of key in the scenario, else in the defaults, else nullptr.
+static IJsonValue Find(const JsonObject& scenario, const JsonObject& defaults, const wchar_t* key)
+{
+    if (scenario.HasKey(key))
+    {
+        return scenario.GetNamedValue(key);
+    }
+    if (defaults != nullptr && defaults.HasKey(key))
+    {
+        return defaults.GetNamedValue(key);
+    }
+    return nullptr;
+}
+
+static std::wstring ReadString(const JsonObject& scenario, const JsonObject& defaults, const wchar_t* key,
+                               const std::wstring& where)
+{
+    IJsonValue value = Find(scenario, defaults, key);
+    if (value == nullptr)
+    {
+        return L"";
+    }
+    if (value.ValueType() != JsonValueType::String)
+    {
+        throw hresult_invalid_argument(where + L": \"" + key + L"\" must be a string.");
+    }
+    return value.GetString().c_str();
+}
+
+static uint32_t ReadCount(const JsonObject& scenario, const JsonObject& defaults, const wchar_t* key,
+                          uint32_t defaultValue, const std::wstring& where)
+{
+    IJsonValue value = Find(scenario, defaults, key);
+    if (value == nullptr)
+    {
+        return defaultValue;
+    }
+    double number = value.ValueType() == JsonValueType::Number ? value.GetNumber() : 0;
+    if (number < 1 || number > UINT32_MAX || number != std::floor(number))
+    {
+        throw hresult_invalid_argument(where + L": \"" + key + L"\" must be a positive integer.");
+    }
+    return static_cast<uint32_t>(number);
+}
+
+// Index of value among names, compared case insensitively as the command line flags are.
+static size_t ReadChoice(const std::wstring& value, const std::vector<const wchar_t*>& names, const wchar_t* key,
+                         const std::wstring& where)
+{
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        if (_wcsicmp(value.c_str(), names[i]) == 0)
+        {
+            return i;
+        }
+    }
+    std::wstring message = where + L": \"" + key + L"\" must be one of";
+    for (const wchar_t* name : names)
+    {
+        message += std::wstring(L" ") + name;
+    }
+    throw hresult_invalid_argument(message + L".");
+}
+
+static std::wstring ResolvePath(const std::filesystem::path& directory, const std::wstring& path)
+{
+    std::filesystem::path resolved(path);
+    return (resolved.is_absolute() ? resolved : directory / resolved).lexically_normal().wstring();
+}
+
+static BenchmarkScenario ReadScenario(const JsonObject& object, const JsonObject& defaults,
+                                      const std::filesystem::path& directory, size_t index)
+{
+    BenchmarkScenario scenario;
+    scenario.Id = ReadString(object, nullptr, L"id", Describe(index, L""));
+    std::wstring where = Describe(index, scenario.Id);
+    if (scenario.Id.empty())
+    {
+        throw hresult_invalid_argument(where + L": \"id\" is required.");
+    }
+    for (const auto& member : object)
+    {
+        if (ScenarioKeys.count(member.Key().c_str()) == 0)
+        {
+            throw hresult_invalid_argument(where + L": unknown key \"" + member.Key().c_str() + L"\".");
+        }
+    }
+
+    std::wstring model = ReadString(object, defaults, L"model", where);
+    if (model.empty())
+    {
+        throw hresult_invalid_argument(where + L": \"model\" is required.");
+    }
+    scenario.ModelPath = ResolvePath(directory, model);
+    if (!std::filesystem::exists(scenario.ModelPath))
+    {
+        throw hresult_invalid_argument(where + L": " + scenario.ModelPath + L" does not exist.");
+    }
+    std::wstring input = ReadString(object, defaults, L"input", where);
+    if (!input.empty())
+    {
+        scenario.InputPath = ResolvePath(directory, input);
+        std::wstring extension = std::filesystem::path(scenario.InputPath).extension().wstring();
+        ReadChoice(extension, { L".png", L".jpg", L".jpeg", L".csv" }, L"input", where);
+    }
+
+    std::wstring device = ReadString(object, defaults, L"device", where);
+    if (!device.empty())
+    {
+        static const DeviceType devices[] = { DeviceType::CPU, DeviceType::DefaultGPU, DeviceType::HighPerfGPU,
+                                              DeviceType::MinPowerGPU };
+        scenario.Device =
+            devices[ReadChoice(device, { L"CPU", L"GPU", L"GPUHighPerformance", L"GPUMinPower" }, L"device", where)];
+    }
+    std::wstring deviceCreation = ReadString(object, defaults, L"deviceCreation", where);
+    if (!deviceCreation.empty())
+    {
+        scenario.DeviceCreation = ReadChoice(deviceCreation, { L"WinML", L"Client" }, L"deviceCreation", where) == 0
+                                      ? DeviceCreationLocation::WinML
+                                      : DeviceCreationLocation::UserD3DDevice;
+    }
+    std::wstring binding = ReadString(object, defaults, L"binding", where);
+    if (!binding.empty())
+    {
+        scenario.Binding = ReadChoice(binding, { L"CPU", L"GPU" }, L"binding", where) == 0 ? InputBindingType::CPU
+                                                                                             : InputBindingType::GPU;
+    }
+    std::wstring inputType = ReadString(object, defaults, L"inputType", where);
+    if (!inputType.empty())
+    {
+        static const InputDataType inputTypes[] = { InputDataType::Tensor, InputDataType::ImageRGB,
+                                                    InputDataType::ImageBGR };
+        scenario.InputType = inputTypes[ReadChoice(inputType, { L"Tensor", L"RGB", L"BGR" }, L"inputType", where)];
+    }
+    scenario.BatchSize = ReadCount(object, defaults, L"batch", scenario.BatchSize, where);
+    scenario.Iterations = ReadCount(object, defaults, L"iterations", scenario.Iterations, where);
+    scenario.Threads = ReadCount(object, defaults, L"threads", scenario.Threads, where);
+
+    if (scenario.BatchSize > 1 && (!scenario.InputPath.empty() || scenario.InputType != InputDataType::Tensor))
+    {
+        // Images and CSV files hold a single sample.
+        throw hresult_invalid_argument(where + L": \"batch\" needs random tensor input.");
+    }
+    return scenario;
+}
+
+std::vector<BenchmarkScenario> LoadScenarioFile(const std::wstring& path)
+{
+    std::ifstream file(std::filesystem::path(path), std::ios::binary);
+    if (!file)
+    {
+        throw hresult_invalid_argument(L"-ScenarioFile: failed to open " + path);
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    JsonObject root = nullptr;
+    if (!JsonObject::TryParse(winrt::to_hstring(text), root))
+    {
+        throw hresult_invalid_argument(L"-ScenarioFile: " + path + L" is not a JSON object.");
+    }
+    for (const auto& member : root)
+    {
+        if (member.Key() != L"defaults" && member.Key() != L"scenarios")
+        {
+            throw hresult_invalid_argument(std::wstring(L"-ScenarioFile: unknown key \"") + member.Key().c_str() +
+                                           L"\".");
+        }
+    }
+    JsonObject defaults = nullptr;
+    if (root.HasKey(L"defaults"))
+    {
+        if (root.GetNamedValue(L"defaults").ValueType() != JsonValueType::Object)
+        {
+            throw hresult_invalid_argument(L"-ScenarioFile: \"defaults\" must be an object.");
+        }
+        defaults = root.GetNamedObject(L"defaults");
+        for (const auto& member : defaults)
+        {
+            if (ScenarioKeys.count(member.Key().c_str()) == 0 || member.Key() == L"id")
+            {
+                throw hresult_invalid_argument(std::wstring(L"-ScenarioFile: unknown default \"") +
+                                               member.Key().c_str() + L"\".");
+            }
+        }
+    }
+    if (!root.HasKey(L"scenarios") || root.GetNamedValue(L"scenarios").ValueType() != JsonValueType::Array)
+    {
+        throw hresult_invalid_argument(L"-ScenarioFile: \"scenarios\" must be an array.");
+    }
+
+    std::filesystem::path directory = std::filesystem::absolute(std::filesystem::path(path)).parent_path();
+    JsonArray entries = root.GetNamedArray(L"scenarios");
+    std::vector<BenchmarkScenario> scenarios;
+    std::set<std::wstring> ids;
+    for (uint32_t i = 0; i < entries.Size(); i++)
+    {
+        if (entries.GetAt(i).ValueType() != JsonValueType::Object)
+        {
+            throw hresult_invalid_argument(Describe(i, L"") + L" must be an object.");
+        }
+        scenarios.push_back(ReadScenario(entries.GetObjectAt(i), defaults, directory, i));
+        if (!ids.insert(scenarios.back().Id).second)
+        {
+            throw hresult_invalid_argument(Describe(i, scenarios.back().Id) + L": the id is already used.");
+        }
+    }
+    if (scenarios.empty())
+    {
+        throw hresult_invalid_argument(L"-ScenarioFile: " + path + L" lists no scenarios.");
+    }
+    return scenarios;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "Common.h"
+
+// One entry of a -ScenarioFile: a model evaluated on one device with one input, binding, input type, batch size and
+// intra-op thread count.
+struct BenchmarkScenario
+{
+    std::wstring Id;
+    std::wstring ModelPath;
+    // Image or CSV file bound to the model. Empty for random input.
+    std::wstring InputPath;
+    DeviceType Device = DeviceType::CPU;
+    DeviceCreationLocation DeviceCreation = DeviceCreationLocation::WinML;
+    InputBindingType Binding = InputBindingType::CPU;
+    InputDataType InputType = InputDataType::Tensor;
+    uint32_t BatchSize = 1;
+    uint32_t Iterations = 1;
+    // Threads the session runs one operator on. 0 leaves WinML's default, which is sized for the whole machine.
+    uint32_t Threads = 0;
+};
+
+// Reads the scenarios of a JSON file of the form
+//
+//   {
+//     "defaults": { "device": "GPU", "iterations": 50 },
+//     "scenarios": [
+//       { "id": "squeezenet-cpu", "model": "SqueezeNet.onnx", "device": "CPU" },
+//       { "id": "squeezenet-b4", "model": "SqueezeNet_free.onnx", "batch": 4, "threads": 2 }
+//     ]
+//   }
+//
+// Keys a scenario leaves out are taken from "defaults", then from the built in defaults of BenchmarkScenario. Model
+// and input paths are relative to the file. Ids must be unique, and unknown keys or values are errors rather than
+// being ignored, so that a typo cannot silently benchmark something else. Throws hresult_invalid_argument naming the
+// offending scenario.
+std::vector<BenchmarkScenario> LoadScenarioFile(const std::wstring& path);
@@ -0,0 +1,93 @@
+#include "ScenarioScheduler.h"
+
+void Scenario::EnterOrderedSection()
+{
+    if (m_inOrderedSection)
+    {
+        return;
+    }
+    m_scheduler.WaitForTurn(m_index);
+    m_inOrderedSection = true;
+    m_capture.Stop();
+}
+
+ScenarioScheduler::ScenarioScheduler(unsigned int maxParallel) : m_pool(maxParallel > 0 ? maxParallel : 1)
+{
+    // The streams must be redirected before any pool thread starts capturing.
+    ConsoleCapture::Install();
+}
+
+ScenarioScheduler::~ScenarioScheduler()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_turnChanged.wait(lock, [this] { return m_nextTurn == m_numSubmitted; });
+}
+
+void ScenarioScheduler::Submit(std::function<void(Scenario&)> work)
+{
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        index = m_numSubmitted++;
+        m_errors.emplace_back();
+    }
+    m_pool.SubmitWork([this, index, work]() { Run(index, work); });
+}
+
+void ScenarioScheduler::WaitAll()
+{
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_turnChanged.wait(lock, [this] { return m_nextTurn == m_numSubmitted; });
+        for (auto& scenarioError : m_errors)
+        {
+            if (scenarioError)
+            {
+                error = scenarioError;
+                break;
+            }
+        }
+        m_errors.assign(m_errors.size(), nullptr);
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void ScenarioScheduler::Run(size_t index, const std::function<void(Scenario&)>& work)
+{
+    std::exception_ptr error;
+    {
+        ConsoleCapture capture;
+        Scenario scenario(*this, index, capture);
+        try
+        {
+            work(scenario);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        // Scenarios start in submission order and only wait for earlier ones, so the earliest unfinished scenario never
+        // blocks here and a full pool cannot deadlock.
+        scenario.EnterOrderedSection();
+    }
+    EndTurn(index, error);
+}
+
+void ScenarioScheduler::WaitForTurn(size_t index)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_turnChanged.wait(lock, [this, index] { return m_nextTurn == index; });
+}
+
+void ScenarioScheduler::EndTurn(size_t index, std::exception_ptr error)
+{
+    // Notify under the lock: the destructor may run as soon as the last turn ends.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_errors[index] = error;
+    m_nextTurn = index + 1;
+    m_turnChanged.notify_all();
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "ConsoleCapture.h"
+#include "ThreadPool.h"
+
+class ScenarioScheduler;
+
+// A unit of work running on a ScenarioScheduler thread. Its console output is captured until it enters its ordered
+// section, so scenarios can run side by side while their output and results still come out in submission order.
+class Scenario
+{
+public:
+    // Blocks until every scenario submitted earlier has finished, then prints the output captured so far. Anything this
+    // scenario prints or writes afterwards (CSV rows, for instance) comes after all earlier scenarios and before all
+    // later ones. Later calls do nothing.
+    void EnterOrderedSection();
+
+    size_t Index() const { return m_index; }
+
+private:
+    friend class ScenarioScheduler;
+    Scenario(ScenarioScheduler& scheduler, size_t index, ConsoleCapture& capture)
+        : m_scheduler(scheduler), m_index(index), m_capture(capture)
+    {
+    }
+
+    ScenarioScheduler& m_scheduler;
+    size_t m_index;
+    ConsoleCapture& m_capture;
+    bool m_inOrderedSection = false;
+};
+
+// Runs up to maxParallel scenarios at a time on a ThreadPool. A scenario that returns or throws without entering its
+// ordered section enters it on completion, so output is never lost or reordered.
+class ScenarioScheduler
+{
+public:
+    explicit ScenarioScheduler(unsigned int maxParallel);
+    ~ScenarioScheduler();
+    ScenarioScheduler(const ScenarioScheduler&) = delete;
+    ScenarioScheduler& operator=(const ScenarioScheduler&) = delete;
+
+    // Queues work; scenarios start in the order they are submitted. Call from one thread only.
+    void Submit(std::function<void(Scenario&)> work);
+
+    // Waits for every submitted scenario, then rethrows the exception of the earliest one that failed.
+    void WaitAll();
+
+private:
+    friend class Scenario;
+    void Run(size_t index, const std::function<void(Scenario&)>& work);
+    void WaitForTurn(size_t index);
+    void EndTurn(size_t index, std::exception_ptr error);
+
+    std::mutex m_mutex;
+    std::condition_variable m_turnChanged;
+    // Index of the scenario allowed into its ordered section, which is the number of scenarios that have finished.
+    size_t m_nextTurn = 0;
+    size_t m_numSubmitted = 0;
+    std::vector<std::exception_ptr> m_errors;
+    // Declared last so that the pool threads are joined before the state they use is destroyed.
+    ThreadPool m_pool;
+};
@@ -1,9 +1,145 @@
 #pragma once
 
+#include <functional>
+#include <map>
+
 #include "common.h"
+#include "CommandLineArgs.h"
+#include "InferenceBackend.h"
+#include "OnnxExternalData.h"
+#include "OnnxQuantizer.h"
 
 // load a model in a multi-threaded environment with num_threads number of
 // threads Each thread will load a model once, with interval in milliseconds for
-// each thread tasks
+// each thread tasks. Models are loaded as load_mode and prefetch say, as -LoadMode
+// and -PrefetchModel load them elsewhere. With use_cache, loads go through the
+// process-wide ModelCache so threads asking for the same model share a single load.
 void ConcurrentLoadModel(const std::vector<std::wstring>& paths, unsigned num_threads, unsigned interval_milliseconds,
-                         bool print_info);
+                         bool print_info, ModelSource::LoadMode load_mode, bool prefetch, bool use_cache = false);
+
+// Serve num_clients closed-loop clients, each sending requests_per_client single-example requests, first with batch
+// size 1 and then through a MicroBatcher that coalesces up to max_batch_size requests waiting at most
+// max_wait_milliseconds. Prints throughput and latency percentiles for both.
+void MicroBatchingBenchmark(const std::wstring& path,
+                            const winrt::Windows::AI::MachineLearning::LearningModelDevice& device,
+                            const std::string& device_name, unsigned max_batch_size, double max_wait_milliseconds,
+                            unsigned num_clients, unsigned requests_per_client);
+
+// Evaluate the model num_requests times with synchronous Evaluate, then through an AsyncEvaluator that keeps up to
+// 1, 2, 4, ... max_in_flight EvaluateAsync calls outstanding. Prints throughput, the speedup over Evaluate and latency
+// percentiles for each depth.
+void AsyncEvaluationBenchmark(const std::wstring& path,
+                              const winrt::Windows::AI::MachineLearning::LearningModelDevice& device,
+                              const std::string& device_name, unsigned max_in_flight, unsigned num_requests);
+
+// Evaluate the model num_requests times with each input handed over through a file, then with each input streamed
+// from a producer process through a shared memory ring of ring_slots tensor slots and bound in place. Prints
+// throughput and latency percentiles for both. Requires a single float tensor input.
+void SharedMemoryInputBenchmark(const std::wstring& path,
+                                const winrt::Windows::AI::MachineLearning::LearningModelDevice& device,
+                                const std::string& device_name, unsigned ring_slots, unsigned num_requests);
+
+// Load the model once, keep a warm MicroBatcher per device and answer ServeProtocol requests on the named pipe
+// pipe_name until a client asks the server to shut down. Requests arriving together are batched up to
+// max_batch_size, waiting at most max_wait_milliseconds. Requires a single float tensor input with a free batch
+// dimension. Returns 0 on success.
+int ServeModel(const std::wstring& path,
+               const std::vector<winrt::Windows::AI::MachineLearning::LearningModelDevice>& devices,
+               const std::vector<std::string>& device_names, const std::wstring& pipe_name, unsigned max_batch_size,
+               double max_wait_milliseconds);
+
+// Connect num_clients closed-loop clients to the server on pipe_name, each sending requests_per_client random
+// single-example requests spread over the server's devices. Prints client-side throughput and latency percentiles and
+// the server's queue and latency statistics, then asks the server to shut down if stop_server is set.
+int RunServeClient(const std::wstring& pipe_name, unsigned num_clients, unsigned requests_per_client,
+                   bool stop_server);
+
+// Load the model through backend, create a session, bind input_path (CSV values for the single input, in tensor
+// order) or random values and evaluate num_iterations times. Prints load, session creation, bind and evaluation times
+// and the top_k scores of each float output. With save_tensor_path set, each float output of the last evaluation is
+// written to save_tensor_path\<output><backend><device_name>.csv in the -SaveTensorData format. Returns 0 on success.
+int RunBackendBenchmark(InferenceBackend::Backend& backend, const std::wstring& path, const std::string& device_name,
+                        const std::wstring& input_path, unsigned num_iterations, unsigned top_k,
+                        const std::wstring& save_tensor_path);
+
+// Load reference_path and candidate_path through backend, bind the same input_path CSV values or random values to
+// both, evaluate once and print the max and mean absolute error and the top-1 and top_k agreement of every floating
+// point output of the reference model. Returns 0 when every output could be compared, 1 otherwise.
+int CompareModelOutputs(InferenceBackend::Backend& backend, const std::wstring& reference_path,
+                        const std::wstring& candidate_path, const std::string& device_name,
+                        const std::wstring& input_path, unsigned top_k);
+
+// Calibrate the float model at path on the reference CPU backend with every sample in calibration_path: .csv and .npy
+// files holding the values of the single float input in tensor order, and .png, .jpg and .bmp images, which
+// load_image turns into the values of the input given the absolute path of the image. Writes the QDQ model to
+// output_path, then evaluates both models on every sample through each of backends, named device_names, and prints how
+// often their top-1 results agree and the average evaluation time of each. Returns 0 on success.
+int QuantizeWithCalibration(const std::wstring& path, const std::wstring& output_path,
+                            const std::wstring& calibration_path, const Onnx::QuantizationOptions& options,
+                            const std::function<std::vector<float>(const std::wstring&)>& load_image,
+                            const std::vector<InferenceBackend::Backend*>& backends,
+                            const std::vector<std::string>& device_names);
+
+// Move the initializers of the model at path that options selects into a data file beside output_path and write the
+// rest of the model to output_path. Then read every weight of both models, copied into the heap and mapped with
+// MapModel, and print how much the working set and the private bytes of the process grow each way. Returns 0 on
+// success.
+int SplitModelExternalData(const std::wstring& path, const std::wstring& output_path,
+                           const Onnx::ExternalDataOptions& options);
+
+// Write a chain of MatMuls with size_mb of weights to output_path and its external data file, then print the memory
+// it takes to read every weight as SplitModelExternalData does. Returns 0 on success.
+int GenerateSyntheticModel(const std::wstring& output_path, uint64_t size_mb);
+
+// The arguments this process was started with, less options: lowercase names with the number of values each takes,
+// or -1 for a single optional value.
+std::vector<std::wstring> ChildArguments(const std::map<std::wstring, int>& options);
+
+// Quotes argument so that CommandLineToArgvW reads it back unchanged.
+std::wstring QuoteArgument(const std::wstring& argument);
+
+// Run each of units in a WinMLRunner child process of its own, started with this process's arguments less the
+// isolation options, -folder, -model and -PerfOutput, plus unit_option followed by the unit (-model <path> or
+// -OnlyScenario <id>). Up to max_children run at once, each in a job object that kills it after timeout_seconds and,
+// unless memory_limit_mb is 0, fails its allocations past that many MB; children after the first only start while as
+// much physical memory is available. Each child's console output goes to a log beside journal_path, its perf CSV rows
+// are appended to perf_output_path once it exits, and then its outcome (ok, failed, crashed or timeout), exit code,
+// duration and unit are appended to journal_path. Units journal_path already lists are skipped, so a sweep that was
+// interrupted resumes where it stopped. The CPU peak is measured once before the first child starts and passed to
+// every child with -MachinePeak. Returns 0 when every child run succeeded.
+int SuperviseChildren(const std::wstring& unit_option, const std::vector<std::wstring>& units,
+                      const std::wstring& journal_path, const std::wstring& perf_output_path, unsigned max_children,
+                      unsigned timeout_seconds, uint64_t memory_limit_mb);
+
+// Start a WinMLRunner child process launches times, each with this process's arguments less the cold start options,
+// -Iterations and -PerfOutput, to evaluate the model at path once and report its startup milestones. Prints how each
+// launch's time to first result, counted from the call to CreateProcess, splits into process start, runtime DLL load,
+// device creation, COM apartment init, model load, session creation, first bind, first evaluate and the rest, then the
+// median, minimum and maximum of each. With evict_model, the model is dropped from the file cache before each launch
+// and each is followed by a launch that finds it cached, and the two are summarized apart. Each launch is a row of
+// perf_output_path unless it is empty; a launch running longer than timeout_seconds is killed. Returns 0 when every
+// launch reported.
+int MeasureColdStarts(const std::wstring& path, unsigned launches, bool evict_model,
+                      const std::wstring& perf_output_path, unsigned timeout_seconds);
+
+// Run the model at path in workers WinMLRunner child processes, each started with this process's arguments less the
+// scale-out options and -PerfOutput and pinned to CPU sets covering its own equal share of the physical cores. Each
+// worker first runs alone, then all run together. In every run the workers load the model and evaluate once, wait at
+// a barrier in a shared memory section until all have, and then evaluate num_requests times, counting each latency
+// into a histogram of their own in the section. Prints the throughput and latency percentiles of each worker alone
+// and shared with the slowdown between them, and the total throughput and combined percentiles. Each run of a worker
+// and the total are rows of perf_output_path unless it is empty; a run longer than timeout_seconds is killed. Returns
+// 0 when every worker measured.
+int RunScaleOut(const std::wstring& path, uint32_t workers, unsigned num_requests,
+                const std::wstring& perf_output_path, unsigned timeout_seconds);
+
+// Open the shared memory section called section_name, load the model at path on device and evaluate it once, then
+// wait at the barrier until RunScaleOut releases the workers, evaluate num_requests times and record the latencies
+// in the histogram of worker index. This is the worker process RunScaleOut starts. Returns 0 on success.
+int RunScaleOutWorker(const std::wstring& section_name, unsigned index, const std::wstring& path,
+                      const winrt::Windows::AI::MachineLearning::LearningModelDevice& device, unsigned num_requests,
+                      unsigned timeout_seconds);
+
+// Open the shared memory ring called name, publish num_tensors tensors into it and close it. This is the producer
+// process SharedMemoryInputBenchmark starts. Returns 0 on success.
+int RunRingProducer(const std::wstring& name, unsigned num_tensors);
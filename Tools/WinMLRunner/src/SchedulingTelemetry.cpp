@@ -0,0 +1,133 @@
+#include <vector>
+
+#include <windows.h>
+#include <winternl.h>
+
+#include "SchedulingTelemetry.h"
+
+// The entries NtQuerySystemInformation(SystemProcessInformation) fills, laid out in full: winternl.h calls most of
+// the fields read here Reserved.
+struct ThreadInformation
+{
+    LARGE_INTEGER KernelTime;
+    LARGE_INTEGER UserTime;
+    LARGE_INTEGER CreateTime;
+    ULONG WaitTime;
+    PVOID StartAddress;
+    HANDLE UniqueProcess;
+    HANDLE UniqueThread;
+    LONG Priority;
+    LONG BasePriority;
+    ULONG ContextSwitches;
+    ULONG ThreadState;
+    ULONG WaitReason;
+};
+
+struct ProcessInformation
+{
+    ULONG NextEntryOffset;
+    ULONG NumberOfThreads;
+    LARGE_INTEGER WorkingSetPrivateSize;
+    ULONG HardFaultCount;
+    ULONG NumberOfThreadsHighWatermark;
+    ULONGLONG CycleTime;
+    LARGE_INTEGER CreateTime;
+    LARGE_INTEGER UserTime;
+    LARGE_INTEGER KernelTime;
+    UNICODE_STRING ImageName;
+    LONG BasePriority;
+    HANDLE UniqueProcessId;
+    HANDLE InheritedFromUniqueProcessId;
+    ULONG HandleCount;
+    ULONG SessionId;
+    ULONG_PTR UniqueProcessKey;
+    SIZE_T PeakVirtualSize;
+    SIZE_T VirtualSize;
+    ULONG PageFaultCount;
+    SIZE_T PeakWorkingSetSize;
+    SIZE_T WorkingSetSize;
+    SIZE_T QuotaPeakPagedPoolUsage;
+    SIZE_T QuotaPagedPoolUsage;
+    SIZE_T QuotaPeakNonPagedPoolUsage;
+    SIZE_T QuotaNonPagedPoolUsage;
+    SIZE_T PagefileUsage;
+    SIZE_T PeakPagefileUsage;
+    SIZE_T PrivatePageCount;
+    LARGE_INTEGER IoCounters[6];
+    // Followed by NumberOfThreads ThreadInformation.
+};
+
+static const NTSTATUS StatusInfoLengthMismatch = static_cast<NTSTATUS>(0xC0000004);
+
+// NtQuerySystemInformation is not in the SDK's import libraries, so it is looked up in ntdll.
+using NtQuerySystemInformationFunction = NTSTATUS(WINAPI*)(SYSTEM_INFORMATION_CLASS, PVOID, ULONG, PULONG);
+
+static NtQuerySystemInformationFunction QuerySystemInformation()
+{
+    static auto query = reinterpret_cast<NtQuerySystemInformationFunction>(
+        GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "NtQuerySystemInformation"));
+    return query;
+}
+
+namespace SchedulingTelemetry
+{
+Counters Read()
+{
+    Counters counters;
+    NtQuerySystemInformationFunction query = QuerySystemInformation();
+    if (query == nullptr)
+    {
+        return counters;
+    }
+    // Kept from one read to the next, so that only the first allocates.
+    thread_local std::vector<char> buffer(256 * 1024);
+    ULONG needed = 0;
+    NTSTATUS status;
+    while ((status = query(SystemProcessInformation, buffer.data(), static_cast<ULONG>(buffer.size()), &needed)) ==
+           StatusInfoLengthMismatch)
+    {
+        // Room for the processes started until the next call.
+        buffer.resize(needed + 64 * 1024);
+    }
+    if (status < 0)
+    {
+        return counters;
+    }
+
+    HANDLE processId = ULongToHandle(GetCurrentProcessId());
+    HANDLE threadId = ULongToHandle(GetCurrentThreadId());
+    for (size_t offset = 0;;)
+    {
+        auto process = reinterpret_cast<const ProcessInformation*>(buffer.data() + offset);
+        if (process->UniqueProcessId == processId)
+        {
+            auto threads = reinterpret_cast<const ThreadInformation*>(process + 1);
+            for (ULONG i = 0; i < process->NumberOfThreads; i++)
+            {
+                counters.ProcessContextSwitches += threads[i].ContextSwitches;
+                if (threads[i].UniqueThread == threadId)
+                {
+                    counters.ThreadContextSwitches = threads[i].ContextSwitches;
+                }
+            }
+            counters.PageFaults = process->PageFaultCount;
+            counters.HardFaults = process->HardFaultCount;
+            counters.Valid = true;
+            break;
+        }
+        if (process->NextEntryOffset == 0)
+        {
+            break;
+        }
+        offset += process->NextEntryOffset;
+    }
+    return counters;
+}
+
+uint32_t CurrentProcessor()
+{
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx(&processor);
+    return processor.Group * 64u + processor.Number;
+}
+} // namespace SchedulingTelemetry
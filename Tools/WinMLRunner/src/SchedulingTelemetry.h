@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+
+// What the OS did to this process while an evaluation ran, to tell why an iteration was slow. The counters come from
+// the process and thread list ntdll keeps for Task Manager, which is what Windows has for getrusage(RUSAGE_THREAD)
+// and /proc/self/task/*/sched: it does not tell voluntary context switches from involuntary ones, and does not count
+// migrations, so only the CPUs an iteration started and ended on are known.
+namespace SchedulingTelemetry
+{
+struct Counters
+{
+    // False when the list could not be read.
+    bool Valid = false;
+    uint64_t ThreadContextSwitches = 0;
+    // Summed over every thread of the process, the WinML worker threads included.
+    uint64_t ProcessContextSwitches = 0;
+    // Soft and hard faults of the process, and the hard ones alone, which read from disk.
+    uint64_t PageFaults = 0;
+    uint64_t HardFaults = 0;
+};
+
+struct Iteration
+{
+    Counters Delta;
+    uint32_t StartProcessor = 0;
+    uint32_t EndProcessor = 0;
+};
+
+// The counters of the calling thread and its process. Reading them takes a snapshot of every process of the system,
+// so it is taken outside the measured intervals.
+Counters Read();
+
+// The CPU the calling thread runs on, numbered across processor groups.
+uint32_t CurrentProcessor();
+
+class Recorder
+{
+public:
+    // The CPU is noted after the counters are read on Start and before they are on Stop, so as close to the interval
+    // as possible.
+    void Start()
+    {
+        m_start = Read();
+        m_startProcessor = CurrentProcessor();
+    }
+
+    Iteration Stop()
+    {
+        Iteration iteration;
+        iteration.StartProcessor = m_startProcessor;
+        iteration.EndProcessor = CurrentProcessor();
+        Counters end = Read();
+        // The switches of threads that exited in between leave the process sum, which may then shrink.
+        auto difference = [](uint64_t start, uint64_t stop) { return stop > start ? stop - start : 0; };
+        iteration.Delta.Valid = m_start.Valid && end.Valid;
+        iteration.Delta.ThreadContextSwitches = difference(m_start.ThreadContextSwitches, end.ThreadContextSwitches);
+        iteration.Delta.ProcessContextSwitches = difference(m_start.ProcessContextSwitches, end.ProcessContextSwitches);
+        iteration.Delta.PageFaults = difference(m_start.PageFaults, end.PageFaults);
+        iteration.Delta.HardFaults = difference(m_start.HardFaults, end.HardFaults);
+        return iteration;
+    }
+
+private:
+    Counters m_start;
+    uint32_t m_startProcessor = 0;
+};
+} // namespace SchedulingTelemetry
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <Windows.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Wire format between a WinMLRunner -Serve server and its clients over a local named pipe. Every message is a fixed
+// header followed by a body of BodyBytes bytes. Integers are little-endian, tensor payloads are packed row-major.
+//
+// Requests:
+//   Describe: empty body. The response body is a DescribeBody followed by Rank int64 dimensions of one input example.
+//   Infer:    a TensorHeader, Rank int64 dimensions and the payload. The response body is an InferBody followed by
+//             OutputCount tensors, each a TensorHeader, its dimensions and its payload.
+//   Stats:    empty body. The response body is a StatsBody.
+//   Shutdown: empty body. The server answers, stops accepting connections, answers the requests it is evaluating,
+//             then closes every connection, dropping requests that were sent but not yet read, and exits.
+// A response with a Result other than Ok carries a UTF-8 error message as its body.
+namespace ServeProtocol
+{
+    constexpr uint32_t Magic = 0x534c4d57; // "WMLS"
+    constexpr uint8_t MaxRank = 8;
+    // Largest body either side accepts, so that a corrupt header cannot make the peer allocate without bound.
+    constexpr uint32_t MaxBodyBytes = 256 * 1024 * 1024;
+
+    enum class MessageType : uint8_t
+    {
+        Describe = 1,
+        Infer = 2,
+        Stats = 3,
+        Shutdown = 4
+    };
+
+    enum class DataType : uint8_t
+    {
+        Float32 = 1
+    };
+
+    enum class Status : uint8_t
+    {
+        Ok = 0,
+        InvalidRequest = 1,
+        EvaluationFailed = 2
+    };
+
+#pragma pack(push, 1)
+    struct RequestHeader
+    {
+        uint32_t Magic;
+        MessageType Type;
+        // Index of the device to evaluate on, in the order the server was given them. Infer only.
+        uint8_t Device;
+        uint16_t Reserved;
+        uint32_t BodyBytes;
+    };
+
+    struct ResponseHeader
+    {
+        uint32_t Magic;
+        Status Result;
+        uint8_t Reserved[3];
+        uint32_t BodyBytes;
+    };
+
+    struct TensorHeader
+    {
+        DataType ElementType;
+        uint8_t Rank;
+        uint16_t Reserved;
+        uint32_t PayloadBytes;
+    };
+
+    struct DescribeBody
+    {
+        uint32_t DeviceCount;
+        uint32_t MaxBatchSize;
+        DataType InputDataType;
+        uint8_t InputRank;
+        uint16_t Reserved;
+    };
+
+    struct InferBody
+    {
+        // Size of the batch the request was evaluated in.
+        uint32_t BatchSize;
+        uint32_t OutputCount;
+        // Time the request waited for its batch to start evaluating.
+        float QueueMilliseconds;
+        // Time from the request being read to its response being ready, including the queue time.
+        float ServerMilliseconds;
+    };
+
+    // Counters since the server started. Percentiles are in milliseconds.
+    struct StatsBody
+    {
+        uint64_t Requests;
+        uint64_t Batches;
+        uint64_t Errors;
+        uint32_t QueueDepth;
+        uint32_t Connections;
+        double UptimeSeconds;
+        double QueueP50;
+        double QueueP90;
+        double QueueP99;
+        double ServerP50;
+        double ServerP90;
+        double ServerP99;
+    };
+#pragma pack(pop)
+
+    template <typename T> void Append(std::vector<uint8_t>& buffer, const T& value)
+    {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    inline void Append(std::vector<uint8_t>& buffer, const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+
+    // Bounds-checked reads from a received body. Take fails instead of reading past the end.
+    class BodyReader
+    {
+    public:
+        BodyReader(const std::vector<uint8_t>& body) : m_body(body) {}
+
+        bool Take(void* data, size_t size)
+        {
+            if (size > m_body.size() - m_offset)
+            {
+                return false;
+            }
+            memcpy(data, m_body.data() + m_offset, size);
+            m_offset += size;
+            return true;
+        }
+
+        template <typename T> bool Take(T& value) { return Take(&value, sizeof(T)); }
+
+        // Reads a TensorHeader and its dimensions, leaving the payload next.
+        bool TakeTensorHeader(TensorHeader& header, std::vector<int64_t>& shape)
+        {
+            if (!Take(header) || header.Rank > MaxRank)
+            {
+                return false;
+            }
+            shape.resize(header.Rank);
+            return Take(shape.data(), shape.size() * sizeof(int64_t));
+        }
+
+        const uint8_t* Current() const { return m_body.data() + m_offset; }
+        size_t Remaining() const { return m_body.size() - m_offset; }
+        bool Skip(size_t size)
+        {
+            if (size > Remaining())
+            {
+                return false;
+            }
+            m_offset += size;
+            return true;
+        }
+
+    private:
+        const std::vector<uint8_t>& m_body;
+        size_t m_offset = 0;
+    };
+
+    // One end of a pipe opened with FILE_FLAG_OVERLAPPED. Reads and writes block until done, but another thread can
+    // abort them with Cancel, which is how the server closes connections that are waiting for a request.
+    class PipeStream
+    {
+    public:
+        explicit PipeStream(HANDLE pipe) : m_pipe(pipe), m_event(CreateEventW(nullptr, TRUE, FALSE, nullptr)) {}
+        ~PipeStream()
+        {
+            CloseHandle(m_event);
+            CloseHandle(m_pipe);
+        }
+        PipeStream(const PipeStream&) = delete;
+        PipeStream& operator=(const PipeStream&) = delete;
+
+        HANDLE Handle() const { return m_pipe; }
+
+        bool Read(void* data, size_t size)
+        {
+            uint8_t* bytes = static_cast<uint8_t*>(data);
+            while (size > 0)
+            {
+                DWORD transferred = 0;
+                if (!Wait(ReadFile(m_pipe, bytes, static_cast<DWORD>(size), nullptr, Reset()), transferred) ||
+                    transferred == 0)
+                {
+                    return false;
+                }
+                bytes += transferred;
+                size -= transferred;
+            }
+            return true;
+        }
+
+        bool Write(const void* data, size_t size)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            while (size > 0)
+            {
+                DWORD transferred = 0;
+                if (!Wait(WriteFile(m_pipe, bytes, static_cast<DWORD>(size), nullptr, Reset()), transferred) ||
+                    transferred == 0)
+                {
+                    return false;
+                }
+                bytes += transferred;
+                size -= transferred;
+            }
+            return true;
+        }
+
+        // Reads a header of type Header and its body. Fails on a broken pipe, a bad magic or an oversized body.
+        template <typename Header> bool ReadMessage(Header& header, std::vector<uint8_t>& body)
+        {
+            if (!Read(&header, sizeof(header)) || header.Magic != Magic || header.BodyBytes > MaxBodyBytes)
+            {
+                return false;
+            }
+            body.resize(header.BodyBytes);
+            return Read(body.data(), body.size());
+        }
+
+        // Writes a header of type Header and body in one call, so that a small message is a single pipe write.
+        template <typename Header> bool WriteMessage(Header header, const std::vector<uint8_t>& body)
+        {
+            header.Magic = Magic;
+            header.BodyBytes = static_cast<uint32_t>(body.size());
+            std::vector<uint8_t> message;
+            message.reserve(sizeof(header) + body.size());
+            Append(message, header);
+            Append(message, body.data(), body.size());
+            return Write(message.data(), message.size());
+        }
+
+        void Cancel() { CancelIoEx(m_pipe, nullptr); }
+
+    private:
+        OVERLAPPED* Reset()
+        {
+            m_overlapped = {};
+            m_overlapped.hEvent = m_event;
+            return &m_overlapped;
+        }
+
+        bool Wait(BOOL started, DWORD& transferred)
+        {
+            if (!started && GetLastError() != ERROR_IO_PENDING)
+            {
+                return false;
+            }
+            return GetOverlappedResult(m_pipe, &m_overlapped, &transferred, TRUE) != FALSE;
+        }
+
+        HANDLE m_pipe;
+        HANDLE m_event;
+        OVERLAPPED m_overlapped = {};
+    };
+
+    inline std::wstring PipePath(const std::wstring& name) { return L"\\\\.\\pipe\\" + name; }
+}
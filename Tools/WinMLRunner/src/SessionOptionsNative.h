@@ -0,0 +1,10 @@
+#pragma once
+#include "Common.h"
+
+// Caps the threads a session runs one operator on. Declared here as the 10.0.18362 SDK the runner builds against
+// predates it; WinML versions without it do not implement it, so query it with try_as.
+MIDL_INTERFACE("c71e953f-37b4-4564-8658-d8396866db0d")
+ILearningModelSessionOptionsNative : IUnknown
+{
+    virtual HRESULT STDMETHODCALLTYPE SetIntraOpNumThreadsOverride(UINT32 intraOpNumThreads) = 0;
+};
@@ -0,0 +1,226 @@
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+
+#include "Windows.h"
+#include "common.h"
+#include "TensorRing.h"
+#include "Scenarios.h"
+#include "Statistics.h"
+
+using namespace winrt;
+using namespace winrt::Windows::AI::MachineLearning;
+
+// How long the producer waits for a free slot, and the consumer for a published one, before giving up.
+static const DWORD RingTimeoutMilliseconds = 10000;
+
+struct HandoffStats
+{
+    double throughput = 0;
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+};
+
+static HandoffStats ComputeStats(std::vector<double>& latencies, double elapsed)
+{
+    std::sort(latencies.begin(), latencies.end());
+    HandoffStats stats;
+    stats.throughput = elapsed > 0 ? latencies.size() * 1000.0 / elapsed : 0;
+    stats.p50 = Statistics::Percentile(latencies, 50);
+    stats.p90 = Statistics::Percentile(latencies, 90);
+    stats.p99 = Statistics::Percentile(latencies, 99);
+    return stats;
+}
+
+static TensorFeatureDescriptor GetSingleFloatInput(const LearningModel& model)
+{
+    TensorFeatureDescriptor descriptor = nullptr;
+    if (model.InputFeatures().Size() == 1)
+    {
+        descriptor = model.InputFeatures().GetAt(0).try_as<TensorFeatureDescriptor>();
+    }
+    if (!descriptor || descriptor.TensorKind() != TensorKind::Float)
+    {
+        throw hresult_invalid_argument(L"SharedMemoryInput: the model must have a single float tensor input.");
+    }
+    return descriptor;
+}
+
+// Each request is handed over through a file, as -Input does between processes: the tensor is written to disk, read
+// back into a new tensor and evaluated.
+static HandoffStats EvaluateFromFiles(const LearningModelSession& session, const hstring& inputName,
+                                      const std::vector<int64_t>& shape, const std::vector<float>& frame,
+                                      unsigned num_requests)
+{
+    auto path = std::filesystem::temp_directory_path() /
+                (L"WinMLRunnerHandoff" + std::to_wstring(GetCurrentProcessId()) + L".bin");
+    LearningModelBinding binding(session);
+    std::vector<float> input(frame.size());
+    std::vector<double> latencies;
+    Timer wallClock;
+    wallClock.Start();
+    for (unsigned request = 0; request < num_requests; request++)
+    {
+        Timer timer;
+        timer.Start();
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(frame.data()), frame.size() * sizeof(float));
+        }
+        std::ifstream in(path, std::ios::binary);
+        if (!in.read(reinterpret_cast<char*>(input.data()), input.size() * sizeof(float)))
+        {
+            throw hresult_error(E_FAIL, L"SharedMemoryInput: failed to read back the input file.");
+        }
+        binding.Bind(inputName, TensorFloat::CreateFromArray(shape, input));
+        session.Evaluate(binding, L"");
+        latencies.push_back(timer.Stop());
+    }
+    double elapsed = wallClock.Stop();
+    std::filesystem::remove(path);
+    return ComputeStats(latencies, elapsed);
+}
+
+// Starts this executable as a ring producer in a separate process and evaluates every tensor it publishes, bound in
+// place from its slot. Latency is measured from publication, so it includes the time a tensor waited in the ring.
+// Throughput is measured from the first published tensor, leaving out the producer's process startup.
+static HandoffStats EvaluateFromRing(const LearningModelSession& session, const hstring& inputName,
+                                     const std::vector<int64_t>& shape, size_t element_count, unsigned ring_slots,
+                                     unsigned num_requests)
+{
+    std::wstring name = L"Local\\WinMLRunnerRing" + std::to_wstring(GetCurrentProcessId());
+    auto ring = TensorRing::SharedTensorRing::Create(name, static_cast<uint32_t>(element_count * sizeof(float)),
+                                                     ring_slots);
+    std::vector<TensorFloat> slotTensors;
+    for (uint32_t slot = 0; slot < ring_slots; slot++)
+    {
+        slotTensors.push_back(ring->CreateSlotTensor(shape, slot));
+    }
+    LearningModelBinding binding(session);
+
+    wchar_t executable[MAX_PATH];
+    GetModuleFileNameW(nullptr, executable, MAX_PATH);
+    std::wstring commandLine = L"\"" + std::wstring(executable) + L"\" -RingProducer " + name + L" -Requests " +
+                               std::to_wstring(num_requests);
+    STARTUPINFOW startupInfo = { sizeof(startupInfo) };
+    PROCESS_INFORMATION processInfo = {};
+    if (!CreateProcessW(nullptr, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo,
+                        &processInfo))
+    {
+        throw_last_error();
+    }
+    CloseHandle(processInfo.hThread);
+
+    std::vector<double> latencies;
+    Timer wallClock;
+    double elapsed = 0;
+    try
+    {
+        uint32_t slot = 0;
+        TensorRing::WaitResult result;
+        while ((result = ring->AcquireRead(slot, RingTimeoutMilliseconds)) == TensorRing::WaitResult::Ready)
+        {
+            if (latencies.empty())
+            {
+                wallClock.Start();
+            }
+            binding.Bind(inputName, slotTensors[slot]);
+            session.Evaluate(binding, L"");
+            latencies.push_back(TensorRing::SharedTensorRing::MillisecondsSince(ring->PublishedAt(slot)));
+            ring->Release();
+        }
+        elapsed = latencies.empty() ? 0 : wallClock.Stop();
+        if (result == TensorRing::WaitResult::TimedOut)
+        {
+            throw hresult_error(HRESULT_FROM_WIN32(ERROR_TIMEOUT),
+                                L"SharedMemoryInput: the producer process stopped publishing.");
+        }
+    }
+    catch (...)
+    {
+        TerminateProcess(processInfo.hProcess, 1);
+        CloseHandle(processInfo.hProcess);
+        throw;
+    }
+
+    DWORD exitCode = 0;
+    WaitForSingleObject(processInfo.hProcess, INFINITE);
+    GetExitCodeProcess(processInfo.hProcess, &exitCode);
+    CloseHandle(processInfo.hProcess);
+    if (exitCode != 0 || latencies.size() != num_requests)
+    {
+        throw hresult_error(E_FAIL, L"SharedMemoryInput: the producer process failed.");
+    }
+    return ComputeStats(latencies, elapsed);
+}
+
+static void PrintRow(const std::string& mode, const HandoffStats& stats)
+{
+    std::cout << "  " << std::setw(14) << mode << std::setw(20) << std::fixed << std::setprecision(1)
+              << stats.throughput << std::setw(12) << std::setprecision(3) << stats.p50 << std::setw(12) << stats.p90
+              << std::setw(12) << stats.p99 << std::defaultfloat << std::endl;
+}
+
+void SharedMemoryInputBenchmark(const std::wstring& path, const LearningModelDevice& device,
+                                const std::string& device_name, unsigned ring_slots, unsigned num_requests)
+{
+    auto model = LearningModel::LoadFromFilePath(path);
+    std::wcout << L"Shared memory input benchmark for " << path << std::endl;
+    std::cout << "  Device: " << device_name << ", requests: " << num_requests << ", ring slots: " << ring_slots
+              << std::endl;
+
+    auto descriptor = GetSingleFloatInput(model);
+    std::vector<int64_t> shape;
+    size_t elementCount = 1;
+    for (auto dim : descriptor.Shape())
+    {
+        shape.push_back(dim > 0 ? dim : 1);
+        elementCount *= static_cast<size_t>(shape.back());
+    }
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    std::vector<float> frame(elementCount);
+    std::generate(frame.begin(), frame.end(), [&]() { return distribution(generator); });
+
+    LearningModelSession session(model, device);
+    // Warm up so that first-run initialization is not charged to either mode.
+    EvaluateFromFiles(session, descriptor.Name(), shape, frame, 2);
+
+    std::cout << std::left << "  " << std::setw(14) << "Handoff" << std::setw(20) << "Throughput(req/s)"
+              << std::setw(12) << "p50(ms)" << std::setw(12) << "p90(ms)" << std::setw(12) << "p99(ms)" << std::endl;
+    HandoffStats files = EvaluateFromFiles(session, descriptor.Name(), shape, frame, num_requests);
+    PrintRow("File", files);
+    HandoffStats ring = EvaluateFromRing(session, descriptor.Name(), shape, elementCount, ring_slots, num_requests);
+    PrintRow("SharedMemory", ring);
+    std::cout << std::right << std::endl;
+}
+
+int RunRingProducer(const std::wstring& name, unsigned num_tensors)
+{
+    auto ring = TensorRing::SharedTensorRing::Open(name);
+    std::vector<uint8_t> tensor(ring->SlotBytes());
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+    for (size_t offset = 0; offset + sizeof(float) <= tensor.size(); offset += sizeof(float))
+    {
+        float value = distribution(generator);
+        memcpy(tensor.data() + offset, &value, sizeof(float));
+    }
+
+    for (unsigned i = 0; i < num_tensors; i++)
+    {
+        uint32_t slot = 0;
+        if (ring->AcquireWrite(slot, RingTimeoutMilliseconds) != TensorRing::WaitResult::Ready)
+        {
+            std::cout << "Ring producer: the consumer stopped reading." << std::endl;
+            return HRESULT_FROM_WIN32(ERROR_TIMEOUT);
+        }
+        // A camera or feature extractor would write its output straight into the slot.
+        memcpy(ring->Payload(slot), tensor.data(), tensor.size());
+        ring->Publish(ring->SlotBytes());
+    }
+    ring->Close();
+    return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <windows.h>
+
+// Milestones of this process on its way to its first result, which -StartupReport writes for the -ColdStart launch
+// that started it. Points in time are GetSystemTimePreciseAsFileTime values in 100 ns units, so that the launching
+// process can compare them with the time it called CreateProcess.
+namespace StartupTimings
+{
+struct Milestones
+{
+    uint64_t MainEntered = 0;
+    // End of the first evaluation.
+    std::atomic<uint64_t> FirstResult{ 0 };
+    // Activating the first WinML class, which loads Windows.AI.MachineLearning.dll beside the executable or else the
+    // inbox WinML.
+    double RuntimeLoadMs = 0;
+    // Creating the selected devices in main, less the runtime load it triggers.
+    double DeviceCreationMs = 0;
+    double ApartmentInitMs = 0;
+};
+
+inline Milestones& Get()
+{
+    static Milestones milestones;
+    return milestones;
+}
+
+inline uint64_t Now()
+{
+    FILETIME now;
+    GetSystemTimePreciseAsFileTime(&now);
+    return (static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+}
+
+// Records now as the first result unless one is recorded already.
+inline void MarkFirstResult()
+{
+    uint64_t none = 0;
+    Get().FirstResult.compare_exchange_strong(none, Now());
+}
+} // namespace StartupTimings
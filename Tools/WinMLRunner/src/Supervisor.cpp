@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <codecvt>
+#include <filesystem>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <set>
+
+#include "Windows.h"
+#include <shellapi.h>
+#include "common.h"
+#include "MachinePeak.h"
+#include "Scenarios.h"
+
+// Options of the supervisor itself, and the ones naming what to run and where the perf results go, which differ per
+// child. The supervisor passes every other option of its command line on to its children.
+static const std::map<std::wstring, int> SupervisorOptions = {
+    { L"-isolate", 0 },          { L"-journal", 1 }, { L"-maxchildren", 1 }, { L"-childtimeout", 1 },
+    { L"-childmemorylimit", 1 }, { L"-folder", 1 },  { L"-model", 1 },       { L"-onlyscenario", 1 },
+    { L"-perfoutput", -1 },      { L"-machinepeak", 3 },
+};
+
+std::vector<std::wstring> ChildArguments(const std::map<std::wstring, int>& options)
+{
+    int count = 0;
+    std::unique_ptr<LPWSTR, decltype(&LocalFree)> arguments(CommandLineToArgvW(GetCommandLineW(), &count), &LocalFree);
+    std::vector<std::wstring> childArguments;
+    for (int i = 1; i < count; i++)
+    {
+        std::wstring argument = arguments.get()[i];
+        std::wstring name = argument;
+        std::transform(name.begin(), name.end(), name.begin(), ::towlower);
+        auto option = options.find(name);
+        if (option == options.end())
+        {
+            childArguments.push_back(argument);
+        }
+        else if (option->second >= 0)
+        {
+            i += option->second;
+        }
+        else if (i + 1 < count && arguments.get()[i + 1][0] != L'-')
+        {
+            // The value is optional, as the path of -PerfOutput is.
+            i++;
+        }
+    }
+    return childArguments;
+}
+
+std::wstring QuoteArgument(const std::wstring& argument)
+{
+    if (!argument.empty() && argument.find_first_of(L" \t\"") == std::wstring::npos)
+    {
+        return argument;
+    }
+    std::wstring quoted = L"\"";
+    size_t backslashes = 0;
+    for (wchar_t character : argument)
+    {
+        if (character == L'\\')
+        {
+            backslashes++;
+            continue;
+        }
+        // Backslashes are only special in front of a quote.
+        quoted.append(character == L'"' ? backslashes * 2 + 1 : backslashes, L'\\');
+        backslashes = 0;
+        quoted += character;
+    }
+    quoted.append(backslashes * 2, L'\\');
+    return quoted + L"\"";
+}
+
+// Appends the rows of the perf CSV a child wrote to perf_output_path, writing its header first when perf_output_path
+// is new, and deletes it.
+static void AppendChildResults(const std::filesystem::path& child_output_path, const std::wstring& perf_output_path)
+{
+    std::ifstream childOutput(child_output_path);
+    if (!childOutput)
+    {
+        return;
+    }
+    bool writeHeader = !std::filesystem::exists(perf_output_path) || std::filesystem::file_size(perf_output_path) == 0;
+    std::ofstream output(std::filesystem::path(perf_output_path), std::ios::app);
+    std::string line;
+    for (bool header = true; std::getline(childOutput, line); header = false)
+    {
+        if (!header || writeHeader)
+        {
+            output << line << std::endl;
+        }
+    }
+    childOutput.close();
+    std::filesystem::remove(child_output_path);
+}
+
+// Units the journal at path lists as finished, whatever their outcome.
+static std::set<std::wstring> ReadJournal(const std::wstring& path)
+{
+    std::set<std::wstring> finished;
+    std::wifstream journal{ std::filesystem::path(path) };
+    journal.imbue(std::locale(journal.getloc(), new std::codecvt_utf8<wchar_t>));
+    std::wstring line;
+    while (std::getline(journal, line))
+    {
+        // <outcome>\t<exit code>\t<seconds>\t<unit>. A line cut short by a crash of the supervisor has no unit.
+        size_t unit = 0;
+        for (int field = 0; field < 3 && unit != std::wstring::npos; field++)
+        {
+            unit = line.find(L'\t', unit);
+            unit = unit == std::wstring::npos ? unit : unit + 1;
+        }
+        if (unit != std::wstring::npos && unit < line.size())
+        {
+            finished.insert(line.substr(unit));
+        }
+    }
+    return finished;
+}
+
+static const char* Outcome(DWORD exit_code, bool timed_out)
+{
+    if (timed_out)
+    {
+        return "timeout";
+    }
+    if (exit_code == 0)
+    {
+        return "ok";
+    }
+    // NTSTATUS exception codes, such as access violations and unhandled C++ exceptions, rather than an error returned
+    // by run().
+    return (exit_code & 0xC0000000) == 0xC0000000 ? "crashed" : "failed";
+}
+
+struct Child
+{
+    size_t Unit = 0;
+    winrt::handle Job;
+    winrt::handle Process;
+    std::filesystem::path OutputPath;
+    ULONGLONG StartTicks = 0;
+};
+
+// Starts command_line in a job of its own, so that it can be killed with everything it started and held to
+// memory_limit_mb, with its console output going to log_path.
+static Child StartChild(const std::wstring& command_line, const std::filesystem::path& log_path,
+                        uint64_t memory_limit_mb)
+{
+    Child child;
+    child.Job.attach(CreateJobObjectW(nullptr, nullptr));
+    winrt::check_bool(static_cast<bool>(child.Job));
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits = {};
+    limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+    if (memory_limit_mb > 0)
+    {
+        limits.BasicLimitInformation.LimitFlags |= JOB_OBJECT_LIMIT_PROCESS_MEMORY;
+        limits.ProcessMemoryLimit = static_cast<SIZE_T>(memory_limit_mb * 1024 * 1024);
+    }
+    winrt::check_bool(
+        SetInformationJobObject(child.Job.get(), JobObjectExtendedLimitInformation, &limits, sizeof(limits)));
+
+    SECURITY_ATTRIBUTES inheritable = { sizeof(inheritable), nullptr, TRUE };
+    winrt::file_handle log(CreateFileW(log_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &inheritable, CREATE_ALWAYS,
+                                       FILE_ATTRIBUTE_NORMAL, nullptr));
+    if (!log)
+    {
+        winrt::throw_last_error();
+    }
+    // Only the log is inherited, not the logs of the other children running at the time.
+    SIZE_T attributesSize = 0;
+    InitializeProcThreadAttributeList(nullptr, 1, 0, &attributesSize);
+    std::vector<char> attributesBuffer(attributesSize);
+    auto attributes = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(attributesBuffer.data());
+    winrt::check_bool(InitializeProcThreadAttributeList(attributes, 1, 0, &attributesSize));
+    HANDLE inherited = log.get();
+    winrt::check_bool(UpdateProcThreadAttribute(attributes, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, &inherited,
+                                                sizeof(inherited), nullptr, nullptr));
+
+    STARTUPINFOEXW startupInfo = {};
+    startupInfo.StartupInfo.cb = sizeof(startupInfo);
+    startupInfo.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    startupInfo.StartupInfo.hStdOutput = log.get();
+    startupInfo.StartupInfo.hStdError = log.get();
+    startupInfo.lpAttributeList = attributes;
+    PROCESS_INFORMATION processInfo = {};
+    std::wstring commandLine = command_line;
+    BOOL created = CreateProcessW(nullptr, &commandLine[0], nullptr, nullptr, TRUE,
+                                  CREATE_SUSPENDED | CREATE_NO_WINDOW | EXTENDED_STARTUPINFO_PRESENT, nullptr, nullptr,
+                                  &startupInfo.StartupInfo, &processInfo);
+    DeleteProcThreadAttributeList(attributes);
+    winrt::check_bool(created);
+    child.Process.attach(processInfo.hProcess);
+    winrt::handle thread(processInfo.hThread);
+    // Assigned before it runs, so that nothing it starts escapes the job.
+    if (!AssignProcessToJobObject(child.Job.get(), child.Process.get()))
+    {
+        TerminateProcess(child.Process.get(), 1);
+        winrt::throw_last_error();
+    }
+    ResumeThread(thread.get());
+    child.StartTicks = GetTickCount64();
+    return child;
+}
+
+static uint64_t AvailablePhysicalMB()
+{
+    MEMORYSTATUSEX status = { sizeof(status) };
+    GlobalMemoryStatusEx(&status);
+    return status.ullAvailPhys / (1024 * 1024);
+}
+
+int SuperviseChildren(const std::wstring& unit_option, const std::vector<std::wstring>& units,
+                      const std::wstring& journal_path, const std::wstring& perf_output_path, unsigned max_children,
+                      unsigned timeout_seconds, uint64_t memory_limit_mb)
+{
+    wchar_t executable[MAX_PATH] = {};
+    GetModuleFileNameW(nullptr, executable, MAX_PATH);
+    std::wstring baseCommandLine = QuoteArgument(executable);
+    for (const auto& argument : ChildArguments(SupervisorOptions))
+    {
+        baseCommandLine += L" " + QuoteArgument(argument);
+    }
+    std::filesystem::path logDirectory = journal_path + L".logs";
+    std::filesystem::create_directories(logDirectory);
+
+    std::set<std::wstring> finished = ReadJournal(journal_path);
+    std::vector<size_t> pending;
+    for (size_t unit = 0; unit < units.size(); unit++)
+    {
+        if (finished.count(units[unit]) == 0)
+        {
+            pending.push_back(unit);
+        }
+    }
+    std::wcout << L"Supervising " << pending.size() << L" of " << units.size() << L" runs, "
+               << units.size() - pending.size() << L" already in " << journal_path << std::endl;
+    if (!pending.empty())
+    {
+        // Measured once here on an idle machine rather than by every child, each beside its running siblings.
+        MachinePeak::Peak peak = MachinePeak::Measure();
+        baseCommandLine += L" -MachinePeak " + std::to_wstring(peak.threads) + L" " + std::to_wstring(peak.gflops) +
+                           L" " + std::to_wstring(peak.gigabytesPerSecond);
+    }
+
+    std::wofstream journal(std::filesystem::path(journal_path), std::ios::app);
+    journal.imbue(std::locale(journal.getloc(), new std::codecvt_utf8<wchar_t>));
+    std::map<std::string, size_t> outcomes;
+    std::vector<Child> running;
+    size_t next = 0;
+    size_t done = 0;
+    Timer sweepTimer;
+    sweepTimer.Start();
+    while (next < pending.size() || !running.empty())
+    {
+        // The first child always starts; later ones only while the CPU and memory budget allows.
+        while (next < pending.size() && running.size() < max_children &&
+               (running.empty() || memory_limit_mb == 0 || AvailablePhysicalMB() >= memory_limit_mb))
+        {
+            size_t unit = pending[next++];
+            std::wstring name = std::to_wstring(unit) + L"_" + std::filesystem::path(units[unit]).stem().wstring();
+            // Scenario ids may hold characters file names cannot.
+            std::replace_if(name.begin(), name.end(), [](wchar_t c) { return wcschr(L"<>:\"/\\|?*", c) != nullptr; },
+                            L'_');
+            std::filesystem::path outputPath = logDirectory / (name + L".csv");
+            std::filesystem::remove(outputPath);
+            std::wstring commandLine = baseCommandLine + L" " + unit_option + L" " + QuoteArgument(units[unit]) +
+                                       L" -PerfOutput " + QuoteArgument(outputPath.wstring());
+            try
+            {
+                running.push_back(StartChild(commandLine, logDirectory / (name + L".log"), memory_limit_mb));
+                running.back().Unit = unit;
+                running.back().OutputPath = outputPath;
+            }
+            catch (const winrt::hresult_error& error)
+            {
+                std::wcout << L"Starting a child for " << units[unit] << L" [FAILED]: " << error.message().c_str()
+                           << std::endl;
+                outcomes["failed"]++;
+                done++;
+            }
+        }
+        if (running.empty())
+        {
+            continue;
+        }
+
+        std::vector<HANDLE> processes;
+        for (const auto& child : running)
+        {
+            processes.push_back(child.Process.get());
+        }
+        // Wakes up on the first child exiting, and at least once a second to enforce the timeout.
+        WaitForMultipleObjects(static_cast<DWORD>(processes.size()), processes.data(), FALSE, 1000);
+        for (size_t i = 0; i < running.size();)
+        {
+            Child& child = running[i];
+            double seconds = (GetTickCount64() - child.StartTicks) / 1000.0;
+            bool exited = WaitForSingleObject(child.Process.get(), 0) == WAIT_OBJECT_0;
+            bool timedOut = !exited && seconds > timeout_seconds;
+            if (!exited && !timedOut)
+            {
+                i++;
+                continue;
+            }
+            DWORD exitCode = 0;
+            if (timedOut)
+            {
+                TerminateJobObject(child.Job.get(), 1);
+                WaitForSingleObject(child.Process.get(), INFINITE);
+            }
+            GetExitCodeProcess(child.Process.get(), &exitCode);
+            const char* outcome = Outcome(exitCode, timedOut);
+            outcomes[outcome]++;
+            done++;
+            // Results first: a supervisor dying in between reruns the child rather than losing its results.
+            AppendChildResults(child.OutputPath, perf_output_path);
+            journal << outcome << L"\t" << std::hex << L"0x" << exitCode << std::dec << L"\t" << std::fixed
+                    << std::setprecision(3) << seconds << L"\t" << units[child.Unit] << std::endl;
+            std::wcout << L"[" << done << L"/" << pending.size() << L"] " << units[child.Unit] << L": " << outcome;
+            if (exitCode != 0)
+            {
+                std::wcout << L" (0x" << std::hex << exitCode << std::dec << L")";
+            }
+            std::wcout << L" in " << std::fixed << std::setprecision(1) << seconds << L" s" << std::defaultfloat
+                       << std::endl;
+            running.erase(running.begin() + i);
+        }
+    }
+
+    std::cout << "Supervised runs finished in " << std::fixed << std::setprecision(1) << sweepTimer.Stop() / 1000
+              << " s:" << std::defaultfloat;
+    for (const auto& outcome : outcomes)
+    {
+        std::cout << " " << outcome.second << " " << outcome.first;
+    }
+    std::cout << std::endl;
+    std::wcout << L"Logs of every run are in " << logDirectory.wstring() << std::endl;
+    return outcomes["ok"] == done ? 0 : 1;
+}
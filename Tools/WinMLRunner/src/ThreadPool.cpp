@@ -31,7 +31,11 @@ ThreadPool::ThreadPool(unsigned int initial_pool_size) : m_threads(), m_destruct
 
 ThreadPool::~ThreadPool()
 {
-    m_destruct_pool = true;
+    {
+        // Set under the lock so that a thread between checking the flag and waiting cannot miss the notification
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_destruct_pool = true;
+    }
     m_cond_var.notify_all(); // notify destruction to threads
     for (auto& thread : m_threads)
     {
@@ -8,6 +8,8 @@
 #include <PdhMsg.h>
 #endif
 #include <psapi.h>
+#include "AllocationTracker.h"
+#include "EnvironmentMonitor.h"
 
 #define TIMER_SLOT_SIZE (1024)
 #define CONVERT_100NS_TO_SECOND(x) ((x)*0.0000001)
@@ -463,6 +465,8 @@ public:
 #ifndef DISABLE_GPU_COUNTERS
         m_gpuCounter.Reset();
 #endif
+        m_allocations.Reset();
+        m_clock.Reset();
         for (int i = 0; i < CounterType::TYPE_COUNT; ++i)
         {
             m_data[i].Reset();
@@ -474,11 +478,15 @@ public:
         if (m_bDisabled)
             return;
 
+        // Before the timer, so that waiting on the sampling thread's lock is not timed.
+        EnvironmentMonitor::Enter(m_clock);
         m_timer.Start();
         m_cpuCounter.Start();
 #ifndef DISABLE_GPU_COUNTERS
         m_gpuCounter.Start();
 #endif
+        // Last, so that the counters' own allocations are not counted.
+        AllocationTracker::Enter(m_allocations);
     }
 
     void Stop()
@@ -486,6 +494,7 @@ public:
         if (m_bDisabled)
             return;
 
+        AllocationTracker::Leave();
         double counterValue[CounterType::TYPE_COUNT];
 
         // Query counters
@@ -494,6 +503,7 @@ public:
 #ifndef DISABLE_GPU_COUNTERS
         m_gpuCounter.Stop();
 #endif
+        EnvironmentMonitor::Leave();
 
         // Get counter values
         counterValue[CounterType::TIMER] = time;
@@ -564,6 +574,8 @@ public:
     double GetCpuWorkingStart() { return CpuWorkingStart; }
     double GetGpuSharedStart() { return GpuSharedStart; }
     double GetGpuDedicatedDiff() { return GpuDedicatedDiff; }
+    const AllocationTracker::Phase& GetAllocations() const { return m_allocations; }
+    const EnvironmentMonitor::Phase& GetClock() const { return m_clock; }
 
 private:
     struct DataBlock
@@ -592,6 +604,8 @@ private:
     GpuPerfCounter m_gpuCounter;
 #endif
     DataBlock m_data[CounterType::TYPE_COUNT];
+    AllocationTracker::Phase m_allocations;
+    EnvironmentMonitor::Phase m_clock;
 
     double clockTime;
     double CpuWorkingDiff;
@@ -1,5 +1,6 @@
 #pragma once
 #include "Common.h"
+#include "ModelSource.h"
 
 using namespace winrt::Windows::AI::MachineLearning;
 using namespace winrt::Windows::Graphics::DirectX;
@@ -35,6 +36,16 @@ enum class DeviceCreationLocation
     UserD3DDevice
 };
 
+// Engine behind -Backend. None runs the usual WinML pipeline.
+enum class BackendType
+{
+    None,
+    WinML,
+    Reference,
+    // The reference executor without its optimizations, as a baseline for them.
+    ReferenceNaive
+};
+
 class TypeHelper
 {
 public:
@@ -111,6 +122,21 @@ public:
         throw "No name found for this DeviceCreationLocation.";
     }
 
+    static std::string Stringify(ModelSource::LoadMode loadMode)
+    {
+        switch (loadMode)
+        {
+            case ModelSource::LoadMode::Path:
+                return "Path";
+            case ModelSource::LoadMode::Stream:
+                return "Stream";
+            case ModelSource::LoadMode::MemoryMap:
+                return "MemoryMap";
+        }
+
+        throw "No name found for this LoadMode.";
+    }
+
     static std::wstring Stringify(TensorKind tensorKind)
     {
         // IMPORTANT: This tensorKinds array needs to match the "enum class TensorKind" idl in
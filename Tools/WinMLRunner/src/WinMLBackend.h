@@ -0,0 +1,247 @@
+#pragma once
+
+#include "Common.h"
+#include "InferenceBackend.h"
+#include "Windows.AI.MachineLearning.Native.h"
+#include <map>
+
+// InferenceBackend implementation over Windows ML, so that harness code written against the portable interface in
+// SampleSharedLib runs on any LearningModelDevice as well as on the reference CPU backend. Inputs are copied into
+// tensors created from the host buffer; outputs are read through ITensorNative when the session exposes its buffer
+// (CPU) and copied through GetAsVectorView otherwise (GPU). Image features are bound as NCHW float tensors.
+namespace WinMLBackend
+{
+    namespace WinML = winrt::Windows::AI::MachineLearning;
+    using InferenceBackend::ElementType;
+
+    inline ElementType ToElementType(WinML::TensorKind kind)
+    {
+        switch (kind)
+        {
+            case WinML::TensorKind::Float: return ElementType::Float;
+            case WinML::TensorKind::Float16: return ElementType::Float16;
+            case WinML::TensorKind::Double: return ElementType::Double;
+            case WinML::TensorKind::Int8: return ElementType::Int8;
+            case WinML::TensorKind::UInt8: return ElementType::UInt8;
+            case WinML::TensorKind::Int16: return ElementType::Int16;
+            case WinML::TensorKind::UInt16: return ElementType::UInt16;
+            case WinML::TensorKind::Int32: return ElementType::Int32;
+            case WinML::TensorKind::UInt32: return ElementType::UInt32;
+            case WinML::TensorKind::Int64: return ElementType::Int64;
+            case WinML::TensorKind::UInt64: return ElementType::UInt64;
+            case WinML::TensorKind::Boolean: return ElementType::Bool;
+            default: return ElementType::Undefined;
+        }
+    }
+
+    inline InferenceBackend::ValueInfo ToValueInfo(const WinML::ILearningModelFeatureDescriptor& feature)
+    {
+        InferenceBackend::ValueInfo info;
+        info.name = winrt::to_string(feature.Name());
+        if (auto tensorDescriptor = feature.try_as<WinML::TensorFeatureDescriptor>())
+        {
+            info.type = ToElementType(tensorDescriptor.TensorKind());
+            for (int64_t dim : tensorDescriptor.Shape())
+            {
+                info.shape.push_back(dim);
+            }
+        }
+        else if (auto imageDescriptor = feature.try_as<WinML::ImageFeatureDescriptor>())
+        {
+            auto format = imageDescriptor.BitmapPixelFormat();
+            bool isGray = format == winrt::Windows::Graphics::Imaging::BitmapPixelFormat::Gray8 ||
+                          format == winrt::Windows::Graphics::Imaging::BitmapPixelFormat::Gray16;
+            info.type = ElementType::Float;
+            info.shape = { 1, isGray ? 1 : 3, static_cast<int64_t>(imageDescriptor.Height()),
+                           static_cast<int64_t>(imageDescriptor.Width()) };
+        }
+        else
+        {
+            throw std::runtime_error("WinMLBackend: feature " + info.name + " is not a tensor or an image.");
+        }
+        return info;
+    }
+
+    template <typename TTensor, typename T> TTensor CreateFromData(const InferenceBackend::Tensor& value)
+    {
+        const T* data = value.Data<T>();
+        return TTensor::CreateFromArray(value.Shape(), winrt::array_view<const T>(data, data + value.ElementCount()));
+    }
+
+    inline WinML::ITensor CreateTensor(const InferenceBackend::Tensor& value)
+    {
+        switch (value.Type())
+        {
+            case ElementType::Float: return CreateFromData<WinML::TensorFloat, float>(value);
+            case ElementType::Float16:
+            {
+                // TensorFloat16Bit is created from floats.
+                std::vector<float> values(value.ElementCount());
+                for (size_t i = 0; i < values.size(); i++)
+                {
+                    values[i] = DirectX::PackedVector::XMConvertHalfToFloat(value.Data<uint16_t>()[i]);
+                }
+                return WinML::TensorFloat16Bit::CreateFromArray(value.Shape(), values);
+            }
+            case ElementType::Double: return CreateFromData<WinML::TensorDouble, double>(value);
+            case ElementType::Int8: return CreateFromData<WinML::TensorInt8Bit, uint8_t>(value);
+            case ElementType::UInt8: return CreateFromData<WinML::TensorUInt8Bit, uint8_t>(value);
+            case ElementType::Int16: return CreateFromData<WinML::TensorInt16Bit, int16_t>(value);
+            case ElementType::UInt16: return CreateFromData<WinML::TensorUInt16Bit, uint16_t>(value);
+            case ElementType::Int32: return CreateFromData<WinML::TensorInt32Bit, int32_t>(value);
+            case ElementType::UInt32: return CreateFromData<WinML::TensorUInt32Bit, uint32_t>(value);
+            case ElementType::Int64: return CreateFromData<WinML::TensorInt64Bit, int64_t>(value);
+            case ElementType::UInt64: return CreateFromData<WinML::TensorUInt64Bit, uint64_t>(value);
+            case ElementType::Bool: return CreateFromData<WinML::TensorBoolean, bool>(value);
+            default: throw std::runtime_error("WinMLBackend: cannot bind a tensor of undefined type.");
+        }
+    }
+
+    template <typename TTensor, typename T>
+    void CopyFromView(const WinML::ITensor& tensor, InferenceBackend::Tensor& out)
+    {
+        auto view = tensor.as<TTensor>().GetAsVectorView();
+        std::copy(begin(view), end(view), out.Data<T>());
+    }
+
+    inline void ReadTensor(const WinML::ITensor& tensor, InferenceBackend::Tensor& out)
+    {
+        std::vector<int64_t> shape;
+        for (int64_t dim : tensor.Shape())
+        {
+            shape.push_back(dim);
+        }
+        out.Reset(ToElementType(tensor.TensorKind()), shape);
+        try
+        {
+            winrt::com_ptr<ITensorNative> tensorNative = tensor.as<ITensorNative>();
+            BYTE* buffer = nullptr;
+            uint32_t capacity = 0;
+            winrt::check_hresult(tensorNative->GetBuffer(&buffer, &capacity));
+            memcpy(out.Data(), buffer, (std::min<size_t>)(capacity, out.ByteSize()));
+            return;
+        }
+        catch (winrt::hresult_error const&)
+        {
+        }
+        switch (out.Type())
+        {
+            case ElementType::Float: CopyFromView<WinML::TensorFloat, float>(tensor, out); break;
+            case ElementType::Float16:
+            {
+                auto view = tensor.as<WinML::TensorFloat16Bit>().GetAsVectorView();
+                for (uint32_t i = 0; i < view.Size(); i++)
+                {
+                    out.Data<uint16_t>()[i] = DirectX::PackedVector::XMConvertFloatToHalf(view.GetAt(i));
+                }
+                break;
+            }
+            case ElementType::Double: CopyFromView<WinML::TensorDouble, double>(tensor, out); break;
+            case ElementType::Int8: CopyFromView<WinML::TensorInt8Bit, uint8_t>(tensor, out); break;
+            case ElementType::UInt8: CopyFromView<WinML::TensorUInt8Bit, uint8_t>(tensor, out); break;
+            case ElementType::Int16: CopyFromView<WinML::TensorInt16Bit, int16_t>(tensor, out); break;
+            case ElementType::UInt16: CopyFromView<WinML::TensorUInt16Bit, uint16_t>(tensor, out); break;
+            case ElementType::Int32: CopyFromView<WinML::TensorInt32Bit, int32_t>(tensor, out); break;
+            case ElementType::UInt32: CopyFromView<WinML::TensorUInt32Bit, uint32_t>(tensor, out); break;
+            case ElementType::Int64: CopyFromView<WinML::TensorInt64Bit, int64_t>(tensor, out); break;
+            case ElementType::UInt64: CopyFromView<WinML::TensorUInt64Bit, uint64_t>(tensor, out); break;
+            case ElementType::Bool: CopyFromView<WinML::TensorBoolean, bool>(tensor, out); break;
+            default: throw std::runtime_error("WinMLBackend: cannot read a tensor of undefined type.");
+        }
+    }
+
+    class Session : public InferenceBackend::Session
+    {
+    public:
+        Session(const WinML::LearningModel& model, const WinML::LearningModelDevice& device)
+            : m_session(model, device), m_binding(m_session)
+        {
+        }
+
+        void Bind(const std::string& name, const InferenceBackend::Tensor& value) override
+        {
+            m_binding.Bind(winrt::to_hstring(name), CreateTensor(value));
+        }
+
+        void Evaluate() override
+        {
+            m_result = m_session.Evaluate(m_binding, L"");
+            m_outputs.clear();
+        }
+
+        // Outputs are copied out of the evaluation result the first time they are asked for.
+        const InferenceBackend::Tensor& Output(const std::string& name) override
+        {
+            auto cached = m_outputs.find(name);
+            if (cached != m_outputs.end())
+            {
+                return cached->second;
+            }
+            if (!m_result)
+            {
+                throw std::runtime_error("WinMLBackend: Output was called before Evaluate.");
+            }
+            auto value = m_result.Outputs().TryLookup(winrt::to_hstring(name));
+            auto tensor = value ? value.try_as<WinML::ITensor>() : nullptr;
+            if (!tensor)
+            {
+                throw std::runtime_error("WinMLBackend: " + name + " is not a tensor output of the model.");
+            }
+            InferenceBackend::Tensor& output = m_outputs[name];
+            ReadTensor(tensor, output);
+            return output;
+        }
+
+    private:
+        WinML::LearningModelSession m_session;
+        WinML::LearningModelBinding m_binding;
+        WinML::LearningModelEvaluationResult m_result = nullptr;
+        std::map<std::string, InferenceBackend::Tensor> m_outputs;
+    };
+
+    class Model : public InferenceBackend::Model
+    {
+    public:
+        Model(const WinML::LearningModel& model, const WinML::LearningModelDevice& device)
+            : m_model(model), m_device(device)
+        {
+            for (auto&& feature : m_model.InputFeatures())
+            {
+                m_inputs.push_back(ToValueInfo(feature));
+            }
+            for (auto&& feature : m_model.OutputFeatures())
+            {
+                m_outputs.push_back(ToValueInfo(feature));
+            }
+        }
+
+        const std::vector<InferenceBackend::ValueInfo>& Inputs() const override { return m_inputs; }
+        const std::vector<InferenceBackend::ValueInfo>& Outputs() const override { return m_outputs; }
+        std::unique_ptr<InferenceBackend::Session> CreateSession() override
+        {
+            return std::make_unique<Session>(m_model, m_device);
+        }
+
+    private:
+        WinML::LearningModel m_model;
+        WinML::LearningModelDevice m_device;
+        std::vector<InferenceBackend::ValueInfo> m_inputs;
+        std::vector<InferenceBackend::ValueInfo> m_outputs;
+    };
+
+    // Sessions of every model loaded through this backend run on device.
+    class Backend : public InferenceBackend::Backend
+    {
+    public:
+        explicit Backend(const WinML::LearningModelDevice& device) : m_device(device) {}
+
+        std::string Name() const override { return "WinML"; }
+        std::unique_ptr<InferenceBackend::Model> Load(const std::filesystem::path& path) override
+        {
+            return std::make_unique<Model>(WinML::LearningModel::LoadFromFilePath(path.wstring()), m_device);
+        }
+
+    private:
+        WinML::LearningModelDevice m_device;
+    };
+}
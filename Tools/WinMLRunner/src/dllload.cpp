@@ -1,4 +1,5 @@
 #include "FileHelper.h"
+#include "StartupTimings.h"
 #include <winrt/Windows.Foundation.h>
 #include <winstring.h>
 
@@ -18,7 +19,7 @@ bool starts_with(std::wstring_view value, std::wstring_view match) noexcept
     return 0 == value.compare(0, match.size(), match);
 }
 
-int32_t __stdcall WINRT_RoGetActivationFactory(void* classId, winrt::guid const& iid, void** factory) noexcept
+static int32_t GetActivationFactory(void* classId, winrt::guid const& iid, void** factory) noexcept
 {
     *factory = nullptr;
     std::wstring_view name{ WindowsGetStringRawBuffer(static_cast<HSTRING>(classId), nullptr),
@@ -70,3 +71,19 @@ int32_t __stdcall WINRT_RoGetActivationFactory(void* classId, winrt::guid const&
     *factory = activation_factory.detach();
     return S_OK;
 }
+
+int32_t __stdcall WINRT_RoGetActivationFactory(void* classId, winrt::guid const& iid, void** factory) noexcept
+{
+    // The first WinML class activated loads the runtime; the later ones find it loaded.
+    static std::atomic_flag loaded = ATOMIC_FLAG_INIT;
+    std::wstring_view name{ WindowsGetStringRawBuffer(static_cast<HSTRING>(classId), nullptr),
+                            WindowsGetStringLen(static_cast<HSTRING>(classId)) };
+    if (!starts_with(name, L"Windows.AI.MachineLearning.") || loaded.test_and_set())
+    {
+        return GetActivationFactory(classId, iid, factory);
+    }
+    uint64_t start = StartupTimings::Now();
+    int32_t hr = GetActivationFactory(classId, iid, factory);
+    StartupTimings::Get().RuntimeLoadMs = (StartupTimings::Now() - start) / 10000.0;
+    return hr;
+}
@@ -1,12 +1,14 @@
 #include "CommandLineArgs.h"
 #include "Run.h"
 #include "Common.h"
+#include "StartupTimings.h"
 #include <iostream>
 #include <codecvt>
 using namespace std;
 
 int main(int argc, char *argv[])
 {
+    StartupTimings::Get().MainEntered = StartupTimings::Now();
     std::wstring_convert<std::codecvt_utf8<wchar_t>, wchar_t> converter;
     vector<wstring> argsList;
     CommandLineArgs* commandLineArgs = NULL;
@@ -29,7 +31,20 @@ int main(int argc, char *argv[])
     vector<LearningModelDeviceWithMetadata> deviceList;
     try
     {
-        PopulateLearningModelDeviceList(*commandLineArgs, deviceList);
+        // Initialize COM in a multi-threaded environment before the devices are created, which would otherwise join
+        // the apartment themselves and have its cost counted as device creation.
+        uint64_t apartmentStart = StartupTimings::Now();
+        winrt::init_apartment();
+        StartupTimings::Get().ApartmentInitMs = (StartupTimings::Now() - apartmentStart) / 10000.0;
+
+        // The -ColdStart launches and the -ScaleOut workers create their own devices.
+        if (commandLineArgs->ColdStartLaunches() == 0 && commandLineArgs->ScaleOutWorkers() == 0)
+        {
+            uint64_t start = StartupTimings::Now();
+            PopulateLearningModelDeviceList(*commandLineArgs, deviceList);
+            StartupTimings::Get().DeviceCreationMs =
+                (StartupTimings::Now() - start) / 10000.0 - StartupTimings::Get().RuntimeLoadMs;
+        }
     }
     catch (const hresult_error& error)
     {